@@ -98,6 +98,65 @@ inline epicsUInt32 dbr_htonl ( const epicsUInt32 & host )
     return tmp;
 }
 
+/*
+ * Bulk array byte swapping
+ *
+ * On plain little endian hosts with IEEE floats the conversion of each
+ * 16, 32 and 64 bit element is just a reversal of its bytes, in either
+ * direction. The loops are written byte-wise so that they work for
+ * unaligned and "in place" buffers and can be vectorized by the compiler
+ * (a bswap based loop is not). On x86 Linux with a recent gcc, SSSE3 and
+ * AVX2 versions are also built and the best one is selected at run time.
+ */
+#if EPICS_BYTE_ORDER == EPICS_ENDIAN_LITTLE && \
+    EPICS_FLOAT_WORD_ORDER == EPICS_ENDIAN_LITTLE
+#   define CA_BULK_SWAP
+
+#if defined ( __GNUC__ ) && __GNUC__ >= 6 && \
+    ( defined ( __x86_64__ ) || defined ( __i386__ ) ) && \
+    defined ( __linux__ ) && ! defined ( __clang__ )
+#   define CA_SWAP_CLONES \
+        __attribute__ (( target_clones ( "default", "ssse3", "avx2" ) ))
+#else
+#   define CA_SWAP_CLONES
+#endif
+
+template < unsigned N >
+inline void swapElements ( const void * s, void * d, arrayElementCount num )
+{
+    const epicsUInt8 * pSrc = static_cast < const epicsUInt8 * > ( s );
+    epicsUInt8 * pDest = static_cast < epicsUInt8 * > ( d );
+
+    for ( arrayElementCount i = 0; i < num; i++ ) {
+        epicsUInt8 tmp[N];
+        for ( unsigned j = 0; j < N; j++ ) {
+            tmp[j] = pSrc[N * i + N - 1 - j];
+        }
+        for ( unsigned j = 0; j < N; j++ ) {
+            pDest[N * i + j] = tmp[j];
+        }
+    }
+}
+
+CA_SWAP_CLONES
+static void swapArray16 ( const void * s, void * d, arrayElementCount num )
+{
+    swapElements < 2u > ( s, d, num );
+}
+
+CA_SWAP_CLONES
+static void swapArray32 ( const void * s, void * d, arrayElementCount num )
+{
+    swapElements < 4u > ( s, d, num );
+}
+
+CA_SWAP_CLONES
+static void swapArray64 ( const void * s, void * d, arrayElementCount num )
+{
+    swapElements < 8u > ( s, d, num );
+}
+#endif
+
 /*
  * if hton is true then it is a host to network conversion
  * otherwise vise-versa
@@ -138,6 +197,9 @@ arrayElementCount   num         /* number of values     */
     dbr_short_t         *pSrc = (dbr_short_t *) s;
     dbr_short_t         *pDest = (dbr_short_t *) d;
 
+#ifdef CA_BULK_SWAP
+    swapArray16 ( pSrc, pDest, num );
+#else
     if(encode){
         for(arrayElementCount i=0; i<num; i++){
             pDest[i] = dbr_htons( pSrc[i] );
@@ -148,6 +210,7 @@ arrayElementCount   num         /* number of values     */
             pDest[i] = dbr_ntohs( pSrc[i] );
         }
     }
+#endif
 }
 
 /*
@@ -188,6 +251,9 @@ arrayElementCount   num         /* number of values     */
     dbr_long_t          *pSrc = (dbr_long_t *) s;
     dbr_long_t          *pDest = (dbr_long_t *) d;
 
+#ifdef CA_BULK_SWAP
+    swapArray32 ( pSrc, pDest, num );
+#else
     if(encode){
         for(arrayElementCount i=0; i<num; i++){
             pDest[i] = dbr_htonl( pSrc[i] );
@@ -198,6 +264,7 @@ arrayElementCount   num         /* number of values     */
             pDest[i] = dbr_ntohl( pSrc[i] );
         }
     }
+#endif
 }
 
 /*
@@ -217,6 +284,9 @@ arrayElementCount   num         /* number of values     */
     dbr_enum_t          *pSrc = (dbr_enum_t *) s;
     dbr_enum_t          *pDest = (dbr_enum_t *) d;
 
+#ifdef CA_BULK_SWAP
+    swapArray16 ( pSrc, pDest, num );
+#else
     if(encode){
         for(arrayElementCount i=0; i<num; i++){
             pDest[i] = dbr_htons ( pSrc[i] );
@@ -227,6 +297,7 @@ arrayElementCount   num         /* number of values     */
             pDest[i] = dbr_ntohs ( pSrc[i] );
         }
     }
+#endif
 }
 
 /*
@@ -248,6 +319,9 @@ arrayElementCount   num         /* number of values     */
     const dbr_float_t   *pSrc = (const dbr_float_t *) s;
     dbr_float_t         *pDest = (dbr_float_t *) d;
 
+#ifdef CA_BULK_SWAP
+    swapArray32 ( pSrc, pDest, num );
+#else
     if(encode){
         for(arrayElementCount i=0; i<num; i++){
             dbr_htonf ( &pSrc[i], &pDest[i] );
@@ -258,6 +332,7 @@ arrayElementCount   num         /* number of values     */
             dbr_ntohf ( &pSrc[i], &pDest[i] );
         }
     }
+#endif
 }
 
 /*
@@ -273,6 +348,9 @@ arrayElementCount   num         /* number of values     */
     dbr_double_t        *pSrc = (dbr_double_t *) s;
     dbr_double_t        *pDest = (dbr_double_t *) d;
 
+#ifdef CA_BULK_SWAP
+    swapArray64 ( pSrc, pDest, num );
+#else
     if(encode){
         for(arrayElementCount i=0; i<num; i++){
             dbr_htond ( &pSrc[i], &pDest[i] );
@@ -283,6 +361,7 @@ arrayElementCount   num         /* number of values     */
             dbr_ntohd( &pSrc[i], &pDest[i] );
         }
     }
+#endif
 }
 
 /****************************************************************************
@@ -0,0 +1,129 @@
+/*************************************************************************\
+* EPICS BASE is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+/*
+ * Checks the wire format produced by caNetConvert() for array payloads
+ * and measures the encode/decode throughput for large arrays.
+ */
+
+#include <cstdlib>
+#include <cstring>
+
+#include "epicsTime.h"
+#include "epicsUnitTest.h"
+#include "testMain.h"
+#include "caerr.h"
+#include "net_convert.h"
+
+static const arrayElementCount nSmall = 1001u;
+static const arrayElementCount nLarge = 1000000u;
+static const unsigned nIterations = 20u;
+
+/* Expected big endian wire bytes for element i, byte j of size n */
+static epicsUInt8 wireByte ( arrayElementCount i, unsigned j, unsigned n )
+{
+    return static_cast < epicsUInt8 > ( i * 7u + n - 1 - j );
+}
+
+static void testEncodeDecode ( unsigned type, const char * name, unsigned size )
+{
+    epicsUInt8 * pHost = new epicsUInt8 [ nSmall * size ];
+    epicsUInt8 * pNet = new epicsUInt8 [ nSmall * size + 1 ];
+    epicsUInt8 * pBack = new epicsUInt8 [ nSmall * size ];
+
+    /* host values whose wire form is known */
+    for ( arrayElementCount i = 0; i < nSmall; i++ ) {
+        for ( unsigned j = 0; j < size; j++ ) {
+            pNet[i * size + j] = wireByte ( i, j, size );
+        }
+    }
+    caNetConvert ( type, pNet, pHost, false, nSmall );
+
+    int ok = caNetConvert ( type, pHost, pNet, true, nSmall ) == ECA_NORMAL;
+    for ( arrayElementCount i = 0; ok && i < nSmall; i++ ) {
+        for ( unsigned j = 0; j < size; j++ ) {
+            if ( pNet[i * size + j] != wireByte ( i, j, size ) ) {
+                testDiag ( "element %lu byte %u wrong", i, j );
+                ok = 0;
+                break;
+            }
+        }
+    }
+    testOk ( ok, "%s array encodes to wire format", name );
+
+    /* in place and unaligned round trips */
+    memcpy ( pBack, pHost, nSmall * size );
+    caNetConvert ( type, pBack, pBack, true, nSmall );
+    caNetConvert ( type, pBack, pBack, false, nSmall );
+    testOk ( memcmp ( pBack, pHost, nSmall * size ) == 0,
+        "%s array in place round trip", name );
+
+    caNetConvert ( type, pHost, pNet + 1, true, nSmall );
+    caNetConvert ( type, pNet + 1, pBack, false, nSmall );
+    testOk ( memcmp ( pBack, pHost, nSmall * size ) == 0,
+        "%s array unaligned round trip", name );
+
+    delete [] pHost;
+    delete [] pNet;
+    delete [] pBack;
+}
+
+static void measure ( unsigned type, const char * name, unsigned size )
+{
+    epicsUInt8 * pBuf = new epicsUInt8 [ nLarge * size ];
+    epicsUInt8 * pOut = new epicsUInt8 [ nLarge * size ];
+    epicsTimeStamp start, stop;
+
+    memset ( pBuf, 0x5a, nLarge * size );
+
+    epicsTimeGetCurrent ( &start );
+    for ( unsigned i = 0; i < nIterations; i++ ) {
+        caNetConvert ( type, pBuf, pBuf, true, nLarge );
+    }
+    epicsTimeGetCurrent ( &stop );
+    double inPlace = epicsTimeDiffInSeconds ( &stop, &start ) / nIterations;
+
+    epicsTimeGetCurrent ( &start );
+    for ( unsigned i = 0; i < nIterations; i++ ) {
+        caNetConvert ( type, pBuf, pOut, true, nLarge );
+    }
+    epicsTimeGetCurrent ( &stop );
+    double copy = epicsTimeDiffInSeconds ( &stop, &start ) / nIterations;
+
+    testDiag ( "%-12s %lu elements: in place %8.3f ms (%7.1f MB/s), "
+        "copy %8.3f ms (%7.1f MB/s)", name, nLarge,
+        inPlace * 1e3, nLarge * size / inPlace / 1e6,
+        copy * 1e3, nLarge * size / copy / 1e6 );
+
+    delete [] pBuf;
+    delete [] pOut;
+}
+
+static const struct {
+    unsigned type;
+    const char * name;
+    unsigned size;
+} types[] = {
+    { DBR_SHORT,  "DBR_SHORT",  sizeof ( dbr_short_t ) },
+    { DBR_ENUM,   "DBR_ENUM",   sizeof ( dbr_enum_t ) },
+    { DBR_LONG,   "DBR_LONG",   sizeof ( dbr_long_t ) },
+    { DBR_FLOAT,  "DBR_FLOAT",  sizeof ( dbr_float_t ) },
+    { DBR_DOUBLE, "DBR_DOUBLE", sizeof ( dbr_double_t ) },
+};
+static const unsigned nTypes = sizeof ( types ) / sizeof ( types[0] );
+
+MAIN ( caNetConvertPerform )
+{
+    testPlan ( 3 * nTypes );
+
+    for ( unsigned i = 0; i < nTypes; i++ ) {
+        testEncodeDecode ( types[i].type, types[i].name, types[i].size );
+    }
+    for ( unsigned i = 0; i < nTypes; i++ ) {
+        measure ( types[i].type, types[i].name, types[i].size );
+    }
+
+    return testDone ();
+}
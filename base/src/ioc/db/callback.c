@@ -43,6 +43,7 @@
 #include "dbFldTypes.h"
 #include "dbLock.h"
 #include "dbStaticLib.h"
+#include "dbTaskStats.h"
 #include "epicsExport.h"
 #include "link.h"
 #include "recSup.h"
@@ -58,6 +59,7 @@ typedef struct cbQueueSet {
     int shutdown;
     int threadsConfigured;
     int threadsRunning;
+    dbTaskStatsId stats;
 } cbQueueSet;
 
 static cbQueueSet callbackQueue[NUM_CALLBACK_PRIORITIES];
@@ -169,10 +171,14 @@ static void callbackTask(void *arg)
 
         while ((ptr = epicsRingPointerPop(mySet->queue))) {
             epicsCallback *pcallback = (epicsCallback *)ptr;
+            epicsTimeStamp start;
+
             if(!epicsRingPointerIsEmpty(mySet->queue))
                 epicsEventMustTrigger(mySet->semWakeUp);
             mySet->queueOverflow = FALSE;
+            dbTaskStatsStart(mySet->stats, &start);
             (*pcallback->callback)(pcallback);
+            dbTaskStatsDone(mySet->stats, &start, NULL);
         }
     }
 
@@ -246,6 +252,7 @@ void callbackInit(void)
             cantProceed("epicsRingPointerLockedCreate failed for %s\n",
                 threadNamePrefix[i]);
         callbackQueue[i].queueOverflow = FALSE;
+        callbackQueue[i].stats = dbTaskStatsCreate(threadNamePrefix[i]);
         if (callbackQueue[i].threadsConfigured == 0)
             callbackQueue[i].threadsConfigured = callbackThreadsDefault;
 
@@ -284,15 +291,20 @@ int callbackRequest(epicsCallback *pcallback)
         return S_db_badChoice;
     }
     mySet = &callbackQueue[priority];
-    if (mySet->queueOverflow) return S_db_bufFull;
+    if (mySet->queueOverflow) {
+        dbTaskStatsOverflow(mySet->stats);
+        return S_db_bufFull;
+    }
 
     pushOK = epicsRingPointerPush(mySet->queue, pcallback);
 
     if (!pushOK) {
         epicsInterruptContextMessage(fullMessage[priority]);
         mySet->queueOverflow = TRUE;
+        dbTaskStatsOverflow(mySet->stats);
         return S_db_bufFull;
     }
+    dbTaskStatsQueued(mySet->stats);
     epicsEventSignal(mySet->semWakeUp);
     return 0;
 }
@@ -46,6 +46,7 @@
 #include "db_convert.h"
 #include "dbLock.h"
 #include "dbScan.h"
+#include "dbTaskStats.h"
 #include "link.h"
 #include "recSup.h"
 
@@ -56,6 +57,7 @@ static ELLLIST workList = ELLLIST_INIT;    /* Work list for dbCaTask */
 static epicsMutexId workListLock; /*Mutual exclusions semaphores for workList*/
 static epicsEventId workListEvent; /*wakeup event for dbCaTask*/
 static int removesOutstanding = 0;
+static dbTaskStatsId dbCaStats;
 #define removesOutstandingWarning 10000
 
 static volatile enum {
@@ -152,8 +154,11 @@ static void addAction(caLink *pca, short link_action)
         }
     }
     pca->link_action |= link_action;
-    if (callAdd)
+    if (callAdd) {
         ellAdd(&workList, &pca->node);
+        dbTaskStatsStart(dbCaStats, &pca->queued);
+        dbTaskStatsQueued(dbCaStats);
+    }
     epicsMutexUnlock(workListLock);
     if (callAdd)
         epicsEventSignal(workListEvent);
@@ -231,6 +236,7 @@ void dbCaLinkInit(void)
     dbCaLinkInitIsolated();
     startStopEvent = epicsEventMustCreate(epicsEventEmpty);
     dbCaCtl = ctlPause;
+    dbCaStats = dbTaskStatsCreate("dbCaLink");
 
     epicsThreadCreate("dbCaLink", epicsThreadPriorityMedium,
         epicsThreadGetStackSize(epicsThreadStackBig),
@@ -910,6 +916,7 @@ static void dbCaTask(void *arg)
             caLink *pca;
             short  link_action;
             int    status;
+            epicsTimeStamp queued, begin;
 
             epicsMutexMustLock(workListLock);
             if (!(pca = (caLink *)ellGet(&workList))){  /* Take off list head */
@@ -919,12 +926,14 @@ static void dbCaTask(void *arg)
             }
             link_action = pca->link_action;
             pca->link_action = 0;
+            queued = pca->queued;
             if (link_action & CA_CLEAR_CHANNEL) --removesOutstanding;
             epicsMutexUnlock(workListLock);         /* Give back immediately */
+            dbTaskStatsStart(dbCaStats, &begin);
             if (link_action & CA_CLEAR_CHANNEL) {   /* This must be first */
                 dbCaLinkFree(pca);
                 /* No alarm is raised. Since link is changing so what? */
-                continue; /* No other link_action makes sense */
+                goto done; /* No other link_action makes sense */
             }
             if (link_action & CA_CONNECT) {
                 status = ca_create_channel(
@@ -934,7 +943,7 @@ static void dbCaTask(void *arg)
                     errlogPrintf("dbCaTask ca_create_channel %s\n",
                         ca_message(status));
                     printLinks(pca);
-                    continue;
+                    goto done;
                 }
                 dbca_chan_count++;
                 status = ca_replace_access_rights_event(pca->chid,
@@ -944,9 +953,9 @@ static void dbCaTask(void *arg)
                         ca_message(status));
                     printLinks(pca);
                 }
-                continue; /*Other options must wait until connect*/
+                goto done; /*Other options must wait until connect*/
             }
-            if (ca_state(pca->chid) != cs_conn) continue;
+            if (ca_state(pca->chid) != cs_conn) goto done;
             if (link_action & CA_WRITE_NATIVE) {
                 assert(pca->pputNative);
                 if (pca->putType == CA_PUT) {
@@ -1035,6 +1044,8 @@ static void dbCaTask(void *arg)
                     printLinks(pca);
                 }
             }
+done:
+            dbTaskStatsDone(dbCaStats, &begin, &queued);
         }
         SEVCHK(ca_flush_io(), "dbCaTask");
     }
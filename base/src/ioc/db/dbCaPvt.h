@@ -44,6 +44,7 @@ typedef struct caLink
         char		*pvname;
 	chid 		chid;
 	short		link_action;
+	epicsTimeStamp	queued;		/* when link_action was first set */
         /* The following have new values after each data event*/
 	epicsEnum16	sevr;
 	epicsEnum16	stat;
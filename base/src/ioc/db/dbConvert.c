@@ -63,6 +63,53 @@ static void copyNoConvert(const void *pfrom,
 #define COPYNOCONVERT(N, FROM, TO, NREQ, NO_ELEM, OFFSET) \
     copyNoConvert(FROM, TO, (N)*(NREQ), (N)*(NO_ELEM), (N)*(OFFSET))
 
+/* Helpers for numeric array conversion.
+ * The field array may wrap around at no_elements, so the elements are
+ * converted as (at most) two contiguous runs.  The run loops have no
+ * per-element wrap test, which allows the compiler to vectorize them.
+ * CVT is a cast or a conversion function applied to each element.
+ */
+#define CONVERT_RUN(PTO, PFROM, N, CVT) { \
+    long i_, n_ = (N); \
+    for (i_ = 0; i_ < n_; i_++) \
+        (PTO)[i_] = CVT((PFROM)[i_]); \
+}
+
+/* Inlinable fast path for epicsConvertDoubleToFloat(), values that are
+ * within the float range are just cast.  Only those that need clipping
+ * (and NaNs) are passed to the library routine.
+ */
+static float convertDoubleToFloat(double value)
+{
+    double abs = fabs(value);
+
+    if (abs < FLT_MAX && (abs > FLT_MIN || value == 0))
+        return (float) value;
+    return epicsConvertDoubleToFloat(value);
+}
+
+/* Get: psrc (at offset) is in the field, pbuffer is the user's buffer */
+#define GET_ARRAY(FIELD_TYPE, CVT) { \
+    long n1_ = no_elements - offset; \
+    if (n1_ > nRequest) n1_ = nRequest; \
+    CONVERT_RUN(pbuffer, psrc, n1_, CVT); \
+    if (nRequest > n1_) { \
+        psrc = (FIELD_TYPE *) paddr->pfield; \
+        CONVERT_RUN(pbuffer + n1_, psrc, nRequest - n1_, CVT); \
+    } \
+}
+
+/* Put: pbuffer is the user's buffer, pdest (at offset) is in the field */
+#define PUT_ARRAY(FIELD_TYPE, CVT) { \
+    long n1_ = no_elements - offset; \
+    if (n1_ > nRequest) n1_ = nRequest; \
+    CONVERT_RUN(pdest, pbuffer, n1_, CVT); \
+    if (nRequest > n1_) { \
+        pdest = (FIELD_TYPE *) paddr->pfield; \
+        CONVERT_RUN(pdest, pbuffer + n1_, nRequest - n1_, CVT); \
+    } \
+}
+
 /* DATABASE ACCESS GET CONVERSION SUPPORT */
 
 static long getStringString (
@@ -490,12 +537,7 @@ static long getCharShort(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (char *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(char, (epicsInt16));
     return 0;
 }
 
@@ -511,12 +553,7 @@ static long getCharUshort(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (char *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(char, (epicsUInt16));
     return 0;
 }
 
@@ -532,12 +569,7 @@ static long getCharLong(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (char *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(char, (epicsInt32));
     return 0;
 }
 
@@ -553,12 +585,7 @@ static long getCharUlong(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (char *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(char, (epicsUInt32));
     return 0;
 }
 
@@ -574,12 +601,7 @@ static long getCharFloat(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (char *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(char, (float));
     return 0;
 }
 
@@ -595,12 +617,7 @@ static long getCharDouble(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (char *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(char, (double));
     return 0;
 }
 
@@ -616,12 +633,7 @@ static long getCharEnum(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (char *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(char, (epicsEnum16));
     return 0;
 }
 
@@ -691,12 +703,7 @@ static long getUcharShort(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsUInt8 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsUInt8, (epicsInt16));
     return 0;
 }
 
@@ -712,12 +719,7 @@ static long getUcharUshort(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsUInt8 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsUInt8, (epicsUInt16));
     return 0;
 }
 
@@ -733,12 +735,7 @@ static long getUcharLong(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsUInt8 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsUInt8, (epicsInt32));
     return 0;
 }
 
@@ -754,12 +751,7 @@ static long getUcharUlong(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsUInt8 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsUInt8, (epicsUInt32));
     return 0;
 }
 
@@ -775,12 +767,7 @@ static long getUcharFloat(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsUInt8 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsUInt8, (float));
     return 0;
 }
 
@@ -796,12 +783,7 @@ static long getUcharDouble(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsUInt8 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsUInt8, (double));
     return 0;
 }
 
@@ -817,12 +799,7 @@ static long getUcharEnum(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsUInt8 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsUInt8, (epicsEnum16));
     return 0;
 }
 
@@ -862,12 +839,7 @@ static long getShortChar(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = (char)*psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsInt16 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsInt16, (char));
     return 0;
 }
 
@@ -883,12 +855,7 @@ static long getShortUchar(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = (epicsUInt8)*psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsInt16 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsInt16, (epicsUInt8));
     return 0;
 }
 
@@ -934,12 +901,7 @@ static long getShortLong(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsInt16 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsInt16, (epicsInt32));
     return 0;
 }
 
@@ -955,12 +917,7 @@ static long getShortUlong(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsInt16 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsInt16, (epicsUInt32));
     return 0;
 }
 
@@ -976,12 +933,7 @@ static long getShortFloat(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsInt16 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsInt16, (float));
     return 0;
 }
 
@@ -997,12 +949,7 @@ static long getShortDouble(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsInt16 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsInt16, (double));
     return 0;
 }
 
@@ -1018,12 +965,7 @@ static long getShortEnum(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsInt16 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsInt16, (epicsEnum16));
     return 0;
 }
 
@@ -1063,12 +1005,7 @@ static long getUshortChar(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = (char)*psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsUInt16 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsUInt16, (char));
     return 0;
 }
 
@@ -1084,12 +1021,7 @@ static long getUshortUchar(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = (epicsUInt8)*psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsUInt16 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsUInt16, (epicsUInt8));
     return 0;
 }
 static long getUshortShort(
@@ -1134,12 +1066,7 @@ static long getUshortLong(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsUInt16 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsUInt16, (epicsInt32));
     return 0;
 }
 
@@ -1155,12 +1082,7 @@ static long getUshortUlong(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsUInt16 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsUInt16, (epicsUInt32));
     return 0;
 }
 
@@ -1176,12 +1098,7 @@ static long getUshortFloat(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsUInt16 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsUInt16, (float));
     return 0;
 }
 
@@ -1197,12 +1114,7 @@ static long getUshortDouble(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsUInt16 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsUInt16, (double));
     return 0;
 }
 
@@ -1218,12 +1130,7 @@ static long getUshortEnum(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsUInt16 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsUInt16, (epicsEnum16));
     return 0;
 }
 
@@ -1263,12 +1170,7 @@ static long getLongChar(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsInt32 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsInt32, (char));
     return 0;
 }
 
@@ -1284,12 +1186,7 @@ static long getLongUchar(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsInt32 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsInt32, (epicsUInt8));
     return 0;
 }
 
@@ -1305,12 +1202,7 @@ static long getLongShort(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsInt32 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsInt32, (epicsInt16));
     return 0;
 }
 
@@ -1326,12 +1218,7 @@ static long getLongUshort(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsInt32 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsInt32, (epicsUInt16));
     return 0;
 }
 
@@ -1377,12 +1264,7 @@ static long getLongFloat(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = (float)*psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsInt32 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsInt32, (float));
     return 0;
 }
 
@@ -1398,12 +1280,7 @@ static long getLongDouble(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsInt32 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsInt32, (double));
     return 0;
 }
 
@@ -1419,12 +1296,7 @@ static long getLongEnum(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsInt32 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsInt32, (epicsEnum16));
     return 0;
 }
 
@@ -1464,12 +1336,7 @@ static long getUlongChar(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsUInt32 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsUInt32, (char));
     return 0;
 }
 
@@ -1485,12 +1352,7 @@ static long getUlongUchar(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsUInt32 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsUInt32, (epicsUInt8));
     return 0;
 }
 
@@ -1506,12 +1368,7 @@ static long getUlongShort(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsUInt32 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsUInt32, (epicsInt16));
     return 0;
 }
 
@@ -1527,12 +1384,7 @@ static long getUlongUshort(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsUInt32 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsUInt32, (epicsUInt16));
     return 0;
 }
 
@@ -1578,12 +1430,7 @@ static long getUlongFloat(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = (float)*psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsUInt32 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsUInt32, (float));
     return 0;
 }
 
@@ -1599,12 +1446,7 @@ static long getUlongDouble(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsUInt32 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsUInt32, (double));
     return 0;
 }
 
@@ -1620,12 +1462,7 @@ static long getUlongEnum(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsUInt32 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsUInt32, (epicsEnum16));
     return 0;
 }
 
@@ -1671,12 +1508,7 @@ static long getFloatChar(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = (char)*psrc++;
-        if (++offset == no_elements)
-            psrc = (float *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(float, (char));
     return 0;
 }
 
@@ -1692,12 +1524,7 @@ static long getFloatUchar(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = (epicsUInt8)*psrc++;
-        if (++offset == no_elements)
-            psrc = (float *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(float, (epicsUInt8));
     return 0;
 }
 
@@ -1713,12 +1540,7 @@ static long getFloatShort(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = (epicsInt16)*psrc++;
-        if (++offset == no_elements)
-            psrc = (float *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(float, (epicsInt16));
     return 0;
 }
 
@@ -1734,12 +1556,7 @@ static long getFloatUshort(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = (epicsUInt16)*psrc++;
-        if (++offset == no_elements)
-            psrc = (float *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(float, (epicsUInt16));
     return 0;
 }
 
@@ -1755,12 +1572,7 @@ static long getFloatLong(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = (epicsInt32)*psrc++;
-        if (++offset == no_elements)
-            psrc = (float *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(float, (epicsInt32));
     return 0;
 }
 
@@ -1776,12 +1588,7 @@ static long getFloatUlong(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = (epicsUInt32)*psrc++;
-        if (++offset == no_elements)
-            psrc = (float *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(float, (epicsUInt32));
     return 0;
 }
 
@@ -1812,12 +1619,7 @@ static long getFloatDouble(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (float *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(float, (double));
     return 0;
 }
 
@@ -1833,12 +1635,7 @@ static long getFloatEnum(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = (epicsEnum16)*psrc++;
-        if (++offset == no_elements)
-            psrc = (float *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(float, (epicsEnum16));
     return 0;
 }
 
@@ -1884,12 +1681,7 @@ static long getDoubleChar(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = (char)*psrc++;
-        if (++offset == no_elements)
-            psrc = (double *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(double, (char));
     return 0;
 }
 
@@ -1905,12 +1697,7 @@ static long getDoubleUchar(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = (epicsUInt8)*psrc++;
-        if (++offset == no_elements)
-            psrc = (double *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(double, (epicsUInt8));
     return 0;
 }
 
@@ -1926,12 +1713,7 @@ static long getDoubleShort(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = (epicsInt16)*psrc++;
-        if (++offset == no_elements)
-            psrc = (double *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(double, (epicsInt16));
     return 0;
 }
 
@@ -1947,12 +1729,7 @@ static long getDoubleUshort(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = (epicsUInt16)*psrc++;
-        if (++offset == no_elements)
-            psrc = (double *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(double, (epicsUInt16));
     return 0;
 }
 
@@ -1968,12 +1745,7 @@ static long getDoubleLong(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = (epicsInt32)*psrc++;
-        if (++offset == no_elements)
-            psrc = (double *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(double, (epicsInt32));
     return 0;
 }
 
@@ -1989,12 +1761,7 @@ static long getDoubleUlong(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = (epicsUInt32)*psrc++;
-        if (++offset == no_elements)
-            psrc = (double *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(double, (epicsUInt32));
     return 0;
 }
 
@@ -2010,13 +1777,7 @@ static long getDoubleFloat(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer = epicsConvertDoubleToFloat(*psrc);
-        ++psrc; ++pbuffer;
-        if (++offset == no_elements)
-            psrc = (double *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(double, convertDoubleToFloat);
     return 0;
 }
 
@@ -2047,12 +1808,7 @@ static long getDoubleEnum(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = (epicsEnum16)*psrc++;
-        if (++offset == no_elements)
-            psrc = (double *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(double, (epicsEnum16));
     return 0;
 }
 
@@ -2083,12 +1839,7 @@ static long getEnumChar(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = (char)*psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsEnum16 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsEnum16, (char));
     return 0;
 }
 
@@ -2104,12 +1855,7 @@ static long getEnumUchar(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = (epicsUInt8)*psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsEnum16 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsEnum16, (epicsUInt8));
     return 0;
 }
 
@@ -2125,12 +1871,7 @@ static long getEnumShort(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsEnum16 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsEnum16, (epicsInt16));
     return 0;
 }
 
@@ -2146,12 +1887,7 @@ static long getEnumUshort(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsEnum16 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsEnum16, (epicsUInt16));
     return 0;
 }
 
@@ -2167,12 +1903,7 @@ static long getEnumLong(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsEnum16 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsEnum16, (epicsInt32));
     return 0;
 }
 
@@ -2188,12 +1919,7 @@ static long getEnumUlong(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsEnum16 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsEnum16, (epicsUInt32));
     return 0;
 }
 
@@ -2209,12 +1935,7 @@ static long getEnumFloat(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsEnum16 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsEnum16, (float));
     return 0;
 }
 
@@ -2230,12 +1951,7 @@ static long getEnumDouble(
         return 0;
     }
     psrc += offset;
-    while (nRequest) {
-        *pbuffer++ = *psrc++;
-        if (++offset == no_elements)
-            psrc = (epicsEnum16 *) paddr->pfield;
-        nRequest--;
-    }
+    GET_ARRAY(epicsEnum16, (double));
     return 0;
 }
 
@@ -2782,12 +2498,7 @@ static long putCharShort(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsInt16 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsInt16, (epicsInt16));
     return 0;
 }
 
@@ -2803,12 +2514,7 @@ static long putCharUshort(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsUInt16 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsUInt16, (epicsUInt16));
     return 0;
 }
 
@@ -2824,12 +2530,7 @@ static long putCharLong(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsInt32 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsInt32, (epicsInt32));
     return 0;
 }
 
@@ -2845,12 +2546,7 @@ static long putCharUlong(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsUInt32 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsUInt32, (epicsUInt32));
     return 0;
 }
 
@@ -2866,12 +2562,7 @@ static long putCharFloat(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (float *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(float, (float));
     return 0;
 }
 
@@ -2887,12 +2578,7 @@ static long putCharDouble(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (double *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(double, (double));
     return 0;
 }
 
@@ -2908,12 +2594,7 @@ static long putCharEnum(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsEnum16 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsEnum16, (epicsEnum16));
     return 0;
 }
 
@@ -2985,12 +2666,7 @@ static long putUcharShort(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsInt16 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsInt16, (epicsInt16));
     return 0;
 }
 
@@ -3006,12 +2682,7 @@ static long putUcharUshort(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsUInt16 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsUInt16, (epicsUInt16));
     return 0;
 }
 
@@ -3027,12 +2698,7 @@ static long putUcharLong(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsInt32 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsInt32, (epicsInt32));
     return 0;
 }
 
@@ -3048,12 +2714,7 @@ static long putUcharUlong(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsUInt32 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsUInt32, (epicsUInt32));
     return 0;
 }
 
@@ -3069,12 +2730,7 @@ static long putUcharFloat(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (float *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(float, (float));
     return 0;
 }
 
@@ -3090,12 +2746,7 @@ static long putUcharDouble(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (double *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(double, (double));
     return 0;
 }
 
@@ -3111,12 +2762,7 @@ static long putUcharEnum(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsEnum16 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsEnum16, (epicsEnum16));
     return 0;
 }
 
@@ -3158,12 +2804,7 @@ static long putShortChar(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = (char) *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (char *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(char, (char));
     return 0;
 }
 
@@ -3179,12 +2820,7 @@ static long putShortUchar(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = (epicsUInt8) *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsUInt8 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsUInt8, (epicsUInt8));
     return 0;
 }
 
@@ -3230,12 +2866,7 @@ static long putShortLong(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsInt32 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsInt32, (epicsInt32));
     return 0;
 }
 
@@ -3251,12 +2882,7 @@ static long putShortUlong(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsUInt32 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsUInt32, (epicsUInt32));
     return 0;
 }
 
@@ -3272,12 +2898,7 @@ static long putShortFloat(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (float *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(float, (float));
     return 0;
 }
 
@@ -3293,12 +2914,7 @@ static long putShortDouble(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (double *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(double, (double));
     return 0;
 }
 
@@ -3314,12 +2930,7 @@ static long putShortEnum(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsEnum16 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsEnum16, (epicsEnum16));
     return 0;
 }
 
@@ -3361,12 +2972,7 @@ static long putUshortChar(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = (char) *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (char *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(char, (char));
     return 0;
 }
 
@@ -3382,12 +2988,7 @@ static long putUshortUchar(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = (epicsUInt8) *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsUInt8 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsUInt8, (epicsUInt8));
     return 0;
 }
 
@@ -3433,12 +3034,7 @@ static long putUshortLong(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsInt32 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsInt32, (epicsInt32));
     return 0;
 }
 
@@ -3454,12 +3050,7 @@ static long putUshortUlong(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsUInt32 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsUInt32, (epicsUInt32));
     return 0;
 }
 
@@ -3475,12 +3066,7 @@ static long putUshortFloat(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (float *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(float, (float));
     return 0;
 }
 
@@ -3496,12 +3082,7 @@ static long putUshortDouble(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (double *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(double, (double));
     return 0;
 }
 
@@ -3517,12 +3098,7 @@ static long putUshortEnum(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsEnum16 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsEnum16, (epicsEnum16));
     return 0;
 }
 
@@ -3564,12 +3140,7 @@ static long putLongChar(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (char *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(char, (char));
     return 0;
 }
 
@@ -3585,12 +3156,7 @@ static long putLongUchar(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsUInt8 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsUInt8, (epicsUInt8));
     return 0;
 }
 
@@ -3606,12 +3172,7 @@ static long putLongShort(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsInt16 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsInt16, (epicsInt16));
     return 0;
 }
 
@@ -3627,12 +3188,7 @@ static long putLongUshort(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsUInt16 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsUInt16, (epicsUInt16));
     return 0;
 }
 
@@ -3678,12 +3234,7 @@ static long putLongFloat(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = (float) *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (float *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(float, (float));
     return 0;
 }
 
@@ -3699,12 +3250,7 @@ static long putLongDouble(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (double *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(double, (double));
     return 0;
 }
 
@@ -3720,12 +3266,7 @@ static long putLongEnum(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsEnum16 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsEnum16, (epicsEnum16));
     return 0;
 }
 
@@ -3767,12 +3308,7 @@ static long putUlongChar(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (char *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(char, (char));
     return 0;
 }
 
@@ -3788,12 +3324,7 @@ static long putUlongUchar(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsUInt8 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsUInt8, (epicsUInt8));
     return 0;
 }
 
@@ -3809,12 +3340,7 @@ static long putUlongShort(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsInt16 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsInt16, (epicsInt16));
     return 0;
 }
 
@@ -3830,12 +3356,7 @@ static long putUlongUshort(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsUInt16 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsUInt16, (epicsUInt16));
     return 0;
 }
 
@@ -3881,12 +3402,7 @@ static long putUlongFloat(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = (float) *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (float *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(float, (float));
     return 0;
 }
 
@@ -3902,12 +3418,7 @@ static long putUlongDouble(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (double *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(double, (double));
     return 0;
 }
 
@@ -3923,12 +3434,7 @@ static long putUlongEnum(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsEnum16 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsEnum16, (epicsEnum16));
     return 0;
 }
 
@@ -3974,12 +3480,7 @@ static long putFloatChar(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = (char) *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (char *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(char, (char));
     return 0;
 }
 
@@ -3995,12 +3496,7 @@ static long putFloatUchar(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = (epicsUInt8) *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsUInt8 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsUInt8, (epicsUInt8));
     return 0;
 }
 
@@ -4016,12 +3512,7 @@ static long putFloatShort(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = (epicsInt16) *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsInt16 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsInt16, (epicsInt16));
     return 0;
 }
 
@@ -4037,12 +3528,7 @@ static long putFloatUshort(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = (epicsUInt16) *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsUInt16 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsUInt16, (epicsUInt16));
     return 0;
 }
 
@@ -4058,12 +3544,7 @@ static long putFloatLong(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = (epicsInt32) *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsInt32 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsInt32, (epicsInt32));
     return 0;
 }
 
@@ -4079,12 +3560,7 @@ static long putFloatUlong(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = (epicsUInt32) *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsUInt32 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsUInt32, (epicsUInt32));
     return 0;
 }
 
@@ -4115,12 +3591,7 @@ static long putFloatDouble(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (double *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(double, (double));
     return 0;
 }
 
@@ -4136,12 +3607,7 @@ static long putFloatEnum(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = (epicsEnum16) *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsEnum16 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsEnum16, (epicsEnum16));
     return 0;
 }
 
@@ -4187,12 +3653,7 @@ static long putDoubleChar(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = (char) *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (char *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(char, (char));
     return 0;
 }
 
@@ -4208,12 +3669,7 @@ static long putDoubleUchar(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = (epicsUInt8) *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsUInt8 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsUInt8, (epicsUInt8));
     return 0;
 }
 
@@ -4229,12 +3685,7 @@ static long putDoubleShort(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = (epicsInt16) *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsInt16 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsInt16, (epicsInt16));
     return 0;
 }
 
@@ -4250,12 +3701,7 @@ static long putDoubleUshort(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = (epicsUInt16) *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsUInt16 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsUInt16, (epicsUInt16));
     return 0;
 }
 
@@ -4271,12 +3717,7 @@ static long putDoubleLong(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = (epicsInt32) *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsInt32 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsInt32, (epicsInt32));
     return 0;
 }
 
@@ -4292,12 +3733,7 @@ static long putDoubleUlong(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = (epicsUInt32) *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsUInt32 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsUInt32, (epicsUInt32));
     return 0;
 }
 
@@ -4313,13 +3749,7 @@ static long putDoubleFloat(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest = epicsConvertDoubleToFloat(*pbuffer);
-        ++pbuffer; ++pdest;
-        if (++offset == no_elements)
-            pdest = (float *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(float, convertDoubleToFloat);
     return 0;
 }
 
@@ -4350,12 +3780,7 @@ static long putDoubleEnum(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = (epicsEnum16) *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsEnum16 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsEnum16, (epicsEnum16));
     return 0;
 }
 
@@ -4397,12 +3822,7 @@ static long putEnumChar(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = (char) *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (char *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(char, (char));
     return 0;
 }
 
@@ -4418,12 +3838,7 @@ static long putEnumUchar(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = (epicsUInt8) *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsUInt8 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsUInt8, (epicsUInt8));
     return 0;
 }
 
@@ -4439,12 +3854,7 @@ static long putEnumShort(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsInt16 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsInt16, (epicsInt16));
     return 0;
 }
 
@@ -4460,12 +3870,7 @@ static long putEnumUshort(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsUInt16 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsUInt16, (epicsUInt16));
     return 0;
 }
 
@@ -4481,12 +3886,7 @@ static long putEnumLong(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsInt32 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsInt32, (epicsInt32));
     return 0;
 }
 
@@ -4502,12 +3902,7 @@ static long putEnumUlong(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (epicsUInt32 *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(epicsUInt32, (epicsUInt32));
     return 0;
 }
 
@@ -4523,12 +3918,7 @@ static long putEnumFloat(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (float *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(float, (float));
     return 0;
 }
 
@@ -4544,12 +3934,7 @@ static long putEnumDouble(
         return 0;
     }
     pdest += offset;
-    while (nRequest) {
-        *pdest++ = *pbuffer++;
-        if (++offset == no_elements)
-            pdest = (double *) paddr->pfield;
-        nRequest--;
-    }
+    PUT_ARRAY(double, (double));
     return 0;
 }
 
@@ -21,6 +21,7 @@
 #include "dbScan.h"
 #include "dbServer.h"
 #include "dbState.h"
+#include "dbTaskStats.h"
 #include "db_test.h"
 #include "dbTest.h"
 
@@ -382,6 +383,35 @@ static void dbStateShowAllCallFunc (const iocshArgBuf *args)
     dbStateShowAll(args[0].ival);
 }
 
+/* dbTaskStatsShow */
+static const iocshArg dbTaskStatsArgName = { "name", iocshArgString };
+static const iocshArg dbTaskStatsArgLevel = { "level", iocshArgInt };
+static const iocshArg * const dbTaskStatsShowArgs[] = { &dbTaskStatsArgName, &dbTaskStatsArgLevel };
+static const iocshFuncDef dbTaskStatsShowFuncDef = { "dbTaskStatsShow", 2, dbTaskStatsShowArgs };
+static void dbTaskStatsShowCallFunc (const iocshArgBuf *args)
+{
+    dbTaskStatsId id = dbTaskStatsFind(args[0].sval);
+
+    if (id)
+        dbTaskStatsShow(id, args[1].ival);
+}
+
+/* dbTaskStatsShowAll */
+static const iocshArg * const dbTaskStatsShowAllArgs[] = { &dbTaskStatsArgLevel };
+static const iocshFuncDef dbTaskStatsShowAllFuncDef = { "dbTaskStatsShowAll", 1, dbTaskStatsShowAllArgs };
+static void dbTaskStatsShowAllCallFunc (const iocshArgBuf *args)
+{
+    dbTaskStatsShowAll(args[0].ival);
+}
+
+/* dbTaskStatsReset */
+static const iocshArg * const dbTaskStatsResetArgs[] = { &dbTaskStatsArgName };
+static const iocshFuncDef dbTaskStatsResetFuncDef = { "dbTaskStatsReset", 1, dbTaskStatsResetArgs };
+static void dbTaskStatsResetCallFunc (const iocshArgBuf *args)
+{
+    dbTaskStatsReset(dbTaskStatsFind(args[0].sval));
+}
+
 void dbIocRegister(void)
 {
     iocshRegister(&dbbFuncDef,dbbCallFunc);
@@ -438,4 +468,7 @@ void dbIocRegister(void)
     iocshRegister(&dbStateClearFuncDef, dbStateClearCallFunc);
     iocshRegister(&dbStateShowFuncDef, dbStateShowCallFunc);
     iocshRegister(&dbStateShowAllFuncDef, dbStateShowAllCallFunc);
+    iocshRegister(&dbTaskStatsShowFuncDef, dbTaskStatsShowCallFunc);
+    iocshRegister(&dbTaskStatsShowAllFuncDef, dbTaskStatsShowAllCallFunc);
+    iocshRegister(&dbTaskStatsResetFuncDef, dbTaskStatsResetCallFunc);
 }
@@ -47,6 +47,7 @@
 #include "dbLock.h"
 #include "dbScan.h"
 #include "dbStaticLib.h"
+#include "dbTaskStats.h"
 #include "devSup.h"
 #include "link.h"
 #include "recGbl.h"
@@ -66,6 +67,7 @@ static int onceQueueSize = 1000;
 static epicsEventId onceSem;
 static epicsRingPointerId onceQ;
 static epicsThreadId onceTaskId;
+static dbTaskStatsId onceStats;
 static void *exitOnce;
 
 
@@ -94,6 +96,7 @@ typedef struct periodic_scan_list {
     unsigned long       overruns;
     volatile enum ctl   scanCtl;
     epicsEventId        loopEvent;
+    dbTaskStatsId       stats;
 } periodic_scan_list;
 
 static int nPeriodic = 0;
@@ -644,8 +647,10 @@ void scanOnce(struct dbCommon *precord)
     if (!pushOK) {
         if (newOverflow) errlogPrintf("scanOnce: Ring buffer overflow\n");
         newOverflow = FALSE;
+        dbTaskStatsOverflow(onceStats);
     } else {
         newOverflow = TRUE;
+        dbTaskStatsQueued(onceStats);
     }
     epicsEventSignal(onceSem);
 }
@@ -660,10 +665,14 @@ static void onceTask(void *arg)
 
         epicsEventMustWait(onceSem);
         while ((precord = epicsRingPointerPop(onceQ))) {
+            epicsTimeStamp start;
+
             if (precord == &exitOnce) goto shutdown;
+            dbTaskStatsStart(onceStats, &start);
             dbScanLock(precord);
             dbProcess(precord);
             dbScanUnlock(precord);
+            dbTaskStatsDone(onceStats, &start, NULL);
         }
     }
 
@@ -685,6 +694,7 @@ static void initOnce(void)
     }
     if(!onceSem)
         onceSem = epicsEventMustCreate(epicsEventEmpty);
+    onceStats = dbTaskStatsCreate("scanOnce");
     onceTaskId = epicsThreadCreate("scanOnce",
         epicsThreadPriorityScanLow + nPeriodic,
         epicsThreadGetStackSize(epicsThreadStackBig), onceTask, 0);
@@ -713,8 +723,14 @@ static void periodicTask(void *arg)
         double delay;
         epicsTimeStamp now;
 
-        if (ppsl->scanCtl == ctlRun)
+        if (ppsl->scanCtl == ctlRun) {
+            epicsTimeStamp start;
+
+            /* Queueing time is how late the scan started */
+            dbTaskStatsStart(ppsl->stats, &start);
             scanList(&ppsl->scan_list);
+            dbTaskStatsDone(ppsl->stats, &start, &next);
+        }
 
         epicsTimeAddSeconds(&next, ppsl->period);
         epicsTimeGetCurrent(&now);
@@ -855,6 +871,7 @@ static void spawnPeriodic(int ind)
     if (!ppsl) return;
 
     sprintf(taskName, "scan-%g", ppsl->period);
+    ppsl->stats = dbTaskStatsCreate(taskName);
     periodicTaskId[ind] = epicsThreadCreate(
         taskName, epicsThreadPriorityScanLow + ind,
         epicsThreadGetStackSize(epicsThreadStackBig),
@@ -0,0 +1,281 @@
+/*************************************************************************\
+* EPICS BASE is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+/*
+ * Load statistics for IOC worker threads
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "cantProceed.h"
+#include "ellLib.h"
+#include "epicsAtomic.h"
+#include "epicsMutex.h"
+#include "epicsSpin.h"
+#include "epicsString.h"
+#include "epicsThread.h"
+
+#define epicsExportSharedSymbols
+#include "dbDefs.h"
+#include "dbTaskStats.h"
+#include "epicsExport.h"
+
+epicsShareDef int dbTaskStatsEnable = 1;
+epicsExportAddress(int, dbTaskStatsEnable);
+
+static ELLLIST taskStats = ELLLIST_INIT;
+static epicsMutexId taskStatsLock;
+static epicsThreadOnceId taskStatsOnce = EPICS_THREAD_ONCE_INIT;
+
+typedef struct dbTaskStats {
+    ELLNODE node;
+    char *name;
+    epicsTimeStamp created;
+    size_t queued;          /* epicsAtomic */
+    size_t overflows;       /* epicsAtomic */
+    epicsSpinId lock;       /* protects the rest */
+    size_t jobs;
+    size_t timed;
+    size_t waited;
+    size_t queueMax;
+    double busy;
+    double waitSum;
+    double execMax;
+    double waitMax;
+    size_t execHist[DBTS_HIST_BINS];
+    size_t waitHist[DBTS_HIST_BINS];
+} dbTaskStats;
+
+static void taskStatsInit(void *junk)
+{
+    taskStatsLock = epicsMutexMustCreate();
+}
+
+static dbTaskStatsId findLocked(const char *name)
+{
+    ELLNODE *node;
+
+    for (node = ellFirst(&taskStats); node; node = ellNext(node)) {
+        dbTaskStatsId id = CONTAINER(node, dbTaskStats, node);
+
+        if (strcmp(id->name, name) == 0)
+            return id;
+    }
+    return NULL;
+}
+
+dbTaskStatsId dbTaskStatsFind(const char *name)
+{
+    dbTaskStatsId id;
+
+    if (!name)
+        return NULL;
+
+    epicsThreadOnce(&taskStatsOnce, taskStatsInit, NULL);
+    epicsMutexMustLock(taskStatsLock);
+    id = findLocked(name);
+    epicsMutexUnlock(taskStatsLock);
+    return id;
+}
+
+dbTaskStatsId dbTaskStatsCreate(const char *name)
+{
+    dbTaskStatsId id;
+
+    if (!name || !*name)
+        return NULL;
+
+    epicsThreadOnce(&taskStatsOnce, taskStatsInit, NULL);
+    epicsMutexMustLock(taskStatsLock);
+    id = findLocked(name);
+    if (!id) {
+        id = callocMustSucceed(1, sizeof(dbTaskStats), "dbTaskStatsCreate");
+        id->name = epicsStrDup(name);
+        id->lock = epicsSpinMustCreate();
+        epicsTimeGetCurrent(&id->created);
+        ellAdd(&taskStats, &id->node);
+    }
+    epicsMutexUnlock(taskStatsLock);
+    return id;
+}
+
+void dbTaskStatsQueued(dbTaskStatsId id)
+{
+    if (id)
+        epicsAtomicIncrSizeT(&id->queued);
+}
+
+void dbTaskStatsOverflow(dbTaskStatsId id)
+{
+    if (id)
+        epicsAtomicIncrSizeT(&id->overflows);
+}
+
+void dbTaskStatsStart(dbTaskStatsId id, epicsTimeStamp *pstart)
+{
+    if (!id || !dbTaskStatsEnable ||
+        epicsTimeGetCurrent(pstart) != epicsTimeOK) {
+        pstart->secPastEpoch = 0;
+        pstart->nsec = 0;
+    }
+}
+
+static int histBin(double seconds)
+{
+    double limit = 1e-5;
+    int bin = 0;
+
+    while (bin < DBTS_HIST_BINS - 1 && seconds >= limit) {
+        limit *= 10;
+        bin++;
+    }
+    return bin;
+}
+
+void dbTaskStatsDone(dbTaskStatsId id, const epicsTimeStamp *pstart,
+    const epicsTimeStamp *pqueued)
+{
+    epicsTimeStamp now;
+    double exec = -1.0, wait = -1.0;
+    size_t queued;
+
+    if (!id)
+        return;
+
+    if (pstart->secPastEpoch &&
+        epicsTimeGetCurrent(&now) == epicsTimeOK) {
+        exec = epicsTimeDiffInSeconds(&now, pstart);
+        if (exec < 0.0)
+            exec = 0.0;
+        if (pqueued && pqueued->secPastEpoch) {
+            wait = epicsTimeDiffInSeconds(pstart, pqueued);
+            if (wait < 0.0)
+                wait = 0.0;
+        }
+    }
+    queued = epicsAtomicGetSizeT(&id->queued);
+
+    epicsSpinLock(id->lock);
+    /* Depth includes this job, which has not been counted yet */
+    if (queued > id->jobs && queued - id->jobs > id->queueMax)
+        id->queueMax = queued - id->jobs;
+    id->jobs++;
+    if (exec >= 0.0) {
+        id->timed++;
+        id->busy += exec;
+        if (exec > id->execMax)
+            id->execMax = exec;
+        id->execHist[histBin(exec)]++;
+    }
+    if (wait >= 0.0) {
+        id->waited++;
+        id->waitSum += wait;
+        if (wait > id->waitMax)
+            id->waitMax = wait;
+        id->waitHist[histBin(wait)]++;
+    }
+    epicsSpinUnlock(id->lock);
+}
+
+void dbTaskStatsGet(dbTaskStatsId id, dbTaskStatsInfo *pinfo)
+{
+    epicsTimeStamp now;
+
+    memset(pinfo, 0, sizeof(*pinfo));
+    if (!id)
+        return;
+
+    epicsTimeGetCurrent(&now);
+    pinfo->elapsed = epicsTimeDiffInSeconds(&now, &id->created);
+    pinfo->queued = epicsAtomicGetSizeT(&id->queued);
+    pinfo->overflows = epicsAtomicGetSizeT(&id->overflows);
+
+    epicsSpinLock(id->lock);
+    pinfo->busy = id->busy;
+    pinfo->waitSum = id->waitSum;
+    pinfo->execMax = id->execMax;
+    pinfo->waitMax = id->waitMax;
+    pinfo->jobs = id->jobs;
+    pinfo->timed = id->timed;
+    pinfo->waited = id->waited;
+    pinfo->queueMax = id->queueMax;
+    memcpy(pinfo->execHist, id->execHist, sizeof(pinfo->execHist));
+    memcpy(pinfo->waitHist, id->waitHist, sizeof(pinfo->waitHist));
+    epicsSpinUnlock(id->lock);
+
+    if (pinfo->queued > pinfo->jobs)
+        pinfo->queueDepth = pinfo->queued - pinfo->jobs;
+}
+
+void dbTaskStatsReset(dbTaskStatsId id)
+{
+    if (!id)
+        return;
+
+    epicsSpinLock(id->lock);
+    id->execMax = 0.0;
+    id->waitMax = 0.0;
+    id->queueMax = 0;
+    memset(id->execHist, 0, sizeof(id->execHist));
+    memset(id->waitHist, 0, sizeof(id->waitHist));
+    epicsSpinUnlock(id->lock);
+}
+
+static void showHist(const char *title, const size_t *hist)
+{
+    static const char * const binNames[DBTS_HIST_BINS] = {
+        "<10us", "<100us", "<1ms", "<10ms", "<100ms", "<1s", ">=1s"
+    };
+    int i;
+
+    printf("    %-5s", title);
+    for (i = 0; i < DBTS_HIST_BINS; i++)
+        printf(" %s:%lu", binNames[i], (unsigned long) hist[i]);
+    printf("\n");
+}
+
+void dbTaskStatsShow(dbTaskStatsId id, unsigned int level)
+{
+    dbTaskStatsInfo info;
+
+    if (!id)
+        return;
+
+    dbTaskStatsGet(id, &info);
+    printf("%-12s jobs %lu, load %.3f", id->name,
+        (unsigned long) info.jobs,
+        info.elapsed > 0.0 ? info.busy / info.elapsed : 0.0);
+    if (info.queued || info.overflows)
+        printf(", queue %lu (max %lu), overflows %lu",
+            (unsigned long) info.queueDepth, (unsigned long) info.queueMax,
+            (unsigned long) info.overflows);
+    printf("\n");
+    if (info.timed)
+        printf("    exec  mean %.1f us, max %.1f us\n",
+            info.busy / info.timed * 1e6, info.execMax * 1e6);
+    if (info.waited)
+        printf("    wait  mean %.1f us, max %.1f us\n",
+            info.waitSum / info.waited * 1e6, info.waitMax * 1e6);
+    if (level >= 1) {
+        if (info.timed)
+            showHist("exec", info.execHist);
+        if (info.waited)
+            showHist("wait", info.waitHist);
+    }
+}
+
+void dbTaskStatsShowAll(unsigned int level)
+{
+    ELLNODE *node;
+
+    epicsThreadOnce(&taskStatsOnce, taskStatsInit, NULL);
+    epicsMutexMustLock(taskStatsLock);
+    for (node = ellFirst(&taskStats); node; node = ellNext(node)) {
+        dbTaskStatsShow(CONTAINER(node, dbTaskStats, node), level);
+    }
+    epicsMutexUnlock(taskStatsLock);
+}
@@ -0,0 +1,129 @@
+/*************************************************************************\
+* EPICS BASE is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+#ifndef INCdbTaskStatsH
+#define INCdbTaskStatsH
+
+#include <stddef.h>
+
+#include "epicsTime.h"
+#include "shareLib.h"
+
+/** @file dbTaskStats.h
+ * @brief Load statistics for IOC worker threads
+ *
+ * The callback queues, the periodic scan threads, scanOnce, dbCaLink and
+ * the CA server client threads each keep a named set of counters: jobs
+ * done, time spent working, queue depth and histograms of job execution
+ * and queueing times. The values can be displayed with the IOC Shell
+ * commands below, or read into records with the "Task Stats" soft
+ * device support.
+ *
+ * Timing costs two reads of the current time per job. Setting the
+ * variable dbTaskStatsEnable to 0 turns that off; counts are still kept.
+ */
+
+typedef struct dbTaskStats *dbTaskStatsId;
+
+/** Histogram bins are decades: <10us, <100us, ... <1s, >=1s */
+#define DBTS_HIST_BINS 7
+
+/** @brief Snapshot of one set of statistics. Times are in seconds. */
+typedef struct dbTaskStatsInfo {
+    double elapsed;         /**< Since the statistics were created */
+    double busy;            /**< Total time spent running jobs */
+    double waitSum;         /**< Total time timed jobs spent queued */
+    double execMax;         /**< Longest job since last reset */
+    double waitMax;         /**< Longest queueing time since last reset */
+    size_t jobs;            /**< Jobs completed */
+    size_t timed;           /**< Jobs whose execution time was measured */
+    size_t waited;          /**< Jobs whose queueing time was measured */
+    size_t queued;          /**< Jobs added to the queue */
+    size_t queueDepth;      /**< Jobs queued or running now */
+    size_t queueMax;        /**< Highest queueDepth since last reset */
+    size_t overflows;       /**< Jobs rejected because the queue was full */
+    size_t execHist[DBTS_HIST_BINS];
+    size_t waitHist[DBTS_HIST_BINS];
+} dbTaskStatsInfo;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+epicsShareExtern int dbTaskStatsEnable;
+
+/** @brief Create task statistics.
+ *
+ * If statistics with that name already exist their id is returned.
+ *
+ * @param name Statistics name, normally the name of the thread(s).
+ * @return Id of the statistics, NULL for failure.
+ */
+epicsShareFunc dbTaskStatsId dbTaskStatsCreate(const char *name);
+
+/** @brief Find task statistics.
+ *
+ * @param name Statistics name.
+ * @return Id of the statistics, NULL if not found.
+ */
+epicsShareFunc dbTaskStatsId dbTaskStatsFind(const char *name);
+
+/** @brief Count a job added to the queue. May be called from an ISR.
+ */
+epicsShareFunc void dbTaskStatsQueued(dbTaskStatsId id);
+
+/** @brief Count a job rejected by a full queue. May be called from an ISR.
+ */
+epicsShareFunc void dbTaskStatsOverflow(dbTaskStatsId id);
+
+/** @brief Note the start of a job.
+ *
+ * @param id Statistics id.
+ * @param pstart Set to the start time, or zero if timing is disabled.
+ */
+epicsShareFunc void dbTaskStatsStart(dbTaskStatsId id,
+    epicsTimeStamp *pstart);
+
+/** @brief Count a finished job.
+ *
+ * @param id Statistics id.
+ * @param pstart Value from dbTaskStatsStart().
+ * @param pqueued Time the job was queued, or NULL if not known.
+ */
+epicsShareFunc void dbTaskStatsDone(dbTaskStatsId id,
+    const epicsTimeStamp *pstart, const epicsTimeStamp *pqueued);
+
+/** @brief Copy the current statistics.
+ */
+epicsShareFunc void dbTaskStatsGet(dbTaskStatsId id, dbTaskStatsInfo *pinfo);
+
+/** @brief Clear the maximum values and histograms.
+ *
+ * <em>Also provided as an IOC Shell command.</em>
+ */
+epicsShareFunc void dbTaskStatsReset(dbTaskStatsId id);
+
+/** @brief Print one set of statistics.
+ *
+ * <em>Also provided as an IOC Shell command.</em>
+ *
+ * @param id Statistics id.
+ * @param level Interest level, 1 adds the histograms.
+ */
+epicsShareFunc void dbTaskStatsShow(dbTaskStatsId id, unsigned int level);
+
+/** @brief Print all statistics.
+ *
+ * <em>Also provided as an IOC Shell command.</em>
+ *
+ * @param level Interest level.
+ */
+epicsShareFunc void dbTaskStatsShowAll(unsigned int level);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INCdbTaskStatsH */
@@ -5,12 +5,14 @@
 #include "string.h"
 
 #include "cantProceed.h"
+#include "dbAccessDefs.h"
 #include "dbAddr.h"
 #include "dbConvert.h"
 #include "dbDefs.h"
 #include "epicsTime.h"
 #include "epicsMath.h"
 #include "epicsAssert.h"
+#include "epicsTypes.h"
 
 #include "epicsUnitTest.h"
 #include "testMain.h"
@@ -18,8 +20,8 @@
 typedef struct {
     size_t nelem, niter;
 
-    short *output;
-    short *input;
+    void *output;
+    void *input;
 
     GETCONVERTFUNC getter;
 
@@ -36,32 +38,68 @@ static long runRep(testData *D)
     return 0;
 }
 
-static void runBench(size_t nelem, size_t niter, size_t nrep)
+/* The same values as the original SHORT benchmark, i, in the type of the field */
+static void fillInput(void *input, short dbf_type, size_t nelem)
+{
+    size_t i;
+
+    for(i=0; i<nelem; i++) {
+        switch(dbf_type) {
+        case DBF_UCHAR:  ((epicsUInt8 *)input)[i] = (epicsUInt8)i; break;
+        case DBF_SHORT:  ((epicsInt16 *)input)[i] = (epicsInt16)i; break;
+        case DBF_USHORT: ((epicsUInt16 *)input)[i] = (epicsUInt16)i; break;
+        case DBF_LONG:   ((epicsInt32 *)input)[i] = (epicsInt32)i; break;
+        case DBF_FLOAT:  ((epicsFloat32 *)input)[i] = (epicsFloat32)i; break;
+        case DBF_DOUBLE: ((epicsFloat64 *)input)[i] = (epicsFloat64)i; break;
+        default: return;
+        }
+    }
+}
+
+static const struct {
+    short dbf_type;
+    short dbr_type;
+    const char *name;
+} convPairs[] = {
+    {DBF_SHORT,  DBR_SHORT,  "SHORT->SHORT"},
+    {DBF_SHORT,  DBR_DOUBLE, "SHORT->DOUBLE"},
+    {DBF_USHORT, DBR_FLOAT,  "USHORT->FLOAT"},
+    {DBF_LONG,   DBR_DOUBLE, "LONG->DOUBLE"},
+    {DBF_FLOAT,  DBR_DOUBLE, "FLOAT->DOUBLE"},
+    {DBF_DOUBLE, DBR_FLOAT,  "DOUBLE->FLOAT"},
+    {DBF_DOUBLE, DBR_LONG,   "DOUBLE->LONG"},
+    {DBF_DOUBLE, DBR_SHORT,  "DOUBLE->SHORT"},
+    {DBF_UCHAR,  DBR_SHORT,  "UCHAR->SHORT"},
+};
+
+static void runBench(size_t nelem, size_t niter, size_t nrep,
+                     short dbf_type, short dbr_type)
 {
     size_t i;
     testData tdat;
     double *reptimes;
+    size_t insize = dbValueSize(dbf_type);
+    size_t outsize = dbValueSize(dbr_type);
     testDiag("Using %lu element arrays.",(unsigned long)nelem);
     testDiag("run %lu reps with %lu iterations each",
              (unsigned long)nrep, (unsigned long)niter);
 
     reptimes = callocMustSucceed(nrep, sizeof(*reptimes), "runBench");
-    tdat.output = callocMustSucceed(nelem, sizeof(*tdat.output), "runBench");
-    tdat.input = callocMustSucceed(nelem, sizeof(*tdat.input), "runBench");
+    tdat.output = callocMustSucceed(nelem, outsize, "runBench");
+    tdat.input = callocMustSucceed(nelem, insize, "runBench");
 
     tdat.nelem = nelem;
     tdat.niter = niter;
 
-    tdat.getter = dbGetConvertRoutine[DBF_SHORT][DBF_SHORT];
+    tdat.getter = dbGetConvertRoutine[dbf_type][dbr_type];
 
     memset(&tdat.addr, 0, sizeof(tdat.addr));
-    tdat.addr.field_type = DBF_SHORT;
-    tdat.addr.field_size = nelem*sizeof(*tdat.input);
+    tdat.addr.field_type = dbf_type;
+    tdat.addr.field_size = insize;
     tdat.addr.no_elements = nelem;
-    tdat.addr.pfield = (void*)tdat.input;
+    tdat.addr.pfield = tdat.input;
 
-    for(i=0; i<nelem; i++)
-        tdat.input[i] = (short)i;
+    fillInput(tdat.input, dbf_type, nelem);
 
     for(i=0; i<nrep; i++)
     {
@@ -83,9 +121,9 @@ static void runBench(size_t nelem, size_t niter, size_t nrep)
         reptimes[i] = epicsTimeDiffInSeconds(&stop, &start);
 
         testDiag("%lu bytes in %.03f ms.  %.1f MB/s",
-                 (unsigned long)(nelem*niter),
+                 (unsigned long)(nelem*niter*insize),
                  reptimes[i]*1e3,
-                 (nelem*niter)/reptimes[i]/1e6);
+                 (nelem*niter*insize)/reptimes[i]/1e6);
     }
 
     {
@@ -99,7 +137,7 @@ static void runBench(size_t nelem, size_t niter, size_t nrep)
         testDiag("Final: %.04f ms +- %.05f ms.  %.1f MB/s  (for %lu elements)",
                  mean*1e3,
                  sqrt(sum2/nrep - mean*mean)*1e3,
-                 (nelem*niter)/mean/1e6,
+                 (nelem*niter*insize)/mean/1e6,
                  (unsigned long)nelem);
     }
 
@@ -111,14 +149,21 @@ done:
 
 MAIN(benchdbConvert)
 {
+    size_t i;
+
     testPlan(0);
-    runBench(1, 10000000, 10);
-    runBench(2,  5000000, 10);
-    runBench(10, 1000000, 10);
-    runBench(100, 100000, 10);
-    runBench(10000, 1000, 10);
-    runBench(100000, 100, 10);
-    runBench(1000000, 10, 10);
-    runBench(10000000, 1, 10);
+    runBench(1, 10000000, 10, DBF_SHORT, DBR_SHORT);
+    runBench(2,  5000000, 10, DBF_SHORT, DBR_SHORT);
+    runBench(10, 1000000, 10, DBF_SHORT, DBR_SHORT);
+    runBench(100, 100000, 10, DBF_SHORT, DBR_SHORT);
+    runBench(10000, 1000, 10, DBF_SHORT, DBR_SHORT);
+    runBench(100000, 100, 10, DBF_SHORT, DBR_SHORT);
+    runBench(1000000, 10, 10, DBF_SHORT, DBR_SHORT);
+    runBench(10000000, 1, 10, DBF_SHORT, DBR_SHORT);
+
+    for(i=0; i<NELEMENTS(convPairs); i++) {
+        testDiag("Conversion %s", convPairs[i].name);
+        runBench(1000000, 10, 10, convPairs[i].dbf_type, convPairs[i].dbr_type);
+    }
     return testDone();
 }
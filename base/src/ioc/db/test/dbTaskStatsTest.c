@@ -0,0 +1,151 @@
+/*************************************************************************\
+* EPICS BASE is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+#include <string.h>
+
+#include "callback.h"
+#include "dbAccess.h"
+#include "dbTaskStats.h"
+#include "dbUnitTest.h"
+#include "epicsAtomic.h"
+#include "epicsEvent.h"
+#include "epicsThread.h"
+#include "errlog.h"
+#include "epicsUnitTest.h"
+#include "testMain.h"
+
+void dbTestIoc_registerRecordDeviceDriver(struct dbBase *);
+
+#define NCALLBACKS 10
+
+static int nDone;
+
+static void testApi(void)
+{
+    dbTaskStatsId red, red2;
+    dbTaskStatsInfo info;
+    epicsTimeStamp queued, start;
+    int i;
+
+    testDiag("dbTaskStats API");
+
+    testOk(!dbTaskStatsFind("red"), "Finding nonexisting stats fails");
+    testOk(!!(red = dbTaskStatsCreate("red")), "Create stats 'red'");
+    testOk((red2 = dbTaskStatsFind("red")) == red, "Find 'red' returns correct id");
+    testOk((red2 = dbTaskStatsCreate("red")) == red, "Create existing 'red' returns correct id");
+
+    dbTaskStatsStart(red, &queued);
+    for (i = 0; i < 3; i++)
+        dbTaskStatsQueued(red);
+    dbTaskStatsOverflow(red);
+    for (i = 0; i < 2; i++) {
+        dbTaskStatsStart(red, &start);
+        epicsThreadSleep(0.001);
+        dbTaskStatsDone(red, &start, &queued);
+    }
+
+    dbTaskStatsGet(red, &info);
+    testOk(info.jobs == 2 && info.timed == 2 && info.waited == 2,
+        "2 jobs timed (%lu, %lu, %lu)", (unsigned long) info.jobs,
+        (unsigned long) info.timed, (unsigned long) info.waited);
+    testOk(info.queued == 3 && info.queueDepth == 1 && info.queueMax == 3,
+        "queued 3, depth 1, max 3 (%lu, %lu, %lu)",
+        (unsigned long) info.queued, (unsigned long) info.queueDepth,
+        (unsigned long) info.queueMax);
+    testOk(info.overflows == 1, "1 overflow");
+    testOk(info.busy >= 0.002 && info.execMax >= 0.001 &&
+           info.busy >= info.execMax, "busy %.6f, execMax %.6f",
+           info.busy, info.execMax);
+    testOk(info.waitMax >= 0.001 && info.waitSum >= info.waitMax,
+        "waitSum %.6f, waitMax %.6f", info.waitSum, info.waitMax);
+    testOk(info.execHist[0] + info.execHist[1] + info.execHist[2] == 0 &&
+           info.execHist[3] + info.execHist[4] + info.execHist[5] +
+           info.execHist[6] == 2, "Both jobs in the >=1ms bins");
+
+    dbTaskStatsEnable = 0;
+    dbTaskStatsStart(red, &start);
+    dbTaskStatsDone(red, &start, NULL);
+    dbTaskStatsEnable = 1;
+    dbTaskStatsGet(red, &info);
+    testOk(info.jobs == 3 && info.timed == 2,
+        "Untimed job counted (%lu, %lu)", (unsigned long) info.jobs,
+        (unsigned long) info.timed);
+
+    dbTaskStatsReset(red);
+    dbTaskStatsGet(red, &info);
+    testOk(info.execMax == 0.0 && info.waitMax == 0.0 &&
+           info.queueMax == 0 && info.execHist[3] == 0 && info.jobs == 3,
+        "Reset clears maxima and histograms, not counts");
+}
+
+static void done(epicsCallback *pcb)
+{
+    epicsEventId ev;
+
+    callbackGetUser(ev, pcb);
+    if (epicsAtomicIncrIntT(&nDone) == NCALLBACKS)
+        epicsEventMustTrigger(ev);
+}
+
+static void testIoc(void)
+{
+    epicsCallback cb[NCALLBACKS];
+    dbTaskStatsInfo before, after;
+    epicsEventId ev = epicsEventMustCreate(epicsEventEmpty);
+    dbTaskStatsId low;
+    int i;
+
+    testDiag("IOC threads");
+
+    testdbPrepare();
+    testdbReadDatabase("dbTestIoc.dbd", NULL, NULL);
+    dbTestIoc_registerRecordDeviceDriver(pdbbase);
+    testdbReadDatabase("xRecord.db", NULL, NULL);
+
+    eltc(0);
+    testIocInitOk();
+    eltc(1);
+
+    testOk(!!(low = dbTaskStatsFind("cbLow")), "cbLow stats exist");
+    testOk(!!dbTaskStatsFind("cbHigh"), "cbHigh stats exist");
+    testOk(!!dbTaskStatsFind("scanOnce"), "scanOnce stats exist");
+    testOk(!!dbTaskStatsFind("scan-1"), "scan-1 stats exist");
+
+    dbTaskStatsGet(low, &before);
+    for (i = 0; i < NCALLBACKS; i++) {
+        callbackSetCallback(done, &cb[i]);
+        callbackSetPriority(priorityLow, &cb[i]);
+        callbackSetUser(ev, &cb[i]);
+        callbackRequest(&cb[i]);
+    }
+    epicsEventMustWait(ev);
+    /* The last callback may still be finishing */
+    epicsThreadSleep(0.1);
+    dbTaskStatsGet(low, &after);
+
+    testOk(after.jobs - before.jobs == NCALLBACKS,
+        "cbLow ran %d jobs (%lu)", NCALLBACKS,
+        (unsigned long) (after.jobs - before.jobs));
+    testOk(after.queued - before.queued == NCALLBACKS,
+        "cbLow queued %d jobs (%lu)", NCALLBACKS,
+        (unsigned long) (after.queued - before.queued));
+    testOk(after.queueDepth == 0, "cbLow queue is empty");
+
+    dbTaskStatsShowAll(1);
+
+    testIocShutdownOk();
+    testdbCleanup();
+    epicsEventDestroy(ev);
+}
+
+MAIN(dbTaskStatsTest)
+{
+    testPlan(19);
+
+    testApi();
+    testIoc();
+
+    return testDone();
+}
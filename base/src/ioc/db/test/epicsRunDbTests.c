@@ -20,6 +20,7 @@ int testdbConvert(void);
 int callbackTest(void);
 int callbackParallelTest(void);
 int dbStateTest(void);
+int dbTaskStatsTest(void);
 int dbCaStatsTest(void);
 int dbShutdownTest(void);
 int scanIoTest(void);
@@ -38,6 +39,7 @@ void epicsRunDbTests(void)
     runTest(callbackTest);
     runTest(callbackParallelTest);
     runTest(dbStateTest);
+    runTest(dbTaskStatsTest);
     runTest(dbCaStatsTest);
     runTest(dbShutdownTest);
     runTest(scanIoTest);
@@ -146,10 +146,72 @@ static void testBasicPut(void)
     free(scratch);
 }
 
+static void testConvertGetPut(void)
+{
+    double scratch[7];
+    short field[7];
+    DBADDR addr;
+    GETCONVERTFUNC getter;
+    PUTCONVERTFUNC putter;
+    int i, ok;
+
+    getter = dbGetConvertRoutine[DBF_SHORT][DBR_DOUBLE];
+    putter = dbPutConvertRoutine[DBR_DOUBLE][DBF_SHORT];
+
+    memset(&addr, 0, sizeof(addr));
+    addr.field_type = DBF_SHORT;
+    addr.field_size = sizeof(short);
+    addr.no_elements = s_input_len;
+    addr.pfield = (void*)s_input;
+
+    testDiag("Test dbGetConvertRoutine[DBF_SHORT][DBR_DOUBLE]");
+
+    {
+        testDiag("Convert out entire array");
+
+        getter(&addr, scratch, s_input_len, s_input_len, 0);
+
+        for (i = 0, ok = 1; i < s_input_len; i++)
+            ok &= scratch[i] == s_input[i];
+        testOk(ok, "all elements converted");
+    }
+
+    {
+        testDiag("Convert out with wrap");
+
+        memset(scratch, 0, sizeof(scratch));
+        getter(&addr, scratch, s_input_len, s_input_len, 3);
+
+        for (i = 0, ok = 1; i < s_input_len; i++)
+            ok &= scratch[i] == s_input[(i + 3) % s_input_len];
+        testOk(ok, "all elements converted in wrapped order");
+    }
+
+    testDiag("Test dbPutConvertRoutine[DBR_DOUBLE][DBF_SHORT]");
+
+    addr.pfield = (void*)field;
+
+    {
+        testDiag("Convert in with wrap");
+
+        for (i = 0; i < s_input_len; i++)
+            scratch[i] = s_input[i];
+        memset(field, 0x42, sizeof(field));
+        putter(&addr, scratch, 4, s_input_len, 5);
+
+        testOk1(field[5] == s_input[0]);
+        testOk1(field[6] == s_input[1]);
+        testOk1(field[0] == s_input[2]);
+        testOk1(field[1] == s_input[3]);
+        testOk1(field[2] == 0x4242);
+    }
+}
+
 MAIN(testdbConvert)
 {
-    testPlan(15);
+    testPlan(22);
     testBasicGet();
     testBasicPut();
+    testConvertGetPut();
     return testDone();
 }
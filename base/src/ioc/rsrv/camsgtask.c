@@ -49,6 +49,7 @@ void camsgtask ( void *pParm )
         osiSockIoctl_t check_nchars;
         long nchars;
         int status;
+        epicsTimeStamp start;
 
         /*
          * allow message to batch up if more are comming
@@ -114,7 +115,9 @@ void camsgtask ( void *pParm )
         epicsTimeGetCurrent ( &client->time_at_last_recv );
         client->recv.cnt += ( unsigned ) nchars;
 
+        dbTaskStatsStart ( rsrvClientStats, &start );
         status = camessage ( client );
+        dbTaskStatsDone ( rsrvClientStats, &start, NULL );
         if (status == 0) {
             /*
              * if there is a partial message
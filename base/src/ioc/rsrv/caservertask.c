@@ -469,6 +469,7 @@ int rsrv_init (void)
     epicsSignalInstallSigPipeIgnore ();
 
     rsrvCurrentClient = epicsThreadPrivateCreate ();
+    rsrvClientStats = dbTaskStatsCreate ( "CAS-client" );
 
     dbRegisterServer(&rsrv_server);
 
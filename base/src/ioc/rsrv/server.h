@@ -27,6 +27,7 @@
 #include "asLib.h"
 #include "dbChannel.h"
 #include "dbNotify.h"
+#include "dbTaskStats.h"
 #define CA_MINOR_PROTOCOL_REVISION 13
 #include "caProto.h"
 #include "ellLib.h"
@@ -205,6 +206,7 @@ GLBLTYPE void               *rsrvLargeBufFreeListTCP;
 GLBLTYPE unsigned           rsrvSizeofLargeBufTCP;
 GLBLTYPE void               *rsrvPutNotifyFreeList;
 GLBLTYPE unsigned           rsrvChannelCount; /* locked by clientQlock */
+GLBLTYPE dbTaskStatsId      rsrvClientStats;
 
 GLBLTYPE epicsEventId       casudp_startStopEvent;
 GLBLTYPE epicsEventId       beacon_startStopEvent;
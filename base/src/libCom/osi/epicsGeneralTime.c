@@ -14,8 +14,10 @@
 
 #define epicsExportSharedSymbols
 #include "epicsTypes.h"
+#include "epicsAtomic.h"
 #include "epicsEvent.h"
 #include "epicsMutex.h"
+#include "epicsSpin.h"
 #include "epicsMessageQueue.h"
 #include "epicsString.h"
 #include "epicsStdioRedirect.h"
@@ -57,14 +59,31 @@ typedef struct {
         TIMECURRENTFUN Time;
         TIMEEVENTFUN   Event;
     } getInt;
+    TIMECURRENTFUN getFast;
+    /* Statistics, calls is atomic, the rest protected by gtPvt.statsLock */
+    size_t  calls;
+    size_t  samples;
+    double  latencySum;
+    double  latencyMax;
 } gtProvider;
 
+/* Measure the latency of one provider call in every 2^N */
+#define LATENCY_SAMPLE_MASK 0x3ff
+
 static struct {
     epicsMutexId    timeListLock;
     ELLLIST         timeProviders;
-    gtProvider      *lastTimeProvider;
+    EpicsAtomicPtrT lastTimeProvider;   /* gtProvider * */
+
+    /* Last current time, see ratchetCurrent() */
+    size_t          lastPackedTime;
+    epicsSpinId     ratchetLock;
     epicsTimeStamp  lastProvidedTime;
 
+    epicsSpinId     statsLock;
+    EpicsAtomicPtrT fastTimeProvider;   /* gtProvider * */
+    EpicsAtomicPtrT latencyProvider;    /* gtProvider *, using getFast */
+
     epicsMutexId    eventListLock;
     ELLLIST         eventProviders;
     gtProvider      *lastEventProvider;
@@ -88,6 +107,9 @@ static void generalTime_InitOnce(void *dummy)
     ellInit(&gtPvt.eventProviders);
     gtPvt.eventListLock = epicsMutexMustCreate();
 
+    gtPvt.ratchetLock = epicsSpinMustCreate();
+    gtPvt.statsLock = epicsSpinMustCreate();
+
     IFDEBUG(1)
         printf("General Time Initialized\n");
 }
@@ -142,52 +164,178 @@ int generalTimeGetExceptPriority(epicsTimeStamp *pDest, int *pPrio, int ignore)
     return status;
 }
 
+/* Provider pointers read by the current time paths without a lock */
+
+#define getProvider(field) ((gtProvider *) epicsAtomicGetPtrT(&gtPvt.field))
+#define setProvider(field, ptp) epicsAtomicSetPtrT(&gtPvt.field, (ptp))
+
+/* Provider Statistics
+ *
+ * Every provider call is counted atomically, and one call in every
+ * LATENCY_SAMPLE_MASK+1 is timed against the fast OS clock; only those
+ * samples take the statsLock. The read of ptp->calls just picks which calls
+ * get timed, so a race there is harmless.
+ */
+
+static int latencyStart(gtProvider *ptp, epicsTimeStamp *pStart)
+{
+    gtProvider *pclock = getProvider(latencyProvider);
+
+    return pclock &&
+        !(epicsAtomicGetSizeT(&ptp->calls) & LATENCY_SAMPLE_MASK) &&
+        pclock->getFast(pStart) == epicsTimeOK;
+}
+
+static double latencyEnd(int sampling, const epicsTimeStamp *pStart)
+{
+    epicsTimeStamp stop;
+
+    if (!sampling ||
+        getProvider(latencyProvider)->getFast(&stop) != epicsTimeOK)
+        return -1.0;
+    return epicsTimeDiffInSeconds(&stop, pStart);
+}
+
+static void updateStats(gtProvider *ptp, double latency)
+{
+    epicsAtomicIncrSizeT(&ptp->calls);
+    if (latency >= 0.0) {
+        epicsSpinLock(gtPvt.statsLock);
+        ptp->samples++;
+        ptp->latencySum += latency;
+        if (latency > ptp->latencyMax)
+            ptp->latencyMax = latency;
+        epicsSpinUnlock(gtPvt.statsLock);
+    }
+}
+
+/* Current Time Ratchet
+ *
+ * Where size_t is 64 bits wide the last time provided is packed into one
+ * word, seconds above nanoseconds so the packed values sort in time order,
+ * and is advanced with compare-and-swap. Narrower targets fall back to
+ * gtPvt.lastProvidedTime under the ratchetLock.
+ */
+
+#define PACKED_RATCHET (sizeof(size_t) >= 8)
+
+static size_t packTime(const epicsTimeStamp *pts)
+{
+    /* Shifted in two steps to stay defined where size_t is 32 bits */
+    return ((size_t) pts->secPastEpoch << 16 << 16) | pts->nsec;
+}
+
+static void unpackTime(size_t packed, epicsTimeStamp *pts)
+{
+    pts->secPastEpoch = (epicsUInt32) (packed >> 16 >> 16);
+    pts->nsec = (epicsUInt32) (packed & 0xffffffffu);
+}
+
+/* Returns non-zero if *pts was older than the last time provided,
+ * in which case that is returned in *pDest instead.
+ */
+static int advanceLastTime(const epicsTimeStamp *pts, epicsTimeStamp *pDest)
+{
+    int backwards = 1;
+
+    if (PACKED_RATCHET) {
+        size_t now = packTime(pts);
+        size_t last = epicsAtomicGetSizeT(&gtPvt.lastPackedTime);
+
+        while (backwards && now >= last) {
+            size_t prev = epicsAtomicCmpAndSwapSizeT(&gtPvt.lastPackedTime,
+                last, now);
+
+            backwards = (prev != last);
+            last = prev;
+        }
+        if (backwards)
+            unpackTime(last, pDest);
+    }
+    else {
+        epicsSpinLock(gtPvt.ratchetLock);
+        backwards = !epicsTimeGreaterThanEqual(pts, &gtPvt.lastProvidedTime);
+        if (backwards)
+            *pDest = gtPvt.lastProvidedTime;
+        else
+            gtPvt.lastProvidedTime = *pts;
+        epicsSpinUnlock(gtPvt.ratchetLock);
+    }
+    return backwards;
+}
+
+static int ratchetCurrent(gtProvider *ptp, const epicsTimeStamp *pts,
+    epicsTimeStamp *pDest)
+{
+    int key;
+
+    if (advanceLastTime(pts, pDest)) {
+        key = epicsInterruptLock();
+        gtPvt.ErrorCounts++;
+        epicsInterruptUnlock(key);
+        return 1;
+    }
+
+    *pDest = *pts;
+    /* Avoid dirtying the shared cache line on every call */
+    if (getProvider(lastTimeProvider) != ptp)
+        setProvider(lastTimeProvider, ptp);
+    return 0;
+}
+
 int epicsShareAPI epicsTimeGetCurrent(epicsTimeStamp *pDest)
 {
     gtProvider *ptp;
     int status = epicsTimeERROR;
-    epicsTimeStamp ts;
+    int backwards = 0;
+    int sampling;
+    epicsTimeStamp ts, start;
 
     generalTime_Init();
 
     IFDEBUG(20)
         printf("epicsTimeGetCurrent()\n");
 
-    epicsMutexMustLock(gtPvt.timeListLock);
-    for (ptp = (gtProvider *)ellFirst(&gtPvt.timeProviders);
-         ptp; ptp = (gtProvider *)ellNext(&ptp->node)) {
+    /* Fast path: the highest priority provider can be called without
+     * taking any lock.
+     */
+    ptp = getProvider(fastTimeProvider);
+    if (ptp) {
+        sampling = latencyStart(ptp, &start);
+        status = ptp->getFast(&ts);
+        updateStats(ptp, latencyEnd(sampling, &start));
+        if (status == epicsTimeOK)
+            backwards = ratchetCurrent(ptp, &ts, pDest);
+    }
 
-        status = ptp->get.Time(&ts);
-        if (status == epicsTimeOK) {
-            /* check time is monotonic */
-            if (epicsTimeGreaterThanEqual(&ts, &gtPvt.lastProvidedTime)) {
-                *pDest = ts;
-                gtPvt.lastProvidedTime = ts;
-                gtPvt.lastTimeProvider = ptp;
-            } else {
-                int key;
+    if (status != epicsTimeOK) {
+        epicsMutexMustLock(gtPvt.timeListLock);
+        for (ptp = (gtProvider *)ellFirst(&gtPvt.timeProviders);
+             ptp; ptp = (gtProvider *)ellNext(&ptp->node)) {
 
-                *pDest = gtPvt.lastProvidedTime;
-                key = epicsInterruptLock();
-                gtPvt.ErrorCounts++;
-                epicsInterruptUnlock(key);
+            sampling = latencyStart(ptp, &start);
+            status = ptp->get.Time(&ts);
+            updateStats(ptp, latencyEnd(sampling, &start));
+            if (status == epicsTimeOK) {
+                backwards = ratchetCurrent(ptp, &ts, pDest);
+                break;
+            }
+        }
+        if (status == epicsTimeERROR)
+            setProvider(lastTimeProvider, NULL);
+        epicsMutexUnlock(gtPvt.timeListLock);
+    }
 
-                IFDEBUG(10) {
-                    char last[40], buff[40];
+    IFDEBUG(10) {
+        if (backwards) {
+            char last[40], buff[40];
 
-                    epicsTimeToStrftime(last, sizeof(last), tsfmt,
-                        &gtPvt.lastProvidedTime);
-                    epicsTimeToStrftime(buff, sizeof(buff), tsfmt, &ts);
-                    printf("eTGC provider '%s' returned older time\n"
-                        "    %s, using %s instead\n", ptp->name, buff, last);
-                }
-            }
-            break;
+            epicsTimeToStrftime(last, sizeof(last), tsfmt, pDest);
+            epicsTimeToStrftime(buff, sizeof(buff), tsfmt, &ts);
+            printf("eTGC provider '%s' returned older time\n"
+                "    %s, using %s instead\n", ptp->name, buff, last);
         }
     }
-    if (status == epicsTimeERROR)
-        gtPvt.lastTimeProvider = NULL;
-    epicsMutexUnlock(gtPvt.timeListLock);
 
     IFDEBUG(20) {
         if (ptp && status == epicsTimeOK) {
@@ -206,7 +354,7 @@ int epicsShareAPI epicsTimeGetCurrent(epicsTimeStamp *pDest)
 
 int epicsTimeGetCurrentInt(epicsTimeStamp *pDest)
 {
-    gtProvider *ptp = gtPvt.lastTimeProvider;
+    gtProvider *ptp = getProvider(lastTimeProvider);
 
     if (ptp == NULL ||
         ptp->getInt.Time == NULL) {
@@ -224,7 +372,8 @@ static int generalTimeGetEventPriority(epicsTimeStamp *pDest, int eventNumber,
 {
     gtProvider *ptp;
     int status = epicsTimeERROR;
-    epicsTimeStamp ts;
+    int sampling;
+    epicsTimeStamp ts, start;
 
     generalTime_Init();
 
@@ -239,7 +388,9 @@ static int generalTimeGetEventPriority(epicsTimeStamp *pDest, int eventNumber,
     for (ptp = (gtProvider *)ellFirst(&gtPvt.eventProviders);
          ptp; ptp = (gtProvider *)ellNext(&ptp->node)) {
 
+        sampling = latencyStart(ptp, &start);
         status = ptp->get.Event(&ts, eventNumber);
+        updateStats(ptp, latencyEnd(sampling, &start));
         if (status == epicsTimeOK) {
             gtPvt.lastEventProvider = ptp;
             if (pPrio)
@@ -369,6 +520,19 @@ static void insertProvider(gtProvider *ptp, ELLLIST *plist, epicsMutexId lock)
     epicsMutexUnlock(lock);
 }
 
+/* The fast path is only used while the highest priority current time
+ * provider is one that registered a fast routine.
+ */
+static void updateFastProvider(void)
+{
+    gtProvider *ptp;
+
+    epicsMutexMustLock(gtPvt.timeListLock);
+    ptp = (gtProvider *)ellFirst(&gtPvt.timeProviders);
+    setProvider(fastTimeProvider, (ptp && ptp->getFast) ? ptp : NULL);
+    epicsMutexUnlock(gtPvt.timeListLock);
+}
+
 static gtProvider * findProvider(ELLLIST *plist, epicsMutexId lock,
     const char *name, int priority)
 {
@@ -405,6 +569,11 @@ int generalTimeRegisterEventProvider(const char *name, int priority,
     ptp->priority     = priority;
     ptp->get.Event    = getEvent;
     ptp->getInt.Event = NULL;
+    ptp->getFast      = NULL;
+    ptp->calls        = 0;
+    ptp->samples      = 0;
+    ptp->latencySum   = 0.0;
+    ptp->latencyMax   = 0.0;
 
     insertProvider(ptp, &gtPvt.eventProviders, gtPvt.eventListLock);
 
@@ -448,8 +617,14 @@ int generalTimeRegisterCurrentProvider(const char *name, int priority,
     ptp->priority    = priority;
     ptp->get.Time    = getTime;
     ptp->getInt.Time = NULL;
+    ptp->getFast     = NULL;
+    ptp->calls       = 0;
+    ptp->samples     = 0;
+    ptp->latencySum  = 0.0;
+    ptp->latencyMax  = 0.0;
 
     insertProvider(ptp, &gtPvt.timeProviders, gtPvt.timeListLock);
+    updateFastProvider();
 
     IFDEBUG(1)
         printf("Registered time provider '%s' at %d\n", name, priority);
@@ -473,6 +648,27 @@ int generalTimeAddIntCurrentProvider(const char *name, int priority,
     return epicsTimeOK;
 }
 
+int generalTimeAddFastCurrentProvider(const char *name, int priority,
+    TIMECURRENTFUN getTime)
+{
+    gtProvider *ptp = findProvider(&gtPvt.timeProviders, gtPvt.timeListLock,
+        name, priority);
+    if (ptp == NULL)
+        return epicsTimeERROR;
+
+    epicsMutexMustLock(gtPvt.timeListLock);
+    ptp->getFast = getTime;
+    if (!getProvider(latencyProvider))
+        setProvider(latencyProvider, ptp);
+    epicsMutexUnlock(gtPvt.timeListLock);
+    updateFastProvider();
+
+    IFDEBUG(1)
+        printf("Time provider '%s' is lock-free callable\n", name);
+
+    return epicsTimeOK;
+}
+
 /* 
  * Provide an optional "last resort" provider for Event Time.
  * 
@@ -499,6 +695,16 @@ int installLastResortEventProvider(void)
 
 /* Status Report */
 
+static int reportStats(char *pout, const gtProvider *ptp)
+{
+    if (!ptp->samples)
+        return sprintf(pout, "\tCalls = %lu\n", (unsigned long) ptp->calls);
+
+    return sprintf(pout, "\tCalls = %lu, latency mean %.3f us, "
+        "max %.3f us\n", (unsigned long) ptp->calls,
+        ptp->latencySum / ptp->samples * 1e6, ptp->latencyMax * 1e6);
+}
+
 long generalTimeReport(int level)
 {
     int items;
@@ -520,7 +726,7 @@ long generalTimeReport(int level)
         char *message;     /* Temporary output buffer */
         char *pout;
 
-        message = calloc(items, 80 * 2); /* Each provider needs 2 lines */
+        message = calloc(items, 80 * 3); /* Each provider needs 3 lines */
         if (!message) {
             epicsMutexUnlock(gtPvt.timeListLock);
             printf("Out of memory\n");
@@ -531,8 +737,17 @@ long generalTimeReport(int level)
 
         for (ptp = (gtProvider *)ellFirst(&gtPvt.timeProviders);
              ptp; ptp = (gtProvider *)ellNext(&ptp->node)) {
-            pout += sprintf(pout, "    \"%s\", priority = %d\n",
-                ptp->name, ptp->priority);
+            gtProvider stats;
+
+            epicsSpinLock(gtPvt.statsLock);
+            stats = *ptp;
+            epicsSpinUnlock(gtPvt.statsLock);
+            stats.calls = epicsAtomicGetSizeT(&ptp->calls);
+
+            pout += sprintf(pout, "    \"%s\", priority = %d%s\n",
+                ptp->name, ptp->priority,
+                ptp == getProvider(fastTimeProvider) ? ", fast path" : "");
+            pout += reportStats(pout, &stats);
             if (level) {
                 epicsTimeStamp tempTS;
                 if (ptp->get.Time(&tempTS) != epicsTimeERROR) {
@@ -562,7 +777,7 @@ long generalTimeReport(int level)
         char *message;     /* Temporary output buffer */
         char *pout;
 
-        message = calloc(items, 80);     /* Each provider needs 1 line, */
+        message = calloc(items, 80 * 2); /* Each provider needs 2 lines */
         if (!message) {
             epicsMutexUnlock(gtPvt.eventListLock);
             printf("Out of memory\n");
@@ -575,6 +790,7 @@ long generalTimeReport(int level)
              ptp; ptp = (gtProvider *)ellNext(&ptp->node)) {
             pout += sprintf(pout, "    \"%s\", priority = %d\n",
                 ptp->name, ptp->priority);
+            pout += reportStats(pout, ptp);
         }
         epicsMutexUnlock(gtPvt.eventListLock);
         puts(message);
@@ -610,9 +826,33 @@ int generalTimeGetErrorCounts(void)
 
 const char * generalTimeCurrentProviderName(void)
 {
-    if (gtPvt.lastTimeProvider)
-        return gtPvt.lastTimeProvider->name;
-    return NULL;
+    gtProvider *ptp = getProvider(lastTimeProvider);
+
+    return ptp ? ptp->name : NULL;
+}
+
+int generalTimeCurrentProviderStats(const char *name, size_t *pCalls,
+    double *pMeanLatency, double *pMaxLatency)
+{
+    gtProvider *ptp;
+    int status = epicsTimeERROR;
+
+    epicsMutexMustLock(gtPvt.timeListLock);
+    for (ptp = (gtProvider *)ellFirst(&gtPvt.timeProviders);
+         ptp; ptp = (gtProvider *)ellNext(&ptp->node)) {
+        if (strcmp(name, ptp->name) == 0) {
+            *pCalls = epicsAtomicGetSizeT(&ptp->calls);
+            epicsSpinLock(gtPvt.statsLock);
+            *pMeanLatency = ptp->samples ?
+                ptp->latencySum / ptp->samples : 0.0;
+            *pMaxLatency = ptp->latencyMax;
+            epicsSpinUnlock(gtPvt.statsLock);
+            status = epicsTimeOK;
+            break;
+        }
+    }
+    epicsMutexUnlock(gtPvt.timeListLock);
+    return status;
 }
 
 const char * generalTimeEventProviderName(void)
@@ -10,6 +10,8 @@
 #ifndef INC_epicsGeneralTime_H
 #define INC_epicsGeneralTime_H
 
+#include <stddef.h>
+
 #include "shareLib.h"
 
 #ifdef __cplusplus
@@ -30,6 +32,10 @@ epicsShareFunc const char * generalTimeCurrentProviderName(void);
 epicsShareFunc const char * generalTimeEventProviderName(void);
 epicsShareFunc const char * generalTimeHighestCurrentName(void);
 
+/* Call count and sampled latency (in seconds) of a current time provider */
+epicsShareFunc int generalTimeCurrentProviderStats(const char *name,
+    size_t *pCalls, double *pMeanLatency, double *pMaxLatency);
+
 /* Original names, for compatibility */
 #define generalTimeCurrentTpName generalTimeCurrentProviderName
 #define generalTimeEventTpName generalTimeEventProviderName
@@ -37,6 +37,13 @@ epicsShareFunc int generalTimeAddIntCurrentProvider(const char *name,
 epicsShareFunc int generalTimeAddIntEventProvider(const char *name,
     int priority, TIMEEVENTFUN getEvent);
 
+/* Register a routine that can be called without holding any generalTime
+ * locks. While this is the highest priority current time provider,
+ * epicsTimeGetCurrent() calls it directly instead of searching the list.
+ */
+epicsShareFunc int generalTimeAddFastCurrentProvider(const char *name,
+    int priority, TIMECURRENTFUN getTime);
+
 epicsShareFunc int generalTimeGetExceptPriority(epicsTimeStamp *pDest,
     int *pPrio, int ignorePrio);
 
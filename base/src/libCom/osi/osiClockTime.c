@@ -91,6 +91,8 @@ static void ClockTime_InitOnce(void *pfirst)
     /* Register as a time provider */
     generalTimeRegisterCurrentProvider("OS Clock", LAST_RESORT_PRIORITY,
         ClockTimeGetCurrent);
+    generalTimeAddFastCurrentProvider("OS Clock", LAST_RESORT_PRIORITY,
+        ClockTimeGetCurrent);
 }
 
 void ClockTime_Init(int synchronize)
@@ -0,0 +1,199 @@
+/*************************************************************************\
+* EPICS BASE is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+/*
+ * Checks that epicsTimeGetCurrent() stays monotonic when called from
+ * several threads at once, and measures its cost. A test provider checks
+ * the lock-free fast path and the provider statistics.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "epicsAtomic.h"
+#include "epicsEvent.h"
+#include "epicsThread.h"
+#include "epicsTime.h"
+#include "epicsGeneralTime.h"
+#include "generalTimeSup.h"
+#include "epicsUnitTest.h"
+#include "testMain.h"
+
+#define NTHREADS 4
+#define NCALLS 200000
+
+typedef struct {
+    epicsEventId done;
+    unsigned long backwards;
+    unsigned long errors;
+} threadInfo;
+
+static void getTimes(void *arg)
+{
+    threadInfo *pinfo = (threadInfo *) arg;
+    epicsTimeStamp last = {0, 0}, now;
+    int i;
+
+    for (i = 0; i < NCALLS; i++) {
+        if (epicsTimeGetCurrent(&now) != epicsTimeOK) {
+            pinfo->errors++;
+            continue;
+        }
+        if (epicsTimeLessThan(&now, &last))
+            pinfo->backwards++;
+        last = now;
+    }
+    epicsEventSignal(pinfo->done);
+}
+
+static void runThreads(void)
+{
+    threadInfo info[NTHREADS];
+    int i;
+
+    for (i = 0; i < NTHREADS; i++) {
+        info[i].done = epicsEventMustCreate(epicsEventEmpty);
+        info[i].backwards = 0;
+        info[i].errors = 0;
+        epicsThreadMustCreate("getTimes", epicsThreadPriorityMedium,
+            epicsThreadGetStackSize(epicsThreadStackSmall),
+            getTimes, &info[i]);
+    }
+    for (i = 0; i < NTHREADS; i++) {
+        epicsEventMustWait(info[i].done);
+        epicsEventDestroy(info[i].done);
+        testOk(!info[i].backwards && !info[i].errors,
+            "Thread %d: %lu backwards, %lu errors", i,
+            info[i].backwards, info[i].errors);
+    }
+}
+
+/* Test provider, ticks 1 ns per call from testBase */
+
+#define TEST_CLOCK "Test Clock"
+#define TEST_CALLS 1000
+
+static epicsTimeStamp testBase;
+static size_t testTicks;
+static size_t fastCalls, slowCalls;
+static int fastFails;
+
+static void testTime(epicsTimeStamp *pDest)
+{
+    *pDest = testBase;
+    epicsTimeAddSeconds(pDest, epicsAtomicIncrSizeT(&testTicks) * 1e-9);
+}
+
+static int testGetFast(epicsTimeStamp *pDest)
+{
+    epicsAtomicIncrSizeT(&fastCalls);
+    if (fastFails)
+        return epicsTimeERROR;
+    testTime(pDest);
+    return epicsTimeOK;
+}
+
+static int testGetSlow(epicsTimeStamp *pDest)
+{
+    epicsAtomicIncrSizeT(&slowCalls);
+    testTime(pDest);
+    return epicsTimeOK;
+}
+
+static void testFastProvider(void)
+{
+    epicsTimeStamp ts, last;
+    const char *name;
+    size_t calls;
+    double mean, max;
+    int errors, i;
+
+    testDiag("Fast current time provider");
+
+    epicsTimeGetCurrent(&testBase);
+    epicsTimeAddSeconds(&testBase, 1000.0);
+    generalTimeRegisterCurrentProvider(TEST_CLOCK, 10, testGetSlow);
+    generalTimeAddFastCurrentProvider(TEST_CLOCK, 10, testGetFast);
+    name = generalTimeHighestCurrentName();
+    testOk(name && strcmp(name, TEST_CLOCK) == 0,
+        "Highest current time provider is \"%s\"", name ? name : "(none)");
+
+    for (i = 0; i < TEST_CALLS; i++)
+        epicsTimeGetCurrent(&ts);
+    testOk(fastCalls == TEST_CALLS && slowCalls == 0,
+        "%d calls: %lu fast, %lu slow", TEST_CALLS,
+        (unsigned long) fastCalls, (unsigned long) slowCalls);
+    name = generalTimeCurrentProviderName();
+    testOk(name && strcmp(name, TEST_CLOCK) == 0,
+        "Current time provider is \"%s\"", name ? name : "(none)");
+
+    testOk(generalTimeCurrentProviderStats(TEST_CLOCK, &calls, &mean, &max)
+        == epicsTimeOK, "generalTimeCurrentProviderStats(\"%s\")",
+        TEST_CLOCK);
+    testOk(calls == TEST_CALLS && mean >= 0.0 && max >= mean,
+        "Calls = %lu, latency mean %.3f us, max %.3f us",
+        (unsigned long) calls, mean * 1e6, max * 1e6);
+
+    /* Step the provider backwards */
+    last = ts;
+    errors = generalTimeGetErrorCounts();
+    epicsTimeAddSeconds(&testBase, -10.0);
+    epicsTimeGetCurrent(&ts);
+    testOk(epicsTimeEqual(&ts, &last),
+        "Older time replaced by the last time provided");
+    testOk(generalTimeGetErrorCounts() == errors + 1,
+        "Error count incremented");
+    epicsTimeAddSeconds(&testBase, 10.0);
+
+    fastFails = 1;
+    testOk(epicsTimeGetCurrent(&ts) == epicsTimeOK && slowCalls == 1,
+        "Fast routine failing falls back to the provider's get routine");
+    fastFails = 0;
+
+    runThreads();
+}
+
+static double measure(void)
+{
+    epicsTimeStamp start, stop, ts;
+    int i;
+
+    epicsTimeGetCurrent(&start);
+    for (i = 0; i < NCALLS; i++)
+        epicsTimeGetCurrent(&ts);
+    epicsTimeGetCurrent(&stop);
+    return epicsTimeDiffInSeconds(&stop, &start) / NCALLS;
+}
+
+MAIN(epicsGeneralTimeTest)
+{
+    epicsTimeStamp ts, start, stop;
+    const char *name;
+    double perCall;
+
+    testPlan(11 + 2 * NTHREADS);
+
+    testOk(epicsTimeGetCurrent(&ts) == epicsTimeOK,
+        "epicsTimeGetCurrent() succeeds");
+    name = generalTimeCurrentProviderName();
+    testOk(name != NULL, "Current time provider is \"%s\"",
+        name ? name : "(none)");
+
+    perCall = measure();
+    testDiag("epicsTimeGetCurrent() takes %.1f ns in one thread",
+        perCall * 1e9);
+
+    epicsTimeGetCurrent(&start);
+    runThreads();
+    epicsTimeGetCurrent(&stop);
+    testDiag("%d threads made %d calls each in %.3f sec", NTHREADS, NCALLS,
+        epicsTimeDiffInSeconds(&stop, &start));
+
+    testFastProvider();
+
+    testOk(generalTimeReport(0) == epicsTimeOK, "generalTimeReport(0)");
+
+    return testDone();
+}
@@ -24,6 +24,7 @@ int epicsEllTest(void);
 int epicsEnvTest(void);
 int epicsErrlogTest(void);
 int epicsEventTest(void);
+int epicsGeneralTimeTest(void);
 int epicsExitTest(void);
 int epicsMathTest(void);
 int epicsMessageQueueTest(void);
@@ -81,6 +82,7 @@ void epicsRunLibComTests(void)
     runTest(epicsEnvTest);
     runTest(epicsErrlogTest);
     runTest(epicsEventTest);
+    runTest(epicsGeneralTimeTest);
     runTest(epicsInlineTest);
     runTest(epicsMathTest);
     runTest(epicsMessageQueueTest);
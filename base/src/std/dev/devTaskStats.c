@@ -0,0 +1,172 @@
+/*************************************************************************\
+* EPICS BASE is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+/*
+ *   Device support for reading IOC worker thread statistics
+ *
+ *   INP has the form "@<name> <metric>", e.g. "@cbLow LOAD". Interval
+ *   metrics are computed over the time since the record last processed.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "alarm.h"
+#include "cantProceed.h"
+#include "dbDefs.h"
+#include "dbAccess.h"
+#include "dbTaskStats.h"
+#include "recGbl.h"
+#include "devSup.h"
+#include "epicsString.h"
+
+#include "aiRecord.h"
+#include "epicsExport.h"
+
+#define DEVSUPNAME "devAiTaskStats"
+
+typedef enum {
+    metricJobs, metricRate, metricLoad,
+    metricQueue, metricQueueMax, metricOverflows,
+    metricExecMean, metricExecMax, metricWaitMean, metricWaitMax,
+    metricExecHist, metricWaitHist
+} metric;
+
+static const char * const metricNames[] = {
+    "JOBS", "RATE", "LOAD",
+    "QUEUE", "QUEUE_MAX", "OVERFLOWS",
+    "EXEC_MEAN", "EXEC_MAX", "WAIT_MEAN", "WAIT_MAX",
+    "EXEC_HIST", "WAIT_HIST"
+};
+
+typedef struct taskStatsPvt {
+    dbTaskStatsId id;
+    metric metric;
+    int bin;
+    dbTaskStatsInfo last;
+} taskStatsPvt;
+
+static long init_ai(aiRecord *prec)
+{
+    char name[40], parm[20];
+    taskStatsPvt *pvt;
+    int i;
+
+    if (prec->inp.type != INST_IO) {
+        recGblRecordError(S_db_badField, (void *)prec,
+                          DEVSUPNAME "::init_ai: Illegal INP field");
+        prec->pact = TRUE;
+        return S_db_badField;
+    }
+
+    if (sscanf(prec->inp.value.instio.string, "%39s %19s", name, parm) != 2)
+        goto bad;
+
+    pvt = callocMustSucceed(1, sizeof(taskStatsPvt), DEVSUPNAME);
+    for (i = 0; i < NELEMENTS(metricNames); i++) {
+        size_t len = strlen(metricNames[i]);
+
+        if (i >= metricExecHist) {
+            /* Histogram metrics have the bin number appended */
+            char *end;
+
+            if (epicsStrnCaseCmp(parm, metricNames[i], len))
+                continue;
+            pvt->bin = strtol(parm + len, &end, 10);
+            if (end == parm + len || *end ||
+                pvt->bin < 0 || pvt->bin >= DBTS_HIST_BINS)
+                continue;
+        }
+        else if (epicsStrCaseCmp(parm, metricNames[i]))
+            continue;
+
+        pvt->metric = (metric) i;
+        /* Records initialize before some threads have started */
+        pvt->id = dbTaskStatsCreate(name);
+        dbTaskStatsGet(pvt->id, &pvt->last);
+        prec->dpvt = pvt;
+        return 0;
+    }
+    free(pvt);
+
+bad:
+    recGblRecordError(S_db_badField, (void *)prec,
+                      DEVSUPNAME "::init_ai: Bad parm");
+    prec->pact = TRUE;
+    prec->dpvt = NULL;
+    return S_db_badField;
+}
+
+static double ratio(double num, double den)
+{
+    return den > 0.0 ? num / den : 0.0;
+}
+
+static long read_ai(aiRecord *prec)
+{
+    taskStatsPvt *pvt = (taskStatsPvt *)prec->dpvt;
+    dbTaskStatsInfo info, *plast;
+    double dt;
+
+    if (!pvt) return -1;
+
+    plast = &pvt->last;
+    dbTaskStatsGet(pvt->id, &info);
+    dt = info.elapsed - plast->elapsed;
+
+    switch (pvt->metric) {
+    case metricJobs:
+        prec->val = (double) info.jobs;
+        break;
+    case metricRate:
+        prec->val = ratio((double) (info.jobs - plast->jobs), dt);
+        break;
+    case metricLoad:
+        prec->val = ratio(info.busy - plast->busy, dt);
+        break;
+    case metricQueue:
+        prec->val = (double) info.queueDepth;
+        break;
+    case metricQueueMax:
+        prec->val = (double) info.queueMax;
+        break;
+    case metricOverflows:
+        prec->val = (double) info.overflows;
+        break;
+    case metricExecMean:
+        prec->val = ratio(info.busy - plast->busy,
+            (double) (info.timed - plast->timed));
+        break;
+    case metricExecMax:
+        prec->val = info.execMax;
+        break;
+    case metricWaitMean:
+        prec->val = ratio(info.waitSum - plast->waitSum,
+            (double) (info.waited - plast->waited));
+        break;
+    case metricWaitMax:
+        prec->val = info.waitMax;
+        break;
+    case metricExecHist:
+        prec->val = (double) info.execHist[pvt->bin];
+        break;
+    case metricWaitHist:
+        prec->val = (double) info.waitHist[pvt->bin];
+        break;
+    }
+    *plast = info;
+    prec->udf = FALSE;
+    return 2;
+}
+
+struct {
+    dset common;
+    DEVSUPFUN read_write;
+    DEVSUPFUN special_linconv;
+} devAiTaskStats = {
+    {6, NULL, NULL, init_ai, NULL}, read_ai,  NULL
+};
+epicsExportAddress(dset, devAiTaskStats);
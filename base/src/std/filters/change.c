@@ -0,0 +1,209 @@
+/*************************************************************************\
+* EPICS BASE is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+/*
+ * Array change filter: only forwards array updates whose contents differ
+ * from the last update that was sent through this channel.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <freeList.h>
+#include <dbAccess.h>
+#include <dbExtractArray.h>
+#include <db_field_log.h>
+#include <dbLock.h>
+#include <recSup.h>
+#include <special.h>
+#include <chfPlugin.h>
+#include <epicsExport.h>
+
+typedef struct myStruct {
+    epicsInt32 n;
+    epicsInt32 i;
+    void *arrayFreeList;
+    void *last;
+    long last_elements;
+    long max_elements;
+    short field_size;
+    int valid;
+    unsigned long sent;
+    unsigned long dropped;
+} myStruct;
+
+static void *myStructFreeList;
+
+static const
+chfPluginArgDef opts[] = {
+    chfInt32 (myStruct, n, "n", 0, 1),
+    chfPluginArgEnd
+};
+
+static void * allocPvt(void)
+{
+    return freeListCalloc(myStructFreeList);
+}
+
+static void freePvt(void *pvt)
+{
+    myStruct *my = (myStruct*) pvt;
+
+    if (my->arrayFreeList) freeListCleanup(my->arrayFreeList);
+    free(my->last);
+    freeListFree(myStructFreeList, pvt);
+}
+
+static int parse_ok(void *pvt)
+{
+    myStruct *my = (myStruct*) pvt;
+
+    if (my->n < 0) my->n = 0;
+    return 0;
+}
+
+static void freeArray(db_field_log *pfl) {
+    if (pfl->type == dbfl_type_ref) {
+        freeListFree(pfl->u.r.pvt, pfl->u.r.field);
+    }
+}
+
+/* Copy the current array out of the record, converting pfl to type ref */
+static void extractFromRec(myStruct *my, dbChannel *chan, db_field_log *pfl)
+{
+    struct dbCommon *prec = dbChannelRecord(chan);
+    struct rset *prset = dbGetRset(&chan->addr);
+    void *pfieldsave = chan->addr.pfield;
+    long nSource = chan->addr.no_elements;
+    long offset = 0;
+    void *pdst;
+
+    dbScanLock(prec);
+    prset->get_array_info(&chan->addr, &nSource, &offset);
+    if (nSource > my->max_elements) nSource = my->max_elements;
+    pfl->type = dbfl_type_ref;
+    pfl->stat = prec->stat;
+    pfl->sevr = prec->sevr;
+    pfl->time = prec->time;
+    pfl->field_type = chan->addr.field_type;
+    pfl->field_size = chan->addr.field_size;
+    pfl->no_elements = nSource;
+    pfl->u.r.dtor = NULL;
+    pfl->u.r.field = NULL;
+    if (nSource) {
+        pdst = freeListCalloc(my->arrayFreeList);
+        if (pdst) {
+            pfl->u.r.dtor = freeArray;
+            pfl->u.r.pvt = my->arrayFreeList;
+            dbExtractArrayFromRec(&chan->addr, pdst, nSource, nSource, offset, 1);
+            pfl->u.r.field = pdst;
+        } else {
+            pfl->no_elements = 0;
+        }
+    }
+    dbScanUnlock(prec);
+    chan->addr.pfield = pfieldsave;
+}
+
+static db_field_log* filter(void* pvt, dbChannel *chan, db_field_log *pfl) {
+    myStruct *my = (myStruct*) pvt;
+    size_t nBytes;
+    int force;
+
+    /* Only array monitor updates are filtered */
+    if (pfl->ctx == dbfl_context_read || pfl->type == dbfl_type_val)
+        return pfl;
+
+    if (pfl->type == dbfl_type_rec) {
+        struct rset *prset;
+
+        if (chan->addr.special != SPC_DBADDR ||
+            !(prset = dbGetRset(&chan->addr)) ||
+            !prset->get_array_info)
+            return pfl;
+        extractFromRec(my, chan, pfl);
+    }
+
+    if (pfl->no_elements > my->max_elements || pfl->field_size != my->field_size)
+        return pfl;
+
+    nBytes = pfl->no_elements * pfl->field_size;
+    if (nBytes && !pfl->u.r.field)
+        return pfl;
+
+    force = my->n && ++my->i >= my->n;
+
+    if (!force && my->valid &&
+        pfl->no_elements == my->last_elements &&
+        (nBytes == 0 || !memcmp(my->last, pfl->u.r.field, nBytes))) {
+        my->dropped++;
+        db_delete_field_log(pfl);
+        return NULL;
+    }
+
+    if (nBytes) memcpy(my->last, pfl->u.r.field, nBytes);
+    my->last_elements = pfl->no_elements;
+    my->valid = 1;
+    my->i = 0;
+    my->sent++;
+    return pfl;
+}
+
+static void channelRegisterPost(dbChannel *chan, void *pvt,
+                                chPostEventFunc **cb_out, void **arg_out, db_field_log *probe)
+{
+    myStruct *my = (myStruct*) pvt;
+
+    if (probe->no_elements <= 1) return;                /* array data only */
+
+    if (!my->arrayFreeList)
+        freeListInitPvt(&my->arrayFreeList, probe->no_elements * probe->field_size, 2);
+    if (!my->arrayFreeList) return;
+    if (!my->last)
+        my->last = calloc(probe->no_elements, probe->field_size);
+    if (!my->last) return;
+
+    my->max_elements = probe->no_elements;
+    my->field_size = probe->field_size;
+    *cb_out = filter;
+    *arg_out = pvt;
+}
+
+static void channel_report(dbChannel *chan, void *pvt, int level, const unsigned short indent)
+{
+    myStruct *my = (myStruct*) pvt;
+    printf("%*sChange (chg): n=%d, sent=%lu, dropped=%lu\n", indent, "",
+           my->n, my->sent, my->dropped);
+}
+
+static chfPluginIf pif = {
+    allocPvt,
+    freePvt,
+
+    NULL, /* parse_error, */
+    parse_ok,
+
+    NULL, /* channel_open, */
+    NULL, /* channelRegisterPre, */
+    channelRegisterPost,
+    channel_report,
+    NULL /* channel_close */
+};
+
+static void chgInitialize(void)
+{
+    static int firstTime = 1;
+
+    if (!firstTime) return;
+    firstTime = 0;
+
+    if (!myStructFreeList)
+        freeListInitPvt(&myStructFreeList, sizeof(myStruct), 64);
+
+    chfPluginRegister("chg", &pif, opts);
+}
+
+epicsExportRegistrar(chgInitialize);
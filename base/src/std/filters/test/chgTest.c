@@ -0,0 +1,145 @@
+/*************************************************************************\
+* EPICS BASE is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+#include <string.h>
+
+#include "dbStaticLib.h"
+#include "dbAccess.h"
+#include "db_field_log.h"
+#include "dbCommon.h"
+#include "dbChannel.h"
+#include "registry.h"
+#include "chfPlugin.h"
+#include "errlog.h"
+#include "dbmf.h"
+#include "epicsUnitTest.h"
+#include "dbUnitTest.h"
+#include "testMain.h"
+#include "osiFileName.h"
+
+void filterTest_registerRecordDeviceDriver(struct dbBase *);
+
+static void testHead (char* title) {
+    testDiag("--------------------------------------------------------");
+    testDiag("%s", title);
+    testDiag("--------------------------------------------------------");
+}
+
+static db_field_log* newEventLog(dbChannel *pch) {
+    db_field_log *pfl = db_create_read_log(pch);
+
+    pfl->ctx = dbfl_context_event;
+    return pfl;
+}
+
+static void putArray(dbAddr *paddr, epicsInt32 *ar) {
+    (void) dbPutField(paddr, DBR_LONG, ar, 10);
+}
+
+static void mustPass(dbChannel *pch, epicsInt32 *ar, char* m) {
+    db_field_log *pfl = newEventLog(pch);
+    db_field_log *pfl2 = dbChannelRunPostChain(pch, pfl);
+
+    testOk(pfl2 == pfl, "filter passes field_log (%s)", m);
+    testOk(pfl2 && pfl2->type == dbfl_type_ref, "filtered field log has type ref");
+    testOk(pfl2 && pfl2->no_elements == 10 &&
+           !memcmp(pfl2->u.r.field, ar, 10 * sizeof(epicsInt32)),
+           "array data correct");
+    db_delete_field_log(pfl2);
+}
+
+static void mustDrop(dbChannel *pch, char* m) {
+    db_field_log *pfl = newEventLog(pch);
+    int oldFree = db_available_logs();
+    db_field_log *pfl2 = dbChannelRunPostChain(pch, pfl);
+    int newFree = db_available_logs();
+
+    testOk(NULL == pfl2, "filter drops field_log (%s)", m);
+    testOk(newFree == oldFree + 1, "field_log was freed - %d+1 => %d",
+        oldFree, newFree);
+    db_delete_field_log(pfl2);
+}
+
+MAIN(chgTest)
+{
+    dbChannel *pch;
+    const chFilterPlugin *plug;
+    char myname[] = "chg";
+    db_field_log *pfl, *pfl2;
+    dbEventCtx evtctx;
+    dbAddr valaddr;
+    epicsInt32 ar[10] = {10,11,12,13,14,15,16,17,18,19};
+
+    testPlan(31);
+
+    testdbPrepare();
+
+    testdbReadDatabase("filterTest.dbd", NULL, NULL);
+
+    filterTest_registerRecordDeviceDriver(pdbbase);
+
+    testdbReadDatabase("arrTest.db", NULL, NULL);
+
+    eltc(0);
+    testIocInitOk();
+    eltc(1);
+
+    evtctx = db_init_events();
+
+    testOk(!!(plug = dbFindFilter(myname, strlen(myname))),
+        "plugin '%s' registered correctly", myname);
+
+    testOk(!dbNameToAddr("x.VAL", &valaddr), "dbAddr for x.VAL");
+    putArray(&valaddr, ar);
+
+    /* No parameter: only changed arrays pass */
+
+    testOk(!!(pch = dbChannelCreate("x.{\"chg\":{}}")),
+        "dbChannel with plugin chg created");
+    testOk(!(dbChannelOpen(pch)), "dbChannel with plugin chg opened");
+    testOk((ellCount(&pch->post_chain) == 1), "chg has one filter in post chain");
+
+    testHead("Unchanged arrays are dropped");
+    mustPass(pch, ar, "first update");
+    mustDrop(pch, "same data");
+    mustDrop(pch, "same data again");
+
+    testHead("Changed arrays are passed");
+    ar[9] = 42;
+    putArray(&valaddr, ar);
+    mustPass(pch, ar, "last element changed");
+    mustDrop(pch, "same data");
+
+    testHead("Read requests are not filtered");
+    pfl = db_create_read_log(pch);
+    pfl2 = dbChannelRunPostChain(pch, pfl);
+    testOk(pfl2 == pfl, "read field_log passed");
+    testOk(pfl2->type == dbfl_type_rec, "read field_log not modified");
+    db_delete_field_log(pfl2);
+
+    dbChannelDelete(pch);
+
+    /* n=3: unchanged data is sent every third update */
+
+    testOk(!!(pch = dbChannelCreate("x.{\"chg\":{\"n\":3}}")),
+        "dbChannel with plugin chg (n=3) created");
+    testOk(!(dbChannelOpen(pch)), "dbChannel with plugin chg (n=3) opened");
+
+    testHead("Unchanged arrays are forced out every n updates");
+    mustPass(pch, ar, "first update");
+    mustDrop(pch, "same data");
+    mustDrop(pch, "same data again");
+    mustPass(pch, ar, "third unchanged update");
+
+    dbChannelDelete(pch);
+
+    db_close_events(evtctx);
+
+    testIocShutdownOk();
+
+    testdbCleanup();
+
+    return testDone();
+}
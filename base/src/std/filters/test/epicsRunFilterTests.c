@@ -18,6 +18,7 @@ int dbndTest(void);
 int syncTest(void);
 int arrTest(void);
 int decTest(void);
+int chgTest(void);
 
 void epicsRunFilterTests(void)
 {
@@ -28,6 +29,7 @@ void epicsRunFilterTests(void)
     runTest(syncTest);
     runTest(arrTest);
     runTest(decTest);
+    runTest(chgTest);
 
     dbmfFreeChunks();
 
@@ -31,10 +31,13 @@
 NDArray::NDArray()
   : referenceCount(0), pNDArrayPool(0), pDriver(0),
     uniqueId(0), timeStamp(0.0), ndims(0), dataType(NDInt8),
-    dataSize(0),  pData(0)
+    dataSize(0),  pData(0), compressedSize(0), pViewParent(0)
 {
   this->epicsTS.secPastEpoch = 0;
   this->epicsTS.nsec = 0;
+  this->codec.level = 0;
+  this->codec.shuffle = 0;
+  this->codec.compressor = 0;
   memset(this->dims, 0, sizeof(this->dims));
   memset(&this->node, 0, sizeof(this->node));
   this->pAttributeList = new NDAttributeList();
@@ -43,11 +46,14 @@ NDArray::NDArray()
 NDArray::NDArray(int nDims, size_t *dims, NDDataType_t dataType, size_t dataSize, void *pData)
   : referenceCount(0), pNDArrayPool(0), pDriver(0),
     uniqueId(0), timeStamp(0.0), ndims(nDims), dataType(dataType),
-    dataSize(dataSize),  pData(0)
+    dataSize(dataSize),  pData(0), compressedSize(0), pViewParent(0)
 {
   static const char *functionName = "NDArray::NDArray";
   this->epicsTS.secPastEpoch = 0;
   this->epicsTS.nsec = 0;
+  this->codec.level = 0;
+  this->codec.shuffle = 0;
+  this->codec.compressor = 0;
   this->pAttributeList = new NDAttributeList();
   this->referenceCount = 1;
 
@@ -250,6 +256,14 @@ int NDArray::report(FILE *fp, int details)
         this->dataType, (int)this->dataSize, this->pData);
   fprintf(fp, "  uniqueId=%d, timeStamp=%f, epicsTS.secPastEpoch=%d, epicsTS.nsec=%d\n",
         this->uniqueId, this->timeStamp, this->epicsTS.secPastEpoch, this->epicsTS.nsec);
+  if (!this->codec.name.empty()) {
+    fprintf(fp, "  codec=%s, level=%d, shuffle=%d, compressor=%d, compressedSize=%d\n",
+          this->codec.name.c_str(), this->codec.level, this->codec.shuffle, this->codec.compressor,
+          (int)this->compressedSize);
+  }
+  if (this->pViewParent) {
+    fprintf(fp, "  view of array=%p\n", this->pViewParent);
+  }
   fprintf(fp, "  referenceCount=%d\n", this->referenceCount);
   fprintf(fp, "  number of attributes=%d\n", this->pAttributeList->count());
   if (details > 5) {
@@ -13,6 +13,9 @@
 #define NDArray_H
 
 #include <set>
+#include <string>
+#include <vector>
+#include <ellLib.h>
 #include <epicsMutex.h>
 #include <epicsTime.h>
 #include <stdio.h>
@@ -66,6 +69,15 @@ typedef struct NDDimension {
                       * reversed data passed to NDPluginROI. */
 } NDDimension_t;
 
+/** Structure describing how the data of an NDArray are compressed.
+  * An NDArray with an empty codec name holds uncompressed data. */
+typedef struct NDCodec {
+    std::string name;   /**< The codec, "zlib" or "blosc"; empty if the data are not compressed */
+    int level;          /**< Compression level used */
+    int shuffle;        /**< Blosc shuffle (0=none, 1=byte, 2=bit) */
+    int compressor;     /**< Blosc compressor code */
+} NDCodec_t;
+
 /** Structure returned by NDArray::getInfo */
 typedef struct NDArrayInfo {
     size_t nElements;       /**< The total number of elements in the array */
@@ -124,29 +136,17 @@ public:
                                   * The data is assumed to be stored in the order of dims[0] changing fastest, and 
                                   * dims[ndims-1] changing slowest. */
     NDAttributeList *pAttributeList;  /**< Linked list of attributes */
+    NDCodec_t     codec;        /**< The codec of the data; dims and dataType describe the data after decompression */
+    size_t        compressedSize; /**< Number of bytes of compressed data in pData; 0 if the data are not compressed */
+    NDArray       *pViewParent; /**< The array that owns the buffer pData points into if this array was created
+                                  * by NDArrayPool::view(); NULL if this array owns its buffer */
 };
 
-// This class defines the object that is contained in the std::multilist for sorting NDArrays in the freeList_.
-// It defines the < operator to use the NDArray::dataSize field as the sort key
-
-// We would like to hide this class definition in NDArrayPool.cpp and just forward reference it here.
-// That works on Visual Studio, and on gcc if instantiating plugins as heap variables with "new", but fails on gcc
-// if instantiating plugins as automatic variables.
-//class sortedListElement;
-
-class freeListElement {
-    public:
-        freeListElement(NDArray *pArray, size_t dataSize) {
-          pArray_ = pArray;
-          dataSize_ = dataSize;}
-        friend bool operator<(const freeListElement& lhs, const freeListElement& rhs) {
-            return (lhs.dataSize_ < rhs.dataSize_);
-        }
-        NDArray *pArray_;
-        size_t dataSize_;
-    private:
-        freeListElement(); // Default constructor is private so objects cannot be constructed without arguments
-};
+/** Function called by NDArrayPool::runTiles() to process items first to first+count-1 */
+typedef void (*NDTileFunc_t)(void *pvt, size_t first, size_t count);
+
+/** Number of size classes in the NDArrayPool free list; there are 4 classes for each power of 2 */
+#define ND_POOL_NUM_SIZE_CLASSES (4 * 8 * sizeof(size_t))
 
 /** The NDArrayPool class manages a free list (pool) of NDArray objects.
   * Drivers allocate NDArray objects from the pool, and pass these objects to plugins.
@@ -154,6 +154,15 @@ class freeListElement {
   * their queue, and decrease the reference count when they are done processing the
   * array. When the reference count reaches 0 again the NDArray object is placed back
   * on the free list. This mechanism minimizes the copying of array data in plugins.
+  *
+  * The free list is divided into size classes, each a stack of arrays with
+  * similar dataSize, so a buffer of the right size is normally found at the top of a stack.  reserve() and release()
+  * change the reference count atomically and only take the free list lock when an
+  * array is returned to the free list.
+  *
+  * view() creates an array that shares the buffer of another array instead of copying it,
+  * for regions of the input array that are contiguous in memory.  The parent array is reserved
+  * until the view is released.  Like all arrays passed to plugins, views must not be modified.
   */
 class epicsShareClass NDArrayPool {
 public:
@@ -161,6 +170,8 @@ public:
     virtual ~NDArrayPool() {}
     NDArray*     alloc(int ndims, size_t *dims, NDDataType_t dataType, size_t dataSize, void *pData);
     NDArray*     copy(NDArray *pIn, NDArray *pOut, int copyData);
+    NDArray*     view(NDArray *pIn, NDDimension_t *dimsOut);
+    NDArray*     view(NDArray *pIn);
 
     int          reserve(NDArray *pArray);
     int          release(NDArray *pArray);
@@ -171,16 +182,29 @@ public:
     int          convert(NDArray *pIn,
                          NDArray **ppOut,
                          NDDataType_t dataTypeOut);
+    int          convert(NDArray *pIn,
+                         NDArray **ppOut,
+                         NDDataType_t dataTypeOut,
+                         NDDimension_t *outDims,
+                         double scale,
+                         bool clamp);
     int          report(FILE  *fp, int details);
     int          getNumBuffers();
     size_t       getMaxMemory();
     size_t       getMemorySize();
     int          getNumFree();
     void         emptyFreeList();
+    int          preAllocBuffers(int numBuffers, size_t dataSize);
+    size_t       getNumHits();
+    size_t       getNumMisses();
+    size_t       getNumBlocked();
+    size_t       getPeakMemorySize();
+    static void  runTiles(int numTiles, size_t count, NDTileFunc_t func, void *pvt);
 
 protected:
     /** The following methods should be implemented by a pool class
       * that manages objects derived from the NDArray class.
+      * They are called without the free list lock held.
       */
     virtual NDArray* createArray();
     virtual void onAllocateArray(NDArray *pArray);
@@ -188,11 +212,17 @@ protected:
     virtual void onReleaseArray(NDArray *pArray);
 
 private:
-    std::multiset<freeListElement> freeList_;
+    void*        allocData(size_t dataSize);
+    std::vector<NDArray*> freeList_[ND_POOL_NUM_SIZE_CLASSES]; /**< Free arrays, one stack per size class */
     epicsMutexId listLock_;      /**< Mutex to protect the free list */
     int          numBuffers_;
+    int          numFree_;       /**< Number of NDArray objects in freeList_ */
     size_t       maxMemory_;     /**< Maximum bytes of memory this object is allowed to allocate; -1=unlimited */
     size_t       memorySize_;    /**< Number of bytes of memory this object has currently allocated */
+    size_t       peakMemorySize_; /**< Largest value of memorySize_ */
+    size_t       numHits_;       /**< Allocations that reused a buffer from the free list */
+    size_t       numMisses_;     /**< Allocations that needed a new buffer */
+    size_t       numBlocked_;    /**< Allocations that reached maxMemory_ */
     class asynNDArrayDriver *pDriver_; /**< The asynNDArrayDriver that created this object */
 };
 
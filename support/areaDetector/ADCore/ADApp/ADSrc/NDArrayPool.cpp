@@ -9,8 +9,17 @@
 #include <stdlib.h>
 #include <dbDefs.h>
 #include <stdint.h>
+#include <limits>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
 
 #include <cantProceed.h>
+#include <epicsAtomic.h>
+#include <epicsEvent.h>
+#include <epicsThread.h>
+#include <epicsThreadPool.h>
+#include <iocsh.h>
 
 #include <asynPortDriver.h>
 
@@ -22,6 +31,12 @@
 // How much larger an NDArray must be than the required size before it is considered "too large"
 #define THRESHOLD_SIZE_RATIO 1.5
 
+// Buffers at least this large are aligned for huge pages if NDArrayPoolHugePages is set
+#define HUGE_PAGE_SIZE (2*1024*1024)
+
+// Output arrays at least this large are converted by NDArrayPoolConvertThreads threads
+#define CONVERT_TILE_MIN_BYTES (1024*1024)
+
 static const char *driverName = "NDArrayPool";
 
 
@@ -37,13 +52,57 @@ static const char *driverName = "NDArrayPool";
 volatile int eraseNDAttributes=0;
 extern "C" {epicsExportAddress(int, eraseNDAttributes);}
 
+/** NDArrayPoolHugePages is a global flag that controls how large array buffers are allocated.
+  * If it is non-zero then on Linux buffers of 2 MB or more are aligned on 2 MB boundaries and
+  * the kernel is advised to back them with transparent huge pages, which reduces TLB misses when
+  * plugins walk through large images.  The default value is 0.
+  */
+volatile int NDArrayPoolHugePages=0;
+extern "C" {epicsExportAddress(int, NDArrayPoolHugePages);}
+
+/** NDArrayPoolConvertThreads is a global variable that sets the number of threads that
+  * NDArrayPool::convert() uses for output arrays of CONVERT_TILE_MIN_BYTES or more.
+  * The rows of the array are divided between the calling thread and the EPICS shared
+  * thread pool.  The default value is 4; 1 converts all arrays in the calling thread.
+  */
+volatile int NDArrayPoolConvertThreads=4;
+extern "C" {epicsExportAddress(int, NDArrayPoolConvertThreads);}
+
+/** Returns the free list size class for a buffer size; each power of 2 is divided into 4 classes */
+static int sizeClass(size_t size)
+{
+  int msb = 0;
+
+  if (size < 4) return (int)size;
+  while (size >> (msb+1)) msb++;
+  return 4*msb + (int)((size >> (msb-2)) & 3);
+}
+
+/** Sets the ColorMode attribute of an RGBx array to mono if its color dimension is no longer 3 */
+static void checkColorMode(NDArray *pOut)
+{
+  NDAttribute *pAttribute;
+  int colorMode, colorModeMono = NDColorModeMono;
+
+  pAttribute = pOut->pAttributeList->find("ColorMode");
+  if (pAttribute && pAttribute->getValue(NDAttrInt32, &colorMode)) {
+    if      ((colorMode == NDColorModeRGB1) && (pOut->dims[0].size != 3)) 
+      pAttribute->setValue(&colorModeMono);
+    else if ((colorMode == NDColorModeRGB2) && (pOut->dims[1].size != 3)) 
+      pAttribute->setValue(&colorModeMono);
+    else if ((colorMode == NDColorModeRGB3) && (pOut->dims[2].size != 3))
+      pAttribute->setValue(&colorModeMono);
+  }
+}
+
 /** NDArrayPool constructor
   * \param[in] pDriver Pointer to the asynNDArrayDriver that created this object.
   * \param[in] maxMemory Maxiumum number of bytes of memory the the pool is allowed to use, summed over
   * all of the NDArray objects; 0=unlimited.
   */
 NDArrayPool::NDArrayPool(class asynNDArrayDriver *pDriver, size_t maxMemory)
-  : numBuffers_(0), maxMemory_(maxMemory), memorySize_(0), pDriver_(pDriver)
+  : numBuffers_(0), numFree_(0), maxMemory_(maxMemory), memorySize_(0), peakMemorySize_(0),
+    numHits_(0), numMisses_(0), numBlocked_(0), pDriver_(pDriver)
 {
   listLock_ = epicsMutexCreate();
 }
@@ -82,6 +141,22 @@ void NDArrayPool::onReleaseArray(NDArray *pArray)
 }
 
 
+/** Allocates memory for array data.
+  * \param[in] dataSize Number of bytes to allocate.
+  */
+void* NDArrayPool::allocData(size_t dataSize)
+{
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  if (NDArrayPoolHugePages && (dataSize >= HUGE_PAGE_SIZE)) {
+    void *pData;
+    if (posix_memalign(&pData, HUGE_PAGE_SIZE, dataSize)) return NULL;
+    madvise(pData, dataSize, MADV_HUGEPAGE);
+    return pData;
+  }
+#endif
+  return malloc(dataSize);
+}
+
 /** Allocates a new NDArray object; the first 3 arguments are required.
   * \param[in] ndims The number of dimensions in the NDArray. 
   * \param[in] dims Array of dimensions, whose size must be at least ndims.
@@ -99,15 +174,19 @@ void NDArrayPool::onReleaseArray(NDArray *pArray)
   * this NDArray would cause the cumulative memory allocated for the pool to exceed
   * maxMemory then an error will be returned. alloc() sets the reference count for the
   * returned NDArray to 1.
+  *
+  * The free list lock is only held while arrays are moved on and off the free list;
+  * memory is allocated and freed after it has been released.
   */
 NDArray* NDArrayPool::alloc(int ndims, size_t *dims, NDDataType_t dataType, size_t dataSize, void *pData)
 {
   NDArray *pArray=NULL;
   NDArrayInfo_t arrayInfo;
+  std::vector<NDArray*> deleteList;
+  void *pOldData = NULL;
+  bool needData;
   const char* functionName = "NDArrayPool::alloc:";
 
-  epicsMutexLock(listLock_);
-
   // Compute the required NDArray size
   NDArray::computeArrayInfo(ndims, dims, dataType, &arrayInfo);
   if (dataSize == 0) {
@@ -122,24 +201,74 @@ NDArray* NDArrayPool::alloc(int ndims, size_t *dims, NDDataType_t dataType, size
     if (pData != NULL) pData = NULL;
   }
 
+  epicsMutexLock(listLock_);
+
   // Try to find an array in the free list which is big enough.
-  freeListElement testElement(NULL, dataSize);
-  std::multiset<freeListElement>::iterator pListElement = freeList_.lower_bound(testElement);
-  if (pListElement == freeList_.end()) {
-    /* We did not find a free image that is large enough, allocate a new one */
+  // Arrays in a higher size class are always big enough, so only the first class
+  // that has any arrays may need to be searched.  The most recently released array
+  // is at the back of each stack, and is tried first.
+  for (size_t i=sizeClass(dataSize); i<ND_POOL_NUM_SIZE_CLASSES && !pArray; i++) {
+    std::vector<NDArray*> &stack = freeList_[i];
+    for (size_t j=stack.size(); j>0; j--) {
+      if (stack[j-1]->dataSize >= dataSize) {
+        pArray = stack[j-1];
+        stack.erase(stack.begin() + (j-1));
+        numFree_--;
+        break;
+      }
+    }
+  }
+  if (pArray == NULL) {
+    /* We did not find a free image that is large enough, allocate a new one below */
     numBuffers_++;
-    pArray = this->createArray();
-  } else {
-    pArray = pListElement->pArray_;
-    if (pListElement->dataSize_ > (dataSize * THRESHOLD_SIZE_RATIO)) {
-      // We found an array but it is too large.  Set the size to 0 so it will be allocated below.
-      memorySize_ -= pArray->dataSize;
-      free(pArray->pData);
-      pArray->pData = NULL;
+  } else if (pArray->dataSize > (dataSize * THRESHOLD_SIZE_RATIO)) {
+    // We found an array but it is too large.  Free its memory so it will be allocated below.
+    memorySize_ -= pArray->dataSize;
+    pOldData = pArray->pData;
+    pArray->pData = NULL;
+    pArray->dataSize = 0;
+  }
+  needData = (pData == NULL) && ((pArray == NULL) || (pArray->pData == NULL));
+
+  if (needData) {
+    numMisses_++;
+    if ((maxMemory_ > 0) && ((memorySize_ + dataSize) > maxMemory_)) {
+      // We don't have enough memory to allocate the array
+      // See if we can get memory by deleting arrays
+      // Delete the largest arrays first, i.e. work from the highest size class
+      numBlocked_++;
+      for (int i=ND_POOL_NUM_SIZE_CLASSES-1; i>=0 && ((memorySize_ + dataSize) > maxMemory_); i--) {
+        while (((memorySize_ + dataSize) > maxMemory_) && !freeList_[i].empty()) {
+          NDArray *freeArray = freeList_[i].back();
+          freeList_[i].pop_back();
+          memorySize_ -= freeArray->dataSize;
+          numFree_--;
+          numBuffers_--;
+          deleteList.push_back(freeArray);
+        }
+      }
+    }
+    if ((maxMemory_ > 0) && ((memorySize_ + dataSize) > maxMemory_)) {
+      asynPrint(pDriver_->pasynUserSelf, ASYN_TRACE_ERROR, 
+             "%s: error: reached limit of %ld memory (%d buffers)\n",
+             functionName, (long)maxMemory_, numBuffers_);
+      needData = false;
+    } else {
+      // Claim the memory now so other threads see it while we allocate
+      memorySize_ += dataSize;
+      if (memorySize_ > peakMemorySize_) peakMemorySize_ = memorySize_;
     }
-    freeList_.erase(pListElement);
+  } else if (pData == NULL) {
+    numHits_++;
   }
-    
+  epicsMutexUnlock(listLock_);
+
+  // Free memory outside the lock
+  if (pOldData) free(pOldData);
+  for (size_t i=0; i<deleteList.size(); i++) delete deleteList[i];
+
+  if (pArray == NULL) pArray = this->createArray();
+
   /* Initialize fields */
   pArray->pNDArrayPool = this;
   pArray->referenceCount = 1;
@@ -153,6 +282,8 @@ NDArray* NDArrayPool::alloc(int ndims, size_t *dims, NDDataType_t dataType, size
     pArray->dims[i].binning = 1;
     pArray->dims[i].reverse = 0;
   }
+  pArray->codec.name.clear();
+  pArray->compressedSize = 0;
 
   /* Erase the attributes if that global flag is set */
   if (eraseNDAttributes) pArray->pAttributeList->clear();
@@ -161,45 +292,27 @@ NDArray* NDArrayPool::alloc(int ndims, size_t *dims, NDDataType_t dataType, size
   /* If the caller passed a valid buffer use that */
   if (pData) {
     pArray->pData = pData;
-  } else if (pArray->pData == NULL) {
-    if ((maxMemory_ > 0) && ((memorySize_ + dataSize) > maxMemory_)) {
-      // We don't have enough memory to allocate the array
-      // See if we can get memory by deleting arrays
-      // Delete the largest arrays first, i.e. work from the end of freeList_
-      NDArray *freeArray;
-      std::multiset<freeListElement>::iterator it;
-      while (!freeList_.empty() && ((memorySize_ + dataSize) > maxMemory_)) {
-        it = freeList_.end();
-        it--;
-        freeArray = it->pArray_;
-        freeList_.erase(it);
-        memorySize_ -= freeArray->dataSize;
-        numBuffers_--;
-        delete freeArray;
-      }
-    }
-    if ((maxMemory_ > 0) && ((memorySize_ + dataSize) > maxMemory_)) {
-      asynPrint(pDriver_->pasynUserSelf, ASYN_TRACE_ERROR, 
-             "%s: error: reached limit of %ld memory (%d buffers)\n",
-             functionName, (long)maxMemory_, numBuffers_);
+  } else if (needData) {
+    pArray->pData = allocData(dataSize);
+    if (pArray->pData) {
+      pArray->dataSize = dataSize;
     } else {
-      pArray->pData = malloc(dataSize);
-      if (pArray->pData) {
-        pArray->dataSize = dataSize;
-        memorySize_ += dataSize;
-      }
+      epicsMutexLock(listLock_);
+      memorySize_ -= dataSize;
+      epicsMutexUnlock(listLock_);
     }
   }
   // If we don't have a valid memory buffer see pArray to NULL to indicate error
-  if (pArray && (pArray->pData == NULL)) {
+  if (pArray->pData == NULL) {
     delete pArray;
+    epicsMutexLock(listLock_);
     numBuffers_--;
+    epicsMutexUnlock(listLock_);
     pArray = NULL;
   }
 
   // Call allocation hook (for pools that manage objects derived from NDArray class)
   onAllocateArray(pArray);
-  epicsMutexUnlock(listLock_);
   return (pArray);
 }
 
@@ -225,7 +338,10 @@ NDArray* NDArrayPool::copy(NDArray *pIn, NDArray *pOut, int copyData)
   /* If the output array does not exist then create it */
   if (!pOut) {
     for (i=0; i<pIn->ndims; i++) dimSizeOut[i] = pIn->dims[i].size;
-    pOut = this->alloc(pIn->ndims, dimSizeOut, pIn->dataType, 0, NULL);
+    /* Compressed data may be larger than the uncompressed array */
+    pIn->getInfo(&arrayInfo);
+    pOut = this->alloc(pIn->ndims, dimSizeOut, pIn->dataType,
+                       (pIn->compressedSize > arrayInfo.totalBytes) ? pIn->compressedSize : 0, NULL);
     if(NULL==pOut) return NULL;
   }
   pOut->uniqueId = pIn->uniqueId;
@@ -234,9 +350,12 @@ NDArray* NDArrayPool::copy(NDArray *pIn, NDArray *pOut, int copyData)
   pOut->ndims = pIn->ndims;
   memcpy(pOut->dims, pIn->dims, sizeof(pIn->dims));
   pOut->dataType = pIn->dataType;
+  pOut->codec = pIn->codec;
+  pOut->compressedSize = pIn->compressedSize;
   if (copyData) {
     pIn->getInfo(&arrayInfo);
     numCopy = arrayInfo.totalBytes;
+    if (!pIn->codec.name.empty()) numCopy = pIn->compressedSize;
     if (pOut->dataSize < numCopy) numCopy = pOut->dataSize;
     memcpy(pOut->pData, pIn->pData, numCopy);
   }
@@ -245,6 +364,103 @@ NDArray* NDArrayPool::copy(NDArray *pIn, NDArray *pOut, int copyData)
   return(pOut);
 }
 
+/** Creates an array that is a view of a region of another array and shares its buffer.
+  * \param[in] pIn The input array.
+  * \param[in] dimsOut The region of the input array, with the same meaning as for convert().
+  * \return Returns the new array, or NULL if the region cannot be a view and must be copied
+  * with convert().
+  *
+  * A region can be a view if it has no binning or reversal and its elements are contiguous in
+  * the input buffer, i.e. it covers the full size of all of the dimensions that change faster
+  * than the first dimension it does not cover, and has size 1 in all of the slower dimensions.
+  * This includes the whole array, and blocks of complete rows or planes.
+  * The view has its own dimensions and attributes, and pData points into the buffer of pIn.
+  * The array that owns the buffer is reserved until the view is released, so the buffer
+  * is not reused or freed while the view exists.  The view takes no memory from this pool.
+  */
+NDArray* NDArrayPool::view(NDArray *pIn, NDDimension_t *dimsOut)
+{
+  NDArray *pArray = NULL;
+  NDArray *pParent;
+  NDArrayInfo_t arrayInfo;
+  size_t offset = 0, stride = 1, nElements = 1;
+  bool partial = false;
+  int i;
+
+  if (!pIn->codec.name.empty() || (pIn->pData == NULL)) return NULL;
+  if (pIn->getInfo(&arrayInfo) != ND_SUCCESS) return NULL;
+  for (i=0; i<pIn->ndims; i++) {
+    NDDimension_t *pDim = &dimsOut[i];
+    if ((pDim->binning != 1) || pDim->reverse || (pDim->size == 0) ||
+        (pDim->offset + pDim->size > pIn->dims[i].size)) return NULL;
+    if (partial && (pDim->size != 1)) return NULL;
+    if (pDim->size != pIn->dims[i].size) partial = true;
+    offset += pDim->offset * stride;
+    stride *= pIn->dims[i].size;
+    nElements *= pDim->size;
+  }
+
+  /* Views have no buffer of their own, so use an array object without one */
+  epicsMutexLock(listLock_);
+  std::vector<NDArray*> &stack = freeList_[0];
+  for (size_t j=stack.size(); j>0; j--) {
+    if (stack[j-1]->pData == NULL) {
+      pArray = stack[j-1];
+      stack.erase(stack.begin() + (j-1));
+      numFree_--;
+      break;
+    }
+  }
+  if (pArray == NULL) numBuffers_++;
+  epicsMutexUnlock(listLock_);
+  if (pArray == NULL) pArray = this->createArray();
+
+  /* Always keep the array that owns the buffer, not another view */
+  pParent = pIn->pViewParent ? pIn->pViewParent : pIn;
+  pParent->reserve();
+
+  pArray->pNDArrayPool = this;
+  pArray->referenceCount = 1;
+  pArray->pDriver = pDriver_;
+  pArray->uniqueId = pIn->uniqueId;
+  pArray->timeStamp = pIn->timeStamp;
+  pArray->epicsTS = pIn->epicsTS;
+  pArray->dataType = pIn->dataType;
+  pArray->ndims = pIn->ndims;
+  memset(pArray->dims, 0, sizeof(pArray->dims));
+  for (i=0; i<pIn->ndims; i++) {
+    pArray->dims[i].size = dimsOut[i].size;
+    pArray->dims[i].offset = pIn->dims[i].offset + dimsOut[i].offset;
+    pArray->dims[i].binning = pIn->dims[i].binning;
+    pArray->dims[i].reverse = pIn->dims[i].reverse;
+  }
+  pArray->codec.name.clear();
+  pArray->compressedSize = 0;
+  pArray->pData = (char *)pIn->pData + offset * arrayInfo.bytesPerElement;
+  pArray->dataSize = nElements * arrayInfo.bytesPerElement;
+  pArray->pViewParent = pParent;
+  pArray->pAttributeList->clear();
+  pIn->pAttributeList->copy(pArray->pAttributeList);
+  checkColorMode(pArray);
+
+  onAllocateArray(pArray);
+  return pArray;
+}
+
+/** Creates an array that is a view of all of another array; see view(NDArray*, NDDimension_t*).
+  * \param[in] pIn The input array.
+  */
+NDArray* NDArrayPool::view(NDArray *pIn)
+{
+  NDDimension_t dims[ND_ARRAY_MAX_DIMS];
+  int i;
+
+  for (i=0; i<pIn->ndims; i++) {
+    pIn->initDimension(&dims[i], pIn->dims[i].size);
+  }
+  return this->view(pIn, dims);
+}
+
 /** This method increases the reference count for the NDArray object.
   * \param[in] pArray The array on which to increase the reference count.
   *
@@ -264,17 +480,15 @@ int NDArrayPool::reserve(NDArray *pArray)
   }
   //asynPrint(pDriver_->pasynUserSelf, ASYN_TRACE_FLOW,
   //  "NDArrayPool::reserve pArray=%p, count=%d\n", pArray, pArray->referenceCount);
-  epicsMutexLock(listLock_);
-  // If the reference count is less than 1 then something is wrong, this NDArray has been released.
-  if (pArray->referenceCount < 1) {
+  // If the reference count was less than 1 then something is wrong, this NDArray has been released.
+  int count = epicsAtomicIncrIntT(&pArray->referenceCount);
+  if (count <= 1) {
     cantProceed("%s:reserve ERROR, reference count = %d, should be >= 1, pArray=%p\n",
-           driverName, pArray->referenceCount, pArray);
+           driverName, count-1, pArray);
   }
-  pArray->referenceCount++;
 
   // Call reservation hook (for pools that manage objects derived from NDArray class)
   onReserveArray(pArray);
-  epicsMutexUnlock(listLock_);
   return ND_SUCCESS;
 }
 
@@ -299,85 +513,87 @@ int NDArrayPool::release(NDArray *pArray)
   }
   //asynPrint(pDriver_->pasynUserSelf, ASYN_TRACE_FLOW,
   //  "NDArrayPool::release pArray=%p, count=%d\n", pArray, pArray->referenceCount);
-  epicsMutexLock(listLock_);
-  pArray->referenceCount--;
-  if (pArray->referenceCount == 0) {
-    /* The last user has released this image, add it back to the free list */
-    freeListElement listElement(pArray, pArray->dataSize);
-    freeList_.insert(listElement);
-  }
-  if (pArray->referenceCount < 0) {
+  int count = epicsAtomicDecrIntT(&pArray->referenceCount);
+  if (count < 0) {
     cantProceed("%s:release ERROR, reference count < 0 pArray=%p\n",
            driverName, pArray);
   }
 
   // Call release hook (for pools that manage objects derived from NDArray class)
+  // This is done before the array goes on the free list, where another thread could take it.
   onReleaseArray(pArray);
-  epicsMutexUnlock(listLock_);
+
+  if (count == 0) {
+    /* A view gives the buffer back to its parent; the array object goes on the free list without it */
+    NDArray *pParent = pArray->pViewParent;
+    if (pParent) {
+      pArray->pViewParent = NULL;
+      pArray->pData = NULL;
+      pArray->dataSize = 0;
+    }
+    /* The last user has released this image, add it back to the free list.
+     * The stacks keep their capacity, so this does not normally allocate memory. */
+    epicsMutexLock(listLock_);
+    freeList_[sizeClass(pArray->dataSize)].push_back(pArray);
+    numFree_++;
+    epicsMutexUnlock(listLock_);
+    if (pParent) pParent->release();
+  }
   return ND_SUCCESS;
 }
 
-template <typename dataTypeIn, typename dataTypeOut> void convertType(NDArray *pIn, NDArray *pOut)
+/** Converts n contiguous elements.  The loop has no dependencies between elements, so the compiler
+  * vectorizes it for each pair of types. */
+template <typename dataTypeIn, typename dataTypeOut>
+static void convertRow(const dataTypeIn *pIn, dataTypeOut *pOut, size_t n)
 {
-  size_t i;
-  dataTypeIn *pDataIn = (dataTypeIn *)pIn->pData;
-  dataTypeOut *pDataOut = (dataTypeOut *)pOut->pData;
-  NDArrayInfo_t arrayInfo;
-
-  pOut->getInfo(&arrayInfo);
-  for (i=0; i<arrayInfo.nElements; i++) {
-    *pDataOut++ = (dataTypeOut)(*pDataIn++);
+  for (size_t i=0; i<n; i++) {
+    pOut[i] = (dataTypeOut)pIn[i];
   }
 }
 
-template <typename dataTypeOut> int convertTypeSwitch (NDArray *pIn, NDArray *pOut)
+/** Converts n contiguous elements and adds them to the output, for binning */
+template <typename dataTypeIn, typename dataTypeOut>
+static void addRow(const dataTypeIn *pIn, dataTypeOut *pOut, size_t n)
 {
-  int status = ND_SUCCESS;
-
-  switch(pIn->dataType) {
-    case NDInt8:
-      convertType<epicsInt8, dataTypeOut> (pIn, pOut);
-      break;
-    case NDUInt8:
-      convertType<epicsUInt8, dataTypeOut> (pIn, pOut);
-      break;
-    case NDInt16:
-      convertType<epicsInt16, dataTypeOut> (pIn, pOut);
-      break;
-    case NDUInt16:
-      convertType<epicsUInt16, dataTypeOut> (pIn, pOut);
-      break;
-    case NDInt32:
-      convertType<epicsInt32, dataTypeOut> (pIn, pOut);
-      break;
-    case NDUInt32:
-      convertType<epicsUInt32, dataTypeOut> (pIn, pOut);
-      break;
-    case NDFloat32:
-      convertType<epicsFloat32, dataTypeOut> (pIn, pOut);
-      break;
-    case NDFloat64:
-      convertType<epicsFloat64, dataTypeOut> (pIn, pOut);
-      break;
-    default:
-      status = ND_ERROR;
-      break;
+  for (size_t i=0; i<n; i++) {
+    pOut[i] += (dataTypeOut)pIn[i];
   }
-  return(status);
 }
 
+/** The arrays of a conversion, passed to each tile */
+typedef struct {
+  NDArray *pIn;
+  NDArray *pOut;
+  bool assign;      /**< There is no binning, so output elements are assigned rather than summed */
+  double scale;     /**< Output elements are divided by this; only used by the scaling tiles */
+  bool clamp;       /**< Output elements are limited to the range of the output type */
+} convertArgs_t;
+
+/** Converts elements first to first+count-1 of an array whose dimensions do not change */
+template <typename dataTypeIn, typename dataTypeOut>
+static void convertTypeTile(void *pvt, size_t first, size_t count)
+{
+  convertArgs_t *pArgs = (convertArgs_t *)pvt;
+
+  convertRow((const dataTypeIn *)pArgs->pIn->pData + first, (dataTypeOut *)pArgs->pOut->pData + first, count);
+}
 
-template <typename dataTypeIn, typename dataTypeOut> void convertDim(NDArray *pIn, NDArray *pOut,
-                                                     void *pDataIn, void *pDataOut, int dim)
+/** Converts output elements first to first+count-1 of dimension dim, binning and reversing as required.
+  * Binning and conversion are done in the same pass, and rows with no binning or reversal are
+  * converted with convertRow() or addRow(). */
+template <typename dataTypeIn, typename dataTypeOut>
+static void convertDim(convertArgs_t *pArgs, const dataTypeIn *pDIn, dataTypeOut *pDOut, int dim,
+                       size_t first, size_t count)
 {
-  dataTypeOut *pDOut = (dataTypeOut *)pDataOut;
-  dataTypeIn *pDIn = (dataTypeIn *)pDataIn;
-  NDDimension_t *pOutDims = pOut->dims;
-  NDDimension_t *pInDims = pIn->dims;
+  NDDimension_t *pOutDims = pArgs->pOut->dims;
+  NDDimension_t *pInDims = pArgs->pIn->dims;
   size_t inStep, outStep, inOffset;
+  ptrdiff_t inc;
   int inDir;
   int i, bin;
-  size_t inc, in, out;
+  int binning = pOutDims[dim].binning;
+  size_t out;
 
   inStep = 1;
   outStep = 1;
@@ -388,103 +604,268 @@ template <typename dataTypeIn, typename dataTypeOut> void convertDim(NDArray *pI
     outStep *= pOutDims[i].size;
   }
   if (pOutDims[dim].reverse) {
-    inOffset += pOutDims[dim].size * pOutDims[dim].binning - 1;
+    inOffset += pOutDims[dim].size * binning - 1;
     inDir = -1;
   }
-  inc = inDir * inStep;
+  inc = inDir * (ptrdiff_t)inStep;
   pDIn += inOffset*inStep;
-  for (in=0, out=0; out<pOutDims[dim].size; out++, in++) {
-    for (bin=0; bin<pOutDims[dim].binning; bin++) {
-      if (dim > 0) {
-        convertDim <dataTypeIn, dataTypeOut> (pIn, pOut, pDIn, pDOut, dim-1);
-      } else {
-        *pDOut += (dataTypeOut)*pDIn;
+  pDIn += (ptrdiff_t)(first*binning) * inc;
+  pDOut += first*outStep;
+
+  if (dim > 0) {
+    for (out=0; out<count; out++) {
+      for (bin=0; bin<binning; bin++) {
+        convertDim <dataTypeIn, dataTypeOut> (pArgs, pDIn, pDOut, dim-1, 0, pOutDims[dim-1].size);
+        pDIn += inc;
       }
+      pDOut += outStep;
+    }
+  } else if ((binning == 1) && (inDir == 1)) {
+    if (pArgs->assign) convertRow(pDIn, pDOut, count);
+    else addRow(pDIn, pDOut, count);
+  } else if (pArgs->assign) {
+    for (out=0; out<count; out++) {
+      pDOut[out] = (dataTypeOut)*pDIn;
       pDIn += inc;
     }
-    pDOut += outStep;
+  } else {
+    /* Each output element still receives its bins in order, so the sums are the same as
+     * summing one element at a time */
+    for (bin=0; bin<binning; bin++) {
+      const dataTypeIn *pBin = pDIn + bin*inc;
+      ptrdiff_t binInc = binning*inc;
+      for (out=0; out<count; out++) {
+        pDOut[out] += (dataTypeOut)pBin[out*binInc];
+      }
+    }
   }
 }
 
-template <typename dataTypeOut> int convertDimensionSwitch(NDArray *pIn, NDArray *pOut,
-                                                           void *pDataIn, void *pDataOut, int dim)
+/** Converts output elements first to first+count-1 of the slowest dimension of the output array */
+template <typename dataTypeIn, typename dataTypeOut>
+static void convertDimTile(void *pvt, size_t first, size_t count)
 {
-  int status = ND_SUCCESS;
+  convertArgs_t *pArgs = (convertArgs_t *)pvt;
 
-  switch(pIn->dataType) {
+  convertDim <dataTypeIn, dataTypeOut> (pArgs, (const dataTypeIn *)pArgs->pIn->pData,
+                                        (dataTypeOut *)pArgs->pOut->pData, pArgs->pIn->ndims-1, first, count);
+}
+
+template <typename dataTypeOut>
+static NDTileFunc_t convertTileFuncSwitch(NDDataType_t dataTypeIn, bool changeDims)
+{
+  switch(dataTypeIn) {
     case NDInt8:
-      convertDim <epicsInt8, dataTypeOut> (pIn, pOut, pDataIn, pDataOut, dim);
-      break;
+      return changeDims ? convertDimTile<epicsInt8, dataTypeOut> : convertTypeTile<epicsInt8, dataTypeOut>;
     case NDUInt8:
-      convertDim <epicsUInt8, dataTypeOut> (pIn, pOut, pDataIn, pDataOut, dim);
-      break;
+      return changeDims ? convertDimTile<epicsUInt8, dataTypeOut> : convertTypeTile<epicsUInt8, dataTypeOut>;
     case NDInt16:
-      convertDim <epicsInt16, dataTypeOut> (pIn, pOut, pDataIn, pDataOut, dim);
-      break;
+      return changeDims ? convertDimTile<epicsInt16, dataTypeOut> : convertTypeTile<epicsInt16, dataTypeOut>;
     case NDUInt16:
-      convertDim <epicsUInt16, dataTypeOut> (pIn, pOut, pDataIn, pDataOut, dim);
-      break;
+      return changeDims ? convertDimTile<epicsUInt16, dataTypeOut> : convertTypeTile<epicsUInt16, dataTypeOut>;
     case NDInt32:
-      convertDim <epicsInt32, dataTypeOut> (pIn, pOut, pDataIn, pDataOut, dim);
-      break;
+      return changeDims ? convertDimTile<epicsInt32, dataTypeOut> : convertTypeTile<epicsInt32, dataTypeOut>;
     case NDUInt32:
-      convertDim <epicsUInt32, dataTypeOut> (pIn, pOut, pDataIn, pDataOut, dim);
-      break;
+      return changeDims ? convertDimTile<epicsUInt32, dataTypeOut> : convertTypeTile<epicsUInt32, dataTypeOut>;
     case NDFloat32:
-      convertDim <epicsFloat32, dataTypeOut> (pIn, pOut, pDataIn, pDataOut, dim);
-      break;
+      return changeDims ? convertDimTile<epicsFloat32, dataTypeOut> : convertTypeTile<epicsFloat32, dataTypeOut>;
     case NDFloat64:
-      convertDim <epicsFloat64, dataTypeOut> (pIn, pOut, pDataIn, pDataOut, dim);
-      break;
+      return changeDims ? convertDimTile<epicsFloat64, dataTypeOut> : convertTypeTile<epicsFloat64, dataTypeOut>;
     default:
-      status = ND_ERROR;
-      break;
+      return NULL;
+  }
+}
+
+/** Divides n contiguous elements by scale and converts them.  With clamp the results are limited to
+  * the range of the output type, and NaN gives 0 for integer types; the selects keep the loop
+  * vectorizable. */
+template <typename dataTypeIn, typename dataTypeOut>
+static void scaleRow(const dataTypeIn *pIn, dataTypeOut *pOut, size_t n, double scale, bool clamp)
+{
+  const bool isInteger = std::numeric_limits<dataTypeOut>::is_integer;
+  const double high = (double)std::numeric_limits<dataTypeOut>::max();
+  const double low = isInteger ? (double)std::numeric_limits<dataTypeOut>::min() : -high;
+  size_t i;
+
+  if (!clamp) {
+    for (i=0; i<n; i++) {
+      pOut[i] = (dataTypeOut)(pIn[i] / scale);
+    }
+    return;
+  }
+  for (i=0; i<n; i++) {
+    double value = pIn[i] / scale;
+    if (isInteger) value = (value == value) ? value : 0.;
+    value = (value < low) ? low : value;
+    value = (value > high) ? high : value;
+    pOut[i] = (dataTypeOut)value;
   }
-  return(status);
 }
 
-static int convertDimension(NDArray *pIn,
-                            NDArray *pOut,
-                            void *pDataIn,
-                            void *pDataOut,
-                            int dim)
+/** Scales elements first to first+count-1 of an array whose dimensions do not change */
+template <typename dataTypeIn, typename dataTypeOut>
+static void scaleTile(void *pvt, size_t first, size_t count)
+{
+  convertArgs_t *pArgs = (convertArgs_t *)pvt;
+
+  scaleRow((const dataTypeIn *)pArgs->pIn->pData + first, (dataTypeOut *)pArgs->pOut->pData + first, count,
+           pArgs->scale, pArgs->clamp);
+}
+
+template <typename dataTypeOut>
+static NDTileFunc_t scaleTileFuncSwitch(NDDataType_t dataTypeIn)
 {
-  int status = ND_SUCCESS;
-  /* This routine is passed:
-   * A pointer to the start of the input data
-   * A pointer to the start of the output data
-   * An array of dimensions
-   * A dimension index */
-  switch(pOut->dataType) {
+  switch(dataTypeIn) {
+    case NDInt8:    return scaleTile<epicsInt8, dataTypeOut>;
+    case NDUInt8:   return scaleTile<epicsUInt8, dataTypeOut>;
+    case NDInt16:   return scaleTile<epicsInt16, dataTypeOut>;
+    case NDUInt16:  return scaleTile<epicsUInt16, dataTypeOut>;
+    case NDInt32:   return scaleTile<epicsInt32, dataTypeOut>;
+    case NDUInt32:  return scaleTile<epicsUInt32, dataTypeOut>;
+    case NDFloat32: return scaleTile<epicsFloat32, dataTypeOut>;
+    case NDFloat64: return scaleTile<epicsFloat64, dataTypeOut>;
+    default:        return NULL;
+  }
+}
+
+/** Returns the function that scales one tile from dataTypeIn to dataTypeOut */
+static NDTileFunc_t scaleTileFunc(NDDataType_t dataTypeIn, NDDataType_t dataTypeOut)
+{
+  switch(dataTypeOut) {
+    case NDInt8:    return scaleTileFuncSwitch <epicsInt8> (dataTypeIn);
+    case NDUInt8:   return scaleTileFuncSwitch <epicsUInt8> (dataTypeIn);
+    case NDInt16:   return scaleTileFuncSwitch <epicsInt16> (dataTypeIn);
+    case NDUInt16:  return scaleTileFuncSwitch <epicsUInt16> (dataTypeIn);
+    case NDInt32:   return scaleTileFuncSwitch <epicsInt32> (dataTypeIn);
+    case NDUInt32:  return scaleTileFuncSwitch <epicsUInt32> (dataTypeIn);
+    case NDFloat32: return scaleTileFuncSwitch <epicsFloat32> (dataTypeIn);
+    case NDFloat64: return scaleTileFuncSwitch <epicsFloat64> (dataTypeIn);
+    default:        return NULL;
+  }
+}
+
+/** Returns the function that converts one tile from dataTypeIn to dataTypeOut.
+  * \param[in] dataTypeIn The data type of the input array.
+  * \param[in] dataTypeOut The data type of the output array.
+  * \param[in] changeDims false if only the data type changes, true if the dimensions change.
+  */
+static NDTileFunc_t convertTileFunc(NDDataType_t dataTypeIn, NDDataType_t dataTypeOut, bool changeDims)
+{
+  switch(dataTypeOut) {
     case NDInt8:
-      convertDimensionSwitch <epicsInt8>(pIn, pOut, pDataIn, pDataOut, dim);
-      break;
+      return convertTileFuncSwitch <epicsInt8> (dataTypeIn, changeDims);
     case NDUInt8:
-      convertDimensionSwitch <epicsUInt8> (pIn, pOut, pDataIn, pDataOut, dim);
-      break;
+      return convertTileFuncSwitch <epicsUInt8> (dataTypeIn, changeDims);
     case NDInt16:
-      convertDimensionSwitch <epicsInt16> (pIn, pOut, pDataIn, pDataOut, dim);
-      break;
+      return convertTileFuncSwitch <epicsInt16> (dataTypeIn, changeDims);
     case NDUInt16:
-      convertDimensionSwitch <epicsUInt16> (pIn, pOut, pDataIn, pDataOut, dim);
-      break;
+      return convertTileFuncSwitch <epicsUInt16> (dataTypeIn, changeDims);
     case NDInt32:
-      convertDimensionSwitch <epicsInt32> (pIn, pOut, pDataIn, pDataOut, dim);
-      break;
+      return convertTileFuncSwitch <epicsInt32> (dataTypeIn, changeDims);
     case NDUInt32:
-      convertDimensionSwitch <epicsUInt32> (pIn, pOut, pDataIn, pDataOut, dim);
-      break;
+      return convertTileFuncSwitch <epicsUInt32> (dataTypeIn, changeDims);
     case NDFloat32:
-      convertDimensionSwitch <epicsFloat32> (pIn, pOut, pDataIn, pDataOut, dim);
-      break;
+      return convertTileFuncSwitch <epicsFloat32> (dataTypeIn, changeDims);
     case NDFloat64:
-      convertDimensionSwitch <epicsFloat64> (pIn, pOut, pDataIn, pDataOut, dim);
-      break;
+      return convertTileFuncSwitch <epicsFloat64> (dataTypeIn, changeDims);
     default:
-      status = ND_ERROR;
-      break;
+      return NULL;
+  }
+}
+
+/** One tile of NDArrayPool::runTiles() run by the shared thread pool */
+typedef struct {
+  NDTileFunc_t func;
+  void *pvt;
+  size_t first;
+  size_t count;
+  epicsJob *pJob;
+  int *pRemaining;
+  epicsEventId done;
+} NDTile_t;
+
+static void tileJob(void *arg, epicsJobMode mode)
+{
+  NDTile_t *pTile = (NDTile_t *)arg;
+  // The tiles may be freed by runTiles() as soon as the count reaches 0
+  epicsEventId done = pTile->done;
+
+  if (mode == epicsJobModeRun) {
+    pTile->func(pTile->pvt, pTile->first, pTile->count);
+  }
+  epicsJobDestroy(pTile->pJob);
+  if (epicsAtomicDecrIntT(pTile->pRemaining) == 0) {
+    epicsEventSignal(done);
+  }
+}
+
+static epicsThreadOnceId tilePoolOnce = EPICS_THREAD_ONCE_INIT;
+static epicsThreadPool *pTilePool;
+
+static void tilePoolInit(void *arg)
+{
+  epicsThreadPoolConfig poolConfig;
+
+  epicsThreadPoolConfigDefaults(&poolConfig);
+  pTilePool = epicsThreadPoolGetShared(&poolConfig);
+}
+
+/** Divides items 0 to count-1 into numTiles tiles and calls func for each tile.
+  * Tile 0 is processed in the calling thread and the others by the EPICS shared thread pool,
+  * and this method returns when all tiles are done.  If numTiles <= 1 func is simply called
+  * for all items.  This is used by convert() and NDPluginDriver::runTiles().
+  * \param[in] numTiles The number of tiles.
+  * \param[in] count The number of items, e.g. rows of an array.
+  * \param[in] func The function that processes the items in one tile.
+  * \param[in] pvt Passed to func. */
+void NDArrayPool::runTiles(int numTiles, size_t count, NDTileFunc_t func, void *pvt)
+{
+  std::vector<NDTile_t> tiles;
+  epicsEventId done;
+  int remaining, tile;
+  size_t first;
+
+  if ((size_t)numTiles > count) numTiles = (int)count;
+  if (numTiles > 1) {
+    epicsThreadOnce(&tilePoolOnce, tilePoolInit, NULL);
+    if (!pTilePool) numTiles = 1;
+  }
+  if (numTiles <= 1) {
+    if (count > 0) func(pvt, 0, count);
+    return;
   }
-  return(status);
+  tiles.resize(numTiles);
+  done = epicsEventMustCreate(epicsEventEmpty);
+  remaining = numTiles - 1;
+  for (tile=0, first=0; tile<numTiles; tile++) {
+    tiles[tile].func = func;
+    tiles[tile].pvt = pvt;
+    tiles[tile].first = first;
+    tiles[tile].count = count/numTiles + (((size_t)tile < count%numTiles) ? 1 : 0);
+    tiles[tile].pRemaining = &remaining;
+    tiles[tile].done = done;
+    first += tiles[tile].count;
+  }
+  for (tile=1; tile<numTiles; tile++) {
+    NDTile_t *pTile = &tiles[tile];
+    pTile->pJob = epicsJobCreate(pTilePool, tileJob, pTile);
+    if (!pTile->pJob || epicsJobQueue(pTile->pJob)) {
+      if (pTile->pJob) epicsJobDestroy(pTile->pJob);
+      func(pvt, pTile->first, pTile->count);
+      if (epicsAtomicDecrIntT(&remaining) == 0) epicsEventSignal(done);
+    }
+  }
+  func(pvt, tiles[0].first, tiles[0].count);
+  // Whichever thread finishes the last tile signals done, so always wait for it
+  epicsEventMustWait(done);
+  epicsEventDestroy(done);
+}
+
+/** Calls func for items 0 to count-1, divided between NDArrayPoolConvertThreads threads if the
+  * output array has at least CONVERT_TILE_MIN_BYTES bytes. */
+static void runConvertTiles(NDTileFunc_t func, void *pvt, size_t count, size_t outBytes)
+{
+  NDArrayPool::runTiles((outBytes < CONVERT_TILE_MIN_BYTES) ? 1 : NDArrayPoolConvertThreads, count, func, pvt);
 }
 
 /** Creates a new output NDArray from an input NDArray, performing
@@ -534,13 +915,20 @@ int NDArrayPool::convert(NDArray *pIn,
   int i;
   NDArray *pOut;
   NDArrayInfo_t arrayInfo;
-  NDAttribute *pAttribute;
-  int colorMode, colorModeMono = NDColorModeMono;
+  convertArgs_t args;
+  NDTileFunc_t convertFunc;
   const char *functionName = "convert";
 
   /* Initialize failure */
   *ppOut = NULL;
 
+  if (!pIn->codec.name.empty()) {
+    asynPrint(pDriver_->pasynUserSelf, ASYN_TRACE_ERROR,
+      "%s:%s: ERROR, cannot convert array compressed with codec %s\n",
+      driverName, functionName, pIn->codec.name.c_str());
+    return(ND_ERROR);
+  }
+
   /* Copy the input dimension array because we need to modify it
    * but don't want to affect caller */
   memcpy(dimsOutCopy, dimsOut, pIn->ndims*sizeof(NDDimension_t));
@@ -581,50 +969,29 @@ int NDArrayPool::convert(NDArray *pIn,
 
   pOut->getInfo(&arrayInfo);
 
-  if (dimsUnchanged) {
-    if (pIn->dataType == pOut->dataType) {
-      /* The dimensions are the same and the data type is the same,
-       * then just copy the input image to the output image */
-      memcpy(pOut->pData, pIn->pData, arrayInfo.totalBytes);
-      return ND_SUCCESS;
-    } else {
+  if (dimsUnchanged && (pIn->dataType == pOut->dataType)) {
+    /* The dimensions are the same and the data type is the same,
+     * then just copy the input image to the output image */
+    memcpy(pOut->pData, pIn->pData, arrayInfo.totalBytes);
+    return ND_SUCCESS;
+  }
+  args.pIn = pIn;
+  args.pOut = pOut;
+  args.assign = true;
+  for (i=0; i<pIn->ndims; i++) {
+    if (dimsOutCopy[i].binning != 1) args.assign = false;
+  }
+  convertFunc = convertTileFunc(pIn->dataType, pOut->dataType, !dimsUnchanged);
+  if (convertFunc) {
+    if (dimsUnchanged) {
       /* We need to convert data types */
-      switch(pOut->dataType) {
-        case NDInt8:
-          convertTypeSwitch <epicsInt8> (pIn, pOut);
-          break;
-        case NDUInt8:
-          convertTypeSwitch <epicsUInt8> (pIn, pOut);
-          break;
-        case NDInt16:
-          convertTypeSwitch <epicsInt16> (pIn, pOut);
-          break;
-        case NDUInt16:
-          convertTypeSwitch <epicsUInt16> (pIn, pOut);
-          break;
-        case NDInt32:
-          convertTypeSwitch <epicsInt32> (pIn, pOut);
-          break;
-        case NDUInt32:
-          convertTypeSwitch <epicsUInt32> (pIn, pOut);
-          break;
-        case NDFloat32:
-          convertTypeSwitch <epicsFloat32> (pIn, pOut);
-          break;
-        case NDFloat64:
-          convertTypeSwitch <epicsFloat64> (pIn, pOut);
-          break;
-        default:
-          //status = ND_ERROR;
-          break;
-      }
+      runConvertTiles(convertFunc, &args, arrayInfo.nElements, arrayInfo.totalBytes);
+    } else {
+      /* The input and output dimensions are not the same, so we are extracting a region
+       * and/or binning.  Binned output elements are sums, so they must start at 0. */
+      if (!args.assign) memset(pOut->pData, 0, arrayInfo.totalBytes);
+      runConvertTiles(convertFunc, &args, pOut->dims[pIn->ndims-1].size, arrayInfo.totalBytes);
     }
-  } else {
-    /* The input and output dimensions are not the same, so we are extracting a region
-     * and/or binning */
-    /* Clear entire output array */
-    memset(pOut->pData, 0, arrayInfo.totalBytes);
-    convertDimension(pIn, pOut, pIn->pData, pOut->pData, pIn->ndims-1);
   }
 
   /* Set fields in the output array */
@@ -635,15 +1002,87 @@ int NDArrayPool::convert(NDArray *pIn,
   }
 
   /* If the frame is an RGBx frame and we have collapsed that dimension then change the colorMode */
-  pAttribute = pOut->pAttributeList->find("ColorMode");
-  if (pAttribute && pAttribute->getValue(NDAttrInt32, &colorMode)) {
-    if      ((colorMode == NDColorModeRGB1) && (pOut->dims[0].size != 3)) 
-      pAttribute->setValue(&colorModeMono);
-    else if ((colorMode == NDColorModeRGB2) && (pOut->dims[1].size != 3)) 
-      pAttribute->setValue(&colorModeMono);
-    else if ((colorMode == NDColorModeRGB3) && (pOut->dims[2].size != 3))
-      pAttribute->setValue(&colorModeMono);
+  checkColorMode(pOut);
+  return ND_SUCCESS;
+}
+
+/** Creates a new output NDArray from an input NDArray, performing conversion operations
+  * as the form above, and then dividing each output element by scale.
+  * If the dimensions change the region is first converted to NDFloat64, so binned sums are
+  * divided without integer truncation, and that array is then scaled to dataTypeOut.
+  * Otherwise the input is scaled and converted in one pass.
+  * \param[in] pIn The input array, source of the conversion.
+  * \param[out] ppOut The output array, result of the conversion.
+  * \param[in] dataTypeOut The data type of the output array.
+  * \param[in] dimsOut The dimensions of the output array.
+  * \param[in] scale The output elements are divided by this; must not be 0.
+  * \param[in] clamp If true the output elements are limited to the range of dataTypeOut,
+  *                  otherwise values out of range are cast as by the other forms.
+  */
+int NDArrayPool::convert(NDArray *pIn,
+                         NDArray **ppOut,
+                         NDDataType_t dataTypeOut,
+                         NDDimension_t *dimsOut,
+                         double scale,
+                         bool clamp)
+{
+  NDArray *pScratch = NULL, *pSource = pIn, *pOut;
+  size_t dimSizeOut[ND_ARRAY_MAX_DIMS];
+  NDArrayInfo_t arrayInfo;
+  convertArgs_t args;
+  NDTileFunc_t scaleFunc;
+  int i, status;
+  const char *functionName = "convert";
+
+  *ppOut = NULL;
+  if ((scale == 1.) && !clamp) return this->convert(pIn, ppOut, dataTypeOut, dimsOut);
+  if (scale == 0.) {
+    asynPrint(pDriver_->pasynUserSelf, ASYN_TRACE_ERROR,
+      "%s:%s: ERROR, scale must not be 0\n",
+      driverName, functionName);
+    return(ND_ERROR);
+  }
+  for (i=0; i<pIn->ndims; i++) {
+    if ((dimsOut[i].size != pIn->dims[i].size) || (dimsOut[i].offset != 0) ||
+        (dimsOut[i].binning != 1) || (dimsOut[i].reverse != 0)) break;
   }
+  if (i < pIn->ndims) {
+    status = this->convert(pIn, &pScratch, NDFloat64, dimsOut);
+    if (status) return status;
+    pSource = pScratch;
+  } else if (!pIn->codec.name.empty()) {
+    asynPrint(pDriver_->pasynUserSelf, ASYN_TRACE_ERROR,
+      "%s:%s: ERROR, cannot convert array compressed with codec %s\n",
+      driverName, functionName, pIn->codec.name.c_str());
+    return(ND_ERROR);
+  }
+
+  for (i=0; i<pSource->ndims; i++) dimSizeOut[i] = pSource->dims[i].size;
+  pOut = alloc(pSource->ndims, dimSizeOut, dataTypeOut, 0, NULL);
+  if (!pOut) {
+    asynPrint(pDriver_->pasynUserSelf, ASYN_TRACE_ERROR,
+      "%s:%s: ERROR, cannot allocate output array\n",
+      driverName, functionName);
+    if (pScratch) pScratch->release();
+    return(ND_ERROR);
+  }
+  pOut->timeStamp = pSource->timeStamp;
+  pOut->epicsTS = pSource->epicsTS;
+  pOut->uniqueId = pSource->uniqueId;
+  memcpy(pOut->dims, pSource->dims, pSource->ndims*sizeof(NDDimension_t));
+  pSource->pAttributeList->copy(pOut->pAttributeList);
+
+  pOut->getInfo(&arrayInfo);
+  args.pIn = pSource;
+  args.pOut = pOut;
+  args.assign = true;
+  args.scale = scale;
+  args.clamp = clamp;
+  scaleFunc = scaleTileFunc(pSource->dataType, dataTypeOut);
+  if (scaleFunc) runConvertTiles(scaleFunc, &args, arrayInfo.nElements, arrayInfo.totalBytes);
+  if (pScratch) pScratch->release();
+  checkColorMode(pOut);
+  *ppOut = pOut;
   return ND_SUCCESS;
 }
 
@@ -668,33 +1107,83 @@ size_t NDArrayPool::getMemorySize()
 /** Returns number of NDArray objects in the free list */
 int NDArrayPool::getNumFree()
 {
-  epicsMutexLock(listLock_);
-  int size = (int)freeList_.size();
-  epicsMutexUnlock(listLock_);
-  return size;
+  return numFree_;
+}
+
+/** Returns number of allocations that reused a buffer from the free list */
+size_t NDArrayPool::getNumHits()
+{
+  return numHits_;
+}
+
+/** Returns number of allocations that needed a new buffer */
+size_t NDArrayPool::getNumMisses()
+{
+  return numMisses_;
+}
+
+/** Returns number of allocations that reached maxMemory, whether or not they then succeeded
+  * by deleting free arrays */
+size_t NDArrayPool::getNumBlocked()
+{
+  return numBlocked_;
+}
+
+/** Returns the largest number of bytes of memory this object has had allocated */
+size_t NDArrayPool::getPeakMemorySize()
+{
+  return peakMemorySize_;
 }
 
 /** Deletes all of the NDArrays in the free list */
 void NDArrayPool::emptyFreeList()
 {
-  NDArray *freeArray;
-  std::multiset<freeListElement>::iterator it;
+  std::vector<NDArray*> deleteList;
+
   epicsMutexLock(listLock_);
-  while (!freeList_.empty()) {
-    it = freeList_.begin();
-    freeArray = it->pArray_;
-    freeList_.erase(it);
-    memorySize_ -= freeArray->dataSize;
-    numBuffers_--;
-    delete freeArray;
+  for (size_t i=0; i<ND_POOL_NUM_SIZE_CLASSES; i++) {
+    for (size_t j=0; j<freeList_[i].size(); j++) {
+      memorySize_ -= freeList_[i][j]->dataSize;
+      numFree_--;
+      numBuffers_--;
+      deleteList.push_back(freeList_[i][j]);
+    }
+    freeList_[i].clear();
   }
   epicsMutexUnlock(listLock_);
+  for (size_t i=0; i<deleteList.size(); i++) delete deleteList[i];
+}
+
+/** Allocates NDArrays and puts them in the free list, so that the memory is available
+  * before acquisition starts.
+  * \param[in] numBuffers Number of arrays to allocate.
+  * \param[in] dataSize Size of each array in bytes.
+  * \return Returns the number of arrays that could be allocated.
+  */
+int NDArrayPool::preAllocBuffers(int numBuffers, size_t dataSize)
+{
+  NDArray **pArrays;
+  int i, numAllocated;
+
+  if ((numBuffers <= 0) || (dataSize == 0)) return 0;
+  pArrays = (NDArray **)calloc(numBuffers, sizeof(NDArray *));
+  for (i=0; i<numBuffers; i++) {
+    pArrays[i] = this->alloc(1, &dataSize, NDInt8, 0, NULL);
+    if (!pArrays[i]) break;
+  }
+  numAllocated = i;
+  for (i=0; i<numAllocated; i++) {
+    this->release(pArrays[i]);
+  }
+  free(pArrays);
+  return numAllocated;
 }
 
 /** Reports on the free list size and other properties of the NDArrayPool
   * object.
   * \param[in] fp File pointer for the report output.
-  * \param[in] details Level of report details desired; does nothing at present.
+  * \param[in] details Level of report details desired; if >5 lists the free arrays,
+  * if >10 also reports on each free array.
   */
 int NDArrayPool::report(FILE *fp, int details)
 {
@@ -702,25 +1191,66 @@ int NDArrayPool::report(FILE *fp, int details)
   fprintf(fp, "NDArrayPool:\n");
   fprintf(fp, "  numBuffers=%d, numFree=%d\n",
          numBuffers_, this->getNumFree());
-  fprintf(fp, "  memorySize=%ld, maxMemory=%ld\n",
-        (long)memorySize_, (long)maxMemory_);
+  fprintf(fp, "  memorySize=%ld, maxMemory=%ld, peakMemorySize=%ld\n",
+        (long)memorySize_, (long)maxMemory_, (long)peakMemorySize_);
+  fprintf(fp, "  hits=%lu, misses=%lu, blocked=%lu\n",
+        (unsigned long)numHits_, (unsigned long)numMisses_, (unsigned long)numBlocked_);
   if (details > 5) {
-    int i;
-    std::multiset<freeListElement>::iterator it;
+    int i=0;
     NDArray *freeArray;
     fprintf(fp, "  freeList: (index, dataSize, pArray)\n");
     epicsMutexLock(listLock_);
-    for (it=freeList_.begin(),i=0; it!=freeList_.end(); ++it,i++) {
-      fprintf(fp, "    %d %d %p\n", i, (int)it->dataSize_, it->pArray_);
-    }
-    if (details > 10) {
-      for (it=freeList_.begin(); it!=freeList_.end(); ++it) {
-        freeArray = it->pArray_;
-        fprintf(fp, "    Array %d\n", i);
-        freeArray->report(fp, details);
+    for (size_t c=0; c<ND_POOL_NUM_SIZE_CLASSES; c++) {
+      for (size_t j=0; j<freeList_[c].size(); j++, i++) {
+        freeArray = freeList_[c][j];
+        fprintf(fp, "    %d %d %p\n", i, (int)freeArray->dataSize, freeArray);
+        if (details > 10) {
+          fprintf(fp, "    Array %d\n", i);
+          freeArray->report(fp, details);
+        }
       }
     }
     epicsMutexUnlock(listLock_);
   }
   return ND_SUCCESS;
 }
+
+/* iocsh command to pre-allocate arrays in the pool of an asynNDArrayDriver */
+extern "C" int NDPoolPreAlloc(const char *portName, int numBuffers, double dataSize)
+{
+  asynPortDriver *pPort = (asynPortDriver *)findAsynPortDriver(portName);
+  asynNDArrayDriver *pDriver = dynamic_cast<asynNDArrayDriver *>(pPort);
+  int numAllocated;
+
+  if (!pDriver) {
+    printf("NDPoolPreAlloc: cannot find NDArray driver port %s\n", portName ? portName : "");
+    return -1;
+  }
+  numAllocated = pDriver->pNDArrayPool->preAllocBuffers(numBuffers, (size_t)dataSize);
+  if (numAllocated < numBuffers) {
+    printf("NDPoolPreAlloc: only allocated %d of %d arrays\n", numAllocated, numBuffers);
+    return -1;
+  }
+  return 0;
+}
+
+static const iocshArg NDPoolPreAllocArg0 = {"portName", iocshArgString};
+static const iocshArg NDPoolPreAllocArg1 = {"numBuffers", iocshArgInt};
+static const iocshArg NDPoolPreAllocArg2 = {"dataSize", iocshArgDouble};
+static const iocshArg * const NDPoolPreAllocArgs[] = {&NDPoolPreAllocArg0,
+                                                      &NDPoolPreAllocArg1,
+                                                      &NDPoolPreAllocArg2};
+static const iocshFuncDef NDPoolPreAllocFuncDef = {"NDPoolPreAlloc", 3, NDPoolPreAllocArgs};
+static void NDPoolPreAllocCallFunc(const iocshArgBuf *args)
+{
+  NDPoolPreAlloc(args[0].sval, args[1].ival, args[2].dval);
+}
+
+extern "C" void NDArrayPoolRegister(void)
+{
+  iocshRegister(&NDPoolPreAllocFuncDef, NDPoolPreAllocCallFunc);
+}
+
+extern "C" {
+epicsExportRegistrar(NDArrayPoolRegister);
+}
@@ -14,6 +14,7 @@
 #include <epicsExport.h>
 
 #include "NDAttribute.h"
+#include "NDAttributeList.h"
 
 /** Strings corresponding to the above enums */
 static const char *NDAttrSourceStrings[] = {
@@ -45,6 +46,8 @@ const char *NDAttribute::attrSourceString(NDAttrSource_t type)
 {
 
   this->name_ = pName ? pName : "";
+  this->nameHash_ = NDAttributeList::hashName(this->name_.c_str());
+  this->listIndex_ = 0;
   this->description_ = pDescription ? pDescription : "";
   this->sourceType_ = sourceType;
   switch (sourceType) {
@@ -70,7 +73,6 @@ const char *NDAttribute::attrSourceString(NDAttrSource_t type)
     this->setDataType(dataType);
     this->setValue(pValue);
   }
-  this->listNode_.pNDAttribute = this;
 }
 
 /** NDAttribute copy constructor
@@ -80,6 +82,8 @@ NDAttribute::NDAttribute(NDAttribute& attribute)
 {
   void *pValue;
   this->name_ = attribute.name_;
+  this->nameHash_ = attribute.nameHash_;
+  this->listIndex_ = 0;
   this->description_ = attribute.description_;
   this->source_ = attribute.source_;
   this->sourceType_ = attribute.sourceType_;
@@ -89,7 +93,6 @@ NDAttribute::NDAttribute(NDAttribute& attribute)
   if (attribute.dataType_ == NDAttrString) pValue = (void *)attribute.string_.c_str();
   else pValue = &attribute.value_;
   this->setValue(pValue);
-  this->listNode_.pNDAttribute = this;
 }
 
 
@@ -14,7 +14,6 @@
 #include <stdio.h>
 #include <string.h>
 
-#include <ellLib.h>
 #include <epicsTypes.h>
 
 /** Success return code  */
@@ -73,14 +72,6 @@ typedef union {
     epicsFloat64 f64;   /**< 64-bit float */
 } NDAttrValue;
 
-/** Structure used by the EPICS ellLib library for linked lists of C++ objects.
-  * This is needed for ellLists of C++ objects, for which making the first data element the ELLNODE 
-  * does not work if the class has virtual functions or derived classes. */
-typedef struct NDAttributeListNode {
-    ELLNODE node;
-    class NDAttribute *pNDAttribute;
-} NDAttributeListNode;
-
 /** NDAttribute class; an attribute has a name, description, source type, source string,
   * data type, and value.
   */
@@ -120,7 +111,8 @@ private:
     std::string source_;            /**< Source string - EPICS PV name or DRV_INFO string */
     NDAttrSource_t sourceType_;     /**< Source type */
     std::string sourceTypeString_;  /**< Source type string */
-    NDAttributeListNode listNode_;  /**< Used for NDAttributeList */
+    epicsUInt32 nameHash_;          /**< Hash of name_, used by NDAttributeList */
+    size_t listIndex_;              /**< Position in the NDAttributeList that owns this attribute */
 };
 
 #endif
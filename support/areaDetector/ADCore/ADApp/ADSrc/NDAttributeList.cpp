@@ -12,11 +12,13 @@
 
 #include "NDAttributeList.h"
 
+// Smallest size of the hash table; it is doubled when it becomes half full
+#define MIN_INDEX_SIZE 16
+
 /** NDAttributeList constructor
   */
 NDAttributeList::NDAttributeList()
 {
-  ellInit(&this->list_);
   this->lock_ = epicsMutexCreate();
 }
 
@@ -25,10 +27,67 @@ NDAttributeList::NDAttributeList()
 NDAttributeList::~NDAttributeList()
 {
   this->clear();
-  ellFree(&this->list_);
   epicsMutexDestroy(this->lock_);
 }
 
+/** Returns the hash of an attribute name (32-bit FNV-1a).
+  * \param[in] pName The name of the attribute.
+  */
+epicsUInt32 NDAttributeList::hashName(const char *pName)
+{
+  epicsUInt32 hash = 2166136261u;
+  for (const unsigned char *p = (const unsigned char *)pName; *p; p++) {
+    hash ^= *p;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/** Adds the position of an attribute to the hash table.  There must be a free slot. */
+void NDAttributeList::insertIndex(size_t position)
+{
+  size_t mask = this->index_.size() - 1;
+  size_t slot = this->attributes_[position]->nameHash_ & mask;
+  while (this->index_[slot] >= 0) slot = (slot + 1) & mask;
+  this->index_[slot] = (int)position;
+}
+
+/** Rebuilds the hash table from the attribute vector.
+  * \param[in] tableSize Size of the new table; must be a power of 2.
+  */
+void NDAttributeList::rebuildIndex(size_t tableSize)
+{
+  this->index_.assign(tableSize, -1);
+  for (size_t i=0; i<this->attributes_.size(); i++) insertIndex(i);
+}
+
+/** Finds an attribute when the lock is already held.
+  * \param[in] pName The name of the attribute.
+  * \param[in] hash The hash of pName.
+  */
+NDAttribute* NDAttributeList::findLocked(const char *pName, epicsUInt32 hash)
+{
+  size_t mask = this->index_.size() - 1;
+  if (this->index_.empty()) return NULL;
+  for (size_t slot = hash & mask; this->index_[slot] >= 0; slot = (slot + 1) & mask) {
+    NDAttribute *pAttribute = this->attributes_[this->index_[slot]];
+    if ((pAttribute->nameHash_ == hash) && (pAttribute->name_ == pName)) return pAttribute;
+  }
+  return NULL;
+}
+
+/** Appends an attribute when the lock is already held; there must not be an attribute of the same name. */
+void NDAttributeList::addLocked(NDAttribute *pAttribute)
+{
+  pAttribute->listIndex_ = this->attributes_.size();
+  this->attributes_.push_back(pAttribute);
+  if (this->attributes_.size() * 2 > this->index_.size()) {
+    rebuildIndex(this->index_.empty() ? MIN_INDEX_SIZE : this->index_.size() * 2);
+  } else {
+    insertIndex(pAttribute->listIndex_);
+  }
+}
+
 /** Adds an attribute to the list.
   * If an attribute of the same name already exists then
   * the existing attribute is deleted and replaced with the new one.
@@ -41,7 +100,7 @@ int NDAttributeList::add(NDAttribute *pAttribute)
   epicsMutexLock(this->lock_);
   /* Remove any existing attribute with this name */
   this->remove(pAttribute->name_.c_str());
-  ellAdd(&this->list_, &pAttribute->listNode_.node);
+  this->addLocked(pAttribute);
   epicsMutexUnlock(this->lock_);
   return(ND_SUCCESS);
 }
@@ -68,12 +127,12 @@ NDAttribute* NDAttributeList::add(const char *pName, const char *pDescription, N
   NDAttribute *pAttribute;
 
   epicsMutexLock(this->lock_);
-  pAttribute = this->find(pName);
+  pAttribute = this->findLocked(pName, hashName(pName));
   if (pAttribute) {
     pAttribute->setValue(pValue);
   } else {
     pAttribute = new NDAttribute(pName, pDescription, NDAttrSourceDriver, "Driver", dataType, pValue);
-    ellAdd(&this->list_, &pAttribute->listNode_.node);
+    this->addLocked(pAttribute);
   }
   epicsMutexUnlock(this->lock_);
   return(pAttribute);
@@ -88,24 +147,16 @@ NDAttribute* NDAttributeList::add(const char *pName, const char *pDescription, N
 NDAttribute* NDAttributeList::find(const char *pName)
 {
   NDAttribute *pAttribute;
-  NDAttributeListNode *pListNode;
+  epicsUInt32 hash = hashName(pName);
   //const char *functionName = "NDAttributeList::find";
 
   epicsMutexLock(this->lock_);
-  pListNode = (NDAttributeListNode *)ellFirst(&this->list_);
-  while (pListNode) {
-    pAttribute = pListNode->pNDAttribute;
-    if (pAttribute->name_ == pName) goto done;
-    pListNode = (NDAttributeListNode *)ellNext(&pListNode->node);
-  }
-  pAttribute = NULL;
-
-  done:
+  pAttribute = this->findLocked(pName, hash);
   epicsMutexUnlock(this->lock_);
   return(pAttribute);
 }
 
-/** Finds the next attribute in the linked list of attributes.
+/** Finds the next attribute in the list of attributes.
   * \param[in] pAttributeIn A pointer to the previous attribute in the list; 
   * if NULL the first attribute in the list is returned.
   * \return Returns a pointer to the next attribute if there is one, 
@@ -113,17 +164,17 @@ NDAttribute* NDAttributeList::find(const char *pName)
 NDAttribute* NDAttributeList::next(NDAttribute *pAttributeIn)
 {
   NDAttribute *pAttribute=NULL;
-  NDAttributeListNode *pListNode;
+  size_t position = 0;
   //const char *functionName = "NDAttributeList::next";
 
   epicsMutexLock(this->lock_);
-  if (!pAttributeIn) {
-    pListNode = (NDAttributeListNode *)ellFirst(&this->list_);
-   }
-  else {
-    pListNode = (NDAttributeListNode *)ellNext(&pAttributeIn->listNode_.node);
+  if (pAttributeIn) {
+    position = pAttributeIn->listIndex_ + 1;
+    // pAttributeIn must be in this list
+    if ((position > this->attributes_.size()) || (this->attributes_[position-1] != pAttributeIn))
+      position = this->attributes_.size();
   }
-  if (pListNode) pAttribute = pListNode->pNDAttribute;
+  if (position < this->attributes_.size()) pAttribute = this->attributes_[position];
   epicsMutexUnlock(this->lock_);
   return(pAttribute);
 }
@@ -134,7 +185,7 @@ int NDAttributeList::count()
 {
   //const char *functionName = "NDAttributeList::count";
 
-  return ellCount(&this->list_);
+  return (int)this->attributes_.size();
 }
 
 /** Removes an attribute from the list.
@@ -148,9 +199,11 @@ int NDAttributeList::remove(const char *pName)
   //const char *functionName = "NDAttributeList::remove";
 
   epicsMutexLock(this->lock_);
-  pAttribute = this->find(pName);
+  pAttribute = this->findLocked(pName, hashName(pName));
   if (!pAttribute) goto done;
-  ellDelete(&this->list_, &pAttribute->listNode_.node);
+  this->attributes_.erase(this->attributes_.begin() + pAttribute->listIndex_);
+  for (size_t i=pAttribute->listIndex_; i<this->attributes_.size(); i++) this->attributes_[i]->listIndex_ = i;
+  this->rebuildIndex(this->index_.size());
   delete pAttribute;
   status = ND_SUCCESS;
 
@@ -162,18 +215,12 @@ int NDAttributeList::remove(const char *pName)
 /** Deletes all attributes from the list. */
 int NDAttributeList::clear()
 {
-  NDAttribute *pAttribute;
-  NDAttributeListNode *pListNode;
   //const char *functionName = "NDAttributeList::clear";
 
   epicsMutexLock(this->lock_);
-  pListNode = (NDAttributeListNode *)ellFirst(&this->list_);
-  while (pListNode) {
-    pAttribute = pListNode->pNDAttribute;
-    ellDelete(&this->list_, &pListNode->node);
-    delete pAttribute;
-    pListNode = (NDAttributeListNode *)ellFirst(&this->list_);
-  }
+  for (size_t i=0; i<this->attributes_.size(); i++) delete this->attributes_[i];
+  this->attributes_.clear();
+  this->index_.assign(this->index_.size(), -1);
   epicsMutexUnlock(this->lock_);
   return(ND_SUCCESS);
 }
@@ -181,27 +228,34 @@ int NDAttributeList::clear()
 /** Copies all attributes from one attribute list to another.
   * It is efficient so that if the attribute already exists in the output
   * list it just copies the properties, and memory allocation is minimized.
+  * If the attribute at the same position of the output list has the same name
+  * it is used without a lookup.
   * The attributes are added to any existing attributes already present in the output list.
   * \param[out] pListOut A pointer to the output attribute list to copy to.
   */
 int NDAttributeList::copy(NDAttributeList *pListOut)
 {
   NDAttribute *pAttrIn, *pAttrOut, *pFound;
-  NDAttributeListNode *pListNode;
   //const char *functionName = "NDAttributeList::copy";
 
+  if (pListOut == this) return(ND_SUCCESS);
   epicsMutexLock(this->lock_);
-  pListNode = (NDAttributeListNode *)ellFirst(&this->list_);
-  while (pListNode) {
-    pAttrIn = pListNode->pNDAttribute;
+  epicsMutexLock(pListOut->lock_);
+  for (size_t i=0; i<this->attributes_.size(); i++) {
+    pAttrIn = this->attributes_[i];
     /* See if there is already an attribute of this name in the output list */
-    pFound = pListOut->find(pAttrIn->name_.c_str());
+    pFound = NULL;
+    if (i < pListOut->attributes_.size()) {
+      pAttrOut = pListOut->attributes_[i];
+      if ((pAttrOut->nameHash_ == pAttrIn->nameHash_) && (pAttrOut->name_ == pAttrIn->name_)) pFound = pAttrOut;
+    }
+    if (!pFound) pFound = pListOut->findLocked(pAttrIn->name_.c_str(), pAttrIn->nameHash_);
     /* The copy function will copy the properties, and will create the attribute if pFound is NULL */
     pAttrOut = pAttrIn->copy(pFound);
     /* If pFound is NULL, then a copy created a new attribute, need to add it to the list */
-    if (!pFound) pListOut->add(pAttrOut);
-    pListNode = (NDAttributeListNode *)ellNext(&pListNode->node);
+    if (!pFound) pListOut->addLocked(pAttrOut);
   }
+  epicsMutexUnlock(pListOut->lock_);
   epicsMutexUnlock(this->lock_);
   return(ND_SUCCESS);
 }
@@ -210,16 +264,11 @@ int NDAttributeList::copy(NDAttributeList *pListOut)
   */
 int NDAttributeList::updateValues()
 {
-  NDAttribute *pAttribute;
-  NDAttributeListNode *pListNode;
   //const char *functionName = "NDAttributeList::updateValues";
 
   epicsMutexLock(this->lock_);
-  pListNode = (NDAttributeListNode *)ellFirst(&this->list_);
-  while (pListNode) {
-    pAttribute = pListNode->pNDAttribute;
-    pAttribute->updateValue();
-    pListNode = (NDAttributeListNode *)ellNext(&pListNode->node);
+  for (size_t i=0; i<this->attributes_.size(); i++) {
+    this->attributes_[i]->updateValue();
   }
   epicsMutexUnlock(this->lock_);
   return(ND_SUCCESS);
@@ -231,19 +280,13 @@ int NDAttributeList::updateValues()
   */
 int NDAttributeList::report(FILE *fp, int details)
 {
-  NDAttribute *pAttribute;
-  NDAttributeListNode *pListNode;
-  
   epicsMutexLock(this->lock_);
   fprintf(fp, "\n");
   fprintf(fp, "NDAttributeList: address=%p:\n", this);
   fprintf(fp, "  number of attributes=%d\n", this->count());
   if (details > 10) {
-    pListNode = (NDAttributeListNode *) ellFirst(&this->list_);
-    while (pListNode) {
-      pAttribute = (NDAttribute *)pListNode->pNDAttribute;
-      pAttribute->report(fp, details);
-      pListNode = (NDAttributeListNode *) ellNext(&pListNode->node);
+    for (size_t i=0; i<this->attributes_.size(); i++) {
+      this->attributes_[i]->report(fp, details);
     }
   }
   epicsMutexUnlock(this->lock_);
@@ -10,13 +10,19 @@
 #define NDAttributeList_H
 
 #include <stdio.h>
-#include <ellLib.h>
+#include <vector>
 #include <epicsMutex.h>
  
 #include "NDAttribute.h"
 
 
-/** NDAttributeList class; this is a linked list of attributes.
+/** NDAttributeList class; this is a list of attributes.
+  * The attributes are kept in a vector in the order they were added, with an open addressing
+  * hash table of their positions so that find() does not scan the list.  The hash of each name
+  * is computed once, when the attribute is created.
+  * copy() copies values in place when the output list already holds the same attributes in the
+  * same order, which is the usual case for arrays reused from an NDArrayPool, so copying the
+  * attributes of a frame then needs no lookups and no memory allocation.
   */
 class epicsShareClass NDAttributeList {
 public:
@@ -34,9 +40,16 @@ public:
     int          updateValues();
     int          report(FILE *fp, int details);
     
+    static epicsUInt32 hashName(const char *pName);
+
 private:
-    ELLLIST      list_;   /**< The EPICS ELLLIST  */
-    epicsMutexId lock_;  /**< Mutex to protect the ELLLIST */
+    NDAttribute* findLocked(const char *pName, epicsUInt32 hash);
+    void         addLocked(NDAttribute *pAttribute);
+    void         insertIndex(size_t position);
+    void         rebuildIndex(size_t tableSize);
+    std::vector<NDAttribute*> attributes_;  /**< The attributes in the order they were added */
+    std::vector<int> index_;                /**< Hash table of positions in attributes_, -1 if empty */
+    epicsMutexId lock_;                     /**< Mutex to protect the list */
 };
 
 #endif
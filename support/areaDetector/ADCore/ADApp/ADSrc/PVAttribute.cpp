@@ -17,6 +17,8 @@
 #include <epicsString.h>
 #include <cadef.h>
 #include <epicsEvent.h>
+#include <epicsAtomic.h>
+#include <epicsThread.h>
 
 #include <asynDriver.h>
 
@@ -45,7 +47,8 @@ static asynUser *pasynUserSelf = NULL;
 PVAttribute::PVAttribute(const char *pName, const char *pDescription,
                          const char *pSource, chtype dbrType)
     : NDAttribute(pName, pDescription, NDAttrSourceEPICSPV, pSource, NDAttrUndefined, 0),
-    dbrType(dbrType), callbackString(0), connectedOnce(false)
+    chanId(0), eventId(0), dbrType(dbrType), callbackString(0), callbackSeq(0), updateSeq(0),
+    connectedOnce(false)
 {
     static const char *functionName = "PVAttribute";
     
@@ -64,6 +67,9 @@ PVAttribute::PVAttribute(const char *pName, const char *pDescription,
      * that which created the context */
     ca_attach_context(pCaInputContext);
     this->lock = epicsMutexCreate();
+    memset(&this->callbackValue, 0, sizeof(this->callbackValue));
+    memset(&this->callbackTime, 0, sizeof(this->callbackTime));
+    memset(&this->updateTime, 0, sizeof(this->updateTime));
     if (!pSource) {
         asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
             "%s:%s: ERROR, must specify source string\n",
@@ -83,6 +89,11 @@ PVAttribute::PVAttribute(PVAttribute& attribute)
     : NDAttribute(attribute)
 {
     dbrType = attribute.dbrType;
+    callbackString = 0;
+    callbackSeq = 0;
+    updateSeq = 0;
+    callbackTime = attribute.updateTime;
+    updateTime = attribute.updateTime;
     eventId = 0;
     chanId = 0;
     lock = 0;
@@ -93,6 +104,7 @@ PVAttribute::~PVAttribute()
 {
     if (this->chanId) SEVCHK(ca_clear_channel(this->chanId),"ca_clear_channel");
     if (this->lock) epicsMutexDestroy(this->lock);
+    free(this->callbackString);
 }
 
 
@@ -117,16 +129,18 @@ static void monitorCallbackC(struct event_handler_args cha)
 }
 
 /** Monitor callback called whenever an EPICS PV changes value.
-  * Calls NDAttribute::setValue to store the new value.
+  * Stores the new value for the next call to updateValue().  Channel access does not call the
+  * callbacks of one channel concurrently, so there is a single writer of callbackValue.
   * \param[in] eha Event handler argument structure passed by channel access. 
   */
 void PVAttribute::monitorCallback(struct event_handler_args eha)
 {
     //chid  chanId = eha.chid;
     NDAttrDataType_t dataType = this->getDataType();
+    NDAttrValue value;
+    epicsTimeStamp now;
     const char *functionName = "monitorCallback";
 
-    epicsMutexLock(this->lock);
     asynPrint(pasynUserSelf, ASYN_TRACE_FLOW, 
         "%s:%s: PV=%s\n", 
         driverName, functionName, this->getSource());
@@ -135,65 +149,111 @@ void PVAttribute::monitorCallback(struct event_handler_args eha)
         asynPrint(pasynUserSelf,  ASYN_TRACE_ERROR,
         "%s:%s: CA returns eha.status=%d\n",
         driverName, functionName, eha.status);
-        goto done;
+        return;
     }
+    epicsTimeGetCurrent(&now);
     /* Treat strings specially */
     if (dataType == NDAttrString) {
+      epicsMutexLock(this->lock);
       if (this->callbackString) free(this->callbackString);
       this->callbackString = epicsStrDup((char *)eha.dbr);
-      goto done;
+      this->callbackTime = now;
+      epicsAtomicAddIntT(&this->callbackSeq, 2);
+      epicsMutexUnlock(this->lock);
+      return;
     }
     switch (dataType) {
       case NDAttrInt8:
-        callbackValue.i8 = *(epicsInt8 *)eha.dbr;
+        value.i8 = *(epicsInt8 *)eha.dbr;
         break;
       case NDAttrUInt8:
-        callbackValue.ui8 = *(epicsUInt8 *)eha.dbr;
+        value.ui8 = *(epicsUInt8 *)eha.dbr;
         break;
       case NDAttrInt16:
-        callbackValue.i16 = *(epicsInt16 *)eha.dbr;
+        value.i16 = *(epicsInt16 *)eha.dbr;
         break;
       case NDAttrUInt16:
-        callbackValue.ui16 = *(epicsUInt16 *)eha.dbr;
+        value.ui16 = *(epicsUInt16 *)eha.dbr;
         break;
       case NDAttrInt32:
-        callbackValue.i32 = *(epicsInt32*)eha.dbr;
+        value.i32 = *(epicsInt32*)eha.dbr;
         break;
       case NDAttrUInt32:
-        callbackValue.ui32 = *(epicsUInt32 *)eha.dbr;
+        value.ui32 = *(epicsUInt32 *)eha.dbr;
         break;
       case NDAttrFloat32:
-        callbackValue.f32 = *(epicsFloat32 *)eha.dbr;
+        value.f32 = *(epicsFloat32 *)eha.dbr;
         break;
       case NDAttrFloat64:
-        callbackValue.f64 = *(epicsFloat64 *)eha.dbr;
+        value.f64 = *(epicsFloat64 *)eha.dbr;
         break;
       case NDAttrUndefined:
-        break;
       default:
-        break;
+        return;
     }
-    done:
-    epicsMutexUnlock(this->lock);
+    /* The sequence count is odd while the value is being written */
+    epicsAtomicIncrIntT(&this->callbackSeq);
+    epicsAtomicWriteMemoryBarrier();
+    this->callbackValue = value;
+    this->callbackTime = now;
+    epicsAtomicWriteMemoryBarrier();
+    epicsAtomicIncrIntT(&this->callbackSeq);
 }
 
+/** Copies the latest value from the monitor callback into the attribute.
+  * If the PV has not changed since the last call this only reads the sequence count.
+  */
 int PVAttribute::updateValue()
 {
     //static const char *functionName = "updateValue"
     
-    void *pValue;
+    NDAttrValue value;
+    epicsTimeStamp time;
     NDAttrDataType_t dataType = this->getDataType();
+    int seq, seqAfter;
     
-    epicsMutexLock(this->lock);
-    if (dataType == NDAttrString)
-        pValue = callbackString;
-    else
-        pValue = &callbackValue;
-    this->setValue(pValue);
-    epicsMutexUnlock(this->lock);
+    seq = epicsAtomicGetIntT(&this->callbackSeq);
+    if (seq == this->updateSeq) return asynSuccess;
+
+    if (dataType == NDAttrString) {
+        epicsMutexLock(this->lock);
+        this->setValue(callbackString);
+        this->updateTime = this->callbackTime;
+        this->updateSeq = this->callbackSeq;
+        epicsMutexUnlock(this->lock);
+        return asynSuccess;
+    }
+    for (;;) {
+        if (seq & 1) {
+            /* The monitor callback is writing the value */
+            epicsThreadSleep(0.);
+        } else {
+            epicsAtomicReadMemoryBarrier();
+            value = this->callbackValue;
+            time = this->callbackTime;
+            epicsAtomicReadMemoryBarrier();
+            seqAfter = epicsAtomicGetIntT(&this->callbackSeq);
+            if (seqAfter == seq) break;
+        }
+        seq = epicsAtomicGetIntT(&this->callbackSeq);
+    }
+    this->setValue(&value);
+    this->updateTime = time;
+    this->updateSeq = seq;
     return asynSuccess;
 }
 
+/** Returns the number of seconds since the monitor callback that provided the current value
+  * of the attribute, or -1 if the attribute has no value yet.
+  */
+double PVAttribute::updateAge()
+{
+    epicsTimeStamp now;
+
+    if ((this->updateTime.secPastEpoch == 0) && (this->updateTime.nsec == 0)) return -1.;
+    epicsTimeGetCurrent(&now);
+    return epicsTimeDiffInSeconds(&now, &this->updateTime);
+}
 
 
 static void connectCallbackC(struct connection_handler_args cha)
@@ -329,6 +389,7 @@ int PVAttribute::report(FILE *fp, int details)
     fprintf(fp, "    dbrType=%s\n", dbr_type_to_text(this->dbrType));
     fprintf(fp, "    chanId=%p\n", this->chanId);
     fprintf(fp, "    eventId=%p\n", this->eventId);
+    fprintf(fp, "    update age=%f\n", this->updateAge());
     return(ND_SUCCESS);
 }
     
@@ -14,6 +14,7 @@
 #include <cadef.h>
 #include <epicsMutex.h>
 #include <epicsEvent.h>
+#include <epicsTime.h>
 
 #include "NDArray.h"
 
@@ -21,6 +22,9 @@
 #define DBR_NATIVE -1
 
 /** Attribute that gets its value from an EPICS PV.
+  * The monitor callback stores each new value with a sequence count (a seqlock), so updateValue()
+  * takes no lock, and does nothing but read the count if the PV has not changed since the last frame.
+  * Only string values are protected by the mutex.
   */
 class PVAttribute : public NDAttribute {
 public:
@@ -29,6 +33,7 @@ public:
     ~PVAttribute();
     PVAttribute* copy(NDAttribute *pAttribute);
     virtual int updateValue();
+    double updateAge();
     /* These callbacks must be public because they are called from C */
     void connectCallback(struct connection_handler_args cha);
     void monitorCallback(struct event_handler_args cha);
@@ -40,8 +45,12 @@ private:
     chtype      dbrType;
     NDAttrValue callbackValue;
     char        *callbackString;
+    epicsTimeStamp callbackTime;
+    int         callbackSeq;     /* Odd while the monitor callback is writing callbackValue */
+    int         updateSeq;       /* callbackSeq of the value last copied by updateValue() */
+    epicsTimeStamp updateTime;   /* Time of the monitor callback that provided the current value */
     bool        connectedOnce;
-    epicsMutexId lock;
+    epicsMutexId lock;           /* Protects callbackString */
 };
 
 #endif /*INCPVAttributeH*/
@@ -482,6 +482,8 @@ done_macros:
   * Calls NDAttributeList::updateValues for this driver's attribute list, 
   * and then NDAttributeList::copy, to copy this driver's attribute 
   * list to pList, appending the values to that output attribute list.
+  * Sets NDAttributesMaxAge to the largest PVAttribute::updateAge() of the EPICS PV attributes,
+  * or -1 if none of them has a value.
   * \param[out] pList  The NDAttributeList to copy the attributes to.
   *
   * NOTE: Plugins must never call this function with a pointer to the attribute
@@ -492,8 +494,22 @@ asynStatus asynNDArrayDriver::getAttributes(NDAttributeList *pList)
 {
     //const char *functionName = "getAttributes";
     int status = asynSuccess;
+    NDAttribute *pAttribute;
+    PVAttribute *pPVAttribute;
+    NDAttrSource_t sourceType;
+    double age, maxAge = -1.;
     
     status = this->pAttributeList->updateValues();
+    for (pAttribute = this->pAttributeList->next(NULL); pAttribute;
+         pAttribute = this->pAttributeList->next(pAttribute)) {
+        pAttribute->getSourceInfo(&sourceType);
+        if (sourceType != NDAttrSourceEPICSPV) continue;
+        pPVAttribute = dynamic_cast<PVAttribute *>(pAttribute);
+        if (!pPVAttribute) continue;
+        age = pPVAttribute->updateAge();
+        if (age > maxAge) maxAge = age;
+    }
+    setDoubleParam(NDAttributesMaxAge, maxAge);
     status = this->pAttributeList->copy(pList);
     return (asynStatus) status;
 }
@@ -644,6 +660,12 @@ asynStatus asynNDArrayDriver::readInt32(asynUser *pasynUser, epicsInt32 *value)
         setIntegerParam(function, this->pNDArrayPool->getNumBuffers());
     } else if (function == NDPoolFreeBuffers) {
         setIntegerParam(function, this->pNDArrayPool->getNumFree());
+    } else if (function == NDPoolHits) {
+        setIntegerParam(function, (int)this->pNDArrayPool->getNumHits());
+    } else if (function == NDPoolMisses) {
+        setIntegerParam(function, (int)this->pNDArrayPool->getNumMisses());
+    } else if (function == NDPoolBlocked) {
+        setIntegerParam(function, (int)this->pNDArrayPool->getNumBlocked());
     }
 
     // Call base class
@@ -662,6 +684,8 @@ asynStatus asynNDArrayDriver::readFloat64(asynUser *pasynUser, epicsFloat64 *val
         setDoubleParam(function, this->pNDArrayPool->getMaxMemory() / MEGABYTE_DBL);
     } else if (function == NDPoolUsedMemory) {
         setDoubleParam(function, this->pNDArrayPool->getMemorySize() / MEGABYTE_DBL);
+    } else if (function == NDPoolPeakMemory) {
+        setDoubleParam(function, this->pNDArrayPool->getPeakMemorySize() / MEGABYTE_DBL);
     }
 
     // Call base class
@@ -820,6 +844,7 @@ asynNDArrayDriver::asynNDArrayDriver(const char *portName, int maxAddr, int maxB
     createParam(NDAttributesFileString,       asynParamOctet,           &NDAttributesFile);
     createParam(NDAttributesStatusString,     asynParamInt32,           &NDAttributesStatus);
     createParam(NDAttributesMacrosString,     asynParamOctet,           &NDAttributesMacros);
+    createParam(NDAttributesMaxAgeString,     asynParamFloat64,         &NDAttributesMaxAge);
     createParam(NDArrayDataString,            asynParamGenericPointer,  &NDArrayData);
     createParam(NDArrayCallbacksString,       asynParamInt32,           &NDArrayCallbacks);
     createParam(NDPoolMaxBuffersString,       asynParamInt32,           &NDPoolMaxBuffers);
@@ -828,6 +853,10 @@ asynNDArrayDriver::asynNDArrayDriver(const char *portName, int maxAddr, int maxB
     createParam(NDPoolMaxMemoryString,        asynParamFloat64,         &NDPoolMaxMemory);
     createParam(NDPoolUsedMemoryString,       asynParamFloat64,         &NDPoolUsedMemory);
     createParam(NDPoolEmptyFreeListString,    asynParamInt32,           &NDPoolEmptyFreeList);
+    createParam(NDPoolHitsString,             asynParamInt32,           &NDPoolHits);
+    createParam(NDPoolMissesString,           asynParamInt32,           &NDPoolMisses);
+    createParam(NDPoolBlockedString,          asynParamInt32,           &NDPoolBlocked);
+    createParam(NDPoolPeakMemoryString,       asynParamFloat64,         &NDPoolPeakMemory);
     createParam(NDNumQueuedArraysString,      asynParamInt32,           &NDNumQueuedArrays);
 
     /* Here we set the values of read-only parameters and of read/write parameters that cannot
@@ -874,11 +903,16 @@ asynNDArrayDriver::asynNDArrayDriver(const char *portName, int maxAddr, int maxB
     setStringParam (NDAttributesFile, "");
     setIntegerParam(NDAttributesStatus, NDAttributesFileNotFound);
     setStringParam (NDAttributesMacros, "");
+    setDoubleParam (NDAttributesMaxAge, -1.);
 
     setIntegerParam(NDPoolAllocBuffers, this->pNDArrayPool->getNumBuffers());
     setIntegerParam(NDPoolFreeBuffers, this->pNDArrayPool->getNumFree());
     setDoubleParam(NDPoolMaxMemory, 0);
     setDoubleParam(NDPoolUsedMemory, 0);
+    setIntegerParam(NDPoolHits, 0);
+    setIntegerParam(NDPoolMisses, 0);
+    setIntegerParam(NDPoolBlocked, 0);
+    setDoubleParam(NDPoolPeakMemory, 0);
 
     setIntegerParam(NDNumQueuedArrays, 0);
 
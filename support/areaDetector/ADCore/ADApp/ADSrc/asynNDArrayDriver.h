@@ -90,6 +90,7 @@ typedef enum {
 #define NDAttributesFileString    "ND_ATTRIBUTES_FILE"   /**< (asynOctet,    r/w) Attributes file name */
 #define NDAttributesStatusString  "ND_ATTRIBUTES_STATUS" /**< (asynInt32,    r/o) Attributes status */
 #define NDAttributesMacrosString  "ND_ATTRIBUTES_MACROS" /**< (asynOctet,    r/w) Attributes macros string */
+#define NDAttributesMaxAgeString  "ND_ATTRIBUTES_MAX_AGE" /**< (asynFloat64,  r/o) Age in seconds of the oldest EPICS PV attribute value */
 
 /* The detector array data */
 #define NDArrayDataString       "ARRAY_DATA"        /**< (asynGenericPointer,   r/w) NDArray data */
@@ -102,6 +103,10 @@ typedef enum {
 #define NDPoolMaxMemoryString       "POOL_MAX_MEMORY"
 #define NDPoolUsedMemoryString      "POOL_USED_MEMORY"
 #define NDPoolEmptyFreeListString   "POOL_EMPTY_FREELIST"
+#define NDPoolHitsString            "POOL_HITS"
+#define NDPoolMissesString          "POOL_MISSES"
+#define NDPoolBlockedString         "POOL_BLOCKED"
+#define NDPoolPeakMemoryString      "POOL_PEAK_MEMORY"
 
 /* Queued arrays */
 #define NDNumQueuedArraysString     "NUM_QUEUED_ARRAYS"
@@ -185,6 +190,7 @@ protected:
     int NDAttributesFile;
     int NDAttributesStatus;
     int NDAttributesMacros;
+    int NDAttributesMaxAge;
     int NDArrayData;
     int NDArrayCallbacks;
     int NDPoolMaxBuffers;
@@ -193,6 +199,10 @@ protected:
     int NDPoolMaxMemory;
     int NDPoolUsedMemory;
     int NDPoolEmptyFreeList;
+    int NDPoolHits;
+    int NDPoolMisses;
+    int NDPoolBlocked;
+    int NDPoolPeakMemory;
     int NDNumQueuedArrays;
 
     class NDArray **pArrays;             /**< An array of NDArray pointers used to store data in the driver */
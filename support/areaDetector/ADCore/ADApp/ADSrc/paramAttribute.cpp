@@ -122,7 +122,6 @@ paramAttribute::~paramAttribute()
 int paramAttribute::updateValue()
 {
     int status = asynSuccess;
-    std::string stringValue = "";
     epicsInt32 i32Value=0;
     epicsFloat64 f64Value=0.;
     static const char *functionName = "updateValue";
@@ -139,9 +138,10 @@ int paramAttribute::updateValue()
             this->setValue(&f64Value);
             break;
         case paramAttrTypeString:
+            // stringValue keeps its buffer between frames, so an unchanged string is not reallocated
             status = this->pDriver->getStringParam(this->paramAddr, this->paramId,
-                                                stringValue);
-            this->setValue(stringValue);
+                                                this->stringValue);
+            this->setValue(this->stringValue);
             break;
         default:
             break;
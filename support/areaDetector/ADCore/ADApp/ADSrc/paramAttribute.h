@@ -41,6 +41,7 @@ private:
     int         paramAddr;
     paramAttrType_t paramType;
     class asynNDArrayDriver *pDriver;
+    std::string stringValue;
 };
 
 #endif /*INCparamAttributeH*/
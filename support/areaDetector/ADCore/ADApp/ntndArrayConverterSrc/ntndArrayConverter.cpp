@@ -41,6 +41,18 @@ static const NDAttrDataType_t scalarToNDAttrDataType[pvString+1] = {
         NDAttrString,   // 11: pvString
 };
 
+// Maps NDDataType_t to the ScalarType of the value field
+static const ScalarType NDDataTypeToScalar[NDFloat64+1] = {
+        pvByte,     // 0: NDInt8
+        pvUByte,    // 1: NDUInt8
+        pvShort,    // 2: NDInt16
+        pvUShort,   // 3: NDUInt16
+        pvInt,      // 4: NDInt32
+        pvUInt,     // 5: NDUInt32
+        pvFloat,    // 6: NDFloat32
+        pvDouble,   // 7: NDFloat64
+};
+
 static const PVDataCreatePtr PVDC = getPVDataCreate();
 
 template <typename dataType>
@@ -68,6 +80,16 @@ ScalarType NTNDArrayConverter::getValueType (void)
     return ScalarTypeFunc::getScalarType(typeName);
 }
 
+// Compressed NTNDArrays are not decoded, so they are rejected rather than read as
+// bytes with the dimensions of the uncompressed data.
+void NTNDArrayConverter::checkCodec (void)
+{
+    string codecName(m_array->getCodec()->getSubField<PVString>("name")->get());
+
+    if(!codecName.empty())
+        throw std::runtime_error("cannot convert array compressed with codec " + codecName);
+}
+
 NDColorMode_t NTNDArrayConverter::getColorMode (void)
 {
     NDColorMode_t colorMode = NDColorModeMono;
@@ -91,6 +113,8 @@ NTNDArrayInfo_t NTNDArrayConverter::getInfo (void)
 {
     NTNDArrayInfo_t info = {0};
 
+    checkCodec();
+
     PVStructureArray::const_svector dims(m_array->getDimension()->view());
 
     info.ndims     = (int) dims.size();
@@ -193,6 +217,7 @@ NTNDArrayInfo_t NTNDArrayConverter::getInfo (void)
 
 void NTNDArrayConverter::toArray (NDArray *dest)
 {
+    checkCodec();
     toValue(dest);
     toDimensions(dest);
     toTimeStamp(dest);
@@ -212,8 +237,7 @@ void NTNDArrayConverter::fromArray (NDArray *src)
     fromTimeStamp(src);
     fromDataTimeStamp(src);
     fromAttributes(src);
-
-    m_array->getCodec()->getSubField<PVString>("name")->put("");
+    fromCodec(src);
 
     // getUniqueId not implemented yet
     // m_array->getUniqueId()->put(src->uniqueId);
@@ -387,9 +411,14 @@ void NTNDArrayConverter::fromValue (NDArray *src)
     count = arrayInfo.nElements;
     nBytes = arrayInfo.totalBytes;
 
-    m_array->getCompressedDataSize()->put(static_cast<int64>(nBytes));
     m_array->getUncompressedDataSize()->put(static_cast<int64>(nBytes));
 
+    // Compressed data are sent as bytes, see fromCodec()
+    if (!src->codec.name.empty())
+        count = nBytes = src->compressedSize;
+
+    m_array->getCompressedDataSize()->put(static_cast<int64>(nBytes));
+
     src->reserve();
     shared_vector<arrayValType> temp((srcDataType*)src->pData,
             freeNDArray<srcDataType>(src), 0, count);
@@ -401,6 +430,12 @@ void NTNDArrayConverter::fromValue (NDArray *src)
 
 void NTNDArrayConverter::fromValue (NDArray *src)
 {
+    if (!src->codec.name.empty())
+    {
+        fromValue<PVUByteArray, uint8_t>(src);
+        return;
+    }
+
     switch(src->dataType)
     {
     case NDInt8:    fromValue<PVByteArray,   int8_t>   (src); break;
@@ -414,6 +449,25 @@ void NTNDArrayConverter::fromValue (NDArray *src)
     }
 }
 
+// The codec name is empty for uncompressed arrays.  For compressed arrays the parameters
+// hold the ScalarType of the data after decompression.
+void NTNDArrayConverter::fromCodec (NDArray *src)
+{
+    PVStructurePtr codec(m_array->getCodec());
+    PVUnionPtr parameters(codec->getSubField<PVUnion>("parameters"));
+
+    codec->getSubField<PVString>("name")->put(src->codec.name);
+    if (src->codec.name.empty())
+    {
+        parameters->set(PVFieldPtr());
+        return;
+    }
+
+    PVIntPtr dataType(PVDC->createPVScalar<PVInt>());
+    dataType->put(static_cast<int32>(NDDataTypeToScalar[src->dataType]));
+    parameters->set(dataType);
+}
+
 void NTNDArrayConverter::fromDimensions (NDArray *src)
 {
     PVStructureArrayPtr dest(m_array->getDimension());
@@ -30,6 +30,7 @@ private:
     epics::nt::NTNDArrayPtr m_array;
 
     epics::pvData::ScalarType getValueType (void);
+    void checkCodec (void);
     NDColorMode_t getColorMode (void);
 
     template <typename arrayType>
@@ -50,6 +51,7 @@ private:
     void fromValue (NDArray *src);
     void fromValue (NDArray *src);
 
+    void fromCodec (NDArray *src);
     void fromDimensions (NDArray *src);
     void fromTimeStamp (NDArray *src);
     void fromDataTimeStamp (NDArray *src);
@@ -0,0 +1,465 @@
+/**
+ * NDFFTPlan.cpp
+ *
+ * Mixed-radix FFT of any length, for complex or real input, in float or double precision.
+ *
+ * The complex transform is a Stockham autosort FFT.  Each stage reads the data in natural order and
+ * writes a permuted copy to the other buffer, so there is no bit reversal.  The inner loop of each
+ * stage is over contiguous elements and the compiler vectorizes it.
+ *
+ * A real transform of even length n is computed as a complex transform of length n/2 of the even
+ * and odd elements, followed by one pass to separate the two halves.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <epicsTypes.h>
+
+#include <epicsExport.h>
+#include "NDFFTPlan.h"
+
+/* Some systems do not define M_PI in math.h */
+#ifndef M_PI
+  #define M_PI 3.14159265358979323846
+#endif
+
+/* On x86-64 Linux the butterflies are compiled for AVX-512, AVX2 and baseline x86-64,
+ * and the best version for the CPU is selected when the library is loaded. */
+#if defined(__GNUC__) && !defined(__clang__) && (__GNUC__ >= 8) && defined(__x86_64__) && defined(__linux__)
+  #define NDFFT_TARGET_CLONES __attribute__((target_clones("avx512f","avx2","default")))
+#else
+  #define NDFFT_TARGET_CLONES
+#endif
+
+/* In each stage of length r*m with stride s, element q + s*(p + k*m) of x goes into butterfly (p,q) as
+ * input k, and output j of the butterfly, times w^(j*p), is written to element q + s*(r*p + j) of y. */
+
+template <typename T>
+NDFFT_TARGET_CLONES
+static void radix2(size_t m, size_t s, const T *x, T *y, const T *tw)
+{
+    size_t p, q;
+
+    for (p=0; p<m; p++) {
+        const T wr = tw[2*p], wi = tw[2*p+1];
+        const T *x0 = x + 2*s*p, *x1 = x + 2*s*(p+m);
+        T *y0 = y + 2*s*(2*p), *y1 = y + 2*s*(2*p+1);
+        for (q=0; q<s; q++) {
+            T ar = x0[2*q], ai = x0[2*q+1];
+            T br = x1[2*q], bi = x1[2*q+1];
+            T dr = ar - br, di = ai - bi;
+            y0[2*q]   = ar + br;
+            y0[2*q+1] = ai + bi;
+            y1[2*q]   = dr*wr - di*wi;
+            y1[2*q+1] = dr*wi + di*wr;
+        }
+    }
+}
+
+template <typename T>
+NDFFT_TARGET_CLONES
+static void radix3(size_t m, size_t s, const T *x, T *y, const T *tw)
+{
+    const T sin60 = (T)0.86602540378443864676;
+    size_t p, q;
+
+    for (p=0; p<m; p++) {
+        const T w1r = tw[4*p],   w1i = tw[4*p+1];
+        const T w2r = tw[4*p+2], w2i = tw[4*p+3];
+        const T *x0 = x + 2*s*p, *x1 = x + 2*s*(p+m), *x2 = x + 2*s*(p+2*m);
+        T *y0 = y + 2*s*(3*p), *y1 = y + 2*s*(3*p+1), *y2 = y + 2*s*(3*p+2);
+        for (q=0; q<s; q++) {
+            T a0r = x0[2*q], a0i = x0[2*q+1];
+            T a1r = x1[2*q], a1i = x1[2*q+1];
+            T a2r = x2[2*q], a2i = x2[2*q+1];
+            T t1r = a1r + a2r, t1i = a1i + a2i;
+            T t2r = a0r - (T)0.5*t1r, t2i = a0i - (T)0.5*t1i;
+            T t3r = sin60*(a1i - a2i), t3i = -sin60*(a1r - a2r);
+            T b1r = t2r + t3r, b1i = t2i + t3i;
+            T b2r = t2r - t3r, b2i = t2i - t3i;
+            y0[2*q]   = a0r + t1r;
+            y0[2*q+1] = a0i + t1i;
+            y1[2*q]   = b1r*w1r - b1i*w1i;
+            y1[2*q+1] = b1r*w1i + b1i*w1r;
+            y2[2*q]   = b2r*w2r - b2i*w2i;
+            y2[2*q+1] = b2r*w2i + b2i*w2r;
+        }
+    }
+}
+
+template <typename T>
+NDFFT_TARGET_CLONES
+static void radix4(size_t m, size_t s, const T *x, T *y, const T *tw)
+{
+    size_t p, q;
+
+    for (p=0; p<m; p++) {
+        const T w1r = tw[6*p],   w1i = tw[6*p+1];
+        const T w2r = tw[6*p+2], w2i = tw[6*p+3];
+        const T w3r = tw[6*p+4], w3i = tw[6*p+5];
+        const T *x0 = x + 2*s*p, *x1 = x + 2*s*(p+m), *x2 = x + 2*s*(p+2*m), *x3 = x + 2*s*(p+3*m);
+        T *y0 = y + 2*s*(4*p), *y1 = y + 2*s*(4*p+1), *y2 = y + 2*s*(4*p+2), *y3 = y + 2*s*(4*p+3);
+        for (q=0; q<s; q++) {
+            T a0r = x0[2*q], a0i = x0[2*q+1];
+            T a1r = x1[2*q], a1i = x1[2*q+1];
+            T a2r = x2[2*q], a2i = x2[2*q+1];
+            T a3r = x3[2*q], a3i = x3[2*q+1];
+            T t0r = a0r + a2r, t0i = a0i + a2i;
+            T t1r = a0r - a2r, t1i = a0i - a2i;
+            T t2r = a1r + a3r, t2i = a1i + a3i;
+            T t3r = a1r - a3r, t3i = a1i - a3i;
+            /* b1 = t1 - i*t3, b3 = t1 + i*t3 */
+            T b1r = t1r + t3i, b1i = t1i - t3r;
+            T b2r = t0r - t2r, b2i = t0i - t2i;
+            T b3r = t1r - t3i, b3i = t1i + t3r;
+            y0[2*q]   = t0r + t2r;
+            y0[2*q+1] = t0i + t2i;
+            y1[2*q]   = b1r*w1r - b1i*w1i;
+            y1[2*q+1] = b1r*w1i + b1i*w1r;
+            y2[2*q]   = b2r*w2r - b2i*w2i;
+            y2[2*q+1] = b2r*w2i + b2i*w2r;
+            y3[2*q]   = b3r*w3r - b3i*w3i;
+            y3[2*q+1] = b3r*w3i + b3i*w3r;
+        }
+    }
+}
+
+template <typename T>
+NDFFT_TARGET_CLONES
+static void radix5(size_t m, size_t s, const T *x, T *y, const T *tw)
+{
+    const T c1 = (T) 0.30901699437494742410, s1 = (T)0.95105651629515357212;
+    const T c2 = (T)-0.80901699437494742410, s2 = (T)0.58778525229247312917;
+    size_t p, q;
+
+    for (p=0; p<m; p++) {
+        const T *pw = tw + 8*p;
+        const T *x0 = x + 2*s*p, *x1 = x + 2*s*(p+m), *x2 = x + 2*s*(p+2*m);
+        const T *x3 = x + 2*s*(p+3*m), *x4 = x + 2*s*(p+4*m);
+        T *y0 = y + 2*s*(5*p), *y1 = y + 2*s*(5*p+1), *y2 = y + 2*s*(5*p+2);
+        T *y3 = y + 2*s*(5*p+3), *y4 = y + 2*s*(5*p+4);
+        for (q=0; q<s; q++) {
+            T a0r = x0[2*q], a0i = x0[2*q+1];
+            T t1r = x1[2*q] + x4[2*q], t1i = x1[2*q+1] + x4[2*q+1];
+            T t2r = x2[2*q] + x3[2*q], t2i = x2[2*q+1] + x3[2*q+1];
+            T t3r = x1[2*q] - x4[2*q], t3i = x1[2*q+1] - x4[2*q+1];
+            T t4r = x2[2*q] - x3[2*q], t4i = x2[2*q+1] - x3[2*q+1];
+            T t5r = a0r + c1*t1r + c2*t2r, t5i = a0i + c1*t1i + c2*t2i;
+            T t6r = a0r + c2*t1r + c1*t2r, t6i = a0i + c2*t1i + c1*t2i;
+            T t7r = s1*t3r + s2*t4r, t7i = s1*t3i + s2*t4i;
+            T t8r = s2*t3r - s1*t4r, t8i = s2*t3i - s1*t4i;
+            /* b1 = t5 - i*t7, b4 = t5 + i*t7, b2 = t6 - i*t8, b3 = t6 + i*t8 */
+            T b1r = t5r + t7i, b1i = t5i - t7r;
+            T b4r = t5r - t7i, b4i = t5i + t7r;
+            T b2r = t6r + t8i, b2i = t6i - t8r;
+            T b3r = t6r - t8i, b3i = t6i + t8r;
+            y0[2*q]   = a0r + t1r + t2r;
+            y0[2*q+1] = a0i + t1i + t2i;
+            y1[2*q]   = b1r*pw[0] - b1i*pw[1];
+            y1[2*q+1] = b1r*pw[1] + b1i*pw[0];
+            y2[2*q]   = b2r*pw[2] - b2i*pw[3];
+            y2[2*q+1] = b2r*pw[3] + b2i*pw[2];
+            y3[2*q]   = b3r*pw[4] - b3i*pw[5];
+            y3[2*q+1] = b3r*pw[5] + b3i*pw[4];
+            y4[2*q]   = b4r*pw[6] - b4i*pw[7];
+            y4[2*q+1] = b4r*pw[7] + b4i*pw[6];
+        }
+    }
+}
+
+/** Any odd radix up to NDFFT_MAX_RADIX; roots holds exp(-2*pi*i*k/r) for k<r */
+template <typename T>
+static void radixGeneric(size_t r, size_t m, size_t s, const T *x, T *y, const T *tw, const T *roots)
+{
+    T a[2*NDFFT_MAX_RADIX];
+    size_t p, q, j, k;
+
+    for (p=0; p<m; p++) {
+        for (q=0; q<s; q++) {
+            for (k=0; k<r; k++) {
+                a[2*k]   = x[2*(q + s*(p + k*m))];
+                a[2*k+1] = x[2*(q + s*(p + k*m)) + 1];
+            }
+            for (j=0; j<r; j++) {
+                T br = 0, bi = 0;
+                size_t jk = 0;
+                for (k=0; k<r; k++) {
+                    br += a[2*k]*roots[2*jk]   - a[2*k+1]*roots[2*jk+1];
+                    bi += a[2*k]*roots[2*jk+1] + a[2*k+1]*roots[2*jk];
+                    jk += j;
+                    if (jk >= r) jk -= r;
+                }
+                T *py = y + 2*(q + s*(r*p + j));
+                if (j == 0) {
+                    py[0] = br;
+                    py[1] = bi;
+                } else {
+                    const T *pw = tw + 2*(p*(r-1) + j-1);
+                    py[0] = br*pw[0] - bi*pw[1];
+                    py[1] = br*pw[1] + bi*pw[0];
+                }
+            }
+        }
+    }
+}
+
+/** Separates the complex transform z of the n/2 even and odd elements into the first n/2+1 points of
+  * the transform of the real data: X[k] = (Z[k] + conj(Z[h-k]))/2 - i*w^k*(Z[k] - conj(Z[h-k]))/2 */
+template <typename T>
+NDFFT_TARGET_CLONES
+static void realSplit(size_t h, const T *z, T *out, const T *tw)
+{
+    size_t k;
+
+    out[0]     = z[0] + z[1];
+    out[1]     = 0;
+    out[2*h]   = z[0] - z[1];
+    out[2*h+1] = 0;
+    for (k=1; k<h; k++) {
+        T zr = z[2*k],     zi = z[2*k+1];
+        T cr = z[2*(h-k)], ci = -z[2*(h-k)+1];
+        T er = (T)0.5*(zr + cr), ei = (T)0.5*(zi + ci);
+        T dr = (T)0.5*(zr - cr), di = (T)0.5*(zi - ci);
+        /* o = -i*d */
+        T or_ = di, oi = -dr;
+        out[2*k]   = er + or_*tw[2*k] - oi*tw[2*k+1];
+        out[2*k+1] = ei + or_*tw[2*k+1] + oi*tw[2*k];
+    }
+}
+
+/** exp(-2*pi*i*num/den), computed in double precision */
+static void twiddle(size_t num, size_t den, double *pr, double *pi)
+{
+    double theta = -2.*M_PI*(double)(num % den)/(double)den;
+    *pr = cos(theta);
+    *pi = sin(theta);
+}
+
+/** Creates a plan.
+  * \param[in] n The number of points.
+  * \param[in] real If true the plan is for forwardReal(), otherwise for forward(). */
+template <typename T>
+NDFFTPlan<T>::NDFFTPlan(size_t n, bool real)
+    : n_(n), real_(real), workSize_(0), pHalf_(0), pBluestein_(0)
+{
+    size_t k;
+
+    if (real && (n % 2 == 0) && (n > 0)) {
+        size_t h = n/2;
+        pHalf_ = new NDFFTPlan<T>(h, false);
+        realTwiddles_.resize(2*(h+1));
+        for (k=0; k<=h; k++) {
+            double wr, wi;
+            twiddle(k, n, &wr, &wi);
+            realTwiddles_[2*k]   = (T)wr;
+            realTwiddles_[2*k+1] = (T)wi;
+        }
+        workSize_ = n + pHalf_->getWorkSize();
+        return;
+    }
+    createStages();
+    /* Real input of odd length is copied to a complex buffer */
+    if (real) workSize_ += 2*n;
+}
+
+template <typename T>
+NDFFTPlan<T>::~NDFFTPlan()
+{
+    delete pHalf_;
+    delete pBluestein_;
+}
+
+template <typename T>
+void NDFFTPlan<T>::createStages()
+{
+    std::vector<size_t> factors;
+    size_t remaining = n_, f, j, p, i;
+
+    if (n_ < 1) return;
+    while (remaining % 4 == 0) { factors.push_back(4); remaining /= 4; }
+    while (remaining % 2 == 0) { factors.push_back(2); remaining /= 2; }
+    for (f=3; (f <= NDFFT_MAX_RADIX) && (remaining > 1); f+=2) {
+        while (remaining % f == 0) { factors.push_back(f); remaining /= f; }
+    }
+    if (remaining > 1) {
+        createBluestein();
+        return;
+    }
+
+    size_t nCurrent = n_;
+    for (i=0; i<factors.size(); i++) {
+        Stage stage;
+        stage.radix = factors[i];
+        stage.m = nCurrent / stage.radix;
+        stage.twiddles.resize(2*stage.m*(stage.radix-1));
+        for (p=0; p<stage.m; p++) {
+            for (j=1; j<stage.radix; j++) {
+                double wr, wi;
+                twiddle(j*p, nCurrent, &wr, &wi);
+                stage.twiddles[2*(p*(stage.radix-1) + j-1)]   = (T)wr;
+                stage.twiddles[2*(p*(stage.radix-1) + j-1)+1] = (T)wi;
+            }
+        }
+        stage.rootsOffset = 0;
+        if (stage.radix > 5) {
+            /* The roots for a generic radix are stored once, for the first stage with that radix */
+            if (!stages_.empty() && (stages_.back().radix == stage.radix)) {
+                stage.rootsOffset = stages_.back().rootsOffset;
+            } else {
+                stage.rootsOffset = roots_.size();
+                roots_.resize(stage.rootsOffset + 2*stage.radix);
+                for (j=0; j<stage.radix; j++) {
+                    double wr, wi;
+                    twiddle(j, stage.radix, &wr, &wi);
+                    roots_[stage.rootsOffset + 2*j]   = (T)wr;
+                    roots_[stage.rootsOffset + 2*j+1] = (T)wi;
+                }
+            }
+        }
+        stages_.push_back(stage);
+        nCurrent = stage.m;
+    }
+    workSize_ = 2*n_;
+}
+
+/** Bluestein's algorithm computes the transform as a convolution with a chirp, using a power of 2 plan */
+template <typename T>
+void NDFFTPlan<T>::createBluestein()
+{
+    size_t m = 1, k;
+
+    while (m < 2*n_-1) m *= 2;
+    pBluestein_ = new NDFFTPlan<T>(m, false);
+    chirp_.resize(2*n_);
+    chirpFFT_.assign(2*m, (T)0);
+    for (k=0; k<n_; k++) {
+        /* exp(-i*pi*k^2/n); k^2 is reduced modulo 2n to keep the angle accurate */
+        double wr, wi;
+        epicsUInt64 k2 = ((epicsUInt64)k * (epicsUInt64)k) % (2*(epicsUInt64)n_);
+        twiddle((size_t)k2, 2*n_, &wr, &wi);
+        chirp_[2*k]   = (T)wr;
+        chirp_[2*k+1] = (T)wi;
+        chirpFFT_[2*k]   = (T)wr;
+        chirpFFT_[2*k+1] = (T)-wi;
+        if (k > 0) {
+            chirpFFT_[2*(m-k)]   = (T)wr;
+            chirpFFT_[2*(m-k)+1] = (T)-wi;
+        }
+    }
+    std::vector<T> work(pBluestein_->getWorkSize());
+    pBluestein_->forward(&chirpFFT_[0], &work[0]);
+    workSize_ = 2*m + pBluestein_->getWorkSize();
+}
+
+template <typename T>
+void NDFFTPlan<T>::bluestein(T *data, T *work) const
+{
+    size_t m = pBluestein_->getSize(), k;
+    T *a = work, *subWork = work + 2*m;
+    T scale = (T)(1./m);
+
+    for (k=0; k<n_; k++) {
+        T xr = data[2*k], xi = data[2*k+1];
+        a[2*k]   = xr*chirp_[2*k] - xi*chirp_[2*k+1];
+        a[2*k+1] = xr*chirp_[2*k+1] + xi*chirp_[2*k];
+    }
+    memset(a + 2*n_, 0, 2*(m-n_)*sizeof(T));
+    pBluestein_->forward(a, subWork);
+    /* Multiply by the transform of the chirp, and take the conjugate so the forward plan
+     * computes the inverse transform */
+    for (k=0; k<m; k++) {
+        T ar = a[2*k], ai = a[2*k+1];
+        a[2*k]   =   ar*chirpFFT_[2*k]   - ai*chirpFFT_[2*k+1];
+        a[2*k+1] = -(ar*chirpFFT_[2*k+1] + ai*chirpFFT_[2*k]);
+    }
+    pBluestein_->forward(a, subWork);
+    for (k=0; k<n_; k++) {
+        T ar = a[2*k]*scale, ai = -a[2*k+1]*scale;
+        data[2*k]   = ar*chirp_[2*k] - ai*chirp_[2*k+1];
+        data[2*k+1] = ar*chirp_[2*k+1] + ai*chirp_[2*k];
+    }
+}
+
+/** Returns the number of points. */
+template <typename T>
+size_t NDFFTPlan<T>::getSize() const
+{
+    return n_;
+}
+
+/** Returns true if the plan is for forwardReal(). */
+template <typename T>
+bool NDFFTPlan<T>::isReal() const
+{
+    return real_;
+}
+
+/** Returns the number of elements of type T needed in the work buffer. */
+template <typename T>
+size_t NDFFTPlan<T>::getWorkSize() const
+{
+    return workSize_;
+}
+
+/** Computes the forward transform of complex data in place.
+  * \param[in,out] data n complex points.
+  * \param[in] work Work buffer of getWorkSize() elements. */
+template <typename T>
+void NDFFTPlan<T>::forward(T *data, T *work) const
+{
+    T *x = data, *y = work, *pTemp;
+    const T *roots = roots_.empty() ? 0 : &roots_[0];
+    size_t s = 1, i;
+
+    if (pBluestein_) {
+        bluestein(data, work);
+        return;
+    }
+    for (i=0; i<stages_.size(); i++) {
+        const Stage &stage = stages_[i];
+        const T *tw = stage.twiddles.empty() ? 0 : &stage.twiddles[0];
+        switch (stage.radix) {
+            case 2: radix2<T>(stage.m, s, x, y, tw); break;
+            case 3: radix3<T>(stage.m, s, x, y, tw); break;
+            case 4: radix4<T>(stage.m, s, x, y, tw); break;
+            case 5: radix5<T>(stage.m, s, x, y, tw); break;
+            default: radixGeneric<T>(stage.radix, stage.m, s, x, y, tw, roots + stage.rootsOffset); break;
+        }
+        pTemp = x; x = y; y = pTemp;
+        s *= stage.radix;
+    }
+    if (x != data) memcpy(data, x, 2*n_*sizeof(T));
+}
+
+/** Computes the first n/2+1 points of the forward transform of real data; the others are
+  * the complex conjugates of these.
+  * \param[in] in n real points.
+  * \param[out] out n/2+1 complex points.
+  * \param[in] work Work buffer of getWorkSize() elements. */
+template <typename T>
+void NDFFTPlan<T>::forwardReal(const T *in, T *out, T *work) const
+{
+    size_t k;
+
+    if (n_ < 1) return;
+    if (pHalf_) {
+        size_t h = n_/2;
+        /* The even and odd points are the real and imaginary parts of n/2 complex points */
+        memcpy(work, in, n_*sizeof(T));
+        pHalf_->forward(work, work + n_);
+        realSplit<T>(h, work, out, &realTwiddles_[0]);
+        return;
+    }
+    T *data = work, *subWork = work + 2*n_;
+    for (k=0; k<n_; k++) {
+        data[2*k]   = in[k];
+        data[2*k+1] = 0;
+    }
+    forward(data, subWork);
+    memcpy(out, data, 2*(n_/2+1)*sizeof(T));
+}
+
+template class NDFFTPlan<epicsFloat32>;
+template class NDFFTPlan<epicsFloat64>;
@@ -0,0 +1,62 @@
+/**
+ * NDFFTPlan.h
+ *
+ * Mixed-radix FFT of any length, for complex or real input, in float or double precision.
+ *
+ * A plan is created once for each length and then used for any number of transforms.
+ * The plan is not changed by a transform, so several threads can use one plan at once,
+ * each with its own work buffer.
+ */
+
+#ifndef NDFFTPlan_H
+#define NDFFTPlan_H
+
+#include <stddef.h>
+#include <vector>
+
+#include <shareLib.h>
+
+/** FFT plan for one length.  Lengths whose prime factors are all <= NDFFT_MAX_RADIX are computed
+  * with a Stockham mixed-radix algorithm using radix 4, 2, 3, 5 and generic odd radix stages.
+  * Other lengths use Bluestein's algorithm with a power of 2 plan.
+  * Complex data are interleaved real and imaginary parts. */
+template <typename T>
+class epicsShareClass NDFFTPlan {
+public:
+    NDFFTPlan(size_t n, bool real);
+    ~NDFFTPlan();
+    size_t getSize() const;
+    bool isReal() const;
+    size_t getWorkSize() const;
+    void forward(T *data, T *work) const;
+    void forwardReal(const T *in, T *out, T *work) const;
+
+private:
+    struct Stage {
+        size_t radix;
+        size_t m;
+        std::vector<T> twiddles;    /**< w^(j*p) for p<m and 0<j<radix, w=exp(-2*pi*i/(radix*m)) */
+        size_t rootsOffset;         /**< Offset of the roots in roots_ for radix > 5 */
+    };
+    void createStages();
+    void createBluestein();
+    void bluestein(T *data, T *work) const;
+    NDFFTPlan(const NDFFTPlan&);
+    NDFFTPlan& operator=(const NDFFTPlan&);
+
+    size_t n_;
+    bool real_;
+    size_t workSize_;
+    std::vector<Stage> stages_;
+    std::vector<T> roots_;          /**< exp(-2*pi*i*k/r) for k<r for the radix > 5 stages */
+    NDFFTPlan<T> *pHalf_;           /**< Complex plan of n/2 for real input of even length */
+    std::vector<T> realTwiddles_;   /**< exp(-2*pi*i*k/n) for k<=n/2 for real input of even length */
+    NDFFTPlan<T> *pBluestein_;      /**< Power of 2 complex plan for Bluestein's algorithm */
+    std::vector<T> chirp_;
+    std::vector<T> chirpFFT_;
+};
+
+/** Largest prime factor computed with a radix stage; longer lengths with larger factors use Bluestein */
+#define NDFFT_MAX_RADIX 64
+
+#endif // NDFFTPlan_H
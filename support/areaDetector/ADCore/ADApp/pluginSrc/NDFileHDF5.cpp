@@ -47,6 +47,9 @@ enum HDF5Compression_t {HDF5CompressNone=0, HDF5CompressNumBits, HDF5CompressSZi
 
 #define DIMSREPORTSIZE 512
 #define DIMNAMESIZE 40
+#define MIN_STACK_SIZE 2097152
+#define DIRECT_IO_BLOCK_SIZE 4096
+#define DIRECT_IO_COPY_BUFFER_SIZE 16777216
 #define ALIGNMENT_BOUNDARY 1048576
 #define INFINITE_FRAMES_CAPTURE 10000 /* Used to calculate istorek (the size of the chunk index binar search tree) when capturing infinite number of frames */
 
@@ -72,6 +75,22 @@ static herr_t cFlushCallback(hid_t objectID, void *data)
 }
 #endif
 
+/** Chunks of one frame encoded by the threads of NDPluginDriver::runTiles */
+typedef struct {
+  NDFileHDF5ChunkWriter *pWriter;
+  const char *pData;
+  NDFileHDF5ChunkFrame_t *pFrame;
+} NDFileHDF5Encode_t;
+
+static void encodeChunks(void *pvt, int first, int count)
+{
+  NDFileHDF5Encode_t *pEncode = (NDFileHDF5Encode_t *)pvt;
+  for (int i=first; i<first+count; i++){
+    // A chunk that fails is left with pData=NULL
+    pEncode->pWriter->encodeChunk(pEncode->pData, i, &pEncode->pFrame->chunks[i]);
+  }
+}
+
 const char *NDFileHDF5::str_NDFileHDF5_extraDimSize[MAXEXTRADIMS] = {
     "HDF5_extraDimSizeN",
     "HDF5_extraDimSizeX",
@@ -264,6 +283,9 @@ asynStatus NDFileHDF5::openFile(const char *fileName, NDFileOpenMode_t openMode,
     return asynError;
   }
 
+  // Choose between direct chunk writes and H5Dwrite for this file
+  this->configureChunkWriter(pArray);
+
   if (storeAttributes == 1){
     this->createAttributeDataset(pArray);
     this->writeAttributeDataset(hdf5::OnFileOpen, 0, NULL);
@@ -1246,6 +1268,7 @@ asynStatus NDFileHDF5::writeFile(NDArray *pArray)
   epicsInt32 numCaptured;
   double dt=0.0, period=0.0, runtime = 0.0;
   int extradims = 0;
+  bool flushNow = false;
   hsize_t offsets[MAXEXTRADIMS] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
   static const char *functionName = "writeFile";
 
@@ -1274,6 +1297,8 @@ asynStatus NDFileHDF5::writeFile(NDArray *pArray)
   getStringParam(NDFileHDF5_posName[7], MAX_STRING_SIZE, posName[7]);
   getStringParam(NDFileHDF5_posName[8], MAX_STRING_SIZE, posName[8]);
   getStringParam(NDFileHDF5_posName[9], MAX_STRING_SIZE, posName[9]);
+  // We are in SWMR mode so flush the dataset on every <flush> frames
+  flushNow = checkForSWMRMode() && ((numCaptured+1) % flush == 0);
   this->unlock();
 
   if (numCaptured == 1) epicsTimeGetCurrent(&this->firstFrame);
@@ -1381,13 +1406,24 @@ asynStatus NDFileHDF5::writeFile(NDArray *pArray)
   }
 
   if (status == asynSuccess){
-    status = this->detDataMap[destination]->writeFile(pArray, this->datatype, this->dataspace, this->framesize);
+    if (this->directChunkActive){
+      // The chunk writer also flushes the dataset, after the chunks of this frame are written
+      status = this->writeChunks(this->detDataMap[destination], pArray, flushNow);
+    } else if (!pArray->codec.name.empty()){
+      asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                "%s::%s ERROR: arrays compressed with %s can only be written with DirectChunkWrite\n",
+                driverName, functionName, pArray->codec.name.c_str());
+      status = asynError;
+    } else {
+      status = this->detDataMap[destination]->writeFile(pArray, this->datatype, this->dataspace, this->framesize);
+    }
   }
   if (status != asynSuccess){
     // If dataset creation fails then close file and abort as all following writes will fail as well
     asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
               "%s::%s ERROR: could not write to dataset. Aborting\n",
               driverName, functionName);
+    this->pChunkWriter->drain();
     hdfstatus = H5Sclose(this->dataspace);
     if (hdfstatus){
       asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
@@ -1420,6 +1456,8 @@ asynStatus NDFileHDF5::writeFile(NDArray *pArray)
     return asynError;
   }
 
+  // Frames queued for the chunk writer thread may be being written
+  this->pChunkWriter->lock();
   if (storeAttributes == 1){
     if (dimAttDataset == 1){
       // If attribute datasets are following dimensions of the main dataset
@@ -1433,6 +1471,7 @@ asynStatus NDFileHDF5::writeFile(NDArray *pArray)
       status = this->writeAttributeDataset(hdf5::OnFrame, 0, offsets);
     }
     if (status != asynSuccess){
+      this->pChunkWriter->unlock();
       return status;
     }
   }
@@ -1454,14 +1493,13 @@ asynStatus NDFileHDF5::writeFile(NDArray *pArray)
     this->performancePtr++;
   }
 
-  if (checkForSWMRMode()){
-    if ((numCaptured+1) % flush == 0) {
-      // We are in SWMR mode so flush the dataset on every <flush> frames
-      status = this->detDataMap[destination]->flushDataset();
-    }
+  if (flushNow && !this->directChunkActive){
+    status = this->detDataMap[destination]->flushDataset();
   }
+  this->pChunkWriter->unlock();
 
   if (status != asynSuccess){
+    this->pChunkWriter->drain();
     hdfstatus = H5Fclose(this->file);
     if (hdfstatus){
       asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
@@ -1480,6 +1518,7 @@ asynStatus NDFileHDF5::writeFile(NDArray *pArray)
 
     this->nextRecord++;
   }
+  if (this->directChunkActive) this->updateChunkStatistics();
   return status;
 }
 
@@ -1508,6 +1547,15 @@ asynStatus NDFileHDF5::closeFile()
     return asynSuccess;
   }
 
+  // Wait for the chunk writer thread to write all of the queued frames
+  if (this->pChunkWriter->drain() != asynSuccess){
+    asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+              "%s::%s ERROR: not all frames were written to the file\n",
+              driverName, functionName);
+  }
+  if (this->directChunkActive) this->updateChunkStatistics();
+  this->directChunkActive = false;
+
   this->lock();
   getIntegerParam(NDFileHDF5_storeAttributes, &storeAttributes);
   getIntegerParam(NDFileHDF5_storePerformance, &storePerformance);
@@ -1734,11 +1782,24 @@ asynStatus NDFileHDF5::writeInt32(asynUser *pasynUser, epicsInt32 value)
         setIntegerParam(function, oldvalue);
       }
   } else if (function == NDFileHDF5_storeAttributes ||
-         function == NDFileHDF5_storePerformance) {
+         function == NDFileHDF5_storePerformance ||
+         function == NDFileHDF5_directChunkWrite ||
+         function == NDFileHDF5_directIO) {
     if (this->file != 0) {
       status = asynError;
       setIntegerParam(function, oldvalue);
     }
+  } else if (function == NDFileHDF5_writeQueueSize) {
+    // Not allowed to change the queue size once the file is opened
+    if (this->file != 0 || value < 0) {
+      status = asynError;
+      setIntegerParam(function, oldvalue);
+    }
+  } else if (function == NDFileHDF5_compressThreads) {
+    if (value < 1) {
+      status = asynError;
+      setIntegerParam(function, oldvalue);
+    }
   } else if (function == NDFileHDF5_compressionType) {
     if (this->file != 0)
     {
@@ -2044,6 +2105,16 @@ NDFileHDF5::NDFileHDF5(const char *portName, int queueSize, int blockingCallback
   this->createParam(str_NDFileHDF5_SWMRSupported,   asynParamInt32,   &NDFileHDF5_SWMRSupported);
   this->createParam(str_NDFileHDF5_SWMRMode,        asynParamInt32,   &NDFileHDF5_SWMRMode);
   this->createParam(str_NDFileHDF5_SWMRRunning,     asynParamInt32,   &NDFileHDF5_SWMRRunning);
+  this->createParam(str_NDFileHDF5_directChunkWrite, asynParamInt32,  &NDFileHDF5_directChunkWrite);
+  this->createParam(str_NDFileHDF5_directChunkActive,asynParamInt32,  &NDFileHDF5_directChunkActive);
+  this->createParam(str_NDFileHDF5_compressThreads, asynParamInt32,   &NDFileHDF5_compressThreads);
+  this->createParam(str_NDFileHDF5_writeQueueSize,  asynParamInt32,   &NDFileHDF5_writeQueueSize);
+  this->createParam(str_NDFileHDF5_writeQueueUsed,  asynParamInt32,   &NDFileHDF5_writeQueueUsed);
+  this->createParam(str_NDFileHDF5_directIO,        asynParamInt32,   &NDFileHDF5_directIO);
+  this->createParam(str_NDFileHDF5_compressRate,    asynParamFloat64, &NDFileHDF5_compressRate);
+  this->createParam(str_NDFileHDF5_compressRatio,   asynParamFloat64, &NDFileHDF5_compressRatio);
+  this->createParam(str_NDFileHDF5_writeRate,       asynParamFloat64, &NDFileHDF5_writeRate);
+  this->createParam(str_NDFileHDF5_flushTime,       asynParamFloat64, &NDFileHDF5_flushTime);
 
   setIntegerParam(NDFileHDF5_nRowChunks,      0);
   setIntegerParam(NDFileHDF5_nColChunks,      0);
@@ -2084,6 +2155,16 @@ NDFileHDF5::NDFileHDF5(const char *portName, int queueSize, int blockingCallback
   setIntegerParam(NDFileHDF5_SWMRCbCounter,   0);
   setIntegerParam(NDFileHDF5_SWMRMode,        0);
   setIntegerParam(NDFileHDF5_SWMRRunning,     0);
+  setIntegerParam(NDFileHDF5_directChunkWrite, 0);
+  setIntegerParam(NDFileHDF5_directChunkActive, 0);
+  setIntegerParam(NDFileHDF5_compressThreads, 1);
+  setIntegerParam(NDFileHDF5_writeQueueSize,  0);
+  setIntegerParam(NDFileHDF5_writeQueueUsed,  0);
+  setIntegerParam(NDFileHDF5_directIO,        0);
+  setDoubleParam (NDFileHDF5_compressRate,    0.0);
+  setDoubleParam (NDFileHDF5_compressRatio,   0.0);
+  setDoubleParam (NDFileHDF5_writeRate,       0.0);
+  setDoubleParam (NDFileHDF5_flushTime,       0.0);
   if (checkForSWMRSupported()){
     setIntegerParam(NDFileHDF5_SWMRSupported, 1);
   } else {
@@ -2114,6 +2195,8 @@ NDFileHDF5::NDFileHDF5(const char *portName, int queueSize, int blockingCallback
   //printf("plugin type and version: %s\n", plugin_type );
   setStringParam(NDPluginDriverPluginType, plugin_type);
   this->supportsMultipleArrays = 1;
+  // Arrays from NDPluginCodec are written with direct chunk writes
+  this->compressionAware_ = true;
   this->pAttributeId = NULL;
   this->pFileAttributes = new NDAttributeList;
 
@@ -2135,6 +2218,17 @@ NDFileHDF5::NDFileHDF5(const char *portName, int queueSize, int blockingCallback
 
   this->hostname = (char*)calloc(MAXHOSTNAMELEN, sizeof(char));
   gethostname(this->hostname, MAXHOSTNAMELEN);
+
+  // The chunk writer thread makes HDF5 calls so it needs the same stack size as the plugin thread
+  std::string writerName = std::string(portName) + "_ChunkWriter";
+  this->pChunkWriter = new NDFileHDF5ChunkWriter(this->pasynUserSelf, writerName,
+                                                 stackSize < MIN_STACK_SIZE ? MIN_STACK_SIZE : stackSize);
+  this->directChunkActive = false;
+}
+
+NDFileHDF5::~NDFileHDF5()
+{
+  delete this->pChunkWriter;
 }
 
 /** Calculate the total number of frames that the current configured dimensions can contain.
@@ -3047,6 +3141,166 @@ asynStatus NDFileHDF5::configureCompression()
   return status;
 }
 
+/** Decide whether the frames of a new file are written as whole chunks with NDFileHDF5ChunkWriter.
+ * This is only possible when every chunk holds part of a single frame and the filter pipeline
+ * can be reproduced outside of the HDF5 library; otherwise frames are written with H5Dwrite.
+ * \param[in] pArray - The first NDArray of the file.
+ */
+asynStatus NDFileHDF5::configureChunkWriter(NDArray *pArray)
+{
+  int directChunkWrite = 0;
+  int compressionScheme = HDF5CompressNone;
+  int zLevel = 0;
+  int bloscShuffle = 0;
+  int bloscCompressor = 0;
+  int bloscLevel = 0;
+  static const char *functionName = "configureChunkWriter";
+
+  this->lock();
+  getIntegerParam(NDFileHDF5_directChunkWrite, &directChunkWrite);
+  getIntegerParam(NDFileHDF5_compressionType, &compressionScheme);
+  getIntegerParam(NDFileHDF5_zCompressLevel, &zLevel);
+  getIntegerParam(NDFileHDF5_bloscShuffleType, &bloscShuffle);
+  getIntegerParam(NDFileHDF5_bloscCompressor, &bloscCompressor);
+  getIntegerParam(NDFileHDF5_bloscCompressLevel, &bloscLevel);
+  this->unlock();
+
+  this->directChunkActive = false;
+  this->pChunkWriter->resetStatistics();
+  if (directChunkWrite == 1){
+    asynStatus status = asynSuccess;
+    switch (compressionScheme)
+    {
+      case HDF5CompressNone:
+        status = this->pChunkWriter->configure(this->rank, this->rank - pArray->ndims, this->framesize,
+                                               this->chunkdims, this->bytesPerElement, this->ptrFillValue,
+                                               NDFileHDF5ChunkRaw, 0, 0, 0);
+        break;
+      case HDF5CompressZlib:
+        status = this->pChunkWriter->configure(this->rank, this->rank - pArray->ndims, this->framesize,
+                                               this->chunkdims, this->bytesPerElement, this->ptrFillValue,
+                                               NDFileHDF5ChunkZlib, zLevel, 0, 0);
+        break;
+      case HDF5CompressBlosc:
+        status = this->pChunkWriter->configure(this->rank, this->rank - pArray->ndims, this->framesize,
+                                               this->chunkdims, this->bytesPerElement, this->ptrFillValue,
+                                               NDFileHDF5ChunkBlosc, bloscLevel, bloscShuffle, bloscCompressor);
+        break;
+      default:
+        // N-bit and szip are only available inside the HDF5 library
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_WARNING,
+                  "%s::%s compression type %d is not supported by direct chunk writes\n",
+                  driverName, functionName, compressionScheme);
+        status = asynError;
+        break;
+    }
+    this->directChunkActive = (status == asynSuccess);
+    if (!this->directChunkActive){
+      asynPrint(this->pasynUserSelf, ASYN_TRACE_WARNING,
+                "%s::%s writing frames with H5Dwrite\n",
+                driverName, functionName);
+    }
+  }
+
+  this->lock();
+  setIntegerParam(NDFileHDF5_directChunkActive, this->directChunkActive ? 1 : 0);
+  setIntegerParam(NDFileHDF5_writeQueueUsed, 0);
+  setDoubleParam(NDFileHDF5_compressRate, 0.0);
+  setDoubleParam(NDFileHDF5_compressRatio, 0.0);
+  setDoubleParam(NDFileHDF5_writeRate, 0.0);
+  setDoubleParam(NDFileHDF5_flushTime, 0.0);
+  this->unlock();
+  return asynSuccess;
+}
+
+/** Encode a frame into chunks, divided between HDF5_compressThreads threads, and pass them
+ * to the chunk writer.  A frame compressed by NDPluginCodec is passed on as a single chunk.
+ * If HDF5_writeQueueSize is 0 the chunks are written before returning,
+ * otherwise this only waits if the queue of the writer thread is full.
+ * \param[in] pDataset - The destination dataset, already extended for this frame.
+ * \param[in] pArray - The frame to write.
+ * \param[in] flush - Flush the dataset after writing this frame.
+ */
+asynStatus NDFileHDF5::writeChunks(NDFileHDF5Dataset *pDataset, NDArray *pArray, bool flush)
+{
+  NDFileHDF5Encode_t encode;
+  NDFileHDF5ChunkFrame_t *pFrame;
+  NDFileHDF5Chunk_t empty = {NULL, 0, 0};
+  NDArrayInfo_t info;
+  epicsTimeStamp start, end;
+  size_t encodedBytes = 0;
+  int compressThreads = 1;
+  int queueSize = 0;
+  int numChunks = this->pChunkWriter->getNumChunks();
+  int i;
+  static const char *functionName = "writeChunks";
+
+  pArray->getInfo(&info);
+  if (info.totalBytes != this->pChunkWriter->getFrameBytes()){
+    asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+              "%s::%s ERROR: array size %lu does not match the frame size of the file %lu\n",
+              driverName, functionName, (unsigned long)info.totalBytes,
+              (unsigned long)this->pChunkWriter->getFrameBytes());
+    return asynError;
+  }
+
+  this->lock();
+  getIntegerParam(NDFileHDF5_compressThreads, &compressThreads);
+  getIntegerParam(NDFileHDF5_writeQueueSize, &queueSize);
+  this->unlock();
+
+  pFrame = new NDFileHDF5ChunkFrame_t;
+  pFrame->pDataset = pDataset;
+  pFrame->dims.resize(pDataset->getRank());
+  pFrame->offset.resize(pDataset->getRank());
+  pDataset->reserveFrame(&pFrame->dims[0], &pFrame->offset[0]);
+  pFrame->chunks.assign(numChunks, empty);
+  pFrame->flush = flush;
+
+  epicsTimeGetCurrent(&start);
+  if (!pArray->codec.name.empty()){
+    // Compressed upstream, the array is the only chunk of the frame
+    this->pChunkWriter->copyEncodedFrame(pArray, &pFrame->chunks[0]);
+  } else {
+    encode.pWriter = this->pChunkWriter;
+    encode.pData = (const char *)pArray->pData;
+    encode.pFrame = pFrame;
+    this->runTiles(compressThreads, numChunks, encodeChunks, &encode);
+  }
+  epicsTimeGetCurrent(&end);
+
+  for (i=0; i<numChunks; i++){
+    if (pFrame->chunks[i].pData == NULL){
+      asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                "%s::%s ERROR: could not encode chunk %d\n",
+                driverName, functionName, i);
+      this->pChunkWriter->freeFrame(pFrame);
+      return asynError;
+    }
+    encodedBytes += pFrame->chunks[i].size;
+  }
+  this->pChunkWriter->addCompressStatistics(info.totalBytes, encodedBytes, epicsTimeDiffInSeconds(&end, &start));
+
+  return this->pChunkWriter->write(pFrame, queueSize);
+}
+
+/** Copy the statistics of the chunk writer to the parameters; rates are in MB/s.
+ */
+void NDFileHDF5::updateChunkStatistics()
+{
+  NDFileHDF5ChunkStats_t stats;
+  const double MB = 1024.0 * 1024.0;
+
+  this->pChunkWriter->getStatistics(&stats);
+  this->lock();
+  setIntegerParam(NDFileHDF5_writeQueueUsed, stats.queued);
+  if (stats.compressSeconds > 0.0) setDoubleParam(NDFileHDF5_compressRate, stats.rawBytes / MB / stats.compressSeconds);
+  if (stats.encodedBytes > 0.0)    setDoubleParam(NDFileHDF5_compressRatio, stats.rawBytes / stats.encodedBytes);
+  if (stats.writeSeconds > 0.0)    setDoubleParam(NDFileHDF5_writeRate, stats.writeBytes / MB / stats.writeSeconds);
+  if (stats.numFlushes > 0)        setDoubleParam(NDFileHDF5_flushTime, 1000.0 * stats.flushSeconds / stats.numFlushes);
+  this->unlock();
+}
+
 /** Translate the NDArray datatype to HDF5 datatypes 
  */
 hid_t NDFileHDF5::typeNd2Hdf(NDDataType_t datatype)
@@ -3157,7 +3411,7 @@ extern "C" int NDFileHDF5Configure(const char *portName, int queueSize, int bloc
                                    int priority, int stackSize)
 {
   // Stack Size must be a minimum of 2MB
-  if (stackSize < 2097152) stackSize = 2097152;
+  if (stackSize < MIN_STACK_SIZE) stackSize = MIN_STACK_SIZE;
   NDFileHDF5 *pPlugin = new NDFileHDF5(portName, queueSize, blockingCallbacks, NDArrayPort, NDArrayAddr,
                                        priority, stackSize);
   return pPlugin->start();
@@ -3312,9 +3566,11 @@ asynStatus NDFileHDF5::createNewFile(const char *fileName)
   int tempAlign = 0;
   int tempThreshold = 0;
   int SWMRMode = 0;
+  int directIO = 0;
   static const char *functionName = "createNewFile";
 
   this->lock();
+  getIntegerParam(NDFileHDF5_directIO, &directIO);
   getIntegerParam(NDFileHDF5_chunkBoundaryAlign, &tempAlign);
   getIntegerParam(NDFileHDF5_chunkBoundaryThreshold, (int*)&tempThreshold);
   // Check if we are in SWMR mode
@@ -3349,6 +3605,22 @@ asynStatus NDFileHDF5::createNewFile(const char *fileName)
 
   /* File creation property list: set the i-storek according to HDF group recommendations */
   H5Pset_fclose_degree(access_plist, H5F_CLOSE_STRONG);
+
+  /* Use the direct file driver (O_DIRECT) so that data bypasses the page cache */
+  if (directIO == 1){
+  #ifdef H5_HAVE_DIRECT
+    hdfstatus = H5Pset_fapl_direct(access_plist, DIRECT_IO_BLOCK_SIZE, DIRECT_IO_BLOCK_SIZE, DIRECT_IO_COPY_BUFFER_SIZE);
+    if (hdfstatus < 0){
+      asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                "%s::%s Warning: failed to select the direct file driver\n",
+                driverName, functionName);
+    }
+  #else
+    asynPrint(this->pasynUserSelf, ASYN_TRACE_WARNING,
+              "%s::%s Warning: the HDF5 library was built without the direct file driver, using the default driver\n",
+              driverName, functionName);
+  #endif
+  }
   
   // Not required if SWMR is not supported
   #if H5_VERSION_GE(1,9,178)
@@ -16,6 +16,7 @@
 #include "NDFileHDF5Dataset.h"
 #include "NDFileHDF5LayoutXML.h"
 #include "NDFileHDF5AttributeDataset.h"
+#include "NDFileHDF5ChunkWriter.h"
 #include "NDFileHDF5VersionCheck.h"
 
 #define MAXEXTRADIMS 10
@@ -58,6 +59,16 @@
 #define str_NDFileHDF5_SWMRSupported     "HDF5_SWMRSupported"
 #define str_NDFileHDF5_SWMRMode          "HDF5_SWMRMode"
 #define str_NDFileHDF5_SWMRRunning       "HDF5_SWMRRunning"
+#define str_NDFileHDF5_directChunkWrite  "HDF5_directChunkWrite"
+#define str_NDFileHDF5_directChunkActive "HDF5_directChunkActive"
+#define str_NDFileHDF5_compressThreads   "HDF5_compressThreads"
+#define str_NDFileHDF5_writeQueueSize    "HDF5_writeQueueSize"
+#define str_NDFileHDF5_writeQueueUsed    "HDF5_writeQueueUsed"
+#define str_NDFileHDF5_directIO          "HDF5_directIO"
+#define str_NDFileHDF5_compressRate      "HDF5_compressRate"
+#define str_NDFileHDF5_compressRatio     "HDF5_compressRatio"
+#define str_NDFileHDF5_writeRate         "HDF5_writeRate"
+#define str_NDFileHDF5_flushTime         "HDF5_flushTime"
 
 /** Writes NDArrays in the HDF5 file format; an XML file can control the structure of the HDF5 file.
   */
@@ -73,6 +84,7 @@ class epicsShareClass NDFileHDF5 : public NDPluginFile
     NDFileHDF5(const char *portName, int queueSize, int blockingCallbacks, 
                const char *NDArrayPort, int NDArrayAddr,
                int priority, int stackSize);
+    virtual ~NDFileHDF5();
        
     /* The methods that this class implements */
     virtual asynStatus openFile(const char *fileName, NDFileOpenMode_t openMode, NDArray *pArray);
@@ -159,6 +171,16 @@ class epicsShareClass NDFileHDF5 : public NDPluginFile
     int NDFileHDF5_SWMRSupported;
     int NDFileHDF5_SWMRMode;
     int NDFileHDF5_SWMRRunning;
+    int NDFileHDF5_directChunkWrite;
+    int NDFileHDF5_directChunkActive;
+    int NDFileHDF5_compressThreads;
+    int NDFileHDF5_writeQueueSize;
+    int NDFileHDF5_writeQueueUsed;
+    int NDFileHDF5_directIO;
+    int NDFileHDF5_compressRate;
+    int NDFileHDF5_compressRatio;
+    int NDFileHDF5_writeRate;
+    int NDFileHDF5_flushTime;
 
 #ifndef _UNITTEST_HDF5_
   private:
@@ -182,6 +204,9 @@ class epicsShareClass NDFileHDF5 : public NDPluginFile
     asynStatus configureDatasetDims(NDArray *pArray);
     asynStatus configureDims(NDArray *pArray);
     asynStatus configureCompression();
+    asynStatus configureChunkWriter(NDArray *pArray);
+    asynStatus writeChunks(NDFileHDF5Dataset *pDataset, NDArray *pArray, bool flush);
+    void updateChunkStatistics();
     char* getDimsReport();
     asynStatus writeStringAttribute(hid_t element, const char* attrName, const char* attrStrValue);
     asynStatus calculateAttributeChunking(int *chunking, int *mdim_chunking);
@@ -231,6 +256,8 @@ class epicsShareClass NDFileHDF5 : public NDPluginFile
     double frameSize;  /** < frame size in megabits. For performance measurement. */
     int bytesPerElement;
     char *hostname;
+    NDFileHDF5ChunkWriter *pChunkWriter;
+    bool directChunkActive;   /** < Frames of the open file are written with NDFileHDF5ChunkWriter */
 
     std::list<NDFileHDF5AttributeDataset*> attrList;
 
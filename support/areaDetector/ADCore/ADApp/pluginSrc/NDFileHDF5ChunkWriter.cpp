@@ -0,0 +1,540 @@
+/*
+ * NDFileHDF5ChunkWriter.cpp
+ *
+ * Encodes frames into HDF5 chunks outside of the HDF5 library and writes them with
+ * H5Dwrite_chunk, either in the calling thread or from a writer thread with a bounded queue.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <epicsTime.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_BLOSC
+#include <blosc.h>
+#endif
+#include "NDFileHDF5ChunkWriter.h"
+
+static const char *fileName = "NDFileHDF5ChunkWriter";
+
+static void writerTaskC(void *drvPvt)
+{
+  NDFileHDF5ChunkWriter *pWriter = (NDFileHDF5ChunkWriter *)drvPvt;
+  pWriter->writerTask();
+}
+
+/** Constructor.
+ * \param[in] pAsynUser - asynUser that is used to control debugging output
+ * \param[in] name - Name of the writer thread
+ * \param[in] stackSize - Stack size of the writer thread; HDF5 needs a large stack
+ */
+NDFileHDF5ChunkWriter::NDFileHDF5ChunkWriter(asynUser *pAsynUser, const std::string& name, int stackSize) :
+  pAsynUser_(pAsynUser),
+  name_(name),
+  stackSize_(stackSize),
+  extradims_(0),
+  numChunks_(0),
+  chunkElements_(0),
+  bytesPerElement_(1),
+  codec_(NDFileHDF5ChunkRaw),
+  level_(0),
+  shuffle_(0),
+  compressorName_(NULL),
+  thread_(0),
+  busy_(false),
+  exiting_(false),
+  writeError_(false)
+{
+  memset(this->fillValue_, 0, sizeof(this->fillValue_));
+  this->hdf5Lock_   = epicsMutexMustCreate();
+  this->queueLock_  = epicsMutexMustCreate();
+  this->queueEvent_ = epicsEventMustCreate(epicsEventEmpty);
+  this->doneEvent_  = epicsEventMustCreate(epicsEventEmpty);
+  this->resetStatistics();
+}
+
+NDFileHDF5ChunkWriter::~NDFileHDF5ChunkWriter()
+{
+  this->drain();
+  epicsMutexLock(this->queueLock_);
+  this->exiting_ = true;
+  epicsMutexUnlock(this->queueLock_);
+  if (this->thread_) {
+    epicsEventSignal(this->queueEvent_);
+    // The thread signals doneEvent_ as it exits
+    epicsMutexLock(this->queueLock_);
+    while (this->thread_) {
+      epicsMutexUnlock(this->queueLock_);
+      epicsEventWait(this->doneEvent_);
+      epicsMutexLock(this->queueLock_);
+    }
+    epicsMutexUnlock(this->queueLock_);
+  }
+  epicsEventDestroy(this->doneEvent_);
+  epicsEventDestroy(this->queueEvent_);
+  epicsMutexDestroy(this->queueLock_);
+  epicsMutexDestroy(this->hdf5Lock_);
+}
+
+/** configure.
+ * Set up the chunk layout and encoding for a new file.
+ * \param[in] rank - Number of dimensions of the dataset.
+ * \param[in] extradims - Number of dimensions in addition to the frame dimensions.
+ * \param[in] framesize - Size of one frame in each dimension of the dataset.
+ * \param[in] chunkdims - Chunk size in each dimension of the dataset.
+ * \param[in] bytesPerElement - Size of one element.
+ * \param[in] pFillValue - Value of the elements of edge chunks outside the frame.
+ * \param[in] codec - Encoding matching the filter pipeline of the dataset.
+ * \param[in] level - Compression level of zlib or blosc.
+ * \param[in] shuffle - Blosc shuffle type.
+ * \param[in] compressor - Blosc compressor code.
+ * Returns asynError if frames cannot be written as whole chunks with this layout or encoding.
+ */
+asynStatus NDFileHDF5ChunkWriter::configure(int rank, int extradims, const hsize_t *framesize, const hsize_t *chunkdims,
+                                            int bytesPerElement, const void *pFillValue,
+                                            NDFileHDF5ChunkCodec_t codec, int level, int shuffle, int compressor)
+{
+  int i;
+  static const char *functionName = "configure";
+
+  // Each chunk must hold data from only one frame
+  for (i=0; i<extradims; i++){
+    if (chunkdims[i] != 1){
+      asynPrint(this->pAsynUser_, ASYN_TRACE_WARNING,
+                "%s::%s chunks contain more than one frame, direct chunk writes are not possible\n",
+                fileName, functionName);
+      return asynError;
+    }
+  }
+  if ((bytesPerElement < 1) || (bytesPerElement > (int)sizeof(this->fillValue_))) return asynError;
+
+  this->compressorName_ = NULL;
+  switch (codec){
+    case NDFileHDF5ChunkRaw:
+      break;
+    case NDFileHDF5ChunkZlib:
+#ifndef HAVE_ZLIB
+      asynPrint(this->pAsynUser_, ASYN_TRACE_WARNING,
+                "%s::%s built without zlib, direct chunk writes are not possible\n",
+                fileName, functionName);
+      return asynError;
+#endif
+      break;
+    case NDFileHDF5ChunkBlosc:
+#ifdef HAVE_BLOSC
+      if (blosc_compcode_to_compname(compressor, (char **)&this->compressorName_) < 0){
+        asynPrint(this->pAsynUser_, ASYN_TRACE_WARNING,
+                  "%s::%s blosc compressor %d is not available, direct chunk writes are not possible\n",
+                  fileName, functionName, compressor);
+        return asynError;
+      }
+#else
+      asynPrint(this->pAsynUser_, ASYN_TRACE_WARNING,
+                "%s::%s built without blosc, direct chunk writes are not possible\n",
+                fileName, functionName);
+      return asynError;
+#endif
+      break;
+    default:
+      return asynError;
+  }
+
+  this->extradims_ = extradims;
+  this->frameDims_.assign(framesize + extradims, framesize + rank);
+  this->chunkDims_.assign(chunkdims + extradims, chunkdims + rank);
+  this->chunksPerDim_.resize(rank - extradims);
+  this->numChunks_ = 1;
+  this->chunkElements_ = 1;
+  for (i=0; i<rank-extradims; i++){
+    this->chunksPerDim_[i] = (this->frameDims_[i] + this->chunkDims_[i] - 1) / this->chunkDims_[i];
+    this->numChunks_ *= (int)this->chunksPerDim_[i];
+    this->chunkElements_ *= this->chunkDims_[i];
+  }
+  this->bytesPerElement_ = bytesPerElement;
+  memcpy(this->fillValue_, pFillValue, bytesPerElement);
+  this->codec_ = codec;
+  this->level_ = level;
+  this->shuffle_ = shuffle;
+  return asynSuccess;
+}
+
+/** getNumChunks.
+ * Returns the number of chunks in each frame.
+ */
+int NDFileHDF5ChunkWriter::getNumChunks()
+{
+  return this->numChunks_;
+}
+
+/** getFrameBytes.
+ * Returns the number of bytes in each frame.
+ */
+size_t NDFileHDF5ChunkWriter::getFrameBytes()
+{
+  size_t bytes = this->bytesPerElement_;
+  for (size_t i=0; i<this->frameDims_.size(); i++) bytes *= this->frameDims_[i];
+  return bytes;
+}
+
+/** chunkOrigin.
+ * Calculate the position of a chunk within the frame.
+ * \param[in] index - Chunk number, with the last dimension changing fastest.
+ * \param[out] origin - Position of the first element of the chunk in each frame dimension.
+ */
+void NDFileHDF5ChunkWriter::chunkOrigin(int index, hsize_t *origin)
+{
+  for (int i=(int)this->chunkDims_.size()-1; i>=0; i--){
+    origin[i] = (index % this->chunksPerDim_[i]) * this->chunkDims_[i];
+    index = (int)(index / this->chunksPerDim_[i]);
+  }
+}
+
+/** encodeChunk.
+ * Copy one chunk out of a frame, padding edge chunks with the fill value, and encode it.
+ * This can be called from several threads at once.
+ * \param[in] pFrame - The frame data, with the layout given to configure().
+ * \param[in] index - Chunk number, with the last dimension changing fastest.
+ * \param[out] pChunk - The encoded chunk; pChunk->pData is NULL if this fails.
+ */
+asynStatus NDFileHDF5ChunkWriter::encodeChunk(const char *pFrame, int index, NDFileHDF5Chunk_t *pChunk)
+{
+  int ndims = (int)this->chunkDims_.size();
+  int last = ndims - 1;
+  size_t chunkBytes = this->chunkElements_ * this->bytesPerElement_;
+  size_t i, rowBytes, numRows, row;
+  hsize_t origin[H5S_MAX_RANK];
+  hsize_t pos[H5S_MAX_RANK];
+  bool partial = false;
+  char *pRaw;
+  int d;
+  static const char *functionName = "encodeChunk";
+
+  pChunk->pData = NULL;
+  pChunk->size = 0;
+  pChunk->filterMask = 0;
+  pRaw = (char *)malloc(chunkBytes);
+  if (!pRaw) return asynError;
+
+  // Copy the chunk one row (last dimension) at a time
+  this->chunkOrigin(index, origin);
+  for (d=0; d<ndims; d++){
+    if (origin[d] + this->chunkDims_[d] > this->frameDims_[d]) partial = true;
+  }
+  if (partial){
+    for (i=0; i<this->chunkElements_; i++){
+      memcpy(pRaw + i*this->bytesPerElement_, this->fillValue_, this->bytesPerElement_);
+    }
+  }
+  rowBytes = (size_t)(this->frameDims_[last] - origin[last]);
+  if (rowBytes > this->chunkDims_[last]) rowBytes = (size_t)this->chunkDims_[last];
+  rowBytes *= this->bytesPerElement_;
+  numRows = this->chunkElements_ / (size_t)this->chunkDims_[last];
+  for (row=0; row<numRows; row++){
+    size_t rest = row, src = 0;
+    bool inside = true;
+    for (d=last-1; d>=0; d--){
+      pos[d] = origin[d] + rest % this->chunkDims_[d];
+      rest /= (size_t)this->chunkDims_[d];
+      if (pos[d] >= this->frameDims_[d]) inside = false;
+    }
+    if (!inside) continue;
+    for (d=0; d<last; d++) src = src * (size_t)this->frameDims_[d] + (size_t)pos[d];
+    src = src * (size_t)this->frameDims_[last] + (size_t)origin[last];
+    memcpy(pRaw + row * (size_t)this->chunkDims_[last] * this->bytesPerElement_,
+           pFrame + src * this->bytesPerElement_, rowBytes);
+  }
+
+  switch (this->codec_){
+    case NDFileHDF5ChunkZlib:
+#ifdef HAVE_ZLIB
+      {
+        uLongf encodedBytes = compressBound((uLong)chunkBytes);
+        char *pEncoded = (char *)malloc(encodedBytes);
+        if (!pEncoded || (compress2((Bytef *)pEncoded, &encodedBytes, (const Bytef *)pRaw,
+                                    (uLong)chunkBytes, this->level_) != Z_OK)){
+          asynPrint(this->pAsynUser_, ASYN_TRACE_ERROR,
+                    "%s::%s ERROR zlib compression of chunk %d failed\n",
+                    fileName, functionName, index);
+          free(pEncoded);
+          free(pRaw);
+          return asynError;
+        }
+        if (encodedBytes < chunkBytes){
+          free(pRaw);
+          pChunk->pData = pEncoded;
+          pChunk->size = encodedBytes;
+        } else {
+          // The deflate filter is optional, so a chunk that does not compress is stored as it is
+          free(pEncoded);
+          pChunk->pData = pRaw;
+          pChunk->size = chunkBytes;
+          pChunk->filterMask = 1;
+        }
+      }
+#endif
+      break;
+    case NDFileHDF5ChunkBlosc:
+#ifdef HAVE_BLOSC
+      {
+        char *pEncoded = (char *)malloc(chunkBytes + BLOSC_MAX_OVERHEAD);
+        int encodedBytes = -1;
+        if (pEncoded){
+          encodedBytes = blosc_compress_ctx(this->level_, this->shuffle_, this->bytesPerElement_,
+                                            chunkBytes, pRaw, pEncoded, chunkBytes + BLOSC_MAX_OVERHEAD,
+                                            this->compressorName_, 0, 1);
+        }
+        free(pRaw);
+        if (encodedBytes <= 0){
+          asynPrint(this->pAsynUser_, ASYN_TRACE_ERROR,
+                    "%s::%s ERROR blosc compression of chunk %d failed\n",
+                    fileName, functionName, index);
+          free(pEncoded);
+          return asynError;
+        }
+        pChunk->pData = pEncoded;
+        pChunk->size = encodedBytes;
+      }
+#endif
+      break;
+    default:
+      pChunk->pData = pRaw;
+      pChunk->size = chunkBytes;
+      break;
+  }
+  return asynSuccess;
+}
+
+/** copyEncodedFrame.
+ * Use an array that was compressed before it reached the file plugin (by NDPluginCodec) as the
+ * single chunk of a frame.  This is only possible if the chunk is the whole frame and the codec of
+ * the array is the one the filter pipeline of the dataset expects.
+ * \param[in] pArray - The compressed array.
+ * \param[out] pChunk - A copy of the compressed data; pChunk->pData is NULL if this fails.
+ */
+asynStatus NDFileHDF5ChunkWriter::copyEncodedFrame(NDArray *pArray, NDFileHDF5Chunk_t *pChunk)
+{
+  bool codecOK;
+  static const char *functionName = "copyEncodedFrame";
+
+  pChunk->pData = NULL;
+  pChunk->size = 0;
+  pChunk->filterMask = 0;
+  if ((this->numChunks_ != 1) || (this->chunkDims_ != this->frameDims_)){
+    asynPrint(this->pAsynUser_, ASYN_TRACE_ERROR,
+              "%s::%s ERROR compressed arrays need chunks of exactly one frame\n",
+              fileName, functionName);
+    return asynError;
+  }
+  codecOK = ((pArray->codec.name == "zlib") && (this->codec_ == NDFileHDF5ChunkZlib)) ||
+            ((pArray->codec.name == "blosc") && (this->codec_ == NDFileHDF5ChunkBlosc));
+  if (!codecOK){
+    asynPrint(this->pAsynUser_, ASYN_TRACE_ERROR,
+              "%s::%s ERROR codec %s of the array does not match the compression of the file\n",
+              fileName, functionName, pArray->codec.name.c_str());
+    return asynError;
+  }
+  pChunk->pData = (char *)malloc(pArray->compressedSize);
+  if (!pChunk->pData) return asynError;
+  memcpy(pChunk->pData, pArray->pData, pArray->compressedSize);
+  pChunk->size = pArray->compressedSize;
+  return asynSuccess;
+}
+
+/** write.
+ * Write a frame of encoded chunks.  The writer takes ownership of pFrame and frees it.
+ * \param[in] pFrame - The frame, allocated with new.
+ * \param[in] queueSize - If 0 the frame is written before returning.  Otherwise it is
+ *            queued for the writer thread, first waiting until fewer than queueSize frames are queued.
+ * Returns asynError if this frame or an earlier queued frame could not be written.
+ */
+asynStatus NDFileHDF5ChunkWriter::write(NDFileHDF5ChunkFrame_t *pFrame, int queueSize)
+{
+  asynStatus status = asynSuccess;
+  static const char *functionName = "write";
+
+  if (queueSize <= 0){
+    // Frames already queued must be written first
+    status = this->drain();
+    if (status == asynSuccess) status = this->writeFrame(pFrame);
+    this->freeFrame(pFrame);
+    return status;
+  }
+
+  epicsMutexLock(this->queueLock_);
+  if (!this->thread_){
+    this->thread_ = epicsThreadCreate(this->name_.c_str(), epicsThreadPriorityMedium,
+                                      this->stackSize_, writerTaskC, this);
+    if (!this->thread_){
+      epicsMutexUnlock(this->queueLock_);
+      asynPrint(this->pAsynUser_, ASYN_TRACE_ERROR,
+                "%s::%s ERROR unable to create the writer thread\n",
+                fileName, functionName);
+      this->freeFrame(pFrame);
+      return asynError;
+    }
+  }
+  while ((int)this->queue_.size() >= queueSize){
+    epicsMutexUnlock(this->queueLock_);
+    epicsEventWait(this->doneEvent_);
+    epicsMutexLock(this->queueLock_);
+  }
+  if (this->writeError_){
+    this->writeError_ = false;
+    status = asynError;
+  }
+  this->queue_.push_back(pFrame);
+  this->stats_.queued = (int)this->queue_.size();
+  epicsMutexUnlock(this->queueLock_);
+  epicsEventSignal(this->queueEvent_);
+  return status;
+}
+
+/** drain.
+ * Wait until the writer thread has written all of the queued frames.
+ * Returns asynError if any of them could not be written.
+ */
+asynStatus NDFileHDF5ChunkWriter::drain()
+{
+  asynStatus status = asynSuccess;
+
+  epicsMutexLock(this->queueLock_);
+  while (!this->queue_.empty() || this->busy_){
+    epicsMutexUnlock(this->queueLock_);
+    epicsEventWait(this->doneEvent_);
+    epicsMutexLock(this->queueLock_);
+  }
+  if (this->writeError_){
+    this->writeError_ = false;
+    status = asynError;
+  }
+  epicsMutexUnlock(this->queueLock_);
+  return status;
+}
+
+/** lock.
+ * Take the lock that serializes HDF5 library calls with the writer thread.
+ */
+void NDFileHDF5ChunkWriter::lock()
+{
+  epicsMutexLock(this->hdf5Lock_);
+}
+
+void NDFileHDF5ChunkWriter::unlock()
+{
+  epicsMutexUnlock(this->hdf5Lock_);
+}
+
+/** writerTask.
+ * Writes queued frames in order until the writer is destroyed.
+ */
+void NDFileHDF5ChunkWriter::writerTask()
+{
+  NDFileHDF5ChunkFrame_t *pFrame;
+  asynStatus status;
+
+  epicsMutexLock(this->queueLock_);
+  while (!this->exiting_){
+    if (this->queue_.empty()){
+      epicsMutexUnlock(this->queueLock_);
+      epicsEventWait(this->queueEvent_);
+      epicsMutexLock(this->queueLock_);
+      continue;
+    }
+    pFrame = this->queue_.front();
+    this->queue_.pop_front();
+    this->busy_ = true;
+    epicsMutexUnlock(this->queueLock_);
+
+    status = this->writeFrame(pFrame);
+    this->freeFrame(pFrame);
+
+    epicsMutexLock(this->queueLock_);
+    if (status != asynSuccess) this->writeError_ = true;
+    this->busy_ = false;
+    this->stats_.queued = (int)this->queue_.size();
+    epicsEventSignal(this->doneEvent_);
+  }
+  // The destructor can continue as soon as the lock is released
+  this->thread_ = 0;
+  epicsEventSignal(this->doneEvent_);
+  epicsMutexUnlock(this->queueLock_);
+}
+
+/** writeFrame.
+ * Extend the dataset and write all of the chunks of one frame, then flush the dataset if requested.
+ */
+asynStatus NDFileHDF5ChunkWriter::writeFrame(NDFileHDF5ChunkFrame_t *pFrame)
+{
+  asynStatus status;
+  hsize_t offset[H5S_MAX_RANK];
+  epicsTimeStamp start, end;
+  double writeBytes = 0.0, writeSeconds, flushSeconds = 0.0;
+  int i, d;
+  int rank = (int)pFrame->offset.size();
+
+  epicsMutexLock(this->hdf5Lock_);
+  epicsTimeGetCurrent(&start);
+  status = pFrame->pDataset->setExtent(&pFrame->dims[0]);
+  for (d=0; d<rank; d++) offset[d] = pFrame->offset[d];
+  for (i=0; (i<(int)pFrame->chunks.size()) && (status == asynSuccess); i++){
+    this->chunkOrigin(i, offset + this->extradims_);
+    status = pFrame->pDataset->writeChunk(offset, pFrame->chunks[i].filterMask,
+                                          pFrame->chunks[i].size, pFrame->chunks[i].pData);
+    writeBytes += pFrame->chunks[i].size;
+  }
+  epicsTimeGetCurrent(&end);
+  writeSeconds = epicsTimeDiffInSeconds(&end, &start);
+  if ((status == asynSuccess) && pFrame->flush){
+    status = pFrame->pDataset->flushDataset();
+    epicsTimeGetCurrent(&start);
+    flushSeconds = epicsTimeDiffInSeconds(&start, &end);
+  }
+  epicsMutexUnlock(this->hdf5Lock_);
+
+  epicsMutexLock(this->queueLock_);
+  this->stats_.writeBytes += writeBytes;
+  this->stats_.writeSeconds += writeSeconds;
+  if (pFrame->flush){
+    this->stats_.numFlushes++;
+    this->stats_.flushSeconds += flushSeconds;
+  }
+  epicsMutexUnlock(this->queueLock_);
+  return status;
+}
+
+/** freeFrame.
+ * Free the chunks of a frame and the frame.
+ */
+void NDFileHDF5ChunkWriter::freeFrame(NDFileHDF5ChunkFrame_t *pFrame)
+{
+  for (size_t i=0; i<pFrame->chunks.size(); i++) free(pFrame->chunks[i].pData);
+  delete pFrame;
+}
+
+/** addCompressStatistics.
+ * Add the encoding of one frame to the statistics.
+ */
+void NDFileHDF5ChunkWriter::addCompressStatistics(size_t rawBytes, size_t encodedBytes, double seconds)
+{
+  epicsMutexLock(this->queueLock_);
+  this->stats_.rawBytes += rawBytes;
+  this->stats_.encodedBytes += encodedBytes;
+  this->stats_.compressSeconds += seconds;
+  epicsMutexUnlock(this->queueLock_);
+}
+
+void NDFileHDF5ChunkWriter::getStatistics(NDFileHDF5ChunkStats_t *pStats)
+{
+  epicsMutexLock(this->queueLock_);
+  *pStats = this->stats_;
+  epicsMutexUnlock(this->queueLock_);
+}
+
+void NDFileHDF5ChunkWriter::resetStatistics()
+{
+  epicsMutexLock(this->queueLock_);
+  memset(&this->stats_, 0, sizeof(this->stats_));
+  this->stats_.queued = (int)this->queue_.size();
+  epicsMutexUnlock(this->queueLock_);
+}
@@ -0,0 +1,123 @@
+/*
+ * NDFileHDF5ChunkWriter.h
+ *
+ * Encodes frames into HDF5 chunks outside of the HDF5 library and writes them with
+ * H5Dwrite_chunk, either in the calling thread or from a writer thread with a bounded queue.
+ * Frames already compressed by NDPluginCodec can be written as they are.
+ */
+
+#ifndef ADAPP_PLUGINSRC_NDFILEHDF5CHUNKWRITER_H_
+#define ADAPP_PLUGINSRC_NDFILEHDF5CHUNKWRITER_H_
+
+#include <string>
+#include <deque>
+#include <vector>
+#include <hdf5.h>
+#include <epicsMutex.h>
+#include <epicsEvent.h>
+#include <epicsThread.h>
+#include <asynDriver.h>
+#include "NDFileHDF5Dataset.h"
+#include "NDFileHDF5VersionCheck.h"
+
+/** Encoding of the chunks; must match the filter pipeline of the dataset */
+typedef enum {
+  NDFileHDF5ChunkRaw,     /**< No filters */
+  NDFileHDF5ChunkZlib,    /**< The deflate filter */
+  NDFileHDF5ChunkBlosc    /**< The blosc filter (32001) */
+} NDFileHDF5ChunkCodec_t;
+
+/** One encoded chunk */
+typedef struct {
+  char     *pData;        /**< Encoded data, allocated with malloc() */
+  size_t   size;          /**< Number of bytes in pData */
+  uint32_t filterMask;    /**< Bit n set if filter n of the pipeline was skipped */
+} NDFileHDF5Chunk_t;
+
+/** All of the chunks of one frame and where the frame goes in the dataset */
+typedef struct {
+  NDFileHDF5Dataset *pDataset;
+  std::vector<hsize_t> dims;        /**< Extent of the dataset including this frame */
+  std::vector<hsize_t> offset;      /**< Position of the frame in the dataset */
+  std::vector<NDFileHDF5Chunk_t> chunks;
+  bool flush;                       /**< Flush the dataset after this frame (SWMR mode) */
+} NDFileHDF5ChunkFrame_t;
+
+/** Totals since the statistics were last reset */
+typedef struct {
+  double rawBytes;          /**< Bytes of frame data encoded */
+  double encodedBytes;      /**< Bytes after encoding */
+  double compressSeconds;   /**< Time spent encoding, not including waits for the writer */
+  double writeBytes;        /**< Bytes written with H5Dwrite_chunk */
+  double writeSeconds;
+  int    numFlushes;
+  double flushSeconds;
+  int    queued;            /**< Frames waiting for the writer thread */
+} NDFileHDF5ChunkStats_t;
+
+/** Class that writes pre-encoded chunks to the detector datasets of NDFileHDF5.
+  * configure() is called when a file is opened.  encodeChunk() can then be called from
+  * several threads at once.  write() either writes a frame immediately or adds it to the
+  * queue of the writer thread.  All HDF5 calls in the writer thread are made with lock()
+  * held, so NDFileHDF5 must also hold it for HDF5 calls made while frames are queued.
+  */
+class NDFileHDF5ChunkWriter
+{
+  public:
+    NDFileHDF5ChunkWriter(asynUser *pAsynUser, const std::string& name, int stackSize);
+    ~NDFileHDF5ChunkWriter();
+
+    asynStatus configure(int rank, int extradims, const hsize_t *framesize, const hsize_t *chunkdims,
+                         int bytesPerElement, const void *pFillValue,
+                         NDFileHDF5ChunkCodec_t codec, int level, int shuffle, int compressor);
+    int getNumChunks();
+    size_t getFrameBytes();
+    asynStatus encodeChunk(const char *pFrame, int index, NDFileHDF5Chunk_t *pChunk);
+    asynStatus copyEncodedFrame(NDArray *pArray, NDFileHDF5Chunk_t *pChunk);
+    asynStatus write(NDFileHDF5ChunkFrame_t *pFrame, int queueSize);
+    void freeFrame(NDFileHDF5ChunkFrame_t *pFrame);
+    asynStatus drain();
+    void lock();
+    void unlock();
+    void addCompressStatistics(size_t rawBytes, size_t encodedBytes, double seconds);
+    void getStatistics(NDFileHDF5ChunkStats_t *pStats);
+    void resetStatistics();
+    void writerTask();
+
+#ifndef _UNITTEST_HDF5_
+  private:
+#endif
+    asynStatus writeFrame(NDFileHDF5ChunkFrame_t *pFrame);
+    void chunkOrigin(int index, hsize_t *origin);
+
+    asynUser    *pAsynUser_;
+    std::string name_;
+    int         stackSize_;
+
+    /* Chunk layout of one frame, in HDF5 dimension order (slowest first) */
+    std::vector<hsize_t> frameDims_;
+    std::vector<hsize_t> chunkDims_;
+    std::vector<hsize_t> chunksPerDim_;
+    int         extradims_;
+    int         numChunks_;
+    size_t      chunkElements_;
+    int         bytesPerElement_;
+    char        fillValue_[8];
+    NDFileHDF5ChunkCodec_t codec_;
+    int         level_;
+    int         shuffle_;
+    const char  *compressorName_;
+
+    epicsMutexId hdf5Lock_;     // Serializes HDF5 library calls with the writer thread
+    epicsMutexId queueLock_;    // Protects everything below
+    epicsEventId queueEvent_;   // Signalled when a frame is queued or the thread must exit
+    epicsEventId doneEvent_;    // Signalled when the writer thread finishes a frame or exits
+    std::deque<NDFileHDF5ChunkFrame_t *> queue_;
+    epicsThreadId thread_;
+    bool        busy_;
+    bool        exiting_;
+    bool        writeError_;
+    NDFileHDF5ChunkStats_t stats_;
+};
+
+#endif /* ADAPP_PLUGINSRC_NDFILEHDF5CHUNKWRITER_H_ */
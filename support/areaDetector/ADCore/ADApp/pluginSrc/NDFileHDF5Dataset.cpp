@@ -1,6 +1,9 @@
 #include "NDFileHDF5Dataset.h"
 #include <iostream>
 #include <stdlib.h>
+#if !H5_VERSION_GE(1,10,3)
+#include <H5DOpublic.h>
+#endif
 
 static const char *fileName = "NDFileHDF5Dataset";
 
@@ -246,3 +249,75 @@ asynStatus NDFileHDF5Dataset::flushDataset()
   return asynSuccess;  
 }
 
+
+/** getRank.
+ * Returns the number of dimensions of this dataset.
+ */
+int NDFileHDF5Dataset::getRank()
+{
+  return this->rank_;
+}
+
+/** reserveFrame.
+ * Used instead of writeFile when the frame is written as chunks with writeChunk.
+ * Returns the extent of the dataset including the frame and the position of the frame,
+ * as set by extendDataSet, and moves on to the next record.
+ * \param[out] dims - Array of getRank() elements for the extent of the dataset.
+ * \param[out] offset - Array of getRank() elements for the position of the frame.
+ */
+asynStatus NDFileHDF5Dataset::reserveFrame(hsize_t *dims, hsize_t *offset)
+{
+  for (int i=0; i<this->rank_; i++){
+    dims[i] = this->dims_[i];
+    offset[i] = this->offset_[i];
+  }
+  this->nextRecord_++;
+  return asynSuccess;
+}
+
+/** setExtent.
+ * Increase the size of the dataset.
+ * \param[in] dims - The new size of each dimension.
+ */
+asynStatus NDFileHDF5Dataset::setExtent(const hsize_t *dims)
+{
+  herr_t hdfstatus;
+  static const char *functionName = "setExtent";
+
+  hdfstatus = H5Dset_extent(this->dataset_, dims);
+  if (hdfstatus){
+    asynPrint(this->pAsynUser_, ASYN_TRACE_ERROR, 
+              "%s::%s ERROR Increasing the size of the dataset [%s] failed\n", 
+              fileName, functionName, this->name_.c_str());
+    return asynError;
+  }
+  return asynSuccess;
+}
+
+/** writeChunk.
+ * Write one chunk that has already been passed through the filter pipeline, bypassing
+ * the filters and the chunk cache of the HDF5 library.
+ * \param[in] offset - Position of the first element of the chunk in the dataset.
+ * \param[in] filterMask - Bit n is set if filter n of the pipeline was not applied.
+ * \param[in] size - Number of bytes in the chunk.
+ * \param[in] pData - The chunk data.
+ */
+asynStatus NDFileHDF5Dataset::writeChunk(const hsize_t *offset, uint32_t filterMask, size_t size, const void *pData)
+{
+  static const char *functionName = "writeChunk";
+  herr_t hdfstatus;
+
+  // H5Dwrite_chunk was added to the core library in 1.10.3; earlier versions have H5DOwrite_chunk in hdf5_hl
+  #if H5_VERSION_GE(1,10,3)
+  hdfstatus = H5Dwrite_chunk(this->dataset_, H5P_DEFAULT, filterMask, offset, size, pData);
+  #else
+  hdfstatus = H5DOwrite_chunk(this->dataset_, H5P_DEFAULT, filterMask, offset, size, pData);
+  #endif
+  if (hdfstatus < 0){
+    asynPrint(this->pAsynUser_, ASYN_TRACE_ERROR, 
+              "%s::%s ERROR Unable to write chunk to the dataset [%s]\n", 
+              fileName, functionName, this->name_.c_str());
+    return asynError;
+  }
+  return asynSuccess;
+}
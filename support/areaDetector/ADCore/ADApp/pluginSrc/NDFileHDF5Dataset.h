@@ -19,6 +19,10 @@ class NDFileHDF5Dataset
     asynStatus writeFile(NDArray *pArray, hid_t datatype, hid_t dataspace, hsize_t *framesize);
     hid_t getHandle();
     asynStatus flushDataset();
+    int getRank();
+    asynStatus reserveFrame(hsize_t *dims, hsize_t *offset);
+    asynStatus setExtent(const hsize_t *dims);
+    asynStatus writeChunk(const hsize_t *offset, uint32_t filterMask, size_t size, const void *pData);
 
 #ifndef _UNITTEST_HDF5_
   private:
@@ -38,6 +38,7 @@
 #include "NDFileTIFF.h"
 
 #define STRING_BUFFER_SIZE 2048
+#define MAX_WRITE_THREADS 64
  
 static const char *driverName = "NDFileTIFF";
 
@@ -49,7 +50,8 @@ static const int TIFFTAG_EPICSTSNSEC     = 65003;
 static const int TIFFTAG_FIRST_ATTRIBUTE = 65010;
 static const int TIFFTAG_LAST_ATTRIBUTE  = 65500;
 
-#define NUM_CUSTOM_TIFF_TAGS (4 + TIFFTAG_LAST_ATTRIBUTE - TIFFTAG_FIRST_ATTRIBUTE - 1)
+#define NUM_ATTRIBUTE_TIFF_TAGS (TIFFTAG_LAST_ATTRIBUTE - TIFFTAG_FIRST_ATTRIBUTE)
+#define NUM_CUSTOM_TIFF_TAGS (4 + NUM_ATTRIBUTE_TIFF_TAGS)
 
 static TIFFFieldInfo tiffFieldInfo[NUM_CUSTOM_TIFF_TAGS] = {
     {TIFFTAG_NDTIMESTAMP, 1, 1, TIFF_DOUBLE,FIELD_CUSTOM, 1, 0, (char *)"NDTimeStamp"},
@@ -57,6 +59,8 @@ static TIFFFieldInfo tiffFieldInfo[NUM_CUSTOM_TIFF_TAGS] = {
     {TIFFTAG_EPICSTSSEC,  1, 1, TIFF_LONG,FIELD_CUSTOM,   1, 0, (char *)"EPICSTSSec"},
     {TIFFTAG_EPICSTSNSEC, 1, 1, TIFF_LONG,FIELD_CUSTOM,   1, 0, (char *)"EPICSTSNsec"}
 };
+static char attributeTagNames[NUM_ATTRIBUTE_TIFF_TAGS][20];
+static epicsThreadOnceId customTagsOnceId = EPICS_THREAD_ONCE_INIT;
 
 static void registerCustomTIFFTags(TIFF *tif)
 {
@@ -64,15 +68,105 @@ static void registerCustomTIFFTags(TIFF *tif)
     TIFFMergeFieldInfo(tif, tiffFieldInfo, sizeof(tiffFieldInfo)/sizeof(tiffFieldInfo[0]));
 }
 
-static void augmentLibTiffWithCustomTags() {
-    static bool first_time = true;
-    if (!first_time) return;
-    first_time = false;
+static void initCustomTIFFTags(void *arg)
+{
+    TIFFFieldInfo fieldInfo = {0, 1, 1, TIFF_ASCII, FIELD_CUSTOM, 1, 0, NULL};
+    int i;
+
+    for (i=0; i<NUM_ATTRIBUTE_TIFF_TAGS; i++) {
+        sprintf(attributeTagNames[i], "Attribute_%d", i+1);
+        fieldInfo.field_tag = TIFFTAG_FIRST_ATTRIBUTE + i;
+        fieldInfo.field_name = attributeTagNames[i];
+        tiffFieldInfo[4+i] = fieldInfo;
+    }
     TIFFSetTagExtender(registerCustomTIFFTags);
+
+    /* Suppress error and warning messages from the TIFF library */
+    TIFFSetErrorHandler(NULL);
+    TIFFSetWarningHandler(NULL);
+}
+
+/* This is done once, because the tags are used by the writer threads of all plugins */
+static void augmentLibTiffWithCustomTags() {
+    epicsThreadOnce(&customTagsOnceId, initCustomTIFFTags, NULL);
+}
+
+/** Sets the tags of a TIFF file opened for writing */
+static void setTIFFTags(TIFF *tiff, const NDTIFFFile_t *pFile)
+{
+    size_t i;
+
+    TIFFSetField(tiff, TIFFTAG_NDTIMESTAMP, pFile->timeStamp);
+    TIFFSetField(tiff, TIFFTAG_UNIQUEID, pFile->uniqueId);
+    TIFFSetField(tiff, TIFFTAG_EPICSTSSEC, pFile->epicsTS.secPastEpoch);
+    TIFFSetField(tiff, TIFFTAG_EPICSTSNSEC, pFile->epicsTS.nsec);
+    TIFFSetField(tiff, TIFFTAG_BITSPERSAMPLE, pFile->bitsPerSample);
+    TIFFSetField(tiff, TIFFTAG_SAMPLEFORMAT, pFile->sampleFormat);
+    TIFFSetField(tiff, TIFFTAG_SAMPLESPERPIXEL, pFile->samplesPerPixel);
+    TIFFSetField(tiff, TIFFTAG_PHOTOMETRIC, pFile->photoMetric);
+    TIFFSetField(tiff, TIFFTAG_PLANARCONFIG, pFile->planarConfig);
+    TIFFSetField(tiff, TIFFTAG_IMAGEWIDTH, pFile->sizeX);
+    TIFFSetField(tiff, TIFFTAG_IMAGELENGTH, pFile->sizeY);
+    TIFFSetField(tiff, TIFFTAG_ROWSPERSTRIP, pFile->rowsPerStrip);
+    TIFFSetField(tiff, TIFFTAG_MODEL, pFile->model.c_str());
+    TIFFSetField(tiff, TIFFTAG_MAKE, pFile->make.c_str());
+    TIFFSetField(tiff, TIFFTAG_SOFTWARE, "EPICS areaDetector");
+    if (pFile->hasDescription) {
+        TIFFSetField(tiff, TIFFTAG_IMAGEDESCRIPTION, pFile->description.c_str());
+    }
+    for (i=0; i<pFile->attributeTags.size(); i++) {
+        TIFFSetField(tiff, TIFFTAG_FIRST_ATTRIBUTE + (int)i, pFile->attributeTags[i].c_str());
+    }
+}
+
+/** Writes the data of an NDArray to a TIFF file; returns the result of the last TIFFWriteEncodedStrip,
+  * or -1 if the color mode is not supported */
+static tsize_t writeTIFFStrips(TIFF *tiff, NDColorMode_t colorMode, NDArray *pArray)
+{
+    unsigned long stripSize;
+    tsize_t nwrite=-1;
+    int strip, sizeY;
+    unsigned char *pRed, *pGreen, *pBlue;
+
+    stripSize = (unsigned long)TIFFStripSize(tiff);
+    TIFFGetField(tiff, TIFFTAG_IMAGELENGTH, &sizeY);
+
+    switch (colorMode) {
+        case NDColorModeMono:
+        case NDColorModeRGB1:
+            nwrite = TIFFWriteEncodedStrip(tiff, 0, pArray->pData, stripSize); 
+            break;
+        case NDColorModeRGB2:
+            /* TIFF readers don't support row interleave, put all the red strips first, then all the blue, then green. */
+            for (strip=0; strip<sizeY; strip++) {
+                pRed   = (unsigned char *)pArray->pData + 3*strip*stripSize;
+                pGreen = pRed + stripSize;
+                pBlue  = pRed + 2*stripSize;
+                nwrite = TIFFWriteEncodedStrip(tiff, strip, pRed, stripSize);
+                nwrite = TIFFWriteEncodedStrip(tiff, sizeY+strip, pGreen, stripSize);
+                nwrite = TIFFWriteEncodedStrip(tiff, 2*sizeY+strip, pBlue, stripSize);
+            }
+            break;
+        case NDColorModeRGB3:
+            for (strip=0; strip<3; strip++) {
+                nwrite = TIFFWriteEncodedStrip(tiff, strip, (unsigned char *)pArray->pData+stripSize*strip, stripSize);
+            }
+            break;
+        default:
+            break;
+    }
+    return nwrite;
 }
 
+static void writerTaskC(void *drvPvt)
+{
+    NDFileTIFF *pPvt = (NDFileTIFF *)drvPvt;
+    pPvt->writerTask();
+}
 
 /** Opens a TIFF file.
+  * If TIFF_WRITE_THREADS > 0 and there is no temporary file suffix, a file opened for writing is only
+  * opened by a writer thread after writeFile is called.
   * \param[in] fileName The name of the file to open.
   * \param[in] openMode Mask defining how the file should be opened; bits are 
   *            NDFileModeRead, NDFileModeWrite, NDFileModeAppend, NDFileModeMultiple
@@ -80,30 +174,13 @@ static void augmentLibTiffWithCustomTags() {
   */
 asynStatus NDFileTIFF::openFile(const char *fileName, NDFileOpenMode_t openMode, NDArray *pArray)
 {
-    /* When we create TIFF variables and dimensions, we get back an
-     * ID for each one. */
     static const char *functionName = "openFile";
-    size_t sizeX, sizeY, rowsPerStrip;
-    int bitsPerSample=8, sampleFormat=SAMPLEFORMAT_INT, samplesPerPixel, photoMetric, planarConfig;
-    int colorMode=NDColorModeMono;
-    NDAttribute *pAttribute = NULL;
-    char tagString[STRING_BUFFER_SIZE] = {0};
-    char attrString[STRING_BUFFER_SIZE] = {0};
-    char tagName[STRING_BUFFER_SIZE] = {0};
-    int i;
-    TIFFFieldInfo fieldInfo = {0, 1, 1, TIFF_ASCII, FIELD_CUSTOM, 1, 0, tagName};
-
-    for (i=TIFFTAG_FIRST_ATTRIBUTE; i<TIFFTAG_LAST_ATTRIBUTE; i++) {
-        sprintf(tagName, "Attribute_%d", i-TIFFTAG_FIRST_ATTRIBUTE+1);
-        fieldInfo.field_tag = i;
-        tiffFieldInfo[4+i-TIFFTAG_FIRST_ATTRIBUTE] = fieldInfo;
-    }
+    char tempSuffix[MAX_FILENAME_LEN];
+    int numWriters;
+    asynStatus status;
 
     augmentLibTiffWithCustomTags();
-
-    /* Suppress error and warning messages from the TIFF library */
-    TIFFSetErrorHandler(NULL);
-    TIFFSetWarningHandler(NULL);
+    epicsTimeGetCurrent(&this->openTime_);
 
     /* We don't support opening an existing file for appending yet */
     if (openMode & NDFileModeAppend) return(asynError);
@@ -120,94 +197,129 @@ asynStatus NDFileTIFF::openFile(const char *fileName, NDFileOpenMode_t openMode,
         asynPrint(pasynUserSelf, ASYN_TRACE_FLOW,
             "%s::%s opened file %s\n", 
             driverName, functionName, fileName);
+        return asynSuccess;
+    }
+
+    status = getFileTags(fileName, pArray, &this->file_);
+    if (status) return status;
+
+    /* The temporary file is renamed when closeFile returns, so it must be written by this thread.
+     * The number of writer threads is changed here, because no file is being queued. */
+    this->lock();
+    getIntegerParam(NDFileTIFFWriteThreads, &numWriters);
+    getStringParam(NDFileTempSuffix, sizeof(tempSuffix), tempSuffix);
+    this->unlock();
+    if (numWriters < 0) numWriters = 0;
+    if (numWriters > MAX_WRITE_THREADS) numWriters = MAX_WRITE_THREADS;
+    if (numWriters != this->numWriters_) {
+        stopWriters();
+        startWriters(numWriters);
     }
+    this->useWriters_ = (this->numWriters_ > 0) && (tempSuffix[0] == 0);
+    if (this->useWriters_) return asynSuccess;
 
     /* Open file for writing */
-    else if (openMode & NDFileModeWrite) {
-        if ((this->tiff = TIFFOpen(fileName, "w")) == NULL ) {
-            asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR, 
-            "%s:%s error opening file %s\n",
-            driverName, functionName, fileName);
-            return(asynError);
-        }
-        asynPrint(pasynUserSelf, ASYN_TRACE_FLOW,
-            "%s::%s opened file %s\n", 
-            driverName, functionName, fileName);
+    if ((this->tiff = TIFFOpen(fileName, "w")) == NULL ) {
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR, 
+        "%s:%s error opening file %s\n",
+        driverName, functionName, fileName);
+        return(asynError);
     }
+    asynPrint(pasynUserSelf, ASYN_TRACE_FLOW,
+        "%s::%s opened file %s\n", 
+        driverName, functionName, fileName);
+    setTIFFTags(this->tiff, &this->file_);
+    return(asynSuccess);
+}
+
+/** Gets the name, the tags and the structure of a TIFF file for an NDArray.
+  * \param[in] fileName The name of the file.
+  * \param[in] pArray A pointer to an NDArray; this is used to determine the array and attribute properties.
+  * \param[out] pFile The file name and tags.
+  */
+asynStatus NDFileTIFF::getFileTags(const char *fileName, NDArray *pArray, NDTIFFFile_t *pFile)
+{
+    static const char *functionName = "getFileTags";
+    int colorMode=NDColorModeMono;
+    NDAttribute *pAttribute = NULL;
+    char tagString[STRING_BUFFER_SIZE] = {0};
+    char attrString[STRING_BUFFER_SIZE] = {0};
+
+    pFile->fileName = fileName;
+    pFile->bitsPerSample = 8;
+    pFile->sampleFormat = SAMPLEFORMAT_INT;
+    pFile->pArray = NULL;
 
-    // If the file is open for reading we are done
-    if (openMode & NDFileModeRead) return asynSuccess;
-    
     /* We do some special treatment based on colorMode */
     pAttribute = pArray->pAttributeList->find("ColorMode");
     if (pAttribute) pAttribute->getValue(NDAttrInt32, &colorMode);
 
     switch (pArray->dataType) {
         case NDInt8:
-            sampleFormat = SAMPLEFORMAT_INT;
-            bitsPerSample = 8;
+            pFile->sampleFormat = SAMPLEFORMAT_INT;
+            pFile->bitsPerSample = 8;
             break;
         case NDUInt8:
-            sampleFormat = SAMPLEFORMAT_UINT;
-            bitsPerSample = 8;
+            pFile->sampleFormat = SAMPLEFORMAT_UINT;
+            pFile->bitsPerSample = 8;
             break;
         case NDInt16:
-            sampleFormat = SAMPLEFORMAT_INT;
-            bitsPerSample = 16;
+            pFile->sampleFormat = SAMPLEFORMAT_INT;
+            pFile->bitsPerSample = 16;
             break;
         case NDUInt16:
-            sampleFormat = SAMPLEFORMAT_UINT;
-            bitsPerSample = 16;
+            pFile->sampleFormat = SAMPLEFORMAT_UINT;
+            pFile->bitsPerSample = 16;
             break;
         case NDInt32:
-            sampleFormat = SAMPLEFORMAT_INT;
-            bitsPerSample = 32;
+            pFile->sampleFormat = SAMPLEFORMAT_INT;
+            pFile->bitsPerSample = 32;
             break;
         case NDUInt32:
-            sampleFormat = SAMPLEFORMAT_UINT;
-            bitsPerSample = 32;
+            pFile->sampleFormat = SAMPLEFORMAT_UINT;
+            pFile->bitsPerSample = 32;
             break;
         case NDFloat32:
-            sampleFormat = SAMPLEFORMAT_IEEEFP;
-            bitsPerSample = 32;
+            pFile->sampleFormat = SAMPLEFORMAT_IEEEFP;
+            pFile->bitsPerSample = 32;
             break;
         case NDFloat64:
-            sampleFormat = SAMPLEFORMAT_IEEEFP;
-            bitsPerSample = 64;
+            pFile->sampleFormat = SAMPLEFORMAT_IEEEFP;
+            pFile->bitsPerSample = 64;
             break;
     }
     if (pArray->ndims == 2) {
-        sizeX = pArray->dims[0].size;
-        sizeY = pArray->dims[1].size;
-        rowsPerStrip = sizeY;
-        samplesPerPixel = 1;
-        photoMetric = PHOTOMETRIC_MINISBLACK;
-        planarConfig = PLANARCONFIG_CONTIG;
-        this->colorMode = NDColorModeMono;
+        pFile->sizeX = (epicsUInt32)pArray->dims[0].size;
+        pFile->sizeY = (epicsUInt32)pArray->dims[1].size;
+        pFile->rowsPerStrip = pFile->sizeY;
+        pFile->samplesPerPixel = 1;
+        pFile->photoMetric = PHOTOMETRIC_MINISBLACK;
+        pFile->planarConfig = PLANARCONFIG_CONTIG;
+        pFile->colorMode = NDColorModeMono;
     } else if ((pArray->ndims == 3) && (pArray->dims[0].size == 3) && (colorMode == NDColorModeRGB1)) {
-        sizeX = pArray->dims[1].size;
-        sizeY = pArray->dims[2].size;
-        rowsPerStrip = sizeY;
-        samplesPerPixel = 3;
-        photoMetric = PHOTOMETRIC_RGB;
-        planarConfig = PLANARCONFIG_CONTIG;
-        this->colorMode = NDColorModeRGB1;
+        pFile->sizeX = (epicsUInt32)pArray->dims[1].size;
+        pFile->sizeY = (epicsUInt32)pArray->dims[2].size;
+        pFile->rowsPerStrip = pFile->sizeY;
+        pFile->samplesPerPixel = 3;
+        pFile->photoMetric = PHOTOMETRIC_RGB;
+        pFile->planarConfig = PLANARCONFIG_CONTIG;
+        pFile->colorMode = NDColorModeRGB1;
     } else if ((pArray->ndims == 3) && (pArray->dims[1].size == 3) && (colorMode == NDColorModeRGB2)) {
-        sizeX = pArray->dims[0].size;
-        sizeY = pArray->dims[2].size;
-        rowsPerStrip = 1;
-        samplesPerPixel = 3;
-        photoMetric = PHOTOMETRIC_RGB;
-        planarConfig = PLANARCONFIG_SEPARATE;
-        this->colorMode = NDColorModeRGB2;
+        pFile->sizeX = (epicsUInt32)pArray->dims[0].size;
+        pFile->sizeY = (epicsUInt32)pArray->dims[2].size;
+        pFile->rowsPerStrip = 1;
+        pFile->samplesPerPixel = 3;
+        pFile->photoMetric = PHOTOMETRIC_RGB;
+        pFile->planarConfig = PLANARCONFIG_SEPARATE;
+        pFile->colorMode = NDColorModeRGB2;
     } else if ((pArray->ndims == 3) && (pArray->dims[2].size == 3) && (colorMode == NDColorModeRGB3)) {
-        sizeX = pArray->dims[0].size;
-        sizeY = pArray->dims[1].size;
-        rowsPerStrip = sizeY;
-        samplesPerPixel = 3;
-        photoMetric = PHOTOMETRIC_RGB;
-        planarConfig = PLANARCONFIG_SEPARATE;
-        this->colorMode = NDColorModeRGB3;
+        pFile->sizeX = (epicsUInt32)pArray->dims[0].size;
+        pFile->sizeY = (epicsUInt32)pArray->dims[1].size;
+        pFile->rowsPerStrip = pFile->sizeY;
+        pFile->samplesPerPixel = 3;
+        pFile->photoMetric = PHOTOMETRIC_RGB;
+        pFile->planarConfig = PLANARCONFIG_SEPARATE;
+        pFile->colorMode = NDColorModeRGB3;
     } else {
         asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR, 
             "%s:%s: unsupported array structure\n",
@@ -215,19 +327,10 @@ asynStatus NDFileTIFF::openFile(const char *fileName, NDFileOpenMode_t openMode,
         return(asynError);
     }
 
-    TIFFSetField(this->tiff, TIFFTAG_NDTIMESTAMP, pArray->timeStamp);
-    TIFFSetField(this->tiff, TIFFTAG_UNIQUEID, pArray->uniqueId);
-    TIFFSetField(this->tiff, TIFFTAG_EPICSTSSEC, pArray->epicsTS.secPastEpoch);
-    TIFFSetField(this->tiff, TIFFTAG_EPICSTSNSEC, pArray->epicsTS.nsec);
-    TIFFSetField(this->tiff, TIFFTAG_BITSPERSAMPLE, bitsPerSample);
-    TIFFSetField(this->tiff, TIFFTAG_SAMPLEFORMAT, sampleFormat);
-    TIFFSetField(this->tiff, TIFFTAG_SAMPLESPERPIXEL, samplesPerPixel);
-    TIFFSetField(this->tiff, TIFFTAG_PHOTOMETRIC, photoMetric);
-    TIFFSetField(this->tiff, TIFFTAG_PLANARCONFIG, planarConfig);
-    TIFFSetField(this->tiff, TIFFTAG_IMAGEWIDTH, (epicsUInt32)sizeX);
-    TIFFSetField(this->tiff, TIFFTAG_IMAGELENGTH, (epicsUInt32)sizeY);
-    TIFFSetField(this->tiff, TIFFTAG_ROWSPERSTRIP, (epicsUInt32)rowsPerStrip);   
-    
+    pFile->timeStamp = pArray->timeStamp;
+    pFile->uniqueId = pArray->uniqueId;
+    pFile->epicsTS = pArray->epicsTS;
+
     this->pFileAttributes->clear();
     this->getAttributes(this->pFileAttributes);
     pArray->pAttributeList->copy(this->pFileAttributes);
@@ -235,32 +338,32 @@ asynStatus NDFileTIFF::openFile(const char *fileName, NDFileOpenMode_t openMode,
     pAttribute = this->pFileAttributes->find("Model");
     if (pAttribute) {
         pAttribute->getValue(NDAttrString, tagString, sizeof(tagString)-1);
-        TIFFSetField(this->tiff, TIFFTAG_MODEL, tagString);
+        pFile->model = tagString;
     } else {
-        TIFFSetField(this->tiff, TIFFTAG_MODEL, "Unknown");
+        pFile->model = "Unknown";
     }
     
     pAttribute = this->pFileAttributes->find("Manufacturer");
     if (pAttribute) {
-        pAttribute->getValue(NDAttrString, tagString);
-        TIFFSetField(this->tiff, TIFFTAG_MAKE, tagString, sizeof(tagString)-1);
+        pAttribute->getValue(NDAttrString, tagString, sizeof(tagString)-1);
+        pFile->make = tagString;
     } else {
-        TIFFSetField(this->tiff, TIFFTAG_MAKE, "Unknown");
+        pFile->make = "Unknown";
     }
 
-    TIFFSetField(this->tiff, TIFFTAG_SOFTWARE, "EPICS areaDetector");
-
     // If the attribute TIFFImageDescription exists use it to set the TIFFTAG_IMAGEDESCRIPTION
     pAttribute = this->pFileAttributes->find("TIFFImageDescription");
+    pFile->hasDescription = (pAttribute != NULL);
     if (pAttribute) {
         pAttribute->getValue(NDAttrString, tagString, sizeof(tagString)-1);
-        TIFFSetField(this->tiff, TIFFTAG_IMAGEDESCRIPTION, tagString);
+        pFile->description = tagString;
     }
 
     int count = 0;
     int tagId = TIFFTAG_FIRST_ATTRIBUTE;
    
     numAttributes_ = this->pFileAttributes->count();
+    pFile->attributeTags.clear();
     asynPrint(this->pasynUserSelf, ASYN_TRACEIO_DRIVER,
         "%s:%s this->pFileAttributes->count(): %d\n",
         driverName, functionName, numAttributes_);
@@ -326,7 +429,7 @@ asynStatus NDFileTIFF::openFile(const char *fileName, NDFileOpenMode_t openMode,
             asynPrint(this->pasynUserSelf, ASYN_TRACEIO_DRIVER,
                 "%s:%s : tagId: %d, tagString: %s\n",
                   driverName, functionName, tagId, tagString);
-            TIFFSetField(this->tiff, tagId, tagString);
+            pFile->attributeTags.push_back(tagString);
             ++count;
             ++tagId;
             if ((tagId == TIFFTAG_LAST_ATTRIBUTE) || (count > numAttributes_)) {
@@ -343,20 +446,31 @@ asynStatus NDFileTIFF::openFile(const char *fileName, NDFileOpenMode_t openMode,
 }
 
 /** Writes single NDArray to the TIFF file.
+  * If the file is written by the writer threads the NDArray is queued for them; this waits if the queue is full.
   * \param[in] pArray Pointer to the NDArray to be written
   */
 asynStatus NDFileTIFF::writeFile(NDArray *pArray)
 {
-    unsigned long stripSize;
     tsize_t nwrite=0;
-    int strip, sizeY;
-    unsigned char *pRed, *pGreen, *pBlue;
+    NDTIFFFile_t *pFile;
     static const char *functionName = "writeFile";
 
     asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW,
               "%s:%s: writing file dimensions=[%lu, %lu]\n", 
               driverName, functionName, (unsigned long)pArray->dims[0].size, (unsigned long)pArray->dims[1].size);
 
+    if (this->useWriters_) {
+        pFile = new NDTIFFFile_t(this->file_);
+        pArray->reserve();
+        pFile->pArray = pArray;
+        this->lock();
+        this->filesPending_++;
+        setIntegerParam(NDFileTIFFFilesPending, this->filesPending_);
+        this->unlock();
+        this->pWriterQ_->send(&pFile, sizeof(pFile));
+        return(asynSuccess);
+    }
+
     if (this->tiff == NULL) {
         asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR, 
         "%s:%s NULL TIFF file\n",
@@ -364,37 +478,7 @@ asynStatus NDFileTIFF::writeFile(NDArray *pArray)
         return(asynError);
     }
 
-    stripSize = (unsigned long)TIFFStripSize(this->tiff);
-    TIFFGetField(this->tiff, TIFFTAG_IMAGELENGTH, &sizeY);
-
-    switch (this->colorMode) {
-        case NDColorModeMono:
-        case NDColorModeRGB1:
-            nwrite = TIFFWriteEncodedStrip(this->tiff, 0, pArray->pData, stripSize); 
-            break;
-        case NDColorModeRGB2:
-            /* TIFF readers don't support row interleave, put all the red strips first, then all the blue, then green. */
-            for (strip=0; strip<sizeY; strip++) {
-                pRed   = (unsigned char *)pArray->pData + 3*strip*stripSize;
-                pGreen = pRed + stripSize;
-                pBlue  = pRed + 2*stripSize;
-                nwrite = TIFFWriteEncodedStrip(this->tiff, strip, pRed, stripSize);
-                nwrite = TIFFWriteEncodedStrip(this->tiff, sizeY+strip, pGreen, stripSize);
-                nwrite = TIFFWriteEncodedStrip(this->tiff, 2*sizeY+strip, pBlue, stripSize);
-            }
-            break;
-        case NDColorModeRGB3:
-            for (strip=0; strip<3; strip++) {
-                nwrite = TIFFWriteEncodedStrip(this->tiff, strip, (unsigned char *)pArray->pData+stripSize*strip, stripSize);
-            }
-            break;
-        default:
-            asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR, 
-                "%s:%s: unknown color mode %d\n",
-                driverName, functionName, this->colorMode);
-            return(asynError);
-            break;
-    }
+    nwrite = writeTIFFStrips(this->tiff, this->file_.colorMode, pArray);
     if (nwrite <= 0) {
         asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR, 
             "%s:%s: error writing data to file\n",
@@ -542,11 +626,17 @@ asynStatus NDFileTIFF::readFile(NDArray **pArray)
 }
 
 
-/** Closes the TIFF file. */
+/** Closes the TIFF file.  If the file is written by the writer threads they close it. */
 asynStatus NDFileTIFF::closeFile()
 {
+    epicsTimeStamp tEnd;
     static const char *functionName = "closeFile";
 
+    if (this->useWriters_) {
+        this->useWriters_ = false;
+        return asynSuccess;
+    }
+
     if (this->tiff == NULL) {
         asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR, 
         "%s:%s NULL TIFF file\n",
@@ -558,11 +648,111 @@ asynStatus NDFileTIFF::closeFile()
         "%s::%s closing file\n", 
         driverName, functionName);
     TIFFClose(this->tiff);
+    this->tiff = NULL;
+    epicsTimeGetCurrent(&tEnd);
+    this->lock();
+    setDoubleParam(NDFileTIFFFileLatency, epicsTimeDiffInSeconds(&tEnd, &this->openTime_)*1e3);
+    this->unlock();
 
     return asynSuccess;
 }
 
-
+/** Writer thread; opens, writes and closes the files queued by writeFile until it receives a NULL file. */
+void NDFileTIFF::writerTask()
+{
+    NDTIFFFile_t *pFile;
+    TIFF *tiff;
+    epicsTimeStamp tStart, tEnd;
+    asynStatus status;
+
+    while (1) {
+        this->pWriterQ_->receive(&pFile, sizeof(pFile));
+        if (pFile == NULL) break;
+        epicsTimeGetCurrent(&tStart);
+        status = asynError;
+        tiff = TIFFOpen(pFile->fileName.c_str(), "w");
+        if (tiff) {
+            setTIFFTags(tiff, pFile);
+            if ((writeTIFFStrips(tiff, pFile->colorMode, pFile->pArray) > 0) && (TIFFFlush(tiff) == 1)) {
+                status = asynSuccess;
+            }
+            TIFFClose(tiff);
+        }
+        epicsTimeGetCurrent(&tEnd);
+        pFile->pArray->release();
+        fileDone(pFile, status, epicsTimeDiffInSeconds(&tEnd, &tStart));
+        delete pFile;
+    }
+    epicsEventSignal(this->writerExitEvent_);
+}
+
+/** Called by a writer thread when it has written a file.
+  * \param[in] pFile The file.
+  * \param[in] status The status of writing the file.
+  * \param[in] seconds The time to open, write and close the file. */
+void NDFileTIFF::fileDone(const NDTIFFFile_t *pFile, asynStatus status, double seconds)
+{
+    char errorMessage[256];
+    int writeErrors;
+    static const char *functionName = "fileDone";
+
+    this->lock();
+    this->filesPending_--;
+    setIntegerParam(NDFileTIFFFilesPending, this->filesPending_);
+    setDoubleParam(NDFileTIFFFileLatency, seconds*1e3);
+    if (status) {
+        epicsSnprintf(errorMessage, sizeof(errorMessage)-1, 
+            "Error writing file %s", pFile->fileName.c_str());
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR, 
+            "%s::%s %s\n", 
+            driverName, functionName, errorMessage);
+        setIntegerParam(NDFileWriteStatus, NDFileWriteError);
+        setStringParam(NDFileWriteMessage, errorMessage);
+        /* WriteStatus is reset when the next file is opened, the count is kept */
+        getIntegerParam(NDFileTIFFWriteErrors, &writeErrors);
+        setIntegerParam(NDFileTIFFWriteErrors, writeErrors+1);
+    }
+    callParamCallbacks();
+    this->unlock();
+}
+
+/** Creates the writer threads and their queue.
+  * \param[in] numWriters The number of writer threads; none are created if this is 0. */
+void NDFileTIFF::startWriters(int numWriters)
+{
+    char taskName[256];
+    int i;
+
+    if (numWriters <= 0) return;
+    /* Each thread can have one file queued while it writes another */
+    this->pWriterQ_ = new epicsMessageQueue(2*numWriters, sizeof(NDTIFFFile_t *));
+    for (i=0; i<numWriters; i++) {
+        epicsSnprintf(taskName, sizeof(taskName)-1, "%s_TIFF_%d", portName, i+1);
+        epicsThreadMustCreate(taskName, epicsThreadPriorityMedium,
+                              epicsThreadGetStackSize(epicsThreadStackMedium),
+                              (EPICSTHREADFUNC)writerTaskC, this);
+    }
+    this->numWriters_ = numWriters;
+}
+
+/** Stops the writer threads after they have written the queued files, and deletes their queue.
+  * This must be called without the lock held. */
+void NDFileTIFF::stopWriters()
+{
+    NDTIFFFile_t *pFile = NULL;
+    int i;
+
+    if (this->numWriters_ == 0) return;
+    /* The exit event is binary, so stop the threads one at a time */
+    for (i=0; i<this->numWriters_; i++) {
+        this->pWriterQ_->send(&pFile, sizeof(pFile));
+        epicsEventMustWait(this->writerExitEvent_);
+    }
+    delete this->pWriterQ_;
+    this->pWriterQ_ = NULL;
+    this->numWriters_ = 0;
+}
+
 /** Constructor for NDFileTIFF; all parameters are simply passed to NDPluginFile::NDPluginFile.
   * \param[in] portName The name of the asyn port driver to be created.
   * \param[in] queueSize The number of NDArrays that the input queue for this plugin can hold when 
@@ -597,6 +787,29 @@ NDFileTIFF::NDFileTIFF(const char *portName, int queueSize, int blockingCallback
 
     this->pAttributeId = NULL;
     this->pFileAttributes = new NDAttributeList;
+    this->tiff = NULL;
+    this->useWriters_ = false;
+    this->numWriters_ = 0;
+    this->filesPending_ = 0;
+    this->pWriterQ_ = NULL;
+    this->writerExitEvent_ = epicsEventMustCreate(epicsEventEmpty);
+
+    createParam(NDFileTIFFWriteThreadsString, asynParamInt32,   &NDFileTIFFWriteThreads);
+    createParam(NDFileTIFFFilesPendingString, asynParamInt32,   &NDFileTIFFFilesPending);
+    createParam(NDFileTIFFFileLatencyString,  asynParamFloat64, &NDFileTIFFFileLatency);
+    createParam(NDFileTIFFWriteErrorsString,  asynParamInt32,   &NDFileTIFFWriteErrors);
+    setIntegerParam(NDFileTIFFWriteThreads, 0);
+    setIntegerParam(NDFileTIFFFilesPending, 0);
+    setDoubleParam(NDFileTIFFFileLatency, 0.0);
+    setIntegerParam(NDFileTIFFWriteErrors, 0);
+}
+
+/** Destructor; waits for the writer threads to write the queued files. */
+NDFileTIFF::~NDFileTIFF()
+{
+    stopWriters();
+    epicsEventDestroy(this->writerExitEvent_);
+    delete this->pFileAttributes;
 }
 
 /* Configuration routine.  Called directly, or from the iocsh  */
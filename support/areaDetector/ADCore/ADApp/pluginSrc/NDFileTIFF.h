@@ -8,6 +8,13 @@
 #ifndef DRV_NDFileTIFF_H
 #define DRV_NDFileTIFF_H
 
+#include <string>
+#include <vector>
+
+#include <epicsEvent.h>
+#include <epicsMessageQueue.h>
+#include <epicsTime.h>
+
 #include "NDPluginFile.h"
 #include "tiffio.h"
 
@@ -15,10 +22,42 @@
  * to handle changes in the file contents */
 #define NDTIFFFileVersion 1.0
 
+#define NDFileTIFFWriteThreadsString  "TIFF_WRITE_THREADS"  /* (asynInt32,   r/w) Threads writing files, 0=write in the plugin thread */
+#define NDFileTIFFFilesPendingString  "TIFF_FILES_PENDING"  /* (asynInt32,   r/o) Files queued or being written by the threads */
+#define NDFileTIFFFileLatencyString   "TIFF_FILE_LATENCY"   /* (asynFloat64, r/o) Time to open, write and close the last file (ms) */
+#define NDFileTIFFWriteErrorsString   "TIFF_WRITE_ERRORS"   /* (asynInt32,   r/w) Files the writer threads failed to write, write 0 to reset */
+
+/** The name, tags and data of one TIFF file, so that the file can be written by a writer thread */
+typedef struct {
+    std::string fileName;
+    NDColorMode_t colorMode;
+    int bitsPerSample;
+    int sampleFormat;
+    int samplesPerPixel;
+    int photoMetric;
+    int planarConfig;
+    epicsUInt32 sizeX;
+    epicsUInt32 sizeY;
+    epicsUInt32 rowsPerStrip;
+    double timeStamp;
+    int uniqueId;
+    epicsTimeStamp epicsTS;
+    std::string model;
+    std::string make;
+    bool hasDescription;
+    std::string description;
+    std::vector<std::string> attributeTags;     /**< "name:value" for each NDAttribute */
+    NDArray *pArray;                            /**< The array to write, reserved until the file is written */
+} NDTIFFFile_t;
+
 /** Writes NDArrays in the TIFF file format.
     Tagged Image File Format is a file format for storing images.  The format was originally created by Aldus corporation and is
     currently developed by Adobe Systems Incorporated.  This plugin was developed using the libtiff library to write the file.
     The current version is only capable of writing 2-D images with one image per file.
+    If TIFF_WRITE_THREADS is greater than 0 the files are opened, written and closed by that many writer
+    threads, so several files can be written at once.  The file names are still assigned in order by the
+    plugin thread.  FullFileName is then set before the file exists.  WriteStatus and WriteMessage
+    show an error from a writer thread until the next file is opened, and TIFF_WRITE_ERRORS counts them.
     */
 
 class epicsShareClass NDFileTIFF : public NDPluginFile {
@@ -32,10 +71,31 @@ public:
     virtual asynStatus readFile(NDArray **pArray);
     virtual asynStatus writeFile(NDArray *pArray);
     virtual asynStatus closeFile();
+    virtual ~NDFileTIFF();
+    /* This should be private but is called from C so must be public */
+    void writerTask();
+
+protected:
+    int NDFileTIFFWriteThreads;
+    #define FIRST_NDFILE_TIFF_PARAM NDFileTIFFWriteThreads
+    int NDFileTIFFFilesPending;
+    int NDFileTIFFFileLatency;
+    int NDFileTIFFWriteErrors;
 
 private:
+    asynStatus getFileTags(const char *fileName, NDArray *pArray, NDTIFFFile_t *pFile);
+    void startWriters(int numWriters);
+    void stopWriters();
+    void fileDone(const NDTIFFFile_t *pFile, asynStatus status, double seconds);
+
     TIFF *tiff;
-    NDColorMode_t colorMode;
+    NDTIFFFile_t file_;                 /**< The file opened by openFile */
+    bool useWriters_;                   /**< The file opened by openFile will be written by the writer threads */
+    epicsTimeStamp openTime_;
+    int numWriters_;
+    int filesPending_;
+    epicsMessageQueue *pWriterQ_;       /**< Files for the writer threads, as NDTIFFFile_t pointers */
+    epicsEventId writerExitEvent_;
     int *pAttributeId;
     NDAttributeList *pFileAttributes;
     int numAttributes_;
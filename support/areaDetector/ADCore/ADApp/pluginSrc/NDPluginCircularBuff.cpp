@@ -11,6 +11,9 @@
 #include <string.h>
 #include <stdio.h>
 #include <math.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
 
 #include <epicsTypes.h>
 #include <epicsMessageQueue.h>
@@ -31,10 +34,13 @@ static const char *driverName="NDPluginCircularBuff";
 
 #define DEFAULT_TRIGGER_CALC "0"
 
+// Slots of the contiguous ring start on cache line boundaries
+#define RING_SLOT_ALIGN 64
+#define HUGE_PAGE_SIZE (2*1024*1024)
+
 asynStatus NDPluginCircularBuff::calculateTrigger(NDArray *pArray, int *trig)
 {
     NDAttribute *trigger;
-    char triggerString[256];
     double triggerValue;
     double calcResult;
     int status;
@@ -55,16 +61,15 @@ asynStatus NDPluginCircularBuff::calculateTrigger(NDArray *pArray, int *trig)
     triggerCalcArgs_[4] = currentImage;
     triggerCalcArgs_[5] = triggered;
 
-    getStringParam(NDCircBuffTriggerA, sizeof(triggerString), triggerString);
-    trigger = pArray->pAttributeList->find(triggerString);
+    // The attribute names are copied by writeOctet so they are not read from the parameter library for each frame
+    trigger = triggerAName_.empty() ? NULL : pArray->pAttributeList->find(triggerAName_.c_str());
     if (trigger != NULL) {
         status = trigger->getValue(NDAttrFloat64, &triggerValue);
         if (status == asynSuccess) {
             triggerCalcArgs_[0] = triggerValue;
         }
     }
-    getStringParam(NDCircBuffTriggerB, sizeof(triggerString), triggerString);
-    trigger = pArray->pAttributeList->find(triggerString);
+    trigger = triggerBName_.empty() ? NULL : pArray->pAttributeList->find(triggerBName_.c_str());
     if (trigger != NULL) {
         status = trigger->getValue(NDAttrFloat64, &triggerValue);
         if (status == asynSuccess) {
@@ -88,6 +93,172 @@ asynStatus NDPluginCircularBuff::calculateTrigger(NDArray *pArray, int *trig)
     return asynSuccess;
 }
     
+/** Returns true if two attribute lists have attributes with the same names */
+static bool sameAttributeNames(NDAttributeList *pList1, NDAttributeList *pList2)
+{
+    NDAttribute *pAttribute;
+
+    if (pList1->count() != pList2->count()) return false;
+    for (pAttribute = pList1->next(NULL); pAttribute; pAttribute = pList1->next(pAttribute)) {
+        if (!pList2->find(pAttribute->getName())) return false;
+    }
+    return true;
+}
+
+/** Allocates the contiguous ring, unless one with the same layout is already allocated.
+  * The ring is one NDArray from the plugin's own NDArrayPool, so that on a trigger each frame can be
+  * output as a view of its slot.  The whole buffer is written once here so that no page faults are
+  * taken while frames are buffered.
+  * \param[in] numSlots Number of frames the ring holds.
+  * \param[in] slotSize Maximum number of bytes of one frame.
+  * \param[in] hugePages Ask the kernel to back the ring with huge pages.
+  */
+asynStatus NDPluginCircularBuff::allocateRing(int numSlots, size_t slotSize, int hugePages)
+{
+    size_t ringBytes, allocBytes;
+    static const char *functionName = "allocateRing";
+
+    slotSize = (slotSize + RING_SLOT_ALIGN - 1) / RING_SLOT_ALIGN * RING_SLOT_ALIGN;
+    if (pRing_ && (numSlots == numSlots_) && (slotSize == slotSize_) && (hugePages == ringHugePages_))
+        return asynSuccess;
+    freeRing();
+    if ((numSlots <= 0) || (slotSize == 0)) return asynSuccess;
+
+    // The extra bytes let the first slot start on a cache line boundary
+    ringBytes = (size_t)numSlots * slotSize;
+    allocBytes = ringBytes + RING_SLOT_ALIGN;
+    pRingArray_ = this->pNDArrayPoolPvt_->alloc(1, &allocBytes, NDInt8, 0, NULL);
+    if (!pRingArray_) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s::%s cannot allocate %d slots of %lu bytes\n",
+            driverName, functionName, numSlots, (unsigned long)slotSize);
+        return asynError;
+    }
+    pRing_ = (char *)pRingArray_->pData;
+    pRing_ += (RING_SLOT_ALIGN - (size_t)pRing_ % RING_SLOT_ALIGN) % RING_SLOT_ALIGN;
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    if (hugePages) {
+        // Only the huge pages that lie entirely within the ring can be used
+        size_t first = ((size_t)pRing_ + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+        size_t last = ((size_t)pRing_ + ringBytes) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+        if (last > first) madvise((void *)first, last - first, MADV_HUGEPAGE);
+    }
+#endif
+    memset(pRing_, 0, ringBytes);
+
+    ringBytes_ = ringBytes;
+    slotSize_ = slotSize;
+    numSlots_ = numSlots;
+    ringHugePages_ = hugePages;
+    slots_ = new NDCircBuffSlot_t[numSlots];
+    for (int i=0; i<numSlots; i++) {
+        slots_[i].dataSize = 0;
+        slots_[i].pAttributeList = new NDAttributeList;
+    }
+    setDoubleParam(NDCircBuffRingMemory, ringBytes / 1048576.);
+    return asynSuccess;
+}
+
+/** Releases the contiguous ring; arrays that were output from it keep it until they are released */
+void NDPluginCircularBuff::freeRing()
+{
+    if (slots_) {
+        for (int i=0; i<numSlots_; i++) delete slots_[i].pAttributeList;
+        delete[] slots_;
+    }
+    if (pRingArray_) pRingArray_->release();
+    pRingArray_ = NULL;
+    pRing_ = NULL;
+    slots_ = NULL;
+    ringBytes_ = 0;
+    slotSize_ = 0;
+    numSlots_ = 0;
+    ringHead_ = 0;
+    ringCount_ = 0;
+    setDoubleParam(NDCircBuffRingMemory, 0.);
+}
+
+/** Copies a frame into the next slot of the contiguous ring, overwriting the oldest frame once the ring is full.
+  * \param[in] pArray The frame to store.
+  * \return asynError if the frame is larger than a slot; the frame is then dropped.
+  */
+asynStatus NDPluginCircularBuff::addToRing(NDArray *pArray)
+{
+    NDArrayInfo arrayInfo;
+    NDCircBuffSlot_t *pSlot;
+    size_t dataSize;
+
+    // Compressed frames are stored as their compressed bytes
+    pArray->getInfo(&arrayInfo);
+    dataSize = pArray->codec.name.empty() ? arrayInfo.totalBytes : pArray->compressedSize;
+    if (!pRing_ || (dataSize > slotSize_)) return asynError;
+
+    // Arrays output by the last trigger may still be using the ring, so leave it to them and start a new one
+    if (pRingArray_->getReferenceCount() > 1) {
+        int numSlots = numSlots_;
+        size_t slotSize = slotSize_;
+        freeRing();
+        if (allocateRing(numSlots, slotSize, ringHugePages_) != asynSuccess) return asynError;
+    }
+
+    pSlot = &slots_[ringHead_];
+    memcpy(pRing_ + ringHead_*slotSize_, pArray->pData, dataSize);
+    pSlot->ndims = pArray->ndims;
+    memcpy(pSlot->dims, pArray->dims, sizeof(pSlot->dims));
+    pSlot->dataType = pArray->dataType;
+    pSlot->uniqueId = pArray->uniqueId;
+    pSlot->timeStamp = pArray->timeStamp;
+    pSlot->epicsTS = pArray->epicsTS;
+    pSlot->codec = pArray->codec;
+    pSlot->dataSize = dataSize;
+    // Attributes are copied by name into the existing ones; only start again if the names have changed
+    if (!sameAttributeNames(pSlot->pAttributeList, pArray->pAttributeList))
+        pSlot->pAttributeList->clear();
+    pArray->pAttributeList->copy(pSlot->pAttributeList);
+
+    ringHead_ = (ringHead_ + 1) % numSlots_;
+    if (ringCount_ < numSlots_) ringCount_++;
+    return asynSuccess;
+}
+
+/** Outputs the frames in the contiguous ring, oldest first, and empties it.
+  * Each frame is output as a view of its slot, so no memory is allocated or copied; the ring is kept
+  * until all of the views are released.  Frames for which no view can be created are counted as dropped.
+  */
+void NDPluginCircularBuff::flushRing()
+{
+    NDDimension_t region;
+    size_t ringOffset = pRing_ - (char *)pRingArray_->pData;
+    int dropped;
+    int slot = (ringHead_ - ringCount_ + numSlots_) % numSlots_;
+
+    getIntegerParam(NDCircBuffDropped, &dropped);
+    for (int i=0; i<ringCount_; i++, slot = (slot + 1) % numSlots_) {
+        NDCircBuffSlot_t *pSlot = &slots_[slot];
+        pRingArray_->initDimension(&region, pSlot->dataSize);
+        region.offset = ringOffset + slot*slotSize_;
+        NDArray *pOut = this->pNDArrayPool->view(pRingArray_, &region);
+        if (!pOut) {
+            dropped++;
+            continue;
+        }
+        // The view is a byte array, so give it the layout of the frame
+        pOut->ndims = pSlot->ndims;
+        memcpy(pOut->dims, pSlot->dims, sizeof(pSlot->dims));
+        pOut->dataType = pSlot->dataType;
+        pOut->uniqueId = pSlot->uniqueId;
+        pOut->timeStamp = pSlot->timeStamp;
+        pOut->epicsTS = pSlot->epicsTS;
+        pOut->codec = pSlot->codec;
+        pOut->compressedSize = pSlot->codec.name.empty() ? 0 : pSlot->dataSize;
+        pSlot->pAttributeList->copy(pOut->pAttributeList);
+        doCallbacksGenericPointer(pOut, NDArrayData, 0);
+        pOut->release();
+    }
+    ringHead_ = 0;
+    ringCount_ = 0;
+    setIntegerParam(NDCircBuffDropped, dropped);
+}
 
 /** Callback function that is called by the NDArray driver with new NDArray data.
   * Stores the number of pre-trigger images prior to the trigger in a ring buffer.
@@ -102,8 +273,10 @@ void NDPluginCircularBuff::processCallbacks(NDArray *pArray)
      * structures don't need to be protected.
      */
     int scopeControl, preCount, postCount, currentImage, currentPostCount, softTrigger;
-    int presetTriggerCount, actualTriggerCount;
+    int presetTriggerCount, actualTriggerCount, dropped, slotSize;
+    size_t frameBytes;
     NDArray *pArrayCpy = NULL;
+    bool stored = false;
     NDArrayInfo arrayInfo;
     int triggered = 0;
 
@@ -141,8 +314,41 @@ void NDPluginCircularBuff::processCallbacks(NDArray *pArray)
         }
       }
 
-      // First copy the buffer into our buffer pool so we can release the resource on the driver
-      pArrayCpy = this->pNDArrayPool->copy(pArray, NULL, 1);
+      if (ringMode_ == NDCircBuffRingContiguous) {
+        // The frame data is copied into the ring, so pArray itself can be passed on after the trigger
+        if (!triggered){
+          // Without a slot size the slots are sized for the first frame of each capture
+          frameBytes = pArray->codec.name.empty() ? arrayInfo.totalBytes : pArray->compressedSize;
+          if (frameBytes < arrayInfo.totalBytes) frameBytes = arrayInfo.totalBytes;
+          getIntegerParam(NDCircBuffRingSlotSize, &slotSize);
+          if (!pRing_ || ((slotSize == 0) && (ringCount_ == 0) && (frameBytes > slotSize_))) {
+            allocateRing(preCount, frameBytes, ringHugePages_);
+          }
+          if ((preCount > 0) && (addToRing(pArray) != asynSuccess)) {
+            getIntegerParam(NDCircBuffDropped, &dropped);
+            setIntegerParam(NDCircBuffDropped, dropped+1);
+          }
+          setIntegerParam(NDCircBuffCurrentImage, ringCount_);
+          if (ringCount_ == preCount){
+            setStringParam(NDCircBuffStatus, "Buffer Wrapping");
+          }
+        } else {
+          setStringParam(NDCircBuffStatus, "Flushing");
+          if (previousTrigger_ == 0){
+            previousTrigger_ = 1;
+            if (pRing_) flushRing();
+            setIntegerParam(NDCircBuffCurrentImage, 0);
+          }
+          currentPostCount++;
+          setIntegerParam(NDCircBuffPostCount,  currentPostCount);
+          doCallbacksGenericPointer(pArray, NDArrayData, 0);
+        }
+        stored = true;
+      } else {
+        // First copy the buffer into our buffer pool so we can release the resource on the driver
+        pArrayCpy = this->pNDArrayPool->copy(pArray, NULL, 1);
+        stored = (pArrayCpy != NULL);
+      }
 
       if (pArrayCpy){
 
@@ -186,7 +392,9 @@ void NDPluginCircularBuff::processCallbacks(NDArray *pArray)
             pArrayCpy->release();
           }
         }
+      }
 
+      if (stored){
         // Stop recording once we have reached the post-trigger count, wait for a restart
         if (currentPostCount >= postCount){
           actualTriggerCount++;
@@ -226,21 +434,43 @@ asynStatus NDPluginCircularBuff::writeInt32(asynUser *pasynUser, epicsInt32 valu
 {
     int function = pasynUser->reason;
     asynStatus status = asynSuccess;
-    int preCount;
+    int preCount, slotSize, hugePages;
     static const char *functionName = "writeInt32";
 
     if (function == NDCircBuffControl){
         if (value == 1){
           // If the control is turned on then create our new ring buffer
           getIntegerParam(NDCircBuffPreTrigger,  &preCount);
+          getIntegerParam(NDCircBuffRingMode,    &ringMode_);
           if (preBuffer_){
             delete preBuffer_;
+            preBuffer_ = NULL;
           }
-          preBuffer_ = new NDArrayRing(preCount);
           if (pOldArray_){
             pOldArray_->release();
           }
           pOldArray_ = NULL;
+          if (ringMode_ == NDCircBuffRingContiguous) {
+            getIntegerParam(NDCircBuffRingSlotSize,  &slotSize);
+            getIntegerParam(NDCircBuffRingHugePages, &hugePages);
+            if (slotSize > 0) {
+              if (allocateRing(preCount, slotSize, hugePages) != asynSuccess) {
+                setStringParam(NDCircBuffStatus, "Ring allocation failed");
+                callParamCallbacks();
+                return asynError;
+              }
+            } else if ((preCount != numSlots_) || (hugePages != ringHugePages_)) {
+              // Without a slot size an existing ring of the right length is reused,
+              // otherwise the ring is allocated for the first frame
+              freeRing();
+            }
+            ringHugePages_ = hugePages;
+            ringHead_ = 0;
+            ringCount_ = 0;
+          } else {
+            freeRing();
+            preBuffer_ = new NDArrayRing(preCount);
+          }
  
           previousTrigger_ = 0;
 
@@ -249,6 +479,8 @@ asynStatus NDPluginCircularBuff::writeInt32(asynUser *pasynUser, epicsInt32 valu
           setIntegerParam(NDCircBuffTriggered, 0);
           setIntegerParam(NDCircBuffPostCount, 0);
           setIntegerParam(NDCircBuffActualTriggerCount, 0);
+          setIntegerParam(NDCircBuffCurrentImage, 0);
+          setIntegerParam(NDCircBuffDropped, 0);
           setStringParam(NDCircBuffStatus, "Buffer filling");
         } else {
           // Control is turned off, before we have finished
@@ -270,7 +502,8 @@ asynStatus NDPluginCircularBuff::writeInt32(asynUser *pasynUser, epicsInt32 valu
         setIntegerParam(NDCircBuffTriggered, 1);
 
     }  else if (function == NDCircBuffPreTrigger){
-        // Check the value of pretrigger does not exceed max buffers
+        // Check the value of pretrigger does not exceed max buffers.  The contiguous ring outputs
+        // each frame in its own NDArray too, although that array does not have a buffer.
         if (value > (maxBuffers_ - 1)){
           setStringParam(NDCircBuffStatus, "Pre-count too high");
         } else {
@@ -321,7 +554,13 @@ asynStatus NDPluginCircularBuff::writeOctet(asynUser *pasynUser, const char *val
   status = (asynStatus)setStringParam(addr, function, (char *)value);
   if (status != asynSuccess) return(status);
 
-  if (function == NDCircBuffTriggerCalc){
+  if (function == NDCircBuffTriggerA){
+    triggerAName_ = value;
+  }
+  else if (function == NDCircBuffTriggerB){
+    triggerBName_ = value;
+  }
+  else if (function == NDCircBuffTriggerCalc){
     if (nChars > sizeof(triggerCalcInfix_)) nChars = sizeof(triggerCalcInfix_);
     // If the input string is empty then use a value of "0", otherwise there is an error
     if ((value == 0) || (strlen(value) == 0)) {
@@ -387,7 +626,9 @@ NDPluginCircularBuff::NDPluginCircularBuff(const char *portName, int queueSize,
                    NDArrayPort, NDArrayAddr, 1, maxBuffers, maxMemory,
                    asynInt32ArrayMask | asynFloat64ArrayMask | asynGenericPointerMask,
                    asynInt32ArrayMask | asynFloat64ArrayMask | asynGenericPointerMask,
-                   0, 1, priority, stackSize, 1), pOldArray_(NULL)
+                   0, 1, priority, stackSize, 1), pOldArray_(NULL),
+      ringMode_(NDCircBuffRingArrays), pRingArray_(NULL), pRing_(NULL), ringBytes_(0), slotSize_(0), numSlots_(0),
+      ringHugePages_(0), slots_(NULL), ringHead_(0), ringCount_(0)
 {
     //const char *functionName = "NDPluginCircularBuff";
     preBuffer_ = NULL;
@@ -411,6 +652,14 @@ NDPluginCircularBuff::NDPluginCircularBuff(const char *portName, int queueSize,
     createParam(NDCircBuffPostCountString,          asynParamInt32,      &NDCircBuffPostCount);
     createParam(NDCircBuffSoftTriggerString,        asynParamInt32,      &NDCircBuffSoftTrigger);
     createParam(NDCircBuffTriggeredString,          asynParamInt32,      &NDCircBuffTriggered);
+    createParam(NDCircBuffRingModeString,           asynParamInt32,      &NDCircBuffRingMode);
+    createParam(NDCircBuffRingSlotSizeString,       asynParamInt32,      &NDCircBuffRingSlotSize);
+    createParam(NDCircBuffRingHugePagesString,      asynParamInt32,      &NDCircBuffRingHugePages);
+    createParam(NDCircBuffRingMemoryString,         asynParamFloat64,    &NDCircBuffRingMemory);
+    createParam(NDCircBuffDroppedString,            asynParamInt32,      &NDCircBuffDropped);
+
+    // Frames are buffered and passed on unchanged, so compressed arrays are accepted
+    this->compressionAware_ = true;
 
     // Set the plugin type string
     setStringParam(NDPluginDriverPluginType, "NDPluginCircularBuff");
@@ -432,6 +681,13 @@ NDPluginCircularBuff::NDPluginCircularBuff(const char *portName, int queueSize,
     // Init the preset trigger count to 1
     setIntegerParam(NDCircBuffPresetTriggerCount, 1);
     setIntegerParam(NDCircBuffActualTriggerCount, 0);
+
+    // Keep copies of the NDArrays by default
+    setIntegerParam(NDCircBuffRingMode, NDCircBuffRingArrays);
+    setIntegerParam(NDCircBuffRingSlotSize, 0);
+    setIntegerParam(NDCircBuffRingHugePages, 0);
+    setDoubleParam(NDCircBuffRingMemory, 0.);
+    setIntegerParam(NDCircBuffDropped, 0);
     
     // Enable ArrayCallbacks.  
     // This plugin currently ignores this setting and always does callbacks, so make the setting reflect the behavior
@@ -441,6 +697,11 @@ NDPluginCircularBuff::NDPluginCircularBuff(const char *portName, int queueSize,
     connectToArrayPort();
 }
 
+NDPluginCircularBuff::~NDPluginCircularBuff()
+{
+    freeRing();
+}
+
 /** Configuration command */
 extern "C" int NDCircularBuffConfigure(const char *portName, int queueSize, int blockingCallbacks,
                                 const char *NDArrayPort, int NDArrayAddr,
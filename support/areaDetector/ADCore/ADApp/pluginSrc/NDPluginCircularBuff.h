@@ -1,6 +1,8 @@
 #ifndef NDPluginCircularBuff_H
 #define NDPluginCircularBuff_H
 
+#include <string>
+
 #include <epicsTypes.h>
 #include <postfix.h>
 
@@ -24,10 +26,39 @@
 #define NDCircBuffPostCountString           "CIRC_BUFF_POST_COUNT"            /* (asynInt32,        r/o) Number of the current post count image */
 #define NDCircBuffSoftTriggerString         "CIRC_BUFF_SOFT_TRIGGER"          /* (asynInt32,        r/w) Force a soft trigger */
 #define NDCircBuffTriggeredString           "CIRC_BUFF_TRIGGERED"             /* (asynInt32,        r/o) Have we had a trigger event */
+#define NDCircBuffRingModeString            "CIRC_BUFF_RING_MODE"             /* (asynInt32,        r/w) NDCircBuffRingMode_t */
+#define NDCircBuffRingSlotSizeString        "CIRC_BUFF_RING_SLOT_SIZE"        /* (asynInt32,        r/w) Bytes per slot of the contiguous ring, 0=size of first frame */
+#define NDCircBuffRingHugePagesString       "CIRC_BUFF_RING_HUGE_PAGES"       /* (asynInt32,        r/w) Back the contiguous ring with huge pages */
+#define NDCircBuffRingMemoryString          "CIRC_BUFF_RING_MEMORY"           /* (asynFloat64,      r/o) Size of the contiguous ring in MB */
+#define NDCircBuffDroppedString             "CIRC_BUFF_DROPPED"               /* (asynInt32,        r/o) Frames that could not be buffered or output */
+
+/** How the pre-trigger frames are held */
+typedef enum {
+    NDCircBuffRingArrays,       /**< Copies of the NDArrays are kept in an NDArrayRing */
+    NDCircBuffRingContiguous    /**< The frame data is copied into fixed size slots of one preallocated buffer */
+} NDCircBuffRingMode_t;
+
+/** Metadata of a frame held in a slot of the contiguous ring */
+typedef struct {
+    int ndims;
+    NDDimension_t dims[ND_ARRAY_MAX_DIMS];
+    NDDataType_t dataType;
+    int uniqueId;
+    double timeStamp;
+    epicsTimeStamp epicsTS;
+    NDCodec_t codec;
+    size_t dataSize;
+    NDAttributeList *pAttributeList;
+} NDCircBuffSlot_t;
 
 
 /** Performs a scope like capture.  Records a quantity
   * of pre-trigger and post-trigger images
+  *
+  * With RingMode=Contiguous the pre-trigger frames are not kept as NDArrays from the pool.
+  * Instead the data of each frame is copied into a slot of one buffer that is allocated,
+  * and touched, when capture starts, so buffering frames allocates no memory.  On a trigger
+  * each slot is output as a view of the buffer, so flushing allocates and copies no data either.
   */
 class epicsShareClass NDPluginCircularBuff : public NDPluginDriver {
 public:
@@ -35,6 +66,7 @@ public:
                  const char *NDArrayPort, int NDArrayAddr,
                  int maxBuffers, size_t maxMemory,
                  int priority, int stackSize);
+    ~NDPluginCircularBuff();
     /* These methods override the virtual methods in the base class */
     void processCallbacks(NDArray *pArray);
     asynStatus writeInt32(asynUser *pasynUser, epicsInt32 value);
@@ -62,10 +94,19 @@ protected:
     int NDCircBuffPostCount;
     int NDCircBuffSoftTrigger;
     int NDCircBuffTriggered;
+    int NDCircBuffRingMode;
+    int NDCircBuffRingSlotSize;
+    int NDCircBuffRingHugePages;
+    int NDCircBuffRingMemory;
+    int NDCircBuffDropped;
 
 private:
 
     asynStatus calculateTrigger(NDArray *pArray, int *trig);
+    asynStatus allocateRing(int numSlots, size_t slotSize, int hugePages);
+    void freeRing();
+    asynStatus addToRing(NDArray *pArray);
+    void flushRing();
     NDArrayRing *preBuffer_;
     NDArray *pOldArray_;
     int previousTrigger_;
@@ -73,6 +114,19 @@ private:
     char triggerCalcInfix_[MAX_INFIX_SIZE];
     char triggerCalcPostfix_[MAX_POSTFIX_SIZE];
     double triggerCalcArgs_[CALCPERFORM_NARGS];
+    std::string triggerAName_;
+    std::string triggerBName_;
+    /* Contiguous ring */
+    int ringMode_;
+    NDArray *pRingArray_;
+    char *pRing_;
+    size_t ringBytes_;
+    size_t slotSize_;
+    int numSlots_;
+    int ringHugePages_;
+    NDCircBuffSlot_t *slots_;
+    int ringHead_;
+    int ringCount_;
 };
     
 #endif
@@ -0,0 +1,371 @@
+/*
+ * NDPluginCodec.cpp
+ *
+ * Plugin to compress and decompress NDArrays with zlib or blosc
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include <epicsTypes.h>
+#include <epicsStdio.h>
+#include <epicsThread.h>
+#include <epicsTime.h>
+#include <iocsh.h>
+
+#include <asynDriver.h>
+
+#include <epicsExport.h>
+#include "NDPluginDriver.h"
+#include "NDPluginCodec.h"
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_BLOSC
+#include <blosc.h>
+#endif
+
+#define MAX_ERROR_MESSAGE 256
+
+static const char *driverName="NDPluginCodec";
+
+/** Compress one array into a new array from the pool.
+  * Called with the lock held; the lock is released while the data are compressed.
+  * \param[in] pArray The uncompressed input array.
+  * \param[in] compressor The NDCodecCompressor_t to use.
+  * \param[out] errorMessage Set if NULL is returned.
+  * \return The compressed array, or NULL on error. */
+NDArray *NDPluginCodec::compressArray(NDArray *pArray, int compressor, char *errorMessage)
+{
+    NDArrayInfo_t info;
+    NDArray *pOut;
+    size_t dims[ND_ARRAY_MAX_DIMS];
+    size_t maxSize = 0;
+    size_t compressedSize = 0;
+    int zlibLevel, bloscCompressor, bloscLevel, bloscShuffle, bloscThreads;
+    int i;
+
+    getIntegerParam(NDCodecZlibLevel,       &zlibLevel);
+    getIntegerParam(NDCodecBloscCompressor, &bloscCompressor);
+    getIntegerParam(NDCodecBloscCLevel,     &bloscLevel);
+    getIntegerParam(NDCodecBloscShuffle,    &bloscShuffle);
+    getIntegerParam(NDCodecBloscNumThreads, &bloscThreads);
+    if (bloscThreads < 1) bloscThreads = 1;
+
+    pArray->getInfo(&info);
+    switch (compressor) {
+        case NDCodecZlib:
+#ifdef HAVE_ZLIB
+            maxSize = compressBound((uLong)info.totalBytes);
+            break;
+#else
+            epicsSnprintf(errorMessage, MAX_ERROR_MESSAGE, "built without zlib");
+            return NULL;
+#endif
+        case NDCodecBlosc:
+#ifdef HAVE_BLOSC
+            if (info.totalBytes > BLOSC_MAX_BUFFERSIZE) {
+                epicsSnprintf(errorMessage, MAX_ERROR_MESSAGE, "array is too large for blosc");
+                return NULL;
+            }
+            maxSize = info.totalBytes + BLOSC_MAX_OVERHEAD;
+            break;
+#else
+            epicsSnprintf(errorMessage, MAX_ERROR_MESSAGE, "built without blosc");
+            return NULL;
+#endif
+        default:
+            epicsSnprintf(errorMessage, MAX_ERROR_MESSAGE, "unknown compressor %d", compressor);
+            return NULL;
+    }
+
+    for (i=0; i<pArray->ndims; i++) dims[i] = pArray->dims[i].size;
+    pOut = this->pNDArrayPool->alloc(pArray->ndims, dims, pArray->dataType, maxSize, NULL);
+    if (!pOut) {
+        epicsSnprintf(errorMessage, MAX_ERROR_MESSAGE, "cannot allocate output array");
+        return NULL;
+    }
+    this->pNDArrayPool->copy(pArray, pOut, 0);
+
+    /* pArray is reserved by the caller and pOut is ours, so neither needs the lock */
+    this->unlock();
+    switch (compressor) {
+#ifdef HAVE_ZLIB
+        case NDCodecZlib: {
+            uLongf destLen = (uLongf)maxSize;
+            pOut->codec.name = "zlib";
+            pOut->codec.level = zlibLevel;
+            if (compress2((Bytef *)pOut->pData, &destLen, (const Bytef *)pArray->pData,
+                          (uLong)info.totalBytes, zlibLevel) == Z_OK) {
+                compressedSize = destLen;
+            }
+            break;
+        }
+#endif
+#ifdef HAVE_BLOSC
+        case NDCodecBlosc: {
+            const char *compName = NULL;
+            pOut->codec.name = "blosc";
+            pOut->codec.level = bloscLevel;
+            pOut->codec.shuffle = bloscShuffle;
+            pOut->codec.compressor = bloscCompressor;
+            /* The compressor code is checked against those built into this blosc library */
+            if (blosc_compcode_to_compname(bloscCompressor, (char **)&compName) < 0) break;
+            int status = blosc_compress_ctx(bloscLevel, bloscShuffle, info.bytesPerElement,
+                                            info.totalBytes, pArray->pData, pOut->pData, maxSize,
+                                            compName, 0, bloscThreads);
+            if (status > 0) compressedSize = status;
+            break;
+        }
+#endif
+        default:
+            break;
+    }
+    this->lock();
+
+    if (compressedSize == 0) {
+        epicsSnprintf(errorMessage, MAX_ERROR_MESSAGE, "%s compression failed", pOut->codec.name.c_str());
+        pOut->release();
+        return NULL;
+    }
+    pOut->compressedSize = compressedSize;
+    return pOut;
+}
+
+/** Decompress one array into a new array from the pool.
+  * Called with the lock held; the lock is released while the data are decompressed.
+  * \param[in] pArray The compressed input array.
+  * \param[out] errorMessage Set if NULL is returned.
+  * \return The uncompressed array, or NULL on error. */
+NDArray *NDPluginCodec::decompressArray(NDArray *pArray, char *errorMessage)
+{
+    NDArrayInfo_t info;
+    NDArray *pOut;
+    size_t dims[ND_ARRAY_MAX_DIMS];
+    bool success = false;
+    int bloscThreads;
+    int i;
+
+    getIntegerParam(NDCodecBloscNumThreads, &bloscThreads);
+    if (bloscThreads < 1) bloscThreads = 1;
+
+    if ((pArray->codec.name != "zlib") && (pArray->codec.name != "blosc")) {
+        epicsSnprintf(errorMessage, MAX_ERROR_MESSAGE, "unknown codec %s", pArray->codec.name.c_str());
+        return NULL;
+    }
+    pArray->getInfo(&info);
+    for (i=0; i<pArray->ndims; i++) dims[i] = pArray->dims[i].size;
+    pOut = this->pNDArrayPool->alloc(pArray->ndims, dims, pArray->dataType, 0, NULL);
+    if (!pOut) {
+        epicsSnprintf(errorMessage, MAX_ERROR_MESSAGE, "cannot allocate output array");
+        return NULL;
+    }
+    this->pNDArrayPool->copy(pArray, pOut, 0);
+    pOut->codec.name.clear();
+    pOut->compressedSize = 0;
+
+    this->unlock();
+#ifdef HAVE_ZLIB
+    if (pArray->codec.name == "zlib") {
+        uLongf destLen = (uLongf)info.totalBytes;
+        success = (uncompress((Bytef *)pOut->pData, &destLen, (const Bytef *)pArray->pData,
+                              (uLong)pArray->compressedSize) == Z_OK) &&
+                  (destLen == info.totalBytes);
+    }
+#endif
+#ifdef HAVE_BLOSC
+    if (pArray->codec.name == "blosc") {
+        int status = blosc_decompress_ctx(pArray->pData, pOut->pData, info.totalBytes, bloscThreads);
+        success = (status == (int)info.totalBytes);
+    }
+#endif
+    this->lock();
+
+    if (!success) {
+        epicsSnprintf(errorMessage, MAX_ERROR_MESSAGE, "%s decompression failed", pArray->codec.name.c_str());
+        pOut->release();
+        return NULL;
+    }
+    return pOut;
+}
+
+/** Callback function that is called by the NDArray driver with new NDArray data.
+  * Compresses or decompresses the array and does callbacks with the result.
+  * \param[in] pArray  The NDArray from the callback.
+  */
+void NDPluginCodec::processCallbacks(NDArray *pArray)
+{
+    NDArrayInfo_t info;
+    NDArray *pOut = NULL;
+    int mode, compressor;
+    char errorMessage[MAX_ERROR_MESSAGE] = "";
+    NDCodecStatus_t codecStatus = NDCodecStatusSuccess;
+    static const char* functionName = "processCallbacks";
+
+    /* Call the base class method */
+    NDPluginDriver::beginProcessCallbacks(pArray);
+
+    getIntegerParam(NDCodecMode, &mode);
+    getIntegerParam(NDCodecCompressor, &compressor);
+
+    if (mode == NDCodecCompress) {
+        if (!pArray->codec.name.empty()) {
+            epicsSnprintf(errorMessage, sizeof(errorMessage), "array is already compressed with %s",
+                          pArray->codec.name.c_str());
+            codecStatus = NDCodecStatusWarning;
+        } else if (compressor != NDCodecNone) {
+            pOut = this->compressArray(pArray, compressor, errorMessage);
+            if (!pOut) codecStatus = NDCodecStatusError;
+        }
+    } else {
+        if (!pArray->codec.name.empty()) {
+            pOut = this->decompressArray(pArray, errorMessage);
+            if (!pOut) codecStatus = NDCodecStatusError;
+        }
+    }
+
+    if (codecStatus != NDCodecStatusSuccess) {
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                  "%s::%s uniqueId=%d: %s\n",
+                  driverName, functionName, pArray->uniqueId, errorMessage);
+    }
+    setIntegerParam(NDCodecCodecStatus, codecStatus);
+    setStringParam(NDCodecCodecError, errorMessage);
+
+    if (pOut) {
+        pOut->getInfo(&info);
+        if (!pOut->codec.name.empty()) {
+            setDoubleParam(NDCodecCompFactor, (double)info.totalBytes / pOut->compressedSize);
+        } else {
+            setDoubleParam(NDCodecCompFactor, (double)info.totalBytes / pArray->compressedSize);
+        }
+        NDPluginDriver::endProcessCallbacks(pOut, false, true);
+    } else if (codecStatus != NDCodecStatusError) {
+        setDoubleParam(NDCodecCompFactor, 1.0);
+        NDPluginDriver::endProcessCallbacks(pArray, true, true);
+    }
+
+    callParamCallbacks();
+}
+
+
+/** Constructor for NDPluginCodec; most parameters are simply passed to NDPluginDriver::NDPluginDriver.
+  * After calling the base class constructor this method sets reasonable default values for all of the
+  * parameters.
+  * \param[in] portName The name of the asyn port driver to be created.
+  * \param[in] queueSize The number of NDArrays that the input queue for this plugin can hold when
+  *            NDPluginDriverBlockingCallbacks=0.  Larger queues can decrease the number of dropped arrays,
+  *            at the expense of more NDArray buffers being allocated from the underlying driver's NDArrayPool.
+  * \param[in] blockingCallbacks Initial setting for the NDPluginDriverBlockingCallbacks flag.
+  *            0=callbacks are queued and executed by the callback thread; 1 callbacks execute in the thread
+  *            of the driver doing the callbacks.
+  * \param[in] NDArrayPort Name of asyn port driver for initial source of NDArray callbacks.
+  * \param[in] NDArrayAddr asyn port driver address for initial source of NDArray callbacks.
+  * \param[in] maxBuffers The maximum number of NDArray buffers that the NDArrayPool for this driver is
+  *            allowed to allocate. Set this to 0 to allow an unlimited number of buffers.
+  * \param[in] maxMemory The maximum amount of memory that the NDArrayPool for this driver is
+  *            allowed to allocate. Set this to 0 to allow an unlimited amount of memory.
+  * \param[in] priority The thread priority for the asyn port driver thread if ASYN_CANBLOCK is set in asynFlags.
+  * \param[in] stackSize The stack size for the asyn port driver thread if ASYN_CANBLOCK is set in asynFlags.
+  * \param[in] maxThreads The maximum number of threads this driver is allowed to use. If 0 then 1 will be used.
+  */
+NDPluginCodec::NDPluginCodec(const char *portName, int queueSize, int blockingCallbacks,
+                             const char *NDArrayPort, int NDArrayAddr,
+                             int maxBuffers, size_t maxMemory,
+                             int priority, int stackSize, int maxThreads)
+    /* Invoke the base class constructor */
+    : NDPluginDriver(portName, queueSize, blockingCallbacks,
+                   NDArrayPort, NDArrayAddr, 1, maxBuffers, maxMemory,
+                   asynGenericPointerMask,
+                   asynGenericPointerMask,
+                   0, 1, priority, stackSize, maxThreads)  /* Not ASYN_CANBLOCK or ASYN_MULTIDEVICE, do autoConnect */
+{
+    //static const char *functionName = "NDPluginCodec";
+
+    createParam(NDCodecModeString,            asynParamInt32,   &NDCodecMode);
+    createParam(NDCodecCompressorString,      asynParamInt32,   &NDCodecCompressor);
+    createParam(NDCodecCompFactorString,      asynParamFloat64, &NDCodecCompFactor);
+    createParam(NDCodecCodecStatusString,     asynParamInt32,   &NDCodecCodecStatus);
+    createParam(NDCodecCodecErrorString,      asynParamOctet,   &NDCodecCodecError);
+    createParam(NDCodecZlibLevelString,       asynParamInt32,   &NDCodecZlibLevel);
+    createParam(NDCodecBloscCompressorString, asynParamInt32,   &NDCodecBloscCompressor);
+    createParam(NDCodecBloscCLevelString,     asynParamInt32,   &NDCodecBloscCLevel);
+    createParam(NDCodecBloscShuffleString,    asynParamInt32,   &NDCodecBloscShuffle);
+    createParam(NDCodecBloscNumThreadsString, asynParamInt32,   &NDCodecBloscNumThreads);
+
+    /* Set the plugin type string */
+    setStringParam(NDPluginDriverPluginType, "NDPluginCodec");
+
+    setIntegerParam(NDCodecMode, NDCodecCompress);
+    setIntegerParam(NDCodecCompressor, NDCodecNone);
+    setDoubleParam(NDCodecCompFactor, 1.0);
+    setIntegerParam(NDCodecCodecStatus, NDCodecStatusSuccess);
+    setStringParam(NDCodecCodecError, "");
+    setIntegerParam(NDCodecZlibLevel, 6);
+    setIntegerParam(NDCodecBloscCompressor, NDCodecBloscLZ4);
+    setIntegerParam(NDCodecBloscCLevel, 5);
+    setIntegerParam(NDCodecBloscShuffle, NDCodecBloscBitShuffle);
+    setIntegerParam(NDCodecBloscNumThreads, 1);
+
+    /* This plugin handles compressed arrays itself */
+    this->compressionAware_ = true;
+
+    // Enable ArrayCallbacks.
+    // This plugin currently ignores this setting and always does callbacks, so make the setting reflect the behavior
+    setIntegerParam(NDArrayCallbacks, 1);
+
+    /* Try to connect to the array port */
+    connectToArrayPort();
+}
+
+extern "C" int NDCodecConfigure(const char *portName, int queueSize, int blockingCallbacks,
+                                const char *NDArrayPort, int NDArrayAddr,
+                                int maxBuffers, size_t maxMemory,
+                                int priority, int stackSize, int maxThreads)
+{
+    NDPluginCodec *pPlugin = new NDPluginCodec(portName, queueSize, blockingCallbacks, NDArrayPort, NDArrayAddr,
+                                               maxBuffers, maxMemory, priority, stackSize, maxThreads);
+    return pPlugin->start();
+}
+
+/** EPICS iocsh shell commands */
+static const iocshArg initArg0 = { "portName",iocshArgString};
+static const iocshArg initArg1 = { "frame queue size",iocshArgInt};
+static const iocshArg initArg2 = { "blocking callbacks",iocshArgInt};
+static const iocshArg initArg3 = { "NDArrayPort",iocshArgString};
+static const iocshArg initArg4 = { "NDArrayAddr",iocshArgInt};
+static const iocshArg initArg5 = { "maxBuffers",iocshArgInt};
+static const iocshArg initArg6 = { "maxMemory",iocshArgInt};
+static const iocshArg initArg7 = { "priority",iocshArgInt};
+static const iocshArg initArg8 = { "stackSize",iocshArgInt};
+static const iocshArg initArg9 = { "maxThreads",iocshArgInt};
+static const iocshArg * const initArgs[] = {&initArg0,
+                                            &initArg1,
+                                            &initArg2,
+                                            &initArg3,
+                                            &initArg4,
+                                            &initArg5,
+                                            &initArg6,
+                                            &initArg7,
+                                            &initArg8,
+                                            &initArg9};
+static const iocshFuncDef initFuncDef = {"NDCodecConfigure",10,initArgs};
+static void initCallFunc(const iocshArgBuf *args)
+{
+    NDCodecConfigure(args[0].sval, args[1].ival, args[2].ival,
+                     args[3].sval, args[4].ival, args[5].ival,
+                     args[6].ival, args[7].ival, args[8].ival,
+                     args[9].ival);
+}
+
+extern "C" void NDCodecRegister(void)
+{
+    iocshRegister(&initFuncDef,initCallFunc);
+}
+
+extern "C" {
+epicsExportRegistrar(NDCodecRegister);
+}
@@ -0,0 +1,93 @@
+#ifndef NDPluginCodec_H
+#define NDPluginCodec_H
+
+#include <epicsTypes.h>
+
+#include "NDPluginDriver.h"
+
+#define NDCodecModeString             "MODE"              /* (asynInt32,   r/w) NDCodecMode_t */
+#define NDCodecCompressorString       "COMPRESSOR"        /* (asynInt32,   r/w) NDCodecCompressor_t */
+#define NDCodecCompFactorString       "COMP_FACTOR"       /* (asynFloat64, r/o) Uncompressed size / compressed size */
+#define NDCodecCodecStatusString      "CODEC_STATUS"      /* (asynInt32,   r/o) NDCodecStatus_t */
+#define NDCodecCodecErrorString       "CODEC_ERROR"       /* (asynOctet,   r/o) Error message of the last array */
+#define NDCodecZlibLevelString        "ZLIB_LEVEL"        /* (asynInt32,   r/w) zlib compression level, 0-9 */
+#define NDCodecBloscCompressorString  "BLOSC_COMPRESSOR"  /* (asynInt32,   r/w) NDCodecBloscComp_t */
+#define NDCodecBloscCLevelString      "BLOSC_CLEVEL"      /* (asynInt32,   r/w) Blosc compression level, 0-9 */
+#define NDCodecBloscShuffleString     "BLOSC_SHUFFLE"     /* (asynInt32,   r/w) NDCodecBloscShuffle_t */
+#define NDCodecBloscNumThreadsString  "BLOSC_NUMTHREADS"  /* (asynInt32,   r/w) Blosc threads per array */
+
+/** Direction of the codec */
+typedef enum {
+    NDCodecCompress,
+    NDCodecDecompress
+} NDCodecMode_t;
+
+/** Compressors; the value of NDArray::codec.name is given for each */
+typedef enum {
+    NDCodecNone,      /**< The arrays are passed on unchanged */
+    NDCodecZlib,      /**< "zlib", a zlib stream as written by the HDF5 deflate filter */
+    NDCodecBlosc      /**< "blosc", a blosc buffer as written by the HDF5 blosc filter */
+} NDCodecCompressor_t;
+
+/** Compressors used inside blosc; these values are the blosc compressor codes */
+typedef enum {
+    NDCodecBloscLZ,
+    NDCodecBloscLZ4,
+    NDCodecBloscLZ4HC,
+    NDCodecBloscSnappy,
+    NDCodecBloscZlib,
+    NDCodecBloscZstd
+} NDCodecBloscComp_t;
+
+/** Blosc shuffle filters */
+typedef enum {
+    NDCodecBloscNoShuffle,
+    NDCodecBloscByteShuffle,
+    NDCodecBloscBitShuffle
+} NDCodecBloscShuffle_t;
+
+typedef enum {
+    NDCodecStatusSuccess,
+    NDCodecStatusWarning,
+    NDCodecStatusError
+} NDCodecStatus_t;
+
+/** Compress or decompress NDArrays.
+  * In Compress mode each array is compressed with zlib or blosc into a new array with the same dimensions
+  * and data type, and NDArray::codec and NDArray::compressedSize describe the compressed data.
+  * In Decompress mode arrays compressed by this plugin are restored.  Arrays that need no work
+  * (uncompressed arrays in Decompress mode, compressed arrays in Compress mode) are passed on unchanged.
+  * Plugins that do not set compressionAware_ drop compressed arrays, so NDPluginCodec is normally
+  * followed by a file plugin that can store the compressed data directly, such as NDFileHDF5
+  * with DirectChunkWrite.
+  * Blosc can use several threads for each array (BLOSC_NUMTHREADS); several arrays are compressed
+  * at once when NumThreads of the plugin is more than 1. */
+class epicsShareClass NDPluginCodec : public NDPluginDriver {
+public:
+    NDPluginCodec(const char *portName, int queueSize, int blockingCallbacks,
+                  const char *NDArrayPort, int NDArrayAddr,
+                  int maxBuffers, size_t maxMemory,
+                  int priority, int stackSize, int maxThreads);
+
+    /* These methods override the virtual methods in the base class */
+    void processCallbacks(NDArray *pArray);
+
+protected:
+    int NDCodecMode;
+    #define FIRST_NDCODEC_PARAM NDCodecMode
+    int NDCodecCompressor;
+    int NDCodecCompFactor;
+    int NDCodecCodecStatus;
+    int NDCodecCodecError;
+    int NDCodecZlibLevel;
+    int NDCodecBloscCompressor;
+    int NDCodecBloscCLevel;
+    int NDCodecBloscShuffle;
+    int NDCodecBloscNumThreads;
+
+private:
+    NDArray *compressArray(NDArray *pArray, int compressor, char *errorMessage);
+    NDArray *decompressArray(NDArray *pArray, char *errorMessage);
+};
+
+#endif
@@ -13,6 +13,8 @@
 #include <stdio.h>
 #include <math.h>
 
+#include <limits>
+
 #include <epicsTypes.h>
 #include <epicsMessageQueue.h>
 #include <epicsThread.h>
@@ -25,481 +27,653 @@
 #include <epicsExport.h>
 #include "NDPluginDriver.h"
 #include "colorMaps.h"
-#ifdef HAVE_PVAPI
-  #include "PvApi.h"
-#endif
 #include "NDPluginColorConvert.h"
 
 static const char *driverName="NDPluginColorConvert";
 
-/* This function returns 1 if it did a conversion, 0 if it did not */
+/** Where each color of an image is in an array, in elements.
+  * Mono and Bayer images have the same offset for all three colors. */
+typedef struct {
+    size_t offset[3];   /**< First element of red, green and blue */
+    size_t rowStride;   /**< Elements from one row of a color to the next */
+    size_t step;        /**< Elements from one pixel of a color to the next */
+} colorLayout_t;
+
+/** The row conversions that convertRows() can do */
+typedef enum {
+    kernelNone,
+    kernelRGB,              /* Mono or RGB to RGB, with a false color map for mono */
+    kernelMono,             /* RGB to mono */
+    kernelBayerNearest,     /* Bayer to RGB, NDColorConvertBayerNearest */
+    kernelBayerBilinear,    /* Bayer to RGB, NDColorConvertBayerBilinear */
+    kernelBayerGreen,       /* First pass of NDColorConvertBayerEdgeAware, green */
+    kernelBayerRedBlue,     /* Second pass of NDColorConvertBayerEdgeAware, red and blue */
+    kernelYUV               /* YUV to mono or RGB */
+} colorKernel_t;
+
+/** Everything needed to convert the rows of one array, shared by the threads in runTiles() */
+typedef struct {
+    colorKernel_t kernel;
+    const void *pIn;
+    void *pOut;
+    size_t nx, ny;                      /* Size of the image in pixels */
+    colorLayout_t in, out;
+    const unsigned char *colorMap[3];   /* False color maps for red, green and blue */
+    const int *bayerColors;             /* Row of bayerColors for the Bayer pattern */
+    int yuvMode;                        /* Input color mode for kernelYUV */
+} colorConvertPvt_t;
+
+/* Color of each pixel of a 2x2 Bayer cell, indexed by NDBayerPattern_t and then by 2*(y&1) + (x&1).
+ * 0 is red, 1 green and 2 blue. */
+static const int bayerColors[4][4] = {
+    {0, 1, 1, 2},   /* NDBayerRGGB */
+    {1, 2, 0, 1},   /* NDBayerGBRG */
+    {1, 0, 2, 1},   /* NDBayerGRBG */
+    {2, 1, 1, 0}    /* NDBayerBGGR */
+};
+
+/** Sets the layout of an nx by ny image in a color mode */
+static void colorLayout(int colorMode, size_t nx, size_t ny, colorLayout_t *pLayout)
+{
+    size_t i;
+
+    switch (colorMode) {
+        case NDColorModeRGB1:
+            for (i=0; i<3; i++) pLayout->offset[i] = i;
+            pLayout->rowStride = 3*nx;
+            pLayout->step = 3;
+            break;
+        case NDColorModeRGB2:
+            for (i=0; i<3; i++) pLayout->offset[i] = i*nx;
+            pLayout->rowStride = 3*nx;
+            pLayout->step = 1;
+            break;
+        case NDColorModeRGB3:
+            for (i=0; i<3; i++) pLayout->offset[i] = i*nx*ny;
+            pLayout->rowStride = nx;
+            pLayout->step = 1;
+            break;
+        default:
+            for (i=0; i<3; i++) pLayout->offset[i] = 0;
+            pLayout->rowStride = nx;
+            pLayout->step = 1;
+            break;
+    }
+}
+
+/** Type in which pixel values are summed; int for 8 and 16 bit data so that the loops vectorize */
+template <typename epicsType> struct colorSum { typedef double type; };
+template <> struct colorSum<epicsInt8>        { typedef int type; };
+template <> struct colorSum<epicsUInt8>       { typedef int type; };
+template <> struct colorSum<epicsInt16>       { typedef int type; };
+template <> struct colorSum<epicsUInt16>      { typedef int type; };
+
+/** Average of n values with this sum, rounded to the nearest integer for integers */
+static inline int colorAverage(int sum, int n)
+{
+    return (sum >= 0) ? (sum + n/2) / n : -((n/2 - sum) / n);
+}
+
+static inline double colorAverage(double sum, int n)
+{
+    return sum / n;
+}
+
+/** Converts a value to epicsType, limiting it to the range of integer types */
+template <typename epicsType>
+static inline epicsType colorClamp(typename colorSum<epicsType>::type value)
+{
+    typedef typename colorSum<epicsType>::type sumType;
+
+    if (std::numeric_limits<epicsType>::is_integer) {
+        if (value < (sumType)std::numeric_limits<epicsType>::min()) return std::numeric_limits<epicsType>::min();
+        if (value > (sumType)std::numeric_limits<epicsType>::max()) return std::numeric_limits<epicsType>::max();
+    }
+    return (epicsType)value;
+}
+
+/** Index of pixel i of a line of n pixels, reflected at the ends of the line.
+  * The reflected pixel has the same Bayer color as pixel i. */
+static inline size_t reflect(ptrdiff_t i, size_t n)
+{
+    if (i < 0) return (size_t)(-i);
+    if (i >= (ptrdiff_t)n) return 2*(n-1) - (size_t)i;
+    return (size_t)i;
+}
+
+/** Copies one row of three colors.  The steps are template parameters so that the compiler can
+  * vectorize the loop for each layout. */
+template <typename epicsType, int stepIn, int stepOut>
+static void copyColors(const epicsType *pRed, const epicsType *pGreen, const epicsType *pBlue,
+                       epicsType *pRedOut, epicsType *pGreenOut, epicsType *pBlueOut, size_t nx)
+{
+    for (size_t x=0; x<nx; x++) {
+        pRedOut[x*stepOut]   = pRed[x*stepIn];
+        pGreenOut[x*stepOut] = pGreen[x*stepIn];
+        pBlueOut[x*stepOut]  = pBlue[x*stepIn];
+    }
+}
+
+/** Converts row y from mono or RGB to RGB */
 template <typename epicsType>
+static void rgbRow(const colorConvertPvt_t *pPvt, size_t y)
+{
+    const epicsType *pIn[3];
+    epicsType *pOut[3];
+    size_t nx = pPvt->nx;
+    size_t stepIn = pPvt->in.step, stepOut = pPvt->out.step;
+    int c;
+
+    for (c=0; c<3; c++) {
+        pIn[c]  = (const epicsType *)pPvt->pIn + pPvt->in.offset[c] + y*pPvt->in.rowStride;
+        pOut[c] = (epicsType *)pPvt->pOut + pPvt->out.offset[c] + y*pPvt->out.rowStride;
+    }
+    if (pPvt->colorMap[0]) {
+        for (c=0; c<3; c++) {
+            const unsigned char *pMap = pPvt->colorMap[c];
+            for (size_t x=0; x<nx; x++) {
+                pOut[c][x*stepOut] = (epicsType)pMap[(unsigned char)pIn[c][x*stepIn]];
+            }
+        }
+    } else if ((stepIn == 1) && (stepOut == 1)) {
+        for (c=0; c<3; c++) memcpy(pOut[c], pIn[c], nx*sizeof(epicsType));
+    } else if (stepIn == 1) {
+        copyColors<epicsType, 1, 3>(pIn[0], pIn[1], pIn[2], pOut[0], pOut[1], pOut[2], nx);
+    } else if (stepOut == 1) {
+        copyColors<epicsType, 3, 1>(pIn[0], pIn[1], pIn[2], pOut[0], pOut[1], pOut[2], nx);
+    } else {
+        copyColors<epicsType, 3, 3>(pIn[0], pIn[1], pIn[2], pOut[0], pOut[1], pOut[2], nx);
+    }
+}
+
+/** Converts one row of RGB to mono, the average of the three colors */
+template <typename epicsType, int stepIn>
+static void averageColors(const epicsType *pRed, const epicsType *pGreen, const epicsType *pBlue,
+                          epicsType *pOut, size_t nx)
+{
+    typedef typename colorSum<epicsType>::type sumType;
+
+    for (size_t x=0; x<nx; x++) {
+        pOut[x] = (epicsType)(((sumType)pRed[x*stepIn] + pGreen[x*stepIn] + pBlue[x*stepIn]) / 3);
+    }
+}
+
+/** Converts row y from RGB to mono */
+template <typename epicsType>
+static void monoRow(const colorConvertPvt_t *pPvt, size_t y)
+{
+    const epicsType *pIn[3];
+    epicsType *pOut = (epicsType *)pPvt->pOut + y*pPvt->out.rowStride;
+
+    for (int c=0; c<3; c++) {
+        pIn[c] = (const epicsType *)pPvt->pIn + pPvt->in.offset[c] + y*pPvt->in.rowStride;
+    }
+    if (pPvt->in.step == 1) {
+        averageColors<epicsType, 1>(pIn[0], pIn[1], pIn[2], pOut, pPvt->nx);
+    } else {
+        averageColors<epicsType, 3>(pIn[0], pIn[1], pIn[2], pOut, pPvt->nx);
+    }
+}
+
+/** Converts row y from Bayer to RGB, taking each color from the pixel of that color in the 2x2 cell
+  * that contains the pixel, and green from the same row */
+template <typename epicsType>
+static void bayerNearestRow(const colorConvertPvt_t *pPvt, size_t y)
+{
+    const epicsType *pIn = (const epicsType *)pPvt->pIn;
+    size_t nx = pPvt->nx, ny = pPvt->ny;
+    size_t step = pPvt->out.step;
+    const epicsType *pRow[3];
+    size_t dx[3];
+    epicsType *pOut[3];
+    int c, i;
+
+    /* The row and the position in the cell of each color */
+    for (i=0; i<4; i++) {
+        c = pPvt->bayerColors[i];
+        if ((c == 1) && ((size_t)(i >> 1) != (y & 1))) continue;
+        pRow[c] = pIn + reflect((y & ~(size_t)1) + (i >> 1), ny)*nx;
+        dx[c] = i & 1;
+    }
+    for (c=0; c<3; c++) {
+        pOut[c] = (epicsType *)pPvt->pOut + pPvt->out.offset[c] + y*pPvt->out.rowStride;
+        for (size_t x=0; x<nx; x++) {
+            size_t xIn = (x & ~(size_t)1) + dx[c];
+            /* The last cell is incomplete when nx is odd */
+            if (xIn >= nx) xIn = nx - 2;
+            pOut[c][x*step] = pRow[c][xIn];
+        }
+    }
+}
+
+/** Converts row y from Bayer to RGB, with each missing color the average of the 2 or 4 nearest pixels
+  * of that color */
+template <typename epicsType>
+static void bayerBilinearRow(const colorConvertPvt_t *pPvt, size_t y)
+{
+    typedef typename colorSum<epicsType>::type sumType;
+    const epicsType *pIn = (const epicsType *)pPvt->pIn;
+    size_t nx = pPvt->nx, ny = pPvt->ny;
+    size_t step = pPvt->out.step;
+    const epicsType *pUp   = pIn + reflect((ptrdiff_t)y - 1, ny)*nx;
+    const epicsType *pRow  = pIn + y*nx;
+    const epicsType *pDown = pIn + reflect((ptrdiff_t)y + 1, ny)*nx;
+    const int *rowColors = pPvt->bayerColors + 2*(y & 1);
+    epicsType *pOut[3];
+    int c, h;
+
+    for (c=0; c<3; c++) pOut[c] = (epicsType *)pPvt->pOut + pPvt->out.offset[c] + y*pPvt->out.rowStride;
+    for (size_t x=0; x<nx; x++) {
+        size_t l = x ? x-1 : 1;
+        size_t r = (x+1 < nx) ? x+1 : nx-2;
+        size_t o = x*step;
+        c = rowColors[x & 1];
+        pOut[c][o] = pRow[x];
+        if (c == 1) {
+            /* Green pixel; h is the color of the pixels to the left and right */
+            h = rowColors[(x+1) & 1];
+            pOut[h][o]   = (epicsType)colorAverage((sumType)pRow[l] + pRow[r], 2);
+            pOut[2-h][o] = (epicsType)colorAverage((sumType)pUp[x] + pDown[x], 2);
+        } else {
+            pOut[1][o]   = (epicsType)colorAverage((sumType)pRow[l] + pRow[r] + pUp[x] + pDown[x], 4);
+            pOut[2-c][o] = (epicsType)colorAverage((sumType)pUp[l] + pUp[r] + pDown[l] + pDown[r], 4);
+        }
+    }
+}
+
+/** First pass of the edge-aware Bayer conversion of row y.
+  * Green at red and blue pixels is interpolated along the row or column, whichever has the smaller
+  * gradient, with a correction from the second derivative of the pixel's own color (Hamilton-Adams). */
+template <typename epicsType>
+static void bayerGreenRow(const colorConvertPvt_t *pPvt, size_t y)
+{
+    typedef typename colorSum<epicsType>::type sumType;
+    const epicsType *pIn = (const epicsType *)pPvt->pIn;
+    size_t nx = pPvt->nx, ny = pPvt->ny;
+    size_t step = pPvt->out.step;
+    const epicsType *pRows[5];
+    const int *rowColors = pPvt->bayerColors + 2*(y & 1);
+    epicsType *pGreen = (epicsType *)pPvt->pOut + pPvt->out.offset[1] + y*pPvt->out.rowStride;
+    int i;
+
+    for (i=0; i<5; i++) pRows[i] = pIn + reflect((ptrdiff_t)y + i - 2, ny)*nx;
+    for (size_t x=0; x<nx; x++) {
+        const epicsType *pRow = pRows[2];
+        if (rowColors[x & 1] == 1) {
+            pGreen[x*step] = pRow[x];
+            continue;
+        }
+        size_t l  = x ? x-1 : 1;
+        size_t r  = (x+1 < nx) ? x+1 : nx-2;
+        size_t l2 = reflect((ptrdiff_t)x - 2, nx);
+        size_t r2 = reflect((ptrdiff_t)x + 2, nx);
+        sumType center = 2*(sumType)pRow[x];
+        sumType curveH = center - pRow[l2] - pRow[r2];
+        sumType curveV = center - pRows[0][x] - pRows[4][x];
+        sumType diffH = (sumType)pRow[l] - pRow[r];
+        sumType diffV = (sumType)pRows[1][x] - pRows[3][x];
+        sumType gradH = (diffH < 0 ? -diffH : diffH) + (curveH < 0 ? -curveH : curveH);
+        sumType gradV = (diffV < 0 ? -diffV : diffV) + (curveV < 0 ? -curveV : curveV);
+        /* Four times the estimate along the row and along the column */
+        sumType greenH = 2*((sumType)pRow[l] + pRow[r]) + curveH;
+        sumType greenV = 2*((sumType)pRows[1][x] + pRows[3][x]) + curveV;
+        sumType green;
+        if (gradH < gradV)      green = colorAverage(greenH, 4);
+        else if (gradV < gradH) green = colorAverage(greenV, 4);
+        else                    green = colorAverage(greenH + greenV, 8);
+        pGreen[x*step] = colorClamp<epicsType>(green);
+    }
+}
+
+/** Second pass of the edge-aware Bayer conversion of row y.
+  * Red and blue are interpolated as differences from the green of the first pass, which follow
+  * edges better than the colors themselves. */
+template <typename epicsType>
+static void bayerRedBlueRow(const colorConvertPvt_t *pPvt, size_t y)
+{
+    typedef typename colorSum<epicsType>::type sumType;
+    const epicsType *pIn = (const epicsType *)pPvt->pIn;
+    size_t nx = pPvt->nx, ny = pPvt->ny;
+    size_t step = pPvt->out.step;
+    size_t up = reflect((ptrdiff_t)y - 1, ny), down = reflect((ptrdiff_t)y + 1, ny);
+    const epicsType *pUp   = pIn + up*nx;
+    const epicsType *pRow  = pIn + y*nx;
+    const epicsType *pDown = pIn + down*nx;
+    const epicsType *pGreen     = (const epicsType *)pPvt->pOut + pPvt->out.offset[1];
+    const epicsType *pGreenUp   = pGreen + up*pPvt->out.rowStride;
+    const epicsType *pGreenRow  = pGreen + y*pPvt->out.rowStride;
+    const epicsType *pGreenDown = pGreen + down*pPvt->out.rowStride;
+    const int *rowColors = pPvt->bayerColors + 2*(y & 1);
+    epicsType *pOut[3];
+    int c, h;
+
+    for (c=0; c<3; c++) pOut[c] = (epicsType *)pPvt->pOut + pPvt->out.offset[c] + y*pPvt->out.rowStride;
+    for (size_t x=0; x<nx; x++) {
+        size_t l = x ? x-1 : 1;
+        size_t r = (x+1 < nx) ? x+1 : nx-2;
+        size_t o = x*step;
+        sumType green = pGreenRow[o];
+        c = rowColors[x & 1];
+        if (c == 1) {
+            h = rowColors[(x+1) & 1];
+            pOut[h][o] = colorClamp<epicsType>(green + colorAverage(
+                         ((sumType)pRow[l] - pGreenRow[l*step]) + ((sumType)pRow[r] - pGreenRow[r*step]), 2));
+            pOut[2-h][o] = colorClamp<epicsType>(green + colorAverage(
+                         ((sumType)pUp[x] - pGreenUp[o]) + ((sumType)pDown[x] - pGreenDown[o]), 2));
+        } else {
+            pOut[c][o] = pRow[x];
+            pOut[2-c][o] = colorClamp<epicsType>(green + colorAverage(
+                         ((sumType)pUp[l]   - pGreenUp[l*step])   + ((sumType)pUp[r]   - pGreenUp[r*step]) +
+                         ((sumType)pDown[l] - pGreenDown[l*step]) + ((sumType)pDown[r] - pGreenDown[r*step]), 4));
+        }
+    }
+}
+
+/** Converts a pixel from YUV to RGB with the ITU-R BT.601 equations in 8 bit fixed point */
+static inline void yuvToRGB(int y, int u, int v, int rgb[3])
+{
+    u -= 128;
+    v -= 128;
+    rgb[0] = y + ((359*v + 128) >> 8);
+    rgb[1] = y + ((-88*u - 183*v + 128) >> 8);
+    rgb[2] = y + ((454*u + 128) >> 8);
+    for (int c=0; c<3; c++) {
+        if (rgb[c] < 0) rgb[c] = 0;
+        if (rgb[c] > 255) rgb[c] = 255;
+    }
+}
+
+/** Converts row y of 8 bit YUV data to mono or RGB.
+  * The byte order is that of IIDC cameras: U Y V for YUV444, U Y0 V Y1 for YUV422 and
+  * U Y0 Y1 V Y2 Y3 for YUV411.  Mono output is the Y value. */
+template <typename epicsType>
+static void yuvRow(const colorConvertPvt_t *pPvt, size_t y)
+{
+    const unsigned char *pRow = (const unsigned char *)pPvt->pIn + y*pPvt->in.rowStride;
+    static const int yuv411Y[4] = {1, 2, 4, 5};
+    size_t nx = pPvt->nx;
+    size_t step = pPvt->out.step;
+    bool mono = (pPvt->out.offset[2] == 0);  /* Only the mono layout has all colors at offset 0 */
+    epicsType *pOut[3];
+    int yuv[3], rgb[3];
+    int c;
+
+    for (c=0; c<3; c++) pOut[c] = (epicsType *)pPvt->pOut + pPvt->out.offset[c] + y*pPvt->out.rowStride;
+    for (size_t x=0; x<nx; x++) {
+        const unsigned char *pCell;
+        switch (pPvt->yuvMode) {
+            case NDColorModeYUV444:
+                pCell = pRow + 3*x;
+                yuv[0] = pCell[1]; yuv[1] = pCell[0]; yuv[2] = pCell[2];
+                break;
+            case NDColorModeYUV422:
+                pCell = pRow + 4*(x/2);
+                yuv[0] = pCell[1 + 2*(x & 1)]; yuv[1] = pCell[0]; yuv[2] = pCell[2];
+                break;
+            default:
+                pCell = pRow + 6*(x/4);
+                yuv[0] = pCell[yuv411Y[x & 3]]; yuv[1] = pCell[0]; yuv[2] = pCell[3];
+                break;
+        }
+        if (mono) {
+            pOut[0][x] = (epicsType)yuv[0];
+        } else {
+            yuvToRGB(yuv[0], yuv[1], yuv[2], rgb);
+            for (c=0; c<3; c++) pOut[c][x*step] = (epicsType)rgb[c];
+        }
+    }
+}
+
+/** Function called by runTiles() to convert rows first to first+count-1 */
+template <typename epicsType>
+static void convertRows(void *pvt, int first, int count)
+{
+    const colorConvertPvt_t *pPvt = (const colorConvertPvt_t *)pvt;
+
+    for (size_t y=first; y<(size_t)(first+count); y++) {
+        switch (pPvt->kernel) {
+            case kernelRGB:           rgbRow<epicsType>(pPvt, y);           break;
+            case kernelMono:          monoRow<epicsType>(pPvt, y);          break;
+            case kernelBayerNearest:  bayerNearestRow<epicsType>(pPvt, y);  break;
+            case kernelBayerBilinear: bayerBilinearRow<epicsType>(pPvt, y); break;
+            case kernelBayerGreen:    bayerGreenRow<epicsType>(pPvt, y);    break;
+            case kernelBayerRedBlue:  bayerRedBlueRow<epicsType>(pPvt, y);  break;
+            case kernelYUV:           yuvRow<epicsType>(pPvt, y);           break;
+            default: break;
+        }
+    }
+}
+
+/** Returns the convertRows() function for this data type, or NULL if it is invalid */
+static NDPluginTileFunc_t convertRowsFunc(NDDataType_t dataType)
+{
+    switch (dataType) {
+        case NDInt8:    return convertRows<epicsInt8>;
+        case NDUInt8:   return convertRows<epicsUInt8>;
+        case NDInt16:   return convertRows<epicsInt16>;
+        case NDUInt16:  return convertRows<epicsUInt16>;
+        case NDInt32:   return convertRows<epicsInt32>;
+        case NDUInt32:  return convertRows<epicsUInt32>;
+        case NDFloat32: return convertRows<epicsFloat32>;
+        case NDFloat64: return convertRows<epicsFloat64>;
+        default:        return NULL;
+    }
+}
+
+static bool isRGB(int colorMode)
+{
+    return (colorMode == NDColorModeRGB1) || (colorMode == NDColorModeRGB2) || (colorMode == NDColorModeRGB3);
+}
+
+/** Converts pArray to the output color mode and does the callbacks with the result.
+  * The rows of the image are converted by tileThreads threads. */
 void NDPluginColorConvert::convertColor(NDArray *pArray)
 {
     NDColorMode_t colorModeOut;
     static const char* functionName = "convertColor";
-    size_t i, j;
-    epicsType *pIn, *pRedIn, *pGreenIn, *pBlueIn;
-    epicsType *pOut, *pRedOut, *pGreenOut, *pBlueOut;
-    epicsType *pDataIn  = (epicsType *)pArray->pData;
-    epicsType *pDataOut;
     NDArray *pArrayOut=NULL;
-    size_t imageSize, rowSize, numRows;
+    NDPluginTileFunc_t convertFunc;
+    colorConvertPvt_t pvt;
+    NDDimension_t dimX, dimY, dimColor, dimsOut[3];
     size_t dims[3];
-    NDDimension_t tmpDim;
-    #ifdef HAVE_PVAPI
-    tPvFrame PvFrame, *pFrame=&PvFrame;
-    int ndims;
-    #endif
-    double value;
+    int ndimsOut=2;
     int colorMode=NDColorModeMono, bayerPattern=NDBayerRGGB;
     int falseColor=0;
+    int bayerMethod, tileThreads;
     int changedColorMode=0;
-    const unsigned char *colorMapR=NULL;
-    const unsigned char *colorMapG=NULL;
-    const unsigned char *colorMapB=NULL;        
-    const unsigned char *colorMapRGB=NULL;     
+    bool eightBit = (pArray->dataType == NDInt8) || (pArray->dataType == NDUInt8);
+    bool validDims = false;
     NDAttribute *pAttribute;
+    int i;
      
     getIntegerParam(NDPluginColorConvertColorModeOut, (int *)&colorModeOut);
+    getIntegerParam(NDPluginColorConvertBayerMethod, &bayerMethod);
+    getIntegerParam(NDPluginColorConvertTileThreads, &tileThreads);
+    /* if we have int8 data then check for false color */
+    if (eightBit) getIntegerParam(NDPluginColorConvertFalseColor, &falseColor);
     pAttribute = pArray->pAttributeList->find("ColorMode");
     if (pAttribute) pAttribute->getValue(NDAttrInt32, &colorMode);
     pAttribute = pArray->pAttributeList->find("BayerPattern");
     if (pAttribute) pAttribute->getValue(NDAttrInt32, &bayerPattern);
-    
-    /* if we have int8 data then check for false color */
-    if (pArray->dataType == NDInt8 || pArray->dataType == NDUInt8) {
-        getIntegerParam(NDPluginColorConvertFalseColor, &falseColor);            
-        switch (falseColor) {
-        case 1:
-            colorMapR = RainbowColorR;
-            colorMapG = RainbowColorG;
-            colorMapB = RainbowColorB;
-            colorMapRGB = RainbowColorRGB;      
-            break;
-        case 2:
-            colorMapR = IronColorR;
-            colorMapG = IronColorG;
-            colorMapB = IronColorB;
-            colorMapRGB = IronColorRGB;                        
-            break;
-        default:
-            falseColor = 0;
-        }
-    }     
+
     /* This function is called with the lock taken, and it must be set when we exit.
      * The following code can be exected without the mutex because we are not accessing elements of
      * pPvt that other threads can access. */
     this->unlock();
+
+    /* Find the X, Y and color dimensions of the input */
+    memset(&pvt, 0, sizeof(pvt));
+    memset(&dimColor, 0, sizeof(dimColor));
+    dimColor.size = 3;
+    dimColor.binning = 1;
     switch (colorMode) {
         case NDColorModeMono:
-            if (pArray->ndims != 2) break;
-            rowSize   = pArray->dims[0].size;
-            numRows   = pArray->dims[1].size;
-            imageSize = rowSize * numRows;
-            switch (colorModeOut) {
-                case NDColorModeRGB1:
-                    dims[0] = 3;
-                    dims[1] = rowSize;
-                    dims[2] = numRows;
-                    pArrayOut = this->pNDArrayPool->alloc(3, dims, pArray->dataType, 0, NULL);
-                    tmpDim = pArrayOut->dims[0];
-                    /* Copy everything except the data, e.g. uniqueId and timeStamp, attributes. */
-                    this->pNDArrayPool->copy(pArray, pArrayOut, 0);
-                    /* That replaced the dimensions in the output array, need to fix. */
-                    pArrayOut->ndims = 3;
-                    pArrayOut->dims[2] = pArrayOut->dims[1];
-                    pArrayOut->dims[1] = pArrayOut->dims[0];
-                    pArrayOut->dims[0] = tmpDim;
-                    pDataOut = (epicsType *)pArrayOut->pData;
-                    pOut = pDataOut;
-                    pIn  = pDataIn;
-                    if (falseColor) {
-                        for (i=0; i<imageSize; i++) {
-                            memcpy(pOut, colorMapRGB + 3 * ((unsigned char)*pIn++), 3);
-                            pOut+=3;
-                        }                                       
-                    } else {
-                        for (i=0; i<imageSize; i++) {
-                            *pOut++ = *pIn;
-                            *pOut++ = *pIn;
-                            *pOut++ = *pIn++;
-                        }
-                    }
-                    changedColorMode = 1;
-                    break;
-                case NDColorModeRGB2:
-                    /* Make a new 3-D array */
-                    dims[0] = rowSize;
-                    dims[1] = 3;
-                    dims[2] = numRows;
-                    pArrayOut = this->pNDArrayPool->alloc(3, dims, pArray->dataType, 0, NULL);
-                    tmpDim = pArrayOut->dims[1];
-                    /* Copy everything except the data, e.g. uniqueId and timeStamp, attributes. */
-                    this->pNDArrayPool->copy(pArray, pArrayOut, 0);
-                    /* That replaced the dimensions in the output array, need to fix. */
-                    pArrayOut->ndims = 3;
-                    pArrayOut->dims[2] = pArrayOut->dims[1];
-                    pArrayOut->dims[1] = tmpDim;
-                    pDataOut = (epicsType *)pArrayOut->pData;
-                    pIn  = pDataIn;
-                    if (falseColor) {
-                        for (i=0; i<numRows; i++) {
-                            pRedOut   = pDataOut + 3*i*rowSize;
-                            pGreenOut = pRedOut + rowSize;
-                            pBlueOut  = pRedOut + 2*rowSize;
-                            for (j=0; j<rowSize; j++) {
-                                *pRedOut++   = colorMapR[(unsigned char)*pIn];
-                                *pGreenOut++ = colorMapG[(unsigned char)*pIn];
-                                *pBlueOut++  = colorMapB[(unsigned char)*pIn++];
-                            }
-                        }                                
-                    } else {
-                        for (i=0; i<numRows; i++) {
-                            pRedOut   = pDataOut + 3*i*rowSize;
-                            pGreenOut = pRedOut + rowSize;
-                            pBlueOut  = pRedOut + 2*rowSize;
-                            for (j=0; j<rowSize; j++) {
-                                *pRedOut++   = *pIn;
-                                *pGreenOut++ = *pIn;
-                                *pBlueOut++  = *pIn++;
-                            }
-                        }
-                    }                    
-                    changedColorMode = 1;
-                    break;
-                case NDColorModeRGB3:
-                    /* Make a new 3-D array */
-                    dims[0] = rowSize;
-                    dims[1] = numRows;
-                    dims[2] = 3;
-                    pArrayOut = this->pNDArrayPool->alloc(3, dims, pArray->dataType, 0, NULL);
-                    tmpDim = pArrayOut->dims[2];
-                    /* Copy everything except the data, e.g. uniqueId and timeStamp, attributes. */
-                    this->pNDArrayPool->copy(pArray, pArrayOut, 0);
-                    /* That replaced the dimensions in the output array, need to fix. */
-                    pArrayOut->ndims = 3;
-                    pArrayOut->dims[2] = tmpDim;
-                    pDataOut = (epicsType *)pArrayOut->pData;
-                    pRedOut   = pDataOut;
-                    pGreenOut = pDataOut + imageSize;
-                    pBlueOut  = pDataOut + 2*imageSize;
-                    pIn  = pDataIn;
-                    if (falseColor) {  
-                        for (i=0; i<imageSize; i++) {                    
-                            *pRedOut++   = colorMapR[(unsigned char)*pIn];
-                            *pGreenOut++ = colorMapG[(unsigned char)*pIn];
-                            *pBlueOut++  = colorMapB[(unsigned char)*pIn++];
-                        }                                                   
-                    } else {                                      
-                        for (i=0; i<imageSize; i++) {
-                            *pRedOut++   = *pIn;
-                            *pGreenOut++ = *pIn;
-                            *pBlueOut++  = *pIn++;
-                        }
-                    }                        
-                    changedColorMode = 1;
-                    break;
-                default:
-                    break;
-            }
-            break;
-        #ifdef HAVE_PVAPI
         case NDColorModeBayer:
             if (pArray->ndims != 2) break;
-            switch (colorModeOut) {
-                case NDColorModeRGB1:
-                case NDColorModeRGB2:
-                case NDColorModeRGB3:
-                    rowSize   = pArray->dims[0].size;
-                    numRows   = pArray->dims[1].size;
-                    imageSize = rowSize * numRows;
-                    ndims = 3;
-                    dims[0] = 3;
-                    dims[1] = rowSize;
-                    dims[2] = numRows;
-                    /* There is a problem: the uniqueId and timeStamp are not preserved! */
-                    pArrayOut = this->pNDArrayPool->alloc(ndims, dims, pArray->dataType, 0, NULL);
-                    pArrayOut->uniqueId = pArray->uniqueId;
-                    pArrayOut->epicsTS = pArray->epicsTS;
-                    pArrayOut->timeStamp = pArray->timeStamp;
-                    pDataOut = (epicsType *)pArrayOut->pData;
-                    /* For now we use the Prosilica library functions to convert Bayer to RGB */
-                    /* This requires creating their tPvFrame data structure */
-                    memset(pFrame, 0, sizeof(tPvFrame));
-                    pFrame->Width = (unsigned long)pArray->dims[0].size;
-                    pFrame->Height = (unsigned long)pArray->dims[1].size;
-                    pFrame->RegionX = (unsigned long)pArray->dims[0].offset;
-                    pFrame->RegionY = (unsigned long)pArray->dims[1].offset;
-                    pFrame->ImageBuffer = pArray->pData;
-                    pFrame->ImageBufferSize = (unsigned long)pArray->dataSize;
-                    pFrame->ImageSize = pFrame->ImageBufferSize;
-                    pFrame->BayerPattern = (tPvBayerPattern)bayerPattern;
-                    switch(pArray->dataType) {
-                        case NDInt8:
-                        case NDUInt8:
-                            pFrame->Format = ePvFmtBayer8;
-                            pFrame->BitDepth = 8;
-                            break;
-                        case NDInt16:
-                        case NDUInt16:
-                            pFrame->Format = ePvFmtBayer16;
-                            pFrame->BitDepth = 16;
-                            break;
-                        default:
-                            asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
-                                "%s:%s: error unsupported data type=%d\n",
-                                driverName, functionName, pArray->dataType);
-                            break;
-                    }
-                    break;
-                default: 
-                    break;
-            }
-            switch (colorModeOut) {
-                case NDColorModeRGB1:
-                    PvUtilityColorInterpolate(pFrame, pDataOut, pDataOut+1, pDataOut+2, 2, 0);
-                    pArrayOut->dims[0].size = 3;
-                    memcpy(&pArrayOut->dims[1], &pArray->dims[0], sizeof(NDDimension_t));
-                    memcpy(&pArrayOut->dims[2], &pArray->dims[1], sizeof(NDDimension_t));
-                    changedColorMode = 1;
-                    break;
-                
-                case NDColorModeRGB2:
-                    PvUtilityColorInterpolate(pFrame, pDataOut,  pDataOut+rowSize, pDataOut+2*rowSize, 
-                                              0, (unsigned long)(2*rowSize));
-                    memcpy(&pArrayOut->dims[0], &pArray->dims[0], sizeof(NDDimension_t));
-                    pArrayOut->dims[1].size = 3;
-                    memcpy(&pArrayOut->dims[2], &pArray->dims[1], sizeof(NDDimension_t));
-                    changedColorMode = 1;
-                    break;
-
-                case NDColorModeRGB3:
-                    PvUtilityColorInterpolate(pFrame, pDataOut,  pDataOut+imageSize, pDataOut+2*imageSize, 0, 0);
-                    memcpy(&pArrayOut->dims[0], &pArray->dims[0], sizeof(NDDimension_t));
-                    memcpy(&pArrayOut->dims[1], &pArray->dims[1], sizeof(NDDimension_t));
-                    pArrayOut->dims[2].size = 3;
-                    changedColorMode = 1;
-                    break;
-                default:
-                    break;
-            }
+            dimX = pArray->dims[0];
+            dimY = pArray->dims[1];
+            validDims = true;
             break;
-        #endif
         case NDColorModeRGB1:
-            if (pArray->ndims != 3) break;
-            rowSize   = pArray->dims[1].size;
-            numRows   = pArray->dims[2].size;
-            imageSize = rowSize * numRows;
-            switch (colorModeOut) {
-                case NDColorModeMono:
-                    /* Make a new 2-D array */
-                    dims[0] = rowSize;
-                    dims[1] = numRows;
-                    pArrayOut = this->pNDArrayPool->alloc(2, dims, pArray->dataType, 0, NULL);
-                    /* Copy everything except the data, e.g. uniqueId and timeStamp, attributes. */
-                    this->pNDArrayPool->copy(pArray, pArrayOut, 0);
-                    /* That replaced the dimensions in the output array, need to fix. */
-                    pArrayOut->ndims = 2;
-                    pArrayOut->dims[0] = pArrayOut->dims[1];
-                    pArrayOut->dims[1] = pArrayOut->dims[2];
-                    pDataOut = (epicsType *)pArrayOut->pData;
-                    pOut = pDataOut;
-                    pIn = pDataIn;
-                    for (i=0; i<imageSize; i++) {
-                        value  = (*pIn + *(pIn+1) + *(pIn+2))/3.;
-                        *pOut++ = (epicsType)value;
-                        pIn += 3;
-                    }
-                    changedColorMode = 1;
-                    break;
-                case NDColorModeRGB2:
-                    pArrayOut = this->pNDArrayPool->copy(pArray, NULL, 0);
-                    pDataOut = (epicsType *)pArrayOut->pData;
-                    pIn = pDataIn;
-                    for (i=0; i<numRows; i++) {
-                        pRedOut   = pDataOut + 3*i*rowSize;
-                        pGreenOut = pRedOut + rowSize;
-                        pBlueOut  = pRedOut + 2*rowSize;
-                        for (j=0; j<rowSize; j++) {
-                            *pRedOut++   = *pIn++;
-                            *pGreenOut++ = *pIn++;
-                            *pBlueOut++  = *pIn++;
-                        }
-                    }
-                    memcpy(&pArrayOut->dims[0], &pArray->dims[1], sizeof(NDDimension_t));
-                    memcpy(&pArrayOut->dims[1], &pArray->dims[0], sizeof(NDDimension_t));
-                    memcpy(&pArrayOut->dims[2], &pArray->dims[2], sizeof(NDDimension_t));
-                    changedColorMode = 1;
-                    break;
-                case NDColorModeRGB3:
-                    pArrayOut = this->pNDArrayPool->copy(pArray, NULL, 0);
-                    pDataOut = (epicsType *)pArrayOut->pData;
-                    pIn = pDataIn;
-                    pRedOut   = pDataOut;
-                    pGreenOut = pDataOut + imageSize;
-                    pBlueOut  = pDataOut + 2*imageSize;
-                    for (i=0; i<imageSize; i++) {
-                        *pRedOut++   = *pIn++;
-                        *pGreenOut++ = *pIn++;
-                        *pBlueOut++  = *pIn++;
-                    }
-                    memcpy(&pArrayOut->dims[0], &pArray->dims[1], sizeof(NDDimension_t));
-                    memcpy(&pArrayOut->dims[1], &pArray->dims[2], sizeof(NDDimension_t));
-                    memcpy(&pArrayOut->dims[2], &pArray->dims[0], sizeof(NDDimension_t));
-                    changedColorMode = 1;
-                    break;
-                default:
-                    break;
-            }        
+            if ((pArray->ndims != 3) || (pArray->dims[0].size != 3)) break;
+            dimColor = pArray->dims[0];
+            dimX = pArray->dims[1];
+            dimY = pArray->dims[2];
+            validDims = true;
             break;
         case NDColorModeRGB2:
-            if (pArray->ndims != 3) break;
-            rowSize   = pArray->dims[0].size;
-            numRows   = pArray->dims[2].size;
-            imageSize = rowSize * numRows;
-            switch (colorModeOut) {
-                case NDColorModeMono:
-                    /* Make a new 2-D array */
-                    dims[0] = rowSize;
-                    dims[1] = numRows;
-                    pArrayOut = this->pNDArrayPool->alloc(2, dims, pArray->dataType, 0, NULL);
-                    /* Copy everything except the data, e.g. uniqueId and timeStamp, attributes. */
-                    this->pNDArrayPool->copy(pArray, pArrayOut, 0);
-                    /* That replaced the dimensions in the output array, need to fix. */
-                    pArrayOut->ndims = 2;
-                    pArrayOut->dims[1] = pArrayOut->dims[2];
-                    pDataOut = (epicsType *)pArrayOut->pData;
-                    pOut = pDataOut;
-                    for (i=0; i<numRows; i++) {
-                        pRedIn   = pDataIn + 3*i*rowSize;
-                        pGreenIn = pRedIn + rowSize;
-                        pBlueIn  = pRedIn + 2*rowSize;
-                        for (j=0; j<rowSize; j++) {
-                            value = (*pRedIn++ + *pGreenIn++ + *pBlueIn++)/3.;
-                            *pOut++ = (epicsType)value;
-                        }
-                    }
-                    changedColorMode = 1;
-                    break;
-                case NDColorModeRGB1:
-                    pArrayOut = this->pNDArrayPool->copy(pArray, NULL, 0);
-                    pDataOut = (epicsType *)pArrayOut->pData;
-                    pOut = pDataOut;
-                    for (i=0; i<numRows; i++) {
-                        pRedIn   = pDataIn + 3*i*rowSize;
-                        pGreenIn = pRedIn + rowSize;
-                        pBlueIn  = pRedIn + 2*rowSize;
-                        for (j=0; j<rowSize; j++) {
-                            *pOut++  = *pRedIn++;
-                            *pOut++  = *pGreenIn++;
-                            *pOut++  = *pBlueIn++;
-                        }
-                    }
-                    memcpy(&pArrayOut->dims[0], &pArray->dims[1], sizeof(NDDimension_t));
-                    memcpy(&pArrayOut->dims[1], &pArray->dims[0], sizeof(NDDimension_t));
-                    memcpy(&pArrayOut->dims[2], &pArray->dims[2], sizeof(NDDimension_t));
-                    changedColorMode = 1;
-                    break;
-                case NDColorModeRGB3:
-                    pArrayOut = this->pNDArrayPool->copy(pArray, NULL, 0);
-                    pDataOut = (epicsType *)pArrayOut->pData;
-                    pRedOut   = pDataOut;
-                    pGreenOut = pDataOut + imageSize;
-                    pBlueOut  = pDataOut + 2*imageSize;
-                    for (i=0; i<numRows; i++) {
-                        pRedIn   = pDataIn + 3*i*rowSize;
-                        pGreenIn = pRedIn + rowSize;
-                        pBlueIn  = pRedIn + 2*rowSize;
-                        for (j=0; j<rowSize; j++) {
-                            *pRedOut++   = *pRedIn++;
-                            *pGreenOut++ = *pGreenIn++;
-                            *pBlueOut++  = *pBlueIn++;
-                        }
-                    }
-                    memcpy(&pArrayOut->dims[0], &pArray->dims[0], sizeof(NDDimension_t));
-                    memcpy(&pArrayOut->dims[1], &pArray->dims[2], sizeof(NDDimension_t));
-                    memcpy(&pArrayOut->dims[2], &pArray->dims[1], sizeof(NDDimension_t));
-                    changedColorMode = 1;
-                    break;
-                default:
-                    break;
-            }        
+            if ((pArray->ndims != 3) || (pArray->dims[1].size != 3)) break;
+            dimX = pArray->dims[0];
+            dimColor = pArray->dims[1];
+            dimY = pArray->dims[2];
+            validDims = true;
             break;
         case NDColorModeRGB3:
-            if (pArray->ndims != 3) break;
-            rowSize   = pArray->dims[0].size;
-            numRows   = pArray->dims[1].size;
-            imageSize = rowSize * numRows;
-            switch (colorModeOut) {
-                case NDColorModeMono:
-                    /* Make a new 2-D array */
-                    dims[0] = rowSize;
-                    dims[1] = numRows;
-                    pArrayOut = this->pNDArrayPool->alloc(2, dims, pArray->dataType, 0, NULL);
-                    /* Copy everything except the data, e.g. uniqueId and timeStamp, attributes. */
-                    this->pNDArrayPool->copy(pArray, pArrayOut, 0);
-                    /* That replaced the dimensions in the output array, need to fix. */
-                    pArrayOut->ndims = 2;
-                    pDataOut = (epicsType *)pArrayOut->pData;
-                    pOut = pDataOut;
-                    pRedIn   = pDataIn;
-                    pGreenIn = pDataIn + imageSize;
-                    pBlueIn  = pDataIn + 2*imageSize;
-                    for (i=0; i<imageSize; i++) {
-                        value = (*pRedIn++ + *pGreenIn++ + *pBlueIn++)/3.;
-                        *pOut++ = (epicsType)value;
-                    }
-                    changedColorMode = 1;
-                    break;
-                case NDColorModeRGB1:
-                    pArrayOut = this->pNDArrayPool->copy(pArray, NULL, 0);
-                    pDataOut = (epicsType *)pArrayOut->pData;
-                    pRedIn   = pDataIn;
-                    pGreenIn = pDataIn + imageSize;
-                    pBlueIn  = pDataIn + 2*imageSize;
-                    pOut = pDataOut;
-                    for (i=0; i<imageSize; i++) {
-                        *pOut++ = *pRedIn++;
-                        *pOut++ = *pGreenIn++;
-                        *pOut++ = *pBlueIn++;
-                    }
-                    memcpy(&pArrayOut->dims[0], &pArray->dims[2], sizeof(NDDimension_t));
-                    memcpy(&pArrayOut->dims[1], &pArray->dims[0], sizeof(NDDimension_t));
-                    memcpy(&pArrayOut->dims[2], &pArray->dims[1], sizeof(NDDimension_t));
-                    changedColorMode = 1;
-                    break;
-                case NDColorModeRGB2:
-                    pArrayOut = this->pNDArrayPool->copy(pArray, NULL, 0);
-                    pDataOut = (epicsType *)pArrayOut->pData;
-                    pRedIn   = pDataIn;
-                    pGreenIn = pDataIn + imageSize;
-                    pBlueIn  = pDataIn + 2*imageSize;
-                    for (i=0; i<numRows; i++) {
-                        pRedOut   = pDataOut + 3*i*rowSize;
-                        pGreenOut = pRedOut + rowSize;
-                        pBlueOut  = pRedOut + 2*rowSize;
-                        for (j=0; j<rowSize; j++) {
-                            *pRedOut++   = *pRedIn++;
-                            *pGreenOut++ = *pGreenIn++;
-                            *pBlueOut++  = *pBlueIn++;
-                        }
-                    }
-                    memcpy(&pArrayOut->dims[0], &pArray->dims[0], sizeof(NDDimension_t));
-                    memcpy(&pArrayOut->dims[1], &pArray->dims[2], sizeof(NDDimension_t));
-                    memcpy(&pArrayOut->dims[2], &pArray->dims[1], sizeof(NDDimension_t));
-                    changedColorMode = 1;
-                    break;
-                default:
-                    break;
+            if ((pArray->ndims != 3) || (pArray->dims[2].size != 3)) break;
+            dimX = pArray->dims[0];
+            dimY = pArray->dims[1];
+            dimColor = pArray->dims[2];
+            validDims = true;
+            break;
+        case NDColorModeYUV444:
+        case NDColorModeYUV422:
+        case NDColorModeYUV411:
+            /* The first dimension is the number of bytes in each row */
+            if ((pArray->ndims != 2) || !eightBit) break;
+            dimX = pArray->dims[0];
+            dimY = pArray->dims[1];
+            pvt.in.rowStride = dimX.size;
+            if (colorMode == NDColorModeYUV444) {
+                if (dimX.size % 3) break;
+                dimX.size /= 3;
+                dimX.offset /= 3;
+            } else if (colorMode == NDColorModeYUV422) {
+                if (dimX.size % 4) break;
+                dimX.size /= 2;
+                dimX.offset /= 2;
+            } else {
+                if (dimX.size % 6) break;
+                dimX.size = dimX.size / 3 * 2;
+                dimX.offset = dimX.offset / 3 * 2;
             }
+            validDims = true;
             break;
         default:
             break;
     }
-    /* If the output array pointer is null then no conversion was done, copy the input to the output */
-    if (!pArrayOut) pArrayOut = this->pNDArrayPool->copy(pArray, NULL, 1);
+
+    /* Choose the conversion */
+    if (validDims && (colorModeOut != colorMode)) {
+        pvt.nx = dimX.size;
+        pvt.ny = dimY.size;
+        switch (colorMode) {
+            case NDColorModeMono:
+                if (!isRGB(colorModeOut)) break;
+                pvt.kernel = kernelRGB;
+                if (falseColor == 1) {
+                    pvt.colorMap[0] = RainbowColorR;
+                    pvt.colorMap[1] = RainbowColorG;
+                    pvt.colorMap[2] = RainbowColorB;
+                } else if (falseColor == 2) {
+                    pvt.colorMap[0] = IronColorR;
+                    pvt.colorMap[1] = IronColorG;
+                    pvt.colorMap[2] = IronColorB;
+                }
+                break;
+            case NDColorModeRGB1:
+            case NDColorModeRGB2:
+            case NDColorModeRGB3:
+                if (isRGB(colorModeOut)) pvt.kernel = kernelRGB;
+                else if (colorModeOut == NDColorModeMono) pvt.kernel = kernelMono;
+                break;
+            case NDColorModeBayer:
+                if (!isRGB(colorModeOut) || (pvt.nx < 2) || (pvt.ny < 2)) break;
+                if ((bayerPattern < NDBayerRGGB) || (bayerPattern > NDBayerBGGR)) {
+                    asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                        "%s:%s: error unsupported Bayer pattern=%d\n",
+                        driverName, functionName, bayerPattern);
+                    break;
+                }
+                pvt.bayerColors = bayerColors[bayerPattern];
+                /* The edge-aware method needs pixels 2 away */
+                if ((bayerMethod == NDColorConvertBayerEdgeAware) && (pvt.nx >= 3) && (pvt.ny >= 3))
+                    pvt.kernel = kernelBayerGreen;
+                else if (bayerMethod == NDColorConvertBayerNearest)
+                    pvt.kernel = kernelBayerNearest;
+                else
+                    pvt.kernel = kernelBayerBilinear;
+                break;
+            case NDColorModeYUV444:
+            case NDColorModeYUV422:
+            case NDColorModeYUV411:
+                if (!isRGB(colorModeOut) && (colorModeOut != NDColorModeMono)) break;
+                pvt.kernel = kernelYUV;
+                pvt.yuvMode = colorMode;
+                break;
+            default:
+                break;
+        }
+    }
+
+    convertFunc = convertRowsFunc(pArray->dataType);
+    if (!convertFunc) pvt.kernel = kernelNone;
+    if (pvt.kernel != kernelNone) {
+        switch (colorModeOut) {
+            case NDColorModeRGB1:
+                dimsOut[0] = dimColor; dimsOut[1] = dimX;     dimsOut[2] = dimY;
+                ndimsOut = 3;
+                break;
+            case NDColorModeRGB2:
+                dimsOut[0] = dimX;     dimsOut[1] = dimColor; dimsOut[2] = dimY;
+                ndimsOut = 3;
+                break;
+            case NDColorModeRGB3:
+                dimsOut[0] = dimX;     dimsOut[1] = dimY;     dimsOut[2] = dimColor;
+                ndimsOut = 3;
+                break;
+            default:
+                dimsOut[0] = dimX;     dimsOut[1] = dimY;
+                ndimsOut = 2;
+                break;
+        }
+        for (i=0; i<ndimsOut; i++) dims[i] = dimsOut[i].size;
+        pArrayOut = this->pNDArrayPool->alloc(ndimsOut, dims, pArray->dataType, 0, NULL);
+        if (!pArrayOut) {
+            asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                "%s:%s: error allocating output array\n",
+                driverName, functionName);
+        }
+    }
+    if (pArrayOut) {
+        /* Copy everything except the data, e.g. uniqueId and timeStamp, attributes. */
+        this->pNDArrayPool->copy(pArray, pArrayOut, 0);
+        /* That replaced the dimensions in the output array, need to fix. */
+        pArrayOut->ndims = ndimsOut;
+        memcpy(pArrayOut->dims, dimsOut, ndimsOut*sizeof(NDDimension_t));
+        if (colorMode != NDColorModeYUV444 && colorMode != NDColorModeYUV422 && colorMode != NDColorModeYUV411)
+            colorLayout(colorMode, pvt.nx, pvt.ny, &pvt.in);
+        colorLayout(colorModeOut, pvt.nx, pvt.ny, &pvt.out);
+        pvt.pIn = pArray->pData;
+        pvt.pOut = pArrayOut->pData;
+        runTiles(tileThreads, (int)pvt.ny, convertFunc, &pvt);
+        /* The edge-aware Bayer conversion needs all of green before it does red and blue */
+        if (pvt.kernel == kernelBayerGreen) {
+            pvt.kernel = kernelBayerRedBlue;
+            runTiles(tileThreads, (int)pvt.ny, convertFunc, &pvt);
+        }
+        changedColorMode = 1;
+    } else {
+        /* No conversion was done, the output is the input array unchanged so it shares the input buffer */
+        pArrayOut = this->pNDArrayPool->view(pArray);
+        if (!pArrayOut) pArrayOut = this->pNDArrayPool->copy(pArray, NULL, 1);
+    }
     this->lock();
+    if (!pArrayOut) {
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s:%s: error allocating output array\n",
+            driverName, functionName);
+        return;
+    }
     /* Get the attributes for this plugin */
     this->getAttributes(pArrayOut->pAttributeList);
     /* If we changed the color mode then set the attribute */
@@ -538,36 +712,12 @@ void NDPluginColorConvert::processCallbacks(NDArray *pArray)
               "%s:%s: dataType=%d\n",
               driverName, functionName, pArray->dataType);
 
-    switch (pArray->dataType) {
-        case NDInt8:
-            this->convertColor<epicsInt8>(pArray);
-            break;
-        case NDUInt8:
-            this->convertColor<epicsUInt8>(pArray);
-            break;
-        case NDInt16:
-            this->convertColor<epicsInt16>(pArray);
-            break;
-        case NDUInt16:
-            this->convertColor<epicsUInt16>(pArray);
-            break;
-       case NDInt32:
-            this->convertColor<epicsInt32>(pArray);
-            break;
-        case NDUInt32:
-            this->convertColor<epicsUInt32>(pArray);
-            break;
-        case NDFloat32:
-            this->convertColor<epicsFloat32>(pArray);
-            break;
-        case NDFloat64:
-            this->convertColor<epicsFloat64>(pArray);
-            break;
-        default:
-            asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR, 
-                      "%s:%s: ERROR: unknown data type=%d\n",
-                      driverName, functionName, pArray->dataType);
-            break;
+    if (convertRowsFunc(pArray->dataType)) {
+        this->convertColor(pArray);
+    } else {
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR, 
+                  "%s:%s: ERROR: unknown data type=%d\n",
+                  driverName, functionName, pArray->dataType);
     }
    
     callParamCallbacks();
@@ -609,11 +759,15 @@ NDPluginColorConvert::NDPluginColorConvert(const char *portName, int queueSize,
 
     createParam(NDPluginColorConvertColorModeOutString, asynParamInt32, &NDPluginColorConvertColorModeOut);
     createParam(NDPluginColorConvertFalseColorString,   asynParamInt32, &NDPluginColorConvertFalseColor);    
+    createParam(NDPluginColorConvertBayerMethodString,  asynParamInt32, &NDPluginColorConvertBayerMethod);
+    createParam(NDPluginColorConvertTileThreadsString,  asynParamInt32, &NDPluginColorConvertTileThreads);
 
     /* Set the plugin type string */    
     setStringParam(NDPluginDriverPluginType, "NDPluginColorConvert");
     
     setIntegerParam(NDPluginColorConvertColorModeOut, NDColorModeMono);
+    setIntegerParam(NDPluginColorConvertBayerMethod, NDColorConvertBayerBilinear);
+    setIntegerParam(NDPluginColorConvertTileThreads, 1);
 
     // Enable ArrayCallbacks.  
     // This plugin currently ignores this setting and always does callbacks, so make the setting reflect the behavior
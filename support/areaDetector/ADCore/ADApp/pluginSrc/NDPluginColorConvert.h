@@ -7,6 +7,16 @@
 
 #define NDPluginColorConvertColorModeOutString  "COLOR_MODE_OUT" /* (NDColorMode_t r/w) Output color mode */
 #define NDPluginColorConvertFalseColorString    "FALSE_COLOR"    /* (NDColorMode_t r/w) Output color mode */
+#define NDPluginColorConvertBayerMethodString   "BAYER_METHOD"   /* (NDColorConvertBayerMethod_t r/w) Bayer demosaic algorithm */
+#define NDPluginColorConvertTileThreadsString   "TILE_THREADS"   /* (asynInt32 r/w) Number of threads converting each array */
+
+/** Algorithms used to convert Bayer arrays to RGB */
+typedef enum {
+    NDColorConvertBayerNearest,     /**< Each color is taken from the nearest pixel of that color in the 2x2 cell */
+    NDColorConvertBayerBilinear,    /**< Missing colors are the average of the 2 or 4 nearest pixels of that color */
+    NDColorConvertBayerEdgeAware    /**< Green is interpolated along the direction of the smaller gradient,
+                                      *  red and blue by interpolating the color differences to green */
+} NDColorConvertBayerMethod_t;
 
 /** Convert NDArrays from one NDColorMode to another.
   * This plugin is as source of NDArray callbacks, passing the (possibly converted) NDArray
@@ -15,14 +25,16 @@
   * <ul>
   *  <li> Mono to RGB1, RGB2 or RGB3 </li>
   *  <li> RGB1, RGB2 or RGB3 to mono</li>
-  *  <li> Bayer color to RGB1, RGB2 or RGB3 (Windows and Linux only)</li>
+  *  <li> Bayer color to RGB1, RGB2 or RGB3, with the demosaic algorithm selected by BAYER_METHOD</li>
+  *  <li> YUV444, YUV422 or YUV411 8 bit data to mono, RGB1, RGB2 or RGB3</li>
   *  <li> RGB1 to RGB2 or RGB3 </li> 
   *  <li> RGB2 to RGB1 or RGB3 </li> 
   *  <li> RGB3 to RGB1 or RGB2 </li> 
   * </ul> 
   * It also applies a false color map if requested for 8 bit data  
   * If the conversion required by the input color mode and output color mode are not
-  * in this supported list then the NDArray is passed on without conversion. */
+  * in this supported list then the NDArray is passed on without conversion.
+  * The rows of each array are converted by TILE_THREADS threads. */
 class epicsShareClass NDPluginColorConvert : public NDPluginDriver {
 public:
     NDPluginColorConvert(const char *portName, int queueSize, int blockingCallbacks, 
@@ -37,10 +49,12 @@ protected:
     int NDPluginColorConvertColorModeOut;
     #define FIRST_NDPLUGIN_COLOR_CONVERT_PARAM NDPluginColorConvertColorModeOut
     int NDPluginColorConvertFalseColor;    
+    int NDPluginColorConvertBayerMethod;
+    int NDPluginColorConvertTileThreads;
 
 private:
     /* These methods are just for this class */
-    template <typename epicsType> void convertColor(NDArray *pArray);
+    void convertColor(NDArray *pArray);
 };
  
 #endif
@@ -13,7 +13,10 @@
 #include <stdio.h>
 #include <errno.h>
 
+#include <vector>
+
 #include <epicsTypes.h>
+#include <epicsAtomic.h>
 #include <epicsMessageQueue.h>
 #include <epicsThread.h>
 #include <epicsEvent.h>
@@ -24,6 +27,7 @@
 
 #include <epicsExport.h>
 #include "NDPluginDriver.h"
+#include "NDPluginExecutor.h"
 
 typedef enum {
     ToThreadMessageData,
@@ -33,6 +37,7 @@ typedef enum {
 typedef struct {
     ToThreadMessageType_t messageType;
     NDArray *pArray;    
+    epicsTimeStamp queueTime;
 } ToThreadMessage_t;
 
 typedef enum {
@@ -94,12 +99,21 @@ NDPluginDriver::NDPluginDriver(const char *portName, int queueSize, int blocking
           interruptMask | asynInt32Mask | asynFloat64Mask | asynOctetMask | asynInt32ArrayMask,
           asynFlags, autoConnect, priority, stackSize),
     pPrevInputArray_(0),
+    compressionAware_(false),
     pluginStarted_(false),
     firstOutputArray_(true),
     pToThreadMsgQ_(NULL),
     pFromThreadMsgQ_(NULL),
+    pExecutor_(NULL),
+    numSubmitted_(0),
+    numExecuting_(0),
+    numQueued_(0),
+    meanExecutionUs_(0),
     prevUniqueId_(-1000),
-    sortingThreadId_(0)  
+    sortingThreadId_(0),
+    sortingWakeEvent_(NULL),
+    sortingDoneEvent_(NULL),
+    sortingExit_(false)
 {
     asynUser *pasynUser;
     //static const char *functionName = "NDPluginDriver";
@@ -109,6 +123,8 @@ NDPluginDriver::NDPluginDriver(const char *portName, int queueSize, int blocking
     /* Initialize some members to 0 */
     memset(&this->lastProcessTime_, 0, sizeof(this->lastProcessTime_));
     memset(&this->dimsPrev_, 0, sizeof(this->dimsPrev_));
+    memset(this->queueLatencyHist_, 0, sizeof(this->queueLatencyHist_));
+    memset(this->executionTimeHist_, 0, sizeof(this->executionTimeHist_));
     this->pasynGenericPointer_ = NULL;
     this->asynGenericPointerPvt_ = NULL;
     this->asynGenericPointerInterruptPvt_ = NULL;
@@ -141,6 +157,8 @@ NDPluginDriver::NDPluginDriver(const char *portName, int queueSize, int blocking
     createParam(NDPluginDriverProcessPluginString,     asynParamInt32, &NDPluginDriverProcessPlugin);
     createParam(NDPluginDriverExecutionTimeString,     asynParamFloat64, &NDPluginDriverExecutionTime);
     createParam(NDPluginDriverMinCallbackTimeString,   asynParamFloat64, &NDPluginDriverMinCallbackTime);
+    createParam(NDPluginDriverQueueLatencyHistString,  asynParamInt32Array, &NDPluginDriverQueueLatencyHist);
+    createParam(NDPluginDriverExecutionTimeHistString, asynParamInt32Array, &NDPluginDriverExecutionTimeHist);
 
     /* Here we set the values of read-only parameters and of read/write parameters that cannot
      * or should not get their values from the database.  Note that values set here will override
@@ -152,6 +170,7 @@ NDPluginDriver::NDPluginDriver(const char *portName, int queueSize, int blocking
     setIntegerParam(NDPluginDriverArrayAddr, NDArrayAddr);
     setIntegerParam(NDPluginDriverDroppedArrays, 0);
     setIntegerParam(NDPluginDriverDroppedOutputArrays, 0);
+    setIntegerParam(NDPluginDriverDisorderedArrays, 0);
     setIntegerParam(NDPluginDriverQueueSize, queueSize);
     setIntegerParam(NDPluginDriverQueueFree, queueSize);
     setIntegerParam(NDPluginDriverMaxThreads, maxThreads);
@@ -177,7 +196,52 @@ NDPluginDriver::~NDPluginDriver()
   // mutex must be unlocked before deleting it.
   this->lock();
   deleteCallbackThreads();
+  sortingExit_ = true;
   this->unlock();
+  if (sortingThreadId_) {
+    epicsEventSignal(sortingWakeEvent_);
+    epicsEventWait(sortingDoneEvent_);
+    epicsEventDestroy(sortingWakeEvent_);
+    epicsEventDestroy(sortingDoneEvent_);
+  }
+  while (!sortedNDArrayList_.empty()) {
+    sortedNDArrayList_.begin()->pArray_->release();
+    sortedNDArrayList_.erase(sortedNDArrayList_.begin());
+  }
+}
+
+typedef struct {
+    NDPluginTileFunc_t func;
+    void *pvt;
+} NDPluginTileArgs_t;
+
+static void pluginTile(void *pvt, size_t first, size_t count)
+{
+    NDPluginTileArgs_t *pArgs = (NDPluginTileArgs_t *)pvt;
+
+    pArgs->func(pArgs->pvt, (int)first, (int)count);
+}
+
+/** Divides items 0 to count-1 into numTiles tiles and calls func for each tile.
+  * Tile 0 is processed in the calling thread and the others by the EPICS shared thread pool
+  * (see NDArrayPool::runTiles()), and this method returns when all tiles are done.  If numTiles <= 1
+  * func is simply called for all items.  This method is normally called from processCallbacks()
+  * without the lock held.
+  * \param[in] numTiles The number of tiles.
+  * \param[in] count The number of items, e.g. rows of an array.
+  * \param[in] func The function that processes the items in one tile.
+  * \param[in] pvt Passed to func. */
+void NDPluginDriver::runTiles(int numTiles, int count, NDPluginTileFunc_t func, void *pvt)
+{
+    NDPluginTileArgs_t args;
+
+    if (numTiles <= 1) {
+        if (count > 0) func(pvt, 0, count);
+        return;
+    }
+    args.func = func;
+    args.pvt = pvt;
+    NDArrayPool::runTiles(numTiles, count, pluginTile, &args);
 }
 
 /** Method that is normally called at the beginning of the processCallbacks
@@ -277,25 +341,13 @@ asynStatus NDPluginDriver::endProcessCallbacks(NDArray *pArray, bool copyArray,
         return asynError;
     }
     if (callbacksSorted) {
-        int sortSize;
-        int listSize = (int)sortedNDArrayList_.size();
-        getIntegerParam(NDPluginDriverSortSize, &sortSize);
-        setIntegerParam(NDPluginDriverSortFree, sortSize-listSize);
-        if (listSize >= sortSize) {
-            int droppedOutputArrays;
-            getIntegerParam(NDPluginDriverDroppedOutputArrays, &droppedOutputArrays);
-            asynPrint(pasynUserSelf, ASYN_TRACE_WARNING, 
-                "%s::%s std::multilist size exceeded, dropped array uniqueId=%d\n",
-                driverName, functionName, pArrayOut->uniqueId);
-            droppedOutputArrays++;
-            setIntegerParam(NDPluginDriverDroppedOutputArrays, droppedOutputArrays);
-        } else {
-            epicsTimeStamp now;
-            epicsTimeGetCurrent(&now);
-            pArrayOut->reserve();
-            sortedListElement *pListElement = new sortedListElement(pArrayOut, now);
-            sortedNDArrayList_.insert(*pListElement);
-        }
+        /* Arrays that are in order are passed on at once.  The others wait in the list until the
+         * missing arrays arrive, until they have waited SortTime, or until the list has more than SortSize arrays. */
+        epicsTimeStamp now;
+        epicsTimeGetCurrent(&now);
+        pArrayOut->reserve();
+        sortedNDArrayList_.insert(sortedListElement(pArrayOut, now));
+        doSortedCallbacks();
     } else {
         doCallbacksGenericPointer(pArrayOut, NDArrayData, 0);
         bool orderOK = (pArrayOut->uniqueId == prevUniqueId_)   ||
@@ -354,6 +406,18 @@ void NDPluginDriver::driverCallback(asynUser *pasynUser, void *genericPointer)
     
     this->pNDArrayPool = pArray->pNDArrayPool;
 
+    if (!pArray->codec.name.empty() && !this->compressionAware_) {
+        /* This plugin would treat the compressed bytes as array data */
+        asynPrint(pasynUser, ASYN_TRACE_ERROR,
+            "%s::%s cannot process array uniqueId=%d compressed with codec %s, dropped\n",
+            driverName, functionName, pArray->uniqueId, pArray->codec.name.c_str());
+        getIntegerParam(NDPluginDriverDroppedArrays, &droppedArrays);
+        setIntegerParam(NDPluginDriverDroppedArrays, droppedArrays+1);
+        callParamCallbacks();
+        this->unlock();
+        return;
+    }
+
     if ((minCallbackTime == 0.) || (deltaTime > minCallbackTime)) {
         if (pasynUser->auxStatus == asynOverflow) ignoreQueueFull = true;
         pasynUser->auxStatus = asynSuccess;
@@ -369,16 +433,19 @@ void NDPluginDriver::driverCallback(asynUser *pasynUser, void *genericPointer)
         epicsTimeGetCurrent(&tNow);
         memcpy(&this->lastProcessTime_, &tNow, sizeof(tNow));
         if (blockingCallbacks) {
+            epicsAtomicIncrIntT(&numQueued_);
             processCallbacks(pArray);
             epicsTimeGetCurrent(&tEnd);
-            setDoubleParam(NDPluginDriverExecutionTime, epicsTimeDiffInSeconds(&tEnd, &tNow)*1e3);
+            deltaTime = epicsTimeDiffInSeconds(&tEnd, &tNow);
+            updateExecutionTime(deltaTime);
+            epicsAtomicDecrIntT(&numQueued_);
         } else {
             /* Increase the reference count again on this array
              * It will be released in the background task when processing is done */
             pArray->reserve();
             /* Try to put this array on the message queue.  If there is no room then return
              * immediately. */
-            ToThreadMessage_t msg = {ToThreadMessageData, pArray};
+            ToThreadMessage_t msg = {ToThreadMessageData, pArray, tNow};
             status = pToThreadMsgQ_->trySend(&msg, sizeof(msg));
             queueFree = queueSize - pToThreadMsgQ_->pending();
             setIntegerParam(NDPluginDriverQueueFree, queueFree);
@@ -395,7 +462,9 @@ void NDPluginDriver::driverCallback(asynUser *pasynUser, void *genericPointer)
                 /* This buffer needs to be released */
                 pArray->release();
             } else {
+                epicsAtomicIncrIntT(&numQueued_);
                 pArray->pDriver->incrementQueuedArrayCount();
+                if (pExecutor_) submitToExecutor();
             }
         }
     }
@@ -411,8 +480,6 @@ void NDPluginDriver::driverCallback(asynUser *pasynUser, void *genericPointer)
 void NDPluginDriver::processTask()
 {
     /* This thread processes a new array when it arrives */
-    int queueSize, queueFree;
-    epicsTimeStamp tStart, tEnd;
     int numBytes;
     int status;
     NDArray *pArray=0;
@@ -459,25 +526,125 @@ void NDPluginDriver::processTask()
         
         // Note: the lock must not be taken until after the thread exit logic above    
         this->lock();
-        epicsTimeGetCurrent(&tStart);
-        getIntegerParam(NDPluginDriverQueueSize, &queueSize);
-        queueFree = queueSize - pToThreadMsgQ_->pending();
-        setIntegerParam(NDPluginDriverQueueFree, queueFree);
-
-        /* Call the function that does the business of this callback.
-         * This function should release the lock during time-consuming operations,
-         * but of course it must not access any class data when the lock is released. */
-        processCallbacks(pArray); 
-        
-        epicsTimeGetCurrent(&tEnd);
-        setDoubleParam(NDPluginDriverExecutionTime, epicsTimeDiffInSeconds(&tEnd, &tStart)*1e3);
-        pArray->pDriver->decrementQueuedArrayCount();
-        callParamCallbacks();
-        /* We are done with this array buffer */
-        pArray->release();
+        processArray(pArray, &toMsg.queueTime);
+    }
+}
+
+/** Processes an array taken from the input queue, and releases it.
+  * This is called with the lock held, from processTask() or executorTask().
+  * \param[in] pArray The NDArray from the queue.
+  * \param[in] pQueueTime The time the array was put on the queue. */
+void NDPluginDriver::processArray(NDArray *pArray, const epicsTimeStamp *pQueueTime)
+{
+    int queueSize, queueFree;
+    epicsTimeStamp tStart, tEnd;
+    double execTime;
+
+    epicsTimeGetCurrent(&tStart);
+    getIntegerParam(NDPluginDriverQueueSize, &queueSize);
+    queueFree = queueSize - pToThreadMsgQ_->pending();
+    setIntegerParam(NDPluginDriverQueueFree, queueFree);
+    updateHistogram(this->queueLatencyHist_, epicsTimeDiffInSeconds(&tStart, pQueueTime));
+
+    /* Call the function that does the business of this callback.
+     * This function should release the lock during time-consuming operations,
+     * but of course it must not access any class data when the lock is released. */
+    processCallbacks(pArray); 
+    
+    epicsTimeGetCurrent(&tEnd);
+    execTime = epicsTimeDiffInSeconds(&tEnd, &tStart);
+    updateExecutionTime(execTime);
+    epicsAtomicDecrIntT(&numQueued_);
+    pArray->pDriver->decrementQueuedArrayCount();
+    callParamCallbacks();
+    /* We are done with this array buffer */
+    pArray->release();
+}
+
+/** Adds a time to one of the histograms; the bins are decades starting at 10 us. */
+void NDPluginDriver::updateHistogram(epicsInt32 *pHist, double seconds)
+{
+    double limit = 1e-5;
+    int bin = 0;
+
+    while ((bin < ND_PLUGIN_HIST_BINS-1) && (seconds >= limit)) {
+        limit *= 10;
+        bin++;
+    }
+    pHist[bin]++;
+}
+
+/** Updates the execution time, its histogram, and the mean execution time used by getLoad().
+  * This is called with the lock held. */
+void NDPluginDriver::updateExecutionTime(double seconds)
+{
+    int meanUs = this->meanExecutionUs_;
+    int us = (int)(seconds*1e6);
+
+    setDoubleParam(NDPluginDriverExecutionTime, seconds*1e3);
+    updateHistogram(this->executionTimeHist_, seconds);
+    /* Running mean over about the last 8 arrays */
+    meanUs = (meanUs == 0) ? us : meanUs + (us - meanUs)/8;
+    if (meanUs < 1) meanUs = 1;
+    epicsAtomicSetIntT(&this->meanExecutionUs_, meanUs);
+}
+
+/** Returns the NDPluginDriver that registered an NDArray callback, or NULL if the client is not a plugin.
+  * \param[in] callback The callback function of the asynGenericPointer interrupt client.
+  * \param[in] userPvt The userPvt of the asynGenericPointer interrupt client. */
+NDPluginDriver *NDPluginDriver::arrayClientPlugin(interruptCallbackGenericPointer callback, void *userPvt)
+{
+    if (callback != ::driverCallback) return NULL;
+    return (NDPluginDriver *)userPvt;
+}
+
+/** Returns the load of this plugin.  This does not take the lock, so it does not wait for a busy plugin.
+  * \param[out] pNumArrays The number of arrays in the queue or being processed.
+  * \param[out] pLatency The estimated time in seconds until a new array would be processed, from
+  *             the mean execution time of recent arrays.  This is 0 until an array has been processed. */
+void NDPluginDriver::getLoad(int *pNumArrays, double *pLatency)
+{
+    int numThreads = this->numThreads_;
+
+    if (numThreads < 1) numThreads = 1;
+    *pNumArrays = epicsAtomicGetIntT(&this->numQueued_);
+    *pLatency = (*pNumArrays/numThreads + 1) * epicsAtomicGetIntT(&this->meanExecutionUs_) * 1e-6;
+}
+
+/** Submits this plugin to the shared executor once for each queued array that no submission
+  * will take yet, while fewer than NumThreads arrays are submitted or being processed.
+  * With NumThreads=1 arrays are processed one at a time in the order they were queued.
+  * This is called with the lock held. */
+void NDPluginDriver::submitToExecutor()
+{
+    if (!this->pluginStarted_) return;
+    while ((numSubmitted_ + numExecuting_ < numThreads_) &&
+           (numSubmitted_ < (int)pToThreadMsgQ_->pending())) {
+        numSubmitted_++;
+        pExecutor_->submit(this);
     }
 }
 
+/** Called by a thread of the shared executor to process the next array from the input queue.
+  * This method should really be private, but it must be called from NDPluginExecutor, 
+  * so it must be public. */
+void NDPluginDriver::executorTask()
+{
+    ToThreadMessage_t toMsg;
+    int numBytes;
+
+    this->lock();
+    numSubmitted_--;
+    numBytes = pToThreadMsgQ_->tryReceive(&toMsg, sizeof(toMsg));
+    if (numBytes == sizeof(toMsg)) {
+        numExecuting_++;
+        processArray(toMsg.pArray, &toMsg.queueTime);
+        numExecuting_--;
+    }
+    submitToExecutor();
+    this->unlock();
+}
+
 /** Register or unregister to receive asynGenericPointer (NDArray) callbacks from the driver.
   * Note: this function must be called with the lock released, otherwise a deadlock can occur
   * in the call to cancelInterruptUser.
@@ -571,54 +738,68 @@ asynStatus NDPluginDriver::connectToArrayPort(void)
 void NDPluginDriver::sortingTask()
 {
     double sortTime;
-    epicsTimeStamp now;
-    int sortSize;
-    double deltaTime;
-    int listSize;
-    std::multiset<sortedListElement>::iterator pListElement;
-    static const char *functionName = "sortingTask";
 
     lock();
-    while (1) {
+    while (!sortingExit_) {
         getDoubleParam(NDPluginDriverSortTime, &sortTime);
         unlock();
-        epicsThreadSleep(sortTime);
+        epicsEventWaitWithTimeout(sortingWakeEvent_, sortTime);
         lock();
-        epicsTimeGetCurrent(&now);
-        getIntegerParam(NDPluginDriverSortSize, &sortSize);
-        while ((listSize=(int)sortedNDArrayList_.size()) > 0) {
-            bool orderOK;
-            pListElement = sortedNDArrayList_.begin();
-            deltaTime = epicsTimeDiffInSeconds(&now, &pListElement->insertionTime_);
-            asynPrint(pasynUserSelf, ASYN_TRACEIO_DRIVER, 
-                "%s::%s, deltaTime=%f, list size=%d, uniqueId=%d\n", 
-                driverName, functionName, deltaTime, listSize, pListElement->pArray_->uniqueId);            
-            orderOK = (pListElement->pArray_->uniqueId == prevUniqueId_)   ||
-                      (pListElement->pArray_->uniqueId == prevUniqueId_+1);
-            if ((!firstOutputArray_ && orderOK) || (deltaTime > sortTime)) {
-                doCallbacksGenericPointer(pListElement->pArray_, NDArrayData, 0);
-                if (!firstOutputArray_ && !orderOK) {
-                    int disorderedArrays;
-                    getIntegerParam(NDPluginDriverDisorderedArrays, &disorderedArrays);
-                    disorderedArrays++;
-                    setIntegerParam(NDPluginDriverDisorderedArrays, disorderedArrays);
-                    asynPrint(pasynUserSelf, ASYN_TRACE_WARNING, 
-                        "%s::%s disordered array found uniqueId=%d, prevUniqueId_=%d, orderOK=%d, disorderedArrays=%d\n",
-                        driverName, functionName, pListElement->pArray_->uniqueId, prevUniqueId_, 
-                        orderOK, disorderedArrays);
-                }
-                prevUniqueId_ = pListElement->pArray_->uniqueId;
-                pListElement->pArray_->release();
-                sortedNDArrayList_.erase(pListElement);
-                firstOutputArray_ = false;
-            } else  {
-                break;
+        if (!sortingExit_) doSortedCallbacks();
+    }
+    unlock();
+    epicsEventSignal(sortingDoneEvent_);
+}
+
+/** Does the callbacks for arrays at the start of the sorted list that are in order, that have been in the list
+  * for longer than SortTime, or that are more than SortSize arrays before the end of the list.
+  * The first array is not known to be in order, so it waits for SortTime or until the list is full.
+  * This is called with the lock held. */
+void NDPluginDriver::doSortedCallbacks()
+{
+    double sortTime;
+    epicsTimeStamp now;
+    int sortSize;
+    double deltaTime;
+    int listSize;
+    std::multiset<sortedListElement>::iterator pListElement;
+    static const char *functionName = "doSortedCallbacks";
+
+    getDoubleParam(NDPluginDriverSortTime, &sortTime);
+    getIntegerParam(NDPluginDriverSortSize, &sortSize);
+    epicsTimeGetCurrent(&now);
+    while ((listSize=(int)sortedNDArrayList_.size()) > 0) {
+        bool orderOK;
+        pListElement = sortedNDArrayList_.begin();
+        deltaTime = epicsTimeDiffInSeconds(&now, &pListElement->insertionTime_);
+        asynPrint(pasynUserSelf, ASYN_TRACEIO_DRIVER, 
+            "%s::%s, deltaTime=%f, list size=%d, uniqueId=%d\n", 
+            driverName, functionName, deltaTime, listSize, pListElement->pArray_->uniqueId);            
+        orderOK = (pListElement->pArray_->uniqueId == prevUniqueId_)   ||
+                  (pListElement->pArray_->uniqueId == prevUniqueId_+1);
+        if ((!firstOutputArray_ && orderOK) || (deltaTime > sortTime) || (listSize > sortSize)) {
+            doCallbacksGenericPointer(pListElement->pArray_, NDArrayData, 0);
+            if (!firstOutputArray_ && !orderOK) {
+                int disorderedArrays;
+                getIntegerParam(NDPluginDriverDisorderedArrays, &disorderedArrays);
+                disorderedArrays++;
+                setIntegerParam(NDPluginDriverDisorderedArrays, disorderedArrays);
+                asynPrint(pasynUserSelf, ASYN_TRACE_WARNING, 
+                    "%s::%s disordered array found uniqueId=%d, prevUniqueId_=%d, orderOK=%d, disorderedArrays=%d\n",
+                    driverName, functionName, pListElement->pArray_->uniqueId, prevUniqueId_, 
+                    orderOK, disorderedArrays);
             }
+            prevUniqueId_ = pListElement->pArray_->uniqueId;
+            pListElement->pArray_->release();
+            sortedNDArrayList_.erase(pListElement);
+            firstOutputArray_ = false;
+        } else  {
+            break;
         }
-        listSize=(int)sortedNDArrayList_.size();
-        setIntegerParam(NDPluginDriverSortFree, sortSize-listSize);
-        callParamCallbacks();
-    }    
+    }
+    listSize=(int)sortedNDArrayList_.size();
+    setIntegerParam(NDPluginDriverSortFree, sortSize-listSize);
+    callParamCallbacks();
 }
 
 /** Called when asyn clients call pasynInt32->write().
@@ -648,7 +829,7 @@ asynStatus NDPluginDriver::writeInt32(asynUser *pasynUser, epicsInt32 value)
 
     /* If blocking callbacks are being disabled but the callback threads have
      * not been created yet, create them here. */
-    if (function == NDPluginDriverBlockingCallbacks && !value && pThreads_.size() == 0) {
+    if (function == NDPluginDriverBlockingCallbacks && !value && !pToThreadMsgQ_) {
          createCallbackThreads();
      }
     
@@ -780,6 +961,13 @@ asynStatus NDPluginDriver::readInt32Array(asynUser *pasynUser, epicsInt32 *value
             if (nElements < ncopy) ncopy = nElements;
             memcpy(value, this->dimsPrev_, ncopy*sizeof(*this->dimsPrev_));
             *nIn = ncopy;
+    } else if ((function == NDPluginDriverQueueLatencyHist) ||
+               (function == NDPluginDriverExecutionTimeHist)) {
+        ncopy = ND_PLUGIN_HIST_BINS;
+        if (nElements < ncopy) ncopy = nElements;
+        memcpy(value, (function == NDPluginDriverQueueLatencyHist) ? 
+               this->queueLatencyHist_ : this->executionTimeHist_, ncopy*sizeof(*value));
+        *nIn = ncopy;
     } else {
         /* If this parameter belongs to a base class call its method */
         if (function < FIRST_NDPLUGIN_PARAM) 
@@ -803,6 +991,11 @@ asynStatus NDPluginDriver::start(void)
     //static const char *functionName = "start";
   
     this->pluginStarted_ = true;
+    // Arrays queued before start are submitted now
+    if (pExecutor_) {
+        submitToExecutor();
+        return asynSuccess;
+    }
     // If the plugin was started with BlockingCallbacks=Yes then pThreads_.size() will be 0
     if (pThreads_.size() == 0) return asynSuccess;
   
@@ -852,7 +1045,9 @@ void NDPluginDriver::run()
 }
 
 /** Creates the plugin threads.  
-  * This method is called when BlockingCallbacks is 0, and whenever QueueSize or NumThreads is changed. */ 
+  * This method is called when BlockingCallbacks is 0, and whenever QueueSize or NumThreads is changed.
+  * If the shared executor has been configured no threads are created, and up to NumThreads arrays are
+  * processed at once by the executor threads. */ 
 asynStatus NDPluginDriver::createCallbackThreads()
 {
     assert(this->pThreads_.size() == 0);
@@ -895,30 +1090,33 @@ asynStatus NDPluginDriver::createCallbackThreads()
         setIntegerParam(NDPluginDriverQueueSize, queueSize);
     }
   
-    pThreads_.resize(numThreads);
-
     /* Create the message queue for the input arrays */
     pToThreadMsgQ_ = new epicsMessageQueue(queueSize, sizeof(ToThreadMessage_t));
     if (!pToThreadMsgQ_) {
         /* We don't handle memory errors above, so no point in handling this. */
         cantProceed("NDPluginDriver::createCallbackThreads epicsMessageQueueCreate failure\n");
     }
-    pFromThreadMsgQ_ = new epicsMessageQueue(numThreads, sizeof(FromThreadMessage_t));
-    if (!pFromThreadMsgQ_) {
-        /* We don't handle memory errors above, so no point in handling this. */
-        cantProceed("NDPluginDriver::createCallbackThreads epicsMessageQueueCreate failure\n");
-    }
 
-    for (i=0; i<numThreads; i++) {
-        /* Create the thread (but not start). */
-        char taskName[256];
-        epicsSnprintf(taskName, sizeof(taskName)-1, "%s_Plugin_%d", portName, i+1);
-        pThreads_[i] = new epicsThread(*this, taskName, this->threadStackSize_, this->threadPriority_);
-    }
+    pExecutor_ = NDPluginExecutor::getInstance();
+    if (!pExecutor_) {
+        pThreads_.resize(numThreads);
+        pFromThreadMsgQ_ = new epicsMessageQueue(numThreads, sizeof(FromThreadMessage_t));
+        if (!pFromThreadMsgQ_) {
+            /* We don't handle memory errors above, so no point in handling this. */
+            cantProceed("NDPluginDriver::createCallbackThreads epicsMessageQueueCreate failure\n");
+        }
 
-    /* If start() was already run, we also need to start the threads. */
-    if (this->pluginStarted_) {
-        status |= startCallbackThreads();
+        for (i=0; i<numThreads; i++) {
+            /* Create the thread (but not start). */
+            char taskName[256];
+            epicsSnprintf(taskName, sizeof(taskName)-1, "%s_Plugin_%d", portName, i+1);
+            pThreads_[i] = new epicsThread(*this, taskName, this->threadStackSize_, this->threadPriority_);
+        }
+
+        /* If start() was already run, we also need to start the threads. */
+        if (this->pluginStarted_) {
+            status |= startCallbackThreads();
+        }
     }
     getIntegerParam(NDPluginDriverEnableCallbacks, &enableCallbacks);
     setIntegerParam(NDPluginDriverQueueFree, queueSize);
@@ -948,6 +1146,19 @@ asynStatus NDPluginDriver::deleteCallbackThreads()
                 driverName, functionName, pending);
             epicsThreadSleep(0.05);
         }
+        if (pExecutor_) {
+            // Wait for the executor to finish the arrays it took from the queue
+            this->lock();
+            while (numSubmitted_ + numExecuting_ > 0) {
+                this->unlock();
+                epicsThreadSleep(0.05);
+                this->lock();
+            }
+            delete pToThreadMsgQ_;
+            pToThreadMsgQ_ = 0;
+            pExecutor_ = 0;
+            return status;
+        }
         // Send a kill message to the threads and wait for reply.
         // Must do this with lock released else the threads may not be able to receive the message
         for (i=0; i<numThreads_; i++) {
@@ -1001,6 +1212,8 @@ asynStatus NDPluginDriver::createSortingThread()
     if (sortingThreadId_ != 0) return asynSuccess;
     
     /* Create the thread that outputs sorted NDArrays */
+    sortingWakeEvent_ = epicsEventMustCreate(epicsEventEmpty);
+    sortingDoneEvent_ = epicsEventMustCreate(epicsEventEmpty);
     epicsSnprintf(taskName, sizeof(taskName)-1, "%s_Plugin_Sort", portName);
     sortingThreadId_ = epicsThreadCreate(taskName,
                                          this->threadPriority_,
@@ -4,11 +4,17 @@
 #include <set>
 #include <epicsTypes.h>
 #include <epicsMessageQueue.h>
+#include <epicsEvent.h>
 #include <epicsThread.h>
 #include <epicsTime.h>
 
 #include "asynNDArrayDriver.h"
 
+class NDPluginExecutor;
+
+/** Function called by NDPluginDriver::runTiles() to process items first to first+count-1 */
+typedef void (*NDPluginTileFunc_t)(void *pvt, int first, int count);
+
 
 // This class defines the object that is contained in the std::multilist for sorting output NDArrays
 // It contains a pointer to the NDArray and the time that the object was added to the list
@@ -49,6 +55,13 @@ class sortedListElement {
 #define NDPluginDriverExecutionTimeString       "EXECUTION_TIME"        /**< (asynFloat64,  r/o) The last execution time (milliseconds) */
 #define NDPluginDriverMinCallbackTimeString     "MIN_CALLBACK_TIME"     /**< (asynFloat64,  r/w) Minimum time between calling processCallbacks 
                                                                          *  to execute plugin code */
+#define NDPluginDriverQueueLatencyHistString    "QUEUE_LATENCY_HIST"    /**< (asynInt32Array, r/o) Histogram of time arrays spent in the input queue */
+#define NDPluginDriverExecutionTimeHistString   "EXECUTION_TIME_HIST"   /**< (asynInt32Array, r/o) Histogram of execution times */
+
+/** Number of bins in the queue latency and execution time histograms.
+  * The bins are <10us, <100us, <1ms, <10ms, <100ms, <1s and >=1s. */
+#define ND_PLUGIN_HIST_BINS 7
+
 /** Class from which actual plugin drivers are derived; derived from asynNDArrayDriver */
 class epicsShareClass NDPluginDriver : public asynNDArrayDriver, public epicsThreadRunable {
 public:
@@ -70,6 +83,11 @@ public:
     virtual void run(void);
     virtual asynStatus start(void);
     void sortingTask();
+    void executorTask();
+
+    /* These are used by NDPluginScatter to choose which plugin to send an array to */
+    static NDPluginDriver *arrayClientPlugin(interruptCallbackGenericPointer callback, void *userPvt);
+    void getLoad(int *pNumArrays, double *pLatency);
 
 protected:
     virtual void processCallbacks(NDArray *pArray) = 0;
@@ -77,6 +95,7 @@ protected:
     virtual asynStatus endProcessCallbacks(NDArray *pArray, bool copyArray=false, bool readAttributes=true);
     virtual asynStatus connectToArrayPort(void);    
     virtual asynStatus setArrayInterrupt(int connect);
+    void runTiles(int numTiles, int count, NDPluginTileFunc_t func, void *pvt);
 
 protected:
     int NDPluginDriverArrayPort;
@@ -99,11 +118,19 @@ protected:
     int NDPluginDriverProcessPlugin;
     int NDPluginDriverExecutionTime;
     int NDPluginDriverMinCallbackTime;
+    int NDPluginDriverQueueLatencyHist;
+    int NDPluginDriverExecutionTimeHist;
 
     NDArray *pPrevInputArray_;
+    bool compressionAware_;     /**< Set by plugins that accept arrays with a codec; others drop them */
 
 private:
     void processTask();
+    void processArray(NDArray *pArray, const epicsTimeStamp *pQueueTime);
+    void updateHistogram(epicsInt32 *pHist, double seconds);
+    void updateExecutionTime(double seconds);
+    void doSortedCallbacks();
+    void submitToExecutor();
     asynStatus createCallbackThreads();
     asynStatus startCallbackThreads();
     asynStatus deleteCallbackThreads();
@@ -123,11 +150,21 @@ private:
     std::vector<epicsThread*>pThreads_;
     epicsMessageQueue *pToThreadMsgQ_;
     epicsMessageQueue *pFromThreadMsgQ_;
+    NDPluginExecutor *pExecutor_;                /**< Shared executor, if used instead of pThreads_ */
+    int numSubmitted_;                           /**< Submissions to pExecutor_ that have not yet taken an array */
+    int numExecuting_;                           /**< Arrays taken from the queue and being processed by pExecutor_ */
+    int numQueued_;                              /**< Arrays queued or being processed; read without the lock */
+    int meanExecutionUs_;                        /**< Mean execution time in microseconds; read without the lock */
     std::multiset<sortedListElement> sortedNDArrayList_;
     int prevUniqueId_;
     epicsThreadId sortingThreadId_;
+    epicsEventId sortingWakeEvent_;              /**< Signalled to stop the sorting thread */
+    epicsEventId sortingDoneEvent_;              /**< Signalled by the sorting thread when it exits */
+    bool sortingExit_;
     epicsTimeStamp lastProcessTime_;
     int dimsPrev_[ND_ARRAY_MAX_DIMS];
+    epicsInt32 queueLatencyHist_[ND_PLUGIN_HIST_BINS];
+    epicsInt32 executionTimeHist_[ND_PLUGIN_HIST_BINS];
 };
 
     
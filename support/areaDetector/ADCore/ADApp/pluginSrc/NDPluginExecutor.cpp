@@ -0,0 +1,276 @@
+/*
+ * NDPluginExecutor.cpp
+ *
+ * Shared pool of threads that execute the callbacks of non-blocking plugins.
+ *
+ * Each worker owns a queue of plugins that have arrays to process.  A worker takes plugins from
+ * the front of its own queue, and when that is empty steals from the front of the other workers'
+ * queues.  Plugins submitted from a worker thread, e.g. by a downstream plugin called from
+ * endProcessCallbacks(), go on that worker's own queue so the array is likely still in its cache.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <deque>
+
+#include <epicsAtomic.h>
+#include <epicsEvent.h>
+#include <epicsMutex.h>
+#include <epicsStdio.h>
+#include <epicsThread.h>
+#include <iocsh.h>
+
+#include <epicsExport.h>
+#include "NDPluginDriver.h"
+#include "NDPluginExecutor.h"
+
+struct NDPluginExecutorWorker {
+    NDPluginExecutor *pExecutor;
+    int index;
+    epicsMutexId lock;                  /**< Protects jobs */
+    std::deque<NDPluginDriver *> jobs;
+    epicsEventId wakeup;
+    epicsEventId exited;
+    size_t executed;                    /**< epicsAtomic */
+    size_t stolen;                      /**< epicsAtomic */
+};
+
+NDPluginExecutor *NDPluginExecutor::pInstance_ = 0;
+
+extern "C" {static void workerTaskC(void *drvPvt)
+{
+    NDPluginExecutorWorker *pWorker = (NDPluginExecutorWorker *)drvPvt;
+
+    pWorker->pExecutor->workerTask(pWorker);
+}}
+
+/** Returns the executor, or NULL if NDPluginExecutorConfig has not been called. */
+NDPluginExecutor *NDPluginExecutor::getInstance()
+{
+    return pInstance_;
+}
+
+/** Creates the executor.  Plugins created after this use it instead of their own threads.
+  * \param[in] numThreads The number of worker threads.
+  * \param[in] priority The worker thread priority; 0 for epicsThreadPriorityMedium.
+  * \param[in] stackSize The worker thread stack size; 0 for epicsThreadStackMedium. */
+int NDPluginExecutor::configure(int numThreads, int priority, int stackSize)
+{
+    if (pInstance_) {
+        printf("NDPluginExecutorConfig: executor already configured with %d threads\n",
+               pInstance_->getNumThreads());
+        return -1;
+    }
+    if (numThreads < 1) {
+        printf("NDPluginExecutorConfig: numThreads=%d must be >= 1\n", numThreads);
+        return -1;
+    }
+    if (priority <= 0) priority = epicsThreadPriorityMedium;
+    if (stackSize <= 0) stackSize = epicsThreadGetStackSize(epicsThreadStackMedium);
+    pInstance_ = new NDPluginExecutor(numThreads, priority, stackSize);
+    return 0;
+}
+
+/** Stops the worker threads and deletes the executor, so plugins created afterwards use their own
+  * threads again.  All the plugins created while the executor was configured must have been deleted
+  * first.  This is intended for tests; IOCs keep the executor until they exit. */
+void NDPluginExecutor::shutdown()
+{
+    if (!pInstance_) return;
+    delete pInstance_;
+    pInstance_ = 0;
+}
+
+NDPluginExecutor::NDPluginExecutor(int numThreads, int priority, int stackSize)
+    : pending_(0), nextWorker_(0), exiting_(0)
+{
+    int i;
+
+    idleLock_ = epicsMutexMustCreate();
+    workerId_ = epicsThreadPrivateCreate();
+    workers_.resize(numThreads);
+    for (i=0; i<numThreads; i++) {
+        NDPluginExecutorWorker *pWorker = new NDPluginExecutorWorker;
+        pWorker->pExecutor = this;
+        pWorker->index = i;
+        pWorker->lock = epicsMutexMustCreate();
+        pWorker->wakeup = epicsEventMustCreate(epicsEventEmpty);
+        pWorker->exited = epicsEventMustCreate(epicsEventEmpty);
+        pWorker->executed = 0;
+        pWorker->stolen = 0;
+        workers_[i] = pWorker;
+    }
+    for (i=0; i<numThreads; i++) {
+        char taskName[32];
+        epicsSnprintf(taskName, sizeof(taskName)-1, "NDExecutor_%d", i+1);
+        epicsThreadMustCreate(taskName, priority, stackSize, workerTaskC, workers_[i]);
+    }
+}
+
+NDPluginExecutor::~NDPluginExecutor()
+{
+    size_t i;
+
+    // Each worker sees exiting_ when it next wakes up
+    epicsAtomicSetIntT(&exiting_, 1);
+    for (i=0; i<workers_.size(); i++) {
+        epicsEventMustTrigger(workers_[i]->wakeup);
+        epicsEventMustWait(workers_[i]->exited);
+    }
+    for (i=0; i<workers_.size(); i++) {
+        epicsEventDestroy(workers_[i]->wakeup);
+        epicsEventDestroy(workers_[i]->exited);
+        epicsMutexDestroy(workers_[i]->lock);
+        delete workers_[i];
+    }
+    epicsMutexDestroy(idleLock_);
+    epicsThreadPrivateDelete(workerId_);
+}
+
+int NDPluginExecutor::getNumThreads()
+{
+    return (int)workers_.size();
+}
+
+/** Queues a plugin to process the next array in its input queue.
+  * The plugin calls this with its own lock held; the executor never calls a plugin
+  * with any of its own locks held. */
+void NDPluginExecutor::submit(NDPluginDriver *pPlugin)
+{
+    NDPluginExecutorWorker *pWorker = (NDPluginExecutorWorker *)epicsThreadPrivateGet(workerId_);
+    NDPluginExecutorWorker *pIdle = 0;
+
+    if (!pWorker) {
+        int next = epicsAtomicIncrIntT(&nextWorker_);
+        pWorker = workers_[(unsigned int)next % workers_.size()];
+    }
+    epicsMutexMustLock(pWorker->lock);
+    pWorker->jobs.push_back(pPlugin);
+    epicsMutexUnlock(pWorker->lock);
+    epicsAtomicIncrIntT(&pending_);
+
+    // Wake an idle worker; it takes the plugin from our queue if it is not its own
+    epicsMutexMustLock(idleLock_);
+    if (!idle_.empty()) {
+        pIdle = idle_.back();
+        idle_.pop_back();
+    }
+    epicsMutexUnlock(idleLock_);
+    if (pIdle) epicsEventMustTrigger(pIdle->wakeup);
+}
+
+/** Takes the next plugin from the worker's own queue, or steals one from another worker. */
+NDPluginDriver *NDPluginExecutor::take(NDPluginExecutorWorker *pWorker)
+{
+    NDPluginDriver *pPlugin = 0;
+    size_t numWorkers = workers_.size();
+    size_t i;
+
+    for (i=0; i<numWorkers && !pPlugin; i++) {
+        NDPluginExecutorWorker *pVictim = workers_[(pWorker->index + i) % numWorkers];
+        epicsMutexMustLock(pVictim->lock);
+        if (!pVictim->jobs.empty()) {
+            pPlugin = pVictim->jobs.front();
+            pVictim->jobs.pop_front();
+        }
+        epicsMutexUnlock(pVictim->lock);
+        if (pPlugin && i > 0) epicsAtomicIncrSizeT(&pWorker->stolen);
+    }
+    if (pPlugin) epicsAtomicDecrIntT(&pending_);
+    return pPlugin;
+}
+
+/** Worker thread; this should really be private, but it must be called from a
+  * C-linkage thread function, so it must be public. */
+void NDPluginExecutor::workerTask(NDPluginExecutorWorker *pWorker)
+{
+    epicsThreadPrivateSet(workerId_, pWorker);
+    while (!epicsAtomicGetIntT(&exiting_)) {
+        NDPluginDriver *pPlugin = take(pWorker);
+        if (pPlugin) {
+            pPlugin->executorTask();
+            epicsAtomicIncrSizeT(&pWorker->executed);
+            continue;
+        }
+        // submit() increments pending_ before checking idle_, so either we see the
+        // new plugin here or submit() sees us in idle_ and wakes us
+        epicsMutexMustLock(idleLock_);
+        if (epicsAtomicGetIntT(&pending_) > 0) {
+            epicsMutexUnlock(idleLock_);
+            continue;
+        }
+        idle_.push_back(pWorker);
+        epicsMutexUnlock(idleLock_);
+        epicsEventMustWait(pWorker->wakeup);
+    }
+    epicsEventSignal(pWorker->exited);
+}
+
+void NDPluginExecutor::report(FILE *fp, int details)
+{
+    size_t i;
+
+    fprintf(fp, "NDPluginExecutor: %d threads, %d plugins queued\n",
+            getNumThreads(), epicsAtomicGetIntT(&pending_));
+    if (details < 1) return;
+    for (i=0; i<workers_.size(); i++) {
+        NDPluginExecutorWorker *pWorker = workers_[i];
+        size_t queued;
+        epicsMutexMustLock(pWorker->lock);
+        queued = pWorker->jobs.size();
+        epicsMutexUnlock(pWorker->lock);
+        fprintf(fp, "  Worker %d: queued=%d, executed=%lu, stolen=%lu\n",
+                pWorker->index+1, (int)queued,
+                (unsigned long)epicsAtomicGetSizeT(&pWorker->executed),
+                (unsigned long)epicsAtomicGetSizeT(&pWorker->stolen));
+    }
+}
+
+/** Configuration command */
+extern "C" int NDPluginExecutorConfig(int numThreads, int priority, int stackSize)
+{
+    return NDPluginExecutor::configure(numThreads, priority, stackSize);
+}
+
+extern "C" int NDPluginExecutorReport(int details)
+{
+    NDPluginExecutor *pExecutor = NDPluginExecutor::getInstance();
+
+    if (!pExecutor) {
+        printf("NDPluginExecutor: not configured, plugins use their own threads\n");
+        return 0;
+    }
+    pExecutor->report(stdout, details);
+    return 0;
+}
+
+/* EPICS iocsh shell commands */
+static const iocshArg configArg0 = { "numThreads",iocshArgInt};
+static const iocshArg configArg1 = { "priority",iocshArgInt};
+static const iocshArg configArg2 = { "stackSize",iocshArgInt};
+static const iocshArg * const configArgs[] = {&configArg0,
+                                              &configArg1,
+                                              &configArg2};
+static const iocshFuncDef configFuncDef = {"NDPluginExecutorConfig",3,configArgs};
+static void configCallFunc(const iocshArgBuf *args)
+{
+    NDPluginExecutorConfig(args[0].ival, args[1].ival, args[2].ival);
+}
+
+static const iocshArg reportArg0 = { "details",iocshArgInt};
+static const iocshArg * const reportArgs[] = {&reportArg0};
+static const iocshFuncDef reportFuncDef = {"NDPluginExecutorReport",1,reportArgs};
+static void reportCallFunc(const iocshArgBuf *args)
+{
+    NDPluginExecutorReport(args[0].ival);
+}
+
+extern "C" void NDPluginExecutorRegister(void)
+{
+    iocshRegister(&configFuncDef,configCallFunc);
+    iocshRegister(&reportFuncDef,reportCallFunc);
+}
+
+extern "C" {
+epicsExportRegistrar(NDPluginExecutorRegister);
+}
@@ -0,0 +1,45 @@
+#ifndef NDPluginExecutor_H
+#define NDPluginExecutor_H
+
+#include <stdio.h>
+#include <vector>
+
+#include <epicsMutex.h>
+#include <epicsThread.h>
+#include <shareLib.h>
+
+class NDPluginDriver;
+struct NDPluginExecutorWorker;
+
+/** IOC-wide pool of threads that execute the callbacks of non-blocking plugins.
+  * If it has been configured with NDPluginExecutorConfig before the plugins are created, plugins do
+  * not create their own callback threads. Each plugin still queues arrays in its own input queue,
+  * and submits itself to the executor when it has arrays pending and fewer than NumThreads
+  * arrays being processed. Each worker has its own queue of submitted plugins; idle workers
+  * steal plugins from the queues of busy workers. */
+class epicsShareClass NDPluginExecutor {
+public:
+    static NDPluginExecutor *getInstance();
+    static int configure(int numThreads, int priority, int stackSize);
+    static void shutdown();
+    void submit(NDPluginDriver *pPlugin);
+    int getNumThreads();
+    void report(FILE *fp, int details);
+    void workerTask(NDPluginExecutorWorker *pWorker);
+
+private:
+    NDPluginExecutor(int numThreads, int priority, int stackSize);
+    ~NDPluginExecutor();
+    NDPluginDriver *take(NDPluginExecutorWorker *pWorker);
+
+    static NDPluginExecutor *pInstance_;
+    std::vector<NDPluginExecutorWorker *> workers_;
+    epicsMutexId idleLock_;                  /**< Protects idle_ */
+    std::vector<NDPluginExecutorWorker *> idle_;
+    int pending_;                            /**< Submitted plugins not yet taken, epicsAtomic */
+    int nextWorker_;                         /**< Round robin index for submissions from non-worker threads */
+    int exiting_;                            /**< Set by shutdown(), epicsAtomic */
+    epicsThreadPrivateId workerId_;
+};
+
+#endif
@@ -26,10 +26,14 @@
 #include <epicsExport.h>
 
 #include "NDPluginFFT.h"
-#include "fft.h"
 
 #define MIN(A,B) ((A <= B) ? A : B)
 
+/* Some systems do not define M_PI in math.h */
+#ifndef M_PI
+  #define M_PI 3.14159265358979323846
+#endif
+
 //static const char *driverName = "NDPluginFFT";
 
 /** Constructor for NDPluginFFT; most parameters are simply passed to NDPluginDriver::NDPluginDriver.
@@ -60,7 +64,8 @@ NDPluginFFT::NDPluginFFT(const char *portName, int queueSize, int blockingCallba
              asynFloat64Mask | asynFloat64ArrayMask | asynGenericPointerMask,
              asynFloat64Mask | asynFloat64ArrayMask | asynGenericPointerMask,
              0, 1, priority, stackSize, maxThreads),
-    numAverage_(0), uniqueId_(0), nTimeXIn_(0), nTimeYIn_(0), FFTAbsValue_(0), timePerPoint_(0), timeAxis_(0), freqAxis_(0)
+    numAverage_(0), uniqueId_(0), nTimeXIn_(0), nTimeYIn_(0), FFTAbsValue_(0), timePerPoint_(0), timeAxis_(0), freqAxis_(0),
+    cacheUseCount_(0)
 {
   //const char *functionName = "NDPluginFFT::NDPluginFFT";
 
@@ -77,6 +82,10 @@ NDPluginFFT::NDPluginFFT(const char *portName, int queueSize, int blockingCallba
   createParam(FFTRealString,             asynParamFloat64Array, &P_FFTReal);
   createParam(FFTImaginaryString,        asynParamFloat64Array, &P_FFTImaginary);
   createParam(FFTAbsValueString,         asynParamFloat64Array, &P_FFTAbsValue);
+  createParam(FFTWindowString,                  asynParamInt32, &P_FFTWindow);
+  createParam(FFTRowThreadsString,              asynParamInt32, &P_FFTRowThreads);
+  setIntegerParam(P_FFTWindow, FFTWindowNone);
+  setIntegerParam(P_FFTRowThreads, 1);
  
   /* Set the plugin type string */
   setStringParam(NDPluginDriverPluginType, "NDPluginFFT");
@@ -88,23 +97,136 @@ NDPluginFFT::NDPluginFFT(const char *portName, int queueSize, int blockingCallba
   
 }
 
-int NDPluginFFT::nextPow2(int v)
+NDPluginFFT::~NDPluginFFT()
+{
+  size_t i;
+
+  for (i=0; i<floatPlans_.size(); i++) delete floatPlans_[i].pPlan;
+  for (i=0; i<doublePlans_.size(); i++) delete doublePlans_[i].pPlan;
+  for (i=0; i<windows_.size(); i++) free(windows_[i].values);
+  free(FFTAbsValue_);
+  free(timeAxis_);
+  free(freqAxis_);
+}
+
+/** Returns the plan for an FFT of this size, creating it the first time.  The caller must pass it to
+  * releasePlan() when it has finished with it.  Called with the lock held. */
+template <typename fftType>
+NDFFTPlan<fftType> *NDPluginFFT::getPlan(std::vector<fftPlanEntry<fftType> > &plans, int size, bool real)
 {
-  v--;
-  v |= v >> 1;
-  v |= v >> 2;
-  v |= v >> 4;
-  v |= v >> 8;
-  v |= v >> 16;
-  v++;
-  return v;
+  fftPlanEntry<fftType> entry;
+  size_t i, oldest = plans.size();
+
+  for (i=0; i<plans.size(); i++) {
+    if (((int)plans[i].pPlan->getSize() == size) && (plans[i].pPlan->isReal() == real)) {
+      plans[i].users++;
+      plans[i].lastUsed = ++cacheUseCount_;
+      return plans[i].pPlan;
+    }
+    if ((plans[i].users == 0) &&
+        ((oldest == plans.size()) || (plans[i].lastUsed < plans[oldest].lastUsed))) oldest = i;
+  }
+  if ((plans.size() >= FFT_MAX_CACHED) && (oldest < plans.size())) {
+    delete plans[oldest].pPlan;
+    plans.erase(plans.begin() + oldest);
+  }
+  entry.pPlan = new NDFFTPlan<fftType>(size, real);
+  entry.users = 1;
+  entry.lastUsed = ++cacheUseCount_;
+  plans.push_back(entry);
+  return entry.pPlan;
 }
 
-void NDPluginFFT::allocateArrays(fftPvt_t *pPvt, bool sizeChanged)
+/** Releases a plan returned by getPlan(); does nothing for NULL.  Called with the lock held. */
+template <typename fftType>
+void NDPluginFFT::releasePlan(std::vector<fftPlanEntry<fftType> > &plans, NDFFTPlan<fftType> *pPlan)
 {
-  // Round dimensions up to next power of 2
-  pPvt->nTimeX = nextPow2(pPvt->nTimeXIn);
-  pPvt->nTimeY = nextPow2(pPvt->nTimeYIn);
+  size_t i;
+
+  if (!pPlan) return;
+  for (i=0; i<plans.size(); i++) {
+    if (plans[i].pPlan == pPlan) {
+      plans[i].users--;
+      return;
+    }
+  }
+}
+
+/** Returns the window function for this size, creating it the first time, or NULL for no window.
+  * The window is scaled so that its average is 1, which leaves the amplitude of a sine wave unchanged.
+  * The caller must pass it to releaseWindow() when it has finished with it.  Called with the lock held. */
+const double *NDPluginFFT::getWindow(int window, int size)
+{
+  fftWindow_t newWindow;
+  double sum = 0;
+  size_t i, oldest = windows_.size();
+  int j;
+
+  if ((window <= FFTWindowNone) || (window > FFTWindowFlatTop) || (size < 1)) return 0;
+  for (i=0; i<windows_.size(); i++) {
+    if ((windows_[i].window == window) && (windows_[i].size == size)) {
+      windows_[i].users++;
+      windows_[i].lastUsed = ++cacheUseCount_;
+      return windows_[i].values;
+    }
+    if ((windows_[i].users == 0) &&
+        ((oldest == windows_.size()) || (windows_[i].lastUsed < windows_[oldest].lastUsed))) oldest = i;
+  }
+  if ((windows_.size() >= FFT_MAX_CACHED) && (oldest < windows_.size())) {
+    free(windows_[oldest].values);
+    windows_.erase(windows_.begin() + oldest);
+  }
+  newWindow.window = window;
+  newWindow.size = size;
+  newWindow.users = 1;
+  newWindow.lastUsed = ++cacheUseCount_;
+  newWindow.values = (double *)malloc(size * sizeof(double));
+  for (j=0; j<size; j++) {
+    double x = 2. * M_PI * j / size;
+    double w = 1.;
+    switch (window) {
+      case FFTWindowHann:
+        w = 0.5 - 0.5*cos(x);
+        break;
+      case FFTWindowHamming:
+        w = 0.54 - 0.46*cos(x);
+        break;
+      case FFTWindowBlackman:
+        w = 0.42 - 0.5*cos(x) + 0.08*cos(2*x);
+        break;
+      case FFTWindowFlatTop:
+        w = 0.21557895 - 0.41663158*cos(x) + 0.277263158*cos(2*x) - 0.083578947*cos(3*x) + 0.006947368*cos(4*x);
+        break;
+    }
+    newWindow.values[j] = w;
+    sum += w;
+  }
+  for (j=0; j<size; j++) {
+    newWindow.values[j] *= size / sum;
+  }
+  windows_.push_back(newWindow);
+  return newWindow.values;
+}
+
+/** Releases a window returned by getWindow(); does nothing for NULL.  Called with the lock held. */
+void NDPluginFFT::releaseWindow(const double *values)
+{
+  size_t i;
+
+  if (!values) return;
+  for (i=0; i<windows_.size(); i++) {
+    if (windows_[i].values == values) {
+      windows_[i].users--;
+      return;
+    }
+  }
+}
+
+void NDPluginFFT::allocateArrays(fftPvt_t *pPvt, bool sizeChanged, bool useFloat)
+{
+  // Any size is allowed, there is no padding
+  pPvt->nTimeX = pPvt->nTimeXIn;
+  pPvt->nTimeY = pPvt->nTimeYIn;
 
   pPvt->nFreqX = pPvt->nTimeX / 2;
   pPvt->nFreqY = pPvt->nTimeY / 2;
@@ -112,8 +234,11 @@ void NDPluginFFT::allocateArrays(fftPvt_t *pPvt, bool sizeChanged)
 
   size_t timeSize = pPvt->nTimeX * pPvt->nTimeY;
   size_t freqSize = pPvt->nFreqX * pPvt->nFreqY;
+  size_t complexSize = (pPvt->nTimeX/2 + 1) * pPvt->nTimeY * 2;
+  size_t fftTypeSize = useFloat ? sizeof(epicsFloat32) : sizeof(epicsFloat64);
   pPvt->timeSeries   = (double *)calloc(timeSize, sizeof(double));
-  pPvt->FFTComplex   = (double *)calloc(timeSize, sizeof(double) * 2); // Complex data
+  pPvt->input        = calloc(timeSize, fftTypeSize);
+  pPvt->FFTComplex   = calloc(complexSize, fftTypeSize);
   pPvt->FFTReal      = (double *)calloc(freqSize, sizeof(double));
   pPvt->FFTImaginary = (double *)calloc(freqSize, sizeof(double));
   pPvt->FFTAbsValue  = (double *)calloc(freqSize, sizeof(double));
@@ -128,56 +253,93 @@ void NDPluginFFT::allocateArrays(fftPvt_t *pPvt, bool sizeChanged)
   }
 }
 
-void NDPluginFFT::computeFFT_1D(fftPvt_t *pPvt)
+template <typename fftType>
+struct fftBands_t {
+  NDFFTPlan<fftType> *pPlan;
+  const fftType *input;
+  fftType *spectrum;
+  int nTimeX;
+  int nTimeY;
+  int nComplexX;
+  int nFreqY;
+};
+
+/** Real FFTs of rows first to first+count-1 */
+template <typename fftType>
+static void fftRows(void *arg, int first, int count)
 {
-  int j;
+  fftBands_t<fftType> *pBands = (fftBands_t<fftType> *)arg;
+  std::vector<fftType> work(pBands->pPlan->getWorkSize() + 1);
+  int row;
 
-  for (j=0; j<pPvt->nTimeX; j++) {
-    pPvt->FFTComplex[2*j] = pPvt->timeSeries[j];
-    pPvt->FFTComplex[2*j+1] = 0.;
-  }
-  fft_1D(pPvt->FFTComplex, pPvt->nTimeX, 1);
-  for (j=0; j<pPvt->nFreqX; j++) {
-    pPvt->FFTReal     [j] = pPvt->FFTComplex[2*j]; 
-    pPvt->FFTImaginary[j] = pPvt->FFTComplex[2*j+1]; 
-    pPvt->FFTAbsValue [j] = sqrt((pPvt->FFTComplex[2*j]   * pPvt->FFTComplex[2*j] + 
-                            pPvt->FFTComplex[2*j+1] * pPvt->FFTComplex[2*j+1])) / pPvt->nTimeX;
+  for (row=first; row<first+count; row++) {
+    pBands->pPlan->forwardReal(pBands->input + (size_t)row*pBands->nTimeX,
+                               pBands->spectrum + (size_t)row*pBands->nComplexX*2, &work[0]);
   }
-  if (pPvt->suppressDC) {
-    pPvt->FFTReal      [0] = 0;
-    pPvt->FFTImaginary [0] = 0;
-    pPvt->FFTAbsValue  [0] = 0;
+}
+
+/** Complex FFTs of columns first to first+count-1 of the row FFTs; only the first nFreqY points are kept */
+template <typename fftType>
+static void fftColumns(void *arg, int first, int count)
+{
+  fftBands_t<fftType> *pBands = (fftBands_t<fftType> *)arg;
+  std::vector<fftType> work(pBands->pPlan->getWorkSize() + 1);
+  std::vector<fftType> column(2*pBands->nTimeY);
+  size_t stride = 2*pBands->nComplexX;
+  int col, row;
+
+  for (col=first; col<first+count; col++) {
+    fftType *pIn = pBands->spectrum + 2*col;
+    for (row=0; row<pBands->nTimeY; row++) {
+      column[2*row]   = pIn[row*stride];
+      column[2*row+1] = pIn[row*stride + 1];
+    }
+    pBands->pPlan->forward(&column[0], &work[0]);
+    for (row=0; row<pBands->nFreqY; row++) {
+      pIn[row*stride]     = column[2*row];
+      pIn[row*stride + 1] = column[2*row+1];
+    }
   }
-}         
+}
 
-void NDPluginFFT::computeFFT_2D(fftPvt_t *pPvt)
+/** Computes the 1-D FFT, or the 2-D FFT as FFTs of the rows followed by FFTs of the columns.
+  * The real input means only the first nTimeX/2+1 columns need to be computed, and only the
+  * first nFreqX columns are transformed in the second pass.  The rows and columns are divided
+  * between RowThreads threads. */
+template <typename fftType>
+void NDPluginFFT::computeFFT(fftPvt_t *pPvt, NDFFTPlan<fftType> *pPlanX, NDFFTPlan<fftType> *pPlanY)
 {
-  int i,j, k;
-  double *pIn;
-  unsigned long dims[2];
- 
-  for (j=0; j<pPvt->nTimeX*pPvt->nTimeY; j++) {
-    pPvt->FFTComplex[2*j] = pPvt->timeSeries[j];
-    pPvt->FFTComplex[2*j+1] = 0.;
+  fftBands_t<fftType> bands;
+  fftType *spectrum = (fftType *)pPvt->FFTComplex;
+  double scale = 1. / ((double)pPvt->nTimeX * pPvt->nTimeY);
+  int i, j, k;
+
+  bands.pPlan = pPlanX;
+  bands.input = (const fftType *)pPvt->input;
+  bands.spectrum = spectrum;
+  bands.nTimeX = pPvt->nTimeX;
+  bands.nTimeY = pPvt->nTimeY;
+  bands.nComplexX = pPvt->nTimeX/2 + 1;
+  bands.nFreqY = pPvt->nFreqY;
+  runTiles(pPvt->rowThreads, pPvt->nTimeY, fftRows<fftType>, &bands);
+  if (pPvt->rank == 2) {
+    bands.pPlan = pPlanY;
+    runTiles(pPvt->rowThreads, pPvt->nFreqX, fftColumns<fftType>, &bands);
   }
-  dims[0] = pPvt->nTimeX;
-  dims[1] = pPvt->nTimeY;
-  fft_ND(pPvt->FFTComplex, dims, 2, 1);
-  for (i=0, k=0, pIn=pPvt->FFTComplex; 
-       i<pPvt->nFreqY; 
-       i++, pIn+=pPvt->nTimeX*2) {
+  for (i=0, k=0; i<pPvt->nFreqY; i++) {
+    const fftType *pIn = spectrum + (size_t)i*bands.nComplexX*2;
     for (j=0; j<pPvt->nFreqX; j++, k++) {
-      pPvt->FFTReal     [k] = pIn[j*2]; 
-      pPvt->FFTImaginary[k] = pIn[j*2+1]; 
-      pPvt->FFTAbsValue [k]= sqrt((pPvt->FFTReal[k] * pPvt->FFTReal[k]) + (pPvt->FFTImaginary[k] * pPvt->FFTImaginary[k])) / (pPvt->nTimeX * pPvt->nTimeY);
+      pPvt->FFTReal     [k] = pIn[2*j];
+      pPvt->FFTImaginary[k] = pIn[2*j+1];
+      pPvt->FFTAbsValue [k] = sqrt((pPvt->FFTReal[k] * pPvt->FFTReal[k]) + (pPvt->FFTImaginary[k] * pPvt->FFTImaginary[k])) * scale;
     }
   }
-  if (pPvt->suppressDC) {
+  if (pPvt->suppressDC && (pPvt->nFreqX > 0)) {
     pPvt->FFTReal      [0] = 0;
     pPvt->FFTImaginary [0] = 0;
     pPvt->FFTAbsValue  [0] = 0;
   }
-}         
+}
 
 void NDPluginFFT::doArrayCallbacks(fftPvt_t *pPvt)
 {
@@ -235,6 +397,7 @@ void NDPluginFFT::doArrayCallbacks(fftPvt_t *pPvt)
   doCallbacksFloat64Array(pPvt->FFTImaginary, pPvt->nFreqX, P_FFTImaginary,  0);
   doCallbacksFloat64Array(FFTAbsValue_,       MIN(pPvt->nFreqX, nFreqX_), P_FFTAbsValue,   0);
   free(pPvt->timeSeries);
+  free(pPvt->input);
   free(pPvt->FFTComplex);
   free(pPvt->FFTReal);
   free(pPvt->FFTImaginary);
@@ -264,25 +427,45 @@ void NDPluginFFT::createAxisArrays(fftPvt_t *pPvt)
 }
 
 /**
- * Templated function to copy the data from the NDArray into double arrays with padding.
+ * Templated function to copy the data from the NDArray into the time series, and into the FFT input
+ * with the window function applied.
  * \param[in] NDArray The pointer to the NDArray object
  */
-template <typename epicsType>
-void NDPluginFFT::convertToDoubleT(NDArray *pArray, fftPvt_t *pPvt)
+template <typename epicsType, typename fftType>
+void NDPluginFFT::convertT(NDArray *pArray, fftPvt_t *pPvt)
 {
-  epicsType *pIn;
-  double *pOut;
+  epicsType *pIn = (epicsType *)pArray->pData;
+  double *pTime = pPvt->timeSeries;
+  fftType *pOut = (fftType *)pPvt->input;
   int i, j;
-    
-  for (i=0, pIn=(epicsType *)pArray->pData, pOut=pPvt->timeSeries;
-       i<pPvt->nTimeYIn; 
-       i++, pOut+=pPvt->nTimeX) {
-    for (j=0; j<pPvt->nTimeXIn; j++) {
-      pOut[j] = (epicsFloat64)*pIn++;
+
+  for (i=0; i<pPvt->nTimeYIn; i++) {
+    double windowY = pPvt->windowY ? pPvt->windowY[i] : 1.;
+    if (pPvt->windowX) {
+      for (j=0; j<pPvt->nTimeXIn; j++) {
+        double value = (double)*pIn++;
+        *pTime++ = value;
+        *pOut++ = (fftType)(value * pPvt->windowX[j] * windowY);
+      }
+    } else {
+      for (j=0; j<pPvt->nTimeXIn; j++) {
+        double value = (double)*pIn++;
+        *pTime++ = value;
+        *pOut++ = (fftType)(value * windowY);
+      }
     }
   }
 }
 
+template <typename epicsType>
+void NDPluginFFT::convert(NDArray *pArray, fftPvt_t *pPvt)
+{
+  if (pPvt->pFloatPlanX)
+    convertT<epicsType, epicsFloat32>(pArray, pPvt);
+  else
+    convertT<epicsType, epicsFloat64>(pArray, pPvt);
+}
+
      
 /** 
  * Callback function that is called by the NDArray driver with new NDArray data.
@@ -295,8 +478,10 @@ void NDPluginFFT::processCallbacks(NDArray *pArray)
   //It unlocks it during long calculations when private structures don't need to be protected.
 
   double timePerPoint;
-  fftPvt_t *pPvt = new fftPvt_t;
+  fftPvt_t *pPvt = new fftPvt_t();
   bool sizeChanged = false;  
+  bool useFloat;
+  int window;
   const char* functionName = "NDPluginFFT::processCallbacks";
 
   /* Call the base class method */
@@ -318,6 +503,7 @@ void NDPluginFFT::processCallbacks(NDArray *pArray)
       asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
         "%s: error, number of array dimensions must be 1 or 2\n",
         functionName);
+      delete pPvt;
       return;
       break;
   }
@@ -330,8 +516,22 @@ void NDPluginFFT::processCallbacks(NDArray *pArray)
   }
 
   getIntegerParam(P_FFTSuppressDC, &pPvt->suppressDC);
+  getIntegerParam(P_FFTWindow, &window);
+  getIntegerParam(P_FFTRowThreads, &pPvt->rowThreads);
+
+  // Float32 arrays are transformed in single precision, other types in double precision
+  useFloat = (pArray->dataType == NDFloat32);
+  if (useFloat) {
+    pPvt->pFloatPlanX = getPlan(floatPlans_, pPvt->nTimeXIn, true);
+    if (pPvt->rank == 2) pPvt->pFloatPlanY = getPlan(floatPlans_, pPvt->nTimeYIn, false);
+  } else {
+    pPvt->pDoublePlanX = getPlan(doublePlans_, pPvt->nTimeXIn, true);
+    if (pPvt->rank == 2) pPvt->pDoublePlanY = getPlan(doublePlans_, pPvt->nTimeYIn, false);
+  }
+  pPvt->windowX = getWindow(window, pPvt->nTimeXIn);
+  if (pPvt->rank == 2) pPvt->windowY = getWindow(window, pPvt->nTimeYIn);
 
-  allocateArrays(pPvt, sizeChanged);
+  allocateArrays(pPvt, sizeChanged, useFloat);
   getDoubleParam(P_FFTTimePerPoint, &timePerPoint);
   if (timePerPoint != timePerPoint_) {
     timePerPoint_ = timePerPoint;
@@ -342,37 +542,45 @@ void NDPluginFFT::processCallbacks(NDArray *pArray)
   this->unlock();
   switch(pArray->dataType) {
   case NDInt8:
-    convertToDoubleT<epicsInt8>(pArray, pPvt);
+    convert<epicsInt8>(pArray, pPvt);
     break;
   case NDUInt8:
-    convertToDoubleT<epicsUInt8>(pArray, pPvt);
+    convert<epicsUInt8>(pArray, pPvt);
     break;
   case NDInt16:
-    convertToDoubleT<epicsInt16>(pArray, pPvt);
+    convert<epicsInt16>(pArray, pPvt);
     break;
   case NDUInt16:
-    convertToDoubleT<epicsUInt16>(pArray, pPvt);
+    convert<epicsUInt16>(pArray, pPvt);
     break;
   case NDInt32:
-    convertToDoubleT<epicsInt32>(pArray, pPvt);
+    convert<epicsInt32>(pArray, pPvt);
     break;
   case NDUInt32:
-    convertToDoubleT<epicsUInt32>(pArray, pPvt);
+    convert<epicsUInt32>(pArray, pPvt);
     break;
   case NDFloat32:
-    convertToDoubleT<epicsFloat32>(pArray, pPvt);
+    convert<epicsFloat32>(pArray, pPvt);
     break;
   case NDFloat64:
-    convertToDoubleT<epicsFloat64>(pArray, pPvt);
+    convert<epicsFloat64>(pArray, pPvt);
     break;
   default:
     break;
   }
-  if (pPvt->rank == 1) computeFFT_1D(pPvt);
-  if (pPvt->rank == 2) computeFFT_2D(pPvt);
+  if (useFloat)
+    computeFFT<epicsFloat32>(pPvt, pPvt->pFloatPlanX, pPvt->pFloatPlanY);
+  else
+    computeFFT<epicsFloat64>(pPvt, pPvt->pDoublePlanX, pPvt->pDoublePlanY);
 
   // Take the lock again
   this->lock();
+  releasePlan(floatPlans_, pPvt->pFloatPlanX);
+  releasePlan(floatPlans_, pPvt->pFloatPlanY);
+  releasePlan(doublePlans_, pPvt->pDoublePlanX);
+  releasePlan(doublePlans_, pPvt->pDoublePlanY);
+  releaseWindow(pPvt->windowX);
+  releaseWindow(pPvt->windowY);
   doArrayCallbacks(pPvt);
   delete pPvt;
   callParamCallbacks();
@@ -10,10 +10,13 @@
 #ifndef NDPluginFFT_H
 #define NDPluginFFT_H
 
+#include <vector>
+
 #include <epicsTypes.h>
 #include <epicsTime.h>
 
 #include "NDPluginDriver.h"
+#include "NDFFTPlan.h"
 
 #define FFTTimeAxisString        "FFT_TIME_AXIS"        /* (asynFloat64Array, r/o) Time axis array */
 #define FFTFreqAxisString        "FFT_FREQ_AXIS"        /* (asynFloat64Array, r/o) Frequency axis array */
@@ -27,6 +30,33 @@
 #define FFTRealString            "FFT_REAL"             /* (asynFloat64Array, r/o) Real part of FFT */
 #define FFTImaginaryString       "FFT_IMAGINARY"        /* (asynFloat64Array, r/o) Imaginary part of FFT */
 #define FFTAbsValueString        "FFT_ABS_VALUE"        /* (asynFloat64Array, r/o) Absolute value of FFT */
+#define FFTWindowString          "FFT_WINDOW"           /* (asynInt32,        r/w) Window function */
+#define FFTRowThreadsString      "FFT_ROW_THREADS"      /* (asynInt32,        r/w) Number of threads computing each array */
+
+typedef enum {
+  FFTWindowNone,
+  FFTWindowHann,
+  FFTWindowHamming,
+  FFTWindowBlackman,
+  FFTWindowFlatTop
+} NDFFTWindow_t;
+
+/* Plans and windows are kept for at most this many sizes each */
+#define FFT_MAX_CACHED 8
+
+typedef struct {
+  int window;
+  int size;
+  double *values;
+  int users;              /* Threads computing with this window */
+  epicsUInt32 lastUsed;
+} fftWindow_t;
+
+template <typename fftType> struct fftPlanEntry {
+  NDFFTPlan<fftType> *pPlan;
+  int users;              /* Threads computing with this plan */
+  epicsUInt32 lastUsed;
+};
 
 typedef struct {
   int rank;
@@ -38,8 +68,16 @@ typedef struct {
   int nFreqY;
   int suppressDC;
   int numAverage;
+  int rowThreads;
+  const double *windowX;
+  const double *windowY;
+  NDFFTPlan<epicsFloat32> *pFloatPlanX;
+  NDFFTPlan<epicsFloat32> *pFloatPlanY;
+  NDFFTPlan<epicsFloat64> *pDoublePlanX;
+  NDFFTPlan<epicsFloat64> *pDoublePlanY;
+  void *input;
+  void *FFTComplex;
   double *timeSeries;
-  double *FFTComplex;
   double *FFTReal;
   double *FFTImaginary;
   double *FFTAbsValue;
@@ -52,6 +90,7 @@ public:
               const char *NDArrayPort, int NDArrayAddr, 
               int maxBuffers, size_t maxMemory,
               int priority, int stackSize, int maxThreads);
+  ~NDPluginFFT();
 
   //These methods override the virtual methods in the base class
   void processCallbacks(NDArray *pArray);
@@ -72,15 +111,20 @@ protected:
   int P_FFTReal;
   int P_FFTImaginary;
   int P_FFTAbsValue;
+  int P_FFTWindow;
+  int P_FFTRowThreads;
                                 
 private:
-  template <typename epicsType> void convertToDoubleT(NDArray *pArray, fftPvt_t *pPvt);
-  void allocateArrays(fftPvt_t *pPvt, bool sizeChanged);
+  template <typename epicsType, typename fftType> void convertT(NDArray *pArray, fftPvt_t *pPvt);
+  template <typename epicsType> void convert(NDArray *pArray, fftPvt_t *pPvt);
+  template <typename fftType> void computeFFT(fftPvt_t *pPvt, NDFFTPlan<fftType> *pPlanX, NDFFTPlan<fftType> *pPlanY);
+  template <typename fftType> NDFFTPlan<fftType> *getPlan(std::vector<fftPlanEntry<fftType> > &plans, int size, bool real);
+  template <typename fftType> void releasePlan(std::vector<fftPlanEntry<fftType> > &plans, NDFFTPlan<fftType> *pPlan);
+  const double *getWindow(int window, int size);
+  void releaseWindow(const double *values);
+  void allocateArrays(fftPvt_t *pPvt, bool sizeChanged, bool useFloat);
   void createAxisArrays(fftPvt_t *pPvt);
-  void computeFFT_1D(fftPvt_t *pPvt);
-  void computeFFT_2D(fftPvt_t *pPvt);
   void doArrayCallbacks(fftPvt_t *pPvt);
-  int nextPow2(int v);
 
   int numAverage_;
   int uniqueId_;
@@ -94,6 +138,13 @@ private:
   double timePerPoint_; /* Actual time between points in input arrays */
   double *timeAxis_;
   double *freqAxis_;
+  // Plans and windows are not changed once created, so threads can use them without holding
+  // the lock.  The least recently used one that no thread is using is deleted when there are
+  // FFT_MAX_CACHED of them and another size is needed.
+  std::vector<fftPlanEntry<epicsFloat32> > floatPlans_;
+  std::vector<fftPlanEntry<epicsFloat64> > doublePlans_;
+  std::vector<fftWindow_t> windows_;
+  epicsUInt32 cacheUseCount_;
 };
     
 #endif //NDPluginFFT_H
@@ -57,6 +57,16 @@ NDPluginGather::NDPluginGather(const char *portName, int queueSize, int blocking
     NDGatherNDArraySource_t *pArraySrc;
     //static const char *functionName = "NDPluginGather";
 
+    createParam(NDPluginGatherArraysString,          asynParamInt32,        &NDPluginGatherArrays);
+    createParam(NDPluginGatherDroppedArraysString,   asynParamInt32,        &NDPluginGatherDroppedArrays);
+    for (i=0; i<maxPorts; i++) {
+        setIntegerParam(i, NDPluginGatherArrays, 0);
+        setIntegerParam(i, NDPluginGatherDroppedArrays, 0);
+    }
+
+    /* Arrays are passed on unchanged, so compressed arrays are accepted */
+    this->compressionAware_ = true;
+
     /* Set the plugin type string */
     setStringParam(NDPluginDriverPluginType, "NDPluginGather");
     
@@ -68,6 +78,8 @@ NDPluginGather::NDPluginGather(const char *portName, int queueSize, int blocking
         pArraySrc->pasynUserGenericPointer = pasynManager->createAsynUser(0, 0);
         pArraySrc->pasynUserGenericPointer->userPvt = this;
         pArraySrc->pasynUserGenericPointer->reason = NDArrayData;
+        /* This is copied to the asynUser passed to driverCallback, which uses it to find the source */
+        pArraySrc->pasynUserGenericPointer->userData = pArraySrc;
     }
 }
 
@@ -79,6 +91,35 @@ extern "C" {static void driverCallback(void *drvPvt, asynUser *pasynUser, void *
 }}
 
 
+/** Callback function that is called by the NDArray driver with new NDArray data.
+  * Counts the arrays received from each source, and those dropped because the queue was full,
+  * and then calls NDPluginDriver::driverCallback.
+  * \param[in] pasynUser  The pasynUser from the asyn client.
+  * \param[in] genericPointer The pointer to the NDArray */ 
+void NDPluginGather::driverCallback(asynUser *pasynUser, void *genericPointer)
+{
+    int i;
+    int arrays;
+
+    /* The base class sets auxStatus to asynOverflow if the queue is full.  It must be cleared first,
+     * because asynOverflow on entry means that a full queue is not an error. */
+    pasynUser->auxStatus = asynSuccess;
+    NDPluginDriver::driverCallback(pasynUser, genericPointer);
+    for (i=0; i<maxPorts_; i++) {
+        if (pasynUser->userData == &NDArraySrc_[i]) break;
+    }
+    if (i == maxPorts_) return;
+    this->lock();
+    getIntegerParam(i, NDPluginGatherArrays, &arrays);
+    setIntegerParam(i, NDPluginGatherArrays, arrays+1);
+    if (pasynUser->auxStatus == asynOverflow) {
+        getIntegerParam(i, NDPluginGatherDroppedArrays, &arrays);
+        setIntegerParam(i, NDPluginGatherDroppedArrays, arrays+1);
+    }
+    callParamCallbacks(i);
+    this->unlock();
+}
+
 /** 
   * \param[in] pArray  The NDArray from the callback.
   */
@@ -5,6 +5,10 @@
 
 #include "NDPluginDriver.h"
 
+/* Parameters for each source */
+#define NDPluginGatherArraysString           "GATHER_ARRAYS"             /* (asynInt32,        r/o) Arrays received from this source */
+#define NDPluginGatherDroppedArraysString    "GATHER_DROPPED_ARRAYS"     /* (asynInt32,        r/o) Arrays from this source dropped because the queue was full */
+
 typedef struct {
     void *asynGenericPointerInterruptPvt;        /**< InterruptPvt for connecting to NDArray driver interupts */
     asynUser *pasynUserGenericPointer;           /**< asynUser for connecting to NDArray driver */
@@ -13,15 +17,22 @@ typedef struct {
     bool connectedToArrayPort;
 } NDGatherNDArraySource_t;
 
-/** A plugin that subscribes to callbacks from multiple ports, not just a single port  */
+/** A plugin that subscribes to callbacks from multiple ports, not just a single port.
+  * With SortMode=1 the arrays from all ports are passed on in UniqueId order.  */
 class epicsShareClass NDPluginGather : public NDPluginDriver {
 public:
     NDPluginGather(const char *portName, int queueSize, int blockingCallbacks, 
                    int maxPorts, 
                    int maxBuffers, size_t maxMemory,
                    int priority, int stackSize);
+    virtual void driverCallback(asynUser *pasynUser, void *genericPointer);
 
 protected:
+    int NDPluginGatherArrays;
+    #define FIRST_NDPLUGIN_GATHER_PARAM NDPluginGatherArrays
+    int NDPluginGatherDroppedArrays;
+
+
     /* These methods override the virtual methods in the base class */
     virtual void processCallbacks(NDArray *pArray);
     virtual asynStatus connectToArrayPort(void);    
@@ -7,6 +7,7 @@
  * Created March 22, 2010
  */
 
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -37,250 +38,296 @@
 
 static const char *driverName="NDPluginOverlay";
 
-void NDPluginOverlay::addPixel(NDOverlay_t *pOverlay, int ix, int iy, NDArrayInfo_t *pArrayInfo)
+/* The fonts have glyphs for characters 32 (space) to 126 and 160 to 255, in that order.
+ * They are unpacked into a table of all 256 characters, with the others left blank. */
+#define NUM_CHARS 256
+#define FIRST_GLYPH 32
+#define LAST_ASCII_GLYPH 126
+#define FIRST_LATIN1_GLYPH 160
+
+/** Adds a run of pixels from xmin to xmax in row iy to an overlay, clipped to the array */
+void NDPluginOverlay::addRun(NDOverlay_t *pOverlay, int iy, int xmin, int xmax, NDArrayInfo_t *pArrayInfo)
 {
-  if ((ix >= 0) && (ix < (int)pArrayInfo->xSize) &&
-      (iy >= 0) && (iy < (int)pArrayInfo->ySize))
-    pOverlay->pvt.addressOffset.push_back(iy*pArrayInfo->yStride + ix*pArrayInfo->xStride);
+  NDOverlayRun_t run;
+
+  if ((iy < 0) || (iy >= (int)pArrayInfo->ySize)) return;
+  if (xmin < 0) xmin = 0;
+  if (xmax >= (int)pArrayInfo->xSize) xmax = (int)pArrayInfo->xSize - 1;
+  if (xmax < xmin) return;
+  run.y = iy;
+  run.x = xmin;
+  run.count = xmax - xmin + 1;
+  run.overlay = 0;
+  pOverlay->pvt.runs.push_back(run);
 }
 
-template <typename epicsType>
-void NDPluginOverlay::setPixel(epicsType *pValue, NDOverlay_t *pOverlay, NDArrayInfo_t *pArrayInfo)
+static bool runBefore(const NDOverlayRun_t &a, const NDOverlayRun_t &b)
 {
-  if ((pArrayInfo->colorMode == NDColorModeRGB1) ||
-      (pArrayInfo->colorMode == NDColorModeRGB2) ||
-      (pArrayInfo->colorMode == NDColorModeRGB3)) {
-    if (pOverlay->drawMode == NDOverlaySet) {
-      *pValue = (epicsType)pOverlay->red;
-      pValue += pArrayInfo->colorStride;
-      *pValue = (epicsType)pOverlay->green;
-      pValue += pArrayInfo->colorStride;
-      *pValue = (epicsType)pOverlay->blue;
-    } else if (pOverlay->drawMode == NDOverlayXOR) {
-      *pValue = (epicsType)((int)*pValue ^ (int)pOverlay->red);
-      pValue += pArrayInfo->colorStride;
-      *pValue = (epicsType)((int)*pValue ^ (int)pOverlay->green);
-      pValue += pArrayInfo->colorStride;
-      *pValue = (epicsType)((int)*pValue ^ (int)pOverlay->blue);
-    }
-  }
-  else {
-    if (pOverlay->drawMode == NDOverlaySet)
-      *pValue = (epicsType)pOverlay->green;
-    else if (pOverlay->drawMode == NDOverlayXOR)
-      *pValue = (epicsType)((int)*pValue ^ (int)pOverlay->green);
-  }
+  return (a.y < b.y) || ((a.y == b.y) && (a.x < b.x));
 }
 
+static bool rowBefore(const NDOverlayRun_t &a, const NDOverlayRun_t &b)
+{
+  return a.y < b.y;
+}
 
-
-template <typename epicsType>
-void NDPluginOverlay::doOverlayT(NDArray *pArray, NDOverlay_t *pOverlay, NDArrayInfo_t *pArrayInfo)
+/** Computes the runs of pixels that an overlay draws.  This is only done when the overlay
+  * or the array dimensions change, or for text with a time stamp. */
+void NDPluginOverlay::makeRuns(NDArray *pArray, NDOverlay_t *pOverlay, NDArrayInfo_t *pArrayInfo)
 {
-  int xmin, xmax, ymin, ymax, xcent, ycent, xsize, ysize, ix, iy, ii, jj, ib;
-  int xwide, ywide, xwidemax_line, xwidemin_line;
-  std::vector<int>::iterator it;
-  int nSteps;
+  int xmin, xmax, ymin, ymax, xcent, ycent, xsize, ysize, ix, iy, ii, jj, ib, start;
+  int xwide, ywide;
+  int nSteps, nRuns;
   double theta, thetaStep;
-  epicsType *pData=(epicsType *)pArray->pData;
+  std::vector<NDOverlayRun_t> &runs = pOverlay->pvt.runs;
   char textOutStr[512];                    // our string, maybe with a time stamp, to place into the image array
   char *cp;                                // character pointer to current character being rendered
-  int bmc;                                 // current byte in the font bitmap
-  int mask;                                // selects the bit in bmc to look at
   char tstr[64];                           // Used to build the time string
   NDPluginOverlayTextFontBitmapType *bmp;  // pointer to our font information (bitmap pointer, perhaps misnamed)
-  int bpc;                                 // bytes per char, ie, 1 for 6x13 font, 2 for 9x15 font
-  int sbc;                                 // "sub" byte counter to keep track of which byte we are looking at for multi byte fonts
-  //static const char *functionName = "doOverlayT";
+  const epicsUInt32 *pGlyphs;              // the rows of each character of the font, one bit per pixel
+  epicsUInt32 bits;                        // the pixels of the current row of the current character
 
   asynPrint(pasynUserSelf, ASYN_TRACEIO_DRIVER,
-    "NDPluginOverlay::DoOverlayT, shape=%d, Xpos=%d, Ypos=%d, Xsize=%d, Ysize=%d\n",
+    "NDPluginOverlay::makeRuns, shape=%d, Xpos=%d, Ypos=%d, Xsize=%d, Ysize=%d\n",
     pOverlay->shape, (int)pOverlay->PositionX, (int)pOverlay->PositionY, 
     (int)pOverlay->SizeX, (int)pOverlay->SizeY);
 
-  if (pOverlay->pvt.changed) {
-    pOverlay->pvt.addressOffset.clear();
-
-    switch(pOverlay->shape) {
-      case NDOverlayCross:
-        xcent = pOverlay->PositionX + pOverlay->SizeX/2;
-        ycent = pOverlay->PositionY + pOverlay->SizeY/2;
-        xmin = xcent - pOverlay->SizeX/2;
-        xmax = xcent + pOverlay->SizeX/2;
-        ymin = ycent - pOverlay->SizeY/2;
-        ymax = ycent + pOverlay->SizeY/2;
-        xwide = pOverlay->WidthX / 2;
-        ywide = pOverlay->WidthY / 2;
-
-        for (iy=ymin; iy<=ymax; iy++) {
-          if ((iy >= (ycent - ywide)) && (iy <= ycent + ywide)) {
-            for (ix=xmin; ix<=xmax; ++ix) {
-              addPixel(pOverlay, ix, iy, pArrayInfo);
-            }
-          } else {
-            xwidemin_line = xcent - xwide;
-            xwidemax_line = xcent + xwide;
-            for (ix=xwidemin_line; ix<=xwidemax_line; ++ix) {
-              addPixel(pOverlay, ix, iy, pArrayInfo);
-            }
-          }
-        }
-        break;
-
-      case NDOverlayRectangle:
-        xmin = pOverlay->PositionX;
-        xmax = pOverlay->PositionX + pOverlay->SizeX;
-        ymin = pOverlay->PositionY;
-        ymax = pOverlay->PositionY + pOverlay->SizeY;
-        xwide = pOverlay->WidthX;
-        ywide = pOverlay->WidthY;
-        xwide = MIN(xwide, (int)pOverlay->SizeX-1);
-        ywide = MIN(ywide, (int)pOverlay->SizeY-1);
-
-        //For non-zero width, grow the rectangle towards the center.
-        for (iy=ymin; iy<=ymax; iy++) {
-          if ((iy < (ymin + ywide)) || 
-              (iy > (ymax - ywide))) {
-            for (ix=xmin; ix<=xmax; ix++) {
-              addPixel(pOverlay, ix, iy, pArrayInfo);
-            }
-          } else {
-            for (ix=xmin; ix<(xmin+xwide); ++ix) {
-              addPixel(pOverlay, ix, iy, pArrayInfo);
-            }
-            for (ix=(xmax-xwide+1); ix<=xmax; ++ix) {
-              addPixel(pOverlay, ix, iy, pArrayInfo);
-            }
-          }
-        }
-        break;
-
-      case NDOverlayEllipse:
-        xwide = pOverlay->WidthX;
-        ywide = pOverlay->WidthY;
-        xwide = MIN(xwide, (int)pOverlay->SizeX-1);
-        ywide = MIN(ywide, (int)pOverlay->SizeY-1);
-        xcent = pOverlay->PositionX + pOverlay->SizeX/2;
-        ycent = pOverlay->PositionY + pOverlay->SizeY/2;
-        xsize = pOverlay->SizeX/2;
-        ysize = pOverlay->SizeY/2;
-        xmax = (int)(pArrayInfo->xSize-1);
-        ymax = (int)(pArrayInfo->ySize-1);
-
-        // Use the parametric equation for an ellipse.  
-        // Only need to compute 0 to pi/2, other quadrants by symmetry
-        // Make 2*(xsize + ysize) angle points
-        nSteps = 2*(xsize + ysize);
-        thetaStep = M_PI / 2. / nSteps;
-        for (ii=0, theta=0.; ii<=nSteps; ii++, theta+=thetaStep) {
-          for (jj=0; jj<xwide; jj++) {
-            ix = (int)((xsize-jj) * cos(theta) + 0.5);
-            iy = (int)((ysize-jj) * sin(theta) + 0.5);
-            addPixel(pOverlay, (xcent + ix), (ycent + iy), pArrayInfo);
-            addPixel(pOverlay, (xcent + ix), (ycent - iy), pArrayInfo);
-            addPixel(pOverlay, (xcent - ix), (ycent + iy), pArrayInfo);
-            addPixel(pOverlay, (xcent - ix), (ycent - iy), pArrayInfo);
-          }
-        }
-        // There may be duplicate pixels in the address list.  
-        // We must remove them or the XOR draw mode won't work because the pixel will be set and then unset
-        std::sort(pOverlay->pvt.addressOffset.begin(), pOverlay->pvt.addressOffset.end());
-        it = std::unique(pOverlay->pvt.addressOffset.begin(), pOverlay->pvt.addressOffset.end());
-        pOverlay->pvt.addressOffset.resize(std::distance(pOverlay->pvt.addressOffset.begin(), it));
-        break;
-
-      case NDOverlayText:
-        if ((pOverlay->Font >= 0) && (pOverlay->Font < NDPluginOverlayTextFontBitmapTypeN)) {
-          bmp = &NDPluginOverlayTextFontBitmaps[pOverlay->Font];
+  runs.clear();
+
+  switch(pOverlay->shape) {
+    case NDOverlayCross:
+      xcent = pOverlay->PositionX + pOverlay->SizeX/2;
+      ycent = pOverlay->PositionY + pOverlay->SizeY/2;
+      xmin = xcent - pOverlay->SizeX/2;
+      xmax = xcent + pOverlay->SizeX/2;
+      ymin = ycent - pOverlay->SizeY/2;
+      ymax = ycent + pOverlay->SizeY/2;
+      xwide = pOverlay->WidthX / 2;
+      ywide = pOverlay->WidthY / 2;
+
+      for (iy=ymin; iy<=ymax; iy++) {
+        if ((iy >= (ycent - ywide)) && (iy <= ycent + ywide)) {
+          addRun(pOverlay, iy, xmin, xmax, pArrayInfo);
         } else {
-          // Really, no reason to go on if the font is ill defined
-          return;
+          addRun(pOverlay, iy, xcent - xwide, xcent + xwide, pArrayInfo);
         }
+      }
+      break;
 
-        bpc = bmp->width / 8 + 1;
-
-        if (strlen(pOverlay->TimeStampFormat) > 0) {
-          epicsTimeToStrftime(tstr, sizeof(tstr)-1, pOverlay->TimeStampFormat, &pArray->epicsTS);
-          epicsSnprintf(textOutStr, sizeof(textOutStr)-1, "%s%s", pOverlay->DisplayText, tstr);
+    case NDOverlayRectangle:
+      xmin = pOverlay->PositionX;
+      xmax = pOverlay->PositionX + pOverlay->SizeX;
+      ymin = pOverlay->PositionY;
+      ymax = pOverlay->PositionY + pOverlay->SizeY;
+      xwide = pOverlay->WidthX;
+      ywide = pOverlay->WidthY;
+      xwide = MIN(xwide, (int)pOverlay->SizeX-1);
+      ywide = MIN(ywide, (int)pOverlay->SizeY-1);
+
+      //For non-zero width, grow the rectangle towards the center.
+      for (iy=ymin; iy<=ymax; iy++) {
+        if ((iy < (ymin + ywide)) || 
+            (iy > (ymax - ywide))) {
+          addRun(pOverlay, iy, xmin, xmax, pArrayInfo);
         } else {
-          epicsSnprintf(textOutStr, sizeof(textOutStr)-1, "%s", pOverlay->DisplayText);
+          addRun(pOverlay, iy, xmin, xmin + xwide - 1, pArrayInfo);
+          addRun(pOverlay, iy, xmax - xwide + 1, xmax, pArrayInfo);
         }
-        textOutStr[sizeof(textOutStr)-1] = 0;
-
-        cp   = textOutStr;
-        xmin = pOverlay->PositionX;
-        xmax = pOverlay->PositionX + pOverlay->SizeX;
-        ymin = pOverlay->PositionY;
-        ymax = pOverlay->PositionY + pOverlay->SizeY;
-        ymax = MIN(ymax, pOverlay->PositionY + bmp->height);
+      }
+      break;
 
-        // Loop over vertical lines
-        for (jj=0, iy=ymin; iy<ymax; jj++, iy++) {
+    case NDOverlayEllipse:
+      xwide = pOverlay->WidthX;
+      ywide = pOverlay->WidthY;
+      xwide = MIN(xwide, (int)pOverlay->SizeX-1);
+      ywide = MIN(ywide, (int)pOverlay->SizeY-1);
+      xcent = pOverlay->PositionX + pOverlay->SizeX/2;
+      ycent = pOverlay->PositionY + pOverlay->SizeY/2;
+      xsize = pOverlay->SizeX/2;
+      ysize = pOverlay->SizeY/2;
+
+      // Use the parametric equation for an ellipse.  
+      // Only need to compute 0 to pi/2, other quadrants by symmetry
+      // Make 2*(xsize + ysize) angle points
+      nSteps = 2*(xsize + ysize);
+      thetaStep = M_PI / 2. / nSteps;
+      for (ii=0, theta=0.; ii<=nSteps; ii++, theta+=thetaStep) {
+        for (jj=0; jj<xwide; jj++) {
+          ix = (int)((xsize-jj) * cos(theta) + 0.5);
+          iy = (int)((ysize-jj) * sin(theta) + 0.5);
+          addRun(pOverlay, (ycent + iy), (xcent + ix), (xcent + ix), pArrayInfo);
+          addRun(pOverlay, (ycent - iy), (xcent + ix), (xcent + ix), pArrayInfo);
+          addRun(pOverlay, (ycent + iy), (xcent - ix), (xcent - ix), pArrayInfo);
+          addRun(pOverlay, (ycent - iy), (xcent - ix), (xcent - ix), pArrayInfo);
+        }
+      }
+      break;
 
-          // Loop over characters
-          for (ii=0; cp[ii]!=0; ii++) {
-            if( cp[ii] < 32)
+    case NDOverlayText:
+      if ((pOverlay->Font < 0) || (pOverlay->Font >= NDPluginOverlayTextFontBitmapTypeN)) {
+        // Really, no reason to go on if the font is ill defined
+        break;
+      }
+      bmp = &NDPluginOverlayTextFontBitmaps[pOverlay->Font];
+      pGlyphs = &this->glyphRows_[pOverlay->Font][0];
+
+      if (strlen(pOverlay->TimeStampFormat) > 0) {
+        epicsTimeToStrftime(tstr, sizeof(tstr)-1, pOverlay->TimeStampFormat, &pArray->epicsTS);
+        epicsSnprintf(textOutStr, sizeof(textOutStr)-1, "%s%s", pOverlay->DisplayText, tstr);
+      } else {
+        epicsSnprintf(textOutStr, sizeof(textOutStr)-1, "%s", pOverlay->DisplayText);
+      }
+      textOutStr[sizeof(textOutStr)-1] = 0;
+
+      cp   = textOutStr;
+      xmin = pOverlay->PositionX;
+      xmax = pOverlay->PositionX + pOverlay->SizeX;
+      ymin = pOverlay->PositionY;
+      ymax = pOverlay->PositionY + pOverlay->SizeY;
+      ymax = MIN(ymax, pOverlay->PositionY + bmp->height);
+
+      // Loop over vertical lines
+      for (jj=0, iy=ymin; iy<ymax; jj++, iy++) {
+
+        // Loop over characters
+        for (ii=0; cp[ii]!=0; ii++) {
+          if ((unsigned char)cp[ii] < FIRST_GLYPH)
+            continue;
+
+          ix = xmin + ii * bmp->width;
+          if (ix >= xmax)
+            // None of this character can be written
+            break;
+
+          // Add a run for each group of adjacent pixels, up to the right edge of the overlay
+          bits = pGlyphs[bmp->height*(unsigned char)cp[ii] + jj];
+          for (ib=0; bits; ) {
+            if (!(bits & 1)) {
+              bits >>= 1;
+              ib++;
               continue;
-
-            if (xmin+ii * bmp->width >= xmax)
-              // None of this character can be written
+            }
+            for (start=ib; bits & 1; ib++) bits >>= 1;
+            if (ix + ib >= xmax) {
+              addRun(pOverlay, iy, ix + start, xmax - 1, pArrayInfo);
               break;
-
-            sbc = 0;
-            bmc = bmp->bitmap[(bmp->height*(cp[ii] - 32) + jj)*bpc];
-            mask = 0x80;
-            for (ib=0; ib<bmp->width; ib++) {
-              ix = xmin + ii * bmp->width + ib;
-              if (ix >= xmax)
-                break;
-              if (mask & bmc) {
-                addPixel(pOverlay, ix, iy, pArrayInfo);
-              }
-              mask >>= 1;
-              if (!mask) {
-                mask = 0x80;
-                sbc++;
-                bmc = bmp->bitmap[(bmp->height*(cp[ii] - 32) + jj)*bpc + sbc];
-              }
             }
+            addRun(pOverlay, iy, ix + start, ix + ib - 1, pArrayInfo);
           }
         }
-        break;
-    } // switch(pOverlay->shape)
-  } // if (pOverlay->pvt.changed)
+      }
+      break;
+  } // switch(pOverlay->shape)
+
+  // Merge runs that overlap or touch.  There may be duplicate pixels, for example in an ellipse.
+  // We must remove them or the XOR draw mode won't work because the pixel will be set and then unset
+  std::sort(runs.begin(), runs.end(), runBefore);
+  for (ii=0, nRuns=0; ii<(int)runs.size(); ii++) {
+    NDOverlayRun_t *pLast = &runs[nRuns > 0 ? nRuns-1 : 0];
+    if ((nRuns > 0) && (pLast->y == runs[ii].y) && (pLast->x + pLast->count >= runs[ii].x)) {
+      pLast->count = MAX(pLast->count, runs[ii].x + runs[ii].count - pLast->x);
+    } else {
+      runs[nRuns++] = runs[ii];
+    }
+  }
+  runs.resize(nRuns);
+}
+
+/** Combines the runs of all of the overlays in use into a single mask sorted by row */
+void NDPluginOverlay::makeMask(std::vector<NDOverlay_t> &overlays, std::vector<NDOverlayRun_t> &mask)
+{
+  size_t ii;
+  int overlay;
+
+  mask.clear();
+  for (overlay=0; overlay<this->maxOverlays_; overlay++) {
+    if (!overlays[overlay].use) continue;
+    for (ii=0; ii<overlays[overlay].pvt.runs.size(); ii++) {
+      mask.push_back(overlays[overlay].pvt.runs[ii]);
+      mask.back().overlay = overlay;
+    }
+  }
+  // A stable sort keeps the runs in each row in overlay order, so overlapping overlays are drawn as before
+  std::stable_sort(mask.begin(), mask.end(), rowBefore);
+}
+
+/** Draws one run of one color.  Contiguous runs are simple loops that the compiler vectorizes. */
+template <typename epicsType>
+static void blendRun(epicsType *pValue, int count, size_t stride, NDOverlayDrawMode_t drawMode, int value)
+{
+  epicsType setValue = (epicsType)value;
+  int i;
+
+  if (drawMode == NDOverlaySet) {
+    if (stride == 1) {
+      for (i=0; i<count; i++) pValue[i] = setValue;
+    } else {
+      for (i=0; i<count; i++) pValue[i*stride] = setValue;
+    }
+  } else if (drawMode == NDOverlayXOR) {
+    if (stride == 1) {
+      for (i=0; i<count; i++) pValue[i] = (epicsType)((int)pValue[i] ^ value);
+    } else {
+      for (i=0; i<count; i++) pValue[i*stride] = (epicsType)((int)pValue[i*stride] ^ value);
+    }
+  }
+}
 
-  // Set the pixels in the image from the addressOffset vector list
-  for (ii=0; ii<(int)pOverlay->pvt.addressOffset.size(); ii++) {
-    setPixel(pData + pOverlay->pvt.addressOffset[ii], pOverlay, pArrayInfo);
+/** Draws all of the overlays in one pass over the rows that they touch */
+template <typename epicsType>
+void NDPluginOverlay::applyMaskT(NDArray *pArray, std::vector<NDOverlay_t> &overlays,
+                                 std::vector<NDOverlayRun_t> &mask, NDArrayInfo_t *pArrayInfo)
+{
+  epicsType *pData=(epicsType *)pArray->pData;
+  epicsType *pValue;
+  NDOverlay_t *pOverlay;
+  size_t xStride = pArrayInfo->xStride;
+  size_t colorStride = pArrayInfo->colorStride;
+  bool isColor = ((pArrayInfo->colorMode == NDColorModeRGB1) ||
+                  (pArrayInfo->colorMode == NDColorModeRGB2) ||
+                  (pArrayInfo->colorMode == NDColorModeRGB3));
+  std::vector<NDOverlayRun_t>::const_iterator it;
+
+  for (it=mask.begin(); it!=mask.end(); ++it) {
+    pOverlay = &overlays[it->overlay];
+    pValue = pData + it->y*pArrayInfo->yStride + it->x*xStride;
+    if (isColor) {
+      blendRun(pValue,                 it->count, xStride, pOverlay->drawMode, pOverlay->red);
+      blendRun(pValue + colorStride,   it->count, xStride, pOverlay->drawMode, pOverlay->green);
+      blendRun(pValue + 2*colorStride, it->count, xStride, pOverlay->drawMode, pOverlay->blue);
+    } else {
+      blendRun(pValue, it->count, xStride, pOverlay->drawMode, pOverlay->green);
+    }
   }
 }
 
-int NDPluginOverlay::doOverlay(NDArray *pArray, NDOverlay_t *pOverlay, NDArrayInfo_t *pArrayInfo)
+int NDPluginOverlay::applyMask(NDArray *pArray, std::vector<NDOverlay_t> &overlays,
+                               std::vector<NDOverlayRun_t> &mask, NDArrayInfo_t *pArrayInfo)
 {
   switch(pArray->dataType) {
     case NDInt8:
-      doOverlayT<epicsInt8>(pArray, pOverlay, pArrayInfo);
+      applyMaskT<epicsInt8>(pArray, overlays, mask, pArrayInfo);
       break;
     case NDUInt8:
-      doOverlayT<epicsUInt8>(pArray, pOverlay, pArrayInfo);
+      applyMaskT<epicsUInt8>(pArray, overlays, mask, pArrayInfo);
       break;
     case NDInt16:
-      doOverlayT<epicsInt16>(pArray, pOverlay, pArrayInfo);
+      applyMaskT<epicsInt16>(pArray, overlays, mask, pArrayInfo);
       break;
     case NDUInt16:
-      doOverlayT<epicsUInt16>(pArray, pOverlay, pArrayInfo);
+      applyMaskT<epicsUInt16>(pArray, overlays, mask, pArrayInfo);
       break;
     case NDInt32:
-      doOverlayT<epicsInt32>(pArray, pOverlay, pArrayInfo);
+      applyMaskT<epicsInt32>(pArray, overlays, mask, pArrayInfo);
       break;
     case NDUInt32:
-      doOverlayT<epicsUInt32>(pArray, pOverlay, pArrayInfo);
+      applyMaskT<epicsUInt32>(pArray, overlays, mask, pArrayInfo);
       break;
     case NDFloat32:
-      doOverlayT<epicsFloat32>(pArray, pOverlay, pArrayInfo);
+      applyMaskT<epicsFloat32>(pArray, overlays, mask, pArrayInfo);
       break;
     case NDFloat64:
-      doOverlayT<epicsFloat64>(pArray, pOverlay, pArrayInfo);
+      applyMaskT<epicsFloat64>(pArray, overlays, mask, pArrayInfo);
       break;
     default:
       return(ND_ERROR);
@@ -289,9 +336,11 @@ int NDPluginOverlay::doOverlay(NDArray *pArray, NDOverlay_t *pOverlay, NDArrayIn
   return(ND_SUCCESS);
 }
 
-
+
 /** Callback function that is called by the NDArray driver with new NDArray data.
   * Draws overlays on top of the array.
+  * The pixels of all the overlays are kept as a mask of runs sorted by row, which is only rebuilt
+  * when an overlay or the array dimensions change.
   * \param[in] pArray  The NDArray from the callback.
   */
 void NDPluginOverlay::processCallbacks(NDArray *pArray)
@@ -306,9 +355,12 @@ void NDPluginOverlay::processCallbacks(NDArray *pArray)
   NDArray *pOutput;
   NDArrayInfo arrayInfo;
   std::vector<NDOverlay_t>pOverlays;
+  std::vector<NDOverlayRun_t> mask;
   NDOverlay_t *pOverlay;
   bool arrayInfoChanged;
-  int overlayUserLen = sizeof(*pOverlay) - sizeof(pOverlay->pvt);
+  bool maskChanged;
+  /* The user fields end with DisplayText; the padding before pvt is not copied with the structure */
+  int overlayUserLen = offsetof(NDOverlay_t, DisplayText) + sizeof(pOverlay->DisplayText);
   static const char* functionName = "processCallbacks";
 
   /* Call the base class method */
@@ -317,12 +369,15 @@ void NDPluginOverlay::processCallbacks(NDArray *pArray)
   /* Copy the input array so we can modify it. */
   pOutput = this->pNDArrayPool->copy(pArray, NULL, 1);
   
-  /* Get information about the array needed later */
+  /* Get information about the array needed later.
+   * Clear the padding in the structure first so that it can be compared with memcmp. */
+  memset(&arrayInfo, 0, sizeof(arrayInfo));
   pOutput->getInfo(&arrayInfo);
   arrayInfoChanged = (memcmp(&arrayInfo, &this->prevArrayInfo_, sizeof(arrayInfo)) != 0);
   this->prevArrayInfo_ = arrayInfo;
   setIntegerParam(NDPluginOverlayMaxSizeX, (int)arrayInfo.xSize);
   setIntegerParam(NDPluginOverlayMaxSizeY, (int)arrayInfo.ySize);
+  maskChanged = arrayInfoChanged;
  
   /* Copy the previous contents of each overlay */
   pOverlays = this->prevOverlays_;
@@ -331,6 +386,7 @@ void NDPluginOverlay::processCallbacks(NDArray *pArray)
   for (overlay=0; overlay<this->maxOverlays_; overlay++) {
     pOverlay = &pOverlays[overlay];
     getIntegerParam(overlay, NDPluginOverlayUse, &pOverlay->use);
+    if (pOverlay->use != this->prevOverlays_[overlay].use) maskChanged = true;
     if (!pOverlay->use) continue;
      /* Need to fetch all of these parameters while we still have the mutex */
     getIntegerParam(overlay, NDPluginOverlayPositionX,  &pOverlay->PositionX);
@@ -357,7 +413,9 @@ void NDPluginOverlay::processCallbacks(NDArray *pArray)
     if ((pOverlay->shape == NDOverlayText) && (strlen(pOverlay->TimeStampFormat) > 0)) {
         pOverlay->pvt.changed = true;
     }
+    if (pOverlay->pvt.changed) maskChanged = true;
   }
+  if (!maskChanged) mask = this->prevMask_;
   /* This function is called with the lock taken, and it must be set when we exit.
    * The following code can be exected without the mutex because we are not accessing memory
    * that other threads can access. */
@@ -365,19 +423,22 @@ void NDPluginOverlay::processCallbacks(NDArray *pArray)
   for (overlay=0; overlay<this->maxOverlays_; overlay++) {
     pOverlay = &pOverlays[overlay];
     if (!pOverlay->use) continue;
-    this->doOverlay(pOutput, pOverlay, &arrayInfo);
+    if (pOverlay->pvt.changed) this->makeRuns(pOutput, pOverlay, &arrayInfo);
     asynPrint(pasynUserSelf, ASYN_TRACEIO_DRIVER, 
-      "%s::%s overlay %d, changed=%d, points=%d\n", 
-      driverName, functionName, overlay, pOverlay->pvt.changed, (int)pOverlay->pvt.addressOffset.size());
+      "%s::%s overlay %d, changed=%d, runs=%d\n", 
+      driverName, functionName, overlay, pOverlay->pvt.changed, (int)pOverlay->pvt.runs.size());
   }
+  if (maskChanged) this->makeMask(pOverlays, mask);
+  this->applyMask(pOutput, pOverlays, mask, &arrayInfo);
   this->lock();
   this->prevOverlays_ = pOverlays;
+  if (maskChanged) this->prevMask_ = mask;
   NDPluginDriver::endProcessCallbacks(pOutput, false, true);
   callParamCallbacks();
 }
 
-
-
+
+
 /** Constructor for NDPluginOverlay; most parameters are simply passed to NDPluginDriver::NDPluginDriver.
   * After calling the base class constructor this method sets reasonable default values for all of the
   * ROI parameters.
@@ -411,10 +472,33 @@ NDPluginOverlay::NDPluginOverlay(const char *portName, int queueSize, int blocki
            ASYN_MULTIDEVICE, 1, priority, stackSize, maxThreads)
 {
   //static const char *functionName = "NDPluginOverlay";
+  NDPluginOverlayTextFontBitmapType *bmp;
+  int font, bpc, ch, glyph, row, ib;
+  epicsUInt32 bits;
 
 
   this->maxOverlays_ = maxOverlays;
   this->prevOverlays_.resize(maxOverlays_);
+  memset(&this->prevArrayInfo_, 0, sizeof(this->prevArrayInfo_));
+
+  /* Unpack the font bitmaps into one word for each row of each character, with one bit for each pixel */
+  this->glyphRows_.resize(NDPluginOverlayTextFontBitmapTypeN);
+  for (font=0; font<NDPluginOverlayTextFontBitmapTypeN; font++) {
+    bmp = &NDPluginOverlayTextFontBitmaps[font];
+    bpc = bmp->width / 8 + 1;
+    this->glyphRows_[font].assign(NUM_CHARS * bmp->height, 0);
+    for (ch=FIRST_GLYPH, glyph=0; ch<NUM_CHARS; ch++) {
+      if ((ch > LAST_ASCII_GLYPH) && (ch < FIRST_LATIN1_GLYPH)) continue;
+      for (row=0; row<bmp->height; row++) {
+        bits = 0;
+        for (ib=0; ib<bmp->width; ib++) {
+          if (bmp->bitmap[(glyph*bmp->height + row)*bpc + ib/8] & (0x80 >> (ib%8))) bits |= 1 << ib;
+        }
+        this->glyphRows_[font][ch*bmp->height + row] = bits;
+      }
+      glyph++;
+    }
+  }
 
   createParam(NDPluginOverlayMaxSizeXString,        asynParamInt32, &NDPluginOverlayMaxSizeX);
   createParam(NDPluginOverlayMaxSizeYString,        asynParamInt32, &NDPluginOverlayMaxSizeY);
@@ -17,8 +17,16 @@ typedef enum {
     NDOverlayXOR
 } NDOverlayDrawMode_t;
 
+/** A run of consecutive pixels in one row of the array that an overlay draws */
 typedef struct {
-    std::vector<int> addressOffset;
+    int y;          /**< Row of the run */
+    int x;          /**< First pixel of the run */
+    int count;      /**< Number of pixels in the run */
+    int overlay;    /**< Overlay that draws the run */
+} NDOverlayRun_t;
+
+typedef struct {
+    std::vector<NDOverlayRun_t> runs;
     bool changed;
     bool freezePositionX;
     bool freezePositionY;
@@ -104,10 +112,15 @@ private:
     int maxOverlays_;
     NDArrayInfo prevArrayInfo_;
     std::vector<NDOverlay_t> prevOverlays_;    /* Vector of NDOverlay structures */
-    inline void addPixel(NDOverlay_t *pOverlay, int ix, int iy, NDArrayInfo_t *pArrayInfo);
-    template <typename epicsType> void doOverlayT(NDArray *pArray, NDOverlay_t *pOverlay, NDArrayInfo_t *pArrayInfo);
-    int doOverlay(NDArray *pArray, NDOverlay_t *pOverlay, NDArrayInfo_t *pArrayInfo);
-    template <typename epicsType> void setPixel(epicsType *pValue, NDOverlay_t *pOverlay, NDArrayInfo_t *pArrayInfo);
+    std::vector<NDOverlayRun_t> prevMask_;     /* Runs of all overlays in use, sorted by row */
+    std::vector<std::vector<epicsUInt32> > glyphRows_; /* Pixels of each row of each character of each font */
+    void addRun(NDOverlay_t *pOverlay, int iy, int xmin, int xmax, NDArrayInfo_t *pArrayInfo);
+    void makeRuns(NDArray *pArray, NDOverlay_t *pOverlay, NDArrayInfo_t *pArrayInfo);
+    void makeMask(std::vector<NDOverlay_t> &overlays, std::vector<NDOverlayRun_t> &mask);
+    template <typename epicsType> void applyMaskT(NDArray *pArray, std::vector<NDOverlay_t> &overlays,
+                                                  std::vector<NDOverlayRun_t> &mask, NDArrayInfo_t *pArrayInfo);
+    int applyMask(NDArray *pArray, std::vector<NDOverlay_t> &overlays,
+                  std::vector<NDOverlayRun_t> &mask, NDArrayInfo_t *pArrayInfo);
 };
     
 #endif
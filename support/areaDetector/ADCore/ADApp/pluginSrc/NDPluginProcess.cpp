@@ -12,6 +12,8 @@
 #include <stdio.h>
 #include <math.h>
 
+#include <vector>
+
 #include <epicsTypes.h>
 #include <epicsMessageQueue.h>
 #include <epicsThread.h>
@@ -27,6 +29,148 @@
 
 static const char *driverName="NDPluginProcess";
 
+/** Number of elements that processBlocks() takes through all of the processing steps at a time */
+#define PROCESS_BLOCK_SIZE 1024
+
+/** The arrays and values used by processBlocks(), set up by processCallbacks() */
+typedef struct {
+    const void *input;
+    void *output;                   /**< NULL if there are no callbacks for this array */
+    size_t nElements;
+    const double *background;       /**< NULL if background subtraction is not done */
+    const double *flatField;        /**< NULL if flat field normalization is not done */
+    double scaleFlatField;
+    int enableOffsetScale;
+    double offset, scale;
+    int enableHighClip, enableLowClip;
+    double highClip, lowClip;
+    double *filter;                 /**< NULL if filtering is not done */
+    int initFilter;                 /**< The filter is new, so it is first set to the processed data */
+    int resetFilter;
+    double rOffset, rc1, rc2;
+    double oOffset, O1, O2;
+    double fOffset, F1, F2;
+    double *blockMin;               /**< Minimum input of each block; NULL unless autoOffsetScale */
+    double *blockMax;
+} NDProcessPvt_t;
+
+/** Does all of the enabled processing steps for blocks first to first+count-1 of PROCESS_BLOCK_SIZE elements.
+  * Each block is converted to double and taken through every step while it is in the cache, then converted
+  * to the output type, so the array is only read and written once.  Each step is a simple loop over the block
+  * that the compiler can vectorize.  The arithmetic for each element is the same as doing each step for the
+  * whole array in turn, so the results do not depend on the block size or the number of threads. */
+template <typename epicsTypeIn, typename epicsTypeOut>
+static void processBlocks(void *pvt, int first, int count)
+{
+    NDProcessPvt_t *pPvt = (NDProcessPvt_t *)pvt;
+    double value[PROCESS_BLOCK_SIZE];
+    int block;
+    size_t i, n;
+
+    for (block=first; block<first+count; block++) {
+        size_t start = (size_t)block * PROCESS_BLOCK_SIZE;
+        const epicsTypeIn *pIn = (const epicsTypeIn *)pPvt->input + start;
+        n = pPvt->nElements - start;
+        if (n > PROCESS_BLOCK_SIZE) n = PROCESS_BLOCK_SIZE;
+
+        for (i=0; i<n; i++) value[i] = (double)pIn[i];
+        if (pPvt->blockMin) {
+            double minValue = value[0], maxValue = value[0];
+            for (i=0; i<n; i++) {
+                minValue = (value[i] < minValue) ? value[i] : minValue;
+                maxValue = (value[i] > maxValue) ? value[i] : maxValue;
+            }
+            pPvt->blockMin[block] = minValue;
+            pPvt->blockMax[block] = maxValue;
+        }
+        if (pPvt->background) {
+            const double *background = pPvt->background + start;
+            for (i=0; i<n; i++) value[i] -= background[i];
+        }
+        if (pPvt->flatField) {
+            const double *flatField = pPvt->flatField + start;
+            double scaleFlatField = pPvt->scaleFlatField;
+            for (i=0; i<n; i++) {
+                value[i] = (flatField[i] != 0.) ? value[i] * (scaleFlatField / flatField[i]) : scaleFlatField;
+            }
+        }
+        if (pPvt->enableOffsetScale) {
+            double offset = pPvt->offset, scale = pPvt->scale;
+            for (i=0; i<n; i++) value[i] = (value[i] + offset)*scale;
+        }
+        if (pPvt->enableHighClip) {
+            double highClip = pPvt->highClip;
+            for (i=0; i<n; i++) value[i] = (value[i] > highClip) ? highClip : value[i];
+        }
+        if (pPvt->enableLowClip) {
+            double lowClip = pPvt->lowClip;
+            for (i=0; i<n; i++) value[i] = (value[i] < lowClip) ? lowClip : value[i];
+        }
+        if (pPvt->filter) {
+            double *filter = pPvt->filter + start;
+            double rOffset = pPvt->rOffset, rc1 = pPvt->rc1, rc2 = pPvt->rc2;
+            double oOffset = pPvt->oOffset, O1 = pPvt->O1, O2 = pPvt->O2;
+            double fOffset = pPvt->fOffset, F1 = pPvt->F1, F2 = pPvt->F2;
+            if (pPvt->initFilter) {
+                for (i=0; i<n; i++) filter[i] = value[i];
+            }
+            if (pPvt->resetFilter) {
+                for (i=0; i<n; i++) {
+                    double newFilter = rOffset;
+                    if (rc1) newFilter += rc1*filter[i];
+                    if (rc2) newFilter += rc2*value[i];
+                    filter[i] = newFilter;
+                }
+            }
+            for (i=0; i<n; i++) {
+                double newData = oOffset, newFilter = fOffset;
+                if (O1) newData += O1 * filter[i];
+                if (O2) newData += O2 * value[i];
+                if (F1) newFilter += F1 * filter[i];
+                if (F2) newFilter += F2 * value[i];
+                value[i] = newData;
+                filter[i] = newFilter;
+            }
+        }
+        if (pPvt->output) {
+            epicsTypeOut *pOut = (epicsTypeOut *)pPvt->output + start;
+            for (i=0; i<n; i++) pOut[i] = (epicsTypeOut)value[i];
+        }
+    }
+}
+
+template <typename epicsTypeIn>
+static NDPluginTileFunc_t processBlocksFuncT(NDDataType_t dataTypeOut)
+{
+    switch (dataTypeOut) {
+        case NDInt8:    return processBlocks<epicsTypeIn, epicsInt8>;
+        case NDUInt8:   return processBlocks<epicsTypeIn, epicsUInt8>;
+        case NDInt16:   return processBlocks<epicsTypeIn, epicsInt16>;
+        case NDUInt16:  return processBlocks<epicsTypeIn, epicsUInt16>;
+        case NDInt32:   return processBlocks<epicsTypeIn, epicsInt32>;
+        case NDUInt32:  return processBlocks<epicsTypeIn, epicsUInt32>;
+        case NDFloat32: return processBlocks<epicsTypeIn, epicsFloat32>;
+        case NDFloat64: return processBlocks<epicsTypeIn, epicsFloat64>;
+        default:        return NULL;
+    }
+}
+
+/** Returns the processBlocks() function for these input and output data types, or NULL if either is invalid */
+static NDPluginTileFunc_t processBlocksFunc(NDDataType_t dataTypeIn, NDDataType_t dataTypeOut)
+{
+    switch (dataTypeIn) {
+        case NDInt8:    return processBlocksFuncT<epicsInt8>(dataTypeOut);
+        case NDUInt8:   return processBlocksFuncT<epicsUInt8>(dataTypeOut);
+        case NDInt16:   return processBlocksFuncT<epicsInt16>(dataTypeOut);
+        case NDUInt16:  return processBlocksFuncT<epicsUInt16>(dataTypeOut);
+        case NDInt32:   return processBlocksFuncT<epicsInt32>(dataTypeOut);
+        case NDUInt32:  return processBlocksFuncT<epicsUInt32>(dataTypeOut);
+        case NDFloat32: return processBlocksFuncT<epicsFloat32>(dataTypeOut);
+        case NDFloat64: return processBlocksFuncT<epicsFloat64>(dataTypeOut);
+        default:        return NULL;
+    }
+}
+
 
 /** Callback function that is called by the NDArray driver with new NDArray data.
   * Does image processing.
@@ -38,29 +182,31 @@ void NDPluginProcess::processCallbacks(NDArray *pArray)
      * It is called with the mutex already locked.  It unlocks it during long calculations when private
      * structures don't need to be protected.
      */
-    size_t i;
-    NDArray *pScratch=NULL;
-    double  *data, newData, newFilter;
+    int i;
+    NDProcessPvt_t pvt;
+    NDPluginTileFunc_t processFunc;
+    std::vector<double> blockMin, blockMax;
+    size_t  dims[ND_ARRAY_MAX_DIMS];
+    size_t  numBlocks;
     NDArrayInfo arrayInfo;
-    double  *background=NULL, *flatField=NULL, *filter=NULL;
-    double  value;
+    double  *background=NULL, *flatField=NULL;
     size_t  nElements;
     int     saveBackground, enableBackground, validBackground;
     int     saveFlatField,  enableFlatField,  validFlatField;
     double  scaleFlatField;
     int     enableOffsetScale, autoOffsetScale;
-    double  offset, scale, minValue, maxValue;
+    double  offset=0, scale=1, minValue, maxValue;
     double  lowClip=0, highClip=0;
     int     enableLowClip, enableHighClip;
     int     resetFilter, autoResetFilter, filterCallbacks, doCallbacks=1;
-    int     enableFilter, numFilter;
+    int     enableFilter, numFilter=1;
     int     dataType;
+    int     tileThreads;
     int     anyProcess;
-    double  oOffset, fOffset, rOffset, oScale, fScale;
-    double  oc1, oc2, oc3, oc4;
-    double  fc1, fc2, fc3, fc4;
-    double  rc1, rc2;
-    double  F1, F2, O1, O2;
+    double  oOffset=0, fOffset=0, rOffset=0, oScale=0, fScale=0;
+    double  oc1=0, oc2=0, oc3=0, oc4=0;
+    double  fc1=0, fc2=0, fc3=0, fc4=0;
+    double  rc1=0, rc2=0;
 
     NDArray *pArrayOut = NULL;
     static const char* functionName = "processCallbacks";
@@ -83,6 +229,7 @@ void NDPluginProcess::processCallbacks(NDArray *pArray)
     getIntegerParam(NDPluginProcessResetFilter,         &resetFilter);
     getIntegerParam(NDPluginProcessAutoResetFilter,     &autoResetFilter);
     getIntegerParam(NDPluginProcessFilterCallbacks,     &filterCallbacks);
+    getIntegerParam(NDPluginProcessTileThreads,         &tileThreads);
 
     if (enableOffsetScale) {
         getDoubleParam (NDPluginProcessScale,           &scale);
@@ -120,6 +267,7 @@ void NDPluginProcess::processCallbacks(NDArray *pArray)
     
     pArray->getInfo(&arrayInfo);
     nElements = arrayInfo.nElements;
+    for (i=0; i<pArray->ndims; i++) dims[i] = pArray->dims[i].size;
 
     validBackground = 0;
     if (this->pBackground && (nElements == this->nBackgroundElements)) validBackground = 1;
@@ -147,43 +295,36 @@ void NDPluginProcess::processCallbacks(NDArray *pArray)
         this->pNDArrayPool->convert(pArray, &pArrayOut, (NDDataType_t)dataType);
         goto doCallbacks;
     }
-    
-    /* Make a copy of the array converted to double, because we cannot modify the input array */
-    this->pNDArrayPool->convert(pArray, &pScratch, NDFloat64);
-    if (NULL == pScratch) {
+
+    processFunc = processBlocksFunc(pArray->dataType, (NDDataType_t)dataType);
+    if (NULL == processFunc) {
         asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR, 
-            "%s:%s Processing aborted; cannot allocate an NDArray for storage of temporary data.\n", 
-            driverName, functionName);
+            "%s:%s Processing aborted; invalid data type, input=%d, output=%d.\n", 
+            driverName, functionName, pArray->dataType, dataType);
         goto doCallbacks;
     }
-    data = (double *)pScratch->pData;
 
-    if (nElements > 0) {
-        minValue = data[0];
-        maxValue = data[0];
-    } else {
-        minValue = 0;
-        maxValue = 1;
-    }
-    for (i=0; i<nElements; i++) {
-        value = data[i];
-        if (autoOffsetScale) {
-            if (data[i] < minValue) minValue = data[i];
-            if (data[i] > maxValue) maxValue = data[i];
-        }
-        if (background) value -= background[i];
-        if (flatField) {
-            if (flatField[i] != 0.) 
-                value *= scaleFlatField / flatField[i];
-            else
-                value = scaleFlatField;
-        }
-        if (enableOffsetScale) value = (value + offset)*scale;
-        if (enableHighClip && (value > highClip)) value = highClip;
-        if (enableLowClip  && (value < lowClip))  value = lowClip;
-        data[i] = value;
+    memset(&pvt, 0, sizeof(pvt));
+    pvt.input             = pArray->pData;
+    pvt.nElements         = nElements;
+    pvt.background        = background;
+    pvt.flatField         = flatField;
+    pvt.scaleFlatField    = scaleFlatField;
+    pvt.enableOffsetScale = enableOffsetScale;
+    pvt.offset            = offset;
+    pvt.scale             = scale;
+    pvt.enableHighClip    = enableHighClip;
+    pvt.highClip          = highClip;
+    pvt.enableLowClip     = enableLowClip;
+    pvt.lowClip           = lowClip;
+    numBlocks = (nElements + PROCESS_BLOCK_SIZE - 1) / PROCESS_BLOCK_SIZE;
+    if (autoOffsetScale && (numBlocks > 0)) {
+        blockMin.resize(numBlocks);
+        blockMax.resize(numBlocks);
+        pvt.blockMin = &blockMin[0];
+        pvt.blockMax = &blockMax[0];
     }
-    
+
     if (enableFilter) {
         if (this->pFilter) {
             this->pFilter->getInfo(&arrayInfo);
@@ -193,56 +334,69 @@ void NDPluginProcess::processCallbacks(NDArray *pArray)
             }
         }
         if (!this->pFilter) {
-            /* There is not a current filter array */
-            /* Make a copy of the current array, converted to double type */
-            this->pNDArrayPool->convert(pScratch, &this->pFilter, NDFloat64);
+            /* There is not a current filter array, processBlocks sets it to the processed array */
+            this->pFilter = this->pNDArrayPool->alloc(pArray->ndims, dims, NDFloat64, 0, NULL);
             if (NULL == this->pFilter) {
                 asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR, 
                     "%s:%s Processing aborted; cannot allocate an NDArray to store the filter.\n", 
                     driverName,functionName);
                 goto doCallbacks;
             }
+            pvt.initFilter = 1;
             resetFilter = 1;
         }
         if ((this->numFiltered >= numFilter) && autoResetFilter)
           resetFilter = 1;
         if (resetFilter) {
-            filter = (double *)this->pFilter->pData;
-            for (i=0; i<nElements; i++) {
-                newFilter = rOffset;
-                if (rc1) newFilter += rc1*filter[i];
-                if (rc2) newFilter += rc2*data[i];
-                filter[i] = newFilter;
-            }           
+            pvt.resetFilter = 1;
+            pvt.rOffset = rOffset;
+            pvt.rc1 = rc1;
+            pvt.rc2 = rc2;
             this->numFiltered = 0;
         }
-        /* Do the filtering */
         if (this->numFiltered < numFilter) this->numFiltered++;
-        filter = (double *)this->pFilter->pData;
-        O1 = oScale * (oc1 + oc2/this->numFiltered);
-        O2 = oScale * (oc3 + oc4/this->numFiltered);
-        F1 = fScale * (fc1 + fc2/this->numFiltered);
-        F2 = fScale * (fc3 + fc4/this->numFiltered);
-        for (i=0; i<nElements; i++) {
-            newData   = oOffset;
-            if (O1) newData += O1 * filter[i];
-            if (O2) newData += O2 * data[i];
-            newFilter = fOffset;
-            if (F1) newFilter += F1 * filter[i];
-            if (F2) newFilter += F2 * data[i];
-            data[i] = newData;
-            filter[i] = newFilter;
-        }
+        pvt.filter = (double *)this->pFilter->pData;
+        pvt.oOffset = oOffset;
+        pvt.O1 = oScale * (oc1 + oc2/this->numFiltered);
+        pvt.O2 = oScale * (oc3 + oc4/this->numFiltered);
+        pvt.fOffset = fOffset;
+        pvt.F1 = fScale * (fc1 + fc2/this->numFiltered);
+        pvt.F2 = fScale * (fc3 + fc4/this->numFiltered);
         if ((this->numFiltered != numFilter) && filterCallbacks)
           doCallbacks = 0;
     }
 
     if (doCallbacks) {
-      /* Convert the array to the desired output data type */
-      this->pNDArrayPool->convert(pScratch, &pArrayOut, (NDDataType_t)dataType);
+        /* The output array is written directly in the output data type */
+        pArrayOut = this->pNDArrayPool->alloc(pArray->ndims, dims, (NDDataType_t)dataType, 0, NULL);
+        if (NULL == pArrayOut) {
+            asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR, 
+                "%s:%s cannot allocate the output NDArray.\n", 
+                driverName, functionName);
+        } else {
+            pArrayOut->timeStamp = pArray->timeStamp;
+            pArrayOut->epicsTS = pArray->epicsTS;
+            pArrayOut->uniqueId = pArray->uniqueId;
+            memcpy(pArrayOut->dims, pArray->dims, pArray->ndims*sizeof(NDDimension_t));
+            pArray->pAttributeList->copy(pArrayOut->pAttributeList);
+            pvt.output = pArrayOut->pData;
+        }
     }
 
+    runTiles(tileThreads, (int)numBlocks, processFunc, &pvt);
+
     if (autoOffsetScale && (NULL != pArrayOut)) {
+        if (numBlocks > 0) {
+            minValue = blockMin[0];
+            maxValue = blockMax[0];
+            for (size_t block=1; block<numBlocks; block++) {
+                if (blockMin[block] < minValue) minValue = blockMin[block];
+                if (blockMax[block] > maxValue) maxValue = blockMax[block];
+            }
+        } else {
+            minValue = 0;
+            maxValue = 1;
+        }
         pArrayOut->getInfo(&arrayInfo);
         double maxScale = pow(2., arrayInfo.bytesPerElement*8) - 1;
         scale = maxScale /(maxValue-minValue);
@@ -264,8 +418,6 @@ void NDPluginProcess::processCallbacks(NDArray *pArray)
         NDPluginDriver::endProcessCallbacks(pArrayOut, false, true);
     }
 
-    if (NULL != pScratch) pScratch->release();
-
     setIntegerParam(NDPluginProcessNumFiltered, this->numFiltered);
     if (autoOffsetScale && this->pArrays[0] != NULL) {
         setIntegerParam(NDPluginProcessAutoOffsetScale, 0);
@@ -419,6 +571,10 @@ NDPluginProcess::NDPluginProcess(const char *portName, int queueSize, int blocki
     /* Output data type */
     createParam(NDPluginProcessDataTypeString,          asynParamInt32,     &NDPluginProcessDataType);   
 
+    /* Threads */
+    createParam(NDPluginProcessTileThreadsString,       asynParamInt32,     &NDPluginProcessTileThreads);
+    setIntegerParam(NDPluginProcessTileThreads, 1);
+
     this->pBackground = NULL;
     this->pFlatField  = NULL;
     this->pFilter     = NULL;
@@ -52,6 +52,9 @@
 
 /* Output data type */
 #define NDPluginProcessDataTypeString           "PROCESS_DATA_TYPE" /* (asynInt32,   r/w) Output type.  -1 means automatic. */
+
+/* Threads */
+#define NDPluginProcessTileThreadsString        "TILE_THREADS"      /* (asynInt32,   r/w) Number of threads used to process each array */
    
 
 /** Does image processing operations.  These include
@@ -121,6 +124,9 @@ protected:
     /* Output data type */
     int NDPluginProcessDataType;
 
+    /* Threads */
+    int NDPluginProcessTileThreads;
+
 private:
     NDArray *pBackground;
     size_t  nBackgroundElements;
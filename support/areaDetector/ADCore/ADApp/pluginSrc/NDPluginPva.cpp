@@ -150,6 +150,9 @@ NDPluginPva::NDPluginPva(const char *portName, int queueSize,
     if(!m_record.get())
         throw runtime_error("failed to create NTNDArrayRecord");
 
+    /* Compressed arrays are served with the codec of the NTNDArray */
+    this->compressionAware_ = true;
+
     /* Set the plugin type string */
     setStringParam(NDPluginDriverPluginType, "NDPluginPva");
 
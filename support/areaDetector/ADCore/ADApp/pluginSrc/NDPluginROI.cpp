@@ -50,12 +50,10 @@ void NDPluginROI::processCallbacks(NDArray *pArray)
     int dim;
     NDDimension_t dims[ND_ARRAY_MAX_DIMS], tempDim, *pDim;
     size_t userDims[ND_ARRAY_MAX_DIMS];
-    NDArrayInfo arrayInfo, scratchInfo;
-    NDArray *pScratch, *pOutput;
+    NDArrayInfo arrayInfo;
+    NDArray *pOutput;
     NDColorMode_t colorMode;
-    double *pData;
     int enableScale, enableDim[3], autoSize[3];
-    size_t i;
     double scale;
     int collapseDims;
     //static const char* functionName = "processCallbacks";
@@ -170,17 +168,18 @@ void NDPluginROI::processCallbacks(NDArray *pArray)
         /* This is tricky.  We want to do the operation to avoid errors due to integer truncation.
          * For example, if an image with all pixels=1 is binned 3x3 with scale=9 (divide by 9), then
          * the output should also have all pixels=1. 
-         * We do this by extracting the ROI and converting to double, do the scaling, then convert
-         * to the desired data type. */
-        this->pNDArrayPool->convert(pArray, &pScratch, NDFloat64, dims);
-        pScratch->getInfo(&scratchInfo);
-        pData = (double *)pScratch->pData;
-        for (i=0; i<scratchInfo.nElements; i++) pData[i] = pData[i]/scale;
-        this->pNDArrayPool->convert(pScratch, &pOutput, (NDDataType_t)dataType);
-        pScratch->release();
+         * convert() does this by extracting the ROI as double, then scaling and converting to the
+         * desired data type in one pass. */
+        this->pNDArrayPool->convert(pArray, &pOutput, (NDDataType_t)dataType, dims, scale, false);
     } 
     else {        
-        this->pNDArrayPool->convert(pArray, &pOutput, (NDDataType_t)dataType, dims);
+        /* A region of complete rows or planes with no binning, reversal or type change does not
+         * need to be copied; the output array is a view of the input buffer */
+        pOutput = NULL;
+        if (dataType == (int)pArray->dataType)
+            pOutput = this->pNDArrayPool->view(pArray, dims);
+        if (!pOutput)
+            this->pNDArrayPool->convert(pArray, &pOutput, (NDDataType_t)dataType, dims);
     }
 
     /* If we selected just one color from the array, then we need to collapse the
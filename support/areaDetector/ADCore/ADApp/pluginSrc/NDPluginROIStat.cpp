@@ -14,7 +14,9 @@
 #include <stdio.h>
 #include <math.h>
 
-#include <cantProceed.h>
+#include <algorithm>
+#include <vector>
+
 #include <epicsTypes.h>
 #include <epicsMessageQueue.h>
 #include <epicsThread.h>
@@ -34,162 +36,259 @@
 
 #define DEFAULT_NUM_TSPOINTS 2048
 
-/**
- * Templated function to calculate statistics on different NDArray data types.
- * \param[in] NDArray The pointer to the NDArray object
- * \param[in] NDROI The pointer to the NDROI object
- * \return asynStatus
- */
+/* Accumulator type for the sum of one interval of a row.  Integer data is summed exactly in
+ * 64 bit integers, which the compiler can vectorize; floating point data uses double. */
+template <typename epicsType> struct NDROIStatSum { typedef double sumType; };
+template <> struct NDROIStatSum<epicsInt8>   { typedef epicsInt64 sumType; };
+template <> struct NDROIStatSum<epicsUInt8>  { typedef epicsInt64 sumType; };
+template <> struct NDROIStatSum<epicsInt16>  { typedef epicsInt64 sumType; };
+template <> struct NDROIStatSum<epicsUInt16> { typedef epicsInt64 sumType; };
+template <> struct NDROIStatSum<epicsInt32>  { typedef epicsInt64 sumType; };
+template <> struct NDROIStatSum<epicsUInt32> { typedef epicsInt64 sumType; };
+
+/** Statistics of one interval of the current row */
+typedef struct {
+    double min;
+    double max;
+    double total;
+    size_t row;         /* Row these statistics are for, or (size_t)-1 if none */
+} NDROIStatInterval_t;
+
+/** Statistics of one ROI over one band of rows */
+typedef struct {
+    double min;
+    double max;
+    double total;
+    double bgd;
+    size_t nBgd;
+    bool hasData;
+} NDROIStatPartial_t;
+
+/** Everything needed to compute the statistics of all ROIs in one pass over the array.
+  * The columns where any ROI or background region starts or ends divide each row into intervals.
+  * The statistics of each interval of a row are computed once, from one read of the data, and
+  * then combined into those of every ROI that contains the interval.  The rows are divided
+  * into bands, one per thread, each with its own partial results that are merged at the end. */
+typedef struct {
+    const void *pData;
+    size_t rowStride;                           /* Elements in each row of the array */
+    size_t yFirst;                              /* First row of any ROI */
+    size_t yCount;                              /* Number of rows from yFirst to the last row of any ROI */
+    int numBands;
+    std::vector<NDROI_t *> rois;                /* ROIs in use */
+    std::vector<size_t> bounds;                 /* Columns where intervals start, and the end of the last */
+    std::vector<size_t> roiIntervals;           /* For each ROI the intervals where it starts, where its left
+                                                 * background ends, where its right background starts and
+                                                 * where it ends */
+    std::vector<NDROIStatInterval_t> intervals; /* Interval statistics for each band */
+    std::vector<NDROIStatPartial_t> partials;   /* ROI statistics for each band */
+} NDROIStatPvt_t;
+
+/** Computes the statistics of interval k of row y */
 template <typename epicsType>
-asynStatus NDPluginROIStat::doComputeStatisticsT(NDArray *pArray, NDROI *pROI)
+static void intervalStatsT(const epicsType *pRow, const NDROIStatPvt_t *pPvt, size_t k, NDROIStatInterval_t *pInterval)
 {
-  epicsType *pData = (epicsType *)pArray->pData;
-  double value = 0;
-  double bgd = 0;
-  size_t sizeX = pROI->size[0];
-  size_t sizeY = pROI->size[1];
-  size_t offsetX = pROI->offset[0];
-  size_t offsetY = pROI->offset[1];
-  size_t x = 0;
-  size_t y = 0;
-  size_t nElements = 0;
-  size_t nBgd = 0;
-  size_t bgdWidthX = MIN(pROI->bgdWidth, sizeX);
-  size_t bgdWidthY = MIN(pROI->bgdWidth, sizeY);
-  bool initial = true;
-  size_t yOffset = 0;
-
-  pROI->min = 0;
-  pROI->max = 0;
-  pROI->total = 0;
-  pROI->mean = 0;
-  pROI->net = 0;
-
-  if (pArray->ndims == 1) {
-    nElements = sizeX;
-    for (x=offsetX; x<offsetX+sizeX; ++x) {
-      value = (double)pData[x];
-      if (initial) {
-        pROI->min = value;
-        pROI->max = value;
-        initial = false;
-      }  
-      if (value < pROI->min) pROI->min = value;
-      if (value > pROI->max) pROI->max = value;
-      pROI->total += value;
+    typedef typename NDROIStatSum<epicsType>::sumType sumType;
+    const epicsType *pIn = pRow + pPvt->bounds[k];
+    size_t n = pPvt->bounds[k+1] - pPvt->bounds[k];
+    epicsType min = pIn[0], max = pIn[0];
+    sumType total = 0;
+
+    for (size_t i=0; i<n; i++) {
+        epicsType value = pIn[i];
+        min = (value < min) ? value : min;
+        max = (value > max) ? value : max;
+        total += value;
     }
-    if (pROI->bgdWidth > 0) {
-      for (x=offsetX; x<offsetX+bgdWidthX; ++x) {
-        nBgd++;
-        bgd += (double)pData[x];
-      }
-      for (x=offsetX+sizeX-bgdWidthX; x<offsetX+sizeX; ++x) {
-        nBgd++;
-        bgd += (double)pData[x];
-      }
-    }    
-  } else if (pArray->ndims == 2) {
-    nElements = sizeX * sizeY;
-    for (y=offsetY; y<offsetY+sizeY; ++y) {
-      yOffset = y*pROI->arraySize[0];
-      for (x=offsetX; x<offsetX+sizeX; ++x) {
-        value = (double)pData[x+yOffset];
-        if (initial) {
-          pROI->min = value;
-          pROI->max = value;
-          initial = false;
-        } 
-        if (value < pROI->min) pROI->min = value;
-        if (value > pROI->max) pROI->max = value;
-        pROI->total += value;
-      }
-    }
-    if (pROI->bgdWidth > 0) {
-      // Compute total counts in the bgdWidthY rows at the top
-      for (y=offsetY; y<offsetY+bgdWidthY; ++y) {
-        yOffset = y*pROI->arraySize[0];
-        for (x=offsetX; x<offsetX+sizeX; ++x) {
-          nBgd++;
-          bgd += (double)pData[x+yOffset];
-        }
-      }
-      // Compute total counts in the bgdWidthY rows at the bottom
-      for (y=offsetY+sizeY-bgdWidthY; y<offsetY+sizeY; ++y) {
-        yOffset = y*pROI->arraySize[0];
-        for (x=offsetX; x<offsetX+sizeX; ++x) {
-          nBgd++;
-          bgd += (double)pData[x+yOffset];
-        }
-      }
-      // Compute total counts in the bgdWidthX columns left and right
-      for (y=offsetY+bgdWidthY; y<offsetY+sizeY-bgdWidthY; ++y) {
-        yOffset = y*pROI->arraySize[0];
-        for (x=offsetX; x<offsetX+bgdWidthX; ++x) {
-          nBgd++;
-          bgd += (double)pData[x+yOffset];
+    pInterval->min = (double)min;
+    pInterval->max = (double)max;
+    pInterval->total = (double)total;
+}
+
+/** Function called by runTiles() to compute the statistics of bands first to first+count-1 */
+template <typename epicsType>
+static void computeBandsT(void *pvt, int first, int count)
+{
+    NDROIStatPvt_t *pPvt = (NDROIStatPvt_t *)pvt;
+    size_t numROIs = pPvt->rois.size();
+    size_t numIntervals = pPvt->bounds.size() - 1;
+
+    for (int band=first; band<first+count; band++) {
+        NDROIStatInterval_t *pIntervals = &pPvt->intervals[band*numIntervals];
+        NDROIStatPartial_t *pPartials = &pPvt->partials[band*numROIs];
+        size_t yStart = pPvt->yFirst + band*pPvt->yCount/pPvt->numBands;
+        size_t yEnd   = pPvt->yFirst + (band+1)*pPvt->yCount/pPvt->numBands;
+
+        for (size_t k=0; k<numIntervals; k++) pIntervals[k].row = (size_t)-1;
+        for (size_t r=0; r<numROIs; r++) {
+            memset(&pPartials[r], 0, sizeof(NDROIStatPartial_t));
         }
-        for (x=offsetX+sizeX-bgdWidthX; x<offsetX+sizeX; ++x) {
-          nBgd++;
-          bgd += (double)pData[x+yOffset];
+        for (size_t y=yStart; y<yEnd; y++) {
+            const epicsType *pRow = (const epicsType *)pPvt->pData + y*pPvt->rowStride;
+            for (size_t r=0; r<numROIs; r++) {
+                const NDROI_t *pROI = pPvt->rois[r];
+                NDROIStatPartial_t *pPartial = &pPartials[r];
+                const size_t *pK = &pPvt->roiIntervals[4*r];
+                double total = 0, left = 0, right = 0;
+                if ((y < pROI->offset[1]) || (y >= pROI->offset[1] + pROI->size[1])) continue;
+                for (size_t k=pK[0]; k<pK[3]; k++) {
+                    NDROIStatInterval_t *pInterval = &pIntervals[k];
+                    if (pInterval->row != y) {
+                        intervalStatsT<epicsType>(pRow, pPvt, k, pInterval);
+                        pInterval->row = y;
+                    }
+                    if (!pPartial->hasData) {
+                        pPartial->min = pInterval->min;
+                        pPartial->max = pInterval->max;
+                        pPartial->hasData = true;
+                    }
+                    if (pInterval->min < pPartial->min) pPartial->min = pInterval->min;
+                    if (pInterval->max > pPartial->max) pPartial->max = pInterval->max;
+                    total += pInterval->total;
+                    if (k < pK[1]) left += pInterval->total;
+                    if (k >= pK[2]) right += pInterval->total;
+                }
+                pPartial->total += total;
+                if (pROI->bgdWidth == 0) continue;
+                /* The background is the bgdWidthY rows at the top and bottom and the bgdWidthX columns
+                 * at the left and right of the rows between them */
+                if (y < pROI->offset[1] + pROI->bgdWidthY) {
+                    pPartial->bgd += total;
+                    pPartial->nBgd += pROI->size[0];
+                }
+                if (y >= pROI->offset[1] + pROI->size[1] - pROI->bgdWidthY) {
+                    pPartial->bgd += total;
+                    pPartial->nBgd += pROI->size[0];
+                }
+                if ((y >= pROI->offset[1] + pROI->bgdWidthY) &&
+                    (y < pROI->offset[1] + pROI->size[1] - pROI->bgdWidthY)) {
+                    pPartial->bgd += left + right;
+                    pPartial->nBgd += 2*pROI->bgdWidthX;
+                }
+            }
         }
-      }
     }
-  }
-
-  if (nBgd > 0) {
-    bgd = bgd/nBgd * nElements;
-  }
-  pROI->net = pROI->total - bgd;
-
-  if (nElements > 0) {
-    pROI->mean = pROI->total / nElements;
-  }
+}
 
-  return asynSuccess;
+/** Returns the computeBandsT() function for this data type, or NULL if it is invalid */
+static NDPluginTileFunc_t computeBandsFunc(NDDataType_t dataType)
+{
+    switch (dataType) {
+        case NDInt8:    return computeBandsT<epicsInt8>;
+        case NDUInt8:   return computeBandsT<epicsUInt8>;
+        case NDInt16:   return computeBandsT<epicsInt16>;
+        case NDUInt16:  return computeBandsT<epicsUInt16>;
+        case NDInt32:   return computeBandsT<epicsInt32>;
+        case NDUInt32:  return computeBandsT<epicsUInt32>;
+        case NDFloat32: return computeBandsT<epicsFloat32>;
+        case NDFloat64: return computeBandsT<epicsFloat64>;
+        default:        return NULL;
+    }
+}
 
+/** Index of the interval that starts at column x */
+static size_t intervalIndex(const std::vector<size_t> &bounds, size_t x)
+{
+    return std::lower_bound(bounds.begin(), bounds.end(), x) - bounds.begin();
 }
 
-     
 /**
- * Call the templated doComputeStatistics so we can cast correctly. 
- * \param[in] NDArray The pointer to the NDArray object
- * \param[in] NDROI The pointer to the NDROI object
+ * Computes the statistics of all of the ROIs that are in use in one pass over the array.
+ * \param[in] pArray The pointer to the NDArray object
+ * \param[in] pROIs The ROIs, with use, offset, size and bgdWidth set
+ * \param[in] numROIs The number of ROIs
+ * \param[in] tileThreads The number of threads to use
  * \return asynStatus
  */
-asynStatus NDPluginROIStat::doComputeStatistics(NDArray *pArray, NDROI *pROI)
+asynStatus NDPluginROIStat::doComputeStatistics(NDArray *pArray, NDROI_t *pROIs, int numROIs, int tileThreads)
 {
-  asynStatus status = asynSuccess;
-  
-  switch(pArray->dataType) {
-  case NDInt8:
-    status = doComputeStatisticsT<epicsInt8>(pArray, pROI);
-    break;
-  case NDUInt8:
-    status = doComputeStatisticsT<epicsUInt8>(pArray, pROI);
-    break;
-  case NDInt16:
-    status = doComputeStatisticsT<epicsInt16>(pArray, pROI);
-    break;
-  case NDUInt16:
-    status = doComputeStatisticsT<epicsUInt16>(pArray, pROI);
-    break;
-  case NDInt32:
-    status = doComputeStatisticsT<epicsInt32>(pArray, pROI);
-    break;
-  case NDUInt32:
-    status = doComputeStatisticsT<epicsUInt32>(pArray, pROI);
-    break;
-  case NDFloat32:
-    status = doComputeStatisticsT<epicsFloat32>(pArray, pROI);
-    break;
-  case NDFloat64:
-    status = doComputeStatisticsT<epicsFloat64>(pArray, pROI);
-    break;
-  default:
-    return asynError;
-    break;
+  NDROIStatPvt_t pvt;
+  NDPluginTileFunc_t computeFunc = computeBandsFunc(pArray->dataType);
+  size_t yEnd = 0;
+  size_t numIntervals;
+
+  if (!computeFunc) return asynError;
+
+  pvt.yFirst = (size_t)-1;
+  for (int roi=0; roi<numROIs; roi++) {
+    NDROI_t *pROI = &pROIs[roi];
+    if (!pROI->use) continue;
+    pROI->min = 0;
+    pROI->max = 0;
+    pROI->total = 0;
+    pROI->mean = 0;
+    pROI->net = 0;
+    if ((pArray->ndims < 1) || (pArray->ndims > 2)) continue;
+    if (pArray->ndims == 1) {
+      /* A 1-D array is one row, and its background is only at the left and right */
+      pROI->offset[1] = 0;
+      pROI->size[1] = 1;
+      pROI->bgdWidthY = 0;
+    } else {
+      pROI->bgdWidthY = MIN(pROI->bgdWidth, pROI->size[1]);
+    }
+    pROI->bgdWidthX = MIN(pROI->bgdWidth, pROI->size[0]);
+    pvt.rois.push_back(pROI);
+    pvt.bounds.push_back(pROI->offset[0]);
+    pvt.bounds.push_back(pROI->offset[0] + pROI->bgdWidthX);
+    pvt.bounds.push_back(pROI->offset[0] + pROI->size[0] - pROI->bgdWidthX);
+    pvt.bounds.push_back(pROI->offset[0] + pROI->size[0]);
+    pvt.yFirst = MIN(pvt.yFirst, pROI->offset[1]);
+    yEnd = MAX(yEnd, pROI->offset[1] + pROI->size[1]);
   }
-  return status;
+  if (pvt.rois.empty()) return asynSuccess;
+
+  std::sort(pvt.bounds.begin(), pvt.bounds.end());
+  pvt.bounds.erase(std::unique(pvt.bounds.begin(), pvt.bounds.end()), pvt.bounds.end());
+  numIntervals = pvt.bounds.size() - 1;
+  for (size_t r=0; r<pvt.rois.size(); r++) {
+    NDROI_t *pROI = pvt.rois[r];
+    pvt.roiIntervals.push_back(intervalIndex(pvt.bounds, pROI->offset[0]));
+    pvt.roiIntervals.push_back(intervalIndex(pvt.bounds, pROI->offset[0] + pROI->bgdWidthX));
+    pvt.roiIntervals.push_back(intervalIndex(pvt.bounds, pROI->offset[0] + pROI->size[0] - pROI->bgdWidthX));
+    pvt.roiIntervals.push_back(intervalIndex(pvt.bounds, pROI->offset[0] + pROI->size[0]));
+  }
+  pvt.pData = pArray->pData;
+  pvt.rowStride = pArray->dims[0].size;
+  pvt.yCount = yEnd - pvt.yFirst;
+  if (tileThreads < 1) tileThreads = 1;
+  if ((size_t)tileThreads > pvt.yCount) tileThreads = (int)pvt.yCount;
+  pvt.numBands = tileThreads;
+  pvt.intervals.resize(pvt.numBands * numIntervals);
+  pvt.partials.resize(pvt.numBands * pvt.rois.size());
+
+  runTiles(pvt.numBands, pvt.numBands, computeFunc, &pvt);
+
+  for (size_t r=0; r<pvt.rois.size(); r++) {
+    NDROI_t *pROI = pvt.rois[r];
+    size_t nElements = pROI->size[0] * pROI->size[1];
+    double bgd = 0;
+    size_t nBgd = 0;
+    bool hasData = false;
+    for (int band=0; band<pvt.numBands; band++) {
+      NDROIStatPartial_t *pPartial = &pvt.partials[band*pvt.rois.size() + r];
+      if (!pPartial->hasData) continue;
+      if (!hasData) {
+        pROI->min = pPartial->min;
+        pROI->max = pPartial->max;
+        hasData = true;
+      }
+      if (pPartial->min < pROI->min) pROI->min = pPartial->min;
+      if (pPartial->max > pROI->max) pROI->max = pPartial->max;
+      pROI->total += pPartial->total;
+      bgd += pPartial->bgd;
+      nBgd += pPartial->nBgd;
+    }
+    if (nBgd > 0) {
+      bgd = bgd/nBgd * nElements;
+    }
+    pROI->net = pROI->total - bgd;
+    if (nElements > 0) {
+      pROI->mean = pROI->total / nElements;
+    }
+  }
+
+  return asynSuccess;
 }
 
 
@@ -210,9 +309,10 @@ void NDPluginROIStat::processCallbacks(NDArray *pArray)
   asynStatus status = asynSuccess;
   NDROI *pROI;
   int TSAcquiring;
+  int tileThreads;
   const char* functionName = "NDPluginROIStat::processCallbacks";
-  NDROI_t *pROIs = new NDROI[maxROIs_];
-  if(!pROIs) {cantProceed("%s",functionName);}
+  std::vector<NDROI_t> rois(maxROIs_);
+  NDROI_t *pROIs = &rois[0];
 
   /* Call the base class method */
   NDPluginDriver::beginProcessCallbacks(pArray);
@@ -227,6 +327,7 @@ void NDPluginROIStat::processCallbacks(NDArray *pArray)
   //Set NDArraySize params to the input pArray, because this plugin doesn't change them
   if (pArray->ndims > 0) setIntegerParam(NDArraySizeX, (int)pArray->dims[0].size);
   if (pArray->ndims > 1) setIntegerParam(NDArraySizeY, (int)pArray->dims[1].size);
+  getIntegerParam(NDPluginROIStatTileThreads, &tileThreads);
 
   /* Loop over the ROIs in this driver */
   for (int roi=0; roi<maxROIs_; ++roi) {
@@ -271,17 +372,11 @@ void NDPluginROIStat::processCallbacks(NDArray *pArray)
    * pPvt that other threads can access. */
   this->unlock();
     
-  for (int roi=0; roi<maxROIs_; ++roi) {
-    pROI = &pROIs[roi];
-    if (!pROI->use) {
-      continue;
-    }
-    status = doComputeStatistics(pArray, pROI);
-    if (status != asynSuccess) {
-      asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR, 
-        "%s: doComputeStatistics failed. status=%d\n", 
-        functionName, status);
-    }
+  status = doComputeStatistics(pArray, pROIs, maxROIs_, tileThreads);
+  if (status != asynSuccess) {
+    asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR, 
+      "%s: doComputeStatistics failed. status=%d\n", 
+      functionName, status);
   }
 
   /* We must enter the loop and exit with the mutex locked */
@@ -327,7 +422,6 @@ void NDPluginROIStat::processCallbacks(NDArray *pArray)
 
   NDPluginDriver::endProcessCallbacks(pArray, true, true);
   callParamCallbacks();
-  delete[] pROIs;
 }
 
 /** Called when asyn clients call pasynInt32->write().
@@ -532,6 +626,8 @@ NDPluginROIStat::NDPluginROIStat(const char *portName, int queueSize, int blocki
   createParam(NDPluginROIStatTSNetString,        asynParamFloat64Array, &NDPluginROIStatTSNet);
   createParam(NDPluginROIStatTSTimestampString,  asynParamFloat64Array, &NDPluginROIStatTSTimestamp);
 
+  createParam(NDPluginROIStatTileThreadsString,         asynParamInt32, &NDPluginROIStatTileThreads);
+
   createParam(NDPluginROIStatLastString,              asynParamInt32, &NDPluginROIStatLast);
   
   //Note: params set to a default value here will overwrite a default database value
@@ -567,6 +663,7 @@ NDPluginROIStat::NDPluginROIStat(const char *portName, int queueSize, int blocki
 
   numTSPoints_ = DEFAULT_NUM_TSPOINTS;
   setIntegerParam(NDPluginROIStatTSNumPoints, numTSPoints_);
+  setIntegerParam(NDPluginROIStatTileThreads, 1);
   timeSeries_ = (double *)calloc(MAX_TIME_SERIES_TYPES*maxROIs_*numTSPoints_, sizeof(double));
   
   /* Try to connect to the array port */
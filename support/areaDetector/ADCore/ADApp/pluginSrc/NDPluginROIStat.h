@@ -48,6 +48,8 @@
 #define NDPluginROIStatTSNetString              "ROISTAT_TS_NET"            /* (asynFloat64Array, r/o) Series of net */
 #define NDPluginROIStatTSTimestampString        "ROISTAT_TS_TIMESTAMP"      /* (asynFloat64Array, r/o) Series of timestamps */
 
+#define NDPluginROIStatTileThreadsString        "TILE_THREADS"              /* (asynInt32,        r/w) Number of threads computing each array */
+
 typedef enum {
     TSMinValue,
     TSMaxValue,
@@ -77,6 +79,8 @@ typedef struct NDROI {
     double max;
     double net;
     size_t arraySize[2];
+    size_t bgdWidthX;   /* Width of the background columns, at most size[0] */
+    size_t bgdWidthY;   /* Height of the background rows, at most size[1] */
 } NDROI_t;
 
 
@@ -132,13 +136,14 @@ protected:
     int NDPluginROIStatTSTotal;
     int NDPluginROIStatTSNet;
     int NDPluginROIStatTSTimestamp;
+
+    int NDPluginROIStatTileThreads;
     
     int NDPluginROIStatLast;
                                 
 private:
 
-    template <typename epicsType> asynStatus doComputeStatisticsT(NDArray *pArray, NDROI_t *pROI);
-    asynStatus doComputeStatistics(NDArray *pArray, NDROI_t *pStats);
+    asynStatus doComputeStatistics(NDArray *pArray, NDROI_t *pROIs, int numROIs, int tileThreads);
     asynStatus clear(epicsUInt32 roi);
     void doTimeSeriesCallbacks();
 
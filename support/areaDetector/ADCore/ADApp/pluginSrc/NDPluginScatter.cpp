@@ -8,6 +8,9 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
 
 #include <epicsTypes.h>
 #include <epicsMessageQueue.h>
@@ -23,6 +26,24 @@
 
 static const char *driverName="NDPluginScatter";
 
+/** A client of the NDArray callbacks and its load when an array is sent */
+typedef struct {
+    asynGenericPointerInterrupt *pInterrupt;
+    int client;         /**< Position of the client in the list of clients */
+    int numArrays;      /**< Arrays queued or being processed by the client, 0 if it is not a plugin */
+    double latency;     /**< Expected time until the client would process an array */
+} NDScatterClient_t;
+
+static bool shorterQueue(const NDScatterClient_t &lhs, const NDScatterClient_t &rhs)
+{
+    return lhs.numArrays < rhs.numArrays;
+}
+
+static bool lowerLatency(const NDScatterClient_t &lhs, const NDScatterClient_t &rhs)
+{
+    return lhs.latency < rhs.latency;
+}
+
 /** 
   * \param[in] pArray  The NDArray from the callback.
   */
@@ -33,6 +54,9 @@ void NDPluginScatter::processCallbacks(NDArray *pArray)
      * structures don't need to be protected.
      */
     int arrayCallbacks;
+    int method;
+    int client;
+    std::vector<epicsInt32> clientLoad;
 
     static const char *functionName = "NDPluginScatter::processCallbacks";
 
@@ -40,15 +64,20 @@ void NDPluginScatter::processCallbacks(NDArray *pArray)
     NDPluginDriver::beginProcessCallbacks(pArray);
 
     getIntegerParam(NDArrayCallbacks, &arrayCallbacks);
+    getIntegerParam(NDPluginScatterMethod, &method);
     if (arrayCallbacks == 1) {
         NDArray *pArrayOut = this->pNDArrayPool->copy(pArray, NULL, 1);
         if (NULL != pArrayOut) {
             this->getAttributes(pArrayOut->pAttributeList);
             this->unlock();
-            doNDArrayCallbacks(pArrayOut, NDArrayData, 0);
+            client = doNDArrayCallbacks(pArrayOut, NDArrayData, 0, method, clientLoad);
             this->lock();
             if (this->pArrays[0]) this->pArrays[0]->release();
             this->pArrays[0] = pArrayOut;
+            /* Statistics for each client */
+            this->clientLoad_ = clientLoad;
+            if (this->arraysSent_.size() < clientLoad.size()) this->arraysSent_.resize(clientLoad.size(), 0);
+            if (client >= 0) this->arraysSent_[client]++;
         }
         else {
             asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR, 
@@ -58,40 +87,94 @@ void NDPluginScatter::processCallbacks(NDArray *pArray)
     }
 }
 
-/** Called by driver to do the callbacks to the next registered client on the asynGenericPointer interface.
+/** Called by driver to do the callbacks to one registered client on the asynGenericPointer interface.
+  * The clients are tried in round-robin order starting after the last client that an array was sent to.
+  * For the NDScatterShortestQueue and NDScatterLowestLatency methods they are first sorted by the load
+  * of the plugins, so clients with the same load are still used in turn.  A client whose queue is full
+  * is skipped.
   * \param[in] pArray Pointer to the NDArray 
   * \param[in] reason A client will be called if reason matches pasynUser->reason registered for that client.
-  * \param[in] address A client will be called if address matches the address registered for that client. */
-asynStatus NDPluginScatter::doNDArrayCallbacks(NDArray *pArray, int reason, int address)
+  * \param[in] address A client will be called if address matches the address registered for that client.
+  * \param[in] method The NDScatterMethod_t used to choose the client.
+  * \param[out] clientLoad The number of arrays queued by each client before the array was sent.
+  * \return The position of the client the array was sent to in the list of clients, or -1 if it was dropped. */
+int NDPluginScatter::doNDArrayCallbacks(NDArray *pArray, int reason, int address, int method,
+                                        std::vector<epicsInt32> &clientLoad)
 {
     ELLLIST *pclientList;
     interruptNode *pnode;
     int addr;
     int numNodes;
     int i;
+    int sentTo = -1;
+    NDScatterClient_t client;
+    std::vector<NDScatterClient_t> clients;
+    NDPluginDriver *pPlugin;
     //static const char *functionName = "doNDArrayCallbacks";
 
     pasynManager->interruptStart(this->asynStdInterfaces.genericPointerInterruptPvt, &pclientList);
     numNodes = ellCount(pclientList);
+    clientLoad.assign(numNodes, 0);
+    if (nextClient_ > numNodes) nextClient_ = 1;
     for (i=0; i<numNodes; i++) {
-        if (nextClient_ > numNodes) nextClient_ = 1;
-        pnode = (interruptNode *)ellNth(pclientList, nextClient_);
-        nextClient_++;
-        asynGenericPointerInterrupt *pInterrupt = (asynGenericPointerInterrupt *)pnode->drvPvt;
-        pasynManager->getAddr(pInterrupt->pasynUser, &addr);
+        client.client = (nextClient_ - 1 + i) % numNodes;
+        pnode = (interruptNode *)ellNth(pclientList, client.client + 1);
+        client.pInterrupt = (asynGenericPointerInterrupt *)pnode->drvPvt;
+        pasynManager->getAddr(client.pInterrupt->pasynUser, &addr);
         /* If this is not a multi-device then address is -1, change to 0 */
         if (addr == -1) addr = 0;
-        if ((pInterrupt->pasynUser->reason != reason) || (address != addr)) continue;
+        if ((client.pInterrupt->pasynUser->reason != reason) || (address != addr)) continue;
+        client.numArrays = 0;
+        client.latency = 0.;
+        pPlugin = NDPluginDriver::arrayClientPlugin(client.pInterrupt->callback, client.pInterrupt->userPvt);
+        if (pPlugin) pPlugin->getLoad(&client.numArrays, &client.latency);
+        clientLoad[client.client] = client.numArrays;
+        clients.push_back(client);
+    }
+    if (method == NDScatterShortestQueue) {
+        std::stable_sort(clients.begin(), clients.end(), shorterQueue);
+    } else if (method == NDScatterLowestLatency) {
+        std::stable_sort(clients.begin(), clients.end(), lowerLatency);
+    }
+    for (i=0; i<(int)clients.size(); i++) {
+        asynGenericPointerInterrupt *pInterrupt = clients[i].pInterrupt;
         /* Set pasynUser->auxStatus to asynOverflow.  
          * This is a flag that means return without generating an error if the queue is full.
          * We don't set this for the last node because if the last node cannot queue the array
          * then the array will be dropped */
         pInterrupt->pasynUser->auxStatus = asynOverflow;
-        if (i == numNodes-1) pInterrupt->pasynUser->auxStatus = asynSuccess;
+        if (i == (int)clients.size()-1) pInterrupt->pasynUser->auxStatus = asynSuccess;
         pInterrupt->callback(pInterrupt->userPvt, pInterrupt->pasynUser, pArray);
-        if (pInterrupt->pasynUser->auxStatus == asynSuccess) break;
+        if (pInterrupt->pasynUser->auxStatus == asynSuccess) {
+            sentTo = clients[i].client;
+            nextClient_ = sentTo + 2;
+            break;
+        }
     }
     pasynManager->interruptEnd(this->asynStdInterfaces.genericPointerInterruptPvt);
+    return sentTo;
+}
+
+/** Called when asyn clients call pasynInt32Array->read().
+  * Returns the number of arrays sent to each client, and the load of each client when the last array was sent.
+  * For other parameters it calls NDPluginDriver::readInt32Array.
+  * \param[in] pasynUser pasynUser structure that encodes the reason and address.
+  * \param[out] value Array to read.
+  * \param[in] nElements Number of elements to read.
+  * \param[out] nIn Number of elements actually read. */
+asynStatus NDPluginScatter::readInt32Array(asynUser *pasynUser, epicsInt32 *value,
+                                           size_t nElements, size_t *nIn)
+{
+    int function = pasynUser->reason;
+    std::vector<epicsInt32> *pValues;
+
+    if ((function != NDPluginScatterArraysSent) && (function != NDPluginScatterClientLoad)) {
+        return NDPluginDriver::readInt32Array(pasynUser, value, nElements, nIn);
+    }
+    pValues = (function == NDPluginScatterArraysSent) ? &this->arraysSent_ : &this->clientLoad_;
+    *nIn = pValues->size();
+    if (*nIn > nElements) *nIn = nElements;
+    if (*nIn > 0) memcpy(value, &(*pValues)[0], *nIn*sizeof(*value));
     return asynSuccess;
 }
 
@@ -128,6 +211,12 @@ NDPluginScatter::NDPluginScatter(const char *portName, int queueSize, int blocki
     //static const char *functionName = "NDPluginScatter::NDPluginScatter";
 
     createParam(NDPluginScatterMethodString,         asynParamInt32,        &NDPluginScatterMethod);
+    createParam(NDPluginScatterArraysSentString,     asynParamInt32Array,   &NDPluginScatterArraysSent);
+    createParam(NDPluginScatterClientLoadString,     asynParamInt32Array,   &NDPluginScatterClientLoad);
+    setIntegerParam(NDPluginScatterMethod, NDScatterRoundRobin);
+
+    /* Arrays are passed on unchanged, so compressed arrays are accepted */
+    this->compressionAware_ = true;
 
     /* Set the plugin type string */
     setStringParam(NDPluginDriverPluginType, "NDPluginScatter");
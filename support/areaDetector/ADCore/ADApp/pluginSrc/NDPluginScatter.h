@@ -1,12 +1,24 @@
 #ifndef NDPluginScatter_H
 #define NDPluginScatter_H
 
+#include <vector>
+
 #include "NDPluginDriver.h"
 
+/** Algorithms for choosing the client to send each array to */
+typedef enum {
+    NDScatterRoundRobin,        /**< Each client in turn */
+    NDScatterShortestQueue,     /**< The plugin with the fewest arrays queued or being processed */
+    NDScatterLowestLatency      /**< The plugin expected to process the array soonest, from its queue and execution time */
+} NDScatterMethod_t;
+
 /* General parameters */
 #define NDPluginScatterMethodString          "SCATTER_METHOD"            /* (asynInt32,        r/w) Algorithm for scatter */
+#define NDPluginScatterArraysSentString      "SCATTER_ARRAYS_SENT"       /* (asynInt32Array,   r/o) Arrays sent to each client */
+#define NDPluginScatterClientLoadString      "SCATTER_CLIENT_LOAD"       /* (asynInt32Array,   r/o) Arrays queued by each client */
 
-/** A plugin that does callbacks in round-robin fashion rather than passing every NDArray to every callback client  */
+/** A plugin that passes each NDArray to one callback client rather than to every callback client.
+  * Clients that are plugins can be chosen by the number of arrays in their queues or their expected latency. */
 class epicsShareClass NDPluginScatter : public NDPluginDriver {
 public:
     NDPluginScatter(const char *portName, int queueSize, int blockingCallbacks, 
@@ -15,14 +27,20 @@ public:
                       int priority, int stackSize);
     /* These methods override the virtual methods in the base class */
     void processCallbacks(NDArray *pArray);
+    virtual asynStatus readInt32Array(asynUser *pasynUser, epicsInt32 *value,
+                                      size_t nElements, size_t *nIn);
 
 protected:
     int NDPluginScatterMethod;
     #define FIRST_NDPLUGIN_SCATTER_PARAM NDPluginScatterMethod
+    int NDPluginScatterArraysSent;
+    int NDPluginScatterClientLoad;
                                 
 private:
     int nextClient_;
-    asynStatus doNDArrayCallbacks(NDArray *pArray, int reason, int addr);
+    std::vector<epicsInt32> arraysSent_;
+    std::vector<epicsInt32> clientLoad_;
+    int doNDArrayCallbacks(NDArray *pArray, int reason, int addr, int method, std::vector<epicsInt32> &clientLoad);
 };
     
 #endif
@@ -12,6 +12,8 @@
 #include <stdio.h>
 #include <math.h>
 
+#include <vector>
+
 #include <epicsTypes.h>
 #include <epicsMessageQueue.h>
 #include <epicsThread.h>
@@ -35,185 +37,320 @@
 
 static const char *driverName="NDPluginStats";
 
+/* On x86-64 Linux the tile kernel is compiled for AVX-512, AVX2 and baseline x86-64,
+ * and the best version for the CPU is selected when the library is loaded. */
+#if defined(__GNUC__) && !defined(__clang__) && (__GNUC__ >= 8) && defined(__x86_64__) && defined(__linux__)
+  #define NDSTATS_TARGET_CLONES __attribute__((target_clones("avx512f","avx2","default")))
+#else
+  #define NDSTATS_TARGET_CLONES
+#endif
+
+/* Accumulator types for the sums over one row.  8 and 16 bit data are summed exactly in
+ * integers, which the compiler can vectorize; the square of a 16 bit value always fits in
+ * 32 bits, even when computed modulo 2^32 from a negative value.  Other types use double. */
+template <typename epicsType> struct NDStatsRowSum {
+    typedef double sumType;
+    typedef double sumSquaresType;
+    static double square(epicsType value) { return (double)value * (double)value; }
+};
+#define NDSTATS_INTEGER_ROW_SUM(epicsType) \
+template <> struct NDStatsRowSum<epicsType> { \
+    typedef epicsInt64 sumType; \
+    typedef epicsUInt64 sumSquaresType; \
+    static epicsUInt32 square(epicsType value) { return (epicsUInt32)value * (epicsUInt32)value; } \
+};
+NDSTATS_INTEGER_ROW_SUM(epicsInt8)
+NDSTATS_INTEGER_ROW_SUM(epicsUInt8)
+NDSTATS_INTEGER_ROW_SUM(epicsInt16)
+NDSTATS_INTEGER_ROW_SUM(epicsUInt16)
+
+/** Computes the statistics, the sums for the centroid and average profiles, and the histogram
+  * for a band of rows in one pass over the data.  Each row is read once from memory; the separate
+  * loops over the row run from the cache, and have no branches so they can be vectorized. */
 template <typename epicsType>
-asynStatus NDPluginStats::doComputeHistogramT(NDArray *pArray, NDStats_t *pStats)
+NDSTATS_TARGET_CLONES
+static void computeTileT(const epicsType *pData, size_t sizeX, NDStats_t *pStats, NDStatsTile_t *pTile)
 {
-    epicsType *pData = (epicsType *)pArray->pData;
-    size_t i;
-    double scale, entropy;
-    int bin;
-    size_t nElements;
-    double value, counts;
-    NDArrayInfo arrayInfo;
-
-    pArray->getInfo(&arrayInfo);
-    nElements = arrayInfo.nElements;
-    scale = pStats->histSize / (pStats->histMax - pStats->histMin);
-
-    pStats->histBelow = 0;
-    pStats->histAbove = 0;
-    for (i=0; i<nElements; i++) {
-        value = (double)pData[i];
-        bin = (int)(((value - pStats->histMin) * scale) + 0.5);
-        if ((bin < 0) || (value < pStats->histMin))
-            pStats->histBelow++;
-        else if ((bin > (int)pStats->histSize-1) || (value > pStats->histMax))
-            pStats->histAbove++;
-        else 
-            pStats->histogram[bin]++;
+    typedef typename NDStatsRowSum<epicsType>::sumType sumType;
+    typedef typename NDStatsRowSum<epicsType>::sumSquaresType sumSquaresType;
+    const epicsType *pRow = pData + pTile->firstRow*sizeX;
+    size_t ix, iy, minRow, maxRow;
+    epicsType tileMin = pRow[0], tileMax = pRow[0];
+    double threshold = pStats->centroidThreshold;
+    double histMin = pStats->histMin, histMax = pStats->histMax;
+    double scale = pStats->histSize / (pStats->histMax - pStats->histMin);
+    double *pAverageX = pTile->profileX[profAverage];
+    double *pThresholdX = pTile->profileX[profThreshold];
+    double *pMomentX = pTile->momentX;
+    int histSize = pStats->histSize;
+
+    minRow = maxRow = pTile->firstRow;
+    for (iy=pTile->firstRow; iy<pTile->firstRow+pTile->numRows; iy++, pRow+=sizeX) {
+        if (pStats->computeStatistics) {
+            epicsType rowMin = pRow[0], rowMax = pRow[0];
+            sumType rowSum = 0;
+            sumSquaresType rowSumSquares = 0;
+            for (ix=0; ix<sizeX; ix++) {
+                epicsType value = pRow[ix];
+                rowMin = (value < rowMin) ? value : rowMin;
+                rowMax = (value > rowMax) ? value : rowMax;
+                rowSum += value;
+                rowSumSquares += NDStatsRowSum<epicsType>::square(value);
+            }
+            if (rowMin < tileMin) {
+                tileMin = rowMin;
+                minRow = iy;
+            }
+            if (rowMax > tileMax) {
+                tileMax = rowMax;
+                maxRow = iy;
+            }
+            pTile->total += (double)rowSum;
+            pTile->sumSquares += (double)rowSumSquares;
+        }
+        if (pStats->computeCentroid) {
+            sumType rowAverage = 0, rowThreshold = 0;
+            double dy = (double)iy;
+            for (ix=0; ix<sizeX; ix++) {
+                double value = (double)pRow[ix];
+                double thresholded = (value >= threshold) ? value : 0.;
+                pAverageX[ix]   += value;
+                pThresholdX[ix] += thresholded;
+                pMomentX[ix]    += thresholded * dy;
+            }
+            for (ix=0; ix<sizeX; ix++) {
+                epicsType value = pRow[ix];
+                rowAverage   += value;
+                rowThreshold += ((double)value >= threshold) ? value : 0;
+            }
+            pStats->profileY[profAverage][iy]   = (double)rowAverage;
+            pStats->profileY[profThreshold][iy] = (double)rowThreshold;
+        }
+        if (pStats->computeHistogram) {
+            for (ix=0; ix<sizeX; ix++) {
+                double value = (double)pRow[ix];
+                int bin = (int)(((value - histMin) * scale) + 0.5);
+                if ((bin < 0) || (value < histMin))
+                    pTile->histBelow++;
+                else if ((bin > histSize-1) || (value > histMax))
+                    pTile->histAbove++;
+                else 
+                    pTile->histogram[bin]++;
+            }
+        }
     }
-
-    entropy = 0;
-    for (i=0; (int)i<pStats->histSize; i++) {
-        counts = pStats->histogram[i];
-        if (counts <= 0) counts = 1;
-        entropy += counts * log(counts);
+    if (pStats->computeStatistics) {
+        /* Find the first element in the row holding the minimum and maximum */
+        const epicsType *pMin = pData + minRow*sizeX, *pMax = pData + maxRow*sizeX;
+        for (ix=0; (ix<sizeX-1) && (pMin[ix] != tileMin); ix++);
+        pTile->min = (double)tileMin;
+        pTile->minIndex = minRow*sizeX + ix;
+        for (ix=0; (ix<sizeX-1) && (pMax[ix] != tileMax); ix++);
+        pTile->max = (double)tileMax;
+        pTile->maxIndex = maxRow*sizeX + ix;
     }
-    entropy = -entropy / nElements;
-    pStats->histEntropy = entropy;
-    
-    return(asynSuccess);
 }
 
-asynStatus NDPluginStats::doComputeHistogram(NDArray *pArray, NDStats_t *pStats)
+void NDPluginStats::doComputeTile(NDArray *pArray, NDStats_t *pStats, NDStatsTile_t *pTile)
 {
-    asynStatus status;
-    
+    size_t sizeX = pArray->dims[0].size;
+
     switch(pArray->dataType) {
         case NDInt8:
-            status = doComputeHistogramT<epicsInt8>(pArray, pStats);
+            computeTileT<epicsInt8>((epicsInt8 *)pArray->pData, sizeX, pStats, pTile);
             break;
         case NDUInt8:
-            status = doComputeHistogramT<epicsUInt8>(pArray, pStats);
+            computeTileT<epicsUInt8>((epicsUInt8 *)pArray->pData, sizeX, pStats, pTile);
             break;
         case NDInt16:
-            status = doComputeHistogramT<epicsInt16>(pArray, pStats);
+            computeTileT<epicsInt16>((epicsInt16 *)pArray->pData, sizeX, pStats, pTile);
             break;
         case NDUInt16:
-            status = doComputeHistogramT<epicsUInt16>(pArray, pStats);
+            computeTileT<epicsUInt16>((epicsUInt16 *)pArray->pData, sizeX, pStats, pTile);
             break;
         case NDInt32:
-            status = doComputeHistogramT<epicsInt32>(pArray, pStats);
+            computeTileT<epicsInt32>((epicsInt32 *)pArray->pData, sizeX, pStats, pTile);
             break;
         case NDUInt32:
-            status = doComputeHistogramT<epicsUInt32>(pArray, pStats);
+            computeTileT<epicsUInt32>((epicsUInt32 *)pArray->pData, sizeX, pStats, pTile);
             break;
         case NDFloat32:
-            status = doComputeHistogramT<epicsFloat32>(pArray, pStats);
+            computeTileT<epicsFloat32>((epicsFloat32 *)pArray->pData, sizeX, pStats, pTile);
             break;
         case NDFloat64:
-            status = doComputeHistogramT<epicsFloat64>(pArray, pStats);
+            computeTileT<epicsFloat64>((epicsFloat64 *)pArray->pData, sizeX, pStats, pTile);
             break;
         default:
-            status = asynError;
         break;
     }
-    return(status);
 }
 
-template <typename epicsType>
-void NDPluginStats::doComputeStatisticsT(NDArray *pArray, NDStats_t *pStats)
+typedef struct {
+    NDPluginStats *pPlugin;
+    NDArray *pArray;
+    NDStats_t *pStats;
+    NDStatsTile_t *pTiles;
+} NDStatsTiles_t;
+
+static void computeTiles(void *pvt, int first, int count)
 {
-    size_t i, imin, imax;
-    epicsType *pData = (epicsType *)pArray->pData;
+    NDStatsTiles_t *pTiles = (NDStatsTiles_t *)pvt;
+    int t;
+
+    for (t=first; t<first+count; t++) {
+        pTiles->pPlugin->doComputeTile(pTiles->pArray, pTiles->pStats, &pTiles->pTiles[t]);
+    }
+}
+
+/** Computes the statistics, centroid sums, average profiles and histogram requested by the compute
+  * flags in pStats in a single pass over the array.  The rows are divided into numTiles bands,
+  * which are computed by runTiles().
+  * \param[in] pArray The NDArray.
+  * \param[in,out] pStats The flags and parameters, and the results.
+  * \param[in] numTiles The number of bands of rows. */
+asynStatus NDPluginStats::doComputeTiles(NDArray *pArray, NDStats_t *pStats, int numTiles)
+{
+    std::vector<NDStatsTile_t> tiles;
+    NDStatsTiles_t tilesPvt;
     NDArrayInfo arrayInfo;
-    double value;
+    size_t sizeX, numRows, row, ix;
+    int i, t;
+    int computeCentroid = pStats->computeCentroid;
 
+    if (pArray->ndims < 1) return asynError;
+    /* The centroid and profiles are only defined for 1-D and 2-D arrays */
+    if (pArray->ndims > 2) pStats->computeCentroid = 0;
     pArray->getInfo(&arrayInfo);
+    sizeX = pArray->dims[0].size;
+    numRows = (sizeX > 0) ? arrayInfo.nElements / sizeX : 0;
+    if (numRows < 1) return asynError;
+    if (numTiles < 1) numTiles = 1;
+    if ((size_t)numTiles > numRows) numTiles = (int)numRows;
+
+    tiles.resize(numTiles);
+    for (t=0, row=0; t<numTiles; t++) {
+        NDStatsTile_t *pTile = &tiles[t];
+        memset(pTile, 0, sizeof(*pTile));
+        pTile->firstRow = row;
+        pTile->numRows = numRows/numTiles + (((size_t)t < numRows%numTiles) ? 1 : 0);
+        row += pTile->numRows;
+        if (pStats->computeCentroid) {
+            for (i=0; i<=profThreshold; i++) {
+                pTile->profileX[i] = (t == 0) ? pStats->profileX[i] : (double *)calloc(sizeX, sizeof(double));
+            }
+            pTile->momentX = (double *)calloc(sizeX, sizeof(double));
+        }
+        if (pStats->computeHistogram) {
+            pTile->histogram = (t == 0) ? pStats->histogram : (double *)calloc(pStats->histSize, sizeof(double));
+        }
+    }
+
+    tilesPvt.pPlugin = this;
+    tilesPvt.pArray = pArray;
+    tilesPvt.pStats = pStats;
+    tilesPvt.pTiles = &tiles[0];
+    runTiles(numTiles, numTiles, computeTiles, &tilesPvt);
+
+    /* Merge the bands in order, so the first minimum and maximum are found as in a single pass */
     pStats->nElements = arrayInfo.nElements;
-    pStats->min = (double) pData[0];
-    imin = 0;
-    pStats->max = (double) pData[0];
-    imax = 0;
+    pStats->min = tiles[0].min;
+    pStats->max = tiles[0].max;
     pStats->total = 0.;
     pStats->sigma = 0.;
-    for (i=0; i<pStats->nElements; i++) {
-        value = (double)pData[i];
-        if (value < pStats->min) {
-            pStats->min = value;
-            imin = i;
+    pStats->histBelow = 0;
+    pStats->histAbove = 0;
+    size_t minIndex = tiles[0].minIndex, maxIndex = tiles[0].maxIndex;
+    double momentXY = 0.;
+    for (t=0; t<numTiles; t++) {
+        NDStatsTile_t *pTile = &tiles[t];
+        if (pTile->min < pStats->min) {
+            pStats->min = pTile->min;
+            minIndex = pTile->minIndex;
+        }
+        if (pTile->max > pStats->max) {
+            pStats->max = pTile->max;
+            maxIndex = pTile->maxIndex;
+        }
+        pStats->total += pTile->total;
+        pStats->sigma += pTile->sumSquares;
+        if (pStats->computeCentroid) {
+            for (ix=0; ix<sizeX; ix++) {
+                if (t > 0) {
+                    pStats->profileX[profAverage][ix]   += pTile->profileX[profAverage][ix];
+                    pStats->profileX[profThreshold][ix] += pTile->profileX[profThreshold][ix];
+                }
+                momentXY += pTile->momentX[ix] * ix;
+            }
+            if (t > 0) {
+                free(pTile->profileX[profAverage]);
+                free(pTile->profileX[profThreshold]);
+            }
+            free(pTile->momentX);
         }
-        if (value > pStats->max) {
-            pStats->max = value;
-            imax = i; 
+        if (pStats->computeHistogram) {
+            pStats->histBelow += pTile->histBelow;
+            pStats->histAbove += pTile->histAbove;
+            if (t > 0) {
+                for (i=0; i<pStats->histSize; i++) {
+                    pStats->histogram[i] += pTile->histogram[i];
+                }
+                free(pTile->histogram);
+            }
         }
-        pStats->total += value;
-        pStats->sigma += value * value;
     }
-    pStats->minX = imin % arrayInfo.xSize;
-    pStats->minY = imin / arrayInfo.xSize;
-    pStats->maxX = imax % arrayInfo.xSize;
-    pStats->maxY = imax / arrayInfo.xSize;
-    pStats->net = pStats->total;
-    pStats->mean = pStats->total / pStats->nElements;
-    pStats->sigma = sqrt((pStats->sigma / pStats->nElements) - (pStats->mean * pStats->mean));
+
+    if (pStats->computeStatistics) {
+        pStats->minX = minIndex % arrayInfo.xSize;
+        pStats->minY = minIndex / arrayInfo.xSize;
+        pStats->maxX = maxIndex % arrayInfo.xSize;
+        pStats->maxY = maxIndex / arrayInfo.xSize;
+        pStats->net = pStats->total;
+        pStats->mean = pStats->total / pStats->nElements;
+        pStats->sigma = sqrt((pStats->sigma / pStats->nElements) - (pStats->mean * pStats->mean));
+    }
+    if (pStats->computeCentroid) {
+        doComputeCentroid(pStats, momentXY);
+    }
+    if (pStats->computeHistogram) {
+        double entropy = 0, counts;
+        for (i=0; i<pStats->histSize; i++) {
+            counts = pStats->histogram[i];
+            if (counts <= 0) counts = 1;
+            entropy += counts * log(counts);
+        }
+        entropy = -entropy / pStats->nElements;
+        pStats->histEntropy = entropy;
+    }
+    pStats->computeCentroid = computeCentroid;
+    return asynSuccess;
 }
 
+/** Computes the statistics of an array in the calling thread; used for the background regions. */
 int NDPluginStats::doComputeStatistics(NDArray *pArray, NDStats_t *pStats)
 {
-
-    switch(pArray->dataType) {
-        case NDInt8:
-            doComputeStatisticsT<epicsInt8>(pArray, pStats);
-            break;
-        case NDUInt8:
-            doComputeStatisticsT<epicsUInt8>(pArray, pStats);
-            break;
-        case NDInt16:
-            doComputeStatisticsT<epicsInt16>(pArray, pStats);
-            break;
-        case NDUInt16:
-            doComputeStatisticsT<epicsUInt16>(pArray, pStats);
-            break;
-        case NDInt32:
-            doComputeStatisticsT<epicsInt32>(pArray, pStats);
-            break;
-        case NDUInt32:
-            doComputeStatisticsT<epicsUInt32>(pArray, pStats);
-            break;
-        case NDFloat32:
-            doComputeStatisticsT<epicsFloat32>(pArray, pStats);
-            break;
-        case NDFloat64:
-            doComputeStatisticsT<epicsFloat64>(pArray, pStats);
-            break;
-        default:
-            return(ND_ERROR);
-        break;
-    }
+    memset(pStats, 0, sizeof(*pStats));
+    pStats->computeStatistics = 1;
+    if (doComputeTiles(pArray, pStats, 1)) return(ND_ERROR);
     return(ND_SUCCESS);
 }
 
-template <typename epicsType>
-asynStatus NDPluginStats::doComputeCentroidT(NDArray *pArray, NDStats_t *pStats)
+/** Computes the centroid, sigmas, skew, kurtosis, eccentricity and orientation from the threshold profiles,
+  * and normalizes the average and threshold profiles.
+  * \param[in,out] pStats The sums from doComputeTiles, and the results.
+  * \param[in] momentXY The sum of value*x*y over the elements above the threshold. */
+void NDPluginStats::doComputeCentroid(NDStats_t *pStats, double momentXY)
 {
-    epicsType *pData = (epicsType *)pArray->pData;
-    double value, *pValue, *pThresh, varX, varY, varXY;
+    double *pValue, *pThresh, varX, varY, varXY;
     size_t ix, iy;
     /*Raw moments */
     double M00 = 0.0;
     double M10 = 0.0, M01 = 0.0;
-    double M20 = 0.0, M02 = 0.0, M11 = 0.0;
+    double M20 = 0.0, M02 = 0.0, M11 = momentXY;
     double M30 = 0.0, M03 = 0.0;
     double M40 = 0.0, M04 = 0.0;
     /*Central moments */
     double mu20, mu02, mu11, mu30, mu03, mu40, mu04;
 
-    if (pArray->ndims > 2) return(asynError);
-    
-    for (iy=0; iy<pStats->profileSizeY; iy++) {
-        for (ix=0; ix<pStats->profileSizeX; ix++) {
-            value = (double)*pData++;
-            pStats->profileX[profAverage][ix] += value;
-            pStats->profileY[profAverage][iy] += value;
-            if (value >= pStats->centroidThreshold) {
-                pStats->profileX[profThreshold][ix] += value;
-                pStats->profileY[profThreshold][iy] += value;
-                M11 += value * ix * iy;
-            }
-        }
-    }
-
     /* Normalize the average profiles and compute the centroid from them */
     pValue  = pStats->profileX[profAverage];
     pThresh = pStats->profileX[profThreshold];
@@ -280,43 +417,6 @@ asynStatus NDPluginStats::doComputeCentroidT(NDArray *pArray, NDStats_t *pStats)
                                  ((mu20 + mu02) * (mu20 + mu02));
         }
     }
-    return(asynSuccess);
-}
-
-asynStatus NDPluginStats::doComputeCentroid(NDArray *pArray, NDStats_t *pStats)
-{
-    asynStatus status;
-
-    switch(pArray->dataType) {
-        case NDInt8:
-            status = doComputeCentroidT<epicsInt8>(pArray, pStats);
-            break;
-        case NDUInt8:
-            status = doComputeCentroidT<epicsUInt8>(pArray, pStats);
-            break;
-        case NDInt16:
-            status = doComputeCentroidT<epicsInt16>(pArray, pStats);
-            break;
-        case NDUInt16:
-            status = doComputeCentroidT<epicsUInt16>(pArray, pStats);
-            break;
-        case NDInt32:
-            status = doComputeCentroidT<epicsInt32>(pArray, pStats);
-            break;
-        case NDUInt32:
-            status = doComputeCentroidT<epicsUInt32>(pArray, pStats);
-            break;
-        case NDFloat32:
-            status = doComputeCentroidT<epicsFloat32>(pArray, pStats);
-            break;
-        case NDFloat64:
-            status = doComputeCentroidT<epicsFloat64>(pArray, pStats);
-            break;
-        default:
-            status = asynError;
-        break;
-    }
-    return(status);
 }
 
 template <typename epicsType>
@@ -414,6 +514,7 @@ void NDPluginStats::processCallbacks(NDArray *pArray)
     double bgdCounts, avgBgd;
     NDArray *pBgdArray=NULL;
     int computeStatistics, computeCentroid, computeProfiles, computeHistogram;
+    int tileThreads;
     size_t sizeX=0, sizeY=0;
     int i;
     int itemp;
@@ -423,11 +524,16 @@ void NDPluginStats::processCallbacks(NDArray *pArray)
     /* Call the base class method */
     NDPluginDriver::beginProcessCallbacks(pArray);
     
+    memset(pStats, 0, sizeof(*pStats));
     pArray->getInfo(&arrayInfo);
     getIntegerParam(NDPluginStatsComputeStatistics,  &computeStatistics);
     getIntegerParam(NDPluginStatsComputeCentroid,    &computeCentroid);
     getIntegerParam(NDPluginStatsComputeProfiles,    &computeProfiles);
     getIntegerParam(NDPluginStatsComputeHistogram,   &computeHistogram);
+    getIntegerParam(NDPluginStatsTileThreads,        &tileThreads);
+    pStats->computeStatistics = computeStatistics;
+    pStats->computeCentroid   = computeCentroid;
+    pStats->computeHistogram  = computeHistogram;
     getIntegerParam(NDPluginStatsBgdWidth, &bgdWidth);
     getIntegerParam(NDPluginStatsCursorX, &itemp); pStats->cursorX = itemp;
     getIntegerParam(NDPluginStatsCursorY, &itemp); pStats->cursorY = itemp;
@@ -461,8 +567,11 @@ void NDPluginStats::processCallbacks(NDArray *pArray)
     // Release the lock.  While it is released we cannot access the parameter library or class member data.
     this->unlock();
  
+    if (computeStatistics || computeCentroid || computeHistogram) {
+        doComputeTiles(pArray, pStats, tileThreads);
+    }
+
     if (computeStatistics) {
-        doComputeStatistics(pArray, pStats);
         /* If there is a non-zero background width then compute the background counts */
         // Note that the following algorithm is general in N-dimensions but does have a slight inaccuracy.
         // It computes the background region such that the pixels at the corners are counted twice.
@@ -513,18 +622,10 @@ void NDPluginStats::processCallbacks(NDArray *pArray)
         }
     }
 
-    if (computeCentroid) {
-         doComputeCentroid(pArray, pStats);
-    }
-         
     if (computeProfiles) {
         doComputeProfiles(pArray, pStats);
     }
     
-    if (computeHistogram) {
-        doComputeHistogram(pArray, pStats);
-    }
-    
     // Take the lock again.  The time-series data need to be protected.
     this->lock();
 
@@ -822,6 +923,9 @@ NDPluginStats::NDPluginStats(const char *portName, int queueSize, int blockingCa
     createParam(NDPluginStatsHistArrayString,         asynParamFloat64Array,  &NDPluginStatsHistArray);
     createParam(NDPluginStatsHistXArrayString,        asynParamFloat64Array,  &NDPluginStatsHistXArray);
 
+    createParam(NDPluginStatsTileThreadsString,       asynParamInt32,         &NDPluginStatsTileThreads);
+    setIntegerParam(NDPluginStatsTileThreads, 1);
+
     /* Set the plugin type string */
     setStringParam(NDPluginDriverPluginType, "NDPluginStats");
 
@@ -48,6 +48,9 @@ typedef enum {
 } NDStatsTSControl_t;
 
 typedef struct NDStats {
+    int     computeStatistics;
+    int     computeCentroid;
+    int     computeHistogram;
     size_t  nElements;
     double  total;
     double  net;
@@ -89,6 +92,23 @@ typedef struct NDStats {
     double histEntropy;
 } NDStats_t;
 
+/** Partial results for a band of rows, which doComputeTiles merges into NDStats_t */
+typedef struct NDStatsTile {
+    size_t  firstRow;
+    size_t  numRows;
+    double  min;
+    size_t  minIndex;
+    double  max;
+    size_t  maxIndex;
+    double  total;
+    double  sumSquares;
+    double  *profileX[profThreshold+1]; /**< Column sums; band 0 uses the NDStats_t profiles */
+    double  *momentX;                   /**< Column sums of value*y above the centroid threshold */
+    double  *histogram;                 /**< Band 0 uses the NDStats_t histogram */
+    epicsInt32 histBelow;
+    epicsInt32 histAbove;
+} NDStatsTile_t;
+
 /* Statistics */
 #define NDPluginStatsComputeStatisticsString  "COMPUTE_STATISTICS"  /* (asynInt32,        r/w) Compute statistics? */
 #define NDPluginStatsBgdWidthString           "BGD_WIDTH"           /* (asynInt32,        r/w) Width of background region when computing net */
@@ -145,6 +165,9 @@ typedef struct NDStats {
 #define NDPluginStatsHistArrayString          "HIST_ARRAY"          /* (asynFloat64Array, r/o) Histogram array */
 #define NDPluginStatsHistXArrayString         "HIST_X_ARRAY"        /* (asynFloat64Array, r/o) Histogram X axis array */
 
+/* Threads */
+#define NDPluginStatsTileThreadsString        "TILE_THREADS"        /* (asynInt32,        r/w) Number of threads computing each array */
+
 
 /* Arrays of total and net counts for MCA or waveform record */   
 #define NDPluginStatsCallbackPeriodString     "CALLBACK_PERIOD"     /* (asynFloat64,      r/w) Callback period */
@@ -165,14 +188,12 @@ public:
     asynStatus writeInt32(asynUser *pasynUser, epicsInt32 value);
     asynStatus writeFloat64(asynUser *pasynUser, epicsFloat64 value);
     
-    template <typename epicsType> void doComputeStatisticsT(NDArray *pArray, NDStats_t *pStats);
+    void doComputeTile(NDArray *pArray, NDStats_t *pStats, NDStatsTile_t *pTile);
+    asynStatus doComputeTiles(NDArray *pArray, NDStats_t *pStats, int numTiles);
     int doComputeStatistics(NDArray *pArray, NDStats_t *pStats);
-    template <typename epicsType> asynStatus doComputeCentroidT(NDArray *pArray, NDStats_t *pStats);
-    asynStatus doComputeCentroid(NDArray *pArray, NDStats_t *pStats);
+    void doComputeCentroid(NDStats_t *pStats, double momentXY);
     template <typename epicsType> asynStatus doComputeProfilesT(NDArray *pArray, NDStats_t *pStats);
     asynStatus doComputeProfiles(NDArray *pArray, NDStats_t *pStats);
-    template <typename epicsType> asynStatus doComputeHistogramT(NDArray *pArray, NDStats_t *pStats);
-    asynStatus doComputeHistogram(NDArray *pArray, NDStats_t *pStats);
    
 protected:
     int NDPluginStatsComputeStatistics;
@@ -232,6 +253,9 @@ protected:
     int NDPluginStatsHistArray;
     int NDPluginStatsHistXArray;
 
+    /* Threads */
+    int NDPluginStatsTileThreads;
+
 private:
     asynStatus computeHistX();
 };
@@ -28,15 +28,51 @@
 
 static const char *driverName="NDPluginStdArrays";
 
+/** Returns true if converting an array from dataTypeIn to dataTypeOut would not change the data.
+  * The asyn integer array interfaces are signed, so the unsigned types are passed as the signed
+  * type of the same size; the conversion between them does not change the bits. */
+static bool sameRepresentation(NDDataType_t dataTypeIn, NDDataType_t dataTypeOut)
+{
+    switch (dataTypeIn) {
+    case NDInt8:
+    case NDUInt8:
+        return dataTypeOut == NDInt8;
+    case NDInt16:
+    case NDUInt16:
+        return dataTypeOut == NDInt16;
+    case NDInt32:
+    case NDUInt32:
+        return dataTypeOut == NDInt32;
+    default:
+        return dataTypeIn == dataTypeOut;
+    }
+}
+
+/** Returns the data of an array as outputType.
+  * This is the data of the array itself if the conversion would not change it, otherwise the data of a
+  * converted copy.  *ppConverted is the converted copy; if it is NULL a new copy is made and returned in it.
+  * \param[in] pArray The array to convert.
+  * \param[in] outputType The data type of the asyn interface.
+  * \param[in,out] ppConverted The converted copy of pArray.
+  * \return The data, or NULL if the conversion failed. */
+void *NDPluginStdArrays::convertedData(NDArray *pArray, NDDataType_t outputType, NDArray **ppConverted)
+{
+    if (pArray->codec.name.empty() && sameRepresentation(pArray->dataType, outputType)) {
+        return pArray->pData;
+    }
+    if (!*ppConverted) {
+        if (this->pNDArrayPool->convert(pArray, ppConverted, outputType)) return NULL;
+    }
+    return (*ppConverted)->pData;
+}
+
 template <typename epicsType, typename interruptType>
-void NDPluginStdArrays::arrayInterruptCallback(NDArray *pArray, NDArrayPool *pNDArrayPool, 
-                            void *interruptPvt, int *initialized, NDDataType_t signedType)
+void NDPluginStdArrays::arrayInterruptCallback(NDArray *pArray, void *interruptPvt,
+                                               NDDataType_t signedType, NDArray **ppConverted)
 {
     ELLLIST *pclientList;
     interruptNode *pnode;
-    int status;
     epicsType *pData=NULL;
-    NDArray *pOutput=NULL;
     NDArrayInfo_t arrayInfo;
 
     pasynManager->interruptStart(interruptPvt, &pclientList);
@@ -44,17 +80,17 @@ void NDPluginStdArrays::arrayInterruptCallback(NDArray *pArray, NDArrayPool *pND
     while (pnode) {
         interruptType *pInterrupt = (interruptType *)pnode->drvPvt;
         if (pInterrupt->pasynUser->reason == NDPluginStdArraysData) {
-            if (!*initialized) {
-                *initialized = 1;
+            /* The array is only converted if there are clients for this type, and all the clients
+             * are passed the same data */
+            if (!pData) {
                 pArray->getInfo(&arrayInfo);
-                status = pNDArrayPool->convert(pArray, &pOutput, signedType);
-                if (status) {
+                pData = (epicsType *)convertedData(pArray, signedType, ppConverted);
+                if (!pData) {
                     asynPrint(pInterrupt->pasynUser, ASYN_TRACE_ERROR,
                               "%s::arrayInterruptCallback: error allocating array in convert()\n",
                                driverName);
                     break;
                 }
-                pData = (epicsType *)pOutput->pData;
             }
             pInterrupt->pasynUser->timestamp = pArray->epicsTS;
             pInterrupt->callback(pInterrupt->userPvt,
@@ -64,7 +100,6 @@ void NDPluginStdArrays::arrayInterruptCallback(NDArray *pArray, NDArrayPool *pND
         pnode = (interruptNode *)ellNext(&pnode->node);
     }
     pasynManager->interruptEnd(interruptPvt);
-    if (pOutput) pOutput->release();
 }
 
 template <typename epicsType> 
@@ -72,8 +107,9 @@ asynStatus NDPluginStdArrays::readArray(asynUser *pasynUser, epicsType *value, s
 {
     int command = pasynUser->reason;
     asynStatus status = asynSuccess;
-    NDArray *pOutput, *myArray;
+    NDArray *myArray;
     NDArrayInfo_t arrayInfo;
+    void *pData;
 
     myArray = this->pArrays[0];
     if (command == NDPluginStdArraysData) {
@@ -89,17 +125,18 @@ asynStatus NDPluginStdArrays::readArray(asynUser *pasynUser, epicsType *value, s
              * Just pass the first nElements. */
              arrayInfo.nElements = nElements;
         }
-        status = (asynStatus)this->pNDArrayPool->convert(myArray, &pOutput, outputType);
-        if (status) {
+        /* The converted copy is kept until the next array, so repeated reads do not convert again */
+        pData = convertedData(myArray, outputType, &this->pConverted_[outputType]);
+        if (!pData) {
             asynPrint(pasynUser, ASYN_TRACE_ERROR,
                       "%s::readArray: error allocating array in convert()\n",
                        driverName);
+           status = asynError;
            goto done;
         }
         /* Copy the data */
         *nIn = arrayInfo.nElements;
-        memcpy(value, pOutput->pData, *nIn*sizeof(epicsType));
-        pOutput->release();
+        memcpy(value, pData, *nIn*sizeof(epicsType));
         /* Set the timestamp */
         pasynUser->timestamp = myArray->epicsTS;
     } else {
@@ -127,48 +164,44 @@ void NDPluginStdArrays::processCallbacks(NDArray *pArray)
      * It is called with the mutex already locked.
      */
      
-    int int8Initialized=0;
-    int int16Initialized=0;
-    int int32Initialized=0;
-    int float32Initialized=0;
-    int float64Initialized=0;
-    NDArrayInfo_t arrayInfo;
+    NDArray *pConverted[NDFloat64+1];
+    int i;
     asynStandardInterfaces *pInterfaces = this->getAsynStdInterfaces();
     /* static const char* functionName = "processCallbacks"; */
 
     /* Call the base class method */
     NDPluginDriver::beginProcessCallbacks(pArray);
     
-    pArray->getInfo(&arrayInfo);
+    for (i=0; i<=NDFloat64; i++) pConverted[i] = NULL;
  
     /* This function is called with the lock taken, and it must be set when we exit.
      * The following code can be exected without the mutex because we are not accessing pPvt */
     this->unlock();
 
     /* Pass interrupts for int8Array data*/
-    arrayInterruptCallback<epicsInt8, asynInt8ArrayInterrupt>(pArray, this->pNDArrayPool, 
+    arrayInterruptCallback<epicsInt8, asynInt8ArrayInterrupt>(pArray,
                              pInterfaces->int8ArrayInterruptPvt,
-                             &int8Initialized, NDInt8);
+                             NDInt8, &pConverted[NDInt8]);
     
     /* Pass interrupts for int16Array data*/
-    arrayInterruptCallback<epicsInt16,  asynInt16ArrayInterrupt>(pArray, this->pNDArrayPool, 
+    arrayInterruptCallback<epicsInt16,  asynInt16ArrayInterrupt>(pArray,
                              pInterfaces->int16ArrayInterruptPvt,
-                             &int16Initialized, NDInt16);
+                             NDInt16, &pConverted[NDInt16]);
     
     /* Pass interrupts for int32Array data*/
-    arrayInterruptCallback<epicsInt32, asynInt32ArrayInterrupt>(pArray, this->pNDArrayPool, 
+    arrayInterruptCallback<epicsInt32, asynInt32ArrayInterrupt>(pArray,
                              pInterfaces->int32ArrayInterruptPvt,
-                             &int32Initialized, NDInt32);
+                             NDInt32, &pConverted[NDInt32]);
     
     /* Pass interrupts for float32Array data*/
-    arrayInterruptCallback<epicsFloat32, asynFloat32ArrayInterrupt>(pArray, this->pNDArrayPool, 
+    arrayInterruptCallback<epicsFloat32, asynFloat32ArrayInterrupt>(pArray,
                              pInterfaces->float32ArrayInterruptPvt,
-                             &float32Initialized, NDFloat32);
+                             NDFloat32, &pConverted[NDFloat32]);
     
     /* Pass interrupts for float64Array data*/
-    arrayInterruptCallback<epicsFloat64, asynFloat64ArrayInterrupt>(pArray, this->pNDArrayPool, 
+    arrayInterruptCallback<epicsFloat64, asynFloat64ArrayInterrupt>(pArray,
                              pInterfaces->float64ArrayInterruptPvt,
-                             &float64Initialized, NDFloat64);
+                             NDFloat64, &pConverted[NDFloat64]);
 
     /* We must exit with the mutex locked */
     this->lock();
@@ -177,6 +210,11 @@ void NDPluginStdArrays::processCallbacks(NDArray *pArray)
     if (this->pArrays[0]) this->pArrays[0]->release();
     pArray->reserve();
     this->pArrays[0] = pArray;
+    /* Keep the converted copies of this array for read() */
+    for (i=0; i<=NDFloat64; i++) {
+        if (this->pConverted_[i]) this->pConverted_[i]->release();
+        this->pConverted_[i] = pConverted[i];
+    }
     /* Update the parameters.  The counter should be updated after data are posted
      * because clients might use that to detect new data */
     callParamCallbacks();
@@ -285,6 +323,8 @@ NDPluginStdArrays::NDPluginStdArrays(const char *portName, int queueSize, int bl
     
     createParam(NDPluginStdArraysDataString, asynParamGenericPointer, &NDPluginStdArraysData);
 
+    for (int i=0; i<=NDFloat64; i++) pConverted_[i] = NULL;
+
     /* Set the plugin type string */    
     setStringParam(NDPluginDriverPluginType, "NDPluginStdArrays");
 
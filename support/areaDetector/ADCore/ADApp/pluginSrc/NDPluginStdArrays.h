@@ -10,7 +10,9 @@
 /** Converts NDArray callback data into standard asyn arrays (asynInt8Array, asynInt16Array, asynInt32Array,
   * asynFloat32Array or asynFloat64Array); normally used for putting NDArray data in EPICS waveform records.
   * It handles the data type conversion if the NDArray data type differs from the data type of the asyn interface.
-  * It flattens the NDArrays to a single dimension because asyn and EPICS do not support multi-dimensional arrays. */
+  * It flattens the NDArrays to a single dimension because asyn and EPICS do not support multi-dimensional arrays.
+  * Each array is converted at most once to each asyn array type, and only to the types that have clients;
+  * when the conversion would not change the data the clients are passed the NDArray data itself. */
 class epicsShareClass NDPluginStdArrays : public NDPluginDriver {
 public:
     NDPluginStdArrays(const char *portName, int queueSize, int blockingCallbacks, 
@@ -37,9 +39,11 @@ private:
     template <typename epicsType> asynStatus readArray(asynUser *pasynUser, epicsType *value, 
                                         size_t nElements, size_t *nIn, NDDataType_t outputType);
     template <typename epicsType, typename interruptType> void arrayInterruptCallback(NDArray *pArray, 
-                            NDArrayPool *pNDArrayPool, 
-                            void *interruptPvt, int *initialized, NDDataType_t signedType);
-                                        
+                            void *interruptPvt, NDDataType_t signedType, NDArray **ppConverted);
+    void *convertedData(NDArray *pArray, NDDataType_t outputType, NDArray **ppConverted);
+
+    /* Converted copies of pArrays[0], indexed by the output data type; NULL if not yet converted */
+    NDArray *pConverted_[NDFloat64+1];
 };
 
 #endif
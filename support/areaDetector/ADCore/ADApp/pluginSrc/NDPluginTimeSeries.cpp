@@ -31,7 +31,8 @@
 
 enum {
   TSAcquireModeFixed,
-  TSAcquireModeCircular
+  TSAcquireModeCircular,
+  TSAcquireModeStreaming
 };
 
 /** Constructor for NDPluginTimeSeries; most parameters are simply passed to NDPluginDriver::NDPluginDriver.
@@ -63,9 +64,10 @@ NDPluginTimeSeries::NDPluginTimeSeries(const char *portName, int queueSize, int
              asynFloat64Mask | asynFloat64ArrayMask | asynGenericPointerMask,
              asynFloat64Mask | asynFloat64ArrayMask | asynGenericPointerMask,
              ASYN_MULTIDEVICE, 1, priority, stackSize, 1),
-    dataType_(NDFloat64), dataSize_(sizeof(epicsFloat64)), numTimePoints_(DEFAULT_NUM_TSPOINTS), currentTimePoint_(0),
+    dataType_(NDFloat64), numTimePoints_(DEFAULT_NUM_TSPOINTS), currentTimePoint_(0),
+    numNewPoints_(0), chunkSize_(1), chunkSequence_(0),
     uniqueId_(0), numAverage_(1), acquireMode_(TSAcquireModeFixed), averagingTimeRequested_(1), timePerPoint_(0), 
-    signalData_(0), timeAxis_(0), timeStamp_(0), pTimeCircular_(0)
+    signalData_(0), timeAxis_(0), timeStamp_(0)
 {
   //const char *functionName = "NDPluginTimeSeries::NDPluginTimeSeries";
 
@@ -75,6 +77,10 @@ NDPluginTimeSeries::NDPluginTimeSeries(const char *portName, int queueSize, int
   maxSignals_ = maxSignals;
   numSignals_ = maxSignals;
   averageStore_ = (double *)calloc(maxSignals_, sizeof(double));
+  memset(decimations_, 0, sizeof(decimations_));
+  for (int decimation=0; decimation<NUM_TS_DECIMATIONS; decimation++) {
+    decimations_[decimation].factor = 1;
+  }
   
   /* Per-plugin parameters */
   createParam(TSAcquireString,                 asynParamInt32, &P_TSAcquire);
@@ -88,14 +94,26 @@ NDPluginTimeSeries::NDPluginTimeSeries(const char *portName, int queueSize, int
   createParam(TSAcquireModeString,             asynParamInt32, &P_TSAcquireMode);
   createParam(TSTimeAxisString,         asynParamFloat64Array, &P_TSTimeAxis);
   createParam(TSTimestampString,        asynParamFloat64Array, &P_TSTimestamp);
+  createParam(TSChunkSizeString,               asynParamInt32, &P_TSChunkSize);
+  createParam(TSChunkSequenceString,           asynParamInt32, &P_TSChunkSequence);
+  createParam(TSChunkTimestampString,   asynParamFloat64Array, &P_TSChunkTimestamp);
+  createParam(TSDecimate1String,               asynParamInt32, &P_TSDecimate[0]);
+  createParam(TSDecimate2String,               asynParamInt32, &P_TSDecimate[1]);
   
   /* Per-signal parameters */
   createParam(TSTimeSeriesString,       asynParamFloat64Array, &P_TSTimeSeries);
+  createParam(TSChunkString,            asynParamFloat64Array, &P_TSChunk);
+  createParam(TSDecimated1String,       asynParamFloat64Array, &P_TSDecimated[0]);
+  createParam(TSDecimated2String,       asynParamFloat64Array, &P_TSDecimated[1]);
  
   /* Set the plugin type string */
   setStringParam(NDPluginDriverPluginType, "NDPluginTimeSeries");
   
   setIntegerParam(P_TSNumPoints, numTimePoints_);
+  setIntegerParam(P_TSChunkSize, chunkSize_);
+  for (int decimation=0; decimation<NUM_TS_DECIMATIONS; decimation++) {
+    setIntegerParam(P_TSDecimate[decimation], decimations_[decimation].factor);
+  }
   allocateArrays();
   
   /* Try to connect to the array port */
@@ -126,32 +144,56 @@ void NDPluginTimeSeries::computeNumAverage()
 void NDPluginTimeSeries::allocateArrays()
 {
   int numPoints;
-  int nDims=2;
-  size_t dims[2];
+  int decimation;
   
   getIntegerParam(P_TSNumPoints, &numPoints);
   numTimePoints_ = numPoints;
   if (timeStamp_)  free(timeStamp_);
   if (signalData_) free (signalData_);
-  if (pTimeCircular_) pTimeCircular_->release();
-
-  timeStamp_  = (double *)calloc(numSignals_*numTimePoints_, sizeof(double));
-  signalData_ = (double *)calloc(numSignals_*numTimePoints_, sizeof(double));
-  nDims = 2;
-  dims[0] = numTimePoints_;
-  dims[1] = numSignals_;
-  pTimeCircular_ = pNDArrayPool->alloc(nDims, dims, dataType_, 0, 0);
+  for (decimation=0; decimation<NUM_TS_DECIMATIONS; decimation++) {
+    free(decimations_[decimation].sum);
+    free(decimations_[decimation].data);
+    decimations_[decimation].sum = 0;
+    decimations_[decimation].average = 0;
+    decimations_[decimation].data = 0;
+  }
+
+  // Each point is stored at i and i+numTimePoints, see NDTimeSeriesDecimation_t
+  timeStamp_  = (double *)calloc(2*numTimePoints_, sizeof(double));
+  signalData_ = (double *)calloc(numSignals_*2*numTimePoints_, sizeof(double));
   createAxisArray();
   acquireReset();
 }
 
+void NDPluginTimeSeries::resetDecimation(int decimation)
+{
+  NDTimeSeriesDecimation_t *pDecimation = &decimations_[decimation];
+
+  pDecimation->numAveraged = 0;
+  pDecimation->currentPoint = 0;
+  if (pDecimation->data) {
+    memset(pDecimation->sum,  0, numSignals_ * sizeof(double));
+    memset(pDecimation->data, 0, numSignals_ * 2*numTimePoints_ * sizeof(double));
+  } else if (pDecimation->factor > 1) {
+    // The arrays are only allocated when the decimation is first enabled
+    pDecimation->sum = (double *)calloc(2*numSignals_, sizeof(double));
+    pDecimation->average = pDecimation->sum + numSignals_;
+    pDecimation->data = (double *)calloc(numSignals_*2*numTimePoints_, sizeof(double));
+  }
+}
+
 void NDPluginTimeSeries::acquireReset()
 {
-  memset(signalData_,           0, numTimePoints_ * numSignals_ * sizeof(double));
-  memset(timeStamp_,            0, numTimePoints_ * sizeof(double));
-  memset(pTimeCircular_->pData, 0, numTimePoints_ * numSignals_ * dataSize_);
+  memset(signalData_,           0, numSignals_ * 2*numTimePoints_ * sizeof(double));
+  memset(timeStamp_,            0, 2*numTimePoints_ * sizeof(double));
+  for (int decimation=0; decimation<NUM_TS_DECIMATIONS; decimation++) {
+    resetDecimation(decimation);
+  }
   currentTimePoint_ = 0;
+  numNewPoints_ = 0;
+  chunkSequence_ = 0;
   setIntegerParam(P_TSCurrentPoint, currentTimePoint_);
+  setIntegerParam(P_TSChunkSequence, chunkSequence_);
   epicsTimeGetCurrent(&startTime_);
 }
 
@@ -181,7 +223,8 @@ asynStatus NDPluginTimeSeries::doAddToTimeSeriesT(NDArray *pArray)
 {
   epicsType *pData         = (epicsType *)pArray->pData;
   epicsType *pIn; 
-  epicsType *pTimeCircular = (epicsType *)pTimeCircular_->pData;
+  double *pSignal;
+  size_t ringSize = 2*numTimePoints_;
   int signal;
   int i;
   int numTimes = 1;
@@ -197,24 +240,33 @@ asynStatus NDPluginTimeSeries::doAddToTimeSeriesT(NDArray *pArray)
     }
     numAveraged_++;
     if (numAveraged_ < numAverage_) continue;
-    /* We have now collected the desired number of points to average */
+    /* We have now collected the desired number of points to average.
+     * Each point is written twice so the ring can be read oldest first without reordering. */
     for (signal=0; signal<numSignals_; signal++) {
-      pTimeCircular[signal * numTimePoints_ + currentTimePoint_] = (epicsType)averageStore_[signal]/numAveraged_;
-      averageStore_[signal] = 0;
+      averageStore_[signal] /= numAveraged_;
+      pSignal = signalData_ + signal*ringSize;
+      pSignal[currentTimePoint_] = pSignal[currentTimePoint_ + numTimePoints_] = averageStore_[signal];
     }
+    timeStamp_[currentTimePoint_] = timeStamp_[currentTimePoint_ + numTimePoints_] = pArray->timeStamp;
+    addDecimatedPoint(averageStore_);
+    memset(averageStore_, 0, numSignals_ * sizeof(double));
     numAveraged_ = 0;
-    timeStamp_[currentTimePoint_] = pArray->timeStamp;
     currentTimePoint_++;
+    numNewPoints_++;
     if (currentTimePoint_ >= numTimePoints_) {
       if (acquireMode_ == TSAcquireModeFixed) {
         setIntegerParam(P_TSAcquire, 0);
         doTimeSeriesCallbacks();
         break;
       }
-      else { // Circular buffer mode
+      else { // Circular buffer and streaming modes
           currentTimePoint_ = 0;
       }
     }
+    if ((acquireMode_ == TSAcquireModeStreaming) &&
+        ((numNewPoints_ >= chunkSize_) || (numNewPoints_ >= numTimePoints_))) {
+      doChunkCallbacks();
+    }
   }  // for (i=0; ...)
   setIntegerParam(P_TSCurrentPoint, currentTimePoint_);     
   epicsTimeGetCurrent(&timeNow);
@@ -223,6 +275,38 @@ asynStatus NDPluginTimeSeries::doAddToTimeSeriesT(NDArray *pArray)
   return asynSuccess;
 }
 
+
+/**
+ * Adds a point of the time series to the decimated time series.  Each decimation averages
+ * the points of the one before it; a decimation with a factor of 1 passes its input on.
+ * \param[in] pValues The value of each signal.
+ */
+void NDPluginTimeSeries::addDecimatedPoint(const double *pValues)
+{
+  int decimation;
+  int signal;
+  double *pSignal;
+  size_t ringSize = 2*numTimePoints_;
+
+  for (decimation=0; decimation<NUM_TS_DECIMATIONS; decimation++) {
+    NDTimeSeriesDecimation_t *pDecimation = &decimations_[decimation];
+    if ((pDecimation->factor <= 1) || !pDecimation->data) continue;
+    for (signal=0; signal<numSignals_; signal++) {
+      pDecimation->sum[signal] += pValues[signal];
+    }
+    if (++pDecimation->numAveraged < pDecimation->factor) return;
+    for (signal=0; signal<numSignals_; signal++) {
+      pDecimation->average[signal] = pDecimation->sum[signal] / pDecimation->numAveraged;
+      pDecimation->sum[signal] = 0;
+      pSignal = pDecimation->data + signal*ringSize;
+      pSignal[pDecimation->currentPoint] = pSignal[pDecimation->currentPoint + numTimePoints_] =
+          pDecimation->average[signal];
+    }
+    pDecimation->numAveraged = 0;
+    if (++pDecimation->currentPoint >= numTimePoints_) pDecimation->currentPoint = 0;
+    pValues = pDecimation->average;
+  }
+}
      
 /**
  * Call the templated doAddToTimeSeries so we can cast correctly. 
@@ -265,37 +349,31 @@ asynStatus NDPluginTimeSeries::addToTimeSeries(NDArray *pArray)
   return status;
 }
 
+/**
+ * Templated function to copy the time series to an output array of the input data type.
+ * \param[in] pArrayOut The output array, [numTimePoints][numSignals]
+ * \param[in] firstPoint Index in the ring of the first point to copy
+ */
 template <typename epicsType>
-void NDPluginTimeSeries::doTimeSeriesCallbacksT()
+void NDPluginTimeSeries::copyTimeSeriesT(NDArray *pArrayOut, int firstPoint)
 {
+  epicsType *pOut = (epicsType *)pArrayOut->pData;
+  double *pIn;
   int signal;
-  int timeOut;
-  int timeIn=0;
-  epicsType *timeCircular = (epicsType *)pTimeCircular_->pData;
-
+  int i;
 
-  if (acquireMode_ == TSAcquireModeFixed) {
-    for (signal=0; signal<numSignals_; signal++) {
-      for (timeOut=0; timeOut<currentTimePoint_; timeOut++) {
-        signalData_[timeOut] = timeCircular[signal*numTimePoints_ + timeOut];
-      }
-      doCallbacksFloat64Array(signalData_, currentTimePoint_, P_TSTimeSeries, signal);
-    }
-  }
-  else {
-    timeIn = currentTimePoint_;
-    for (signal=0; signal<numSignals_; signal++) {
-      for (timeOut=0; timeOut<numTimePoints_; timeOut++) {
-        signalData_[timeOut] = timeCircular[signal*numTimePoints_ + timeIn];
-        if (++timeIn >= numTimePoints_) timeIn = 0;
-      }
-      doCallbacksFloat64Array(signalData_, numTimePoints_, P_TSTimeSeries, signal);
+  for (signal=0; signal<numSignals_; signal++) {
+    pIn = signalData_ + signal*2*numTimePoints_ + firstPoint;
+    for (i=0; i<numTimePoints_; i++) {
+      *pOut++ = (epicsType)pIn[i];
     }
   }
 }
 
 /**
- * Call the templated doTimeSeriesCallbacks so we can cast correctly. 
+ * Does callbacks with the time series of all signals and the decimated time series.
+ * The rings store each point twice, so the time series are passed to the callbacks
+ * without reordering them.
  * \return asynStatus
  */
 asynStatus NDPluginTimeSeries::doTimeSeriesCallbacks()
@@ -303,61 +381,84 @@ asynStatus NDPluginTimeSeries::doTimeSeriesCallbacks()
   int arrayCallbacks;
   epicsTimeStamp now;
   asynStatus status = asynSuccess;
-  char *src, *dst;
   int signal;
-  size_t dims[1]; 
-  int numCopy;
+  int decimation;
+  int firstPoint, numPoints;
+  size_t ringSize = 2*numTimePoints_;
+  size_t dims[2];
+  NDDimension_t dimsOut[2];
   
-  switch(dataType_) {
-  case NDInt8:
-    doTimeSeriesCallbacksT<epicsInt8>();
-    break;
-  case NDUInt8:
-    doTimeSeriesCallbacksT<epicsUInt8>();
-    break;
-  case NDInt16:
-    doTimeSeriesCallbacksT<epicsInt16>();
-    break;
-  case NDUInt16:
-    doTimeSeriesCallbacksT<epicsUInt16>();
-    break;
-  case NDInt32:
-    doTimeSeriesCallbacksT<epicsInt32>();
-    break;
-  case NDUInt32:
-    doTimeSeriesCallbacksT<epicsUInt32>();
-    break;
-  case NDFloat32:
-    doTimeSeriesCallbacksT<epicsFloat32>();
-    break;
-  case NDFloat64:
-    doTimeSeriesCallbacksT<epicsFloat64>();
-    break;
-  default:
-    return asynError;
-    break;
+  // Fixed mode has the points acquired so far, circular mode all points oldest first
+  if (acquireMode_ == TSAcquireModeFixed) {
+    firstPoint = 0;
+    numPoints = currentTimePoint_;
+  }
+  else {
+    firstPoint = currentTimePoint_;
+    numPoints = numTimePoints_;
+  }
+  for (signal=0; signal<numSignals_; signal++) {
+    doCallbacksFloat64Array(signalData_ + signal*ringSize + firstPoint, numPoints, P_TSTimeSeries, signal);
+  }
+  doCallbacksFloat64Array(timeStamp_ + firstPoint, numPoints, P_TSTimestamp, 0);
+
+  for (decimation=0; decimation<NUM_TS_DECIMATIONS; decimation++) {
+    NDTimeSeriesDecimation_t *pDecimation = &decimations_[decimation];
+    if ((pDecimation->factor <= 1) || !pDecimation->data) continue;
+    if (acquireMode_ == TSAcquireModeFixed) {
+      firstPoint = 0;
+      numPoints = pDecimation->currentPoint;
+    }
+    else {
+      firstPoint = pDecimation->currentPoint;
+      numPoints = numTimePoints_;
+    }
+    for (signal=0; signal<numSignals_; signal++) {
+      doCallbacksFloat64Array(pDecimation->data + signal*ringSize + firstPoint, numPoints,
+                              P_TSDecimated[decimation], signal);
+    }
   }
 
   getIntegerParam(NDArrayCallbacks, &arrayCallbacks);
   if (arrayCallbacks) {
     NDArray *pArrayOut = this->pArrays[0];
     if (pArrayOut) pArrayOut->release();
-    if (acquireMode_ == TSAcquireModeFixed) {
-      pArrayOut = pNDArrayPool->copy(pTimeCircular_, NULL, 1);    
-    }
-    else {
-      // Shift the data so the oldest time point is the first point in the array
-      pArrayOut = pNDArrayPool->copy(pTimeCircular_, NULL, 0);
-      for (signal=0; signal<numSignals_; signal++) {
-        numCopy = numTimePoints_ - currentTimePoint_;
-        src = (char *)pTimeCircular_->pData + ((signal * numTimePoints_) + currentTimePoint_)*dataSize_;
-        dst = (char *)pArrayOut->pData      +  (signal * numTimePoints_)*dataSize_;
-        memcpy(dst, src, numCopy*dataSize_);
-        numCopy = currentTimePoint_;
-        src = (char *)pTimeCircular_->pData +  (signal * numTimePoints_)*dataSize_;
-        dst = (char *)pArrayOut->pData      + ((signal * numTimePoints_) + numTimePoints_ - currentTimePoint_)*dataSize_;
-        memcpy(dst, src, numCopy*dataSize_);
-      }
+    this->pArrays[0] = NULL;
+    dims[0] = numTimePoints_;
+    dims[1] = numSignals_;
+    pArrayOut = pNDArrayPool->alloc(2, dims, dataType_, 0, 0);
+    if (!pArrayOut) return asynError;
+    // The arrays always have numTimePoints; in fixed mode the points not yet acquired are 0
+    firstPoint = (acquireMode_ == TSAcquireModeFixed) ? 0 : currentTimePoint_;
+    switch(dataType_) {
+    case NDInt8:
+      copyTimeSeriesT<epicsInt8>(pArrayOut, firstPoint);
+      break;
+    case NDUInt8:
+      copyTimeSeriesT<epicsUInt8>(pArrayOut, firstPoint);
+      break;
+    case NDInt16:
+      copyTimeSeriesT<epicsInt16>(pArrayOut, firstPoint);
+      break;
+    case NDUInt16:
+      copyTimeSeriesT<epicsUInt16>(pArrayOut, firstPoint);
+      break;
+    case NDInt32:
+      copyTimeSeriesT<epicsInt32>(pArrayOut, firstPoint);
+      break;
+    case NDUInt32:
+      copyTimeSeriesT<epicsUInt32>(pArrayOut, firstPoint);
+      break;
+    case NDFloat32:
+      copyTimeSeriesT<epicsFloat32>(pArrayOut, firstPoint);
+      break;
+    case NDFloat64:
+      copyTimeSeriesT<epicsFloat64>(pArrayOut, firstPoint);
+      break;
+    default:
+      pArrayOut->release();
+      return asynError;
+      break;
     }
     this->getAttributes(pArrayOut->pAttributeList);
     getTimeStamp(&pArrayOut->epicsTS);
@@ -366,18 +467,14 @@ asynStatus NDPluginTimeSeries::doTimeSeriesCallbacks()
     pArrayOut->uniqueId = uniqueId_++;
     doCallbacksGenericPointer(pArrayOut, NDArrayData, numSignals_);
     this->pArrays[0] = pArrayOut;
-    // Now do NDArray callbacks on 1-D arrays for each signal
-    numCopy = (int)pArrayOut->dims[0].size;
-    dims[0] = numCopy;
+    // Now do NDArray callbacks on 1-D arrays for each signal, which are views of the rows of the 2-D array
     for (signal=0; signal<numSignals_; signal++) {
-      NDArray *pArray = pNDArrayPool->alloc(1, dims, pArrayOut->dataType, 0, 0);
-      src = (char *)pArrayOut->pData + (signal * numTimePoints_)*dataSize_;
-      dst = (char *)pArray->pData;
-      memcpy(dst, src, numCopy*dataSize_); 
-      this->getAttributes(pArray->pAttributeList);
-      pArray->epicsTS   = pArrayOut->epicsTS;
-      pArray->timeStamp = pArrayOut->timeStamp;
-      pArray->uniqueId  = pArrayOut->uniqueId;
+      pArrayOut->initDimension(&dimsOut[0], numTimePoints_);
+      pArrayOut->initDimension(&dimsOut[1], 1);
+      dimsOut[1].offset = signal;
+      NDArray *pArray = pNDArrayPool->view(pArrayOut, dimsOut);
+      if (!pArray) continue;
+      pArray->ndims = 1;
       doCallbacksGenericPointer(pArray, NDArrayData, signal);
       pArray->release();
     }
@@ -385,6 +482,30 @@ asynStatus NDPluginTimeSeries::doTimeSeriesCallbacks()
   return status;
 }
 
+/**
+ * Does callbacks with the time points added since the last chunk in streaming mode,
+ * and increments the chunk sequence number so clients can detect missed chunks.
+ */
+void NDPluginTimeSeries::doChunkCallbacks()
+{
+  int signal;
+  int firstPoint;
+  int numPoints = numNewPoints_;
+  size_t ringSize = 2*numTimePoints_;
+
+  if (numPoints == 0) return;
+  if (numPoints > numTimePoints_) numPoints = numTimePoints_;
+  firstPoint = currentTimePoint_ - numPoints;
+  if (firstPoint < 0) firstPoint += numTimePoints_;
+  for (signal=0; signal<numSignals_; signal++) {
+    doCallbacksFloat64Array(signalData_ + signal*ringSize + firstPoint, numPoints, P_TSChunk, signal);
+  }
+  doCallbacksFloat64Array(timeStamp_ + firstPoint, numPoints, P_TSChunkTimestamp, 0);
+  numNewPoints_ = 0;
+  setIntegerParam(P_TSChunkSequence, ++chunkSequence_);
+  callParamCallbacks();
+}
+
 
 /** 
  * Callback function that is called by the NDArray driver with new NDArray data.
@@ -394,7 +515,6 @@ asynStatus NDPluginTimeSeries::doTimeSeriesCallbacks()
 void NDPluginTimeSeries::processCallbacks(NDArray *pArray)
 {
   int acquiring;
-  NDArrayInfo_t arrayInfo;
   const char* functionName = "NDPluginTimeSeries::processCallbacks";
 
   /* Call the base class method */
@@ -416,8 +536,6 @@ void NDPluginTimeSeries::processCallbacks(NDArray *pArray)
     numSignalsIn_ = (int)pArray->dims[0].size;
     numSignals_ = numSignalsIn_;
     if (numSignals_ > maxSignals_) numSignals_ = maxSignals_;
-    pArray->getInfo(&arrayInfo);
-    dataSize_ = arrayInfo.bytesPerElement;
     allocateArrays();
   }
   
@@ -464,12 +582,22 @@ asynStatus NDPluginTimeSeries::writeInt32(asynUser *pasynUser, epicsInt32 value)
       acquireReset();
     }
     else {
+      if (acquireMode_ == TSAcquireModeStreaming) doChunkCallbacks();
       doTimeSeriesCallbacks();
     }
   } else if (function == P_TSRead) {
     doTimeSeriesCallbacks();
+  } else if (function == P_TSChunkSize) {
+    chunkSize_ = (value < 1) ? 1 : value;
   } else if (function < FIRST_NDPLUGIN_TIME_SERIES_PARAM) {
     stat = (NDPluginDriver::writeInt32(pasynUser, value) == asynSuccess) && stat;
+  } else {
+    for (int decimation=0; decimation<NUM_TS_DECIMATIONS; decimation++) {
+      if (function == P_TSDecimate[decimation]) {
+        decimations_[decimation].factor = (value < 1) ? 1 : value;
+        resetDecimation(decimation);
+      }
+    }
   }
 
   /* Do callbacks so higher layers see any changes */
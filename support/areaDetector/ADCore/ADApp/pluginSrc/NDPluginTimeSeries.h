@@ -28,9 +28,32 @@
 #define TSAcquireModeString     "TS_ACQUIRE_MODE"     /* (asynInt32,        r/w) Acquire mode */
 #define TSTimeAxisString        "TS_TIME_AXIS"        /* (asynFloat64Array, r/o) Time axis array */
 #define TSTimestampString       "TS_TIMESTAMP"        /* (asynFloat64Array, r/o) Series of timestamps */
+#define TSChunkSizeString       "TS_CHUNK_SIZE"       /* (asynInt32,        r/w) Time points in each chunk in streaming mode */
+#define TSChunkSequenceString   "TS_CHUNK_SEQUENCE"   /* (asynInt32,        r/o) Sequence number of the last chunk */
+#define TSChunkTimestampString  "TS_CHUNK_TIMESTAMP"  /* (asynFloat64Array, r/o) Timestamps of the last chunk */
+#define TSDecimate1String       "TS_DECIMATE1"        /* (asynInt32,        r/w) Time series points averaged in each decimated point */
+#define TSDecimate2String       "TS_DECIMATE2"        /* (asynInt32,        r/w) Decimation 1 points averaged in each decimated point */
 
 /* Per-signal parameters */
 #define TSTimeSeriesString      "TS_TIME_SERIES"      /* (asynFloat64Array, r/o) Time series array */
+#define TSChunkString           "TS_CHUNK"            /* (asynFloat64Array, r/o) New time points in streaming mode */
+#define TSDecimated1String      "TS_DECIMATED1"       /* (asynFloat64Array, r/o) Time series decimated by TS_DECIMATE1 */
+#define TSDecimated2String      "TS_DECIMATED2"       /* (asynFloat64Array, r/o) Decimation 1 decimated by TS_DECIMATE2 */
+
+/** Number of decimated time series; each averages the points of the one before it */
+#define NUM_TS_DECIMATIONS 2
+
+/** A decimated time series.  Like the time series itself the data for each signal
+  * are stored twice in a row of 2*numTimePoints, so that any numTimePoints consecutive
+  * points, oldest first, are contiguous in memory. */
+typedef struct {
+  int factor;        /**< Points of the previous series averaged into each point; 1 disables this decimation */
+  int numAveraged;   /**< Points of the previous series in sum */
+  int currentPoint;  /**< Index of the next point to write */
+  double *sum;       /**< Sum of each signal, [numSignals] */
+  double *average;   /**< Last point of each signal, [numSignals] */
+  double *data;      /**< Time series of each signal, [numSignals][2*numTimePoints] */
+} NDTimeSeriesDecimation_t;
 
 
 /** Compute time series on signals */
@@ -61,16 +84,25 @@ protected:
   int P_TSAcquireMode;
   int P_TSTimeAxis;
   int P_TSTimestamp;
+  int P_TSChunkSize;
+  int P_TSChunkSequence;
+  int P_TSChunkTimestamp;
+  int P_TSDecimate[NUM_TS_DECIMATIONS];
 
   // Per-signal parameters
   int P_TSTimeSeries;
+  int P_TSChunk;
+  int P_TSDecimated[NUM_TS_DECIMATIONS];
                                 
 private:
   template <typename epicsType> asynStatus doAddToTimeSeriesT(NDArray *pArray);
   asynStatus addToTimeSeries(NDArray *pArray);
   asynStatus clear(epicsUInt32 roi);
-  template <typename epicsType> void doTimeSeriesCallbacksT();
+  template <typename epicsType> void copyTimeSeriesT(NDArray *pArrayOut, int firstPoint);
   asynStatus doTimeSeriesCallbacks();
+  void doChunkCallbacks();
+  void addDecimatedPoint(const double *pValues);
+  void resetDecimation(int decimation);
   void allocateArrays();
   void acquireReset();
   void createAxisArray();
@@ -80,9 +112,11 @@ private:
   int numSignals_;
   int numSignalsIn_;
   NDDataType_t dataType_;
-  int dataSize_;
   int numTimePoints_;
   int currentTimePoint_;
+  int numNewPoints_;    /* Time points since the last chunk */
+  int chunkSize_;
+  int chunkSequence_;
   int uniqueId_;
   int numAverage_;
   int numAveraged_;
@@ -92,10 +126,10 @@ private:
   double timePerPoint_; /* Actual time between points in input arrays */
   epicsTimeStamp startTime_;
   double *averageStore_;
-  double *signalData_;
+  double *signalData_;  /* [numSignals][2*numTimePoints], see NDTimeSeriesDecimation_t */
   double *timeAxis_;
-  double *timeStamp_;
-  NDArray *pTimeCircular_;
+  double *timeStamp_;   /* [2*numTimePoints] */
+  NDTimeSeriesDecimation_t decimations_[NUM_TS_DECIMATIONS];
 };
     
 #endif //NDPluginTimeSeries_H
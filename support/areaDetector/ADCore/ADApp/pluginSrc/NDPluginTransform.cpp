@@ -12,6 +12,7 @@
  */
 
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <stdio.h>
 #include <math.h>
@@ -29,6 +30,8 @@
 #include "NDPluginDriver.h"
 #include "NDPluginTransform.h"
 
+static const char* pluginName = "NDPluginTransform";
+
 /* Enums to describe the types of transformations */
 typedef enum {
   TransformNone,
@@ -41,445 +44,55 @@ typedef enum {
   TransformRotate270Mirror,
 } NDPluginTransformType_t;
 
-/** Perform the move of the pixels to the new orientation. */
+/** Number of output rows and columns in each block of the transform kernel.  For rotations the input
+  * is read down columns, and a block keeps the cache lines of the input columns in the cache until all of
+  * their elements have been used. */
+#define TRANSFORM_BLOCK_SIZE 32
+
+/** Perform the move of the pixels to the new orientation.
+  * The input element for output pixel (x, y) and color c is inOrigin + x*inStepX + y*inStepY + c*inColorStride.
+  * The output is written in blocks of TRANSFORM_BLOCK_SIZE x TRANSFORM_BLOCK_SIZE pixels; rows that
+  * are not reversed are copied with memcpy. */
 template <typename epicsType>
-void transformNDArray(NDArray *inArray, NDArray *outArray, int transformType, int colorMode, NDArrayInfo_t *arrayInfo)
+void transformNDArray(const epicsType *inData, epicsType *outData,
+                      ptrdiff_t outXSize, ptrdiff_t outYSize, ptrdiff_t colorSize,
+                      ptrdiff_t inOrigin, ptrdiff_t inStepX, ptrdiff_t inStepY, ptrdiff_t inColorStride,
+                      ptrdiff_t outXStride, ptrdiff_t outYStride, ptrdiff_t outColorStride)
 {
-  epicsType *inData = (epicsType *)inArray->pData;
-  epicsType *outData = (epicsType *)outArray->pData;
-  int x, y, color;
-  int xSize, ySize, colorSize;
-  int xStride, yStride, colorStride;
-  int elementSize;
-
-  xSize = (int)arrayInfo->xSize;
-  ySize = (int)arrayInfo->ySize;
-  if (arrayInfo->colorSize > 0)
-    colorSize = (int)arrayInfo->colorSize;
-  else
-    colorSize = 1;
-
-  xStride = (int)arrayInfo->xStride;
-  yStride = (int)arrayInfo->yStride;
-  colorStride = (int)arrayInfo->colorStride;
-  elementSize = arrayInfo->bytesPerElement;
-
-  // Assume output array is same dimensions as input.  Handle rotation cases below.
-  outArray->dims[arrayInfo->xDim].size = inArray->dims[arrayInfo->xDim].size;
-  outArray->dims[arrayInfo->yDim].size = inArray->dims[arrayInfo->yDim].size;
-  if (inArray->ndims > 2) outArray->dims[arrayInfo->colorDim].size = inArray->dims[arrayInfo->colorDim].size;
-
-  switch (transformType)
-  {
-    case (TransformNone):
-
-      // Nothing to do, since the input array has already been copied to the output array
-      break;
-
-    case (TransformRotate90):
-
-      outArray->dims[arrayInfo->xDim].size = inArray->dims[arrayInfo->yDim].size;
-      outArray->dims[arrayInfo->yDim].size = inArray->dims[arrayInfo->xDim].size;
-
-      if (colorMode == NDColorModeMono)
-      {      
-        for (x = 0; x < xSize; x++)
-        {
-          for (y = (ySize - 1); y >= 0; y--)
-          {
-            outData[(((ySize-1) - y) * xStride) + (x * ySize)] = inData[(y * yStride) + (x * xStride)];
-          }
-        }          
-      }
-
-      if (colorMode == NDColorModeRGB3)
-      {      
-        for (x = 0; x < xSize; x++)
-        {
-          for (y = (ySize - 1); y >= 0; y--)
-          {
-            /** Copy three values for each iteration of the inner loop.  This moves the red, green, and blue information. */
-            outData[(((ySize-1) - y) * xStride) + (x * ySize)] = inData[(y * yStride) + (x * xStride)];
-            outData[(((ySize-1) - y) * xStride) + (x * ySize) + colorStride] = inData[(y * yStride) + (x * xStride) + colorStride];
-            outData[(((ySize-1) - y) * xStride) + (x * ySize) + (2 * colorStride)] = inData[(y * yStride) + (x * xStride) + (2 * colorStride)];
-          }
-        }          
-      }
-
-      if (colorMode == NDColorModeRGB2)
-      {
-        /** The values of colorStride and yStride need to change
-          because the dimensions of the image may have changed.
-        */
-        int newColorStride = ySize;
-        int newYStride = newColorStride * colorSize;
-
-        for (y = (ySize - 1); y >= 0; y--)
-        {
-          for (x = (xSize - 1); x >= 0; x--)
-          {
-            /** Copy three values for each iteration of the inner loop.  This moves the red, green, and blue information. */
-            outData[(((ySize - 1) - y) * xStride) + (x * newYStride)] = inData[(y * yStride) + (x * xStride)];
-            outData[(((ySize - 1) - y) * xStride) + (x * newYStride) + newColorStride] = inData[(y * yStride) + (x * xStride) + colorStride];
-            outData[(((ySize - 1) - y) * xStride) + (x * newYStride) + (2 * newColorStride)] = inData[(y * yStride) + (x * xStride) + (2 * colorStride)];
-          }
-        }
-      }
-
-      if (colorMode == NDColorModeRGB1)
-      {
-        int source_offset;
-        int target_offset;
-
-        /** Calculate a new value for the Y stride. */
-        int newStride = colorSize * ySize;
-
-        for (y = (ySize - 1); y >= 0; y--)
-        {
-          for (x = (xSize - 1); x >= 0; x--)
-          {
-            source_offset = (x * xStride) + (y * yStride);
-            target_offset = (((ySize - 1) - y) * xStride) + (x * (newStride));
-            outData[target_offset + 0] = inData[source_offset + 0];;
-            outData[target_offset + 1] = inData[source_offset + 1];;
-            outData[target_offset + 2] = inData[source_offset + 2];;
-          }
-        }
-      }
-
-      break;
-
-    case (TransformRotate180):
-
-      if (colorMode == NDColorModeMono)
-      {
-        for (y = (ySize - 1); y >= 0; y--)
-        {
-          for (x = (xSize - 1); x >= 0; x--)
-          {
-            outData[(((xSize - 1) - x) * xStride) + (((ySize - 1) - y) * yStride)] = inData[(y * yStride) + (x * xStride)];
-          }
-        }
-      }
-      else
-      {
-        for (y = (ySize - 1); y >= 0; y--)
-        {
-          for (x = (xSize - 1); x >= 0; x--)
-          {
-            /** Copy three values for each iteration of the inner loop.  This moves the red, green, and blue information. */
-            outData[(((xSize - 1) - x) * xStride) + (((ySize - 1) - y) * yStride)] = inData[(y * yStride) + (x * xStride)];
-            outData[(((xSize - 1) - x) * xStride) + (((ySize - 1) - y) * yStride) + colorStride] = inData[(y * yStride) + (x * xStride) + colorStride];
-            outData[(((xSize - 1) - x) * xStride) + (((ySize - 1) - y) * yStride) + (2 * colorStride)] = inData[(y * yStride) + (x * xStride) + (2 * colorStride)];
-          }
-        }
-      }  
-      break;
-
-    case (TransformRotate270):
-
-      outArray->dims[arrayInfo->xDim].size = inArray->dims[arrayInfo->yDim].size;
-      outArray->dims[arrayInfo->yDim].size = inArray->dims[arrayInfo->xDim].size;
-
-      if (colorMode == NDColorModeMono)
-      {
-        for (x = (xSize - 1); x >= 0; x--)
-        {
-          for (y = 0; y < ySize; y++)
-          {
-            outData[(y * xStride) + (((xSize - 1) - x) * ySize)] = inData[(y * yStride) + (x * xStride)];
-          }
-        }
-      }
-
-      if (colorMode == NDColorModeRGB3)
-      {
-        for (x = (xSize - 1); x >= 0; x--)
-        {
-          for (y = 0; y < ySize; y++)
-          {
-            /** Copy three values for each iteration of the inner loop.  This moves the red, green, and blue information. */
-            outData[(y * xStride) + (((xSize - 1) - x) * ySize)]           = inData[(y * yStride) + (x * xStride)];
-            outData[(y * xStride) + (((xSize - 1) - x) * ySize) + colorStride]     = inData[(y * yStride) + (x * xStride) + colorStride];
-            outData[(y * xStride) + (((xSize - 1) - x) * ySize) + (2 * colorStride)] = inData[(y * yStride) + (x * xStride) + (2 * colorStride)];
-          }
-        }
-      }
-
-      if (colorMode == NDColorModeRGB2)
-      {
-        /** The values of colorStride and yStride need to change
-          because the dimensions of the image may have changed.
-        */
-        int newColorStride = ySize;
-        int newYStride = newColorStride * colorSize;
-
-        for (y = 0; y < ySize; y++)
-        {
-          for (x = (xSize - 1); x >= 0; x--)
-          {
-            /** Copy three values for each iteration of the inner loop.  This moves the red, green, and blue information. */
-            outData[(y * xStride) + (((xSize - 1) - x) * newYStride)]            = inData[(y * yStride) + (x * xStride)];
-            outData[(y * xStride) + (((xSize - 1) - x) * newYStride) + newColorStride]     = inData[(y * yStride) + (x * xStride) + colorStride];
-            outData[(y * xStride) + (((xSize - 1) - x) * newYStride) + (2 * newColorStride)] = inData[(y * yStride) + (x * xStride) + (2 * colorStride)];
-          }
-        }
-      }
-
-      if (colorMode == NDColorModeRGB1)
-      {
-        int source_offset;
-        int target_offset;
-
-        /** Calculate a new value for the Y stride. */
-        int newStride = colorSize * ySize;
-
-        for (y = 0; y < ySize; y++)
-        {
-          for (x = (xSize - 1); x >= 0; x--)
-          {
-            source_offset = (x * xStride) + (y * yStride);
-            target_offset = (y * xStride) + (((xSize-1) - x) * (newStride));
-            outData[target_offset + 0] = inData[source_offset + 0];;
-            outData[target_offset + 1] = inData[source_offset + 1];;
-            outData[target_offset + 2] = inData[source_offset + 2];;
-          }
-        }
-      }
-
-      break;
-
-    case (TransformRotate90Mirror):
-
-      outArray->dims[arrayInfo->xDim].size = inArray->dims[arrayInfo->yDim].size;
-      outArray->dims[arrayInfo->yDim].size = inArray->dims[arrayInfo->xDim].size;
-
-      if (colorMode == NDColorModeMono)
-      {
-        for (x = 0; x < xSize; x++)
-        {
-          for (y = 0; y < ySize; y++)
-          {
-            outData[(y * xStride) + (x * ySize)] = inData[(y * yStride) + (x * xStride)];
-          }
-        }
-      }
-
-      if (colorMode == NDColorModeRGB3)
-      {
-        for (x = 0; x < xSize; x++)
-        {
-          for (y = 0; y < ySize; y++)
-          {
-            /** Copy three values for each iteration of the inner loop.  This moves the red, green, and blue information. */
-            outData[(y * xStride) + (x * ySize)] = inData[(y * yStride) + (x * xStride)];
-            outData[(y * xStride) + (x * ySize) + colorStride] = inData[(y * yStride) + (x * xStride) + colorStride];
-            outData[(y * xStride) + (x * ySize) + (2 * colorStride)] = inData[(y * yStride) + (x * xStride) + (2 * colorStride)];
-          }
-        }
-      }
-
-      if (colorMode == NDColorModeRGB2)
-      {
-        /** The values of colorStride and yStride need to change
-          because the dimensions of the image may have changed.
-        */
-        int newColorStride = ySize;
-        int newYStride = newColorStride * colorSize;
-
-        for (y = 0; y < ySize; y++)
-        {
-          for (x = 0; x < xSize; x++)
-          {
-            /** Copy three values for each iteration of the inner loop.  This moves the red, green, and blue information. */
-            outData[(y * xStride) + (x * newYStride)] = inData[(y * yStride) + (x * xStride)];
-            outData[(y * xStride) + (x * newYStride) + newColorStride] = inData[(y * yStride) + (x * xStride) + colorStride];
-            outData[(y * xStride) + (x * newYStride) + (2 * newColorStride)] = inData[(y * yStride) + (x * xStride) + (2 * colorStride)];
-          }
-        }
-      }
-
-      if (colorMode == NDColorModeRGB1)
-      {
-        int source_offset;
-        int target_offset;
-
-        /** Calculate a new value for the Y stride. */
-        int newStride = colorSize * ySize;
-
-        for (y = 0; y < ySize; y++)
-        {
-          for (x = (xSize - 1); x >= 0; x--)
-          {
-            source_offset = (x * xStride) + (y * yStride);
-            target_offset = (y * xStride) + (x * (newStride));
-            outData[target_offset + 0] = inData[source_offset + 0];;
-            outData[target_offset + 1] = inData[source_offset + 1];;
-            outData[target_offset + 2] = inData[source_offset + 2];;
-          }
-        }
-      }
-
-      break;
-
-    case (TransformRotate270Mirror):
-
-      outArray->dims[arrayInfo->xDim].size = inArray->dims[arrayInfo->yDim].size;
-      outArray->dims[arrayInfo->yDim].size = inArray->dims[arrayInfo->xDim].size;
-
-      if (colorMode == NDColorModeMono)
-      {
-        for (x = (xSize - 1); x >= 0; x--)
-        {
-          for (y = (ySize - 1); y >= 0; y--)
-          {
-            outData[(((ySize - 1) - y) * xStride) + (((xSize - 1) - x) * ySize)] = inData[(y * yStride) + (x * xStride)];
-          }
-        }
-      }
-
-      if (colorMode == NDColorModeRGB3)
-      {
-        for (x = (xSize - 1); x >= 0; x--)
-        {
-          for (y = (ySize - 1); y >= 0; y--)
-          {
-            /** Copy three values for each iteration of the inner loop.  This moves the red, green, and blue information. */
-            outData[(((ySize - 1) - y) * xStride) + (((xSize - 1) - x) * ySize)] = inData[(y * yStride) + (x * xStride)];
-            outData[(((ySize - 1) - y) * xStride) + (((xSize - 1) - x) * ySize) + colorStride] = inData[(y * yStride) + (x * xStride) + colorStride];
-            outData[(((ySize - 1) - y) * xStride) + (((xSize - 1) - x) * ySize) + (2 * colorStride)] = inData[(y * yStride) + (x * xStride) + (2 * colorStride)];
-          }
-        }
-      }
-
-      if (colorMode == NDColorModeRGB2)
-      {
-        /** The values of colorStride and yStride need to change
-          because the dimensions of the image may have changed.
-        */
-        int newColorStride = ySize;
-        int newYStride = newColorStride * colorSize;
-
-        for (y = (ySize - 1); y >= 0; y--)
-        {
-          for (x = (xSize - 1); x >= 0; x--)
-          {
-            /** Copy three values for each iteration of the inner loop.  This moves the red, green, and blue information. */
-            outData[(((ySize - 1) - y) * xStride) + (((xSize - 1) - x) * newYStride)] = inData[(y * yStride) + (x * xStride)];
-            outData[(((ySize - 1) - y) * xStride) + (((xSize - 1) - x) * newYStride) + newColorStride] = inData[(y * yStride) + (x * xStride) + colorStride];
-            outData[(((ySize - 1) - y) * xStride) + (((xSize - 1) - x) * newYStride) + (2 * newColorStride)] = inData[(y * yStride) + (x * xStride) + (2 * colorStride)];
-          }
-        }
-      }
-
-      if (colorMode == NDColorModeRGB1)
-      {
-        int source_offset;
-        int target_offset;
-
-        /** Calculate a new value for the Y stride. */
-        int newStride = colorSize * ySize;
-
-        for (y = (ySize - 1); y >= 0; y--)
-        {
-          for (x = (xSize - 1); x >= 0; x--)
-          {
-            source_offset = (((xSize - 1) - x) * xStride) + (((ySize - 1) - y) * yStride);
-            target_offset = (y * xStride) + (x * (newStride));
-            outData[target_offset + 0] = inData[source_offset + 0];;
-            outData[target_offset + 1] = inData[source_offset + 1];;
-            outData[target_offset + 2] = inData[source_offset + 2];;
-          }
-        }
-      }
-
-      break;
-
-    case (TransformMirror):
-
-      if (colorMode == NDColorModeMono)
-      {
-        for (y = 0; y < ySize; y++)
-        {
-          for (x = (xSize - 1); x >= 0; x--)
-          {
-            outData[(((xSize - 1) - x) * xStride) + (y * yStride)] = inData[(y * yStride) + (x * xStride)];
-          }
-        }
-      }
-      else
-      {
-        for (y = 0; y < ySize; y++)
-        {
-          for (x = (xSize - 1); x >= 0; x--)
-          {
-            /** Copy three values for each iteration of the inner loop.  This moves the red, green, and blue information. */
-            outData[(((xSize - 1) - x) * xStride) + (y * yStride)] = inData[(y * yStride) + (x * xStride)];
-            outData[(((xSize - 1) - x) * xStride) + (y * yStride) + colorStride] = inData[(y * yStride) + (x * xStride) + colorStride];
-            outData[(((xSize - 1) - x) * xStride) + (y * yStride) + (2 * colorStride)] = inData[(y * yStride) + (x * xStride) + (2 * colorStride)];
-          }
-        }
-      }
-      break;
-
-    case (TransformRotate180Mirror):
-
-      int source_offset;
-      int target_offset;
-
-      /** In this mode, we are moving an entire row at once.  First all of the red rows are moved.
-        Next, all of the green rows are moved.  Lastly, all of the blue rows are moved.  In mono
-        mode, the outer loop only executes once.*/
-      if (colorMode == NDColorModeMono || colorMode == NDColorModeRGB3)
-      {
-        for (color = 0; color < colorSize; color++)
-        {          
-          for (y = 0; y < ySize; y++)
-          {
-            source_offset = (y * yStride) + (color * colorStride);
-            target_offset = (((ySize-1) - y) * yStride) + (color * colorStride);
-
-            memcpy(outData + target_offset, inData + source_offset, (yStride * elementSize));
-          }
-
-        }
-      }
-
-      /** In this mode, we are moving three rows at a time. All the red, green, and blue
-        information for each for are moved at once. */
-      if (colorMode == NDColorModeRGB2)
-      {
-        for (y = 0; y < ySize; y++)
-        {
-          source_offset = (y * yStride);
-          target_offset = (((ySize-1) - y) * yStride);
-
-          memcpy(outData + target_offset, inData + source_offset, (yStride * elementSize));
-        }
+  ptrdiff_t x, y, color, xBlock, yBlock, xEnd, yEnd;
+
+  if ((inStepX == outXStride) && (inColorStride == outColorStride) &&
+      ((inStepX == 1) || ((inStepX == colorSize) && (inColorStride == 1)))) {
+    /* Rows are in the same order in the input and output, and are contiguous in both.
+     * With interleaved colors (RGB1) a row holds all of the colors. */
+    ptrdiff_t rowColors = (inStepX == 1) ? colorSize : 1;
+    size_t rowBytes = outXSize * ((inStepX == 1) ? 1 : colorSize) * sizeof(epicsType);
+    for (color = 0; color < rowColors; color++) {
+      for (y = 0; y < outYSize; y++) {
+        memcpy(outData + color*outColorStride + y*outYStride,
+               inData + inOrigin + color*inColorStride + y*inStepY, rowBytes);
       }
+    }
+    return;
+  }
 
-      if (colorMode == NDColorModeRGB1)
-      {
-        for (y = 0; y < ySize; y++)
-        {
-          for (x = 0; x < xSize; x++)
-          {
-            source_offset = (x * xStride) + (y * yStride);
-            target_offset = (x * xStride) + (((ySize-1) - y) * yStride);
-            outData[target_offset + 0] = inData[source_offset + 0];;
-            outData[target_offset + 1] = inData[source_offset + 1];;
-            outData[target_offset + 2] = inData[source_offset + 2];;
+  for (yBlock = 0; yBlock < outYSize; yBlock += TRANSFORM_BLOCK_SIZE) {
+    yEnd = (yBlock + TRANSFORM_BLOCK_SIZE < outYSize) ? yBlock + TRANSFORM_BLOCK_SIZE : outYSize;
+    for (xBlock = 0; xBlock < outXSize; xBlock += TRANSFORM_BLOCK_SIZE) {
+      xEnd = (xBlock + TRANSFORM_BLOCK_SIZE < outXSize) ? xBlock + TRANSFORM_BLOCK_SIZE : outXSize;
+      for (color = 0; color < colorSize; color++) {
+        for (y = yBlock; y < yEnd; y++) {
+          ptrdiff_t in = inOrigin + color*inColorStride + y*inStepY + xBlock*inStepX;
+          epicsType *pOut = outData + color*outColorStride + y*outYStride + xBlock*outXStride;
+          for (x = xBlock; x < xEnd; x++) {
+            *pOut = inData[in];
+            in += inStepX;
+            pOut += outXStride;
           }
         }
       }
-
-      break;
-
-    default:
-      break;
+    }
   }
-
-  return;
 }
 
 /** Callback function that is called by the NDArray driver with new NDArray data.
@@ -489,6 +102,7 @@ void transformNDArray(NDArray *inArray, NDArray *outArray, int transformType, in
 void NDPluginTransform::processCallbacks(NDArray *pArray){
   NDArray *transformedArray;
   NDArrayInfo_t arrayInfo;
+  int transformType;
   static const char* functionName = "processCallbacks";
 
   /* Call the base class method */
@@ -503,18 +117,31 @@ void NDPluginTransform::processCallbacks(NDArray *pArray){
   this->userDims_[1] = arrayInfo.yDim;
   this->userDims_[2] = arrayInfo.colorDim;
 
-  /* Copy the information from the current array */
-  transformedArray = this->pNDArrayPool->copy(pArray, NULL, 1);
+  getIntegerParam(NDPluginTransformType_, &transformType);
 
-  /* Release the lock; this is computationally intensive and does not access any shared data */
-  this->unlock();
-  if ( pArray->ndims <=3 )
-    this->transformImage(pArray, transformedArray, &arrayInfo);
-  else {
-    asynPrint( this->pasynUserSelf, ASYN_TRACE_ERROR, "%s::%s, this method is meant to transform 2Dimages when the number of dimensions is <= 3\n",
+  if ((transformType == TransformNone) || (pArray->ndims < 2) || (pArray->ndims > 3)) {
+    if ( pArray->ndims > 3 ) {
+      asynPrint( this->pasynUserSelf, ASYN_TRACE_ERROR, "%s::%s, this method is meant to transform 2Dimages when the number of dimensions is <= 3\n",
+            pluginName, functionName);
+    }
+    /* The output is the input array unchanged, so it shares the input buffer */
+    transformedArray = this->pNDArrayPool->view(pArray);
+  } else {
+    /* Copy the information from the current array; every pixel is written by the transform */
+    transformedArray = this->pNDArrayPool->copy(pArray, NULL, 0);
+    if (transformedArray) {
+      /* Release the lock; this is computationally intensive and does not access any shared data */
+      this->unlock();
+      this->transformImage(pArray, transformedArray, transformType, &arrayInfo);
+      this->lock();
+    }
+  }
+  if (!transformedArray) {
+    asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR, "%s::%s, cannot allocate output array\n",
           pluginName, functionName);
+    callParamCallbacks();
+    return;
   }
-  this->lock();
 
   // Set NDArraySizeX and NDArraySizeY appropriately
   setIntegerParam(NDArraySizeX, (int)transformedArray->dims[arrayInfo.xDim].size);
@@ -526,49 +153,118 @@ void NDPluginTransform::processCallbacks(NDArray *pArray){
   callParamCallbacks();
 }
 
-
-/** Transform the image according to the selected choice.*/  
-void NDPluginTransform::transformImage(NDArray *inArray, NDArray *outArray, NDArrayInfo_t *arrayInfo)
+
+/** Transform the image according to the selected choice.
+  * Each transform is described by the input element of output pixel (0, 0) and the steps through
+  * the input for the output X and Y directions.  The output has the same color mode as the input,
+  * with the X and Y sizes exchanged for the transforms that rotate by 90 or 270 degrees. */
+void NDPluginTransform::transformImage(NDArray *inArray, NDArray *outArray, int transformType, NDArrayInfo_t *arrayInfo)
 {
-  //static const char *functionName = "transformNDArray";
-  int colorMode;
-  int transformType;
+  ptrdiff_t xSize = arrayInfo->xSize;
+  ptrdiff_t ySize = arrayInfo->ySize;
+  ptrdiff_t colorSize = (arrayInfo->colorSize > 0) ? arrayInfo->colorSize : 1;
+  ptrdiff_t xStride = arrayInfo->xStride;
+  ptrdiff_t yStride = arrayInfo->yStride;
+  ptrdiff_t colorStride = (colorSize > 1) ? arrayInfo->colorStride : 0;
+  ptrdiff_t outXSize = xSize, outYSize = ySize;
+  ptrdiff_t origin = 0, stepX = xStride, stepY = yStride;
+  ptrdiff_t outStrides[ND_ARRAY_MAX_DIMS], stride = 1;
+  ptrdiff_t outXStride, outYStride, outColorStride;
+  int i;
 
-  colorMode = NDColorModeMono;
-  getIntegerParam(NDColorMode, &colorMode);
-  getIntegerParam(NDPluginTransformType_, &transformType);
+  switch (transformType) {
+    case TransformRotate90:
+      outXSize = ySize;
+      outYSize = xSize;
+      origin = (ySize - 1) * yStride;
+      stepX = -yStride;
+      stepY = xStride;
+      break;
+    case TransformRotate180:
+      origin = (xSize - 1) * xStride + (ySize - 1) * yStride;
+      stepX = -xStride;
+      stepY = -yStride;
+      break;
+    case TransformRotate270:
+      outXSize = ySize;
+      outYSize = xSize;
+      origin = (xSize - 1) * xStride;
+      stepX = yStride;
+      stepY = -xStride;
+      break;
+    case TransformMirror:
+      origin = (xSize - 1) * xStride;
+      stepX = -xStride;
+      break;
+    case TransformRotate90Mirror:
+      outXSize = ySize;
+      outYSize = xSize;
+      stepX = yStride;
+      stepY = xStride;
+      break;
+    case TransformRotate180Mirror:
+      origin = (ySize - 1) * yStride;
+      stepY = -yStride;
+      break;
+    case TransformRotate270Mirror:
+      outXSize = ySize;
+      outYSize = xSize;
+      origin = (xSize - 1) * xStride + (ySize - 1) * yStride;
+      stepX = -yStride;
+      stepY = -xStride;
+      break;
+    default:
+      break;
+  }
+
+  outArray->dims[arrayInfo->xDim].size = outXSize;
+  outArray->dims[arrayInfo->yDim].size = outYSize;
+  for (i = 0; i < outArray->ndims; i++) {
+    outStrides[i] = stride;
+    stride *= outArray->dims[i].size;
+  }
+
+  outXStride = outStrides[arrayInfo->xDim];
+  outYStride = outStrides[arrayInfo->yDim];
+  outColorStride = (colorSize > 1) ? outStrides[arrayInfo->colorDim] : 0;
 
   switch (inArray->dataType) {
     case NDInt8:
-      transformNDArray<epicsInt8>(inArray, outArray, transformType, colorMode, arrayInfo);
+      transformNDArray<epicsInt8>((const epicsInt8 *)inArray->pData, (epicsInt8 *)outArray->pData, outXSize, outYSize, colorSize,
+                       origin, stepX, stepY, colorStride, outXStride, outYStride, outColorStride);
       break;
     case NDUInt8:
-      transformNDArray<epicsUInt8>(inArray, outArray, transformType, colorMode, arrayInfo);
+      transformNDArray<epicsUInt8>((const epicsUInt8 *)inArray->pData, (epicsUInt8 *)outArray->pData, outXSize, outYSize, colorSize,
+                       origin, stepX, stepY, colorStride, outXStride, outYStride, outColorStride);
       break;
     case NDInt16:
-      transformNDArray<epicsInt16>(inArray, outArray, transformType, colorMode, arrayInfo);
+      transformNDArray<epicsInt16>((const epicsInt16 *)inArray->pData, (epicsInt16 *)outArray->pData, outXSize, outYSize, colorSize,
+                       origin, stepX, stepY, colorStride, outXStride, outYStride, outColorStride);
       break;
     case NDUInt16:
-      transformNDArray<epicsUInt16>(inArray, outArray, transformType, colorMode, arrayInfo);
+      transformNDArray<epicsUInt16>((const epicsUInt16 *)inArray->pData, (epicsUInt16 *)outArray->pData, outXSize, outYSize, colorSize,
+                       origin, stepX, stepY, colorStride, outXStride, outYStride, outColorStride);
       break;
     case NDInt32:
-      transformNDArray<epicsInt32>(inArray, outArray, transformType, colorMode, arrayInfo);
+      transformNDArray<epicsInt32>((const epicsInt32 *)inArray->pData, (epicsInt32 *)outArray->pData, outXSize, outYSize, colorSize,
+                       origin, stepX, stepY, colorStride, outXStride, outYStride, outColorStride);
       break;
     case NDUInt32:
-      transformNDArray<epicsUInt32>(inArray, outArray, transformType, colorMode, arrayInfo);
+      transformNDArray<epicsUInt32>((const epicsUInt32 *)inArray->pData, (epicsUInt32 *)outArray->pData, outXSize, outYSize, colorSize,
+                       origin, stepX, stepY, colorStride, outXStride, outYStride, outColorStride);
       break;
     case NDFloat32:
-      transformNDArray<epicsFloat32>(inArray, outArray, transformType, colorMode, arrayInfo);
+      transformNDArray<epicsFloat32>((const epicsFloat32 *)inArray->pData, (epicsFloat32 *)outArray->pData, outXSize, outYSize, colorSize,
+                       origin, stepX, stepY, colorStride, outXStride, outYStride, outColorStride);
       break;
     case NDFloat64:
-      transformNDArray<epicsFloat64>(inArray, outArray, transformType, colorMode, arrayInfo);
+      transformNDArray<epicsFloat64>((const epicsFloat64 *)inArray->pData, (epicsFloat64 *)outArray->pData, outXSize, outYSize, colorSize,
+                       origin, stepX, stepY, colorStride, outXStride, outYStride, outColorStride);
       break;
   }
-
-  return;
 }
 
-
+
 /** Constructor for NDPluginTransform; most parameters are simply passed to NDPluginDriver::NDPluginDriver.
   * After calling the base class constructor this method sets reasonable default values for all of the
   * Transform parameters.
@@ -10,8 +10,6 @@
   */
 #define NDPluginTransformTypeString  "TRANSFORM_TYPE"
 
-static const char* pluginName = "NDPluginTransform";
-
 /** Perform transformations (rotations, flips) on NDArrays.   */
 class epicsShareClass NDPluginTransform : public NDPluginDriver {
 public:
@@ -28,7 +26,7 @@ protected:
 
 private:
     size_t userDims_[ND_ARRAY_MAX_DIMS];
-    void transformImage(NDArray *inArray, NDArray *outArray, NDArrayInfo_t *arrayInfo);
+    void transformImage(NDArray *inArray, NDArray *outArray, int transformType, NDArrayInfo_t *arrayInfo);
 };
 
 #endif
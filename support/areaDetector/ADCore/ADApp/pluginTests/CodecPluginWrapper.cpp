@@ -0,0 +1,18 @@
+/*
+ * CodecPluginWrapper.cpp
+ *
+ *  Created on: 19 Oct 2026
+ */
+
+#include "CodecPluginWrapper.h"
+
+CodecPluginWrapper::CodecPluginWrapper(const std::string& port, const std::string& detectorPort)
+  :  NDPluginCodec(port.c_str(), 50, 1, detectorPort.c_str(), 0, 0, 0, 0, 0, 1),
+     AsynPortClientContainer(port)
+{
+}
+
+CodecPluginWrapper::~CodecPluginWrapper ()
+{
+  cleanup();
+}
@@ -0,0 +1,20 @@
+/*
+ * CodecPluginWrapper.h
+ *
+ *  Created on: 19 Oct 2026
+ */
+
+#ifndef ADAPP_PLUGINTESTS_CODECPLUGINWRAPPER_H_
+#define ADAPP_PLUGINTESTS_CODECPLUGINWRAPPER_H_
+
+#include <NDPluginCodec.h>
+#include "AsynPortClientContainer.h"
+
+class CodecPluginWrapper : public NDPluginCodec, public AsynPortClientContainer
+{
+public:
+  CodecPluginWrapper(const std::string& port, const std::string& detectorPort);
+  virtual ~CodecPluginWrapper ();
+};
+
+#endif /* ADAPP_PLUGINTESTS_CODECPLUGINWRAPPER_H_ */
@@ -0,0 +1,18 @@
+/*
+ * ColorConvertPluginWrapper.cpp
+ *
+ *  Created on: 19 Oct 2026
+ */
+
+#include "ColorConvertPluginWrapper.h"
+
+ColorConvertPluginWrapper::ColorConvertPluginWrapper(const std::string& port, const std::string& detectorPort)
+  :  NDPluginColorConvert(port.c_str(), 50, 1, detectorPort.c_str(), 0, 0, 0, 0, 0, 1),
+     AsynPortClientContainer(port)
+{
+}
+
+ColorConvertPluginWrapper::~ColorConvertPluginWrapper ()
+{
+  cleanup();
+}
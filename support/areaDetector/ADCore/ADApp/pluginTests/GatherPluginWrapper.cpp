@@ -0,0 +1,18 @@
+/*
+ * GatherPluginWrapper.cpp
+ *
+ *  Created on: 19 Oct 2026
+ */
+
+#include "GatherPluginWrapper.h"
+
+GatherPluginWrapper::GatherPluginWrapper(const std::string& port, int queueSize, int blocking, int maxPorts)
+  :  NDPluginGather(port.c_str(), queueSize, blocking, maxPorts, 0, 0, 0, 0),
+     AsynPortClientContainer(port)
+{
+}
+
+GatherPluginWrapper::~GatherPluginWrapper ()
+{
+  cleanup();
+}
@@ -0,0 +1,20 @@
+/*
+ * GatherPluginWrapper.h
+ *
+ *  Created on: 19 Oct 2026
+ */
+
+#ifndef ADAPP_PLUGINTESTS_GATHERPLUGINWRAPPER_H_
+#define ADAPP_PLUGINTESTS_GATHERPLUGINWRAPPER_H_
+
+#include <NDPluginGather.h>
+#include "AsynPortClientContainer.h"
+
+class GatherPluginWrapper : public NDPluginGather, public AsynPortClientContainer
+{
+public:
+  GatherPluginWrapper(const std::string& port, int queueSize, int blocking, int maxPorts);
+  virtual ~GatherPluginWrapper ();
+};
+
+#endif /* ADAPP_PLUGINTESTS_GATHERPLUGINWRAPPER_H_ */
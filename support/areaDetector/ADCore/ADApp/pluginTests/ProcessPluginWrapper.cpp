@@ -0,0 +1,18 @@
+/*
+ * ProcessPluginWrapper.cpp
+ *
+ *  Created on: 19 Oct 2026
+ */
+
+#include "ProcessPluginWrapper.h"
+
+ProcessPluginWrapper::ProcessPluginWrapper(const std::string& port, const std::string& detectorPort)
+  :  NDPluginProcess(port.c_str(), 50, 1, detectorPort.c_str(), 0, 0, 0, 0, 0),
+     AsynPortClientContainer(port)
+{
+}
+
+ProcessPluginWrapper::~ProcessPluginWrapper ()
+{
+  cleanup();
+}
@@ -0,0 +1,20 @@
+/*
+ * ProcessPluginWrapper.h
+ *
+ *  Created on: 19 Oct 2026
+ */
+
+#ifndef ADAPP_PLUGINTESTS_PROCESSPLUGINWRAPPER_H_
+#define ADAPP_PLUGINTESTS_PROCESSPLUGINWRAPPER_H_
+
+#include <NDPluginProcess.h>
+#include "AsynPortClientContainer.h"
+
+class ProcessPluginWrapper : public NDPluginProcess, public AsynPortClientContainer
+{
+public:
+  ProcessPluginWrapper(const std::string& port, const std::string& detectorPort);
+  virtual ~ProcessPluginWrapper ();
+};
+
+#endif /* ADAPP_PLUGINTESTS_PROCESSPLUGINWRAPPER_H_ */
@@ -0,0 +1,18 @@
+/*
+ * ScatterPluginWrapper.cpp
+ *
+ *  Created on: 19 Oct 2026
+ */
+
+#include "ScatterPluginWrapper.h"
+
+ScatterPluginWrapper::ScatterPluginWrapper(const std::string& port, const std::string& detectorPort)
+  :  NDPluginScatter(port.c_str(), 50, 1, detectorPort.c_str(), 0, 0, 0, 0, 0),
+     AsynPortClientContainer(port)
+{
+}
+
+ScatterPluginWrapper::~ScatterPluginWrapper ()
+{
+  cleanup();
+}
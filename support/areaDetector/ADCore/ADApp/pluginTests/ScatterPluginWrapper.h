@@ -0,0 +1,20 @@
+/*
+ * ScatterPluginWrapper.h
+ *
+ *  Created on: 19 Oct 2026
+ */
+
+#ifndef ADAPP_PLUGINTESTS_SCATTERPLUGINWRAPPER_H_
+#define ADAPP_PLUGINTESTS_SCATTERPLUGINWRAPPER_H_
+
+#include <NDPluginScatter.h>
+#include "AsynPortClientContainer.h"
+
+class ScatterPluginWrapper : public NDPluginScatter, public AsynPortClientContainer
+{
+public:
+  ScatterPluginWrapper(const std::string& port, const std::string& detectorPort);
+  virtual ~ScatterPluginWrapper ();
+};
+
+#endif /* ADAPP_PLUGINTESTS_SCATTERPLUGINWRAPPER_H_ */
@@ -0,0 +1,18 @@
+/*
+ * StatsPluginWrapper.cpp
+ *
+ *  Created on: 19 Oct 2026
+ */
+
+#include "StatsPluginWrapper.h"
+
+StatsPluginWrapper::StatsPluginWrapper(const std::string& port, const std::string& detectorPort)
+  :  NDPluginStats(port.c_str(), 50, 1, detectorPort.c_str(), 0, 0, 0, 0, 0, 1),
+     AsynPortClientContainer(port)
+{
+}
+
+StatsPluginWrapper::~StatsPluginWrapper ()
+{
+  cleanup();
+}
@@ -0,0 +1,20 @@
+/*
+ * TIFFPluginWrapper.h
+ *
+ *  Created on: 19 Oct 2026
+ */
+
+#ifndef ADAPP_PLUGINTESTS_TIFFPLUGINWRAPPER_H_
+#define ADAPP_PLUGINTESTS_TIFFPLUGINWRAPPER_H_
+
+#include <NDFileTIFF.h>
+#include "AsynPortClientContainer.h"
+
+class TIFFPluginWrapper : public NDFileTIFF, public AsynPortClientContainer
+{
+public:
+  TIFFPluginWrapper(const std::string& port, const std::string& detectorPort);
+  virtual ~TIFFPluginWrapper ();
+};
+
+#endif /* ADAPP_PLUGINTESTS_TIFFPLUGINWRAPPER_H_ */
@@ -0,0 +1,18 @@
+/*
+ * TransformPluginWrapper.cpp
+ *
+ *  Created on: 19 Oct 2026
+ */
+
+#include "TransformPluginWrapper.h"
+
+TransformPluginWrapper::TransformPluginWrapper(const std::string& port, const std::string& detectorPort)
+  :  NDPluginTransform(port.c_str(), 50, 1, detectorPort.c_str(), 0, 0, 0, 0, 0, 1),
+     AsynPortClientContainer(port)
+{
+}
+
+TransformPluginWrapper::~TransformPluginWrapper ()
+{
+  cleanup();
+}
@@ -0,0 +1,20 @@
+/*
+ * TransformPluginWrapper.h
+ *
+ *  Created on: 19 Oct 2026
+ */
+
+#ifndef ADAPP_PLUGINTESTS_TRANSFORMPLUGINWRAPPER_H_
+#define ADAPP_PLUGINTESTS_TRANSFORMPLUGINWRAPPER_H_
+
+#include <NDPluginTransform.h>
+#include "AsynPortClientContainer.h"
+
+class TransformPluginWrapper : public NDPluginTransform, public AsynPortClientContainer
+{
+public:
+  TransformPluginWrapper(const std::string& port, const std::string& detectorPort);
+  virtual ~TransformPluginWrapper ();
+};
+
+#endif /* ADAPP_PLUGINTESTS_TRANSFORMPLUGINWRAPPER_H_ */
@@ -0,0 +1,826 @@
+/*
+ * plugin-bench.cpp
+ *
+ * Measures the throughput of a graph of plugins fed by a synthetic detector.
+ *
+ * The detector and the plugins are described in a configuration file, see README.md and the
+ * examples in the bench directory.  The detector generates a fixed number of frames with the
+ * same contents on every run, at a fixed rate or as fast as possible, and the program reports
+ * the frames per second, the latency of each plugin's output arrays, the arrays dropped, the
+ * execution times and the peak memory of each NDArrayPool.
+ *
+ *  Created on: 19 Oct 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <epicsExit.h>
+#include <epicsMutex.h>
+#include <epicsStdio.h>
+#include <epicsThread.h>
+#include <epicsTime.h>
+#include <asynDriver.h>
+#include <asynPortClient.h>
+
+#include <asynNDArrayDriver.h>
+#include <NDPluginDriver.h>
+
+/* The plugins are created with the same functions as in an IOC's startup script */
+extern "C" {
+int NDStatsConfigure(const char *portName, int queueSize, int blockingCallbacks, const char *NDArrayPort, int NDArrayAddr,
+                     int maxBuffers, size_t maxMemory, int priority, int stackSize, int maxThreads);
+int NDROIConfigure(const char *portName, int queueSize, int blockingCallbacks, const char *NDArrayPort, int NDArrayAddr,
+                   int maxBuffers, size_t maxMemory, int priority, int stackSize, int maxThreads);
+int NDProcessConfigure(const char *portName, int queueSize, int blockingCallbacks, const char *NDArrayPort, int NDArrayAddr,
+                       int maxBuffers, size_t maxMemory, int priority, int stackSize);
+int NDTransformConfigure(const char *portName, int queueSize, int blockingCallbacks, const char *NDArrayPort, int NDArrayAddr,
+                         int maxBuffers, size_t maxMemory, int priority, int stackSize, int maxThreads);
+int NDColorConvertConfigure(const char *portName, int queueSize, int blockingCallbacks, const char *NDArrayPort, int NDArrayAddr,
+                            int maxBuffers, size_t maxMemory, int priority, int stackSize, int maxThreads);
+int NDCodecConfigure(const char *portName, int queueSize, int blockingCallbacks, const char *NDArrayPort, int NDArrayAddr,
+                     int maxBuffers, size_t maxMemory, int priority, int stackSize, int maxThreads);
+int NDROIStatConfigure(const char *portName, int queueSize, int blockingCallbacks, const char *NDArrayPort, int NDArrayAddr,
+                       int maxROIs, int maxBuffers, size_t maxMemory, int priority, int stackSize, int maxThreads);
+int NDOverlayConfigure(const char *portName, int queueSize, int blockingCallbacks, const char *NDArrayPort, int NDArrayAddr,
+                       int maxOverlays, int maxBuffers, size_t maxMemory, int priority, int stackSize, int maxThreads);
+int NDStdArraysConfigure(const char *portName, int queueSize, int blockingCallbacks, const char *NDArrayPort, int NDArrayAddr,
+                         int maxBuffers, size_t maxMemory, int priority, int stackSize, int maxThreads);
+int NDFFTConfigure(const char *portName, int queueSize, int blockingCallbacks, const char *NDArrayPort, int NDArrayAddr,
+                   int maxBuffers, size_t maxMemory, int priority, int stackSize, int maxThreads);
+int NDTimeSeriesConfigure(const char *portName, int queueSize, int blockingCallbacks, const char *NDArrayPort, int NDArrayAddr,
+                          int maxSignals, int maxBuffers, size_t maxMemory, int priority, int stackSize);
+int NDCircularBuffConfigure(const char *portName, int queueSize, int blockingCallbacks, const char *NDArrayPort, int NDArrayAddr,
+                            int maxBuffers, size_t maxMemory);
+int NDAttrConfigure(const char *portName, int queueSize, int blockingCallbacks, const char *NDArrayPort, int NDArrayAddr,
+                    int maxAttributes, int maxBuffers, size_t maxMemory, int priority, int stackSize);
+int NDScatterConfigure(const char *portName, int queueSize, int blockingCallbacks, const char *NDArrayPort, int NDArrayAddr,
+                       int maxBuffers, size_t maxMemory, int priority, int stackSize);
+int NDGatherConfigure(const char *portName, int queueSize, int blockingCallbacks, int maxPorts,
+                      int maxBuffers, size_t maxMemory, int priority, int stackSize);
+int NDFileNullConfigure(const char *portName, int queueSize, int blockingCallbacks, const char *NDArrayPort, int NDArrayAddr,
+                        int priority, int stackSize);
+int NDFileTIFFConfigure(const char *portName, int queueSize, int blockingCallbacks, const char *NDArrayPort, int NDArrayAddr,
+                        int priority, int stackSize);
+}
+
+/* The detector copies each frame from a random buffer, starting at one of this many offsets */
+#define NUM_FRAME_OFFSETS 64
+/* The time to wait for the plugins to process the queued arrays after the last frame (s) */
+#define DRAIN_TIMEOUT 60.
+#define MEGABYTE_DBL 1048576.
+
+typedef std::map<std::string, std::string> BenchArgs;
+
+/** One command of the configuration file, "command key=value ...", with the keys it may use */
+class BenchCommand {
+public:
+  BenchCommand(const std::string& command, const BenchArgs& args, int line)
+    : command_(command), args_(args), line_(line) {}
+
+  void checkKeys(const char *keys)
+  {
+    std::string allowed = std::string(" ") + keys + " ";
+    for (BenchArgs::const_iterator it=args_.begin(); it!=args_.end(); ++it) {
+      if (allowed.find(" " + it->first + " ") == std::string::npos) error("unknown key " + it->first);
+    }
+  }
+
+  std::string getString(const char *key, const char *defaultValue=NULL)
+  {
+    BenchArgs::const_iterator it = args_.find(key);
+    if (it != args_.end()) return it->second;
+    if (!defaultValue) error(std::string("missing key ") + key);
+    return defaultValue;
+  }
+
+  double getDouble(const char *key, double defaultValue)
+  {
+    char *end;
+    std::string value = getString(key, "");
+    if (value.empty()) return defaultValue;
+    double result = strtod(value.c_str(), &end);
+    if (*end) error(std::string("invalid number for ") + key);
+    return result;
+  }
+
+  int getInt(const char *key, int defaultValue) { return (int)getDouble(key, defaultValue); }
+
+  void error(const std::string& message)
+  {
+    std::ostringstream os;
+    os << "line " << line_ << " (" << command_ << "): " << message;
+    throw std::runtime_error(os.str());
+  }
+
+  std::string command_;
+  BenchArgs args_;
+  int line_;
+};
+
+/** Synthetic detector; generates frames of one size and data type, with contents that
+  * depend only on the seed and the frame number */
+class BenchDetector : public asynNDArrayDriver {
+public:
+  BenchDetector(BenchCommand& cmd)
+    : asynNDArrayDriver(cmd.getString("port").c_str(), 1, 0,
+                        (size_t)(cmd.getDouble("maxMemory", 0) * 1024 * 1024),
+                        asynGenericPointerMask, asynGenericPointerMask, 0, 0, 0, 0),
+      port(cmd.getString("port")), numGenerated(0), numDropped(0), seconds(0)
+  {
+    std::string dataTypeName = cmd.getString("dataType", "UInt16");
+    std::string colorModeName = cmd.getString("colorMode", "Mono");
+    size_t sizeX = cmd.getInt("sizeX", 1024);
+    size_t sizeY = cmd.getInt("sizeY", 1024);
+    int numAttributes = cmd.getInt("attributes", 0);
+    NDArrayInfo_t info;
+
+    numFrames = cmd.getInt("frames", 1000);
+    rate = cmd.getDouble("rate", 0);
+    seed = cmd.getInt("seed", 1);
+    bayerPattern = NDBayerRGGB;
+    if (!parseDataType(dataTypeName)) cmd.error("unknown dataType " + dataTypeName);
+    if ((colorModeName == "Mono") || (colorModeName == "Bayer")) {
+      colorMode = (colorModeName == "Mono") ? NDColorModeMono : NDColorModeBayer;
+      /* A single row is sent as a 1-D array, e.g. for NDPluginFFT */
+      ndims = ((sizeY == 1) && (colorMode == NDColorModeMono)) ? 1 : 2;
+      dims[0] = sizeX;
+      dims[1] = sizeY;
+    } else if (colorModeName == "RGB1") {
+      colorMode = NDColorModeRGB1;
+      ndims = 3;
+      dims[0] = 3;
+      dims[1] = sizeX;
+      dims[2] = sizeY;
+    } else {
+      cmd.error("unknown colorMode " + colorModeName);
+    }
+    if ((sizeX < 1) || (sizeY < 1) || (numFrames < 1)) cmd.error("sizeX, sizeY and frames must be at least 1");
+    /* Like the attributes of a detector's attribute file; every tenth one is a string */
+    for (int i=0; i<numAttributes; i++) {
+      char name[20];
+      epicsSnprintf(name, sizeof(name), "BenchAttr%d", i);
+      attributeNames.push_back(name);
+    }
+
+    /* Messages for arrays dropped because the pool is full would slow the detector down */
+    pasynTrace->setTraceMask(pasynUserSelf, 0);
+
+    NDArray *pArray = pNDArrayPool->alloc(ndims, dims, dataType, 0, NULL);
+    if (!pArray) cmd.error("maxMemory is too small for one frame");
+    pArray->getInfo(&info);
+    pArray->release();
+    elementSize = info.bytesPerElement;
+    dataSize = info.totalBytes;
+    fillFrames();
+  }
+
+  /** Sends the frames to the plugins.  Calls sample() after each frame. */
+  void run(void (*sample)(void *), void *samplePvt)
+  {
+    epicsTimeStamp start, now;
+    int arrayData;
+
+    findParam(NDArrayDataString, &arrayData);
+    epicsTimeGetCurrent(&start);
+    for (int i=0; i<numFrames; i++) {
+      if (rate > 0) {
+        epicsTimeGetCurrent(&now);
+        double delay = i/rate - epicsTimeDiffInSeconds(&now, &start);
+        if (delay > 0) epicsThreadSleep(delay);
+      }
+      NDArray *pArray = pNDArrayPool->alloc(ndims, dims, dataType, 0, NULL);
+      if (!pArray) {
+        numDropped++;
+        continue;
+      }
+      memcpy(pArray->pData, &frameData[((i+1) % NUM_FRAME_OFFSETS) * elementSize], dataSize);
+      pArray->uniqueId = i+1;
+      pArray->pAttributeList->add("ColorMode", "Color mode", NDAttrInt32, &colorMode);
+      if (colorMode == NDColorModeBayer) {
+        pArray->pAttributeList->add("BayerPattern", "Bayer pattern", NDAttrInt32, &bayerPattern);
+      }
+      for (size_t j=0; j<attributeNames.size(); j++) {
+        epicsFloat64 value = i + 0.5;
+        if (j % 10 == 0) {
+          pArray->pAttributeList->add(attributeNames[j].c_str(), "", NDAttrString, (void *)"A string value");
+        } else {
+          pArray->pAttributeList->add(attributeNames[j].c_str(), "", NDAttrFloat64, &value);
+        }
+      }
+      epicsTimeGetCurrent(&pArray->epicsTS);
+      pArray->timeStamp = pArray->epicsTS.secPastEpoch + pArray->epicsTS.nsec/1.e9;
+      doCallbacksGenericPointer(pArray, arrayData, 0);
+      pArray->release();
+      numGenerated++;
+      sample(samplePvt);
+    }
+    epicsTimeGetCurrent(&now);
+    seconds = epicsTimeDiffInSeconds(&now, &start);
+  }
+
+  std::string port;
+  int numFrames;
+  int numGenerated;
+  int numDropped;
+  double rate;
+  double seconds;
+
+private:
+  bool parseDataType(const std::string& name)
+  {
+    static const char *names[] = {"Int8", "UInt8", "Int16", "UInt16", "Int32", "UInt32", "Float32", "Float64"};
+    static const NDDataType_t types[] = {NDInt8, NDUInt8, NDInt16, NDUInt16, NDInt32, NDUInt32, NDFloat32, NDFloat64};
+    for (size_t i=0; i<sizeof(names)/sizeof(names[0]); i++) {
+      if (name == names[i]) {
+        dataType = types[i];
+        return true;
+      }
+    }
+    return false;
+  }
+
+  template <typename epicsType>
+  void fillFramesT()
+  {
+    size_t numElements = dataSize/elementSize + NUM_FRAME_OFFSETS;
+    epicsType *pData;
+    epicsUInt32 x = seed;
+
+    frameData.resize(numElements * elementSize);
+    pData = (epicsType *)&frameData[0];
+    /* 12 bit values, like the counts of a detector */
+    for (size_t i=0; i<numElements; i++) {
+      x = x*1664525u + 1013904223u;
+      pData[i] = (epicsType)((x >> 8) & 0xFFF);
+    }
+  }
+
+  void fillFrames()
+  {
+    switch (dataType) {
+      case NDInt8:    fillFramesT<epicsInt8>();    break;
+      case NDUInt8:   fillFramesT<epicsUInt8>();   break;
+      case NDInt16:   fillFramesT<epicsInt16>();   break;
+      case NDUInt16:  fillFramesT<epicsUInt16>();  break;
+      case NDInt32:   fillFramesT<epicsInt32>();   break;
+      case NDUInt32:  fillFramesT<epicsUInt32>();  break;
+      case NDFloat32: fillFramesT<epicsFloat32>(); break;
+      case NDFloat64: fillFramesT<epicsFloat64>(); break;
+    }
+  }
+
+  NDDataType_t dataType;
+  int colorMode;
+  int bayerPattern;
+  std::vector<std::string> attributeNames;
+  int ndims;
+  size_t dims[3];
+  int seed;
+  size_t elementSize;
+  size_t dataSize;
+  std::vector<char> frameData;
+};
+
+/** Records the latency of the output arrays of a plugin, from the time the detector sent the frame */
+class BenchOutput : public asynGenericPointerClient {
+public:
+  BenchOutput(const char *port)
+    : asynGenericPointerClient(port, 0, NDArrayDataString)
+  {
+    lock = epicsMutexMustCreate();
+    registerInterruptUser(callback);
+  }
+
+  static void callback(void *userPvt, asynUser *pasynUser, void *pointer)
+  {
+    BenchOutput *pOutput = (BenchOutput *)userPvt;
+    NDArray *pArray = (NDArray *)pointer;
+    epicsTimeStamp now;
+
+    epicsTimeGetCurrent(&now);
+    epicsMutexLock(pOutput->lock);
+    pOutput->latencies.push_back(epicsTimeDiffInSeconds(&now, &pArray->epicsTS));
+    pOutput->pools.insert(pArray->pNDArrayPool);
+    epicsMutexUnlock(pOutput->lock);
+  }
+
+  /** Returns true if any of the output arrays came from pPool */
+  bool usedPool(NDArrayPool *pPool)
+  {
+    epicsMutexLock(lock);
+    bool used = pools.count(pPool) > 0;
+    epicsMutexUnlock(lock);
+    return used;
+  }
+
+  std::vector<double> sortedLatencies()
+  {
+    epicsMutexLock(lock);
+    std::vector<double> sorted = latencies;
+    epicsMutexUnlock(lock);
+    std::sort(sorted.begin(), sorted.end());
+    return sorted;
+  }
+
+private:
+  epicsMutexId lock;
+  std::vector<double> latencies;
+  std::set<NDArrayPool *> pools;
+};
+
+/** Callback of the array clients; the plugin does the work of converting the array for the client */
+template <typename epicsType>
+static void arrayClientCallback(void *userPvt, asynUser *pasynUser, epicsType *pData, size_t nElements)
+{
+}
+
+template <class ClientType, typename epicsType>
+static asynPortClient *createArrayClient(const char *port, int addr, const char *param)
+{
+  ClientType *pClient = new ClientType(port, addr, param);
+  pClient->registerInterruptUser(arrayClientCallback<epicsType>);
+  return pClient;
+}
+
+struct BenchPlugin {
+  std::string port;
+  std::string type;
+  NDPluginDriver *pPlugin;
+  NDArrayPool *pOwnPool;
+  BenchOutput *pOutput;
+  int maxQueued;
+};
+
+class PluginBench {
+public:
+  PluginBench() : pDetector(NULL) {}
+
+  void readConfig(const char *fileName)
+  {
+    std::ifstream file(fileName);
+    std::string text;
+    int line = 0;
+
+    if (!file) throw std::runtime_error(std::string("cannot open ") + fileName);
+    configName = fileName;
+    while (std::getline(file, text)) {
+      line++;
+      size_t comment = text.find('#');
+      if (comment != std::string::npos) text.erase(comment);
+      std::istringstream words(text);
+      std::string command, word;
+      BenchArgs args;
+      if (!(words >> command)) continue;
+      while (words >> word) {
+        size_t equals = word.find('=');
+        if ((equals == std::string::npos) || (equals == 0)) {
+          BenchCommand(command, args, line).error("expected key=value, not " + word);
+        }
+        args[word.substr(0, equals)] = word.substr(equals+1);
+      }
+      BenchCommand cmd(command, args, line);
+      if (command == "detector") {
+        cmd.checkKeys("port sizeX sizeY dataType colorMode frames rate maxMemory attributes seed");
+        if (pDetector) cmd.error("only one detector is supported");
+        pDetector = new BenchDetector(cmd);
+      } else if (command == "plugin") {
+        cmd.checkKeys("type port input addr queue blocking threads maxBuffers maxMemory n");
+        createPlugin(cmd);
+      } else if (command == "set") {
+        cmd.checkKeys("port param value addr");
+        setParam(cmd);
+      } else if (command == "client") {
+        cmd.checkKeys("port param type addr");
+        createClient(cmd);
+      } else {
+        cmd.error("unknown command");
+      }
+    }
+    if (!pDetector) throw std::runtime_error("no detector in the configuration");
+  }
+
+  void run()
+  {
+    epicsTimeStamp start, now;
+
+    epicsTimeGetCurrent(&start);
+    pDetector->run(sampleC, this);
+    /* Wait until every plugin has been idle for 3 samples in a row */
+    for (int idle=0; idle<3; ) {
+      epicsTimeGetCurrent(&now);
+      if (epicsTimeDiffInSeconds(&now, &start) - pDetector->seconds > DRAIN_TIMEOUT) {
+        printf("Warning: plugins were still busy %.0f s after the last frame\n", DRAIN_TIMEOUT);
+        break;
+      }
+      epicsThreadSleep(0.01);
+      idle = (sample() == 0) ? idle+1 : 0;
+    }
+    epicsTimeGetCurrent(&now);
+    totalSeconds = epicsTimeDiffInSeconds(&now, &start);
+  }
+
+  void report(const char *csvFileName)
+  {
+    FILE *csv = NULL;
+
+    printf("%s: %d frames generated in %.3f s (%.1f frames/s), %d dropped because the detector pool was full\n",
+           configName.c_str(), pDetector->numGenerated, pDetector->seconds,
+           pDetector->numGenerated/pDetector->seconds, pDetector->numDropped);
+    printf("All plugins idle after %.3f s (%.1f frames/s)\n", totalSeconds, pDetector->numGenerated/totalSeconds);
+    printf("Latency is from the time the detector sent the frame to the plugin's output callback;\n"
+           "it is not measured for Scatter plugins, whose output arrays go to only one client.\n"
+           "Execution times are the last one, and the bins of the execution time histogram that hold\n"
+           "the 50th and 90th percentiles.\n");
+    printf("%-16s %-14s %8s %8s %8s %8s %9s %9s %9s %9s %9s %8s %8s %6s\n",
+           "Port", "Type", "In", "Out", "Dropped", "DropOut",
+           "p50 ms", "p90 ms", "p99 ms", "max ms", "exec ms", "exec p50", "exec p90", "maxQ");
+
+    if (csvFileName) {
+      csv = fopen(csvFileName, "a");
+      if (!csv) throw std::runtime_error(std::string("cannot open ") + csvFileName);
+      if (ftell(csv) == 0) {
+        fprintf(csv, "config,port,type,frames,framesPerSec,arraysIn,arraysOut,dropped,droppedOutput,"
+                     "latencyP50ms,latencyP90ms,latencyP99ms,latencyMaxms,executionLastms,executionP50,executionP90,"
+                     "queueHighWater,poolPeakMB,poolHits,poolMisses,poolBlocked\n");
+      }
+      fprintf(csv, "%s,%s,detector,%d,%.3f,%d,%d,%d,0,,,,,,,,,%s\n",
+              configName.c_str(), pDetector->port.c_str(), pDetector->numGenerated,
+              pDetector->numGenerated/totalSeconds, pDetector->numGenerated, pDetector->numGenerated,
+              pDetector->numDropped, poolCsv(pDetector->pNDArrayPool).c_str());
+    }
+
+    for (size_t i=0; i<plugins.size(); i++) {
+      BenchPlugin& p = plugins[i];
+      std::vector<double> latencies;
+      char text[4][20], csvText[4][20];
+      double fractions[4] = {0.5, 0.9, 0.99, 1.0};
+      epicsInt32 hist[ND_PLUGIN_HIST_BINS];
+      int arraysOut;
+      int arraysIn = readInt(p.pPlugin, NDArrayCounterString);
+      int dropped = readInt(p.pPlugin, NDPluginDriverDroppedArraysString);
+      int droppedOutput = readInt(p.pPlugin, NDPluginDriverDroppedOutputArraysString);
+      double execution = readDouble(p.pPlugin, NDPluginDriverExecutionTimeString);
+      readHistogram(p.port, NDPluginDriverExecutionTimeHistString, hist);
+      const char *execP50 = histogramBin(hist, 0.5);
+      const char *execP90 = histogramBin(hist, 0.9);
+      if (p.pOutput) {
+        latencies = p.pOutput->sortedLatencies();
+        arraysOut = (int)latencies.size();
+      } else {
+        arraysOut = arraysIn - droppedOutput;
+      }
+      for (int j=0; j<4; j++) {
+        if (p.pOutput) {
+          epicsSnprintf(text[j], sizeof(text[j]), "%9.3f", percentile(latencies, fractions[j])*1e3);
+          epicsSnprintf(csvText[j], sizeof(csvText[j]), "%.4f", percentile(latencies, fractions[j])*1e3);
+        } else {
+          epicsSnprintf(text[j], sizeof(text[j]), "%9s", "-");
+          csvText[j][0] = 0;
+        }
+      }
+      printf("%-16s %-14s %8d %8d %8d %8d %s %s %s %s %9.3f %8s %8s %6d\n",
+             p.port.c_str(), p.type.c_str(), arraysIn, arraysOut, dropped, droppedOutput,
+             text[0], text[1], text[2], text[3], execution, execP50, execP90, p.maxQueued);
+      if (csv) {
+        fprintf(csv, "%s,%s,%s,%d,%.3f,%d,%d,%d,%d,%s,%s,%s,%s,%.4f,%s,%s,%d,%s\n",
+                configName.c_str(), p.port.c_str(), p.type.c_str(), pDetector->numGenerated,
+                arraysOut/totalSeconds, arraysIn, arraysOut, dropped, droppedOutput,
+                csvText[0], csvText[1], csvText[2], csvText[3], execution, execP50, execP90, p.maxQueued,
+                poolCsv(p.pOwnPool).c_str());
+      }
+    }
+    if (csv) fclose(csv);
+    reportPools();
+  }
+
+  void setFrames(int numFrames) { pDetector->numFrames = numFrames; }
+
+private:
+  void createPlugin(BenchCommand& cmd)
+  {
+    BenchPlugin p;
+    std::string type = cmd.getString("type");
+    std::string port = cmd.getString("port");
+    std::string inputString = cmd.getString("input", "");
+    const char *input = inputString.c_str();
+    int addr = cmd.getInt("addr", 0);
+    int queue = cmd.getInt("queue", 20);
+    int blocking = cmd.getInt("blocking", 0);
+    int threads = cmd.getInt("threads", 1);
+    int maxBuffers = cmd.getInt("maxBuffers", 0);
+    size_t maxMemory = (size_t)(cmd.getDouble("maxMemory", 0) * 1024 * 1024);
+    int n = cmd.getInt("n", 8);
+    const char *name = port.c_str();
+
+    if (findAsynPortDriver(name)) cmd.error("port " + port + " already exists");
+    if ((type != "Gather") && !findAsynPortDriver(input)) cmd.error("input port " + inputString + " does not exist");
+    if (type == "Stats") {
+      NDStatsConfigure(name, queue, blocking, input, addr, maxBuffers, maxMemory, 0, 0, threads);
+    } else if (type == "ROI") {
+      NDROIConfigure(name, queue, blocking, input, addr, maxBuffers, maxMemory, 0, 0, threads);
+    } else if (type == "Process") {
+      NDProcessConfigure(name, queue, blocking, input, addr, maxBuffers, maxMemory, 0, 0);
+    } else if (type == "Transform") {
+      NDTransformConfigure(name, queue, blocking, input, addr, maxBuffers, maxMemory, 0, 0, threads);
+    } else if (type == "ColorConvert") {
+      NDColorConvertConfigure(name, queue, blocking, input, addr, maxBuffers, maxMemory, 0, 0, threads);
+    } else if (type == "Codec") {
+      NDCodecConfigure(name, queue, blocking, input, addr, maxBuffers, maxMemory, 0, 0, threads);
+    } else if (type == "ROIStat") {
+      NDROIStatConfigure(name, queue, blocking, input, addr, n, maxBuffers, maxMemory, 0, 0, threads);
+    } else if (type == "Overlay") {
+      NDOverlayConfigure(name, queue, blocking, input, addr, n, maxBuffers, maxMemory, 0, 0, threads);
+    } else if (type == "StdArrays") {
+      NDStdArraysConfigure(name, queue, blocking, input, addr, maxBuffers, maxMemory, 0, 0, threads);
+    } else if (type == "FFT") {
+      NDFFTConfigure(name, queue, blocking, input, addr, maxBuffers, maxMemory, 0, 0, threads);
+    } else if (type == "TimeSeries") {
+      NDTimeSeriesConfigure(name, queue, blocking, input, addr, n, maxBuffers, maxMemory, 0, 0);
+    } else if (type == "CircularBuff") {
+      NDCircularBuffConfigure(name, queue, blocking, input, addr, maxBuffers, maxMemory);
+    } else if (type == "Attribute") {
+      NDAttrConfigure(name, queue, blocking, input, addr, n, maxBuffers, maxMemory, 0, 0);
+    } else if (type == "Scatter") {
+      NDScatterConfigure(name, queue, blocking, input, addr, maxBuffers, maxMemory, 0, 0);
+    } else if (type == "Gather") {
+      /* The inputs are set with "set port=... param=NDARRAY_PORT addr=N value=..." */
+      NDGatherConfigure(name, queue, blocking, n, maxBuffers, maxMemory, 0, 0);
+    } else if (type == "FileNull") {
+      NDFileNullConfigure(name, queue, blocking, input, addr, 0, 0);
+#ifdef HAVE_TIFF
+    } else if (type == "FileTIFF") {
+      NDFileTIFFConfigure(name, queue, blocking, input, addr, 0, 0);
+#endif
+    } else {
+      cmd.error("unknown plugin type " + type);
+    }
+    p.pPlugin = dynamic_cast<NDPluginDriver *>((asynPortDriver *)findAsynPortDriver(name));
+    if (!p.pPlugin) cmd.error("error creating " + type + " plugin");
+    p.port = port;
+    p.type = type;
+    /* The plugin's own pool; pNDArrayPool changes to the pool of its input arrays in the callbacks */
+    p.pOwnPool = p.pPlugin->pNDArrayPool;
+    p.maxQueued = 0;
+    /* Messages for dropped arrays would slow the plugins down */
+    disableTrace(name);
+    /* A client of NDPluginScatter would take a share of the arrays from the other plugins */
+    p.pOutput = (type == "Scatter") ? NULL : new BenchOutput(name);
+    writeParam(cmd, port, NDArrayCallbacksString, "1", 0);
+    writeParam(cmd, port, NDPluginDriverEnableCallbacksString, "1", 0);
+    plugins.push_back(p);
+  }
+
+  /** Registers a client for an array parameter, like a waveform record with SCAN=I/O Intr */
+  void createClient(BenchCommand& cmd)
+  {
+    std::string port = cmd.getString("port");
+    std::string param = cmd.getString("param");
+    std::string type = cmd.getString("type");
+    int addr = cmd.getInt("addr", 0);
+    const char *name = port.c_str();
+    asynPortClient *pClient = NULL;
+
+    if (!findAsynPortDriver(name)) cmd.error("port " + port + " does not exist");
+    try {
+      if (type == "Int8") {
+        pClient = createArrayClient<asynInt8ArrayClient, epicsInt8>(name, addr, param.c_str());
+      } else if (type == "Int16") {
+        pClient = createArrayClient<asynInt16ArrayClient, epicsInt16>(name, addr, param.c_str());
+      } else if (type == "Int32") {
+        pClient = createArrayClient<asynInt32ArrayClient, epicsInt32>(name, addr, param.c_str());
+      } else if (type == "Float32") {
+        pClient = createArrayClient<asynFloat32ArrayClient, epicsFloat32>(name, addr, param.c_str());
+      } else if (type == "Float64") {
+        pClient = createArrayClient<asynFloat64ArrayClient, epicsFloat64>(name, addr, param.c_str());
+      } else {
+        cmd.error("unknown client type " + type);
+      }
+    }
+    catch (std::runtime_error& e) {
+      cmd.error(std::string("error connecting to ") + param + ": " + e.what());
+    }
+    clients.push_back(pClient);
+  }
+
+  void setParam(BenchCommand& cmd)
+  {
+    std::string port = cmd.getString("port");
+    std::string param = cmd.getString("param");
+    writeParam(cmd, port, param.c_str(), cmd.getString("value").c_str(), cmd.getInt("addr", 0));
+  }
+
+  /** Writes a parameter through the asyn interface for its type, so the driver handles it as
+    * it would a write from a record */
+  void writeParam(BenchCommand& cmd, const std::string& port, const char *param, const char *value, int addr)
+  {
+    asynPortDriver *pDriver = (asynPortDriver *)findAsynPortDriver(port.c_str());
+    asynParamType type;
+    int index;
+    long intValue = 0;
+    double doubleValue = 0;
+    asynStatus status = asynError;
+    size_t nActual;
+    char *end = NULL;
+
+    if (!pDriver) cmd.error("port " + port + " does not exist");
+    if ((pDriver->findParam(param, &index) != asynSuccess) ||
+        (pDriver->getParamType(index, &type) != asynSuccess)) {
+      cmd.error("port " + port + " has no parameter " + param);
+    }
+    if (type == asynParamInt32) {
+      intValue = strtol(value, &end, 0);
+    } else if (type == asynParamFloat64) {
+      doubleValue = strtod(value, &end);
+    } else if (type != asynParamOctet) {
+      cmd.error(std::string("cannot set parameter ") + param + " of this type");
+    }
+    if (end && (*end || (end == value))) cmd.error(std::string("invalid number for ") + param);
+    try {
+      if (type == asynParamInt32) {
+        status = asynInt32Client(port.c_str(), addr, param).write((epicsInt32)intValue);
+      } else if (type == asynParamFloat64) {
+        status = asynFloat64Client(port.c_str(), addr, param).write(doubleValue);
+      } else {
+        status = asynOctetClient(port.c_str(), addr, param).write(value, strlen(value), &nActual);
+      }
+    }
+    catch (std::runtime_error& e) {
+      cmd.error(std::string("error writing ") + param + ": " + e.what());
+    }
+    if (status != asynSuccess) cmd.error(std::string("error writing ") + param);
+  }
+
+  static void disableTrace(const char *port)
+  {
+    asynUser *pasynUser = pasynManager->createAsynUser(0, 0);
+    for (int addr=-1; addr<=0; addr++) {
+      if (pasynManager->connectDevice(pasynUser, port, addr) == asynSuccess) {
+        pasynTrace->setTraceMask(pasynUser, 0);
+        pasynManager->disconnect(pasynUser);
+      }
+    }
+    pasynManager->freeAsynUser(pasynUser);
+  }
+
+  /** Prints the memory of each NDArrayPool that was used, with the plugins whose output arrays
+    * came from it.  Most plugins allocate their output arrays from the pool of their input
+    * arrays, so the memory is not that of a single plugin. */
+  void reportPools()
+  {
+    printf("\n%-16s %9s %10s %10s %10s  %s\n", "Pool of", "peak MB", "Hits", "Misses", "Blocked",
+           "Output arrays of");
+    reportPool(pDetector->port, pDetector->pNDArrayPool);
+    for (size_t i=0; i<plugins.size(); i++) {
+      reportPool(plugins[i].port, plugins[i].pOwnPool);
+    }
+  }
+
+  void reportPool(const std::string& owner, NDArrayPool *pPool)
+  {
+    std::string users;
+    for (size_t i=0; i<plugins.size(); i++) {
+      if (plugins[i].pOutput && plugins[i].pOutput->usedPool(pPool)) users += " " + plugins[i].port;
+    }
+    if ((pPool->getPeakMemorySize() == 0) && users.empty()) return;
+    printf("%-16s %9.1f %10lu %10lu %10lu %s\n", owner.c_str(), pPool->getPeakMemorySize()/MEGABYTE_DBL,
+           (unsigned long)pPool->getNumHits(), (unsigned long)pPool->getNumMisses(),
+           (unsigned long)pPool->getNumBlocked(), users.empty() ? " -" : users.c_str());
+  }
+
+  static std::string poolCsv(NDArrayPool *pPool)
+  {
+    char text[80];
+    epicsSnprintf(text, sizeof(text), "%.3f,%lu,%lu,%lu", pPool->getPeakMemorySize()/MEGABYTE_DBL,
+                  (unsigned long)pPool->getNumHits(), (unsigned long)pPool->getNumMisses(),
+                  (unsigned long)pPool->getNumBlocked());
+    return text;
+  }
+
+  static void sampleC(void *pvt) { ((PluginBench *)pvt)->sample(); }
+
+  /** Records the highest number of arrays queued for each plugin; returns the number queued for all of them */
+  int sample()
+  {
+    int total = 0;
+    for (size_t i=0; i<plugins.size(); i++) {
+      int numQueued;
+      double execution;
+      plugins[i].pPlugin->getLoad(&numQueued, &execution);
+      if (numQueued > plugins[i].maxQueued) plugins[i].maxQueued = numQueued;
+      total += numQueued;
+    }
+    return total;
+  }
+
+  static int readInt(NDPluginDriver *pPlugin, const char *param)
+  {
+    int index, value = 0;
+    pPlugin->findParam(param, &index);
+    pPlugin->lock();
+    pPlugin->getIntegerParam(index, &value);
+    pPlugin->unlock();
+    return value;
+  }
+
+  static double readDouble(NDPluginDriver *pPlugin, const char *param)
+  {
+    int index;
+    double value = 0;
+    pPlugin->findParam(param, &index);
+    pPlugin->lock();
+    pPlugin->getDoubleParam(index, &value);
+    pPlugin->unlock();
+    return value;
+  }
+
+  /** Reads a histogram through the asynInt32Array interface, as a waveform record would */
+  static void readHistogram(const std::string& port, const char *param, epicsInt32 *pHist)
+  {
+    size_t nIn = 0;
+    memset(pHist, 0, ND_PLUGIN_HIST_BINS*sizeof(*pHist));
+    asynInt32ArrayClient(port.c_str(), 0, param).read(pHist, ND_PLUGIN_HIST_BINS, &nIn);
+  }
+
+  /** Returns the label of the histogram bin that holds the given fraction of the counts */
+  static const char *histogramBin(const epicsInt32 *pHist, double fraction)
+  {
+    static const char *labels[ND_PLUGIN_HIST_BINS] = {"<10us", "<100us", "<1ms", "<10ms", "<100ms", "<1s", ">=1s"};
+    double total = 0, sum = 0;
+    for (int i=0; i<ND_PLUGIN_HIST_BINS; i++) total += pHist[i];
+    if (total == 0) return "-";
+    for (int i=0; i<ND_PLUGIN_HIST_BINS; i++) {
+      sum += pHist[i];
+      if (sum >= fraction*total) return labels[i];
+    }
+    return labels[ND_PLUGIN_HIST_BINS-1];
+  }
+
+  static double percentile(const std::vector<double>& sorted, double fraction)
+  {
+    if (sorted.empty()) return 0;
+    return sorted[(size_t)floor(fraction*(sorted.size()-1) + 0.5)];
+  }
+
+  std::string configName;
+  BenchDetector *pDetector;
+  std::vector<BenchPlugin> plugins;
+  std::vector<asynPortClient *> clients;
+  double totalSeconds;
+};
+
+static void usage()
+{
+  printf("Usage: plugin-bench [-frames N] [-csv file] configFile\n"
+         "  -frames N  Overrides the number of frames in the configuration file\n"
+         "  -csv file  Appends the results to a CSV file, one row for the detector and one for each plugin\n");
+}
+
+int main(int argc, char **argv)
+{
+  const char *configFile = NULL;
+  const char *csvFile = NULL;
+  int numFrames = 0;
+  PluginBench bench;
+
+  for (int i=1; i<argc; i++) {
+    if ((strcmp(argv[i], "-frames") == 0) && (i+1 < argc)) {
+      numFrames = atoi(argv[++i]);
+    } else if ((strcmp(argv[i], "-csv") == 0) && (i+1 < argc)) {
+      csvFile = argv[++i];
+    } else if ((argv[i][0] != '-') && !configFile) {
+      configFile = argv[i];
+    } else {
+      usage();
+      return 1;
+    }
+  }
+  if (!configFile) {
+    usage();
+    return 1;
+  }
+
+  try {
+    bench.readConfig(configFile);
+    if (numFrames > 0) bench.setFrames(numFrames);
+    bench.run();
+    bench.report(csvFile);
+  }
+  catch (std::exception& e) {
+    fprintf(stderr, "plugin-bench: %s\n", e.what());
+    epicsExit(1);
+  }
+  epicsExit(0);
+  return 0;
+}
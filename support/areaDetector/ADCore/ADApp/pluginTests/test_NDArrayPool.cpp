@@ -10,11 +10,17 @@
 
 #include <string.h>
 #include <stdint.h>
+#include <epicsThread.h>
+#include <epicsEvent.h>
+#include <epicsTime.h>
+#include <epicsMath.h>
 
 #include "testingutilities.h"
 
 using namespace std;
 
+extern volatile int NDArrayPoolConvertThreads;
+
 
 struct NDArrayPoolFixture
 {
@@ -129,4 +135,384 @@ BOOST_AUTO_TEST_CASE(test_Pool)
     
 }
 
+BOOST_AUTO_TEST_CASE(test_PoolStatistics)
+{
+  NDArray *pArray;
+  size_t dims = 1000;
+
+  // The first allocation needs memory, the second reuses it
+  pArray = pPool->alloc(1, &dims, NDUInt8, 0, NULL);
+  pArray->release();
+  BOOST_CHECK_EQUAL(pPool->getNumMisses(), 1);
+  BOOST_CHECK_EQUAL(pPool->getNumHits(), 0);
+  pArray = pPool->alloc(1, &dims, NDUInt8, 0, NULL);
+  pArray->release();
+  BOOST_CHECK_EQUAL(pPool->getNumMisses(), 1);
+  BOOST_CHECK_EQUAL(pPool->getNumHits(), 1);
+  BOOST_CHECK_EQUAL(pPool->getNumBlocked(), 0);
+  BOOST_CHECK_EQUAL(pPool->getPeakMemorySize(), 1000);
+
+  // Pre-allocate 4 more arrays; 5 in total fit in MAX_MEMORY
+  BOOST_CHECK_EQUAL(pPool->preAllocBuffers(4, 10000), 4);
+  BOOST_CHECK_EQUAL(pPool->getNumBuffers(), 5);
+  BOOST_CHECK_EQUAL(pPool->getNumFree(), 5);
+  BOOST_CHECK_EQUAL(pPool->getPeakMemorySize(), 41000);
+
+  // Allocating the pre-allocated size does not need new memory
+  dims = 10000;
+  pArray = pPool->alloc(1, &dims, NDUInt8, 0, NULL);
+  BOOST_CHECK_EQUAL(pPool->getNumMisses(), 5);
+  BOOST_CHECK_EQUAL(pArray->dataSize, 10000);
+  pArray->release();
+
+  // Only 2 of these fit, the rest are blocked by MAX_MEMORY.
+  // The first deletes one free 10000 byte array, reaching 56000 bytes.
+  BOOST_CHECK_EQUAL(pPool->preAllocBuffers(4, 25000), 2);
+  BOOST_CHECK_EQUAL(pPool->getNumBlocked(), 3);
+  BOOST_CHECK(pPool->getMemorySize() <= MAX_MEMORY);
+  BOOST_CHECK_EQUAL(pPool->getPeakMemorySize(), 56000);
+  pPool->report(stdout, 6);
+
+  pPool->emptyFreeList();
+  BOOST_CHECK_EQUAL(pPool->getNumBuffers(), 0);
+  BOOST_CHECK_EQUAL(pPool->getNumFree(), 0);
+  BOOST_CHECK_EQUAL(pPool->getMemorySize(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_PoolView)
+{
+  size_t dims[2] = {10, 20};
+  NDDimension_t viewDims[2];
+  NDArray *pArray, *pView, *pView2;
+  epicsUInt16 *pData;
+  size_t memorySize;
+  int i;
+
+  pArray = pPool->alloc(2, dims, NDUInt16, 0, NULL);
+  pData = (epicsUInt16 *)pArray->pData;
+  for (i=0; i<200; i++) pData[i] = (epicsUInt16)i;
+  memorySize = pPool->getMemorySize();
+
+  // Rows 5 to 9 are contiguous and share the buffer of the array
+  pArray->initDimension(&viewDims[0], 10);
+  pArray->initDimension(&viewDims[1], 5);
+  viewDims[1].offset = 5;
+  pView = pPool->view(pArray, viewDims);
+  BOOST_REQUIRE(pView);
+  BOOST_CHECK_EQUAL(pView->pData, (void *)(pData + 50));
+  BOOST_CHECK_EQUAL(pView->dataSize, 100);
+  BOOST_CHECK_EQUAL(pView->dims[1].size, 5);
+  BOOST_CHECK_EQUAL(pView->dims[1].offset, 5);
+  BOOST_CHECK_EQUAL(((epicsUInt16 *)pView->pData)[0], 50);
+  BOOST_CHECK_EQUAL(pView->pViewParent, pArray);
+  BOOST_CHECK_EQUAL(pArray->getReferenceCount(), 2);
+  BOOST_CHECK_EQUAL(pPool->getMemorySize(), memorySize);
+
+  // A view of a view refers to the array that owns the buffer
+  pView2 = pPool->view(pView);
+  BOOST_REQUIRE(pView2);
+  BOOST_CHECK_EQUAL(pView2->pData, pView->pData);
+  BOOST_CHECK_EQUAL(pView2->pViewParent, pArray);
+  BOOST_CHECK_EQUAL(pArray->getReferenceCount(), 3);
+
+  // Part of each row, binning and reversal must be copied
+  viewDims[0].size = 5;
+  BOOST_CHECK(pPool->view(pArray, viewDims) == NULL);
+  viewDims[0].size = 10;
+  viewDims[1].binning = 5;
+  BOOST_CHECK(pPool->view(pArray, viewDims) == NULL);
+  viewDims[1].binning = 1;
+  viewDims[0].reverse = 1;
+  BOOST_CHECK(pPool->view(pArray, viewDims) == NULL);
+  // Part of one row is contiguous
+  viewDims[0].reverse = 0;
+  viewDims[0].offset = 2;
+  viewDims[0].size = 5;
+  viewDims[1].size = 1;
+  pView->release();
+  pView = pPool->view(pArray, viewDims);
+  BOOST_REQUIRE(pView);
+  BOOST_CHECK_EQUAL(((epicsUInt16 *)pView->pData)[0], 52);
+
+  // Released views go back on the free list without the buffer, and are reused for views
+  pView->release();
+  pView2->release();
+  BOOST_CHECK_EQUAL(pArray->getReferenceCount(), 1);
+  BOOST_CHECK_EQUAL(pPool->getNumBuffers(), 3);
+  pView = pPool->view(pArray);
+  BOOST_REQUIRE(pView);
+  BOOST_CHECK_EQUAL(pPool->getNumBuffers(), 3);
+  pView->release();
+  pArray->release();
+  BOOST_CHECK_EQUAL(pPool->getNumFree(), 3);
+  BOOST_CHECK_EQUAL(pPool->getMemorySize(), memorySize);
+
+  // Arrays for data are not taken from the views on the free list
+  pArray = pPool->alloc(2, dims, NDUInt16, 0, NULL);
+  BOOST_REQUIRE(pArray);
+  BOOST_CHECK_EQUAL(pArray->dataSize, 400);
+  BOOST_CHECK(pArray->pViewParent == NULL);
+  pArray->release();
+}
+
+#define NUM_THREADS 4
+#define NUM_LOOPS 10000
+
+struct poolThreadData {
+  NDArrayPool *pPool;
+  NDArray *pShared;
+  epicsEventId done;
+};
+
+static void poolThread(void *arg)
+{
+  poolThreadData *pData = (poolThreadData *)arg;
+  size_t dims = 100;
+
+  for (int i=0; i<NUM_LOOPS; i++) {
+    NDArray *pArray = pData->pPool->alloc(1, &dims, NDUInt8, 0, NULL);
+    pData->pPool->reserve(pData->pShared);
+    pArray->release();
+    pData->pPool->release(pData->pShared);
+  }
+  epicsEventSignal(pData->done);
+}
+
+BOOST_AUTO_TEST_CASE(test_PoolThreads)
+{
+  poolThreadData data[NUM_THREADS];
+  size_t dims = 100;
+  NDArray *pShared = pPool->alloc(1, &dims, NDUInt8, 0, NULL);
+  int i;
+
+  // Several threads allocate and release arrays while changing the reference count of a shared array
+  for (i=0; i<NUM_THREADS; i++) {
+    data[i].pPool = pPool;
+    data[i].pShared = pShared;
+    data[i].done = epicsEventMustCreate(epicsEventEmpty);
+    epicsThreadMustCreate("poolThread", epicsThreadPriorityMedium,
+                          epicsThreadGetStackSize(epicsThreadStackMedium),
+                          poolThread, &data[i]);
+  }
+  for (i=0; i<NUM_THREADS; i++) {
+    epicsEventMustWait(data[i].done);
+    epicsEventDestroy(data[i].done);
+  }
+  BOOST_CHECK_EQUAL(pShared->getReferenceCount(), 1);
+  BOOST_CHECK_EQUAL(pPool->getNumFree(), pPool->getNumBuffers() - 1);
+  BOOST_CHECK(pPool->getNumBuffers() <= NUM_THREADS + 1);
+  BOOST_CHECK_EQUAL(pPool->getNumHits() + pPool->getNumMisses(), NUM_THREADS*NUM_LOOPS + 1);
+  pShared->release();
+  BOOST_CHECK_EQUAL(pPool->getNumFree(), pPool->getNumBuffers());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+static const NDDataType_t convertTypes[] = {NDInt8, NDUInt8, NDInt16, NDUInt16,
+                                            NDInt32, NDUInt32, NDFloat32, NDFloat64};
+#define NUM_CONVERT_TYPES 8
+
+static double getElement(NDArray *pArray, size_t i)
+{
+  switch (pArray->dataType) {
+    case NDInt8:    return ((epicsInt8 *)   pArray->pData)[i];
+    case NDUInt8:   return ((epicsUInt8 *)  pArray->pData)[i];
+    case NDInt16:   return ((epicsInt16 *)  pArray->pData)[i];
+    case NDUInt16:  return ((epicsUInt16 *) pArray->pData)[i];
+    case NDInt32:   return ((epicsInt32 *)  pArray->pData)[i];
+    case NDUInt32:  return ((epicsUInt32 *) pArray->pData)[i];
+    case NDFloat32: return ((epicsFloat32 *)pArray->pData)[i];
+    case NDFloat64: return ((epicsFloat64 *)pArray->pData)[i];
+    default:        return 0;
+  }
+}
+
+static void setElement(NDArray *pArray, size_t i, double value)
+{
+  switch (pArray->dataType) {
+    case NDInt8:    ((epicsInt8 *)   pArray->pData)[i] = (epicsInt8)value;    break;
+    case NDUInt8:   ((epicsUInt8 *)  pArray->pData)[i] = (epicsUInt8)value;   break;
+    case NDInt16:   ((epicsInt16 *)  pArray->pData)[i] = (epicsInt16)value;   break;
+    case NDUInt16:  ((epicsUInt16 *) pArray->pData)[i] = (epicsUInt16)value;  break;
+    case NDInt32:   ((epicsInt32 *)  pArray->pData)[i] = (epicsInt32)value;   break;
+    case NDUInt32:  ((epicsUInt32 *) pArray->pData)[i] = (epicsUInt32)value;  break;
+    case NDFloat32: ((epicsFloat32 *)pArray->pData)[i] = (epicsFloat32)value; break;
+    case NDFloat64: ((epicsFloat64 *)pArray->pData)[i] = (epicsFloat64)value; break;
+    default: break;
+  }
+}
+
+/* Input index of bin j of output element k of a dimension */
+static size_t binIndex(NDDimension_t *pDim, size_t k, int j)
+{
+  if (pDim->reverse) return pDim->offset + pDim->size*pDim->binning - 1 - (k*pDim->binning + j);
+  return pDim->offset + k*pDim->binning + j;
+}
+
+/* Converts pIn with dimsOut (sizes after binning) element by element and counts the output
+ * elements of pOut that differ */
+static size_t checkConvert(NDArray *pIn, NDArray *pOut, NDDimension_t *dimsOut)
+{
+  size_t errors = 0, i0, i1, i2, n = 0;
+  int j0, j1, j2;
+  size_t *inDims = new size_t[3];
+
+  for (int i=0; i<3; i++) inDims[i] = (i < pIn->ndims) ? pIn->dims[i].size : 1;
+  for (i2=0; i2<dimsOut[2].size; i2++) {
+    for (i1=0; i1<dimsOut[1].size; i1++) {
+      for (i0=0; i0<dimsOut[0].size; i0++, n++) {
+        double sum = 0;
+        for (j2=0; j2<dimsOut[2].binning; j2++) {
+          for (j1=0; j1<dimsOut[1].binning; j1++) {
+            for (j0=0; j0<dimsOut[0].binning; j0++) {
+              sum += getElement(pIn, binIndex(&dimsOut[0], i0, j0) +
+                                     inDims[0]*(binIndex(&dimsOut[1], i1, j1) +
+                                                inDims[1]*binIndex(&dimsOut[2], i2, j2)));
+            }
+          }
+        }
+        if (getElement(pOut, n) != sum) errors++;
+      }
+    }
+  }
+  delete[] inDims;
+  return errors;
+}
+
+struct NDArrayConvertFixture
+{
+  asynNDArrayDriver *driver;
+  NDArrayPool *pPool;
+
+  NDArrayConvertFixture()
+  {
+    std::string port("convertPort");
+    uniqueAsynPortName(port);
+    driver = new asynNDArrayDriver(port.c_str(), 1, 0, 0, asynGenericPointerMask, asynGenericPointerMask, 0, 0, 0, 0);
+    pPool = driver->pNDArrayPool;
+  }
+  ~NDArrayConvertFixture()
+  {
+    NDArrayPoolConvertThreads = 4;
+    delete driver;
+  }
+
+  NDArray *createArray(int ndims, size_t *dims, NDDataType_t dataType)
+  {
+    NDArray *pArray = pPool->alloc(ndims, dims, dataType, 0, NULL);
+    NDArrayInfo_t info;
+    pArray->getInfo(&info);
+    // Small values so that the sums of 2x2x2 bins fit in every type
+    for (size_t i=0; i<info.nElements; i++) setElement(pArray, i, (double)((i*7 + i/13) % 16));
+    return pArray;
+  }
+};
+
+BOOST_FIXTURE_TEST_SUITE(NDArrayConvertTests, NDArrayConvertFixture)
+
+BOOST_AUTO_TEST_CASE(test_ConvertRegions)
+{
+  size_t dims[3] = {37, 23, 6};
+  // {size, offset, binning, reverse} for each dimension; sizes are before binning as for convert()
+  NDDimension_t regions[4][3] = {
+    {{37, 0, 1, 0}, {23, 0, 1, 0}, {6, 0, 1, 0}},   // type conversion only
+    {{30, 3, 1, 1}, {20, 2, 1, 0}, {4, 1, 1, 1}},   // region with reversal, no binning
+    {{30, 3, 2, 0}, {20, 1, 1, 1}, {4, 1, 2, 0}},   // binning and reversal
+    {{36, 0, 3, 1}, {22, 1, 2, 1}, {6, 0, 2, 1}},   // binning and reversal in every dimension
+  };
+
+  for (int threads=1; threads<=4; threads+=3) {
+    NDArrayPoolConvertThreads = threads;
+    for (int r=0; r<4; r++) {
+      for (int in=0; in<NUM_CONVERT_TYPES; in++) {
+        NDArray *pIn = createArray(3, dims, convertTypes[in]);
+        for (int out=0; out<NUM_CONVERT_TYPES; out++) {
+          NDArray *pOut;
+          NDDimension_t dimsOut[3];
+          BOOST_REQUIRE_EQUAL(pPool->convert(pIn, &pOut, convertTypes[out], regions[r]), ND_SUCCESS);
+          memcpy(dimsOut, regions[r], sizeof(dimsOut));
+          for (int i=0; i<3; i++) dimsOut[i].size /= dimsOut[i].binning;
+          BOOST_CHECK_EQUAL(checkConvert(pIn, pOut, dimsOut), 0);
+          pOut->release();
+        }
+        pIn->release();
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_ConvertThreads)
+{
+  // Large enough to be divided between threads
+  size_t dims[2] = {1000, 700};
+  NDDimension_t region[2] = {{998, 1, 2, 0}, {697, 2, 1, 1}};
+  NDArray *pIn = createArray(2, dims, NDUInt16);
+  NDArray *pOut1, *pOut4;
+
+  NDArrayPoolConvertThreads = 1;
+  BOOST_REQUIRE_EQUAL(pPool->convert(pIn, &pOut1, NDFloat64, region), ND_SUCCESS);
+  NDArrayPoolConvertThreads = 4;
+  BOOST_REQUIRE_EQUAL(pPool->convert(pIn, &pOut4, NDFloat64, region), ND_SUCCESS);
+  BOOST_CHECK_EQUAL(memcmp(pOut1->pData, pOut4->pData, 499*697*sizeof(epicsFloat64)), 0);
+  pOut1->release();
+  pOut4->release();
+
+  NDArrayPoolConvertThreads = 1;
+  BOOST_REQUIRE_EQUAL(pPool->convert(pIn, &pOut1, NDFloat32), ND_SUCCESS);
+  NDArrayPoolConvertThreads = 4;
+  BOOST_REQUIRE_EQUAL(pPool->convert(pIn, &pOut4, NDFloat32), ND_SUCCESS);
+  BOOST_CHECK_EQUAL(memcmp(pOut1->pData, pOut4->pData, 1000*700*sizeof(epicsFloat32)), 0);
+  pOut1->release();
+  pOut4->release();
+  pIn->release();
+}
+
+BOOST_AUTO_TEST_CASE(test_ConvertScale)
+{
+  // Binned sums are divided without integer truncation, as with a Float64 region divided afterwards
+  size_t dims[2] = {40, 30};
+  NDDimension_t region[2] = {{36, 2, 3, 0}, {30, 0, 2, 1}};
+  NDArray *pIn = createArray(2, dims, NDInt16);
+  NDArray *pOut, *pFloat;
+  NDArrayInfo_t info;
+  size_t i, errors = 0;
+
+  BOOST_REQUIRE_EQUAL(pPool->convert(pIn, &pOut, NDInt16, region, 6., false), ND_SUCCESS);
+  BOOST_REQUIRE_EQUAL(pPool->convert(pIn, &pFloat, NDFloat64, region), ND_SUCCESS);
+  pOut->getInfo(&info);
+  BOOST_CHECK_EQUAL(info.nElements, 12*15);
+  BOOST_CHECK_EQUAL(pOut->dims[0].offset, 2);
+  BOOST_CHECK_EQUAL(pOut->dims[1].binning, 2);
+  for (i=0; i<info.nElements; i++) {
+    if (getElement(pOut, i) != (epicsInt16)(getElement(pFloat, i)/6.)) errors++;
+  }
+  BOOST_CHECK_EQUAL(errors, 0);
+  pOut->release();
+  pFloat->release();
+  pIn->release();
+
+  // Clamping limits the results to the range of the output type, and NaN gives 0
+  dims[0] = 1000;
+  dims[1] = 1;
+  NDDimension_t full[2] = {{1000, 0, 1, 0}, {1, 0, 1, 0}};
+  pIn = pPool->alloc(2, dims, NDFloat32, 0, NULL);
+  for (i=0; i<1000; i++) ((epicsFloat32 *)pIn->pData)[i] = (epicsFloat32)i - 200.f;
+  ((epicsFloat32 *)pIn->pData)[7] = epicsNAN;
+  BOOST_REQUIRE_EQUAL(pPool->convert(pIn, &pOut, NDUInt8, full, 0.5, true), ND_SUCCESS);
+  errors = 0;
+  for (i=0; i<1000; i++) {
+    double expected = ((double)i - 200.) / 0.5;
+    if (expected < 0) expected = 0;
+    if (expected > 255) expected = 255;
+    if (i == 7) expected = 0;
+    if (getElement(pOut, i) != (epicsUInt8)expected) errors++;
+  }
+  BOOST_CHECK_EQUAL(errors, 0);
+  pOut->release();
+
+  BOOST_CHECK_EQUAL(pPool->convert(pIn, &pOut, NDUInt8, full, 0., true), ND_ERROR);
+  BOOST_CHECK(pOut == NULL);
+  pIn->release();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,116 @@
+/*
+ * test_NDAttributeList.cpp
+ *
+ *  Created on: 19 Oct 2026
+ */
+
+#include <stdio.h>
+
+#include "boost/test/unit_test.hpp"
+
+// AD dependencies
+#include <NDAttribute.h>
+#include <NDAttributeList.h>
+
+#include <string>
+
+using namespace std;
+
+static string attributeName(int i)
+{
+  char name[32];
+  sprintf(name, "Attribute%d", i);
+  return name;
+}
+
+BOOST_AUTO_TEST_SUITE(NDAttributeListTests)
+
+BOOST_AUTO_TEST_CASE(test_FindAndOrder)
+{
+  NDAttributeList list;
+  epicsInt32 value;
+
+  // Enough attributes for the hash table to grow several times
+  for (int i=0; i<100; i++) {
+    value = i;
+    list.add(attributeName(i).c_str(), "", NDAttrInt32, &value);
+  }
+  BOOST_REQUIRE_EQUAL(list.count(), 100);
+  for (int i=0; i<100; i++) {
+    NDAttribute *pAttr = list.find(attributeName(i).c_str());
+    BOOST_REQUIRE(pAttr != NULL);
+    pAttr->getValue(NDAttrInt32, &value);
+    BOOST_CHECK_EQUAL(value, i);
+  }
+  BOOST_CHECK(list.find("Attribute100") == NULL);
+  BOOST_CHECK(list.find("") == NULL);
+
+  // Adding an existing name changes the value of the existing attribute
+  value = -1;
+  NDAttribute *pAttr = list.add("Attribute5", "", NDAttrInt32, &value);
+  BOOST_CHECK(pAttr == list.find("Attribute5"));
+  BOOST_CHECK_EQUAL(list.count(), 100);
+
+  // Removing keeps the order of the others
+  BOOST_CHECK_EQUAL(list.remove("Attribute10"), ND_SUCCESS);
+  BOOST_CHECK_EQUAL(list.remove("Attribute10"), ND_ERROR);
+  BOOST_CHECK(list.find("Attribute10") == NULL);
+  int i = 0;
+  for (pAttr = list.next(NULL); pAttr; pAttr = list.next(pAttr), i++) {
+    if (i == 10) i++;
+    BOOST_CHECK_EQUAL(string(pAttr->getName()), attributeName(i));
+  }
+  BOOST_CHECK_EQUAL(i, 100);
+  BOOST_CHECK(list.find("Attribute99") != NULL);
+
+  // add(NDAttribute*) replaces an attribute of the same name and moves it to the end
+  list.add(new NDAttribute("Attribute0", "", NDAttrSourceDriver, "Driver", NDAttrString, (void *)"zero"));
+  BOOST_CHECK_EQUAL(list.count(), 99);
+  string stringValue;
+  list.find("Attribute0")->getValue(stringValue);
+  BOOST_CHECK_EQUAL(stringValue, "zero");
+  BOOST_CHECK_EQUAL(string(list.next(NULL)->getName()), "Attribute1");
+
+  list.clear();
+  BOOST_CHECK_EQUAL(list.count(), 0);
+  BOOST_CHECK(list.next(NULL) == NULL);
+  BOOST_CHECK(list.find("Attribute1") == NULL);
+}
+
+BOOST_AUTO_TEST_CASE(test_Copy)
+{
+  NDAttributeList in, out;
+  epicsFloat64 value;
+
+  for (int i=0; i<10; i++) {
+    value = i;
+    in.add(attributeName(i).c_str(), "", NDAttrFloat64, &value);
+  }
+  // The output has some of the attributes already, in a different order, and one of its own
+  for (int i=9; i>=5; i--) {
+    value = -1;
+    out.add(attributeName(i).c_str(), "", NDAttrFloat64, &value);
+  }
+  out.add("Extra", "", NDAttrFloat64, &value);
+  NDAttribute *pExisting = out.find("Attribute7");
+
+  in.copy(&out);
+  BOOST_CHECK_EQUAL(out.count(), 11);
+  BOOST_CHECK(out.find("Attribute7") == pExisting);
+  for (int i=0; i<10; i++) {
+    out.find(attributeName(i).c_str())->getValue(NDAttrFloat64, &value);
+    BOOST_CHECK_EQUAL(value, i);
+  }
+
+  // A second copy finds the attributes in place
+  value = 42;
+  in.add("Attribute3", "", NDAttrFloat64, &value);
+  NDAttribute *pAttr3 = out.find("Attribute3");
+  in.copy(&out);
+  BOOST_CHECK_EQUAL(out.count(), 11);
+  BOOST_CHECK(out.find("Attribute3") == pAttr3);
+  pAttr3->getValue(NDAttrFloat64, &value);
+  BOOST_CHECK_EQUAL(value, 42);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
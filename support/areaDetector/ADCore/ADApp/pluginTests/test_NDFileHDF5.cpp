@@ -19,6 +19,8 @@
 #include <stdint.h>
 
 #include <deque>
+#include <vector>
+#include <sstream>
 #include <boost/shared_ptr.hpp>
 using namespace std;
 
@@ -26,8 +28,17 @@ using namespace std;
 #include "asynPortDriver.h"
 #include "HDF5PluginWrapper.h"
 #include "HDF5FileReader.h"
+#include "CodecPluginWrapper.h"
 
 static  NDArrayPool *arrayPool;
+static  std::vector<NDArray*> codecOutput;
+
+static void Codec_callback(void *userPvt, asynUser *pasynUser, void *pointer)
+{
+  NDArray *pArray = (NDArray *)pointer;
+  pArray->reserve();
+  codecOutput.push_back(pArray);
+}
 
 struct NDFileHDF5TestFixture
 {
@@ -297,4 +308,176 @@ BOOST_AUTO_TEST_CASE(test_DatasetLayout1)
 
 }
 
+BOOST_AUTO_TEST_CASE(test_DirectChunkWrite)
+{
+  // Frames encoded by the plugin and written with H5Dwrite_chunk must read back unchanged,
+  // including the partial chunks at the edges, with and without zlib and the writer thread
+  const int sizeX = 100, sizeY = 70, numFrames = 10;
+  int compression[] = {0, 3};  // None, zlib
+  int queueSize[] = {0, 4};
+  size_t dims[2] = {sizeX, sizeY};
+  std::vector<NDArray*>arrays(numFrames);
+  int fileNumber = 0;
+
+  for (int i = 0; i < numFrames; i++)
+  {
+    arrays[i] = arrayPool->alloc(2, dims, NDUInt16, 0, NULL);
+    epicsUInt16 *pData = (epicsUInt16 *)arrays[i]->pData;
+    for (int j = 0; j < sizeX*sizeY; j++) pData[j] = (epicsUInt16)(i*1000 + j);
+    arrays[i]->uniqueId = i;
+  }
+
+  for (size_t c = 0; c < sizeof(compression)/sizeof(compression[0]); c++)
+  {
+    for (size_t q = 0; q < sizeof(queueSize)/sizeof(queueSize[0]); q++)
+    {
+      BOOST_TEST_MESSAGE("compression=" << compression[c] << " queueSize=" << queueSize[q]);
+      hdf5->write(NDFileWriteModeString, NDFileModeStream);
+      hdf5->write(NDFilePathString, "/tmp");
+      hdf5->write(NDFileNameString, "direct");
+      hdf5->write(NDFileTemplateString, "%s%s_%d.h5");
+      hdf5->write(NDFileNumberString, fileNumber);
+      hdf5->write(NDAutoIncrementString, 0);
+      hdf5->write(str_NDFileHDF5_nColChunks, 40);
+      hdf5->write(str_NDFileHDF5_nRowChunks, 30);
+      hdf5->write(str_NDFileHDF5_nFramesChunks, 1);
+      hdf5->write(str_NDFileHDF5_compressionType, compression[c]);
+      hdf5->write(str_NDFileHDF5_directChunkWrite, 1);
+      hdf5->write(str_NDFileHDF5_compressThreads, 3);
+      hdf5->write(str_NDFileHDF5_writeQueueSize, queueSize[q]);
+      hdf5->processCallbacks(arrays[0]);
+
+      hdf5->write(NDFileNumCaptureString, numFrames);
+      hdf5->write(NDFileCaptureString, 1);
+      for (int i = 0; i < numFrames; i++)
+      {
+        hdf5->lock();
+        BOOST_CHECK_NO_THROW(hdf5->processCallbacks(arrays[i]));
+        hdf5->unlock();
+        if (i == 0) BOOST_CHECK_EQUAL(hdf5->readInt(str_NDFileHDF5_directChunkActive), 1);
+      }
+      BOOST_CHECK_EQUAL(hdf5->readInt(NDFileNumCapturedString), numFrames);
+      BOOST_CHECK_EQUAL(hdf5->readInt(str_NDFileHDF5_writeQueueUsed), 0);
+      BOOST_CHECK_GT(hdf5->readDouble(str_NDFileHDF5_writeRate), 0.0);
+      if (compression[c] == 3) BOOST_CHECK_GT(hdf5->readDouble(str_NDFileHDF5_compressRatio), 1.0);
+
+      // Read the whole dataset back with the HDF5 library
+      std::stringstream fileName;
+      fileName << "/tmp/direct_" << fileNumber << ".h5";
+      std::vector<epicsUInt16> data(numFrames*sizeX*sizeY);
+      hid_t file = H5Fopen(fileName.str().c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+      BOOST_REQUIRE_GE(file, 0);
+      hid_t dataset = H5Dopen(file, "/entry/data/data", H5P_DEFAULT);
+      BOOST_REQUIRE_GE(dataset, 0);
+      hid_t space = H5Dget_space(dataset);
+      hsize_t fileDims[3] = {0, 0, 0};
+      BOOST_CHECK_EQUAL(H5Sget_simple_extent_dims(space, fileDims, NULL), 3);
+      BOOST_CHECK_EQUAL(fileDims[0], (hsize_t)numFrames);
+      BOOST_CHECK_EQUAL(fileDims[1], (hsize_t)sizeY);
+      BOOST_CHECK_EQUAL(fileDims[2], (hsize_t)sizeX);
+      BOOST_CHECK_GE(H5Dread(dataset, H5T_NATIVE_UINT16, H5S_ALL, H5S_ALL, H5P_DEFAULT, &data[0]), 0);
+      H5Sclose(space);
+      H5Dclose(dataset);
+      H5Fclose(file);
+      int errors = 0;
+      for (int i = 0; i < numFrames; i++)
+      {
+        for (int j = 0; j < sizeX*sizeY; j++)
+        {
+          if (data[i*sizeX*sizeY + j] != (epicsUInt16)(i*1000 + j)) errors++;
+        }
+      }
+      BOOST_CHECK_EQUAL(errors, 0);
+      fileNumber++;
+    }
+  }
+
+  hdf5->write(str_NDFileHDF5_directChunkWrite, 0);
+  for (int i = 0; i < numFrames; i++) arrays[i]->release();
+}
+
+BOOST_AUTO_TEST_CASE(test_PrecompressedChunkWrite)
+{
+  // Frames compressed by NDPluginCodec are written as single chunks without being compressed again
+  const int sizeX = 100, sizeY = 70, numFrames = 5;
+  size_t dims[2] = {sizeX, sizeY};
+  std::string codecport("HDF5Codec");
+  uniqueAsynPortName(codecport);
+  boost::shared_ptr<CodecPluginWrapper> codec(new CodecPluginWrapper(codecport, hdf5->readString(NDPluginDriverArrayPortString)));
+  codec->write(NDPluginDriverEnableCallbacksString, 1);
+  codec->write(NDCodecModeString, NDCodecCompress);
+  codec->write(NDCodecCompressorString, NDCodecZlib);
+  boost::shared_ptr<asynGenericPointerClient> client(new asynGenericPointerClient(codecport.c_str(), 0, NDArrayDataString));
+  client->registerInterruptUser(&Codec_callback);
+
+  for (int i = 0; i < numFrames; i++)
+  {
+    NDArray *pArray = arrayPool->alloc(2, dims, NDUInt16, 0, NULL);
+    epicsUInt16 *pData = (epicsUInt16 *)pArray->pData;
+    for (int j = 0; j < sizeX*sizeY; j++) pData[j] = (epicsUInt16)(i*1000 + j/8);
+    pArray->uniqueId = i;
+    codec->lock();
+    codec->processCallbacks(pArray);
+    codec->unlock();
+    pArray->release();
+  }
+  if (codec->readInt(NDCodecCodecStatusString) != NDCodecStatusSuccess)
+  {
+    BOOST_TEST_MESSAGE("skipping: " << codec->readString(NDCodecCodecErrorString));
+  }
+  else
+  {
+    BOOST_REQUIRE_EQUAL(codecOutput.size(), (size_t)numFrames);
+    BOOST_REQUIRE_EQUAL(codecOutput[0]->codec.name, "zlib");
+
+    hdf5->write(NDFileWriteModeString, NDFileModeStream);
+    hdf5->write(NDFilePathString, "/tmp");
+    hdf5->write(NDFileNameString, "precompressed");
+    hdf5->write(NDFileTemplateString, "%s%s_%d.h5");
+    hdf5->write(NDFileNumberString, 0);
+    hdf5->write(NDAutoIncrementString, 0);
+    hdf5->write(str_NDFileHDF5_nColChunks, sizeX);
+    hdf5->write(str_NDFileHDF5_nRowChunks, sizeY);
+    hdf5->write(str_NDFileHDF5_nFramesChunks, 1);
+    hdf5->write(str_NDFileHDF5_compressionType, 3);  // zlib
+    hdf5->write(str_NDFileHDF5_directChunkWrite, 1);
+    hdf5->write(str_NDFileHDF5_writeQueueSize, 2);
+    hdf5->processCallbacks(codecOutput[0]);
+    hdf5->write(NDFileNumCaptureString, numFrames);
+    hdf5->write(NDFileCaptureString, 1);
+    for (int i = 0; i < numFrames; i++)
+    {
+      hdf5->lock();
+      BOOST_CHECK_NO_THROW(hdf5->processCallbacks(codecOutput[i]));
+      hdf5->unlock();
+    }
+    BOOST_CHECK_EQUAL(hdf5->readInt(NDFileNumCapturedString), numFrames);
+    BOOST_CHECK_EQUAL(hdf5->readInt(str_NDFileHDF5_directChunkActive), 1);
+
+    std::vector<epicsUInt16> data(numFrames*sizeX*sizeY);
+    hid_t file = H5Fopen("/tmp/precompressed_0.h5", H5F_ACC_RDONLY, H5P_DEFAULT);
+    BOOST_REQUIRE_GE(file, 0);
+    hid_t dataset = H5Dopen(file, "/entry/data/data", H5P_DEFAULT);
+    BOOST_REQUIRE_GE(dataset, 0);
+    BOOST_CHECK_GE(H5Dread(dataset, H5T_NATIVE_UINT16, H5S_ALL, H5S_ALL, H5P_DEFAULT, &data[0]), 0);
+    H5Dclose(dataset);
+    H5Fclose(file);
+    int errors = 0;
+    for (int i = 0; i < numFrames; i++)
+    {
+      for (int j = 0; j < sizeX*sizeY; j++)
+      {
+        if (data[i*sizeX*sizeY + j] != (epicsUInt16)(i*1000 + j/8)) errors++;
+      }
+    }
+    BOOST_CHECK_EQUAL(errors, 0);
+    hdf5->write(str_NDFileHDF5_directChunkWrite, 0);
+  }
+
+  client.reset();
+  for (size_t i = 0; i < codecOutput.size(); i++) codecOutput[i]->release();
+  codecOutput.clear();
+  codec.reset();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
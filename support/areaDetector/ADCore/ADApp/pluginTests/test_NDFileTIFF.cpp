@@ -0,0 +1,173 @@
+/*
+ * test_NDFileTIFF.cpp
+ *
+ * Checks the files written by the plugin thread and by the writer threads, and prints
+ * the number of files written per second with and without writer threads.
+ */
+
+#include <stdio.h>
+
+
+#include "boost/test/unit_test.hpp"
+
+// AD dependencies
+#include <NDPluginDriver.h>
+#include <NDArray.h>
+#include <asynDriver.h>
+#include <epicsThread.h>
+#include <tiffio.h>
+
+#include <string.h>
+#include <stdint.h>
+
+#include <boost/shared_ptr.hpp>
+using namespace std;
+
+#include "testingutilities.h"
+#include "TIFFPluginWrapper.h"
+
+struct TIFFPluginTestFixture
+{
+  boost::shared_ptr<asynNDArrayDriver> driver;
+  boost::shared_ptr<TIFFPluginWrapper> tiff;
+  std::string fileName;
+  int numFiles;
+
+  TIFFPluginTestFixture()
+  {
+    std::string simport("simTIFF"), testport("TIFF");
+    uniqueAsynPortName(simport);
+    uniqueAsynPortName(testport);
+    fileName = "test_" + testport;
+    numFiles = 0;
+
+    driver = boost::shared_ptr<asynNDArrayDriver>(new asynNDArrayDriver(simport.c_str(),
+                                                                     1, 0, 0,
+                                                                     asynGenericPointerMask,
+                                                                     asynGenericPointerMask,
+                                                                     0, 0, 0, 0));
+
+    // Arrays are sent to the plugin by calling processCallbacks directly
+    tiff = boost::shared_ptr<TIFFPluginWrapper>(new TIFFPluginWrapper(testport.c_str(), simport.c_str()));
+    tiff->write(NDPluginDriverEnableCallbacksString, 1);
+    tiff->write(NDFilePathString, "/tmp/");
+    tiff->write(NDFileNameString, fileName);
+    tiff->write(NDFileTemplateString, "%s%s_%3.3d.tif");
+    tiff->write(NDFileNumberString, 1);
+    tiff->write(NDAutoIncrementString, 1);
+    tiff->write(NDAutoSaveString, 1);
+    tiff->write(NDFileWriteModeString, NDFileModeSingle);
+  }
+
+  ~TIFFPluginTestFixture()
+  {
+    tiff.reset();
+    driver.reset();
+    for (int i=1; i<=numFiles; i++) remove(filePath(i).c_str());
+  }
+
+  std::string filePath(int fileNumber)
+  {
+    char name[256];
+    epicsSnprintf(name, sizeof(name), "/tmp/%s_%3.3d.tif", fileName.c_str(), fileNumber);
+    return name;
+  }
+
+  void process(NDArray *pArray)
+  {
+    tiff->lock();
+    BOOST_CHECK_NO_THROW(tiff->processCallbacks(pArray));
+    tiff->unlock();
+    numFiles++;
+  }
+
+  void waitForFiles()
+  {
+    for (int i=0; (i<500) && (tiff->readInt(NDFileTIFFFilesPendingString) > 0); i++) epicsThreadSleep(0.01);
+    BOOST_CHECK_EQUAL(tiff->readInt(NDFileTIFFFilesPendingString), 0);
+  }
+
+  // Checks the size, unique ID and data of a file written from a UInt16 array
+  void checkFile(int fileNumber, int uniqueId, size_t sizeX, size_t sizeY)
+  {
+    BOOST_MESSAGE("file " << filePath(fileNumber));
+    TIFF *tif = TIFFOpen(filePath(fileNumber).c_str(), "r");
+    BOOST_REQUIRE(tif != NULL);
+    uint32_t width = 0, height = 0, id = 0;
+    TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &width);
+    TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &height);
+    TIFFGetField(tif, 65001, &id);
+    BOOST_CHECK_EQUAL(width, sizeX);
+    BOOST_CHECK_EQUAL(height, sizeY);
+    BOOST_CHECK_EQUAL((int)id, uniqueId);
+    std::vector<epicsUInt16> data(sizeX*sizeY);
+    BOOST_CHECK_EQUAL(TIFFReadEncodedStrip(tif, 0, &data[0], data.size()*sizeof(epicsUInt16)),
+                      (tsize_t)(data.size()*sizeof(epicsUInt16)));
+    bool dataOK = true;
+    for (size_t i=0; i<data.size(); i++) {
+      if (data[i] != (epicsUInt16)(i + uniqueId)) dataOK = false;
+    }
+    BOOST_CHECK(dataOK);
+    TIFFClose(tif);
+  }
+
+  NDArray *allocArray(size_t sizeX, size_t sizeY, int uniqueId)
+  {
+    size_t dims[2] = {sizeX, sizeY};
+    NDArray *pArray = driver->pNDArrayPool->alloc(2, dims, NDUInt16, 0, NULL);
+    epicsUInt16 *pData = (epicsUInt16 *)pArray->pData;
+    for (size_t i=0; i<sizeX*sizeY; i++) pData[i] = (epicsUInt16)(i + uniqueId);
+    pArray->uniqueId = uniqueId;
+    return pArray;
+  }
+};
+
+BOOST_FIXTURE_TEST_SUITE(TIFFPluginTests, TIFFPluginTestFixture)
+
+BOOST_AUTO_TEST_CASE(test_WriteThreads)
+{
+  const size_t sizeX = 64, sizeY = 48;
+
+  // Files are written by the plugin thread, then by 3 writer threads, with the numbers in order
+  for (int threads=0; threads<=3; threads+=3) {
+    tiff->write(NDFileTIFFWriteThreadsString, threads);
+    for (int i=0; i<6; i++) {
+      NDArray *pArray = allocArray(sizeX, sizeY, numFiles+1);
+      process(pArray);
+      pArray->release();
+    }
+    waitForFiles();
+    BOOST_CHECK_EQUAL(tiff->readInt(NDFileNumberString), numFiles+1);
+  }
+  for (int i=1; i<=numFiles; i++) checkFile(i, i, sizeX, sizeY);
+  BOOST_CHECK_EQUAL(tiff->readInt(NDFileWriteStatusString), NDFileWriteOK);
+  BOOST_CHECK(tiff->readDouble(NDFileTIFFFileLatencyString) > 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_TempSuffix)
+{
+  // A file with a temporary name is written by the plugin thread, because it is renamed after closing
+  tiff->write(NDFileTIFFWriteThreadsString, 2);
+  tiff->write(NDFileTempSuffixString, ".tmp");
+  NDArray *pArray = allocArray(32, 16, 1);
+  process(pArray);
+  pArray->release();
+  BOOST_CHECK_EQUAL(tiff->readInt(NDFileTIFFFilesPendingString), 0);
+  checkFile(1, 1, 32, 16);
+}
+
+BOOST_AUTO_TEST_CASE(test_WriteErrors)
+{
+  // Errors in the writer threads are counted, because WriteStatus is reset when the next file is opened
+  tiff->write(NDFileTIFFWriteThreadsString, 2);
+  tiff->write(NDFilePathString, "/tmp/test_NDFileTIFF_no_such_directory/");
+  NDArray *pArray = allocArray(32, 16, 1);
+  for (int i=0; i<3; i++) process(pArray);
+  pArray->release();
+  waitForFiles();
+  BOOST_CHECK_EQUAL(tiff->readInt(NDFileTIFFWriteErrorsString), 3);
+  tiff->write(NDFileTIFFWriteErrorsString, 0);
+  BOOST_CHECK_EQUAL(tiff->readInt(NDFileTIFFWriteErrorsString), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
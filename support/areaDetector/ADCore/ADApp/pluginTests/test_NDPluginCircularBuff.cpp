@@ -34,6 +34,9 @@ struct NDPluginCircularBuffFixture
     asynOctetClient *cbTrigA;
     asynOctetClient *cbTrigB;
     asynOctetClient *cbCalc;
+    asynInt32Client *cbRingMode;
+    asynInt32Client *cbDropped;
+    std::string portName;
 
     NDPluginCircularBuffFixture()
     {
@@ -43,6 +46,7 @@ struct NDPluginCircularBuffFixture
         // change it slightly for each test case.
         uniqueAsynPortName(dummy_port);
         uniqueAsynPortName(testport);
+        portName = testport;
 
         // We need some upstream driver for our test plugin so that calls to connectToArrayPort don't fail, but we can then ignore it and send
         // arrays by calling processCallbacks directly.
@@ -66,10 +70,14 @@ struct NDPluginCircularBuffFixture
         cbTrigA = new asynOctetClient(testport.c_str(), 0, NDCircBuffTriggerAString);
         cbTrigB = new asynOctetClient(testport.c_str(), 0, NDCircBuffTriggerBString);
         cbCalc = new asynOctetClient(testport.c_str(), 0, NDCircBuffTriggerCalcString);
+        cbRingMode = new asynInt32Client(testport.c_str(), 0, NDCircBuffRingModeString);
+        cbDropped = new asynInt32Client(testport.c_str(), 0, NDCircBuffDroppedString);
 
     }
     ~NDPluginCircularBuffFixture()
     {
+        delete cbDropped;
+        delete cbRingMode;
         delete cbCalc;
         delete cbTrigB;
         delete cbTrigA;
@@ -91,6 +99,32 @@ struct NDPluginCircularBuffFixture
     }
 };
 
+// TestingPlugin does not reserve the arrays, so record what the ring outputs as it arrives
+static std::vector<std::pair<int, int> > ringOutput;
+
+static void ringOutputCallback(void *drvPvt, asynUser *pasynUser, void *ptr)
+{
+    NDArray *pArray = (NDArray *)ptr;
+    ringOutput.push_back(std::make_pair(pArray->uniqueId, (int)((uint8_t *)pArray->pData)[2]));
+}
+
+static std::vector<std::pair<std::string, size_t> > ringCodecs;
+
+static void ringCodecCallback(void *drvPvt, asynUser *pasynUser, void *ptr)
+{
+    NDArray *pArray = (NDArray *)ptr;
+    ringCodecs.push_back(std::make_pair(pArray->codec.name, pArray->compressedSize));
+}
+
+static std::vector<NDArray *> heldArrays;
+
+static void holdOutputCallback(void *drvPvt, asynUser *pasynUser, void *ptr)
+{
+    NDArray *pArray = (NDArray *)ptr;
+    pArray->reserve();
+    heldArrays.push_back(pArray);
+}
+
 BOOST_FIXTURE_TEST_SUITE(CircularBuffTests, NDPluginCircularBuffFixture)
 
 BOOST_AUTO_TEST_CASE(test_BufferWrappingAndStatusMessages)
@@ -183,4 +217,164 @@ BOOST_AUTO_TEST_CASE(test_PreBufferOrder)
     BOOST_CHECK_EQUAL(3, ((uint8_t *)ds->arrays[3]->pData)[0]);
 }
 
+BOOST_AUTO_TEST_CASE(test_ContiguousRing)
+{
+    size_t gotbytes;
+    cbCalc->write("0", 2, &gotbytes);
+
+    asynGenericPointerClient output(portName.c_str(), 0, NDArrayDataString);
+    ringOutput.clear();
+    output.registerInterruptUser(ringOutputCallback);
+
+    cbRingMode->write(NDCircBuffRingContiguous);
+    cbPreTrigger->write(3);
+    cbControl->write(1);
+
+    size_t dims = 3, largeDims = 1000;
+    NDArray *testArrays[6];
+    for (int i = 0; i < 6; i++) {
+        testArrays[i] = arrayPool->alloc(1,&dims,NDUInt8,0,NULL);
+        memset(testArrays[i]->pData, i, 3);
+        testArrays[i]->uniqueId = i;
+    }
+    NDArray *largeArray = arrayPool->alloc(1,&largeDims,NDUInt8,0,NULL);
+
+    // The slots are sized for the first frame, so the larger frame is dropped
+    for (int i = 0; i < 5; i++) {
+        cbProcess(testArrays[i]);
+        if (i == 1) cbProcess(largeArray);
+    }
+
+    int storedImages, dropped;
+    cbCount->read(&storedImages);
+    cbDropped->read(&dropped);
+    BOOST_CHECK_EQUAL(storedImages, 3);
+    BOOST_CHECK_EQUAL(dropped, 1);
+    BOOST_CHECK_EQUAL((size_t)0, ds->arrays.size());
+
+    // The ring holds the last 3 frames, which come out before the post-trigger frame
+    cbSoftTrigger->write(1);
+    cbProcess(testArrays[5]);
+
+    BOOST_REQUIRE_EQUAL((size_t)4, ringOutput.size());
+    for (int i = 0; i < 4; i++) {
+        BOOST_CHECK_EQUAL(i+2, ringOutput[i].first);
+        BOOST_CHECK_EQUAL(i+2, ringOutput[i].second);
+        BOOST_CHECK_EQUAL((size_t)3, ds->arrays[i]->dims[0].size);
+    }
+    // The post-trigger frame is passed on without a copy
+    BOOST_CHECK_EQUAL(testArrays[5], ds->arrays[3]);
+
+    largeArray->release();
+    for (int i = 0; i < 6; i++) testArrays[i]->release();
+}
+
+BOOST_AUTO_TEST_CASE(test_CompressedRing)
+{
+    size_t gotbytes;
+    cbCalc->write("0", 2, &gotbytes);
+
+    asynGenericPointerClient output(portName.c_str(), 0, NDArrayDataString);
+    ringCodecs.clear();
+    output.registerInterruptUser(ringCodecCallback);
+
+    cbRingMode->write(NDCircBuffRingContiguous);
+    cbPreTrigger->write(2);
+    cbControl->write(1);
+
+    // Compressed frames are stored and output with their compressed size and codec
+    size_t dims = 100;
+    NDArray *testArrays[3];
+    for (int i = 0; i < 3; i++) {
+        testArrays[i] = arrayPool->alloc(1,&dims,NDUInt8,0,NULL);
+        memset(testArrays[i]->pData, i, dims);
+        testArrays[i]->uniqueId = i;
+        testArrays[i]->codec.name = "zlib";
+        testArrays[i]->compressedSize = 10 + i;
+    }
+    cbProcess(testArrays[0]);
+    cbProcess(testArrays[1]);
+    cbSoftTrigger->write(1);
+    cbProcess(testArrays[2]);
+
+    BOOST_REQUIRE_EQUAL((size_t)3, ringCodecs.size());
+    for (int i = 0; i < 3; i++) {
+        BOOST_CHECK_EQUAL("zlib", ringCodecs[i].first);
+        BOOST_CHECK_EQUAL((size_t)(10 + i), ringCodecs[i].second);
+    }
+
+    for (int i = 0; i < 3; i++) testArrays[i]->release();
+}
+
+BOOST_AUTO_TEST_CASE(test_ContiguousRingRestart)
+{
+    size_t gotbytes;
+    cbCalc->write("0", 2, &gotbytes);
+    asynInt32Client cbPresetTriggerCount(portName.c_str(), 0, NDCircBuffPresetTriggerCountString);
+
+    // Keep the arrays output by each trigger while the next capture fills the ring
+    asynGenericPointerClient output(portName.c_str(), 0, NDArrayDataString);
+    heldArrays.clear();
+    output.registerInterruptUser(holdOutputCallback);
+
+    // PreCount is limited by maxBuffers in this mode too
+    int preTrigger;
+    cbRingMode->write(NDCircBuffRingContiguous);
+    cbPreTrigger->write(1000);
+    cbPreTrigger->read(&preTrigger);
+    BOOST_CHECK(preTrigger != 1000);
+
+    cbPreTrigger->write(2);
+    cbPostTrigger->write(1);
+    cbPresetTriggerCount.write(3);
+    cbControl->write(1);
+
+    // The first capture has small frames, the next two larger ones, which do not fit the slots sized
+    // for the first capture.  The attribute names change after the first capture, but not their number.
+    const size_t sizes[3] = {100, 1000, 1000};
+    const char *attrNames[3] = {"A", "B", "B"};
+    NDArray *frames[3][3];
+    for (int c = 0; c < 3; c++) {
+        for (int i = 0; i < 3; i++) {
+            size_t dims = sizes[c];
+            epicsInt32 value = 10*c + i;
+            frames[c][i] = arrayPool->alloc(1,&dims,NDUInt8,0,NULL);
+            memset(frames[c][i]->pData, value, dims);
+            frames[c][i]->uniqueId = value;
+            frames[c][i]->pAttributeList->add(attrNames[c], "", NDAttrInt32, &value);
+        }
+        cbProcess(frames[c][0]);
+        cbProcess(frames[c][1]);
+        cbSoftTrigger->write(1);
+        cbProcess(frames[c][2]);
+    }
+
+    int dropped;
+    cbDropped->read(&dropped);
+    BOOST_CHECK_EQUAL(dropped, 0);
+    BOOST_REQUIRE_EQUAL((size_t)9, heldArrays.size());
+    for (int c = 0; c < 3; c++) {
+        // The pre-trigger frames are views of the ring, and are not overwritten by later captures
+        for (int i = 0; i < 2; i++) {
+            NDArray *pArray = heldArrays[3*c + i];
+            BOOST_CHECK_EQUAL(pArray->uniqueId, 10*c + i);
+            BOOST_CHECK_EQUAL(pArray->dims[0].size, sizes[c]);
+            BOOST_CHECK(pArray->pViewParent != NULL);
+            BOOST_CHECK_EQUAL(((uint8_t *)pArray->pData)[0], 10*c + i);
+            BOOST_CHECK_EQUAL(((uint8_t *)pArray->pData)[sizes[c]-1], 10*c + i);
+            BOOST_CHECK(pArray->pAttributeList->find(attrNames[c]) != NULL);
+            BOOST_CHECK_EQUAL(pArray->pAttributeList->count(), 1);
+        }
+        BOOST_CHECK_EQUAL(heldArrays[3*c + 2], frames[c][2]);
+    }
+    // Each capture filled a new ring, as the previous one was still in use
+    BOOST_CHECK(heldArrays[0]->pViewParent != heldArrays[3]->pViewParent);
+    BOOST_CHECK(heldArrays[3]->pViewParent != heldArrays[6]->pViewParent);
+
+    for (size_t i = 0; i < heldArrays.size(); i++) heldArrays[i]->release();
+    for (int c = 0; c < 3; c++) {
+        for (int i = 0; i < 3; i++) frames[c][i]->release();
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
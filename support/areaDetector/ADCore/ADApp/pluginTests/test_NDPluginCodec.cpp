@@ -0,0 +1,272 @@
+/*
+ * test_NDPluginCodec.cpp
+ *
+ * Compresses arrays with one NDPluginCodec and restores them with a second one, for each
+ * compressor and several data types, and checks that plugins which cannot handle
+ * compressed arrays drop them.
+ */
+
+#include <stdio.h>
+
+
+#include "boost/test/unit_test.hpp"
+
+// AD dependencies
+#include <NDPluginDriver.h>
+#include <NDArray.h>
+#include <asynDriver.h>
+
+#include <string.h>
+#include <stdint.h>
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+using namespace std;
+
+#include "testingutilities.h"
+#include "CodecPluginWrapper.h"
+#include "ProcessPluginWrapper.h"
+
+#define SIZE_X 120
+#define SIZE_Y 75
+
+static NDArray *compressOutput = 0;
+static NDArray *decompressOutput = 0;
+
+static void Compress_callback(void *userPvt, asynUser *pasynUser, void *pointer)
+{
+  if (compressOutput) compressOutput->release();
+  compressOutput = (NDArray *)pointer;
+  compressOutput->reserve();
+}
+
+static void Decompress_callback(void *userPvt, asynUser *pasynUser, void *pointer)
+{
+  if (decompressOutput) decompressOutput->release();
+  decompressOutput = (NDArray *)pointer;
+  decompressOutput->reserve();
+}
+
+template <typename epicsType>
+static void fillArrayT(NDArray *pArray, int frame)
+{
+  epicsType *pData = (epicsType *)pArray->pData;
+  for (size_t iy=0; iy<SIZE_Y; iy++) {
+    for (size_t ix=0; ix<SIZE_X; ix++) {
+      // Runs of equal values that every compressor finds, with some variation in both bytes of 16 bit values
+      pData[iy*SIZE_X + ix] = (epicsType)((ix/4 + iy*3 + frame) % 100 + (iy/8) * 37);
+    }
+  }
+}
+
+static void fillArray(NDArray *pArray, int frame)
+{
+  switch (pArray->dataType) {
+    case NDInt8:    fillArrayT<epicsInt8>   (pArray, frame); break;
+    case NDUInt8:   fillArrayT<epicsUInt8>  (pArray, frame); break;
+    case NDInt16:   fillArrayT<epicsInt16>  (pArray, frame); break;
+    case NDUInt16:  fillArrayT<epicsUInt16> (pArray, frame); break;
+    case NDInt32:   fillArrayT<epicsInt32>  (pArray, frame); break;
+    case NDUInt32:  fillArrayT<epicsUInt32> (pArray, frame); break;
+    case NDFloat32: fillArrayT<epicsFloat32>(pArray, frame); break;
+    case NDFloat64: fillArrayT<epicsFloat64>(pArray, frame); break;
+    default: break;
+  }
+}
+
+struct CodecPluginTestFixture
+{
+  boost::shared_ptr<asynNDArrayDriver> driver;
+  boost::shared_ptr<CodecPluginWrapper> compress;
+  boost::shared_ptr<CodecPluginWrapper> decompress;
+  boost::shared_ptr<asynGenericPointerClient> compressClient;
+  boost::shared_ptr<asynGenericPointerClient> decompressClient;
+  std::string simport;
+
+  CodecPluginTestFixture()
+  {
+    std::string compressport("Compress"), decompressport("Decompress");
+    simport = "simCodec";
+    uniqueAsynPortName(simport);
+    uniqueAsynPortName(compressport);
+    uniqueAsynPortName(decompressport);
+
+    driver = boost::shared_ptr<asynNDArrayDriver>(new asynNDArrayDriver(simport.c_str(),
+                                                                     1, 0, 0,
+                                                                     asynGenericPointerMask,
+                                                                     asynGenericPointerMask,
+                                                                     0, 0, 0, 0));
+
+    // Arrays are sent to both plugins by calling processCallbacks directly
+    compress = boost::shared_ptr<CodecPluginWrapper>(new CodecPluginWrapper(compressport.c_str(), simport.c_str()));
+    compress->write(NDPluginDriverEnableCallbacksString, 1);
+    compress->write(NDCodecModeString, NDCodecCompress);
+    decompress = boost::shared_ptr<CodecPluginWrapper>(new CodecPluginWrapper(decompressport.c_str(), simport.c_str()));
+    decompress->write(NDPluginDriverEnableCallbacksString, 1);
+    decompress->write(NDCodecModeString, NDCodecDecompress);
+
+    compressClient = boost::shared_ptr<asynGenericPointerClient>(new asynGenericPointerClient(compressport.c_str(), 0, NDArrayDataString));
+    compressClient->registerInterruptUser(&Compress_callback);
+    decompressClient = boost::shared_ptr<asynGenericPointerClient>(new asynGenericPointerClient(decompressport.c_str(), 0, NDArrayDataString));
+    decompressClient->registerInterruptUser(&Decompress_callback);
+  }
+
+  ~CodecPluginTestFixture()
+  {
+    compressClient.reset();
+    decompressClient.reset();
+    if (compressOutput) compressOutput->release();
+    compressOutput = 0;
+    if (decompressOutput) decompressOutput->release();
+    decompressOutput = 0;
+    compress.reset();
+    decompress.reset();
+    driver.reset();
+  }
+
+  void send(boost::shared_ptr<CodecPluginWrapper> plugin, NDArray *pArray)
+  {
+    plugin->lock();
+    BOOST_CHECK_NO_THROW(plugin->processCallbacks(pArray));
+    plugin->unlock();
+  }
+
+  // Returns false if this compressor is not available in this build
+  bool roundTrip(NDDataType_t dataType, const char *codecName)
+  {
+    size_t dims[2] = {SIZE_X, SIZE_Y};
+    NDArrayInfo_t info;
+
+    for (int frame=0; frame<3; frame++) {
+      NDArray *pArray = driver->pNDArrayPool->alloc(2, dims, dataType, 0, NULL);
+      fillArray(pArray, frame);
+      pArray->uniqueId = frame + 10;
+      pArray->getInfo(&info);
+      send(compress, pArray);
+      if (compress->readInt(NDCodecCodecStatusString) == NDCodecStatusError) {
+        std::string error = compress->readString(NDCodecCodecErrorString);
+        pArray->release();
+        BOOST_REQUIRE(error.find("built without") != std::string::npos);
+        BOOST_TEST_MESSAGE("skipping " << codecName << ": " << error);
+        return false;
+      }
+      BOOST_REQUIRE(compressOutput != 0);
+      BOOST_CHECK_EQUAL(compressOutput->codec.name, codecName);
+      BOOST_CHECK_EQUAL(compressOutput->uniqueId, frame + 10);
+      BOOST_CHECK_EQUAL(compressOutput->dataType, dataType);
+      BOOST_CHECK_EQUAL(compressOutput->dims[0].size, SIZE_X);
+      BOOST_CHECK_EQUAL(compressOutput->dims[1].size, SIZE_Y);
+      BOOST_CHECK_GT(compressOutput->compressedSize, 0);
+      BOOST_CHECK_LT(compressOutput->compressedSize, info.totalBytes);
+      BOOST_CHECK_GT(compress->readDouble(NDCodecCompFactorString), 1.0);
+
+      send(decompress, compressOutput);
+      BOOST_CHECK_EQUAL(decompress->readInt(NDCodecCodecStatusString), NDCodecStatusSuccess);
+      BOOST_REQUIRE(decompressOutput != 0);
+      BOOST_CHECK(decompressOutput->codec.name.empty());
+      BOOST_CHECK_EQUAL(decompressOutput->compressedSize, 0);
+      BOOST_CHECK_EQUAL(decompressOutput->uniqueId, frame + 10);
+      BOOST_CHECK_EQUAL(decompressOutput->dataType, dataType);
+      BOOST_CHECK_EQUAL(memcmp(decompressOutput->pData, pArray->pData, info.totalBytes), 0);
+      pArray->release();
+    }
+    return true;
+  }
+};
+
+BOOST_FIXTURE_TEST_SUITE(CodecPluginTests, CodecPluginTestFixture)
+
+BOOST_AUTO_TEST_CASE(test_CodecZlib)
+{
+  NDDataType_t dataTypes[] = {NDInt8, NDUInt8, NDInt16, NDUInt16, NDInt32, NDUInt32, NDFloat32, NDFloat64};
+
+  compress->write(NDCodecCompressorString, NDCodecZlib);
+  for (size_t i=0; i<sizeof(dataTypes)/sizeof(dataTypes[0]); i++) {
+    BOOST_TEST_MESSAGE("dataType=" << dataTypes[i]);
+    if (!roundTrip(dataTypes[i], "zlib")) break;
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_CodecBlosc)
+{
+  int compressors[] = {NDCodecBloscLZ, NDCodecBloscLZ4, NDCodecBloscLZ4HC, NDCodecBloscZlib, NDCodecBloscZstd};
+  int shuffles[] = {NDCodecBloscNoShuffle, NDCodecBloscByteShuffle, NDCodecBloscBitShuffle};
+  int numThreads[] = {1, 4};
+
+  compress->write(NDCodecCompressorString, NDCodecBlosc);
+  compress->write(NDCodecBloscCLevelString, 5);
+  for (size_t c=0; c<sizeof(compressors)/sizeof(compressors[0]); c++) {
+    for (size_t s=0; s<sizeof(shuffles)/sizeof(shuffles[0]); s++) {
+      for (size_t t=0; t<sizeof(numThreads)/sizeof(numThreads[0]); t++) {
+        BOOST_TEST_MESSAGE("compressor=" << compressors[c] << " shuffle=" << shuffles[s] << " threads=" << numThreads[t]);
+        compress->write(NDCodecBloscCompressorString, compressors[c]);
+        compress->write(NDCodecBloscShuffleString, shuffles[s]);
+        compress->write(NDCodecBloscNumThreadsString, numThreads[t]);
+        decompress->write(NDCodecBloscNumThreadsString, numThreads[t]);
+        if (!roundTrip(NDUInt16, "blosc")) return;
+        BOOST_CHECK_EQUAL(compressOutput->codec.compressor, compressors[c]);
+        BOOST_CHECK_EQUAL(compressOutput->codec.shuffle, shuffles[s]);
+      }
+    }
+  }
+  // Float data with bit shuffle
+  compress->write(NDCodecBloscCompressorString, NDCodecBloscLZ4);
+  compress->write(NDCodecBloscShuffleString, NDCodecBloscBitShuffle);
+  roundTrip(NDFloat32, "blosc");
+  roundTrip(NDFloat64, "blosc");
+}
+
+BOOST_AUTO_TEST_CASE(test_CodecPassThrough)
+{
+  size_t dims[2] = {SIZE_X, SIZE_Y};
+  NDArray *pArray = driver->pNDArrayPool->alloc(2, dims, NDUInt16, 0, NULL);
+  fillArray(pArray, 0);
+
+  // No compressor: the array is passed on unchanged
+  compress->write(NDCodecCompressorString, NDCodecNone);
+  send(compress, pArray);
+  BOOST_REQUIRE(compressOutput != 0);
+  BOOST_CHECK(compressOutput->codec.name.empty());
+  BOOST_CHECK_EQUAL(memcmp(compressOutput->pData, pArray->pData, SIZE_X*SIZE_Y*sizeof(epicsUInt16)), 0);
+
+  // Uncompressed arrays need no decompression
+  send(decompress, pArray);
+  BOOST_CHECK_EQUAL(decompress->readInt(NDCodecCodecStatusString), NDCodecStatusSuccess);
+  BOOST_REQUIRE(decompressOutput != 0);
+  BOOST_CHECK_EQUAL(memcmp(decompressOutput->pData, pArray->pData, SIZE_X*SIZE_Y*sizeof(epicsUInt16)), 0);
+  pArray->release();
+}
+
+BOOST_AUTO_TEST_CASE(test_CodecCompressedDropped)
+{
+  size_t dims[2] = {SIZE_X, SIZE_Y};
+  std::string processport("CodecProcess");
+  uniqueAsynPortName(processport);
+  boost::shared_ptr<ProcessPluginWrapper> process(new ProcessPluginWrapper(processport.c_str(), simport.c_str()));
+  process->write(NDPluginDriverEnableCallbacksString, 1);
+  process->write(NDPluginDriverDroppedArraysString, 0);
+
+  NDArray *pArray = driver->pNDArrayPool->alloc(2, dims, NDUInt16, 0, NULL);
+  fillArray(pArray, 0);
+  compress->write(NDCodecCompressorString, NDCodecZlib);
+  send(compress, pArray);
+  pArray->release();
+  BOOST_REQUIRE(compressOutput != 0);
+  BOOST_REQUIRE(!compressOutput->codec.name.empty());
+
+  // NDPluginProcess would read the compressed bytes as pixels, so it must drop the array
+  asynUser *pasynUser = pasynManager->createAsynUser(0, 0);
+  process->driverCallback(pasynUser, compressOutput);
+  pasynManager->freeAsynUser(pasynUser);
+  BOOST_CHECK_EQUAL(process->readInt(NDPluginDriverDroppedArraysString), 1);
+
+  // Copies keep the codec and all of the compressed data
+  NDArray *pCopy = driver->pNDArrayPool->copy(compressOutput, NULL, 1);
+  BOOST_REQUIRE(pCopy != 0);
+  BOOST_CHECK_EQUAL(pCopy->codec.name, compressOutput->codec.name);
+  BOOST_CHECK_EQUAL(pCopy->compressedSize, compressOutput->compressedSize);
+  BOOST_CHECK_EQUAL(memcmp(pCopy->pData, compressOutput->pData, compressOutput->compressedSize), 0);
+  pCopy->release();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
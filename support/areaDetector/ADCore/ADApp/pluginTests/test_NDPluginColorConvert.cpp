@@ -0,0 +1,394 @@
+/*
+ * test_NDPluginColorConvert.cpp
+ *
+ * Checks the conversions between mono and the RGB color modes, the Bayer demosaic methods and the
+ * YUV conversions against reference values, with image sizes that are not multiples of 2,
+ * and prints the conversion rate for large images.
+ */
+
+#include <stdio.h>
+#include <math.h>
+
+
+#include "boost/test/unit_test.hpp"
+
+// AD dependencies
+#include <NDPluginDriver.h>
+#include <NDArray.h>
+#include <asynDriver.h>
+
+#include <string.h>
+#include <stdint.h>
+
+#include <boost/shared_ptr.hpp>
+using namespace std;
+
+#include "testingutilities.h"
+#include "ColorConvertPluginWrapper.h"
+
+#define SIZE_X 37
+#define SIZE_Y 21
+
+static NDArray *colorConvertOutput = 0;
+
+static void ColorConvert_callback(void *userPvt, asynUser *pasynUser, void *pointer)
+{
+  if (colorConvertOutput) colorConvertOutput->release();
+  colorConvertOutput = (NDArray *)pointer;
+  colorConvertOutput->reserve();
+}
+
+/* Index of pixel (x, y) and color c of an xSize by ySize image in each color mode */
+static size_t pixelIndex(int colorMode, size_t x, size_t y, size_t c, size_t xSize, size_t ySize)
+{
+  switch (colorMode) {
+    case NDColorModeRGB1: return c + 3*x + 3*xSize*y;
+    case NDColorModeRGB2: return x + xSize*c + 3*xSize*y;
+    case NDColorModeRGB3: return x + xSize*y + xSize*ySize*c;
+    default:              return x + xSize*y;
+  }
+}
+
+/* Bayer color of pixel (x, y); 0 is red, 1 green and 2 blue */
+static int bayerColor(int pattern, size_t x, size_t y)
+{
+  static const int colors[4][4] = {{0, 1, 1, 2}, {1, 2, 0, 1}, {1, 0, 2, 1}, {2, 1, 1, 0}};
+  return colors[pattern][2*(y & 1) + (x & 1)];
+}
+
+struct ColorConvertPluginTestFixture
+{
+  boost::shared_ptr<asynNDArrayDriver> driver;
+  boost::shared_ptr<ColorConvertPluginWrapper> colorConvert;
+  boost::shared_ptr<asynGenericPointerClient> client;
+
+  ColorConvertPluginTestFixture()
+  {
+    std::string simport("simColorConvert"), testport("ColorConvert");
+    uniqueAsynPortName(simport);
+    uniqueAsynPortName(testport);
+
+    driver = boost::shared_ptr<asynNDArrayDriver>(new asynNDArrayDriver(simport.c_str(),
+                                                                     1, 0, 0,
+                                                                     asynGenericPointerMask,
+                                                                     asynGenericPointerMask,
+                                                                     0, 0, 0, 0));
+
+    // Arrays are sent to the plugin by calling processCallbacks directly
+    colorConvert = boost::shared_ptr<ColorConvertPluginWrapper>(new ColorConvertPluginWrapper(testport.c_str(), simport.c_str()));
+    colorConvert->write(NDPluginDriverEnableCallbacksString, 1);
+
+    client = boost::shared_ptr<asynGenericPointerClient>(new asynGenericPointerClient(testport.c_str(), 0, NDArrayDataString));
+    client->registerInterruptUser(&ColorConvert_callback);
+  }
+
+  ~ColorConvertPluginTestFixture()
+  {
+    client.reset();
+    if (colorConvertOutput) colorConvertOutput->release();
+    colorConvertOutput = 0;
+    colorConvert.reset();
+    driver.reset();
+  }
+
+  NDArray *createArray(int colorMode, NDDataType_t dataType, size_t xSize, size_t ySize)
+  {
+    size_t dims[3];
+    int ndims = 3;
+    NDArray *pArray;
+
+    switch (colorMode) {
+      case NDColorModeRGB1: dims[0] = 3;     dims[1] = xSize; dims[2] = ySize; break;
+      case NDColorModeRGB2: dims[0] = xSize; dims[1] = 3;     dims[2] = ySize; break;
+      case NDColorModeRGB3: dims[0] = xSize; dims[1] = ySize; dims[2] = 3;     break;
+      default:              dims[0] = xSize; dims[1] = ySize; ndims = 2;       break;
+    }
+    pArray = driver->pNDArrayPool->alloc(ndims, dims, dataType, 0, NULL);
+    BOOST_REQUIRE(pArray);
+    pArray->pAttributeList->add("ColorMode", "Color mode", NDAttrInt32, &colorMode);
+    return pArray;
+  }
+
+  void convert(NDArray *pArray, int colorModeOut)
+  {
+    colorConvert->write(NDPluginColorConvertColorModeOutString, colorModeOut);
+    colorConvert->lock();
+    BOOST_CHECK_NO_THROW(colorConvert->processCallbacks(pArray));
+    colorConvert->unlock();
+    BOOST_REQUIRE(colorConvertOutput);
+  }
+};
+
+BOOST_FIXTURE_TEST_SUITE(ColorConvertPluginTests, ColorConvertPluginTestFixture)
+
+BOOST_AUTO_TEST_CASE(test_RGBConversions)
+{
+  int colorModes[4] = {NDColorModeMono, NDColorModeRGB1, NDColorModeRGB2, NDColorModeRGB3};
+
+  for (int modeIn=0; modeIn<4; modeIn++) {
+    int colorModeIn = colorModes[modeIn];
+    NDArray *pArray = createArray(colorModeIn, NDUInt16, SIZE_X, SIZE_Y);
+    epicsUInt16 *pIn = (epicsUInt16 *)pArray->pData;
+    size_t numColorsIn = (colorModeIn == NDColorModeMono) ? 1 : 3;
+    for (size_t i=0; i<SIZE_X*SIZE_Y*numColorsIn; i++) pIn[i] = (epicsUInt16)(i*7);
+
+    for (int modeOut=0; modeOut<4; modeOut++) {
+      int colorModeOut = colorModes[modeOut];
+      NDArrayInfo_t info;
+      size_t errors = 0;
+
+      if (colorModeOut == colorModeIn) continue;
+      BOOST_MESSAGE("colorModeIn=" << colorModeIn << " colorModeOut=" << colorModeOut);
+      convert(pArray, colorModeOut);
+      colorConvertOutput->getInfo(&info);
+      BOOST_CHECK_EQUAL(info.colorMode, colorModeOut);
+      BOOST_CHECK_EQUAL(info.xSize, SIZE_X);
+      BOOST_CHECK_EQUAL(info.ySize, SIZE_Y);
+      BOOST_CHECK_EQUAL(colorConvertOutput->uniqueId, pArray->uniqueId);
+
+      epicsUInt16 *pOut = (epicsUInt16 *)colorConvertOutput->pData;
+      for (size_t y=0; y<SIZE_Y; y++) {
+        for (size_t x=0; x<SIZE_X; x++) {
+          if (colorModeOut == NDColorModeMono) {
+            int sum = 0;
+            for (size_t c=0; c<3; c++) sum += pIn[pixelIndex(colorModeIn, x, y, c, SIZE_X, SIZE_Y)];
+            if (pOut[pixelIndex(colorModeOut, x, y, 0, SIZE_X, SIZE_Y)] != (epicsUInt16)(sum/3.)) errors++;
+          } else {
+            for (size_t c=0; c<3; c++) {
+              size_t cIn = (colorModeIn == NDColorModeMono) ? 0 : c;
+              if (pOut[pixelIndex(colorModeOut, x, y, c, SIZE_X, SIZE_Y)] !=
+                  pIn[pixelIndex(colorModeIn, x, y, cIn, SIZE_X, SIZE_Y)]) errors++;
+            }
+          }
+        }
+      }
+      BOOST_CHECK_EQUAL(errors, 0);
+    }
+    pArray->release();
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_FalseColor)
+{
+  // The false color map gives the same colors in each layout, and they are not gray
+  NDArray *pArray = createArray(NDColorModeMono, NDUInt8, SIZE_X, SIZE_Y);
+  epicsUInt8 *pIn = (epicsUInt8 *)pArray->pData;
+  std::vector<epicsUInt8> rgb1(3*SIZE_X*SIZE_Y);
+  size_t errors = 0, gray = 0;
+
+  for (size_t i=0; i<SIZE_X*SIZE_Y; i++) pIn[i] = (epicsUInt8)i;
+  colorConvert->write(NDPluginColorConvertFalseColorString, 2);
+  convert(pArray, NDColorModeRGB1);
+  memcpy(&rgb1[0], colorConvertOutput->pData, rgb1.size());
+  convert(pArray, NDColorModeRGB3);
+  epicsUInt8 *pOut = (epicsUInt8 *)colorConvertOutput->pData;
+  for (size_t y=0; y<SIZE_Y; y++) {
+    for (size_t x=0; x<SIZE_X; x++) {
+      for (size_t c=0; c<3; c++) {
+        if (pOut[pixelIndex(NDColorModeRGB3, x, y, c, SIZE_X, SIZE_Y)] !=
+            rgb1[pixelIndex(NDColorModeRGB1, x, y, c, SIZE_X, SIZE_Y)]) errors++;
+      }
+      if ((pOut[pixelIndex(NDColorModeRGB3, x, y, 0, SIZE_X, SIZE_Y)] ==
+           pOut[pixelIndex(NDColorModeRGB3, x, y, 1, SIZE_X, SIZE_Y)])) gray++;
+    }
+  }
+  BOOST_CHECK_EQUAL(errors, 0);
+  BOOST_CHECK(gray < SIZE_X*SIZE_Y/2);
+  pArray->release();
+}
+
+BOOST_AUTO_TEST_CASE(test_BayerFlatColor)
+{
+  // A Bayer image of one color must convert to exactly that color with every method and pattern,
+  // including the pixels at the edges
+  const epicsUInt16 color[3] = {1000, 600, 200};
+  int colorModes[3] = {NDColorModeRGB1, NDColorModeRGB2, NDColorModeRGB3};
+
+  for (int pattern=NDBayerRGGB; pattern<=NDBayerBGGR; pattern++) {
+    NDArray *pArray = createArray(NDColorModeBayer, NDUInt16, SIZE_X, SIZE_Y);
+    pArray->pAttributeList->add("BayerPattern", "Bayer pattern", NDAttrInt32, &pattern);
+    epicsUInt16 *pIn = (epicsUInt16 *)pArray->pData;
+    for (size_t y=0; y<SIZE_Y; y++) {
+      for (size_t x=0; x<SIZE_X; x++) pIn[x + SIZE_X*y] = color[bayerColor(pattern, x, y)];
+    }
+    for (int method=NDColorConvertBayerNearest; method<=NDColorConvertBayerEdgeAware; method++) {
+      for (int mode=0; mode<3; mode++) {
+        NDArrayInfo_t info;
+        size_t errors = 0;
+
+        BOOST_MESSAGE("pattern=" << pattern << " method=" << method << " colorModeOut=" << colorModes[mode]);
+        colorConvert->write(NDPluginColorConvertBayerMethodString, method);
+        convert(pArray, colorModes[mode]);
+        colorConvertOutput->getInfo(&info);
+        BOOST_CHECK_EQUAL(info.colorMode, colorModes[mode]);
+        BOOST_CHECK_EQUAL(info.xSize, SIZE_X);
+        BOOST_CHECK_EQUAL(info.ySize, SIZE_Y);
+        epicsUInt16 *pOut = (epicsUInt16 *)colorConvertOutput->pData;
+        for (size_t y=0; y<SIZE_Y; y++) {
+          for (size_t x=0; x<SIZE_X; x++) {
+            for (size_t c=0; c<3; c++) {
+              if (pOut[pixelIndex(colorModes[mode], x, y, c, SIZE_X, SIZE_Y)] != color[c]) errors++;
+            }
+          }
+        }
+        BOOST_CHECK_EQUAL(errors, 0);
+      }
+    }
+    pArray->release();
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_BayerGradient)
+{
+  // Bilinear and edge-aware interpolation reproduce a gray image that is a linear function of
+  // position more than 2 pixels from the edges; nearest gives each color from within the 2x2 cell
+  int pattern = NDBayerGRBG;
+  NDArray *pArray = createArray(NDColorModeBayer, NDFloat64, SIZE_X, SIZE_Y);
+  pArray->pAttributeList->add("BayerPattern", "Bayer pattern", NDAttrInt32, &pattern);
+  epicsFloat64 *pIn = (epicsFloat64 *)pArray->pData;
+  for (size_t y=0; y<SIZE_Y; y++) {
+    for (size_t x=0; x<SIZE_X; x++) pIn[x + SIZE_X*y] = 3.*x + 5.*y;
+  }
+
+  for (int method=NDColorConvertBayerNearest; method<=NDColorConvertBayerEdgeAware; method++) {
+    size_t errors = 0;
+    colorConvert->write(NDPluginColorConvertBayerMethodString, method);
+    convert(pArray, NDColorModeRGB3);
+    epicsFloat64 *pOut = (epicsFloat64 *)colorConvertOutput->pData;
+    for (size_t y=3; y<SIZE_Y-3; y++) {
+      for (size_t x=3; x<SIZE_X-3; x++) {
+        for (size_t c=0; c<3; c++) {
+          double value = pOut[pixelIndex(NDColorModeRGB3, x, y, c, SIZE_X, SIZE_Y)];
+          if (method == NDColorConvertBayerNearest) {
+            if ((fabs(value - pIn[x + SIZE_X*y]) > 3. + 5.) || (bayerColor(pattern, x, y) == (int)c &&
+                 value != pIn[x + SIZE_X*y])) errors++;
+          } else {
+            if (fabs(value - pIn[x + SIZE_X*y]) > 1e-9) errors++;
+          }
+        }
+      }
+    }
+    BOOST_CHECK_MESSAGE(errors == 0, "method=" << method << " errors=" << errors);
+  }
+  pArray->release();
+}
+
+BOOST_AUTO_TEST_CASE(test_BayerEdge)
+{
+  // At a vertical edge the edge-aware method interpolates green along the edge
+  // while bilinear interpolation blurs it
+  int pattern = NDBayerRGGB;
+  NDArray *pArray = createArray(NDColorModeBayer, NDUInt8, SIZE_X, SIZE_Y);
+  pArray->pAttributeList->add("BayerPattern", "Bayer pattern", NDAttrInt32, &pattern);
+  epicsUInt8 *pIn = (epicsUInt8 *)pArray->pData;
+  for (size_t y=0; y<SIZE_Y; y++) {
+    for (size_t x=0; x<SIZE_X; x++) pIn[x + SIZE_X*y] = (x < SIZE_X/2) ? 20 : 220;
+  }
+  double error[3];
+  for (int method=NDColorConvertBayerNearest; method<=NDColorConvertBayerEdgeAware; method++) {
+    colorConvert->write(NDPluginColorConvertBayerMethodString, method);
+    convert(pArray, NDColorModeRGB1);
+    epicsUInt8 *pOut = (epicsUInt8 *)colorConvertOutput->pData;
+    error[method] = 0;
+    for (size_t y=2; y<SIZE_Y-2; y++) {
+      for (size_t x=2; x<SIZE_X-2; x++) {
+        error[method] += fabs((double)pOut[pixelIndex(NDColorModeRGB1, x, y, 1, SIZE_X, SIZE_Y)] - pIn[x + SIZE_X*y]);
+      }
+    }
+  }
+  BOOST_MESSAGE("green errors nearest=" << error[0] << " bilinear=" << error[1] << " edge-aware=" << error[2]);
+  BOOST_CHECK_EQUAL(error[NDColorConvertBayerEdgeAware], 0);
+  BOOST_CHECK(error[NDColorConvertBayerBilinear] > 0);
+  pArray->release();
+}
+
+BOOST_AUTO_TEST_CASE(test_YUV)
+{
+  int yuvModes[3] = {NDColorModeYUV444, NDColorModeYUV422, NDColorModeYUV411};
+  int bytesPerCell[3] = {3, 4, 6};
+  int pixelsPerCell[3] = {1, 2, 4};
+  static const int yOffsets[3][4] = {{1, 0, 0, 0}, {1, 3, 0, 0}, {1, 2, 4, 5}};
+  static const int vOffsets[3] = {2, 2, 3};
+  const size_t cells = 12;
+
+  for (int mode=0; mode<3; mode++) {
+    size_t xSize = cells*pixelsPerCell[mode];
+    NDArray *pArray = createArray(yuvModes[mode], NDUInt8, cells*bytesPerCell[mode], SIZE_Y);
+    epicsUInt8 *pIn = (epicsUInt8 *)pArray->pData;
+    for (size_t i=0; i<cells*bytesPerCell[mode]*SIZE_Y; i++) pIn[i] = (epicsUInt8)((i*37) % 256);
+
+    for (int out=0; out<2; out++) {
+      int colorModeOut = out ? NDColorModeRGB2 : NDColorModeMono;
+      NDArrayInfo_t info;
+      size_t errors = 0;
+
+      convert(pArray, colorModeOut);
+      colorConvertOutput->getInfo(&info);
+      BOOST_CHECK_EQUAL(info.colorMode, colorModeOut);
+      BOOST_CHECK_EQUAL(info.xSize, xSize);
+      BOOST_CHECK_EQUAL(info.ySize, SIZE_Y);
+      epicsUInt8 *pOut = (epicsUInt8 *)colorConvertOutput->pData;
+      for (size_t y=0; y<SIZE_Y; y++) {
+        for (size_t x=0; x<xSize; x++) {
+          epicsUInt8 *pCell = pIn + y*cells*bytesPerCell[mode] + (x/pixelsPerCell[mode])*bytesPerCell[mode];
+          double Y = pCell[yOffsets[mode][x % pixelsPerCell[mode]]];
+          double U = pCell[0] - 128.;
+          double V = pCell[vOffsets[mode]] - 128.;
+          if (colorModeOut == NDColorModeMono) {
+            if (pOut[x + xSize*y] != Y) errors++;
+            continue;
+          }
+          double rgb[3] = {Y + 1.402*V, Y - 0.344136*U - 0.714136*V, Y + 1.772*U};
+          for (size_t c=0; c<3; c++) {
+            double expected = rgb[c] < 0 ? 0 : rgb[c] > 255 ? 255 : rgb[c];
+            if (fabs(pOut[pixelIndex(colorModeOut, x, y, c, xSize, SIZE_Y)] - expected) > 1.) errors++;
+          }
+        }
+      }
+      BOOST_CHECK_MESSAGE(errors == 0, "yuvMode=" << yuvModes[mode] << " colorModeOut=" << colorModeOut
+                                       << " errors=" << errors);
+    }
+    pArray->release();
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_TileThreads)
+{
+  // Converting with several threads gives the same result as with one
+  int pattern = NDBayerBGGR;
+  const size_t xSize = 301, ySize = 203;
+  NDArray *pArray = createArray(NDColorModeBayer, NDUInt16, xSize, ySize);
+  pArray->pAttributeList->add("BayerPattern", "Bayer pattern", NDAttrInt32, &pattern);
+  epicsUInt16 *pIn = (epicsUInt16 *)pArray->pData;
+  for (size_t i=0; i<xSize*ySize; i++) pIn[i] = (epicsUInt16)((i*2654435761u) >> 20);
+  std::vector<epicsUInt16> first(3*xSize*ySize);
+
+  colorConvert->write(NDPluginColorConvertBayerMethodString, (int)NDColorConvertBayerEdgeAware);
+  for (int threads=1; threads<=4; threads+=3) {
+    colorConvert->write(NDPluginColorConvertTileThreadsString, threads);
+    convert(pArray, NDColorModeRGB1);
+    epicsUInt16 *pOut = (epicsUInt16 *)colorConvertOutput->pData;
+    if (threads == 1) {
+      memcpy(&first[0], pOut, first.size()*sizeof(epicsUInt16));
+    } else {
+      BOOST_CHECK(memcmp(&first[0], pOut, first.size()*sizeof(epicsUInt16)) == 0);
+    }
+  }
+  pArray->release();
+}
+
+BOOST_AUTO_TEST_CASE(test_NoConversionIsView)
+{
+  NDArray *pArray = createArray(NDColorModeRGB1, NDUInt8, SIZE_X, SIZE_Y);
+
+  convert(pArray, NDColorModeRGB1);
+  BOOST_CHECK(colorConvertOutput != pArray);
+  BOOST_CHECK_EQUAL(colorConvertOutput->pData, pArray->pData);
+  BOOST_CHECK_EQUAL(colorConvertOutput->pViewParent, pArray);
+
+  colorConvertOutput->release();
+  colorConvertOutput = 0;
+  pArray->release();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
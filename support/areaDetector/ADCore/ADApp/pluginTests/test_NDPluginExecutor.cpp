@@ -0,0 +1,278 @@
+/*
+ * test_NDPluginExecutor.cpp
+ *
+ * Tests plugins running on the shared NDPluginExecutor.
+ * Each test configures the executor and shuts it down again when its plugins have been
+ * deleted, so plugins created by other tests use their own threads.
+ */
+
+#include <stdio.h>
+
+
+#include "boost/test/unit_test.hpp"
+
+// AD dependencies
+#include <NDPluginDriver.h>
+#include <NDPluginExecutor.h>
+#include <NDArray.h>
+#include <asynDriver.h>
+
+#include <string.h>
+#include <stdint.h>
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <epicsMutex.h>
+#include <epicsThread.h>
+#include <epicsAtomic.h>
+#include <asynPortClient.h>
+using namespace std;
+
+#include "testingutilities.h"
+#include "ROIPluginWrapper.h"
+
+#define NUM_ARRAYS 100
+
+static epicsMutexId outputLock;
+static std::vector<int> outputIds;
+
+static void Executor_callback(void *userPvt, asynUser *pasynUser, void *pointer)
+{
+  NDArray *pArray = (NDArray *)pointer;
+  epicsMutexLock(outputLock);
+  outputIds.push_back(pArray->uniqueId);
+  epicsMutexUnlock(outputLock);
+}
+
+static size_t numOutput()
+{
+  size_t num;
+  epicsMutexLock(outputLock);
+  num = outputIds.size();
+  epicsMutexUnlock(outputLock);
+  return num;
+}
+
+// Plugin that holds each array until released, and records how many are held at once
+class SlowPlugin : public NDPluginDriver {
+public:
+  SlowPlugin(const char *portName, const char *NDArrayPort)
+    : NDPluginDriver(portName, NUM_ARRAYS, 0, NDArrayPort, 0, 1, 0, 0,
+                     asynGenericPointerMask, asynGenericPointerMask, 0, 1, 0, 0, 4),
+      numActive(0), maxActive(0), released(0)
+  {
+    connectToArrayPort();
+  }
+
+  void processCallbacks(NDArray *pArray)
+  {
+    int active;
+
+    NDPluginDriver::beginProcessCallbacks(pArray);
+    this->unlock();
+    active = epicsAtomicIncrIntT(&numActive);
+    epicsMutexLock(outputLock);
+    if (active > maxActive) maxActive = active;
+    epicsMutexUnlock(outputLock);
+    while (!epicsAtomicGetIntT(&released)) epicsThreadSleep(0.01);
+    epicsAtomicDecrIntT(&numActive);
+    epicsMutexLock(outputLock);
+    outputIds.push_back(pArray->uniqueId);
+    epicsMutexUnlock(outputLock);
+    this->lock();
+  }
+
+  // Waits up to 1 second for the number of held arrays to reach num, and returns it
+  int waitActive(int num)
+  {
+    for (int i=0; (i<100) && (epicsAtomicGetIntT(&numActive) != num); i++) {
+      epicsThreadSleep(0.01);
+    }
+    return epicsAtomicGetIntT(&numActive);
+  }
+
+  int numActive;
+  int maxActive;
+  int released;
+};
+
+struct ExecutorPluginTestFixture
+{
+  boost::shared_ptr<asynNDArrayDriver> driver;
+  boost::shared_ptr<ROIPluginWrapper> roi;
+  boost::shared_ptr<asynGenericPointerClient> client;
+  std::string simport;
+  std::string testport;
+
+  ExecutorPluginTestFixture()
+  {
+    simport = "simExec";
+    testport = "Exec";
+    uniqueAsynPortName(simport);
+    uniqueAsynPortName(testport);
+
+    BOOST_REQUIRE_EQUAL(NDPluginExecutor::configure(2, 0, 0), 0);
+    if (!outputLock) outputLock = epicsMutexMustCreate();
+    epicsMutexLock(outputLock);
+    outputIds.clear();
+    epicsMutexUnlock(outputLock);
+
+    driver = boost::shared_ptr<asynNDArrayDriver>(new asynNDArrayDriver(simport.c_str(),
+                                                                     1, 0, 0,
+                                                                     asynGenericPointerMask,
+                                                                     asynGenericPointerMask,
+                                                                     0, 0, 0, 0));
+
+    // Non-blocking plugin with a queue large enough that no arrays are dropped
+    roi = boost::shared_ptr<ROIPluginWrapper>(new ROIPluginWrapper(testport.c_str(),
+                                                                   NUM_ARRAYS,
+                                                                   0,
+                                                                   simport.c_str(),
+                                                                   0,
+                                                                   0,
+                                                                   0,
+                                                                   0,
+                                                                   4));
+    roi->start();
+    roi->write(NDPluginDriverEnableCallbacksString, 1);
+    roi->write(NDArrayCallbacksString, 1);
+
+    client = boost::shared_ptr<asynGenericPointerClient>(new asynGenericPointerClient(testport.c_str(), 0, NDArrayDataString));
+    client->registerInterruptUser(&Executor_callback);
+  }
+
+  ~ExecutorPluginTestFixture()
+  {
+    client.reset();
+    roi.reset();
+    driver.reset();
+    NDPluginExecutor::shutdown();
+  }
+
+  void sendArrays()
+  {
+    size_t dims[2] = {64, 64};
+    int arrayData;
+    int i;
+
+    driver->findParam(NDArrayDataString, &arrayData);
+    for (i=0; i<NUM_ARRAYS; i++) {
+      NDArray *pArray = driver->pNDArrayPool->alloc(2, dims, NDUInt8, 0, NULL);
+      memset(pArray->pData, i, pArray->dataSize);
+      pArray->uniqueId = i;
+      driver->doCallbacksGenericPointer(pArray, arrayData, 0);
+      pArray->release();
+    }
+    // Wait for the executor to process all arrays
+    for (i=0; (i<100) && (numOutput() < NUM_ARRAYS); i++) {
+      epicsThreadSleep(0.05);
+    }
+  }
+
+  void checkHistograms()
+  {
+    epicsInt32 hist[ND_PLUGIN_HIST_BINS];
+    const char *params[2] = {NDPluginDriverQueueLatencyHistString, NDPluginDriverExecutionTimeHistString};
+    size_t nIn;
+    int i, j;
+
+    for (i=0; i<2; i++) {
+      asynInt32ArrayClient histClient(testport.c_str(), 0, params[i]);
+      int total = 0;
+      BOOST_REQUIRE_EQUAL(histClient.read(hist, ND_PLUGIN_HIST_BINS, &nIn), asynSuccess);
+      BOOST_REQUIRE_EQUAL(nIn, ND_PLUGIN_HIST_BINS);
+      for (j=0; j<ND_PLUGIN_HIST_BINS; j++) total += hist[j];
+      BOOST_CHECK_EQUAL(total, NUM_ARRAYS);
+    }
+  }
+};
+
+BOOST_FIXTURE_TEST_SUITE(ExecutorPluginTests, ExecutorPluginTestFixture)
+
+BOOST_AUTO_TEST_CASE(test_ExecutorOrdered)
+{
+  std::string threadName = testport + "_Plugin_1";
+
+  // The plugin uses the executor rather than its own thread
+  BOOST_CHECK(epicsThreadGetId(threadName.c_str()) == 0);
+
+  // With NumThreads=1 arrays are processed one at a time in order
+  sendArrays();
+  BOOST_REQUIRE_EQUAL(numOutput(), NUM_ARRAYS);
+  BOOST_CHECK_EQUAL(roi->readInt(NDPluginDriverDroppedArraysString), 0);
+  for (int i=0; i<NUM_ARRAYS; i++) {
+    BOOST_CHECK_EQUAL(outputIds[i], i);
+  }
+  checkHistograms();
+  NDPluginExecutor::getInstance()->report(stdout, 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_ExecutorParallel)
+{
+  // With NumThreads>1 arrays may be processed concurrently and out of order
+  roi->write(NDPluginDriverNumThreadsString, 4);
+  BOOST_CHECK_EQUAL(roi->readInt(NDPluginDriverNumThreadsString), 4);
+  sendArrays();
+  BOOST_REQUIRE_EQUAL(numOutput(), NUM_ARRAYS);
+  BOOST_CHECK_EQUAL(roi->readInt(NDPluginDriverDroppedArraysString), 0);
+  checkHistograms();
+}
+
+BOOST_AUTO_TEST_CASE(test_ExecutorConcurrent)
+{
+  // An array that arrives while another is being processed starts at once, rather than when
+  // the queue has more arrays than are being processed, and no more than NumThreads arrays are
+  // processed at once when the executor has more threads
+  std::string port("ExecSlow");
+  size_t dims[2] = {16, 16};
+  int arrayData;
+  uniqueAsynPortName(port);
+  client.reset();
+  roi.reset();
+  NDPluginExecutor::shutdown();
+  BOOST_REQUIRE_EQUAL(NDPluginExecutor::configure(4, 0, 0), 0);
+
+  SlowPlugin slow(port.c_str(), simport.c_str());
+  slow.start();
+  asynInt32Client enable(port.c_str(), 0, NDPluginDriverEnableCallbacksString);
+  asynInt32Client numThreads(port.c_str(), 0, NDPluginDriverNumThreadsString);
+  enable.write(1);
+  numThreads.write(2);
+
+  driver->findParam(NDArrayDataString, &arrayData);
+  for (int i=0; i<3; i++) {
+    NDArray *pArray = driver->pNDArrayPool->alloc(2, dims, NDUInt8, 0, NULL);
+    pArray->uniqueId = i;
+    driver->doCallbacksGenericPointer(pArray, arrayData, 0);
+    pArray->release();
+    if (i < 2) {
+      BOOST_CHECK_EQUAL(slow.waitActive(i+1), i+1);
+    }
+  }
+  epicsThreadSleep(0.2);
+  BOOST_CHECK_EQUAL(slow.numActive, 2);
+  epicsAtomicSetIntT(&slow.released, 1);
+  for (int i=0; (i<100) && (numOutput() < 3); i++) {
+    epicsThreadSleep(0.05);
+  }
+  BOOST_REQUIRE_EQUAL(numOutput(), (size_t)3);
+  BOOST_CHECK_EQUAL(slow.maxActive, 2);
+}
+
+BOOST_AUTO_TEST_CASE(test_ExecutorShutdown)
+{
+  // A plugin created after the executor is shut down uses its own thread
+  std::string port("ExecShutdown");
+  uniqueAsynPortName(port);
+  client.reset();
+  roi.reset();
+  NDPluginExecutor::shutdown();
+  BOOST_CHECK(NDPluginExecutor::getInstance() == 0);
+
+  ROIPluginWrapper own(port.c_str(), 10, 0, simport.c_str(), 0, 0, 0, 0, 1);
+  own.start();
+  std::string threadName = port + "_Plugin_1";
+  BOOST_CHECK(epicsThreadGetId(threadName.c_str()) != 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -18,6 +18,7 @@
 
 #include <string.h>
 #include <stdint.h>
+#include <math.h>
 
 #include <deque>
 #include <boost/shared_ptr.hpp>
@@ -28,6 +29,11 @@ using namespace std;
 #include "testingutilities.h"
 #include "FFTPluginWrapper.h"
 #include "AsynException.h"
+#include "NDFFTPlan.h"
+
+#ifndef M_PI
+  #define M_PI 3.14159265358979323846
+#endif
 
 
 static int callbackCount = 0;
@@ -192,7 +198,167 @@ BOOST_AUTO_TEST_CASE(basic_1D_operation)
   BOOST_REQUIRE_GT(downstream_plugin->arrays.size(), (size_t)0);
   BOOST_REQUIRE_EQUAL(downstream_plugin->arrays[0]->ndims, 1);
   for (int i=0; i<200; i++) {
-    BOOST_REQUIRE_EQUAL(downstream_plugin->arrays[i]->dims[0].size, (size_t)16);
+    BOOST_REQUIRE_EQUAL(downstream_plugin->arrays[i]->dims[0].size, (size_t)10);
+  }
+}
+
+// Reference DFT of n complex points in long double precision
+static void referenceDFT(const std::vector<double> &in, std::vector<double> &out)
+{
+  size_t n = in.size()/2;
+  out.assign(2*n, 0.);
+  for (size_t k=0; k<n; k++) {
+    long double re = 0, im = 0;
+    for (size_t j=0; j<n; j++) {
+      long double theta = -2.0L * M_PI * (long double)((j*k) % n) / n;
+      re += in[2*j]*cosl(theta) - in[2*j+1]*sinl(theta);
+      im += in[2*j]*sinl(theta) + in[2*j+1]*cosl(theta);
+    }
+    out[2*k]   = (double)re;
+    out[2*k+1] = (double)im;
+  }
+}
+
+template <typename T>
+static void checkPlan(size_t n, double tolerance)
+{
+  std::vector<double> in(2*n), ref;
+  std::vector<T> data(2*n), realIn(n), realOut(2*(n/2+1));
+  double maxError = 0, maxValue = 0;
+  size_t k;
+
+  for (k=0; k<n; k++) {
+    in[2*k]   = sin(0.37*k) + 0.1*(k % 7);
+    in[2*k+1] = cos(0.11*k*k);
+  }
+  for (k=0; k<2*n; k++) data[k] = (T)in[k];
+  referenceDFT(in, ref);
+  for (k=0; k<2*n; k++) maxValue = std::max(maxValue, fabs(ref[k]));
+
+  NDFFTPlan<T> complexPlan(n, false);
+  std::vector<T> work(complexPlan.getWorkSize() + 1);
+  complexPlan.forward(&data[0], &work[0]);
+  for (k=0; k<2*n; k++) maxError = std::max(maxError, fabs(data[k] - ref[k]));
+  BOOST_CHECK_MESSAGE(maxError <= tolerance*maxValue, "complex n=" << n << " error=" << maxError/maxValue);
+
+  // The real part alone
+  for (k=0; k<n; k++) {
+    in[2*k+1] = 0.;
+    realIn[k] = (T)in[2*k];
+  }
+  referenceDFT(in, ref);
+  NDFFTPlan<T> realPlan(n, true);
+  work.resize(realPlan.getWorkSize() + 1);
+  realPlan.forwardReal(&realIn[0], &realOut[0], &work[0]);
+  maxError = 0;
+  for (k=0; k<2*(n/2+1); k++) maxError = std::max(maxError, fabs(realOut[k] - ref[k]));
+  BOOST_CHECK_MESSAGE(maxError <= tolerance*maxValue, "real n=" << n << " error=" << maxError/maxValue);
+}
+
+BOOST_AUTO_TEST_CASE(plan_accuracy)
+{
+  // Powers of 2, mixed radix, generic odd radix, and Bluestein (67, 2*101, 1009)
+  size_t sizes[] = {1, 2, 3, 4, 5, 6, 7, 8, 12, 15, 16, 20, 30, 49, 60, 64, 67, 100, 121, 128, 202, 210, 1000, 1009, 1024};
+
+  for (size_t i=0; i<sizeof(sizes)/sizeof(sizes[0]); i++) {
+    checkPlan<epicsFloat64>(sizes[i], 1e-12);
+    checkPlan<epicsFloat32>(sizes[i], 1e-5);
+  }
+}
+
+// Sends a 2-D cosine with frequencies fx, fy and returns the FFT array
+static NDArray *send2D(FFTPluginWrapper *fft, TestingPlugin *downstream, NDArrayPool *pool,
+                       NDDataType_t dataType, int nx, int ny, int fx, int fy)
+{
+  size_t dims[2] = {(size_t)nx, (size_t)ny};
+  NDArray *pArray = pool->alloc(2, dims, dataType, 0, NULL);
+  for (int y=0; y<ny; y++) {
+    for (int x=0; x<nx; x++) {
+      double value = 10. + cos(2.*M_PI*(fx*x/(double)nx + fy*y/(double)ny));
+      if (dataType == NDFloat32) ((epicsFloat32 *)pArray->pData)[y*nx + x] = (epicsFloat32)value;
+      else ((epicsFloat64 *)pArray->pData)[y*nx + x] = value;
+    }
+  }
+  fft->lock();
+  fft->processCallbacks(pArray);
+  fft->unlock();
+  pArray->release();
+  return downstream->arrays.back();
+}
+
+BOOST_AUTO_TEST_CASE(mixed_radix_2D)
+{
+  // Sizes that are not powers of 2 are not padded; a cosine is a single peak of 0.5
+  const int nx = 60, ny = 45, fx = 7, fy = 4;
+  NDDataType_t dataTypes[] = {NDFloat64, NDFloat32};
+  int rowThreads[] = {1, 3};
+
+  fft->write(FFTNumAverageString, 1);
+  fft->write(NDArrayCallbacksString, 1);
+  for (int t=0; t<2; t++) {
+    for (int r=0; r<2; r++) {
+      fft->write(FFTRowThreadsString, rowThreads[r]);
+      NDArray *pOut = send2D(fft.get(), downstream_plugin, arrayPool, dataTypes[t], nx, ny, fx, fy);
+      BOOST_REQUIRE_EQUAL(pOut->ndims, 2);
+      BOOST_REQUIRE_EQUAL(pOut->dims[0].size, (size_t)nx/2);
+      BOOST_REQUIRE_EQUAL(pOut->dims[1].size, (size_t)ny/2);
+      double *pData = (double *)pOut->pData;
+      for (int y=0; y<ny/2; y++) {
+        for (int x=0; x<nx/2; x++) {
+          double expected = 0.;
+          if ((x == 0) && (y == 0)) expected = 10.;
+          if ((x == fx) && (y == fy)) expected = 0.5;
+          BOOST_CHECK_SMALL(pData[y*(nx/2) + x] - expected, 1e-4);
+        }
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(window_function)
+{
+  // Windows are scaled to an average of 1, so a constant is unchanged at DC.
+  // A Hann window spreads it into the first bin, and leaves nothing in the others.
+  const int n = 50;
+  size_t dims[1] = {n};
+  NDArray *pArray = arrayPool->alloc(1, dims, NDFloat64, 0, NULL);
+  for (int i=0; i<n; i++) ((epicsFloat64 *)pArray->pData)[i] = 2.;
+
+  fft->write(FFTNumAverageString, 1);
+  fft->write(NDArrayCallbacksString, 1);
+  fft->write(FFTWindowString, 1);
+  BOOST_CHECK_EQUAL(fft->readInt(FFTWindowString), 1);
+  fft->lock();
+  fft->processCallbacks(pArray);
+  fft->unlock();
+  pArray->release();
+  double *pData = (double *)downstream_plugin->arrays.back()->pData;
+  BOOST_CHECK_CLOSE(pData[0], 2., 1e-9);
+  BOOST_CHECK_CLOSE(pData[1], 1., 1e-9);
+  for (int i=2; i<n/2; i++) {
+    BOOST_CHECK_SMALL(pData[i], 1e-12);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(many_sizes)
+{
+  // More sizes than FFT_MAX_CACHED, twice, so plans and windows are deleted and created again
+  fft->write(FFTNumAverageString, 1);
+  fft->write(NDArrayCallbacksString, 1);
+  fft->write(FFTWindowString, 1);
+  for (int pass=0; pass<2; pass++) {
+    for (int n=20; n<20+FFT_MAX_CACHED+4; n++) {
+      size_t dims[1] = {(size_t)n};
+      NDArray *pArray = arrayPool->alloc(1, dims, NDFloat64, 0, NULL);
+      for (int i=0; i<n; i++) ((epicsFloat64 *)pArray->pData)[i] = 2.;
+      fft->lock();
+      fft->processCallbacks(pArray);
+      fft->unlock();
+      pArray->release();
+      double *pData = (double *)downstream_plugin->arrays.back()->pData;
+      BOOST_CHECK_CLOSE(pData[0], 2., 1e-9);
+      BOOST_CHECK_CLOSE(pData[1], 1., 1e-9);
+    }
   }
 }
 
@@ -0,0 +1,188 @@
+/*
+ * test_NDPluginGather.cpp
+ *
+ * Checks that arrays from several ports are passed on in UniqueId order with SortMode=1,
+ * and the counts of arrays received and dropped from each port.
+ */
+
+#include <stdio.h>
+
+
+#include "boost/test/unit_test.hpp"
+
+// AD dependencies
+#include <NDPluginDriver.h>
+#include <NDArray.h>
+#include <asynDriver.h>
+#include <epicsMutex.h>
+#include <epicsThread.h>
+
+#include <string.h>
+#include <stdint.h>
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+using namespace std;
+
+#include "testingutilities.h"
+#include "GatherPluginWrapper.h"
+
+static epicsMutexId outputLock;
+static std::vector<int> outputIds;
+
+static void outputCallback(void *userPvt, asynUser *pasynUser, void *pointer)
+{
+  NDArray *pArray = (NDArray *)pointer;
+  epicsMutexLock(outputLock);
+  outputIds.push_back(pArray->uniqueId);
+  epicsMutexUnlock(outputLock);
+}
+
+static std::vector<int> output()
+{
+  epicsMutexLock(outputLock);
+  std::vector<int> ids = outputIds;
+  epicsMutexUnlock(outputLock);
+  return ids;
+}
+
+struct GatherPluginTestFixture
+{
+  boost::shared_ptr<asynNDArrayDriver> driver[2];
+  boost::shared_ptr<GatherPluginWrapper> gather;
+  boost::shared_ptr<asynGenericPointerClient> client;
+
+  GatherPluginTestFixture()
+  {
+    if (!outputLock) outputLock = epicsMutexMustCreate();
+    epicsMutexLock(outputLock);
+    outputIds.clear();
+    epicsMutexUnlock(outputLock);
+
+    for (int i=0; i<2; i++) {
+      std::string simport("simGather");
+      uniqueAsynPortName(simport);
+      driver[i] = boost::shared_ptr<asynNDArrayDriver>(new asynNDArrayDriver(simport.c_str(),
+                                                                          1, 0, 0,
+                                                                          asynGenericPointerMask,
+                                                                          asynGenericPointerMask,
+                                                                          0, 0, 0, 0));
+    }
+  }
+
+  ~GatherPluginTestFixture()
+  {
+    client.reset();
+    gather.reset();
+    driver[0].reset();
+    driver[1].reset();
+  }
+
+  void createGather(int queueSize, int blocking)
+  {
+    std::string testport("Gather");
+    uniqueAsynPortName(testport);
+    gather = boost::shared_ptr<GatherPluginWrapper>(new GatherPluginWrapper(testport.c_str(), queueSize, blocking, 2));
+    for (int i=0; i<2; i++) {
+      gather->write(NDPluginDriverArrayPortString, std::string(driver[i]->portName), i);
+    }
+    gather->write(NDPluginDriverEnableCallbacksString, 1);
+    gather->write(NDArrayCallbacksString, 1);
+    client = boost::shared_ptr<asynGenericPointerClient>(new asynGenericPointerClient(testport.c_str(), 0, NDArrayDataString));
+    client->registerInterruptUser(&outputCallback);
+  }
+
+  void sendArray(int source, int uniqueId, const char *codec = "")
+  {
+    size_t dims[2] = {16, 8};
+    int arrayData;
+
+    driver[source]->findParam(NDArrayDataString, &arrayData);
+    NDArray *pArray = driver[source]->pNDArrayPool->alloc(2, dims, NDUInt8, 0, NULL);
+    memset(pArray->pData, 0, pArray->dataSize);
+    pArray->uniqueId = uniqueId;
+    pArray->codec.name = codec;
+    if (pArray->codec.name.size()) pArray->compressedSize = 20;
+    driver[source]->doCallbacksGenericPointer(pArray, arrayData, 0);
+    pArray->release();
+  }
+};
+
+BOOST_FIXTURE_TEST_SUITE(GatherPluginTests, GatherPluginTestFixture)
+
+BOOST_AUTO_TEST_CASE(test_Sorted)
+{
+  createGather(50, 1);
+  gather->write(NDPluginDriverSortTimeString, 0.2);
+  gather->write(NDPluginDriverSortSizeString, 10);
+  gather->write(NDPluginDriverSortModeString, 1);
+
+  // The first array waits for SortTime, the others are passed on as soon as they are in order
+  const int ids[] = {1, 3, 2, 5, 4};
+  for (int i=0; i<5; i++) sendArray(i % 2, ids[i]);
+  BOOST_CHECK_EQUAL(output().size(), 0);
+  epicsThreadSleep(0.5);
+  std::vector<int> ids1 = output();
+  BOOST_REQUIRE_EQUAL(ids1.size(), 5);
+  for (int i=0; i<5; i++) BOOST_CHECK_EQUAL(ids1[i], i+1);
+
+  sendArray(0, 7);
+  sendArray(1, 6);
+  std::vector<int> ids2 = output();
+  BOOST_REQUIRE_EQUAL(ids2.size(), 7);
+  BOOST_CHECK_EQUAL(ids2[5], 6);
+  BOOST_CHECK_EQUAL(ids2[6], 7);
+  BOOST_CHECK_EQUAL(gather->readInt(NDPluginDriverDisorderedArraysString), 0);
+
+  // When more than SortSize arrays are waiting the first is passed on even though an array is missing
+  gather->write(NDPluginDriverSortSizeString, 2);
+  sendArray(0, 10);
+  sendArray(1, 11);
+  sendArray(0, 12);
+  std::vector<int> ids3 = output();
+  BOOST_REQUIRE_EQUAL(ids3.size(), 10);
+  BOOST_CHECK_EQUAL(ids3[7], 10);
+  BOOST_CHECK_EQUAL(ids3[8], 11);
+  BOOST_CHECK_EQUAL(ids3[9], 12);
+  BOOST_CHECK_EQUAL(gather->readInt(NDPluginDriverDisorderedArraysString), 1);
+  BOOST_CHECK_EQUAL(gather->readInt(NDPluginDriverDroppedOutputArraysString), 0);
+
+  BOOST_CHECK_EQUAL(gather->readInt(NDPluginGatherArraysString, 0), 6);
+  BOOST_CHECK_EQUAL(gather->readInt(NDPluginGatherArraysString, 1), 4);
+  BOOST_CHECK_EQUAL(gather->readInt(NDPluginGatherDroppedArraysString, 0), 0);
+  BOOST_CHECK_EQUAL(gather->readInt(NDPluginGatherDroppedArraysString, 1), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_SourceCounts)
+{
+  // The plugin is not started, so only the first 2 arrays fit in the queue
+  createGather(2, 0);
+  for (int i=0; i<3; i++) sendArray(0, i);
+  for (int i=0; i<2; i++) sendArray(1, 3+i);
+
+  BOOST_CHECK_EQUAL(gather->readInt(NDPluginGatherArraysString, 0), 3);
+  BOOST_CHECK_EQUAL(gather->readInt(NDPluginGatherArraysString, 1), 2);
+  BOOST_CHECK_EQUAL(gather->readInt(NDPluginGatherDroppedArraysString, 0), 1);
+  BOOST_CHECK_EQUAL(gather->readInt(NDPluginGatherDroppedArraysString, 1), 2);
+  BOOST_CHECK_EQUAL(gather->readInt(NDPluginDriverDroppedArraysString), 3);
+
+  // The queued arrays must be processed before the plugin is deleted
+  gather->start();
+  for (int i=0; (i<100) && (output().size() < 2); i++) epicsThreadSleep(0.01);
+  BOOST_CHECK_EQUAL(output().size(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(test_Compressed)
+{
+  // Compressed arrays are passed on like any other
+  createGather(10, 1);
+  sendArray(0, 1, "zlib");
+  sendArray(1, 2, "blosc");
+  std::vector<int> ids = output();
+  BOOST_REQUIRE_EQUAL(ids.size(), 2);
+  BOOST_CHECK_EQUAL(ids[0], 1);
+  BOOST_CHECK_EQUAL(ids[1], 2);
+  BOOST_CHECK_EQUAL(gather->readInt(NDPluginDriverDroppedArraysString), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -28,6 +28,7 @@ using namespace std;
 #include "testingutilities.h"
 #include "OverlayPluginWrapper.h"
 #include "AsynException.h"
+#include "NDPluginOverlayTextFont.h"
 
 
 static int callbackCount = 0;
@@ -39,6 +40,15 @@ void Overlay_callback(void *userPvt, asynUser *pasynUser, void *pointer)
   callbackCount++;
 }
 
+// A copy of the data of the last array from the plugin
+static std::vector<char> outputData;
+
+static void copyOutputCallback(void *userPvt, asynUser *pasynUser, void *pointer)
+{
+  NDArray *pArray = (NDArray *)pointer;
+  outputData.assign((char *)pArray->pData, (char *)pArray->pData + pArray->dataSize);
+}
+
 // We define 2 structures here.  
 // overlayTempCaseStr uses fixed length arrays so it can be easily initialized
 // and we need to initialize many cases
@@ -117,6 +127,7 @@ struct OverlayPluginTestFixture
   TestingPlugin* downstream_plugin; // TODO: we don't put this in a shared_ptr and purposefully leak memory because asyn ports cannot be deleted
   std::vector<overlayTestCaseStr> overlayTestCaseStrs;
   int expectedArrayCounter;
+  std::string overlayPort;
   
 
   static int testCase;
@@ -130,6 +141,7 @@ struct OverlayPluginTestFixture
     std::string simport("simOVER1"), testport("OVER1");
     uniqueAsynPortName(simport);
     uniqueAsynPortName(testport);
+    overlayPort = testport;
 
     // We need some upstream driver for our test plugin so that calls to connectArrayPort
     // don't fail, but we can then ignore it and send arrays by calling processCallbacks directly.
@@ -199,6 +211,30 @@ struct OverlayPluginTestFixture
     //delete downstream_plugin; // TODO: We can't delete a TestingPlugin because it tries to delete an asyn port which doesnt work
   }
 
+  void setOverlay(int overlay, NDOverlayShape_t shape, NDOverlayDrawMode_t drawMode,
+                  int positionX, int positionY, int sizeX, int sizeY, int widthX, int widthY, int value)
+  {
+    Overlay->write(NDPluginOverlayUseString,       1,         overlay);
+    Overlay->write(NDPluginOverlayShapeString,     shape,     overlay);
+    Overlay->write(NDPluginOverlayDrawModeString,  drawMode,  overlay);
+    Overlay->write(NDPluginOverlayPositionXString, positionX, overlay);
+    Overlay->write(NDPluginOverlayPositionYString, positionY, overlay);
+    Overlay->write(NDPluginOverlaySizeXString,     sizeX,     overlay);
+    Overlay->write(NDPluginOverlaySizeYString,     sizeY,     overlay);
+    Overlay->write(NDPluginOverlayWidthXString,    widthX,    overlay);
+    Overlay->write(NDPluginOverlayWidthYString,    widthY,    overlay);
+    Overlay->write(NDPluginOverlayRedString,       value,     overlay);
+    Overlay->write(NDPluginOverlayGreenString,     value,     overlay);
+    Overlay->write(NDPluginOverlayBlueString,      value,     overlay);
+  }
+
+  void process(NDArray *pArray)
+  {
+    Overlay->lock();
+    BOOST_CHECK_NO_THROW(Overlay->processCallbacks(pArray));
+    Overlay->unlock();
+  }
+
 };
 
 BOOST_FIXTURE_TEST_SUITE(OverlayPluginTests, OverlayPluginTestFixture)
@@ -256,4 +292,165 @@ BOOST_AUTO_TEST_CASE(basic_overlay_operation)
 }
 
 
+BOOST_AUTO_TEST_CASE(test_Shapes)
+{
+  const int xSize = 200, ySize = 150;
+  size_t dims[2] = {xSize, ySize};
+  asynGenericPointerClient output(overlayPort.c_str(), 0, NDArrayDataString);
+  output.registerInterruptUser(copyOutputCallback);
+  NDArray *pArray = arrayPool->alloc(2, dims, NDUInt16, 0, NULL);
+  memset(pArray->pData, 0, pArray->dataSize);
+
+  // A rectangle with borders 2 pixels wide and 3 pixels high, and a cross with a vertical line 3 pixels wide
+  setOverlay(0, NDOverlayRectangle, NDOverlaySet, 10, 20, 30, 40, 2, 3, 1000);
+  setOverlay(1, NDOverlayCross, NDOverlaySet, 100, 50, 40, 20, 3, 1, 2000);
+  process(pArray);
+  BOOST_REQUIRE_EQUAL(outputData.size(), pArray->dataSize);
+  epicsUInt16 *pOut = (epicsUInt16 *)&outputData[0];
+  for (int y=0; y<ySize; y++) {
+    for (int x=0; x<xSize; x++) {
+      int expected = 0;
+      if ((x >= 10) && (x <= 40) && (y >= 20) && (y <= 60) &&
+          ((y < 23) || (y > 57) || (x < 12) || (x > 38))) expected = 1000;
+      if ((y >= 50) && (y <= 70) && (y == 60 ? (x >= 100) && (x <= 140) : (x >= 119) && (x <= 121))) expected = 2000;
+      BOOST_REQUIRE_EQUAL(pOut[y*xSize + x], expected);
+    }
+  }
+
+  // Overlays partly outside the array are clipped
+  setOverlay(0, NDOverlayRectangle, NDOverlaySet, -5, 140, 20, 30, 1, 1, 3000);
+  Overlay->write(NDPluginOverlayUseString, 0, 1);
+  process(pArray);
+  pOut = (epicsUInt16 *)&outputData[0];
+  for (int y=0; y<ySize; y++) {
+    for (int x=0; x<xSize; x++) {
+      int expected = (((y == 140) && (x <= 15)) || ((y >= 140) && (x == 15))) ? 3000 : 0;
+      BOOST_REQUIRE_EQUAL(pOut[y*xSize + x], expected);
+    }
+  }
+  pArray->release();
+}
+
+BOOST_AUTO_TEST_CASE(test_XOR)
+{
+  const int xSize = 120, ySize = 100;
+  size_t dims[2] = {xSize, ySize};
+  asynGenericPointerClient output(overlayPort.c_str(), 0, NDArrayDataString);
+  output.registerInterruptUser(copyOutputCallback);
+  NDArray *pArray = arrayPool->alloc(2, dims, NDUInt16, 0, NULL);
+  epicsUInt16 *pIn = (epicsUInt16 *)pArray->pData;
+  for (int i=0; i<xSize*ySize; i++) pIn[i] = (epicsUInt16)(i % 1000);
+
+  // Each pixel of a wide ellipse, where the parametric points repeat, is only inverted once
+  setOverlay(0, NDOverlayEllipse, NDOverlaySet, 10, 10, 90, 70, 6, 6, 5000);
+  process(pArray);
+  std::vector<epicsUInt16> setData((epicsUInt16 *)&outputData[0], (epicsUInt16 *)&outputData[0] + xSize*ySize);
+  Overlay->write(NDPluginOverlayDrawModeString, NDOverlayXOR, 0);
+  Overlay->write(NDPluginOverlayGreenString, 0x0F0F, 0);
+  process(pArray);
+  epicsUInt16 *pOut = (epicsUInt16 *)&outputData[0];
+  int numDrawn = 0;
+  for (int i=0; i<xSize*ySize; i++) {
+    if (setData[i] == 5000) {
+      numDrawn++;
+      BOOST_REQUIRE_EQUAL(pOut[i], pIn[i] ^ 0x0F0F);
+    } else {
+      BOOST_REQUIRE_EQUAL(pOut[i], pIn[i]);
+    }
+  }
+  BOOST_CHECK(numDrawn > 1000);
+
+  // Overlapping overlays are drawn in order
+  setOverlay(0, NDOverlayRectangle, NDOverlaySet, 20, 20, 10, 10, 100, 100, 100);
+  setOverlay(1, NDOverlayRectangle, NDOverlayXOR, 20, 20, 10, 10, 100, 100, 255);
+  process(pArray);
+  pOut = (epicsUInt16 *)&outputData[0];
+  BOOST_CHECK_EQUAL(pOut[25*xSize + 25], 100 ^ 255);
+  Overlay->write(NDPluginOverlayDrawModeString, NDOverlayXOR, 0);
+  Overlay->write(NDPluginOverlayDrawModeString, NDOverlaySet, 1);
+  process(pArray);
+  pOut = (epicsUInt16 *)&outputData[0];
+  BOOST_CHECK_EQUAL(pOut[25*xSize + 25], 255);
+  pArray->release();
+}
+
+BOOST_AUTO_TEST_CASE(test_Text)
+{
+  const int xSize = 100, ySize = 40;
+  size_t dims[2] = {xSize, ySize};
+  // Characters 127 to 159 have no glyph and are blank, 160 to 255 follow 126 in the font bitmaps
+  const char *text = "Ag9~\x85\xe9 x";
+  asynGenericPointerClient output(overlayPort.c_str(), 0, NDArrayDataString);
+  output.registerInterruptUser(copyOutputCallback);
+  NDArray *pArray = arrayPool->alloc(2, dims, NDInt8, 0, NULL);
+  memset(pArray->pData, 0, pArray->dataSize);
+
+  // Compare with the font bitmaps for each font, with the text cut off in the middle of a character
+  for (int font=0; font<NDPluginOverlayTextFontBitmapTypeN; font++) {
+    NDPluginOverlayTextFontBitmapType *bmp = &NDPluginOverlayTextFontBitmaps[font];
+    int bpc = bmp->width/8 + 1;
+    int sizeX = 6*bmp->width + 3;
+    BOOST_MESSAGE("font=" << font);
+    setOverlay(0, NDOverlayText, NDOverlaySet, 5, 7, sizeX, 30, 1, 1, 1);
+    Overlay->write(NDPluginOverlayFontString, font, 0);
+    Overlay->write(NDPluginOverlayDisplayTextString, std::string(text), 0);
+    process(pArray);
+    BOOST_REQUIRE_EQUAL(outputData.size(), pArray->dataSize);
+    for (int y=0; y<ySize; y++) {
+      for (int x=0; x<xSize; x++) {
+        int expected = 0;
+        int jj = y - 7, ii = (x - 5)/bmp->width, ib = (x - 5)%bmp->width;
+        if ((x >= 5) && (x < 5 + sizeX) && (jj >= 0) && (jj < bmp->height)) {
+          int ch = (unsigned char)text[ii];
+          if ((ch < 127) || (ch >= 160)) {
+            int glyph = (ch < 127) ? ch - 32 : ch - 32 - 33;
+            const unsigned char *pRow = &bmp->bitmap[(bmp->height*glyph + jj)*bpc];
+            expected = (pRow[ib/8] & (0x80 >> (ib%8))) ? 1 : 0;
+          }
+        }
+        BOOST_REQUIRE_EQUAL((int)outputData[y*xSize + x], expected);
+      }
+    }
+  }
+  pArray->release();
+}
+
+BOOST_AUTO_TEST_CASE(test_MaskUpdates)
+{
+  const int xSize = 64, ySize = 48;
+  size_t dims[3] = {3, xSize, ySize};
+  asynGenericPointerClient output(overlayPort.c_str(), 0, NDArrayDataString);
+  output.registerInterruptUser(copyOutputCallback);
+  NDArray *pArray = arrayPool->alloc(3, dims, NDUInt8, 0, NULL);
+  NDColorMode_t colorMode = NDColorModeRGB1;
+  pArray->pAttributeList->add("ColorMode", "Color mode", NDAttrInt32, &colorMode);
+  memset(pArray->pData, 0, pArray->dataSize);
+
+  setOverlay(0, NDOverlayCross, NDOverlaySet, 10, 10, 10, 10, 1, 1, 0);
+  Overlay->write(NDPluginOverlayRedString, 10, 0);
+  Overlay->write(NDPluginOverlayGreenString, 20, 0);
+  Overlay->write(NDPluginOverlayBlueString, 30, 0);
+  process(pArray);
+  unsigned char *pOut = (unsigned char *)&outputData[0];
+  BOOST_CHECK_EQUAL(pOut[(15*xSize + 15)*3],     10);
+  BOOST_CHECK_EQUAL(pOut[(15*xSize + 15)*3 + 1], 20);
+  BOOST_CHECK_EQUAL(pOut[(15*xSize + 15)*3 + 2], 30);
+  BOOST_CHECK_EQUAL(pOut[(14*xSize + 14)*3],     0);
+
+  // Unchanged overlays use the same mask, and changes are drawn on the next array
+  process(pArray);
+  pOut = (unsigned char *)&outputData[0];
+  BOOST_CHECK_EQUAL(pOut[(15*xSize + 15)*3], 10);
+  Overlay->write(NDPluginOverlayPositionXString, 30, 0);
+  process(pArray);
+  pOut = (unsigned char *)&outputData[0];
+  BOOST_CHECK_EQUAL(pOut[(15*xSize + 15)*3], 0);
+  BOOST_CHECK_EQUAL(pOut[(15*xSize + 35)*3], 10);
+  Overlay->write(NDPluginOverlayUseString, 0, 0);
+  process(pArray);
+  pOut = (unsigned char *)&outputData[0];
+  for (size_t i=0; i<outputData.size(); i++) BOOST_REQUIRE_EQUAL(pOut[i], 0);
+  pArray->release();
+}
+
 BOOST_AUTO_TEST_SUITE_END() // Done!
@@ -0,0 +1,330 @@
+/*
+ * test_NDPluginProcess.cpp
+ *
+ * Compares the arrays computed by NDPluginProcess with values computed here by doing
+ * each processing step for the whole array in turn, for several input and output
+ * data types and numbers of tile threads.
+ */
+
+#include <stdio.h>
+
+
+#include "boost/test/unit_test.hpp"
+
+// AD dependencies
+#include <NDPluginDriver.h>
+#include <NDArray.h>
+#include <asynDriver.h>
+
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+using namespace std;
+
+#include "testingutilities.h"
+#include "ProcessPluginWrapper.h"
+
+// Not a multiple of the block size, so the last block of each array is partly full
+#define SIZE_X 67
+#define SIZE_Y 45
+#define NUM_ELEMENTS (SIZE_X*SIZE_Y)
+#define NUM_FILTER 3
+#define SCALE_FLAT_FIELD 2.
+#define OFFSET -3.
+#define SCALE 1.5
+#define LOW_CLIP 1.
+#define HIGH_CLIP 120.
+
+static NDArray *processOutput = 0;
+
+static void Process_callback(void *userPvt, asynUser *pasynUser, void *pointer)
+{
+  if (processOutput) processOutput->release();
+  processOutput = (NDArray *)pointer;
+  processOutput->reserve();
+}
+
+template <typename epicsType>
+static void fillArrayT(NDArray *pArray, int frame, int which)
+{
+  epicsType *pData = (epicsType *)pArray->pData;
+  size_t ix, iy;
+
+  for (iy=0; iy<SIZE_Y; iy++) {
+    for (ix=0; ix<SIZE_X; ix++) {
+      double value;
+      switch (which) {
+        case 0:  value = (double)((ix*7 + iy*13 + frame*5) % 120); break;  // data
+        case 1:  value = (double)((ix + iy) % 5); break;                   // background
+        default: value = (double)((ix * iy) % 4); break;                   // flat field, including zeros
+      }
+      pData[iy*SIZE_X + ix] = (epicsType)value;
+    }
+  }
+}
+
+static void fillArray(NDArray *pArray, int frame, int which)
+{
+  switch (pArray->dataType) {
+    case NDInt8:    fillArrayT<epicsInt8>   (pArray, frame, which); break;
+    case NDUInt8:   fillArrayT<epicsUInt8>  (pArray, frame, which); break;
+    case NDInt16:   fillArrayT<epicsInt16>  (pArray, frame, which); break;
+    case NDUInt16:  fillArrayT<epicsUInt16> (pArray, frame, which); break;
+    case NDInt32:   fillArrayT<epicsInt32>  (pArray, frame, which); break;
+    case NDUInt32:  fillArrayT<epicsUInt32> (pArray, frame, which); break;
+    case NDFloat32: fillArrayT<epicsFloat32>(pArray, frame, which); break;
+    case NDFloat64: fillArrayT<epicsFloat64>(pArray, frame, which); break;
+    default: break;
+  }
+}
+
+template <typename epicsType>
+static void toDoubleT(NDArray *pArray, std::vector<double>& values)
+{
+  epicsType *pData = (epicsType *)pArray->pData;
+  values.resize(NUM_ELEMENTS);
+  for (size_t i=0; i<NUM_ELEMENTS; i++) values[i] = (double)pData[i];
+}
+
+static void toDouble(NDArray *pArray, std::vector<double>& values)
+{
+  switch (pArray->dataType) {
+    case NDInt8:    toDoubleT<epicsInt8>   (pArray, values); break;
+    case NDUInt8:   toDoubleT<epicsUInt8>  (pArray, values); break;
+    case NDInt16:   toDoubleT<epicsInt16>  (pArray, values); break;
+    case NDUInt16:  toDoubleT<epicsUInt16> (pArray, values); break;
+    case NDInt32:   toDoubleT<epicsInt32>  (pArray, values); break;
+    case NDUInt32:  toDoubleT<epicsUInt32> (pArray, values); break;
+    case NDFloat32: toDoubleT<epicsFloat32>(pArray, values); break;
+    case NDFloat64: toDoubleT<epicsFloat64>(pArray, values); break;
+    default: break;
+  }
+}
+
+// Converts a double to the output type and back, as NDArrayPool::convert does
+static double castTo(NDDataType_t dataType, double value)
+{
+  switch (dataType) {
+    case NDInt8:    return (double)(epicsInt8)value;
+    case NDUInt8:   return (double)(epicsUInt8)value;
+    case NDInt16:   return (double)(epicsInt16)value;
+    case NDUInt16:  return (double)(epicsUInt16)value;
+    case NDInt32:   return (double)(epicsInt32)value;
+    case NDUInt32:  return (double)(epicsUInt32)value;
+    case NDFloat32: return (double)(epicsFloat32)value;
+    default:        return value;
+  }
+}
+
+struct ProcessPluginTestFixture
+{
+  boost::shared_ptr<asynNDArrayDriver> driver;
+  boost::shared_ptr<ProcessPluginWrapper> process;
+  boost::shared_ptr<asynGenericPointerClient> client;
+
+  ProcessPluginTestFixture()
+  {
+    std::string simport("simProcess"), testport("Process");
+    uniqueAsynPortName(simport);
+    uniqueAsynPortName(testport);
+
+    driver = boost::shared_ptr<asynNDArrayDriver>(new asynNDArrayDriver(simport.c_str(),
+                                                                     1, 0, 0,
+                                                                     asynGenericPointerMask,
+                                                                     asynGenericPointerMask,
+                                                                     0, 0, 0, 0));
+
+    // This is the plugin under test; arrays are sent by calling processCallbacks directly
+    process = boost::shared_ptr<ProcessPluginWrapper>(new ProcessPluginWrapper(testport.c_str(), simport.c_str()));
+    process->write(NDPluginDriverEnableCallbacksString, 1);
+    process->write(NDPluginProcessDataTypeString, -1);
+    process->write(NDPluginProcessEnableBackgroundString, 0);
+    process->write(NDPluginProcessEnableFlatFieldString, 0);
+    process->write(NDPluginProcessScaleFlatFieldString, SCALE_FLAT_FIELD);
+    process->write(NDPluginProcessEnableOffsetScaleString, 0);
+    process->write(NDPluginProcessOffsetString, OFFSET);
+    process->write(NDPluginProcessScaleString, SCALE);
+    process->write(NDPluginProcessEnableLowClipString, 0);
+    process->write(NDPluginProcessLowClipString, LOW_CLIP);
+    process->write(NDPluginProcessEnableHighClipString, 0);
+    process->write(NDPluginProcessHighClipString, HIGH_CLIP);
+    process->write(NDPluginProcessEnableFilterString, 0);
+    process->write(NDPluginProcessResetFilterString, 0);
+    process->write(NDPluginProcessAutoResetFilterString, 0);
+    process->write(NDPluginProcessFilterCallbacksString, 0);
+    // Recursive average of NUM_FILTER arrays
+    process->write(NDPluginProcessNumFilterString, NUM_FILTER);
+    process->write(NDPluginProcessOOffsetString, 0.);
+    process->write(NDPluginProcessOScaleString, 1.);
+    process->write(NDPluginProcessOC1String, 1.);
+    process->write(NDPluginProcessOC2String, -1.);
+    process->write(NDPluginProcessOC3String, 0.);
+    process->write(NDPluginProcessOC4String, 1.);
+    process->write(NDPluginProcessFOffsetString, 0.);
+    process->write(NDPluginProcessFScaleString, 1.);
+    process->write(NDPluginProcessFC1String, 1.);
+    process->write(NDPluginProcessFC2String, -1.);
+    process->write(NDPluginProcessFC3String, 0.);
+    process->write(NDPluginProcessFC4String, 1.);
+    process->write(NDPluginProcessROffsetString, 0.);
+    process->write(NDPluginProcessRC1String, 0.);
+    process->write(NDPluginProcessRC2String, 1.);
+
+    client = boost::shared_ptr<asynGenericPointerClient>(new asynGenericPointerClient(testport.c_str(), 0, NDArrayDataString));
+    client->registerInterruptUser(&Process_callback);
+  }
+
+  ~ProcessPluginTestFixture()
+  {
+    client.reset();
+    if (processOutput) processOutput->release();
+    processOutput = 0;
+    process.reset();
+    driver.reset();
+  }
+
+  void send(NDArray *pArray)
+  {
+    process->lock();
+    BOOST_CHECK_NO_THROW(process->processCallbacks(pArray));
+    process->unlock();
+  }
+
+  // Saves the background (which=1) or flat field (which=2) from an array sent with no processing
+  void save(NDDataType_t dataType, int which, std::vector<double>& values)
+  {
+    size_t dims[2] = {SIZE_X, SIZE_Y};
+    NDArray *pArray = driver->pNDArrayPool->alloc(2, dims, dataType, 0, NULL);
+    fillArray(pArray, 0, which);
+    toDouble(pArray, values);
+    send(pArray);
+    pArray->release();
+    process->write((which == 1) ? NDPluginProcessSaveBackgroundString : NDPluginProcessSaveFlatFieldString, 1);
+  }
+
+  void check(NDDataType_t dataTypeIn, int dataTypeOut, int tileThreads)
+  {
+    size_t dims[2] = {SIZE_X, SIZE_Y};
+    NDDataType_t outType = (dataTypeOut < 0) ? dataTypeIn : (NDDataType_t)dataTypeOut;
+    std::vector<double> background, flatField, input, output, filter(NUM_ELEMENTS);
+    int numFiltered = 0;
+
+    BOOST_TEST_MESSAGE("dataTypeIn=" << dataTypeIn << " dataTypeOut=" << dataTypeOut << " tileThreads=" << tileThreads);
+    process->write(NDPluginProcessDataTypeString, -1);
+    process->write(NDPluginProcessEnableBackgroundString, 0);
+    process->write(NDPluginProcessEnableFlatFieldString, 0);
+    process->write(NDPluginProcessEnableOffsetScaleString, 0);
+    process->write(NDPluginProcessEnableLowClipString, 0);
+    process->write(NDPluginProcessEnableHighClipString, 0);
+    process->write(NDPluginProcessEnableFilterString, 0);
+    save(dataTypeIn, 1, background);
+    save(dataTypeIn, 2, flatField);
+    BOOST_REQUIRE_EQUAL(process->readInt(NDPluginProcessValidBackgroundString), 1);
+    BOOST_REQUIRE_EQUAL(process->readInt(NDPluginProcessValidFlatFieldString), 1);
+
+    process->write(NDPluginProcessDataTypeString, dataTypeOut);
+    process->write(NDPluginProcessTileThreadsString, tileThreads);
+    process->write(NDPluginProcessEnableBackgroundString, 1);
+    process->write(NDPluginProcessEnableFlatFieldString, 1);
+    process->write(NDPluginProcessEnableOffsetScaleString, 1);
+    process->write(NDPluginProcessEnableLowClipString, 1);
+    process->write(NDPluginProcessEnableHighClipString, 1);
+    process->write(NDPluginProcessEnableFilterString, 1);
+    process->write(NDPluginProcessResetFilterString, 1);
+
+    for (int frame=0; frame<NUM_FILTER+1; frame++) {
+      NDArray *pArray = driver->pNDArrayPool->alloc(2, dims, dataTypeIn, 0, NULL);
+      size_t i, numWrong = 0;
+      fillArray(pArray, frame+1, 0);
+      pArray->uniqueId = frame + 100;
+      toDouble(pArray, input);
+      send(pArray);
+      pArray->release();
+      BOOST_REQUIRE(processOutput != 0);
+      BOOST_CHECK_EQUAL(processOutput->dataType, outType);
+      BOOST_CHECK_EQUAL(processOutput->uniqueId, frame + 100);
+      BOOST_CHECK_EQUAL(processOutput->ndims, 2);
+      BOOST_CHECK_EQUAL(processOutput->dims[0].size, SIZE_X);
+      BOOST_CHECK_EQUAL(processOutput->dims[1].size, SIZE_Y);
+      toDouble(processOutput, output);
+
+      // Each step for the whole array in turn, as NDPluginProcess did before the steps were fused
+      if (numFiltered < NUM_FILTER) numFiltered++;
+      double O1 = 1. - 1./numFiltered, O2 = 1./numFiltered;
+      for (i=0; i<NUM_ELEMENTS; i++) {
+        double value = input[i] - background[i];
+        if (flatField[i] != 0.) value *= SCALE_FLAT_FIELD / flatField[i];
+        else value = SCALE_FLAT_FIELD;
+        value = (value + OFFSET)*SCALE;
+        if (value > HIGH_CLIP) value = HIGH_CLIP;
+        if (value < LOW_CLIP) value = LOW_CLIP;
+        if (frame == 0) filter[i] = value;
+        double newData = 0.;
+        if (O1) newData += O1*filter[i];
+        if (O2) newData += O2*value;
+        filter[i] = newData;
+        if (output[i] != castTo(outType, newData)) numWrong++;
+      }
+      BOOST_CHECK_EQUAL(numWrong, 0);
+    }
+    BOOST_CHECK_EQUAL(process->readInt(NDPluginProcessNumFilteredString), NUM_FILTER);
+  }
+};
+
+BOOST_FIXTURE_TEST_SUITE(ProcessPluginTests, ProcessPluginTestFixture)
+
+BOOST_AUTO_TEST_CASE(test_ProcessDataTypes)
+{
+  NDDataType_t dataTypes[] = {NDInt8, NDUInt8, NDInt16, NDUInt16, NDInt32, NDUInt32, NDFloat32, NDFloat64};
+
+  for (size_t i=0; i<sizeof(dataTypes)/sizeof(dataTypes[0]); i++) {
+    check(dataTypes[i], -1, 1);
+    check(dataTypes[i], NDFloat64, 1);
+    check(dataTypes[i], NDUInt8, 1);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_ProcessTileThreads)
+{
+  // The results do not depend on how the blocks are divided between threads,
+  // including when there are more threads than blocks
+  int tileThreads[] = {2, 3, 8};
+
+  for (size_t i=0; i<sizeof(tileThreads)/sizeof(tileThreads[0]); i++) {
+    check(NDUInt16, -1, tileThreads[i]);
+    check(NDFloat32, NDFloat64, tileThreads[i]);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_ProcessAutoOffsetScale)
+{
+  size_t dims[2] = {SIZE_X, SIZE_Y};
+  int tileThreads[] = {1, 3};
+
+  // Float32 output, so none of the input values are out of range
+  process->write(NDPluginProcessDataTypeString, NDFloat32);
+  for (size_t t=0; t<sizeof(tileThreads)/sizeof(tileThreads[0]); t++) {
+    NDArray *pArray = driver->pNDArrayPool->alloc(2, dims, NDInt16, 0, NULL);
+    epicsInt16 *pData = (epicsInt16 *)pArray->pData;
+    for (size_t i=0; i<NUM_ELEMENTS; i++) pData[i] = (epicsInt16)(i % 1000);
+    pData[2500] = -20;
+    pData[1500] = 1200;
+    process->write(NDPluginProcessTileThreadsString, tileThreads[t]);
+    process->write(NDPluginProcessAutoOffsetScaleString, 1);
+    send(pArray);
+    pArray->release();
+    BOOST_CHECK_EQUAL(process->readDouble(NDPluginProcessOffsetString), 20.);
+    BOOST_CHECK_CLOSE(process->readDouble(NDPluginProcessScaleString), 4294967295./1220., 1e-9);
+    BOOST_CHECK_EQUAL(process->readDouble(NDPluginProcessHighClipString), 4294967295.);
+    BOOST_CHECK_EQUAL(process->readInt(NDPluginProcessEnableOffsetScaleString), 1);
+    BOOST_CHECK_EQUAL(process->readInt(NDPluginProcessAutoOffsetScaleString), 0);
+    process->write(NDPluginProcessEnableOffsetScaleString, 0);
+    process->write(NDPluginProcessEnableLowClipString, 0);
+    process->write(NDPluginProcessEnableHighClipString, 0);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
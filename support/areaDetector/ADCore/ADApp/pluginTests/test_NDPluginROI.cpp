@@ -258,5 +258,55 @@ BOOST_AUTO_TEST_CASE(basic_roi_operation)
   }
 }
 
+BOOST_AUTO_TEST_CASE(roi_view)
+{
+  size_t dims[2] = {20, 30};
+  NDArray *pArray, *pOutput;
+  epicsUInt16 *pData;
+  int i;
+
+  pArray = arrayPool->alloc(2, dims, NDUInt16, 0, NULL);
+  pData = (epicsUInt16 *)pArray->pData;
+  for (i=0; i<600; i++) pData[i] = (epicsUInt16)i;
+
+  BOOST_CHECK_NO_THROW(roi->write(NDPluginROIDim0MinString,      0));
+  BOOST_CHECK_NO_THROW(roi->write(NDPluginROIDim0EnableString,   1));
+  BOOST_CHECK_NO_THROW(roi->write(NDPluginROIDim0AutoSizeString, 1));
+  BOOST_CHECK_NO_THROW(roi->write(NDPluginROIDim1EnableString,   1));
+  BOOST_CHECK_NO_THROW(roi->write(NDPluginROIDim1AutoSizeString, 0));
+  BOOST_CHECK_NO_THROW(roi->write(NDPluginROIDim1MinString,      10));
+  BOOST_CHECK_NO_THROW(roi->write(NDPluginROIDim1SizeString,     5));
+  BOOST_CHECK_NO_THROW(roi->write(NDPluginROICollapseDimsString, 0));
+  BOOST_CHECK_NO_THROW(roi->write(NDPluginROIDataTypeString,     -1));
+  BOOST_CHECK_NO_THROW(roi->write(NDArrayCallbacksString, 1));
+
+  // Complete rows are a view of the input buffer
+  roi->lock();
+  BOOST_CHECK_NO_THROW(roi->processCallbacks(pArray));
+  roi->unlock();
+  pOutput = downstream_plugin->arrays.back();
+  BOOST_REQUIRE_EQUAL(pOutput->ndims, 2);
+  BOOST_CHECK_EQUAL(pOutput->dims[0].size, 20);
+  BOOST_CHECK_EQUAL(pOutput->dims[1].size, 5);
+  BOOST_CHECK_EQUAL(pOutput->dims[1].offset, 10);
+  BOOST_CHECK_EQUAL(pOutput->pData, (void *)(pData + 200));
+  BOOST_CHECK_EQUAL(pOutput->pViewParent, pArray);
+
+  // Part of each row is copied
+  BOOST_CHECK_NO_THROW(roi->write(NDPluginROIDim0AutoSizeString, 0));
+  BOOST_CHECK_NO_THROW(roi->write(NDPluginROIDim0MinString,      3));
+  BOOST_CHECK_NO_THROW(roi->write(NDPluginROIDim0SizeString,     4));
+  roi->lock();
+  BOOST_CHECK_NO_THROW(roi->processCallbacks(pArray));
+  roi->unlock();
+  pOutput = downstream_plugin->arrays.back();
+  BOOST_CHECK(pOutput->pViewParent == NULL);
+  BOOST_CHECK(pOutput->pData != pArray->pData);
+  BOOST_CHECK_EQUAL(((epicsUInt16 *)pOutput->pData)[0], 203);
+  BOOST_CHECK_EQUAL(((epicsUInt16 *)pOutput->pData)[4], 223);
+
+  pArray->release();
+}
+
 
 BOOST_AUTO_TEST_SUITE_END() // Done!
@@ -0,0 +1,229 @@
+/*
+ * test_NDPluginROIStat.cpp
+ *
+ * Checks the statistics of overlapping ROIs, with and without background, against a separate
+ * loop over the pixels of each ROI, and prints the time to compute many ROIs of a large array.
+ */
+
+#include <stdio.h>
+#include <math.h>
+
+
+#include "boost/test/unit_test.hpp"
+
+// AD dependencies
+#include <NDPluginDriver.h>
+#include <NDArray.h>
+#include <asynDriver.h>
+
+#include <string.h>
+#include <stdint.h>
+
+#include <boost/shared_ptr.hpp>
+using namespace std;
+
+#include "testingutilities.h"
+#include "ROIStatPluginWrapper.h"
+
+#define MAX_ROIS 64
+
+struct ROIStatRegion {
+  size_t offset[2];
+  size_t size[2];
+  size_t bgdWidth;
+};
+
+struct ROIStatResult {
+  double min, max, mean, total, net;
+};
+
+/* Statistics of one ROI computed pixel by pixel */
+template <typename epicsType>
+static ROIStatResult referenceStats(const epicsType *pData, int ndims, size_t xSize, const ROIStatRegion &region)
+{
+  ROIStatResult result;
+  size_t sizeY = (ndims == 1) ? 1 : region.size[1];
+  size_t offsetY = (ndims == 1) ? 0 : region.offset[1];
+  size_t bgdX = (region.bgdWidth < region.size[0]) ? region.bgdWidth : region.size[0];
+  size_t bgdY = (ndims == 1) ? 0 : (region.bgdWidth < sizeY) ? region.bgdWidth : sizeY;
+  double bgd = 0;
+  size_t nBgd = 0;
+
+  result.min = result.max = pData[region.offset[0] + offsetY*xSize];
+  result.total = 0;
+  for (size_t y=offsetY; y<offsetY+sizeY; y++) {
+    for (size_t x=region.offset[0]; x<region.offset[0]+region.size[0]; x++) {
+      double value = pData[x + y*xSize];
+      if (value < result.min) result.min = value;
+      if (value > result.max) result.max = value;
+      result.total += value;
+      if (region.bgdWidth == 0) continue;
+      // Pixels in both the top and bottom rows count twice, as do those in both the left and right columns
+      if (y < offsetY + bgdY) { bgd += value; nBgd++; }
+      if (y >= offsetY + sizeY - bgdY) { bgd += value; nBgd++; }
+      if ((y >= offsetY + bgdY) && (y < offsetY + sizeY - bgdY)) {
+        if (x < region.offset[0] + bgdX) { bgd += value; nBgd++; }
+        if (x >= region.offset[0] + region.size[0] - bgdX) { bgd += value; nBgd++; }
+      }
+    }
+  }
+  size_t nElements = region.size[0] * sizeY;
+  if (nBgd > 0) bgd = bgd/nBgd * nElements;
+  result.net = result.total - bgd;
+  result.mean = result.total / nElements;
+  return result;
+}
+
+struct ROIStatPluginTestFixture
+{
+  boost::shared_ptr<asynNDArrayDriver> driver;
+  boost::shared_ptr<ROIStatPluginWrapper> roiStat;
+
+  ROIStatPluginTestFixture()
+  {
+    std::string simport("simROIStat"), testport("ROIStat");
+    uniqueAsynPortName(simport);
+    uniqueAsynPortName(testport);
+
+    driver = boost::shared_ptr<asynNDArrayDriver>(new asynNDArrayDriver(simport.c_str(),
+                                                                     1, 0, 0,
+                                                                     asynGenericPointerMask,
+                                                                     asynGenericPointerMask,
+                                                                     0, 0, 0, 0));
+
+    // Arrays are sent to the plugin by calling processCallbacks directly
+    roiStat = boost::shared_ptr<ROIStatPluginWrapper>(new ROIStatPluginWrapper(testport.c_str(), simport.c_str(), MAX_ROIS));
+    roiStat->write(NDPluginDriverEnableCallbacksString, 1);
+  }
+
+  ~ROIStatPluginTestFixture()
+  {
+    roiStat.reset();
+    driver.reset();
+  }
+
+  void setROI(int roi, const ROIStatRegion &region)
+  {
+    roiStat->write(NDPluginROIStatUseString, 1, roi);
+    roiStat->write(NDPluginROIStatDim0MinString, (int)region.offset[0], roi);
+    roiStat->write(NDPluginROIStatDim0SizeString, (int)region.size[0], roi);
+    roiStat->write(NDPluginROIStatDim1MinString, (int)region.offset[1], roi);
+    roiStat->write(NDPluginROIStatDim1SizeString, (int)region.size[1], roi);
+    roiStat->write(NDPluginROIStatBgdWidthString, (int)region.bgdWidth, roi);
+  }
+
+  void process(NDArray *pArray)
+  {
+    roiStat->lock();
+    BOOST_CHECK_NO_THROW(roiStat->processCallbacks(pArray));
+    roiStat->unlock();
+  }
+
+  template <typename epicsType>
+  void checkROI(NDArray *pArray, const ROIStatRegion &region, int roi)
+  {
+    ROIStatResult expected = referenceStats((epicsType *)pArray->pData, pArray->ndims,
+                                            pArray->dims[0].size, region);
+    double tolerance = 1e-9 * (fabs(expected.total) + 1);
+    BOOST_MESSAGE("roi=" << roi);
+    BOOST_CHECK_EQUAL(roiStat->readDouble(NDPluginROIStatMinValueString, roi), expected.min);
+    BOOST_CHECK_EQUAL(roiStat->readDouble(NDPluginROIStatMaxValueString, roi), expected.max);
+    BOOST_CHECK_SMALL(roiStat->readDouble(NDPluginROIStatTotalString, roi) - expected.total, tolerance);
+    BOOST_CHECK_SMALL(roiStat->readDouble(NDPluginROIStatMeanValueString, roi) - expected.mean, tolerance);
+    BOOST_CHECK_SMALL(roiStat->readDouble(NDPluginROIStatNetString, roi) - expected.net, tolerance);
+  }
+
+  template <typename epicsType>
+  void checkROIs(NDArray *pArray, const ROIStatRegion *regions, int numROIs)
+  {
+    for (int roi=0; roi<numROIs; roi++) checkROI<epicsType>(pArray, regions[roi], roi);
+  }
+};
+
+BOOST_FIXTURE_TEST_SUITE(ROIStatPluginTests, ROIStatPluginTestFixture)
+
+BOOST_AUTO_TEST_CASE(test_OverlappingROIs)
+{
+  const size_t xSize = 97, ySize = 61;
+  size_t dims[2] = {xSize, ySize};
+  // Nested, overlapping, touching the edges, a single pixel, and background wider than half the ROI
+  const ROIStatRegion regions[] = {
+    {{0, 0},   {xSize, ySize}, 0},
+    {{10, 5},  {40, 30},       3},
+    {{20, 15}, {40, 30},       5},
+    {{30, 20}, {10, 10},       0},
+    {{96, 60}, {1, 1},         0},
+    {{50, 0},  {47, 61},       30},
+    {{11, 6},  {7, 3},         1},
+    {{0, 40},  {97, 2},        4}
+  };
+  int numROIs = sizeof(regions)/sizeof(regions[0]);
+
+  NDArray *pArray = driver->pNDArrayPool->alloc(2, dims, NDInt32, 0, NULL);
+  epicsInt32 *pData = (epicsInt32 *)pArray->pData;
+  for (size_t i=0; i<xSize*ySize; i++) pData[i] = (epicsInt32)((i*2654435761u) % 20001) - 10000;
+  for (int roi=0; roi<numROIs; roi++) setROI(roi, regions[roi]);
+
+  process(pArray);
+  checkROIs<epicsInt32>(pArray, regions, numROIs);
+
+  // An ROI that is not in use keeps its last statistics and does not change the others
+  roiStat->write(NDPluginROIStatUseString, 0, 1);
+  pData[20 + 10*xSize] = 100000;
+  process(pArray);
+  BOOST_CHECK(roiStat->readDouble(NDPluginROIStatMaxValueString, 1) < 100000);
+  for (int roi=0; roi<numROIs; roi++) {
+    if (roi != 1) checkROI<epicsInt32>(pArray, regions[roi], roi);
+  }
+  BOOST_CHECK_EQUAL(roiStat->readDouble(NDPluginROIStatMaxValueString, 0), 100000);
+  pArray->release();
+}
+
+BOOST_AUTO_TEST_CASE(test_1D)
+{
+  size_t dims[1] = {200};
+  const ROIStatRegion regions[] = {
+    {{0, 0},   {200, 1}, 10},
+    {{50, 0},  {20, 7},  15},
+    {{199, 0}, {1, 1},   1}
+  };
+  int numROIs = sizeof(regions)/sizeof(regions[0]);
+
+  NDArray *pArray = driver->pNDArrayPool->alloc(1, dims, NDFloat64, 0, NULL);
+  epicsFloat64 *pData = (epicsFloat64 *)pArray->pData;
+  for (size_t i=0; i<dims[0]; i++) pData[i] = sin(i*0.1) * 100.;
+  for (int roi=0; roi<numROIs; roi++) setROI(roi, regions[roi]);
+
+  process(pArray);
+  checkROIs<epicsFloat64>(pArray, regions, numROIs);
+  pArray->release();
+}
+
+BOOST_AUTO_TEST_CASE(test_TileThreads)
+{
+  // The rows are divided between threads; integer data gives identical results
+  const size_t xSize = 300, ySize = 201;
+  size_t dims[2] = {xSize, ySize};
+  ROIStatRegion regions[MAX_ROIS];
+
+  NDArray *pArray = driver->pNDArrayPool->alloc(2, dims, NDUInt16, 0, NULL);
+  epicsUInt16 *pData = (epicsUInt16 *)pArray->pData;
+  for (size_t i=0; i<xSize*ySize; i++) pData[i] = (epicsUInt16)((i*2654435761u) >> 16);
+  for (int roi=0; roi<MAX_ROIS; roi++) {
+    regions[roi].offset[0] = (roi*37) % 200;
+    regions[roi].offset[1] = (roi*23) % 140;
+    regions[roi].size[0] = 20 + roi;
+    regions[roi].size[1] = 10 + (roi*7) % 50;
+    regions[roi].bgdWidth = roi % 4;
+    setROI(roi, regions[roi]);
+  }
+
+  for (int threads=1; threads<=5; threads+=4) {
+    roiStat->write(NDPluginROIStatTileThreadsString, threads);
+    process(pArray);
+    checkROIs<epicsUInt16>(pArray, regions, MAX_ROIS);
+  }
+  pArray->release();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,217 @@
+/*
+ * test_NDPluginScatter.cpp
+ *
+ * Checks which downstream plugin each array is sent to with the round robin, shortest queue
+ * and lowest latency scatter methods, and the statistics for each client.
+ */
+
+#include <stdio.h>
+
+
+#include "boost/test/unit_test.hpp"
+
+// AD dependencies
+#include <NDPluginDriver.h>
+#include <NDArray.h>
+#include <asynDriver.h>
+#include <epicsThread.h>
+
+#include <string.h>
+#include <stdint.h>
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+using namespace std;
+
+#include "testingutilities.h"
+#include "ScatterPluginWrapper.h"
+#include "ROIPluginWrapper.h"
+
+// Makes the plugin that does the callback take at least 20 ms to process each array
+static void slowCallback(void *userPvt, asynUser *pasynUser, void *pointer)
+{
+  epicsThreadSleep(0.02);
+}
+
+struct ScatterPluginTestFixture
+{
+  boost::shared_ptr<asynNDArrayDriver> driver;
+  boost::shared_ptr<ScatterPluginWrapper> scatter;
+  std::vector<boost::shared_ptr<ROIPluginWrapper> > clients;
+  std::vector<std::string> clientPorts;
+  std::vector<boost::shared_ptr<asynGenericPointerClient> > slowClients;
+  std::string scatterPort;
+  int uniqueId;
+
+  ScatterPluginTestFixture()
+  {
+    std::string simport("simScatter"), testport("Scatter");
+    uniqueAsynPortName(simport);
+    uniqueAsynPortName(testport);
+    scatterPort = testport;
+    uniqueId = 1;
+
+    driver = boost::shared_ptr<asynNDArrayDriver>(new asynNDArrayDriver(simport.c_str(),
+                                                                     1, 0, 0,
+                                                                     asynGenericPointerMask,
+                                                                     asynGenericPointerMask,
+                                                                     0, 0, 0, 0));
+
+    // Blocking, so each array has been passed on when the callback returns
+    scatter = boost::shared_ptr<ScatterPluginWrapper>(new ScatterPluginWrapper(testport.c_str(), simport.c_str()));
+    scatter->write(NDPluginDriverEnableCallbacksString, 1);
+    scatter->write(NDArrayCallbacksString, 1);
+  }
+
+  ~ScatterPluginTestFixture()
+  {
+    // The queued arrays must be processed before a non-blocking plugin is deleted
+    for (size_t i=0; i<clients.size(); i++) clients[i]->start();
+    slowClients.clear();
+    clients.clear();
+    scatter.reset();
+    driver.reset();
+  }
+
+  // Adds a downstream ROI plugin.  Non-blocking plugins are not started, so their arrays stay queued.
+  ROIPluginWrapper *addClient(int queueSize, int blocking)
+  {
+    std::string port("ScatterROI");
+    uniqueAsynPortName(port);
+    boost::shared_ptr<ROIPluginWrapper> roi(new ROIPluginWrapper(port.c_str(), queueSize, blocking,
+                                                                 scatterPort.c_str(), 0, 0, 0, 0, 1));
+    roi->write(NDPluginDriverEnableCallbacksString, 1);
+    clients.push_back(roi);
+    clientPorts.push_back(port);
+    return roi.get();
+  }
+
+  // Makes a blocking client slow to process arrays
+  void makeSlow(int index)
+  {
+    clients[index]->write(NDArrayCallbacksString, 1);
+    boost::shared_ptr<asynGenericPointerClient> client(new asynGenericPointerClient(clientPorts[index].c_str(), 0, NDArrayDataString));
+    client->registerInterruptUser(&slowCallback);
+    slowClients.push_back(client);
+  }
+
+  void sendArrays(int numArrays)
+  {
+    size_t dims[2] = {16, 8};
+    int arrayData;
+
+    driver->findParam(NDArrayDataString, &arrayData);
+    for (int i=0; i<numArrays; i++) {
+      NDArray *pArray = driver->pNDArrayPool->alloc(2, dims, NDUInt8, 0, NULL);
+      memset(pArray->pData, 0, pArray->dataSize);
+      pArray->uniqueId = uniqueId++;
+      driver->doCallbacksGenericPointer(pArray, arrayData, 0);
+      pArray->release();
+    }
+  }
+
+  std::vector<epicsInt32> readStatistics(const char *paramName)
+  {
+    std::vector<epicsInt32> values(16);
+    size_t nIn = 0;
+    asynInt32ArrayClient client(scatterPort.c_str(), 0, paramName);
+    BOOST_CHECK_EQUAL(client.read(&values[0], values.size(), &nIn), asynSuccess);
+    values.resize(nIn);
+    return values;
+  }
+
+  int numQueued(ROIPluginWrapper *roi)
+  {
+    int numArrays;
+    double latency;
+    roi->getLoad(&numArrays, &latency);
+    return numArrays;
+  }
+};
+
+BOOST_FIXTURE_TEST_SUITE(ScatterPluginTests, ScatterPluginTestFixture)
+
+BOOST_AUTO_TEST_CASE(test_RoundRobin)
+{
+  ROIPluginWrapper *roi[3];
+  for (int i=0; i<3; i++) roi[i] = addClient(10, 0);
+  BOOST_CHECK_EQUAL(scatter->readInt(NDPluginScatterMethodString), NDScatterRoundRobin);
+
+  sendArrays(6);
+  std::vector<epicsInt32> sent = readStatistics(NDPluginScatterArraysSentString);
+  BOOST_REQUIRE_EQUAL(sent.size(), 3);
+  for (int i=0; i<3; i++) {
+    BOOST_CHECK_EQUAL(numQueued(roi[i]), 2);
+    BOOST_CHECK_EQUAL(sent[i], 2);
+  }
+
+  // Clients with full queues are skipped, and arrays are dropped when all the queues are full
+  sendArrays(30);
+  sent = readStatistics(NDPluginScatterArraysSentString);
+  for (int i=0; i<3; i++) {
+    BOOST_CHECK_EQUAL(numQueued(roi[i]), 10);
+    BOOST_CHECK_EQUAL(sent[i], 10);
+  }
+  std::vector<epicsInt32> load = readStatistics(NDPluginScatterClientLoadString);
+  BOOST_REQUIRE_EQUAL(load.size(), 3);
+  for (int i=0; i<3; i++) BOOST_CHECK_EQUAL(load[i], 10);
+}
+
+BOOST_AUTO_TEST_CASE(test_ShortestQueue)
+{
+  ROIPluginWrapper *roi[3];
+  roi[0] = addClient(10, 0);
+  roi[1] = addClient(10, 0);
+  sendArrays(4);
+
+  // A new client gets arrays until its queue is as long as the others, then they are used in turn
+  roi[2] = addClient(10, 0);
+  scatter->write(NDPluginScatterMethodString, NDScatterShortestQueue);
+  sendArrays(2);
+  BOOST_CHECK_EQUAL(numQueued(roi[0]), 2);
+  BOOST_CHECK_EQUAL(numQueued(roi[1]), 2);
+  BOOST_CHECK_EQUAL(numQueued(roi[2]), 2);
+  sendArrays(3);
+  std::vector<epicsInt32> sent = readStatistics(NDPluginScatterArraysSentString);
+  BOOST_REQUIRE_EQUAL(sent.size(), 3);
+  for (int i=0; i<3; i++) {
+    BOOST_CHECK_EQUAL(numQueued(roi[i]), 3);
+    BOOST_CHECK_EQUAL(sent[i], 3);
+  }
+  // The load is that before the last array was sent
+  std::vector<epicsInt32> load = readStatistics(NDPluginScatterClientLoadString);
+  BOOST_REQUIRE_EQUAL(load.size(), 3);
+  BOOST_CHECK_EQUAL(load[0], 3);
+  BOOST_CHECK_EQUAL(load[1], 3);
+  BOOST_CHECK_EQUAL(load[2], 2);
+}
+
+BOOST_AUTO_TEST_CASE(test_LowestLatency)
+{
+  // Two blocking clients; the second takes at least 20 ms per array
+  ROIPluginWrapper *fast = addClient(10, 1);
+  ROIPluginWrapper *slow = addClient(10, 1);
+  makeSlow(1);
+
+  // Neither client has processed an array yet, so they are used in turn
+  scatter->write(NDPluginScatterMethodString, NDScatterLowestLatency);
+  sendArrays(2);
+  std::vector<epicsInt32> sent = readStatistics(NDPluginScatterArraysSentString);
+  BOOST_REQUIRE_EQUAL(sent.size(), 2);
+  BOOST_CHECK_EQUAL(sent[0], 1);
+  BOOST_CHECK_EQUAL(sent[1], 1);
+
+  int numArrays;
+  double fastLatency, slowLatency;
+  fast->getLoad(&numArrays, &fastLatency);
+  slow->getLoad(&numArrays, &slowLatency);
+  BOOST_CHECK(slowLatency >= 0.015);
+  BOOST_CHECK(fastLatency < slowLatency);
+
+  sendArrays(10);
+  sent = readStatistics(NDPluginScatterArraysSentString);
+  BOOST_CHECK_EQUAL(sent[0], 11);
+  BOOST_CHECK_EQUAL(sent[1], 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
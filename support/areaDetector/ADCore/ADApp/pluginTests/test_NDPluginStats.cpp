@@ -0,0 +1,200 @@
+/*
+ * test_NDPluginStats.cpp
+ *
+ * Compares the statistics, centroid and histogram computed by NDPluginStats
+ * with values computed here, for several data types and numbers of tile threads.
+ */
+
+#include <stdio.h>
+
+
+#include "boost/test/unit_test.hpp"
+
+// AD dependencies
+#include <NDPluginDriver.h>
+#include <NDArray.h>
+#include <asynDriver.h>
+
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include <boost/shared_ptr.hpp>
+using namespace std;
+
+#include "testingutilities.h"
+#include "StatsPluginWrapper.h"
+
+#define SIZE_X 67
+#define SIZE_Y 45
+#define HIST_SIZE 50
+#define HIST_MIN 10.
+#define HIST_MAX 150.
+#define CENTROID_THRESHOLD 20.
+
+typedef struct {
+  double min, minX, minY;
+  double max, maxX, maxY;
+  double total, mean, sigma;
+  double centroidX, centroidY, sigmaX, sigmaY;
+  int histBelow, histAbove;
+} StatsReference;
+
+// Values from 0 to 199 with a single minimum and maximum, shifted down for signed types
+static double pixelValue(size_t ix, size_t iy, double offset)
+{
+  double value = (double)((ix*7 + iy*13) % 199);
+  if ((ix == 40) && (iy == 30)) value = 199;
+  if ((ix == 3) && (iy == 41)) value = -1;
+  return value + 1 - offset;
+}
+
+template <typename epicsType>
+static void fillArray(NDArray *pArray, double offset, StatsReference *pRef)
+{
+  epicsType *pData = (epicsType *)pArray->pData;
+  double sumSquares = 0, centroidTotal = 0, momentX = 0, momentY = 0, momentXX = 0, momentYY = 0;
+  double scale = HIST_SIZE / (HIST_MAX - HIST_MIN);
+  size_t ix, iy;
+
+  memset(pRef, 0, sizeof(*pRef));
+  pRef->min = 1e30;
+  pRef->max = -1e30;
+  for (iy=0; iy<SIZE_Y; iy++) {
+    for (ix=0; ix<SIZE_X; ix++) {
+      double value = pixelValue(ix, iy, offset);
+      pData[iy*SIZE_X + ix] = (epicsType)value;
+      if (value < pRef->min) {
+        pRef->min = value;
+        pRef->minX = ix;
+        pRef->minY = iy;
+      }
+      if (value > pRef->max) {
+        pRef->max = value;
+        pRef->maxX = ix;
+        pRef->maxY = iy;
+      }
+      pRef->total += value;
+      sumSquares += value*value;
+      if (value >= CENTROID_THRESHOLD) {
+        centroidTotal += value;
+        momentX  += value*ix;
+        momentY  += value*iy;
+        momentXX += value*ix*ix;
+        momentYY += value*iy*iy;
+      }
+      int bin = (int)(((value - HIST_MIN) * scale) + 0.5);
+      if ((bin < 0) || (value < HIST_MIN)) pRef->histBelow++;
+      else if ((bin > HIST_SIZE-1) || (value > HIST_MAX)) pRef->histAbove++;
+    }
+  }
+  pRef->mean = pRef->total / (SIZE_X*SIZE_Y);
+  pRef->sigma = sqrt(sumSquares/(SIZE_X*SIZE_Y) - pRef->mean*pRef->mean);
+  pRef->centroidX = momentX / centroidTotal;
+  pRef->centroidY = momentY / centroidTotal;
+  pRef->sigmaX = sqrt(momentXX/centroidTotal - pRef->centroidX*pRef->centroidX);
+  pRef->sigmaY = sqrt(momentYY/centroidTotal - pRef->centroidY*pRef->centroidY);
+}
+
+struct StatsPluginTestFixture
+{
+  boost::shared_ptr<asynNDArrayDriver> driver;
+  boost::shared_ptr<StatsPluginWrapper> stats;
+
+  StatsPluginTestFixture()
+  {
+    std::string simport("simStats"), testport("Stats");
+    uniqueAsynPortName(simport);
+    uniqueAsynPortName(testport);
+
+    driver = boost::shared_ptr<asynNDArrayDriver>(new asynNDArrayDriver(simport.c_str(),
+                                                                     1, 0, 0,
+                                                                     asynGenericPointerMask,
+                                                                     asynGenericPointerMask,
+                                                                     0, 0, 0, 0));
+
+    // This is the plugin under test; arrays are sent by calling processCallbacks directly
+    stats = boost::shared_ptr<StatsPluginWrapper>(new StatsPluginWrapper(testport.c_str(), simport.c_str()));
+    stats->write(NDPluginDriverEnableCallbacksString, 1);
+    stats->write(NDPluginStatsComputeStatisticsString, 1);
+    stats->write(NDPluginStatsComputeCentroidString, 1);
+    stats->write(NDPluginStatsComputeHistogramString, 1);
+    stats->write(NDPluginStatsCentroidThresholdString, CENTROID_THRESHOLD);
+    stats->write(NDPluginStatsHistSizeString, HIST_SIZE);
+    stats->write(NDPluginStatsHistMinString, HIST_MIN);
+    stats->write(NDPluginStatsHistMaxString, HIST_MAX);
+  }
+
+  ~StatsPluginTestFixture()
+  {
+    stats.reset();
+    driver.reset();
+  }
+
+  void check(NDDataType_t dataType, int tileThreads)
+  {
+    size_t dims[2] = {SIZE_X, SIZE_Y};
+    StatsReference ref;
+    double offset = 0;
+    NDArray *pArray = driver->pNDArrayPool->alloc(2, dims, dataType, 0, NULL);
+
+    BOOST_TEST_MESSAGE("dataType=" << dataType << " tileThreads=" << tileThreads);
+    switch (dataType) {
+      case NDInt8:    offset = 100; fillArray<epicsInt8>(pArray, offset, &ref); break;
+      case NDUInt8:   fillArray<epicsUInt8>(pArray, offset, &ref); break;
+      case NDInt16:   offset = 100; fillArray<epicsInt16>(pArray, offset, &ref); break;
+      case NDUInt16:  fillArray<epicsUInt16>(pArray, offset, &ref); break;
+      case NDInt32:   offset = 100; fillArray<epicsInt32>(pArray, offset, &ref); break;
+      case NDUInt32:  fillArray<epicsUInt32>(pArray, offset, &ref); break;
+      case NDFloat32: fillArray<epicsFloat32>(pArray, offset, &ref); break;
+      case NDFloat64: fillArray<epicsFloat64>(pArray, offset, &ref); break;
+      default: break;
+    }
+    stats->write(NDPluginStatsTileThreadsString, tileThreads);
+    stats->lock();
+    BOOST_CHECK_NO_THROW(stats->processCallbacks(pArray));
+    stats->unlock();
+    pArray->release();
+
+    BOOST_CHECK_EQUAL(stats->readDouble(NDPluginStatsMinValueString), ref.min);
+    BOOST_CHECK_EQUAL(stats->readDouble(NDPluginStatsMinXString), ref.minX);
+    BOOST_CHECK_EQUAL(stats->readDouble(NDPluginStatsMinYString), ref.minY);
+    BOOST_CHECK_EQUAL(stats->readDouble(NDPluginStatsMaxValueString), ref.max);
+    BOOST_CHECK_EQUAL(stats->readDouble(NDPluginStatsMaxXString), ref.maxX);
+    BOOST_CHECK_EQUAL(stats->readDouble(NDPluginStatsMaxYString), ref.maxY);
+    BOOST_CHECK_CLOSE(stats->readDouble(NDPluginStatsTotalString), ref.total, 1e-9);
+    BOOST_CHECK_CLOSE(stats->readDouble(NDPluginStatsMeanValueString), ref.mean, 1e-9);
+    BOOST_CHECK_CLOSE(stats->readDouble(NDPluginStatsSigmaValueString), ref.sigma, 1e-6);
+    BOOST_CHECK_CLOSE(stats->readDouble(NDPluginStatsCentroidXString), ref.centroidX, 1e-9);
+    BOOST_CHECK_CLOSE(stats->readDouble(NDPluginStatsCentroidYString), ref.centroidY, 1e-9);
+    BOOST_CHECK_CLOSE(stats->readDouble(NDPluginStatsSigmaXString), ref.sigmaX, 1e-6);
+    BOOST_CHECK_CLOSE(stats->readDouble(NDPluginStatsSigmaYString), ref.sigmaY, 1e-6);
+    BOOST_CHECK_EQUAL(stats->readInt(NDPluginStatsHistBelowString), ref.histBelow);
+    BOOST_CHECK_EQUAL(stats->readInt(NDPluginStatsHistAboveString), ref.histAbove);
+  }
+};
+
+BOOST_FIXTURE_TEST_SUITE(StatsPluginTests, StatsPluginTestFixture)
+
+BOOST_AUTO_TEST_CASE(test_StatsDataTypes)
+{
+  NDDataType_t dataTypes[] = {NDInt8, NDUInt8, NDInt16, NDUInt16, NDInt32, NDUInt32, NDFloat32, NDFloat64};
+
+  for (size_t i=0; i<sizeof(dataTypes)/sizeof(dataTypes[0]); i++) {
+    check(dataTypes[i], 1);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_StatsTileThreads)
+{
+  // The results do not depend on how the rows are divided between threads,
+  // including when there are more threads than rows
+  int tileThreads[] = {2, 3, 4, 8, SIZE_Y+1};
+
+  for (size_t i=0; i<sizeof(tileThreads)/sizeof(tileThreads[0]); i++) {
+    check(NDUInt16, tileThreads[i]);
+    check(NDFloat64, tileThreads[i]);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,155 @@
+/*
+ * test_NDPluginStdArrays.cpp
+ *
+ * Checks that arrays are passed to the clients of each asyn array type without converting them
+ * when the type does not change the data, and converted once for all clients of the other types.
+ */
+
+#include <stdio.h>
+
+
+#include "boost/test/unit_test.hpp"
+
+// AD dependencies
+#include <NDPluginDriver.h>
+#include <NDArray.h>
+#include <asynDriver.h>
+
+#include <string.h>
+#include <stdint.h>
+
+#include <boost/shared_ptr.hpp>
+using namespace std;
+
+#include "testingutilities.h"
+#include "StdArraysPluginWrapper.h"
+
+// The data pointers passed to the clients, and the values of the last Float64 callback
+static std::vector<const void *> int8Pointers;
+static std::vector<const void *> float64Pointers;
+static std::vector<double> float64Data;
+static int numCallbacks = 0;
+
+static void int8Callback(void *userPvt, asynUser *pasynUser, epicsInt8 *data, size_t nelements)
+{
+  int8Pointers.push_back(data);
+  numCallbacks++;
+}
+
+static void float64Callback(void *userPvt, asynUser *pasynUser, epicsFloat64 *data, size_t nelements)
+{
+  float64Pointers.push_back(data);
+  float64Data.assign(data, data + nelements);
+  numCallbacks++;
+}
+
+struct StdArraysPluginTestFixture
+{
+  boost::shared_ptr<asynNDArrayDriver> driver;
+  boost::shared_ptr<StdArraysPluginWrapper> stdArrays;
+  std::string arrayPort;
+
+  StdArraysPluginTestFixture()
+  {
+    std::string simport("simStdArrays"), testport("StdArrays");
+    uniqueAsynPortName(simport);
+    uniqueAsynPortName(testport);
+    arrayPort = testport;
+
+    driver = boost::shared_ptr<asynNDArrayDriver>(new asynNDArrayDriver(simport.c_str(),
+                                                                     1, 0, 0,
+                                                                     asynGenericPointerMask,
+                                                                     asynGenericPointerMask,
+                                                                     0, 0, 0, 0));
+
+    // Arrays are sent to the plugin by calling processCallbacks directly
+    stdArrays = boost::shared_ptr<StdArraysPluginWrapper>(new StdArraysPluginWrapper(testport.c_str(), simport.c_str()));
+    stdArrays->write(NDPluginDriverEnableCallbacksString, 1);
+    numCallbacks = 0;
+  }
+
+  ~StdArraysPluginTestFixture()
+  {
+    stdArrays.reset();
+    driver.reset();
+  }
+
+  void process(NDArray *pArray)
+  {
+    stdArrays->lock();
+    BOOST_CHECK_NO_THROW(stdArrays->processCallbacks(pArray));
+    stdArrays->unlock();
+  }
+};
+
+BOOST_FIXTURE_TEST_SUITE(StdArraysPluginTests, StdArraysPluginTestFixture)
+
+BOOST_AUTO_TEST_CASE(test_BorrowedAndShared)
+{
+  size_t dims[2] = {40, 30};
+  const size_t nElements = dims[0] * dims[1];
+  NDArray *pArray = driver->pNDArrayPool->alloc(2, dims, NDUInt8, 0, NULL);
+  epicsUInt8 *pData = (epicsUInt8 *)pArray->pData;
+  for (size_t i=0; i<nElements; i++) pData[i] = (epicsUInt8)(i*7);
+
+  // Two clients each of Int8 and Float64, none of the other types
+  asynInt8ArrayClient int8Client0(arrayPort.c_str(), 0, NDPluginStdArraysDataString);
+  asynInt8ArrayClient int8Client1(arrayPort.c_str(), 0, NDPluginStdArraysDataString);
+  asynFloat64ArrayClient float64Client0(arrayPort.c_str(), 0, NDPluginStdArraysDataString);
+  asynFloat64ArrayClient float64Client1(arrayPort.c_str(), 0, NDPluginStdArraysDataString);
+  int8Client0.registerInterruptUser(int8Callback);
+  int8Client1.registerInterruptUser(int8Callback);
+  float64Client0.registerInterruptUser(float64Callback);
+  float64Client1.registerInterruptUser(float64Callback);
+  int8Pointers.clear();
+  float64Pointers.clear();
+
+  process(pArray);
+  BOOST_CHECK_EQUAL(numCallbacks, 4);
+
+  // UInt8 data is passed to the Int8 clients without a copy
+  BOOST_REQUIRE_EQUAL(int8Pointers.size(), 2);
+  BOOST_CHECK(int8Pointers[0] == pArray->pData);
+  BOOST_CHECK(int8Pointers[1] == pArray->pData);
+
+  // The Float64 clients share one converted copy, which is the only array the plugin allocated
+  BOOST_REQUIRE_EQUAL(float64Pointers.size(), 2);
+  BOOST_CHECK(float64Pointers[0] != pArray->pData);
+  BOOST_CHECK(float64Pointers[1] == float64Pointers[0]);
+  BOOST_CHECK_EQUAL(stdArrays->pNDArrayPool->getNumBuffers(), 1);
+  BOOST_REQUIRE_EQUAL(float64Data.size(), nElements);
+  for (size_t i=0; i<nElements; i++) {
+    BOOST_CHECK_EQUAL(float64Data[i], pData[i]);
+  }
+
+  // Reads use the converted copy of the last array, and convert to other types once
+  std::vector<epicsFloat64> float64Read(nElements);
+  std::vector<epicsInt16> int16Read(nElements);
+  size_t nIn = 0;
+  BOOST_CHECK_EQUAL(float64Client0.read(&float64Read[0], nElements, &nIn), asynSuccess);
+  BOOST_CHECK_EQUAL(nIn, nElements);
+  BOOST_CHECK_EQUAL(float64Read[nElements-1], pData[nElements-1]);
+  BOOST_CHECK_EQUAL(stdArrays->pNDArrayPool->getNumBuffers(), 1);
+  asynInt16ArrayClient int16Client(arrayPort.c_str(), 0, NDPluginStdArraysDataString);
+  for (int i=0; i<2; i++) {
+    BOOST_CHECK_EQUAL(int16Client.read(&int16Read[0], nElements, &nIn), asynSuccess);
+    BOOST_CHECK_EQUAL(nIn, nElements);
+    BOOST_CHECK_EQUAL(int16Read[nElements-1], pData[nElements-1]);
+    BOOST_CHECK_EQUAL(stdArrays->pNDArrayPool->getNumBuffers(), 2);
+  }
+  pArray->release();
+}
+
+BOOST_AUTO_TEST_CASE(test_NoClients)
+{
+  // Arrays are not converted if there are no clients
+  size_t dims[1] = {1000};
+  NDArray *pArray = driver->pNDArrayPool->alloc(1, dims, NDFloat32, 0, NULL);
+  memset(pArray->pData, 0, pArray->dataSize);
+  process(pArray);
+  BOOST_CHECK_EQUAL(numCallbacks, 0);
+  BOOST_CHECK_EQUAL(stdArrays->pNDArrayPool->getNumBuffers(), 0);
+  pArray->release();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -39,6 +39,56 @@ void TS_callback(void *userPvt, asynUser *pasynUser, void *pointer)
   callbackCount++;
 }
 
+// The data of the last callback on each Float64 array parameter, and of all chunks
+static std::vector<double> seriesData;
+static std::vector<double> decimatedData[NUM_TS_DECIMATIONS];
+static std::vector<double> chunkData;
+static int chunkCount = 0;
+static std::vector<double> signalArrayData;
+
+static void seriesCallback(void *userPvt, asynUser *pasynUser, epicsFloat64 *data, size_t nelements)
+{
+  seriesData.assign(data, data + nelements);
+}
+
+static void decimated1Callback(void *userPvt, asynUser *pasynUser, epicsFloat64 *data, size_t nelements)
+{
+  decimatedData[0].assign(data, data + nelements);
+}
+
+static void decimated2Callback(void *userPvt, asynUser *pasynUser, epicsFloat64 *data, size_t nelements)
+{
+  decimatedData[1].assign(data, data + nelements);
+}
+
+static void chunkCallback(void *userPvt, asynUser *pasynUser, epicsFloat64 *data, size_t nelements)
+{
+  chunkData.insert(chunkData.end(), data, data + nelements);
+  chunkCount++;
+}
+
+// The 1-D arrays for each signal are views that are released after the callback, so copy the data
+static void signalArrayCallback(void *userPvt, asynUser *pasynUser, void *pointer)
+{
+  NDArray *pArray = (NDArray *)pointer;
+  epicsFloat64 *pData = (epicsFloat64 *)pArray->pData;
+  signalArrayData.assign(pData, pData + pArray->dims[0].size);
+}
+
+/* Returns a [numSignals, numTimes] array where signal s at time t has the value first+t+1000*s */
+static NDArray *timeSeriesArray(NDArrayPool *arrayPool, size_t numSignals, size_t numTimes, int first)
+{
+  size_t dims[2] = {numSignals, numTimes};
+  NDArray *pArray = arrayPool->alloc(2, dims, NDFloat64, 0, NULL);
+  epicsFloat64 *pData = (epicsFloat64 *)pArray->pData;
+  for (size_t t=0; t<numTimes; t++) {
+    for (size_t signal=0; signal<numSignals; signal++) {
+      *pData++ = first + (double)t + 1000.*signal;
+    }
+  }
+  return pArray;
+}
+
 struct TimeSeriesPluginTestFixture
 {
   NDArrayPool *arrayPool;
@@ -52,6 +102,7 @@ struct TimeSeriesPluginTestFixture
   std::vector<size_t>dims_2d;
   std::vector<NDArray*>arrays_3d;
   std::vector<size_t>dims_3d;
+  std::string tsPort;
 
   static int testCase;
 
@@ -63,6 +114,7 @@ struct TimeSeriesPluginTestFixture
     std::string simport("simTS"), testport("TS");
     uniqueAsynPortName(simport);
     uniqueAsynPortName(testport);
+    tsPort = testport;
 
     // We need some upstream driver for our test plugin so that calls to connectArrayPort
     // don't fail, but we can then ignore it and send arrays by calling processCallbacks directly.
@@ -339,4 +391,113 @@ BOOST_AUTO_TEST_CASE(trigger_output_NDArray_circular_mode)
 }
 
 
+BOOST_AUTO_TEST_CASE(circular_mode_order)
+{
+  BOOST_MESSAGE("Checking that the circular buffer is output oldest point first");
+  asynFloat64ArrayClient seriesClient(tsPort.c_str(), 0, TSTimeSeriesString);
+  asynGenericPointerClient arrayClient(tsPort.c_str(), 0, NDArrayDataString);
+  seriesClient.registerInterruptUser(seriesCallback);
+  arrayClient.registerInterruptUser(signalArrayCallback);
+
+  BOOST_REQUIRE_NO_THROW(ts->write(TSAveragingTimeString, 0.001));
+  BOOST_REQUIRE_EQUAL(ts->readInt(TSNumAverageString), 1);
+  BOOST_CHECK_NO_THROW(ts->write(NDArrayCallbacksString, 1));
+  BOOST_CHECK_NO_THROW(ts->write(TSAcquireModeString, 1)); // TSAcquireModeCircular=1
+  BOOST_CHECK_NO_THROW(ts->write(TSAcquireString, 1));
+
+  // 25 time points wrap around the 20 point buffer
+  NDArray *pArray = timeSeriesArray(arrayPool, 3, 25, 0);
+  ts->lock();
+  BOOST_CHECK_NO_THROW(ts->processCallbacks(pArray));
+  ts->unlock();
+  pArray->release();
+  BOOST_CHECK_EQUAL(ts->readInt(TSCurrentPointString), 5);
+
+  BOOST_CHECK_NO_THROW(ts->write(TSReadString, 1));
+  BOOST_REQUIRE_EQUAL(seriesData.size(), 20);
+  BOOST_REQUIRE_EQUAL(signalArrayData.size(), 20);
+  for (int i=0; i<20; i++) {
+    BOOST_CHECK_EQUAL(seriesData[i], i + 5);
+    BOOST_CHECK_EQUAL(signalArrayData[i], i + 5);
+  }
+}
+
+
+BOOST_AUTO_TEST_CASE(streaming_mode_chunks)
+{
+  BOOST_MESSAGE("Checking that streaming mode outputs each new point once, in chunks");
+  asynFloat64ArrayClient chunkClient(tsPort.c_str(), 0, TSChunkString);
+  chunkClient.registerInterruptUser(chunkCallback);
+  chunkData.clear();
+  chunkCount = 0;
+
+  BOOST_REQUIRE_NO_THROW(ts->write(TSAveragingTimeString, 0.001));
+  BOOST_CHECK_NO_THROW(ts->write(TSAcquireModeString, 2)); // TSAcquireModeStreaming=2
+  BOOST_CHECK_NO_THROW(ts->write(TSChunkSizeString, 6));
+  BOOST_CHECK_NO_THROW(ts->write(TSAcquireString, 1));
+  BOOST_CHECK_EQUAL(ts->readInt(TSChunkSequenceString), 0);
+
+  // 64 time points, more than the 20 point buffer holds
+  for (int i=0; i<4; i++) {
+    NDArray *pArray = timeSeriesArray(arrayPool, 3, 16, 16*i);
+    ts->lock();
+    BOOST_CHECK_NO_THROW(ts->processCallbacks(pArray));
+    ts->unlock();
+    pArray->release();
+  }
+  BOOST_CHECK_EQUAL(chunkCount, 10);
+  BOOST_CHECK_EQUAL(ts->readInt(TSChunkSequenceString), 10);
+  BOOST_CHECK_EQUAL(ts->readInt(TSAcquireString), 1);
+
+  // Stopping outputs the last partial chunk
+  BOOST_CHECK_NO_THROW(ts->write(TSAcquireString, 0));
+  BOOST_CHECK_EQUAL(chunkCount, 11);
+  BOOST_CHECK_EQUAL(ts->readInt(TSChunkSequenceString), 11);
+  BOOST_REQUIRE_EQUAL(chunkData.size(), 64);
+  for (int i=0; i<64; i++) {
+    BOOST_CHECK_EQUAL(chunkData[i], i);
+  }
+}
+
+
+BOOST_AUTO_TEST_CASE(decimated_time_series)
+{
+  BOOST_MESSAGE("Checking the decimated time series, Decimate1=4, Decimate2=5");
+  asynFloat64ArrayClient decimated1Client(tsPort.c_str(), 0, TSDecimated1String);
+  asynFloat64ArrayClient decimated2Client(tsPort.c_str(), 0, TSDecimated2String);
+  decimated1Client.registerInterruptUser(decimated1Callback);
+  decimated2Client.registerInterruptUser(decimated2Callback);
+
+  BOOST_REQUIRE_NO_THROW(ts->write(TSAveragingTimeString, 0.001));
+  BOOST_CHECK_NO_THROW(ts->write(TSAcquireModeString, 1)); // TSAcquireModeCircular=1
+  BOOST_CHECK_NO_THROW(ts->write(TSDecimate1String, 4));
+  BOOST_CHECK_NO_THROW(ts->write(TSDecimate2String, 5));
+  BOOST_CHECK_NO_THROW(ts->write(TSAcquireString, 1));
+
+  // 100 time points give 25 points of decimation 1 and 5 of decimation 2
+  for (int i=0; i<5; i++) {
+    NDArray *pArray = timeSeriesArray(arrayPool, 3, 20, 20*i);
+    ts->lock();
+    BOOST_CHECK_NO_THROW(ts->processCallbacks(pArray));
+    ts->unlock();
+    pArray->release();
+  }
+  BOOST_CHECK_NO_THROW(ts->write(TSReadString, 1));
+
+  // Decimation 1 point k is the average of time points 4k to 4k+3; the last 20 are output
+  BOOST_REQUIRE_EQUAL(decimatedData[0].size(), 20);
+  for (int i=0; i<20; i++) {
+    BOOST_CHECK_CLOSE(decimatedData[0][i], 4*(i+5) + 1.5, 1e-9);
+  }
+  // Decimation 2 point j is the average of decimation 1 points 5j to 5j+4; the buffer is not yet full
+  BOOST_REQUIRE_EQUAL(decimatedData[1].size(), 20);
+  for (int i=0; i<15; i++) {
+    BOOST_CHECK_EQUAL(decimatedData[1][i], 0);
+  }
+  for (int j=0; j<5; j++) {
+    BOOST_CHECK_CLOSE(decimatedData[1][15+j], 20*j + 9.5, 1e-9);
+  }
+}
+
+
 BOOST_AUTO_TEST_SUITE_END() // Done!
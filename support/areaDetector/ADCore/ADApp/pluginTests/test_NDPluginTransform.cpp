@@ -0,0 +1,188 @@
+/*
+ * test_NDPluginTransform.cpp
+ *
+ * Checks every transform for each color mode against the pixel mapping of each transform,
+ * with image sizes that are not multiples of the block size of the transform kernel,
+ * and that TransformNone passes on a view of the input buffer.
+ */
+
+#include <stdio.h>
+
+
+#include "boost/test/unit_test.hpp"
+
+// AD dependencies
+#include <NDPluginDriver.h>
+#include <NDArray.h>
+#include <asynDriver.h>
+
+#include <string.h>
+#include <stdint.h>
+
+#include <boost/shared_ptr.hpp>
+using namespace std;
+
+#include "testingutilities.h"
+#include "TransformPluginWrapper.h"
+
+#define SIZE_X 37
+#define SIZE_Y 70
+
+static NDArray *transformOutput = 0;
+
+static void Transform_callback(void *userPvt, asynUser *pasynUser, void *pointer)
+{
+  if (transformOutput) transformOutput->release();
+  transformOutput = (NDArray *)pointer;
+  transformOutput->reserve();
+}
+
+/* Index of pixel (x, y) and color c of an xSize by ySize image in each color mode */
+static size_t pixelIndex(int colorMode, size_t x, size_t y, size_t c, size_t xSize, size_t ySize)
+{
+  switch (colorMode) {
+    case NDColorModeRGB1: return c + 3*x + 3*xSize*y;
+    case NDColorModeRGB2: return x + xSize*c + 3*xSize*y;
+    case NDColorModeRGB3: return x + xSize*y + xSize*ySize*c;
+    default:              return x + xSize*y;
+  }
+}
+
+/* Position of input pixel (x, y) in the output of each transform */
+static void transformPixel(int transformType, size_t x, size_t y, size_t *px, size_t *py)
+{
+  switch (transformType) {
+    case 1:  *px = SIZE_Y-1-y; *py = x;          break;  // Rotate90
+    case 2:  *px = SIZE_X-1-x; *py = SIZE_Y-1-y; break;  // Rotate180
+    case 3:  *px = y;          *py = SIZE_X-1-x; break;  // Rotate270
+    case 4:  *px = SIZE_X-1-x; *py = y;          break;  // Mirror
+    case 5:  *px = y;          *py = x;          break;  // Rotate90Mirror
+    case 6:  *px = x;          *py = SIZE_Y-1-y; break;  // Rotate180Mirror
+    case 7:  *px = SIZE_Y-1-y; *py = SIZE_X-1-x; break;  // Rotate270Mirror
+    default: *px = x;          *py = y;          break;
+  }
+}
+
+struct TransformPluginTestFixture
+{
+  boost::shared_ptr<asynNDArrayDriver> driver;
+  boost::shared_ptr<TransformPluginWrapper> transform;
+  boost::shared_ptr<asynGenericPointerClient> client;
+
+  TransformPluginTestFixture()
+  {
+    std::string simport("simTransform"), testport("Transform");
+    uniqueAsynPortName(simport);
+    uniqueAsynPortName(testport);
+
+    driver = boost::shared_ptr<asynNDArrayDriver>(new asynNDArrayDriver(simport.c_str(),
+                                                                     1, 0, 0,
+                                                                     asynGenericPointerMask,
+                                                                     asynGenericPointerMask,
+                                                                     0, 0, 0, 0));
+
+    // Arrays are sent to the plugin by calling processCallbacks directly
+    transform = boost::shared_ptr<TransformPluginWrapper>(new TransformPluginWrapper(testport.c_str(), simport.c_str()));
+    transform->write(NDPluginDriverEnableCallbacksString, 1);
+
+    client = boost::shared_ptr<asynGenericPointerClient>(new asynGenericPointerClient(testport.c_str(), 0, NDArrayDataString));
+    client->registerInterruptUser(&Transform_callback);
+  }
+
+  ~TransformPluginTestFixture()
+  {
+    client.reset();
+    if (transformOutput) transformOutput->release();
+    transformOutput = 0;
+    transform.reset();
+    driver.reset();
+  }
+
+  NDArray *createArray(int colorMode)
+  {
+    size_t dims[3];
+    int ndims = 3;
+    NDArray *pArray;
+
+    switch (colorMode) {
+      case NDColorModeRGB1: dims[0] = 3;      dims[1] = SIZE_X; dims[2] = SIZE_Y; break;
+      case NDColorModeRGB2: dims[0] = SIZE_X; dims[1] = 3;      dims[2] = SIZE_Y; break;
+      case NDColorModeRGB3: dims[0] = SIZE_X; dims[1] = SIZE_Y; dims[2] = 3;      break;
+      default:              dims[0] = SIZE_X; dims[1] = SIZE_Y; ndims = 2;        break;
+    }
+    pArray = driver->pNDArrayPool->alloc(ndims, dims, NDUInt32, 0, NULL);
+    BOOST_REQUIRE(pArray);
+    pArray->pAttributeList->add("ColorMode", "Color mode", NDAttrInt32, &colorMode);
+    epicsUInt32 *pData = (epicsUInt32 *)pArray->pData;
+    for (size_t i=0; i<(size_t)SIZE_X*SIZE_Y*(ndims == 3 ? 3 : 1); i++) pData[i] = (epicsUInt32)i;
+    return pArray;
+  }
+};
+
+BOOST_FIXTURE_TEST_SUITE(TransformPluginTests, TransformPluginTestFixture)
+
+BOOST_AUTO_TEST_CASE(test_TransformTypes)
+{
+  int colorModes[4] = {NDColorModeMono, NDColorModeRGB1, NDColorModeRGB2, NDColorModeRGB3};
+
+  for (int mode=0; mode<4; mode++) {
+    int colorMode = colorModes[mode];
+    size_t numColors = (colorMode == NDColorModeMono) ? 1 : 3;
+    NDArray *pArray = createArray(colorMode);
+    epicsUInt32 *pIn = (epicsUInt32 *)pArray->pData;
+
+    for (int transformType=0; transformType<8; transformType++) {
+      bool swap = (transformType % 2) == 1;
+      size_t outXSize = swap ? SIZE_Y : SIZE_X;
+      size_t outYSize = swap ? SIZE_X : SIZE_Y;
+      NDArrayInfo_t info;
+      size_t errors = 0;
+
+      BOOST_MESSAGE("colorMode=" << colorMode << " transformType=" << transformType);
+      transform->write(NDPluginTransformTypeString, transformType);
+      transform->lock();
+      BOOST_CHECK_NO_THROW(transform->processCallbacks(pArray));
+      transform->unlock();
+      BOOST_REQUIRE(transformOutput);
+      BOOST_REQUIRE_EQUAL(transformOutput->ndims, pArray->ndims);
+      transformOutput->getInfo(&info);
+      BOOST_CHECK_EQUAL(info.colorMode, colorMode);
+      BOOST_CHECK_EQUAL(info.xSize, outXSize);
+      BOOST_CHECK_EQUAL(info.ySize, outYSize);
+
+      epicsUInt32 *pOut = (epicsUInt32 *)transformOutput->pData;
+      for (size_t y=0; y<SIZE_Y; y++) {
+        for (size_t x=0; x<SIZE_X; x++) {
+          size_t px, py;
+          transformPixel(transformType, x, y, &px, &py);
+          for (size_t c=0; c<numColors; c++) {
+            if (pOut[pixelIndex(colorMode, px, py, c, outXSize, outYSize)] !=
+                pIn[pixelIndex(colorMode, x, y, c, SIZE_X, SIZE_Y)]) errors++;
+          }
+        }
+      }
+      BOOST_CHECK_EQUAL(errors, 0);
+    }
+    pArray->release();
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_TransformNoneIsView)
+{
+  NDArray *pArray = createArray(NDColorModeMono);
+
+  transform->write(NDPluginTransformTypeString, 0);
+  transform->lock();
+  BOOST_CHECK_NO_THROW(transform->processCallbacks(pArray));
+  transform->unlock();
+  BOOST_REQUIRE(transformOutput);
+  BOOST_CHECK(transformOutput != pArray);
+  BOOST_CHECK_EQUAL(transformOutput->pData, pArray->pData);
+  BOOST_CHECK_EQUAL(transformOutput->pViewParent, pArray);
+
+  transformOutput->release();
+  transformOutput = 0;
+  pArray->release();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
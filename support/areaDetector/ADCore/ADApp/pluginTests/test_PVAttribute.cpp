@@ -0,0 +1,152 @@
+/*
+ * test_PVAttribute.cpp
+ *
+ *  Created on: 19 Oct 2026
+ */
+
+#include <stdio.h>
+
+#include "boost/test/unit_test.hpp"
+
+// AD and EPICS dependencies
+#include <cadef.h>
+#include <epicsThread.h>
+#include <epicsEvent.h>
+#include <NDAttributeList.h>
+#include <PVAttribute.h>
+#include <asynNDArrayDriver.h>
+
+#include <string.h>
+#include <string>
+#include <boost/shared_ptr.hpp>
+
+#include "testingutilities.h"
+
+using namespace std;
+
+// The attributes have no source PV, so their values come only from calls to postValue()
+
+// Calls the monitor callback of the attribute the way channel access would
+static void postValue(PVAttribute *pAttribute, void *pValue)
+{
+  struct event_handler_args eha;
+  memset(&eha, 0, sizeof(eha));
+  eha.status = ECA_NORMAL;
+  eha.dbr = pValue;
+  pAttribute->monitorCallback(eha);
+}
+
+#define NUM_VALUES 200000
+
+struct monitorThreadData {
+  PVAttribute *pAttribute;
+  epicsEventId done;
+};
+
+// Posts the values 1 to NUM_VALUES
+static void monitorThread(void *arg)
+{
+  monitorThreadData *pData = (monitorThreadData *)arg;
+
+  for (int i=1; i<=NUM_VALUES; i++) {
+    epicsFloat64 value = i;
+    postValue(pData->pAttribute, &value);
+  }
+  epicsEventSignal(pData->done);
+}
+
+// Gives asynNDArrayDriver's attribute list to the tests
+class AttributeDriver : public asynNDArrayDriver
+{
+public:
+  AttributeDriver(const char *portName)
+    : asynNDArrayDriver(portName, 1, 0, 0, asynGenericPointerMask, asynGenericPointerMask, 0, 0, 0, 0) {}
+  NDAttributeList *attributeList() { return pAttributeList; }
+};
+
+BOOST_AUTO_TEST_SUITE(PVAttributeTests)
+
+BOOST_AUTO_TEST_CASE(test_ConcurrentUpdates)
+{
+  PVAttribute attribute("PVValue", "", NULL, DBR_DOUBLE);
+  monitorThreadData data;
+  epicsFloat64 value, lastValue = 0;
+  bool inOrder = true;
+
+  attribute.setDataType(NDAttrFloat64);
+  BOOST_CHECK_EQUAL(attribute.updateAge(), -1.);
+
+  // Values are read while the monitor callback is writing them; they must never go backwards
+  data.pAttribute = &attribute;
+  data.done = epicsEventMustCreate(epicsEventEmpty);
+  epicsThreadMustCreate("monitorThread", epicsThreadPriorityMedium,
+                        epicsThreadGetStackSize(epicsThreadStackMedium),
+                        monitorThread, &data);
+  while (epicsEventTryWait(data.done) != epicsEventOK) {
+    attribute.updateValue();
+    attribute.getValue(NDAttrFloat64, &value);
+    if (value < lastValue) inOrder = false;
+    lastValue = value;
+  }
+  epicsEventDestroy(data.done);
+  BOOST_CHECK(inOrder);
+
+  attribute.updateValue();
+  attribute.getValue(NDAttrFloat64, &value);
+  BOOST_CHECK_EQUAL(value, NUM_VALUES);
+  BOOST_CHECK(attribute.updateAge() >= 0.);
+  BOOST_CHECK(attribute.updateAge() < 10.);
+
+  // A PV that has not changed keeps its value
+  attribute.updateValue();
+  attribute.getValue(NDAttrFloat64, &value);
+  BOOST_CHECK_EQUAL(value, NUM_VALUES);
+}
+
+BOOST_AUTO_TEST_CASE(test_StringValue)
+{
+  PVAttribute attribute("PVString", "", NULL, DBR_STRING);
+  char text[MAX_STRING_SIZE] = "first";
+  string value;
+
+  attribute.setDataType(NDAttrString);
+  postValue(&attribute, text);
+  strcpy(text, "second");
+  postValue(&attribute, text);
+  attribute.updateValue();
+  attribute.getValue(value);
+  BOOST_CHECK_EQUAL(value, "second");
+  BOOST_CHECK(attribute.updateAge() >= 0.);
+}
+
+BOOST_AUTO_TEST_CASE(test_MaxAge)
+{
+  std::string port("PVAttributeDriver");
+  uniqueAsynPortName(port);
+  boost::shared_ptr<AttributeDriver> driver(new AttributeDriver(port.c_str()));
+  PVAttribute *pAttribute = new PVAttribute("PVValue", "", NULL, DBR_DOUBLE);
+  NDAttributeList list;
+  epicsFloat64 value = 1.;
+  double age;
+  int index;
+
+  BOOST_REQUIRE_EQUAL(driver->findParam(NDAttributesMaxAgeString, &index), asynSuccess);
+  pAttribute->setDataType(NDAttrFloat64);
+  driver->attributeList()->add(pAttribute);
+
+  // -1 until the PV has a value
+  driver->getAttributes(&list);
+  driver->getDoubleParam(index, &age);
+  BOOST_CHECK_EQUAL(age, -1.);
+
+  postValue(pAttribute, &value);
+  epicsThreadSleep(0.01);
+  driver->getAttributes(&list);
+  driver->getDoubleParam(index, &age);
+  BOOST_CHECK(age >= 0.01);
+  BOOST_CHECK(age < 10.);
+  list.find("PVValue")->getValue(NDAttrFloat64, &value);
+  BOOST_CHECK_EQUAL(value, 1.);
+}
+
+BOOST_AUTO_TEST_SUITE_END()